@@ -29,6 +29,7 @@
 // Model-specific registers that we use
 #define X86_MSR_APICBASE				0x1B
 #define X86_MSR_PAT						0x277
+#define X86_MSR_TSCDEADLINE				0x6E0
 
 // Bitfields for the APICBASE MSR
 #define X86_MSR_APICBASE_BASEADDR		0xFFFFF000
@@ -90,6 +91,19 @@
 #define X86_PAGEFLAG_DIRTY				0x0040
 #define X86_PAGEFLAG_PAT				0x0080
 #define X86_PAGEFLAG_GLOBAL				0x0100
+// Available to software
+#define X86_PAGEFLAG_COPYONWRITE		0x0200
+#define X86_PAGEFLAG_SHARED				0x0400
+
+// Page fault error code bitfield values
+#define X86_PAGEFAULT_PRESENT			0x0001
+#define X86_PAGEFAULT_WRITE				0x0002
+#define X86_PAGEFAULT_USER				0x0004
+
+// Page directory entry bitfield values, for large (4MB) pages
+#define X86_LARGE_PAGE_SIZE				0x00400000
+#define X86_PAGEFLAG_LARGE				0x0080
+#define X86_PAGEFLAG_LARGEPAT			0x1000
 
 // Processor context values
 #define X86_FPU_STATE_LEN				108
@@ -161,6 +175,9 @@ typedef volatile struct {
 #define processorSetCR0(variable) \
 	__asm__ __volatile__ ("movl %0, %%cr0" : : "r" (variable))
 
+#define processorGetCR2(variable) \
+	__asm__ __volatile__ ("movl %%cr2, %0" : "=r" (variable))
+
 #define processorGetCR3(variable) \
 	__asm__ __volatile__ ("movl %%cr3, %0" : "=r" (variable))
 
@@ -372,8 +389,26 @@ typedef volatile struct {
 	processorPopFlags(); \
 } while (0)
 
+#define processorGetTaskReg(selector) \
+	__asm__ __volatile__ ("str %0" : "=r" (selector))
+
 #define processorClearTaskSwitched() __asm__ __volatile__ ("clts")
 
+#define processorSetTaskSwitched() do { \
+	unsigned _cr0 = 0; \
+	processorGetCR0(_cr0); \
+	_cr0 |= 0x08; \
+	processorSetCR0(_cr0); \
+} while (0)
+
+// Make read-only pages read-only for the kernel as well
+#define processorSetWriteProtect() do { \
+	unsigned _cr0 = 0; \
+	processorGetCR0(_cr0); \
+	_cr0 |= 0x10000; \
+	processorSetCR0(_cr0); \
+} while (0)
+
 #define processorGetInstructionPointer(addr) \
 	__asm__ __volatile__ ( \
 		"call 1f \n\t" \
@@ -390,6 +425,57 @@ typedef volatile struct {
 	processorPopFlags(); \
 } while (0)
 
+// Save the flags, frame pointer and data segments on the current stack,
+// store the stack pointer at 'saveSp', load the page directory (if it's
+// different) and the new stack pointer, and resume whatever was saved there.
+// If 'entry' is non-NULL, jump to it instead, for a stack that has never run.
+// Nothing may touch the stack between the CR3 and ESP loads, since the old
+// stack might not be mapped in the new address space.
+#define processorSwitchStack(saveSp, cr3, loadSp, entry) do { \
+	unsigned _save = (unsigned) (saveSp), _cr3 = (unsigned) (cr3); \
+	unsigned _load = (unsigned) (loadSp), _entry = (unsigned) (entry); \
+	__asm__ __volatile__ ( \
+		"pushfl \n\t" \
+		"pushl %%ebp \n\t" \
+		"pushl %%ds \n\t" \
+		"pushl %%es \n\t" \
+		"pushl %%fs \n\t" \
+		"pushl %%gs \n\t" \
+		"pushl $1f \n\t" \
+		"movl %%esp, (%0) \n\t" \
+		"movl %%cr3, %%ebx \n\t" \
+		"cmpl %%ebx, %1 \n\t" \
+		"je 2f \n\t" \
+		"movl %1, %%cr3 \n\t" \
+		"2: movl %2, %%esp \n\t" \
+		"testl %3, %3 \n\t" \
+		"jz 3f \n\t" \
+		"jmp *%3 \n\t" \
+		"3: ret \n\t" \
+		"1: popl %%gs \n\t" \
+		"popl %%fs \n\t" \
+		"popl %%es \n\t" \
+		"popl %%ds \n\t" \
+		"popl %%ebp \n\t" \
+		"popfl" \
+		: "+a" (_save), "+c" (_cr3), "+d" (_load), "+S" (_entry) \
+		: : "%ebx", "%edi", "memory"); \
+} while (0)
+
+// Start a task from an interrupt return frame at 'frame': EIP, CS and
+// EFLAGS, plus ESP and SS if the task runs at a lower privilege level
+#define processorStartTask(frame, dataSel) do { \
+	__asm__ __volatile__ ( \
+		"movw %%dx, %%ds \n\t" \
+		"movw %%dx, %%es \n\t" \
+		"movw %%dx, %%fs \n\t" \
+		"movw %%dx, %%gs \n\t" \
+		"movl %%eax, %%esp \n\t" \
+		"iret" \
+		: : "a" (frame), "d" (dataSel) : "memory"); \
+	__builtin_unreachable(); \
+} while (0)
+
 #define processorIsrCall(addr) do { \
 	processorPush(PRIV_CODE); \
 	processorPush(addr); \
@@ -418,6 +504,26 @@ typedef volatile struct {
 	processorIntReturn(); \
 } while (0)
 
+// A page fault pushes an error code above the return address, which has to
+// be discarded before returning.  The faulting address is in CR2, 'code'
+// gets the error code, and 'ints' gets the interrupt status of the code
+// that faulted.
+#define processorPageFaultEnter(exAddr, faultAddr, code, ints) do { \
+	processorPushRegs(); \
+	__asm__ __volatile__ ("movl 4(%%ebp), %0" : "=r" (code)); \
+	__asm__ __volatile__ ("movl 8(%%ebp), %0" : "=r" (exAddr)); \
+	__asm__ __volatile__ ("movl 16(%%ebp), %0" : "=r" (ints)); \
+	ints = ((ints >> 9) & 1); \
+	processorGetCR2(faultAddr); \
+} while (0)
+
+#define processorPageFaultExit() do { \
+	processorPopRegs(); \
+	processorPopFrame(); \
+	__asm__ __volatile__ ("addl $4, %%esp" : : : "%esp"); \
+	processorIntReturn(); \
+} while (0)
+
 #define processorIsrEnter(stAddr) do { \
 	processorDisableInts(); \
 	processorPushRegs(); \
@@ -500,6 +606,33 @@ typedef volatile struct {
 	__asm__ __volatile__ ("lock cmpxchgl %1, %2" \
 		: : "a" (0), "r" (proc), "m" (lck) : "memory")
 
+// Atomically store 'val' in 'lck', and return the previous contents in 'val'
+#define processorExchange(lck, val) \
+	__asm__ __volatile__ ("xchgl %0, %1" \
+		: "+r" (val), "+m" (lck) : : "memory")
+
+#define processorAtomicDec(variable) \
+	__asm__ __volatile__ ("lock decl %0" : "+m" (variable) : : "memory")
+
+// If 'var' contains 'old', atomically replace it with 'new'.  Either way,
+// the previous contents are returned in 'old'.
+#define processorCompareExchange(var, old, new) \
+	__asm__ __volatile__ ("lock cmpxchgl %2, %1" \
+		: "+a" (old), "+m" (var) : "r" (new) : "memory")
+
+// Atomically add 'val' to 'variable', and return the previous contents in
+// 'val'
+#define processorAtomicAdd(variable, val) \
+	__asm__ __volatile__ ("lock xaddl %0, %1" \
+		: "+r" (val), "+m" (variable) : : "memory")
+
+// Orders all earlier memory accesses before all later ones, including loads
+// after stores
+#define processorBarrier() \
+	__asm__ __volatile__ ("lock addl $0, (%%esp)" : : : "memory")
+
+#define processorPause() __asm__ __volatile__ ("pause" : : : "memory")
+
 static inline unsigned short processorSwap16(unsigned short variable)
 {
 	volatile unsigned short tmp = (variable);
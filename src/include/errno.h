@@ -89,6 +89,7 @@ extern int errno;
 #define EOVERFLOW ERR_BOUNDS       // Value too large for defined data type
 #define EBADRQC ERR_NOSUCHFUNCTION // No such function
 #define ENOTEMPTY ERR_NOTEMPTY     // Not empty
+#define ETIMEDOUT ERR_TIMEOUT      // Timed out
 #define EWOULDBLOCK EAGAIN         // Operation would block
 
 // Synonyms -- compatibility
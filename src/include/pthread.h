@@ -25,6 +25,16 @@
 #ifndef _PTHREAD_H
 #define _PTHREAD_H
 
+#include <time.h>
+
+#define PTHREAD_KEYS_MAX				64
+
+// Mutex types
+#define PTHREAD_MUTEX_NORMAL			0
+#define PTHREAD_MUTEX_RECURSIVE			1
+#define PTHREAD_MUTEX_ERRORCHECK		2
+#define PTHREAD_MUTEX_DEFAULT			PTHREAD_MUTEX_NORMAL
+
 typedef struct {
 	int pad;
 
@@ -32,15 +42,96 @@ typedef struct {
 
 typedef int pthread_t;
 
+typedef struct {
+	int type;
+
+} pthread_mutexattr_t;
+
+// The lock word is 0 when the mutex is unlocked, 1 when it's locked, and 2
+// when it's locked and other threads might be waiting for it.  Only the
+// non-normal types keep track of the owner.
+typedef struct {
+	volatile int lock;
+	int type;
+	pthread_t owner;
+	int count;
+
+} pthread_mutex_t;
+
+#define PTHREAD_MUTEX_INITIALIZER		{ 0, PTHREAD_MUTEX_NORMAL, 0, 0 }
+
+typedef struct {
+	int pad;
+
+} pthread_condattr_t;
+
+// Waiters sleep until the sequence number changes
+typedef struct {
+	volatile int sequence;
+	volatile int waiters;
+
+} pthread_cond_t;
+
+#define PTHREAD_COND_INITIALIZER		{ 0, 0 }
+
+typedef struct {
+	int pad;
+
+} pthread_rwlockattr_t;
+
+// The state holds the number of readers, and the flags below
+typedef struct {
+	volatile int state;
+
+} pthread_rwlock_t;
+
+#define PTHREAD_RWLOCK_WRITER			0x40000000
+#define PTHREAD_RWLOCK_WAITERS			0x20000000
+#define PTHREAD_RWLOCK_READERS			0x1FFFFFFF
+#define PTHREAD_RWLOCK_INITIALIZER		{ 0 }
+
+typedef volatile int pthread_once_t;
+#define PTHREAD_ONCE_INIT				0
+
+typedef int pthread_key_t;
+
 // Functions exported by libpthread
 int pthread_attr_destroy(pthread_attr_t *);
 int pthread_attr_init(pthread_attr_t *);
 int pthread_cancel(pthread_t);
+int pthread_cond_broadcast(pthread_cond_t *);
+int pthread_cond_destroy(pthread_cond_t *);
+int pthread_cond_init(pthread_cond_t *, const pthread_condattr_t *);
+int pthread_cond_signal(pthread_cond_t *);
+int pthread_cond_timedwait(pthread_cond_t *, pthread_mutex_t *,
+	const struct timespec *);
+int pthread_cond_wait(pthread_cond_t *, pthread_mutex_t *);
 int pthread_create(pthread_t *, const pthread_attr_t *, void *(*)(void *),
 	void *);
 void pthread_exit(void *);
+void *pthread_getspecific(pthread_key_t);
 int pthread_join(pthread_t, void **);
+int pthread_key_create(pthread_key_t *, void (*)(void *));
+int pthread_key_delete(pthread_key_t);
+int pthread_mutex_destroy(pthread_mutex_t *);
+int pthread_mutex_init(pthread_mutex_t *, const pthread_mutexattr_t *);
+int pthread_mutex_lock(pthread_mutex_t *);
+int pthread_mutex_trylock(pthread_mutex_t *);
+int pthread_mutex_unlock(pthread_mutex_t *);
+int pthread_mutexattr_destroy(pthread_mutexattr_t *);
+int pthread_mutexattr_gettype(const pthread_mutexattr_t *, int *);
+int pthread_mutexattr_init(pthread_mutexattr_t *);
+int pthread_mutexattr_settype(pthread_mutexattr_t *, int);
+int pthread_once(pthread_once_t *, void (*)(void));
+int pthread_rwlock_destroy(pthread_rwlock_t *);
+int pthread_rwlock_init(pthread_rwlock_t *, const pthread_rwlockattr_t *);
+int pthread_rwlock_rdlock(pthread_rwlock_t *);
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *);
+int pthread_rwlock_trywrlock(pthread_rwlock_t *);
+int pthread_rwlock_unlock(pthread_rwlock_t *);
+int pthread_rwlock_wrlock(pthread_rwlock_t *);
 pthread_t pthread_self(void);
+int pthread_setspecific(pthread_key_t, const void *);
 
 #endif
 
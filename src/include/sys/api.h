@@ -206,6 +206,7 @@ int memoryRelease(void *);
 int memoryReleaseAllByProcId(int);
 int memoryGetStats(memoryStats *, int);
 int memoryGetBlocks(memoryBlock *, unsigned, int);
+void *memoryCopyToProcess(void *, int);
 
 //
 // Multitasker functions
@@ -241,6 +242,13 @@ int multitaskerSignalRead(int);
 int multitaskerGetIoPerm(int, int);
 int multitaskerSetIoPerm(int, int, int);
 int multitaskerStackTrace(int);
+void multitaskerWaitUs(unsigned);
+int multitaskerFutexWait(volatile int *, int, unsigned);
+int multitaskerFutexWake(volatile int *, int);
+int multitaskerSetProfiling(int);
+int multitaskerGetProfiling(void);
+int multitaskerGetProcessStats(int, processStats *);
+int multitaskerGetApiStats(apiCallStats *, int);
 
 //
 // Loader functions
@@ -433,6 +441,13 @@ objectKey windowNewTree(objectKey, windowTreeItem *, int, int,
 int windowMenuUpdate(objectKey, const char *, const char *,
 	windowMenuContents *, componentParameters *);
 int windowMenuDestroy(objectKey);
+objectKey windowNewVirtualList(objectKey, windowListType, int, int, int, int,
+	componentParameters *);
+int windowListSetNumItems(objectKey, int);
+int windowListSetItems(objectKey, int, listItemParameters *, int);
+int windowListScrollTo(objectKey, int);
+int windowCanvasMapBuffer(objectKey, graphicBuffer *);
+int windowCanvasPresent(objectKey, int, int, int, int);
 
 //
 // User functions
@@ -529,6 +544,11 @@ unsigned charsetFromUnicode(const char *, unsigned);
 uquad_t cpuGetMs(void);
 void cpuSpinMs(unsigned);
 int touchAvailable(void);
+uquad_t cpuGetUs(void);
+int cpuGetCount(void);
+int configGetCacheStats(configCacheStats *);
+int cryptHashSha1File(const char *, unsigned char *);
+int cryptHashSha256File(const char *, unsigned char *);
 
 #endif
 
@@ -166,6 +166,7 @@ typedef volatile void * objectKey;
 #define _fnum_memoryReleaseAllByProcId			0x5002
 #define _fnum_memoryGetStats					0x5003
 #define _fnum_memoryGetBlocks					0x5004
+#define _fnum_memoryCopyToProcess				0x5005
 
 // Multitasker functions.  All are in the 0x6000-0x6FFF range.
 #define _fnum_multitaskerCreateProcess			0x6000
@@ -199,6 +200,13 @@ typedef volatile void * objectKey;
 #define _fnum_multitaskerGetIoPerm				0x601C
 #define _fnum_multitaskerSetIoPerm				0x601D
 #define _fnum_multitaskerStackTrace				0x601E
+#define _fnum_multitaskerWaitUs					0x601F
+#define _fnum_multitaskerFutexWait				0x6020
+#define _fnum_multitaskerFutexWake				0x6021
+#define _fnum_multitaskerSetProfiling			0x6022
+#define _fnum_multitaskerGetProfiling			0x6023
+#define _fnum_multitaskerGetProcessStats		0x6024
+#define _fnum_multitaskerGetApiStats			0x6025
 
 // Loader functions.  All are in the 0x7000-0x7FFF range.
 #define _fnum_loaderLoad						0x7000
@@ -363,6 +371,12 @@ typedef volatile void * objectKey;
 #define _fnum_windowNewTree						0xF052
 #define _fnum_windowMenuUpdate					0xF053
 #define _fnum_windowMenuDestroy					0xF054
+#define _fnum_windowNewVirtualList				0xF055
+#define _fnum_windowListSetNumItems				0xF056
+#define _fnum_windowListSetItems				0xF057
+#define _fnum_windowListScrollTo				0xF058
+#define _fnum_windowCanvasMapBuffer				0xF059
+#define _fnum_windowCanvasPresent				0xF05A
 
 // User functions.  All are in the 0x10000-0x10FFF range.
 #define _fnum_userAuthenticate					0x10000
@@ -448,6 +462,11 @@ typedef volatile void * objectKey;
 #define _fnum_cpuGetMs							0xFF01C
 #define _fnum_cpuSpinMs							0xFF01D
 #define _fnum_touchAvailable					0xFF01E
+#define _fnum_cpuGetUs							0xFF01F
+#define _fnum_cpuGetCount						0xFF020
+#define _fnum_configGetCacheStats				0xFF021
+#define _fnum_cryptHashSha1File					0xFF022
+#define _fnum_cryptHashSha256File				0xFF023
 
 #endif
 
@@ -37,6 +37,7 @@ typedef enum {
 } fileDescType;
 
 // Internal functions of the C library
+unsigned _crc32(void *, unsigned, unsigned *);
 void _dbl2str(double, char *, int);
 int _digits(unsigned, int, int);
 int _fdalloc(fileDescType, void *, int);
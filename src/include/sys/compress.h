@@ -30,8 +30,8 @@
 #include <sys/progress.h>
 
 // For doing distance-length hashes
-#define DEFLATE_HASH_NODES		(DEFLATE_MAX_INBUFFERSIZE * 2)
-#define DEFLATE_HASH_BUCKETS	256
+#define DEFLATE_HASH_BITS		15
+#define DEFLATE_HASH_SIZE		(1 << DEFLATE_HASH_BITS)
 
 typedef struct {
 	const unsigned char *data;
@@ -49,7 +49,10 @@ typedef struct {
 typedef struct {
 	const unsigned char *data;
 	unsigned char bit;
-	unsigned short byte;
+	unsigned byte;
+	unsigned bytes;
+	unsigned long buffer;
+	unsigned char bufferBits;
 
 } bitBufferIn;
 
@@ -66,26 +69,14 @@ typedef struct {
 
 } processedInput;
 
-typedef struct _hashNode {
-	int generation;
-	const unsigned char *data;
-	struct _hashNode *prev;
-	struct _hashNode *next;
-
-} hashNode;
-
+// Hash chains of the positions of 3-byte strings in the input buffer.  The
+// head of each chain is found by hashing the string, and the rest are linked
+// through the 'prev' array, which covers one window's worth of positions.
+// Positions are stored plus one, so that 0 means none.
 typedef struct {
-	hashNode *sub[DEFLATE_HASH_BUCKETS];
-
-} hashBucket;
-
-typedef struct {
-	int generation;
 	unsigned byte;
-	hashNode nodeMemory[DEFLATE_MAX_OUTBUFFERSIZE * 2];
-	hashNode *freeNodes;
-	int numFreeNodes;
-	hashBucket buckets[DEFLATE_HASH_BUCKETS];
+	unsigned head[DEFLATE_HASH_SIZE];
+	unsigned prev[DEFLATE_MAX_DISTANCE];
 
 } hashTable;
 
@@ -137,6 +128,19 @@ typedef struct {
 
 } huffmanTable;
 
+// For decoding Huffman codes by table lookup.  The primary table is indexed
+// by the next (up to) DEFLATE_DECODE_BITS bits of input, and codes longer
+// than that continue in sub-tables after it.
+#define DEFLATE_DECODE_BITS		10
+#define DEFLATE_DECODE_ENTRIES	((1 << DEFLATE_DECODE_BITS) + \
+	(DEFLATE_LITLEN_CODES << (DEFLATE_MAX_CODE_BITS - DEFLATE_DECODE_BITS)))
+
+typedef struct {
+	unsigned char bits;
+	unsigned entry[DEFLATE_DECODE_ENTRIES];
+
+} huffmanDecodeTable;
+
 // State structure passed to compressDeflate() and decompressDeflate().
 // Incorporates all of the working memory needed for DEFLATE.  This is a
 // BIG structure.  Don't try to allocate this on the stack!
@@ -148,6 +152,8 @@ typedef struct {
 	unsigned char *outBuffer;
 	unsigned outBytes;	// outBuffer remaining space
 	unsigned outByte;	// outBuffer current (initially 0)
+	int level;			// compression level 1-9 (0 for the default)
+	int flush;			// end non-final output on a byte boundary
 
 	// The running checksum and the final block flag, set by the DEFLATE code
 	unsigned crc32Sum;
@@ -165,15 +171,17 @@ typedef struct {
 	huffmanTree distTree;
 	huffmanTree codeLenTree;
 
-	// Decompression only
-	bitBufferIn bitIn;
-	byteBufferOut byteOut;
-
-	// Compression and decompression
 	huffmanTable litLenTable;
 	huffmanTable distTable;
 	huffmanTable codeLenTable;
 
+	// Decompression only
+	bitBufferIn bitIn;
+	byteBufferOut byteOut;
+	huffmanDecodeTable litLenDecode;
+	huffmanDecodeTable distDecode;
+	huffmanDecodeTable codeLenDecode;
+
 } deflateState;
 
 typedef struct {
@@ -199,8 +207,8 @@ int deflateDecompress(deflateState *);
 int deflateCompressFileData(deflateState *, FILE *, FILE *, progress *);
 int deflateDecompressFileData(deflateState *, FILE *, FILE *, progress *);
 int gzipAddMember(FILE *, FILE *, const char *, const char *, unsigned, int,
-	progress *);
-int gzipCompressFile(const char *, const char *, const char *, int,
+	int, progress *);
+int gzipCompressFile(const char *, const char *, const char *, int, int,
 	progress *);
 int gzipMemberInfo(FILE *, archiveMemberInfo *, progress *);
 int gzipExtractNextMember(FILE *, int, const char *, progress *);
@@ -213,10 +221,11 @@ int tarMemberInfo(FILE *, archiveMemberInfo *, progress *);
 int tarExtractNextMember(FILE *, progress *);
 int tarExtractMember(const char *, const char *, int, progress *);
 int tarExtract(const char *, progress *);
+int tarExtractGzip(const char *, progress *);
 int tarDeleteMember(const char *, const char *, int, progress *);
-int archiveAddMember(const char *, const char *, int, const char *,
+int archiveAddMember(const char *, const char *, int, const char *, int,
 	progress *);
-int archiveAddRecursive(const char *, const char *, int, const char *,
+int archiveAddRecursive(const char *, const char *, int, const char *, int,
 	progress *);
 int archiveInfo(const char *, archiveMemberInfo **, progress *);
 void archiveInfoContentsFree(archiveMemberInfo *);
@@ -34,6 +34,14 @@
 	(DEFLATE_LITERAL_CODES + DEFLATE_LENGTH_CODES)
 #define DEFLATE_DIST_CODES			32
 #define DEFLATE_CODELEN_CODES		19
+#define DEFLATE_MAX_CODE_BITS		15
+#define DEFLATE_MIN_MATCH			3
+#define DEFLATE_MAX_MATCH			258
+
+// Compression levels
+#define DEFLATE_MIN_LEVEL			1
+#define DEFLATE_DEFAULT_LEVEL		6
+#define DEFLATE_MAX_LEVEL			9
 
 // Block format flag fields
 #define DEFLATE_BTYPE_NONE			0x00
@@ -88,5 +88,14 @@ typedef struct {
 
 } dirStream;
 
+// Statistics for the kernel's cache of parsed config files
+typedef struct {
+	unsigned hits;
+	unsigned misses;
+	unsigned invalidations;
+	unsigned entries;
+
+} configCacheStats;
+
 #endif
 
@@ -35,6 +35,10 @@
 #define GZIP_FLG_FNAME		0x08
 #define GZIP_FLG_FCOMMENT	0x10
 
+// GZIP extra flags, for DEFLATE
+#define GZIP_XFL_MAXCOMP	0x02
+#define GZIP_XFL_FASTEST	0x04
+
 // GZIP OS values
 #define GZIP_OS_FAT			0x00
 #define GZIP_OS_AMIGA		0x01
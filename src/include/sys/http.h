@@ -25,12 +25,17 @@
 #ifndef _HTTP_H
 #define _HTTP_H
 
+#include <stdio.h>
 #include <sys/url.h>
 #include <sys/vis.h>
 
 // Requests
 #define HTTP_REQUEST_GET					"GET"
 
+// Protocol versions
+#define HTTP_VERSION_10						"HTTP/1.0"
+#define HTTP_VERSION_11						"HTTP/1.1"
+
 // Variable names for parts of response status lines
 #define HTTP_VERSION_VAR					"__http_version_var__"
 #define HTTP_STATUSCODE_VAR					"__http_status_code__"
@@ -121,6 +126,11 @@
 #define HTTP_HEADER_WWWAUTHENTICATE			"WWW-Authenticate"	// resp
 #define HTTP_HEADER_XFRAMEOPTIONS			"X-Frame-Options"	// resp
 
+// Header field values
+#define HTTP_CONNECTION_CLOSE				"close"
+#define HTTP_CONNECTION_KEEPALIVE			"keep-alive"
+#define HTTP_TRANSFERENCODING_CHUNKED		"chunked"
+
 // Status codes
 
 // 1xx Informational responses
@@ -191,11 +201,23 @@
 #define HTTP_STATUSCODE_NOTEXTENDED			510
 #define HTTP_STATUSCODE_NETAUTHREQUIRED		511
 
+// A function that receives response content as it arrives.  The first
+// argument is the number of the request (for pipelined requests, otherwise
+// zero), and the last is the caller's data pointer.  Returning a negative
+// error code aborts the transfer.
+typedef int (*httpContentCallback)(int, const char *, unsigned, void *);
+
 // Functions exported from the libhttp library
 int httpParseUrl(const char *, urlInfo **);
 void httpFreeUrlInfo(urlInfo *);
 const char *httpUrlSchemeToString(urlScheme);
 int httpGet(urlInfo *, variableList *, char **, int *, unsigned);
+int httpGetStream(urlInfo *, variableList *, httpContentCallback, void *,
+	unsigned);
+int httpGetFile(urlInfo *, variableList *, FILE *, unsigned);
+int httpGetPipelined(urlInfo *[], variableList *, int *, int,
+	httpContentCallback, void *, unsigned);
+void httpCloseConnections(void);
 
 #endif
 
@@ -90,12 +90,15 @@ typedef struct {
 	unsigned size;
 	int binding;
 	int type;
+	int hashNext;		// Next symbol in the same hash chain, or -1
 
 } loaderSymbol;
 
 typedef struct {
 	int numSymbols;
 	int tableSize;
+	int numBuckets;		// Size of the hash table, or 0 if none
+	int *buckets;		// First symbol in each hash chain, or -1
 	loaderSymbol symbols[];
 
 } loaderSymbolTable;
@@ -31,6 +31,7 @@
 // The default system directory and sub-directories
 #define PATH_SYSTEM				"/system"
 #define PATH_SYSTEM_BOOT		PATH_SYSTEM "/boot"
+#define PATH_SYSTEM_CACHE		PATH_SYSTEM "/cache"
 #define PATH_SYSTEM_CONFIG		PATH_SYSTEM "/config"
 #define PATH_SYSTEM_FONTS		PATH_SYSTEM "/fonts"
 #define PATH_SYSTEM_HEADERS		PATH_SYSTEM "/headers"
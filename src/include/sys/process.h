@@ -26,10 +26,11 @@
 #define _PROCESS_H
 
 #include <string.h>
+#include <sys/types.h>
 #include <sys/user.h>
 
 #define MAX_PROCNAME_LENGTH		63
-#define MAX_PROCESSES			((GDT_SIZE - RES_GLOBAL_DESCRIPTORS))
+#define MAX_PROCESSES			4096
 
 // An enumeration listing possible process states
 typedef enum {
@@ -72,5 +73,30 @@ typedef struct {
 
 } process;
 
+// Scheduling statistics for a process.  Times are in microseconds.  The
+// ready, blocked, and API call times are only counted while profiling is
+// turned on (see multitaskerSetProfiling()).
+typedef struct {
+	int processId;
+	unsigned voluntarySwitches;		// Yielded, waited, or blocked
+	unsigned involuntarySwitches;	// Time slice ran out, or preempted
+	uquad_t runTime;
+	uquad_t readyTime;				// Ready to run, but not running
+	uquad_t blockedTime;			// Waiting, sleeping, or stopped
+	unsigned pageFaults;
+	unsigned apiCalls;
+	uquad_t apiTime;
+
+} processStats;
+
+// System-wide statistics for a kernel API function, collected while
+// profiling is turned on
+typedef struct {
+	int functionNumber;
+	unsigned calls;
+	uquad_t time;
+
+} apiCallStats;
+
 #endif
 
@@ -42,6 +42,18 @@
 	#define PROCESSOR_PAGEFLAG_DIRTY		X86_PAGEFLAG_DIRTY
 	#define PROCESSOR_PAGEFLAG_PAT			X86_PAGEFLAG_PAT
 	#define PROCESSOR_PAGEFLAG_GLOBAL		X86_PAGEFLAG_GLOBAL
+	#define PROCESSOR_PAGEFLAG_COPYONWRITE	X86_PAGEFLAG_COPYONWRITE
+	#define PROCESSOR_PAGEFLAG_SHARED		X86_PAGEFLAG_SHARED
+
+	// Page fault error code bitfield values
+	#define PROCESSOR_PAGEFAULT_PRESENT		X86_PAGEFAULT_PRESENT
+	#define PROCESSOR_PAGEFAULT_WRITE		X86_PAGEFAULT_WRITE
+	#define PROCESSOR_PAGEFAULT_USER		X86_PAGEFAULT_USER
+
+	// Large page values
+	#define PROCESSOR_LARGE_PAGE_SIZE		X86_LARGE_PAGE_SIZE
+	#define PROCESSOR_PAGEFLAG_LARGE		X86_PAGEFLAG_LARGE
+	#define PROCESSOR_PAGEFLAG_LARGEPAT		X86_PAGEFLAG_LARGEPAT
 
 #else
 	#error "ARCH not defined or not supported"
@@ -34,6 +34,7 @@ typedef int					mode_t;
 typedef unsigned			nlink_t;
 typedef unsigned			blksize_t;
 typedef unsigned			blkcnt_t;
+typedef unsigned			useconds_t;
 typedef long long			quad_t;
 typedef unsigned long long	uquad_t;
 
@@ -33,8 +33,10 @@
 // Definitions for variable lists
 #define VARIABLE_INITIAL_MEMORY		MEMORY_PAGE_SIZE
 #define VARIABLE_INITIAL_NUMBER		32
+// Per variable: name and value offsets, a hash, and 2 hash index entries
+#define VARIABLE_SLOT_SIZE			(5 * sizeof(unsigned))
 #define VARIABLE_INITIAL_DATASIZE \
-	(VARIABLE_INITIAL_MEMORY - (2 * VARIABLE_INITIAL_NUMBER * sizeof(char *)))
+	(VARIABLE_INITIAL_MEMORY - (VARIABLE_INITIAL_NUMBER * VARIABLE_SLOT_SIZE))
 
 // Structures for linked lists
 
@@ -59,8 +61,10 @@ typedef struct {
 typedef struct {
 	int procId;
 	int numVariables;
+	int freeVariables;
 	int maxVariables;
 	unsigned usedData;
+	unsigned freeData;
 	unsigned maxData;
 	void *memory;
 	unsigned memorySize;
@@ -59,6 +59,7 @@
 #define WINDOW_EVENT_WINDOW_RESIZE			0x00400000
 #define WINDOW_EVENT_WINDOW_CLOSE			0x00200000
 #define WINDOW_EVENT_WINDOW_MINIMIZE		0x00100000
+#define WINDOW_EVENT_LIST_FETCH				0x00040000
 #define WINDOW_EVENT_SELECTION				0x00020000
 #define WINDOW_EVENT_CURSOR_MOVE			0x00010000
 // And these are "tier 1" events, produced by direct input from the user.
@@ -340,7 +341,6 @@ typedef struct _windowFileList {
 	void *fileEntries;
 	int numFileEntries;
 	int browseFlags;
-	int iconThreadPid;
 	spinLock lock;
 	void *data;
 
@@ -413,6 +413,20 @@ typedef struct _windowKeyboard {
 
 } windowKeyboard;
 
+// A window canvas' graphic buffer, mapped for drawing into directly
+typedef struct {
+	objectKey canvas;
+	graphicBuffer buffer;
+	int bitsPerPixel;
+	int bytesPerPixel;
+	int damaged;
+	int damageX1;
+	int damageY1;
+	int damageX2;
+	int damageY2;
+
+} windowCanvasBuffer;
+
 typedef enum {
 	pixedmode_draw, pixedmode_pick, pixedmode_select
 
@@ -423,6 +437,7 @@ typedef struct _windowPixelEditor {
 	int width;
 	int height;
 	graphicBuffer buffer;
+	windowCanvasBuffer canvasBuffer;
 	image *img;
 	int minPixelSize;
 	int maxPixelSize;
@@ -450,6 +465,16 @@ typedef struct _windowPixelEditor {
 } windowPixelEditor;
 
 // Functions exported by libwindow
+int windowCanvasBufferDrawImage(windowCanvasBuffer *, image *, drawMode, int,
+	int);
+int windowCanvasBufferDrawLine(windowCanvasBuffer *, color *, drawMode, int,
+	int, int, int);
+int windowCanvasBufferDrawPixel(windowCanvasBuffer *, color *, drawMode, int,
+	int);
+int windowCanvasBufferDrawRect(windowCanvasBuffer *, color *, drawMode, int,
+	int, int, int, int, int);
+int windowCanvasBufferMap(objectKey, windowCanvasBuffer *);
+int windowCanvasBufferPresent(windowCanvasBuffer *);
 void windowCenterDialog(objectKey, objectKey);
 int windowClearEventHandler(objectKey);
 int windowClearEventHandlers(void);
@@ -489,6 +514,8 @@ objectKey windowNewThumbImage(objectKey, const char *, unsigned, unsigned, int,
 	componentParameters *);
 int windowProgressDialogDestroy(objectKey);
 int windowRegisterEventHandler(objectKey, void (*)(objectKey, windowEvent *));
+int windowRegisterListDataHandler(objectKey, int (*)(objectKey, int,
+	listItemParameters *, int));
 int windowThumbImageUpdate(objectKey, const char *, unsigned, unsigned, int,
 	color *);
 
@@ -25,6 +25,8 @@
 #ifndef _XML_H
 #define _XML_H
 
+#include <stdio.h>
+
 #define XML_TAG_COMMENT_OPEN	"<!--"
 #define XML_TAG_COMMENT_CLOSE	"-->"
 
@@ -69,16 +71,26 @@ typedef struct _xmlElement {
 
 } xmlElement;
 
+// A document.  The elements point into the document text, which is either
+// the caller's buffer (xmlParse()) or a copy owned by the document (when
+// parsing in pieces).  Everything else lives in the document's arena, and
+// is freed all at once by xmlFree().
 typedef struct {
-	xmlTag *tag;
-	int numTags;
 	xmlElement rootElement;
-	xmlElement *element;
+	int numTags;
 	int numElements;
+	char *text;
+	unsigned textLen;
+	void *arena;
+	void *parser;
 
 } xmlDocument;
 
 int xmlParse(xmlDocument *, const char *, unsigned);
+int xmlParseStart(xmlDocument *);
+int xmlParseChunk(xmlDocument *, const char *, unsigned);
+int xmlParseStream(xmlDocument *, FILE *);
+int xmlParseFinish(xmlDocument *);
 void xmlFree(xmlDocument *);
 xmlElement *xmlFindElement(xmlDocument *, const char *[]);
 
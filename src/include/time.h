@@ -24,6 +24,7 @@
 #ifndef _TIME_H
 #define _TIME_H
 
+#define NS_PER_US		1000
 #define US_PER_MS		1000
 #define MS_PER_SEC		1000
 #define SECS_PER_MIN	60
@@ -31,6 +32,9 @@
 #define HRS_PER_DAY		24
 #define DAYS_PER_YEAR	365
 
+#define NS_PER_MS		(NS_PER_US * US_PER_MS)
+#define NS_PER_SEC		(NS_PER_MS * MS_PER_SEC)
+
 #define US_PER_SEC		(US_PER_MS * MS_PER_SEC)
 #define US_PER_MIN		(US_PER_SEC * SECS_PER_MIN)
 #define US_PER_HOUR		(US_PER_MIN * MINS_PER_HR)
@@ -62,8 +66,19 @@ struct tm {
 typedef unsigned clock_t;
 typedef unsigned time_t;
 
+struct timespec {
+	time_t tv_sec;
+	long tv_nsec;
+};
+
+// Clocks for clock_gettime()
+typedef int clockid_t;
+#define CLOCK_REALTIME		0
+#define CLOCK_MONOTONIC		1
+
 char *asctime(const struct tm *);
 clock_t clock(void);
+int clock_gettime(clockid_t, struct timespec *);
 char *ctime(const time_t);
 double difftime(time_t, time_t);
 struct tm *gmtime(time_t);
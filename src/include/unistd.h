@@ -37,7 +37,7 @@ extern int optind, opterr, optopt;
 // Contains the size_t and ssize_t definitions
 #include <stddef.h>
 
-// Contains the off_t definition
+// Contains the off_t and useconds_t definitions
 #include <sys/types.h>
 
 int chdir(const char *);
@@ -52,6 +52,7 @@ unsigned sleep(unsigned);
 void swab(const void *, void *, ssize_t);
 int truncate(const char *, off_t);
 int unlink(const char *);
+int usleep(useconds_t);
 ssize_t write(int, const void *, size_t);
 
 #endif
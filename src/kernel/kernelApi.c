@@ -37,6 +37,7 @@
 #include "kernelImage.h"
 #include "kernelKeyboard.h"
 #include "kernelLoader.h"
+#include "kernelMalloc.h"
 #include "kernelMemory.h"
 #include "kernelMisc.h"
 #include "kernelMultitasker.h"
@@ -49,10 +50,12 @@
 #include "kernelRandom.h"
 #include "kernelRtc.h"
 #include "kernelShutdown.h"
+#include "kernelSmp.h"
 #include "kernelText.h"
 #include "kernelTouch.h"
 #include "kernelUser.h"
 #include "kernelWindow.h"
+#include <string.h>
 #include <sys/apidefs.h>
 #include <sys/processor.h>
 
@@ -613,6 +616,9 @@ static kernelArgInfo args_memoryGetBlocks[] =
 	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
 		{ 1, type_val, API_ARG_ANYVAL },
 		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_memoryCopyToProcess[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_val, API_ARG_POSINTVAL } };
 
 static kernelFunctionIndex memoryFunctionIndex[] = {
 	{ _fnum_memoryGet, kernelMemoryGet,
@@ -624,7 +630,9 @@ static kernelFunctionIndex memoryFunctionIndex[] = {
 	{ _fnum_memoryGetStats, kernelMemoryGetStats,
 		PRIVILEGE_USER, 2, args_memoryGetStats, type_val },
 	{ _fnum_memoryGetBlocks, kernelMemoryGetBlocks,
-		PRIVILEGE_USER, 3, args_memoryGetBlocks, type_val }
+		PRIVILEGE_USER, 3, args_memoryGetBlocks, type_val },
+	{ _fnum_memoryCopyToProcess, kernelMemoryCopyToProcess,
+		PRIVILEGE_USER, 2, args_memoryCopyToProcess, type_ptr }
 };
 
 // Multitasker functions (0x6000-0x6FFF range)
@@ -703,6 +711,23 @@ static kernelArgInfo args_multitaskerSetIoPerm[] =
 		{ 1, type_val, API_ARG_ANYVAL } };
 static kernelArgInfo args_multitaskerStackTrace[] =
 	{ { 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_multitaskerWaitUs[] =
+	{ { 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_multitaskerFutexWait[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_multitaskerFutexWake[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_multitaskerSetProfiling[] =
+	{ { 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_multitaskerGetProcessStats[] =
+	{ { 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
+static kernelArgInfo args_multitaskerGetApiStats[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_val, API_ARG_POSINTVAL } };
 
 static kernelFunctionIndex multitaskerFunctionIndex[] = {
 	{ _fnum_multitaskerCreateProcess, kernelMultitaskerCreateProcess,
@@ -766,7 +791,21 @@ static kernelFunctionIndex multitaskerFunctionIndex[] = {
 	{ _fnum_multitaskerSetIoPerm, kernelMultitaskerSetIoPerm,
 		PRIVILEGE_SUPERVISOR, 3, args_multitaskerSetIoPerm, type_val },
 	{ _fnum_multitaskerStackTrace, kernelMultitaskerStackTrace,
-		PRIVILEGE_USER, 1, args_multitaskerStackTrace, type_val }
+		PRIVILEGE_USER, 1, args_multitaskerStackTrace, type_val },
+	{ _fnum_multitaskerWaitUs, kernelMultitaskerWaitUs,
+		PRIVILEGE_USER, 1, args_multitaskerWaitUs, type_void },
+	{ _fnum_multitaskerFutexWait, kernelMultitaskerFutexWait,
+		PRIVILEGE_USER, 3, args_multitaskerFutexWait, type_val },
+	{ _fnum_multitaskerFutexWake, kernelMultitaskerFutexWake,
+		PRIVILEGE_USER, 2, args_multitaskerFutexWake, type_val },
+	{ _fnum_multitaskerSetProfiling, kernelMultitaskerSetProfiling,
+		PRIVILEGE_SUPERVISOR, 1, args_multitaskerSetProfiling, type_val },
+	{ _fnum_multitaskerGetProfiling, kernelMultitaskerGetProfiling,
+		PRIVILEGE_USER, 0, NULL, type_val },
+	{ _fnum_multitaskerGetProcessStats, kernelMultitaskerGetProcessStats,
+		PRIVILEGE_USER, 2, args_multitaskerGetProcessStats, type_val },
+	{ _fnum_multitaskerGetApiStats, kernelApiGetStats,
+		PRIVILEGE_USER, 2, args_multitaskerGetApiStats, type_val }
 };
 
 // Loader functions (0x7000-0x7FFF range)
@@ -1413,6 +1452,34 @@ static kernelArgInfo args_windowMenuUpdate[] =
 		{ 1, type_ptr, API_ARG_USERPTR } };
 static kernelArgInfo args_windowMenuDestroy[] =
 	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR } };
+static kernelArgInfo args_windowNewVirtualList[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
+static kernelArgInfo args_windowListSetNumItems[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_windowListSetItems[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_windowListScrollTo[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_windowCanvasMapBuffer[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
+static kernelArgInfo args_windowCanvasPresent[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_KERNPTR },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL },
+		{ 1, type_val, API_ARG_ANYVAL } };
 
 static kernelFunctionIndex windowFunctionIndex[] = {
 	{ _fnum_windowLogin, kernelWindowLogin,
@@ -1585,7 +1652,19 @@ static kernelFunctionIndex windowFunctionIndex[] = {
 	{ _fnum_windowMenuUpdate, kernelWindowMenuUpdate,
 		PRIVILEGE_USER, 5, args_windowMenuUpdate, type_val },
 	{ _fnum_windowMenuDestroy, kernelWindowMenuDestroy,
-		PRIVILEGE_USER, 1, args_windowMenuDestroy, type_val }
+		PRIVILEGE_USER, 1, args_windowMenuDestroy, type_val },
+	{ _fnum_windowNewVirtualList, kernelWindowNewVirtualList,
+		PRIVILEGE_USER, 7, args_windowNewVirtualList, type_ptr },
+	{ _fnum_windowListSetNumItems, kernelWindowListSetNumItems,
+		PRIVILEGE_USER, 2, args_windowListSetNumItems, type_val },
+	{ _fnum_windowListSetItems, kernelWindowListSetItems,
+		PRIVILEGE_USER, 4, args_windowListSetItems, type_val },
+	{ _fnum_windowListScrollTo, kernelWindowListScrollTo,
+		PRIVILEGE_USER, 2, args_windowListScrollTo, type_val },
+	{ _fnum_windowCanvasMapBuffer, kernelWindowCanvasMapBuffer,
+		PRIVILEGE_USER, 2, args_windowCanvasMapBuffer, type_val },
+	{ _fnum_windowCanvasPresent, kernelWindowCanvasPresent,
+		PRIVILEGE_USER, 5, args_windowCanvasPresent, type_val }
 };
 
 // User functions (0x10000-0x10FFF range)
@@ -1919,6 +1998,14 @@ static kernelArgInfo args_charsetFromUnicode[] =
 		{ 1, type_val, API_ARG_ANYVAL } };
 static kernelArgInfo args_cpuSpinMs[] =
 	{ { 1, type_val, API_ARG_ANYVAL } };
+static kernelArgInfo args_configGetCacheStats[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
+static kernelArgInfo args_cryptHashSha1File[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
+static kernelArgInfo args_cryptHashSha256File[] =
+	{ { 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR },
+		{ 1, type_ptr, API_ARG_NONNULLPTR | API_ARG_USERPTR } };
 
 static kernelFunctionIndex miscFunctionIndex[] = {
 	{ _fnum_systemShutdown, kernelSystemShutdown,
@@ -1982,7 +2069,17 @@ static kernelFunctionIndex miscFunctionIndex[] = {
 	{ _fnum_cpuSpinMs, kernelCpuSpinMs,
 		PRIVILEGE_USER, 1, args_cpuSpinMs, type_void },
 	{ _fnum_touchAvailable, kernelTouchAvailable,
-		PRIVILEGE_USER, 0, NULL, type_val }
+		PRIVILEGE_USER, 0, NULL, type_val },
+	{ _fnum_cpuGetUs, kernelCpuGetUs,
+		PRIVILEGE_USER, 0, NULL, type_val },
+	{ _fnum_cpuGetCount, kernelSmpCpus,
+		PRIVILEGE_USER, 0, NULL, type_val },
+	{ _fnum_configGetCacheStats, kernelConfigGetCacheStats,
+		PRIVILEGE_USER, 1, args_configGetCacheStats, type_val },
+	{ _fnum_cryptHashSha1File, kernelCryptHashSha1File,
+		PRIVILEGE_USER, 2, args_cryptHashSha1File, type_val },
+	{ _fnum_cryptHashSha256File, kernelCryptHashSha256File,
+		PRIVILEGE_USER, 2, args_cryptHashSha256File, type_val }
 };
 
 static kernelFunctionIndex *functionIndex[] = {
@@ -2007,6 +2104,35 @@ static kernelFunctionIndex *functionIndex[] = {
 	ipcFunctionIndex
 };
 
+#define NUM_INDEXES (sizeof(functionIndex) / sizeof(kernelFunctionIndex *))
+#define INDEX_SIZE(index) (sizeof(index) / sizeof(kernelFunctionIndex))
+
+static int functionIndexSize[] = {
+	INDEX_SIZE(miscFunctionIndex),
+	INDEX_SIZE(textFunctionIndex),
+	INDEX_SIZE(diskFunctionIndex),
+	INDEX_SIZE(filesystemFunctionIndex),
+	INDEX_SIZE(fileFunctionIndex),
+	INDEX_SIZE(memoryFunctionIndex),
+	INDEX_SIZE(multitaskerFunctionIndex),
+	INDEX_SIZE(loaderFunctionIndex),
+	INDEX_SIZE(rtcFunctionIndex),
+	INDEX_SIZE(randomFunctionIndex),
+	INDEX_SIZE(variableListFunctionIndex),
+	INDEX_SIZE(environmentFunctionIndex),
+	INDEX_SIZE(graphicFunctionIndex),
+	INDEX_SIZE(imageFunctionIndex),
+	INDEX_SIZE(fontFunctionIndex),
+	INDEX_SIZE(windowFunctionIndex),
+	INDEX_SIZE(userFunctionIndex),
+	INDEX_SIZE(networkFunctionIndex),
+	INDEX_SIZE(ipcFunctionIndex)
+};
+
+// Call statistics for each function, allocated when profiling is first
+// turned on
+static apiCallStats *functionStats[NUM_INDEXES];
+
 
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
@@ -2033,12 +2159,19 @@ void kernelApi(unsigned CS __attribute__((unused)), unsigned *args)
 	int currentProc = 0;
 	int currentPriv = 0;
 	quad_t (*functionPointer)() = NULL;
+	kernelProcess *proc = NULL;
+	apiCallStats *stats = NULL;
+	uquad_t startTime = 0;
 	int pushCount = 0;
 	int count;
 	#if defined(DEBUG)
 	const char *symbolName = NULL;
 	#endif // defined(DEBUG)
 
+	// The kernel only runs on the boot processor.  If we were called on
+	// another one, this moves us.
+	kernelMultitaskerEnterKernel();
+
 	// Check args
 	if (!args)
 	{
@@ -2210,9 +2343,32 @@ void kernelApi(unsigned CS __attribute__((unused)), unsigned *args)
 	for (count = (pushCount - 1); count >= 0; count --)
 		processorPush(functionArgs[count]);
 
+	// Count the call, and time it if we're profiling
+	proc = kernelCurrentProcess;
+	proc->stats.apiCalls += 1;
+	if (kernelMultitaskerGetProfiling() && functionStats[0])
+	{
+		if ((functionNumber >> 12) == 0xFF)
+			stats = functionStats[0];
+		else
+			stats = functionStats[functionNumber >> 12];
+
+		stats += (functionNumber & 0xFFF);
+
+		startTime = kernelCpuGetUs();
+	}
+
 	// Call the function
 	status = functionPointer();
 
+	if (stats)
+	{
+		startTime = (kernelCpuGetUs() - startTime);
+		proc->stats.apiTime += startTime;
+		stats->calls += 1;
+		stats->time += startTime;
+	}
+
 	statusLo = (status & 0xFFFFFFFF);
 	statusHi = (status >> 32);
 
@@ -2221,6 +2377,84 @@ out:
 	kernelDebug(debug_api, "ret=%lld", status);
 	#endif
 
+	kernelMultitaskerLeaveKernel();
+
 	processorApiExit(stackAddress, statusLo, statusHi);
 }
 
+
+int kernelApiClearStats(void)
+{
+	// Reset the call statistics of all the API functions, allocating the
+	// memory for them the first time
+
+	int status = 0;
+	int numFunctions = 0;
+	apiCallStats *stats = NULL;
+	int count1, count2;
+
+	if (!functionStats[0])
+	{
+		for (count1 = 0; count1 < (int) NUM_INDEXES; count1 ++)
+			numFunctions += functionIndexSize[count1];
+
+		stats = kernelMalloc(numFunctions * sizeof(apiCallStats));
+		if (!stats)
+			return (status = ERR_MEMORY);
+
+		for (count1 = 0; count1 < (int) NUM_INDEXES; count1 ++)
+		{
+			functionStats[count1] = stats;
+			stats += functionIndexSize[count1];
+		}
+	}
+
+	for (count1 = 0; count1 < (int) NUM_INDEXES; count1 ++)
+	{
+		for (count2 = 0; count2 < functionIndexSize[count1]; count2 ++)
+		{
+			functionStats[count1][count2].functionNumber =
+				functionIndex[count1][count2].functionNumber;
+			functionStats[count1][count2].calls = 0;
+			functionStats[count1][count2].time = 0;
+		}
+	}
+
+	return (status = 0);
+}
+
+
+int kernelApiGetStats(apiCallStats *stats, int maxStats)
+{
+	// Fill in the call statistics of up to 'maxStats' API functions that have
+	// been called while profiling, and return the number filled in
+
+	int numStats = 0;
+	int count1, count2;
+
+	// Check params
+	if (!stats)
+		return (numStats = ERR_NULLPARAMETER);
+
+	if (!functionStats[0])
+		return (numStats = 0);
+
+	for (count1 = 0; count1 < (int) NUM_INDEXES; count1 ++)
+	{
+		for (count2 = 0; count2 < functionIndexSize[count1]; count2 ++)
+		{
+			if (!functionStats[count1][count2].calls)
+				continue;
+
+			if (numStats >= maxStats)
+				return (numStats);
+
+			memcpy(&stats[numStats], &functionStats[count1][count2],
+				sizeof(apiCallStats));
+			numStats += 1;
+		}
+	}
+
+	return (numStats);
+}
+
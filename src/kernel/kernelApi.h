@@ -22,6 +22,8 @@
 #ifndef _KERNELAPI_H
 #define _KERNELAPI_H
 
+#include <sys/process.h>
+
 // Pointer argument types
 #define API_ARG_NONNULLPTR	0x04
 #define API_ARG_USERPTR		0x02
@@ -57,6 +59,8 @@ typedef struct {
 
 // Functions exported from kernelApi.c
 void kernelApi(unsigned, unsigned *);
+int kernelApiClearStats(void);
+int kernelApiGetStats(apiCallStats *, int);
 
 #endif
 
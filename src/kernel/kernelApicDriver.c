@@ -25,16 +25,20 @@
 #include "kernelApicDriver.h"
 #include "kernelCpu.h"
 #include "kernelDebug.h"
+#include "kernelDescriptor.h"
 #include "kernelDevice.h"
 #include "kernelError.h"
 #include "kernelInterrupt.h"
+#include "kernelLog.h"
 #include "kernelMalloc.h"
 #include "kernelPage.h"
 #include "kernelParameters.h"
 #include "kernelPic.h"
 #include "kernelSystemDriver.h"
+#include "kernelTimer.h"
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/multiproc.h>
 #include <sys/processor.h>
 
@@ -47,6 +51,16 @@
 
 static volatile void *localApicRegs = NULL;
 
+// For using the local APIC timer as the clock event device
+static struct {
+	int tscDeadline;
+	uquad_t tscPerUs;
+	uquad_t freq;
+
+} apicTimer;
+
+static kernelClockEvent apicClockEvent;
+
 
 static int calcVector(int intNumber)
 {
@@ -676,6 +690,179 @@ static inline void debugLocalRegs(void)
 #endif
 
 
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+//  Local APIC timer clock event functions
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+static void timerInterrupt(void)
+{
+	// This is the local APIC timer interrupt handler
+
+	void *address = NULL;
+
+	processorIsrEnter(address);
+
+	writeLocalReg(APIC_LOCALREG_EOI, 0);
+	kernelTimerEvent();
+
+	processorIsrExit(address);
+}
+
+
+static int timerStart(void)
+{
+	// Calibrate the local APIC timer against the CPU timestamp counter, and
+	// hook its interrupt
+
+	int status = 0;
+	int interrupts = 0;
+	uquad_t tscFreq = 0;
+	uquad_t startTsc = 0;
+	uquad_t endTsc = 0;
+	unsigned counted = 0;
+	uquad_t maxDelay = 0;
+
+	tscFreq = kernelCpuTimestampFreq();
+	if (!tscFreq)
+		return (status = ERR_NOTINITIALIZED);
+
+	apicTimer.tscPerUs = (tscFreq / US_PER_SEC);
+
+	processorSuspendInts(interrupts);
+
+	// Let the (masked) timer count down from the maximum for 10ms of
+	// timestamp counter time
+	writeLocalReg(APIC_LOCALREG_TIMERDIV, APIC_TIMER_DIVIDE16);
+	writeLocalReg(APIC_LOCALREG_LVT_TIMER, (APIC_LVT_MASKED |
+		APIC_TIMER_VECTOR));
+	writeLocalReg(APIC_LOCALREG_TIMERINIT, 0xFFFFFFFF);
+
+	startTsc = kernelCpuTimestamp();
+	do {
+		endTsc = kernelCpuTimestamp();
+	} while ((endTsc - startTsc) < (tscFreq / 100));
+
+	counted = (0xFFFFFFFF - readLocalReg(APIC_LOCALREG_TIMERCURR));
+	writeLocalReg(APIC_LOCALREG_TIMERINIT, 0);
+
+	processorRestoreInts(interrupts);
+
+	if (!counted)
+	{
+		kernelError(kernel_error, "Local APIC timer is not counting");
+		return (status = ERR_NOTINITIALIZED);
+	}
+
+	apicTimer.freq = (((uquad_t) counted * tscFreq) / (endTsc - startTsc));
+
+	kernelLog("Local APIC timer frequency is %llu KHz%s", (apicTimer.freq /
+		1000), (apicTimer.tscDeadline? " (TSC deadline)" : ""));
+
+	if (apicTimer.tscDeadline)
+	{
+		maxDelay = TIMER_MAX_IDLE_US;
+	}
+	else
+	{
+		maxDelay = ((0xFFFFFFFFULL * US_PER_SEC) / apicTimer.freq);
+		if (maxDelay > TIMER_MAX_IDLE_US)
+			maxDelay = TIMER_MAX_IDLE_US;
+	}
+
+	apicClockEvent.maxDelay = (unsigned) maxDelay;
+
+	status = kernelDescriptorSetIDTInterruptGate(APIC_TIMER_VECTOR,
+		&timerInterrupt);
+	if (status < 0)
+		return (status);
+
+	// Unmask it, in one-shot or TSC-deadline mode
+	writeLocalReg(APIC_LOCALREG_LVT_TIMER, ((apicTimer.tscDeadline?
+		APIC_LVT_TIMER_TSCDEADLINE : 0) | APIC_TIMER_VECTOR));
+
+	return (status = 0);
+}
+
+
+static int timerSetNext(uquad_t deadline, unsigned delay)
+{
+	// Program the next interrupt
+
+	uquad_t count = 0;
+
+	if (apicTimer.tscDeadline)
+	{
+		// Timestamp counter values and kernelCpuGetUs() values have the same
+		// ratio
+		count = (deadline * apicTimer.tscPerUs);
+		processorWriteMsr(X86_MSR_TSCDEADLINE, (unsigned) count,
+			(unsigned)(count >> 32));
+	}
+	else
+	{
+		count = (((uquad_t) delay * apicTimer.freq) / US_PER_SEC);
+		if (!count)
+			count = 1;
+		if (count > 0xFFFFFFFF)
+			count = 0xFFFFFFFF;
+
+		writeLocalReg(APIC_LOCALREG_TIMERINIT, (unsigned) count);
+	}
+
+	return (0);
+}
+
+
+static int timerStop(void)
+{
+	if (apicTimer.tscDeadline)
+		processorWriteMsr(X86_MSR_TSCDEADLINE, 0, 0);
+
+	writeLocalReg(APIC_LOCALREG_TIMERINIT, 0);
+	writeLocalReg(APIC_LOCALREG_LVT_TIMER, (APIC_LVT_MASKED |
+		APIC_TIMER_VECTOR));
+
+	return (0);
+}
+
+
+static kernelClockEvent apicClockEvent = {
+	"local APIC",
+	2,		// minDelay
+	0,		// maxDelay, calculated in timerStart()
+	timerStart,
+	timerSetNext,
+	timerStop
+};
+
+
+static void registerTimer(void)
+{
+	// The local APIC timer can replace the PIT for our clock events.  If the
+	// CPU supports it, it can be given absolute deadlines in terms of the
+	// timestamp counter, which saves us converting.
+
+#ifdef ARCH_X86
+	x86CpuFeatures cpuFeatures;
+
+	memset(&cpuFeatures, 0, sizeof(x86CpuFeatures));
+	kernelCpuGetFeatures(&cpuFeatures, sizeof(x86CpuFeatures));
+
+	memset(&apicTimer, 0, sizeof(apicTimer));
+	apicTimer.tscDeadline = ((cpuFeatures.cpuid1Ecx >> 24) & 1);
+
+	kernelDebug(debug_io, "APIC timer %s TSC deadline mode",
+		(apicTimer.tscDeadline? "supports" : "does not support"));
+
+	kernelTimerRegisterClockEvent(&apicClockEvent);
+#endif
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -1107,6 +1294,11 @@ static int driverDetect(void *parent, kernelDriver *driver)
 			break;
 	}
 
+	// If the APICs are taking the interrupts, use the local APIC timer for
+	// clock events
+	if ((status >= 0) && haveTimerIrq)
+		registerTimer();
+
 out:
 	if (status < 0)
 	{
@@ -1151,6 +1343,117 @@ void kernelApicDriverRegister(kernelDriver *driver)
 }
 
 
+int kernelApicGetId(void)
+{
+	// Returns the local APIC ID of the processor we're running on
+
+	if (!localApicRegs)
+		return (ERR_NOTINITIALIZED);
+
+	return (readLocalReg(APIC_LOCALREG_APICID) >> 24);
+}
+
+
+int kernelApicTimerRunning(void)
+{
+	// Returns 1 if the local APIC timer is being used for clock events
+
+	return (apicTimer.freq != 0);
+}
+
+
+int kernelApicStartCpu(void)
+{
+	// Called by an application processor when it starts up, to enable its
+	// own local APIC, and set up its timer the same way as the boot
+	// processor's.  Interrupts should be disabled.
+
+	int status = 0;
+#ifdef ARCH_X86
+	unsigned rega = 0, regd = 0;
+#endif
+
+	if (!localApicRegs || !apicTimer.freq)
+		return (status = ERR_NOTINITIALIZED);
+
+#ifdef ARCH_X86
+	// Set the enable bit in the APIC base MSR.  The registers are at the
+	// same address as the boot processor's.
+	processorReadMsr(X86_MSR_APICBASE, rega, regd);
+	rega |= X86_MSR_APICBASE_APICENABLE;
+	processorWriteMsr(X86_MSR_APICBASE, rega, regd);
+#endif
+
+	// Accept all interrupts, but mask all of the local ones.  Only the boot
+	// processor gets external interrupts.
+	writeLocalReg(APIC_LOCALREG_TASKPRI, 0);
+	writeLocalReg(APIC_LOCALREG_LVT_TIMER, APIC_LVT_MASKED);
+	writeLocalReg(APIC_LOCALREG_LVT_PERFCNT, APIC_LVT_MASKED);
+	writeLocalReg(APIC_LOCALREG_LVT_LINT0, APIC_LVT_MASKED);
+	writeLocalReg(APIC_LOCALREG_LVT_LINT1, APIC_LVT_MASKED);
+	writeLocalReg(APIC_LOCALREG_LVT_ERROR, APIC_LVT_MASKED);
+
+	// Enable it, with the same spurious interrupt vector
+	writeLocalReg(APIC_LOCALREG_SPURINT,
+		(readLocalReg(APIC_LOCALREG_SPURINT) | 0x000001FF));
+
+	// The timer was calibrated on the boot processor
+	writeLocalReg(APIC_LOCALREG_TIMERDIV, APIC_TIMER_DIVIDE16);
+	writeLocalReg(APIC_LOCALREG_TIMERINIT, 0);
+	writeLocalReg(APIC_LOCALREG_LVT_TIMER, ((apicTimer.tscDeadline?
+		APIC_LVT_TIMER_TSCDEADLINE : 0) | APIC_TIMER_VECTOR));
+
+	return (status = 0);
+}
+
+
+int kernelApicSendIpi(int apicId, unsigned command)
+{
+	// Send an inter-processor interrupt.  If the APIC ID is negative, the
+	// destination shorthand bits in the command say where it goes.
+
+	int status = 0;
+	int interrupts = 0;
+	uquad_t timeout = 0;
+
+	if (!localApicRegs)
+		return (status = ERR_NOTINITIALIZED);
+
+	processorSuspendInts(interrupts);
+
+	if (apicId >= 0)
+		writeLocalReg(APIC_LOCALREG_INTCMDHI, ((unsigned) apicId << 24));
+
+	// Writing the low word sends it
+	writeLocalReg(APIC_LOCALREG_INTCMDLO, command);
+
+	// Wait for it to be accepted
+	timeout = (kernelCpuGetUs() + 1000);
+	while (readLocalReg(APIC_LOCALREG_INTCMDLO) & APIC_IPI_PENDING)
+	{
+		if (kernelCpuGetUs() > timeout)
+		{
+			status = ERR_TIMEOUT;
+			break;
+		}
+
+		processorPause();
+	}
+
+	processorRestoreInts(interrupts);
+
+	return (status);
+}
+
+
+void kernelApicEndOfInterrupt(void)
+{
+	// For the handlers of local interrupts, such as inter-processor ones
+
+	writeLocalReg(APIC_LOCALREG_EOI, 0);
+}
+
+
 #ifdef DEBUG
 void kernelApicDebug(void)
 {
@@ -50,12 +50,35 @@
 #define APIC_LOCALREG_TIMERDIV		0x3E0
 // *support depends on processor version
 
+// Local vector table bits
+#define APIC_LVT_MASKED				(1 << 16)
+#define APIC_LVT_TIMER_TSCDEADLINE	(2 << 17)
+
+// The local APIC timer, when it's used for clock events
+#define APIC_TIMER_VECTOR			0xEF
+#define APIC_TIMER_DIVIDE16			0x03
+
+// Interrupt command register bits, for inter-processor interrupts (IPIs)
+#define APIC_IPI_FIXED				(0 << 8)
+#define APIC_IPI_INIT				(5 << 8)
+#define APIC_IPI_STARTUP			(6 << 8)
+#define APIC_IPI_PENDING			(1 << 12)
+#define APIC_IPI_ASSERT				(1 << 14)
+#define APIC_IPI_LEVEL				(1 << 15)
+#define APIC_IPI_ALLBUTSELF			(3 << 18)
+
 typedef struct {
 	unsigned char id;
 	volatile unsigned *regs;
 
 } kernelIoApic;
 
+// Functions exported by kernelApicDriver.c
+int kernelApicGetId(void);
+int kernelApicTimerRunning(void);
+int kernelApicStartCpu(void);
+int kernelApicSendIpi(int, unsigned);
+void kernelApicEndOfInterrupt(void);
 void kernelApicDebug(void);
 
 #endif
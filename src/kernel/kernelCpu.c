@@ -366,6 +366,18 @@ uquad_t kernelCpuGetMs(void)
 }
 
 
+uquad_t kernelCpuGetUs(void)
+{
+	// Returns a value representing the current CPU timestamp in microseconds
+
+	// Make sure the timestamp frequency has been determined
+	if (!timestampFreq)
+		kernelCpuTimestampFreq();
+
+	return (kernelCpuTimestamp() / (timestampFreq / US_PER_SEC));
+}
+
+
 void kernelCpuSpinMs(unsigned millisecs)
 {
 	// This will use the CPU timestamp counter to spin for (at least) the
@@ -28,6 +28,7 @@ void kernelCpuGetFeatures(void *, unsigned);
 uquad_t kernelCpuTimestampFreq(void);
 uquad_t kernelCpuTimestamp(void);
 uquad_t kernelCpuGetMs(void);
+uquad_t kernelCpuGetUs(void);
 void kernelCpuSpinMs(unsigned);
 
 #endif
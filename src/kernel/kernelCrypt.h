@@ -26,6 +26,8 @@
 
 #include <sys/crypt.h>
 
+int kernelCryptHashSha1File(const char *, unsigned char *);
+int kernelCryptHashSha256File(const char *, unsigned char *);
 int kernelCryptHashMd5(const unsigned char *, unsigned, unsigned char *);
 int kernelCryptHashSha1(const unsigned char *, unsigned, unsigned char *,
 	int, unsigned);
@@ -0,0 +1,160 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelCryptHashFile.c
+//
+
+// This file contains functions for hashing the contents of files inside the
+// kernel, so that the data doesn't have to be copied out to the caller, and
+// the caller doesn't have to make a system call for each piece of it.
+
+#include "kernelCrypt.h"
+#include "kernelError.h"
+#include "kernelFile.h"
+#include "kernelMalloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+
+// Read in chunks of about this size.  The hashing functions need every
+// chunk but the last to be a multiple of 64 bytes.
+#define HASHFILE_BUFFERSIZE		262144
+
+typedef int (*hashFunction)(const unsigned char *, unsigned, unsigned char *,
+	int, unsigned);
+
+
+static int hashFile(const char *fileName, unsigned char *output,
+	hashFunction hashStart, hashFunction hashCont)
+{
+	int status = 0;
+	file theFile;
+	unsigned char *buffer = NULL;
+	unsigned bufferBlocks = 0;
+	unsigned block = 0;
+	unsigned readBlocks = 0;
+	unsigned doBytes = 0;
+	unsigned doneBytes = 0;
+
+	// Check params
+	if (!fileName || !output)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	memset(&theFile, 0, sizeof(file));
+
+	status = kernelFileOpen(fileName, OPENMODE_READ, &theFile);
+	if (status < 0)
+		return (status);
+
+	if (!theFile.blockSize || (theFile.blockSize % 64))
+	{
+		kernelError(kernel_error, "File %s has unsupported block size %u",
+			fileName, theFile.blockSize);
+		status = ERR_RANGE;
+		goto out;
+	}
+
+	// Get a buffer of whole blocks, at least one block long
+	bufferBlocks = max((HASHFILE_BUFFERSIZE / theFile.blockSize), 1);
+
+	buffer = kernelMalloc(bufferBlocks * theFile.blockSize);
+	if (!buffer)
+	{
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	do
+	{
+		doBytes = min((bufferBlocks * theFile.blockSize),
+			(theFile.size - doneBytes));
+
+		if (doBytes)
+		{
+			readBlocks = (((doBytes - 1) / theFile.blockSize) + 1);
+
+			status = kernelFileRead(&theFile, block, readBlocks, buffer);
+			if (status < 0)
+				goto out;
+
+			block += readBlocks;
+		}
+
+		doneBytes += doBytes;
+
+		// Hash.  If nothing was hashed before this chunk, start the hash.
+		if (doneBytes == doBytes)
+		{
+			status = hashStart(buffer, doBytes, output,
+				(doneBytes >= theFile.size) /* finalize? */, theFile.size);
+		}
+		else
+		{
+			status = hashCont(buffer, doBytes, output,
+				(doneBytes >= theFile.size) /* finalize? */, theFile.size);
+		}
+
+		if (status < 0)
+			goto out;
+
+	} while (doneBytes < theFile.size);
+
+	status = 0;
+
+out:
+	if (buffer)
+	{
+		// Scrub
+		memset(buffer, 0, (bufferBlocks * theFile.blockSize));
+		kernelFree(buffer);
+	}
+
+	kernelFileClose(&theFile);
+
+	return (status);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+//  Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int kernelCryptHashSha1File(const char *fileName, unsigned char *output)
+{
+	// Read the file and return its SHA1 digest in 'output'
+
+	return (hashFile(fileName, output, &kernelCryptHashSha1,
+		&kernelCryptHashSha1Cont));
+}
+
+
+int kernelCryptHashSha256File(const char *fileName, unsigned char *output)
+{
+	// Read the file and return its SHA256 digest in 'output'
+
+	return (hashFile(fileName, output, &kernelCryptHashSha256,
+		&kernelCryptHashSha256Cont));
+}
+
@@ -40,60 +40,78 @@ static inline unsigned rol(unsigned x, unsigned n)
 	return ((x << n) | (x >> (32 - n)));
 }
 
+#define K1				0x5A827999
+#define K2				0x6ED9EBA1
+#define K3				0x8F1BBCDC
+#define K4				0xCA62C1D6
+#define F1(x, y, z)		((z) ^ ((x) & ((y) ^ (z))))
+#define F2(x, y, z)		((x) ^ (y) ^ (z))
+#define F3(x, y, z)		(((x) & (y)) | ((z) & ((x) | (y))))
+
+// The message schedule is kept as a rolling window of 16 dwords
+#define W(n) \
+	(w[(n) & 15] = rol((w[((n) - 3) & 15] ^ w[((n) - 8) & 15] ^ \
+		w[((n) - 14) & 15] ^ w[(n) & 15]), 1))
+#define WORD(n)			(((n) < 16)? w[n] : W(n))
+
+// One round.  Rather than shuffling all of the working variables along, the
+// callers rotate the arguments.
+#define ROUND(a, b, c, d, e, f, k, wn) do { \
+	(e) += (rol((a), 5) + f((b), (c), (d)) + (k) + (wn)); \
+	(b) = rol((b), 30); \
+} while (0)
+
 
 static void hashChunk(const unsigned char *buffer, unsigned *hash)
 {
 	// Hash one 512-bit chunk
 
-	unsigned w[80];
+	unsigned w[16];
 	unsigned a = hash[0];
 	unsigned b = hash[1];
 	unsigned c = hash[2];
 	unsigned d = hash[3];
 	unsigned e = hash[4];
-	unsigned f, k, tmp;
 	int count;
 
 	// Break the chunk into 16 32-bit big-endian dwords in the work area
 	for (count = 0; count < 16; count ++)
 		w[count] = processorSwap32(((unsigned *) buffer)[count]);
 
-	// Extend the 16 values into 80
-	for (count = 16; count < 80; count ++)
+	for (count = 0; count < 20; count += 5)
 	{
-		w[count] = rol((w[count - 3] ^ w[count - 8] ^ w[count - 14] ^
-			w[count - 16]), 1);
+		ROUND(a, b, c, d, e, F1, K1, WORD(count));
+		ROUND(e, a, b, c, d, F1, K1, WORD(count + 1));
+		ROUND(d, e, a, b, c, F1, K1, WORD(count + 2));
+		ROUND(c, d, e, a, b, F1, K1, WORD(count + 3));
+		ROUND(b, c, d, e, a, F1, K1, WORD(count + 4));
 	}
 
-	for (count = 0; count < 80; count ++)
+	for ( ; count < 40; count += 5)
 	{
-		if (count < 20)
-		{
-			f = ((b & c) | (~b & d));
-			k = 0x5A827999;
-		}
-		else if (count < 40)
-		{
-			f = (b ^ c ^ d);
-			k = 0x6ED9EBA1;
-		}
-		else if (count < 60)
-		{
-			f = ((b & c) | (b & d) | (c & d));
-			k = 0x8F1BBCDC;
-		}
-		else
-		{
-			f = (b ^ c ^ d);
-			k = 0xCA62C1D6;
-		}
+		ROUND(a, b, c, d, e, F2, K2, W(count));
+		ROUND(e, a, b, c, d, F2, K2, W(count + 1));
+		ROUND(d, e, a, b, c, F2, K2, W(count + 2));
+		ROUND(c, d, e, a, b, F2, K2, W(count + 3));
+		ROUND(b, c, d, e, a, F2, K2, W(count + 4));
+	}
 
-		tmp = (rol(a, 5) + f + e + k + w[count]);
-		e = d;
-		d = c;
-		c = rol(b, 30);
-		b = a;
-		a = tmp;
+	for ( ; count < 60; count += 5)
+	{
+		ROUND(a, b, c, d, e, F3, K3, W(count));
+		ROUND(e, a, b, c, d, F3, K3, W(count + 1));
+		ROUND(d, e, a, b, c, F3, K3, W(count + 2));
+		ROUND(c, d, e, a, b, F3, K3, W(count + 3));
+		ROUND(b, c, d, e, a, F3, K3, W(count + 4));
+	}
+
+	for ( ; count < 80; count += 5)
+	{
+		ROUND(a, b, c, d, e, F2, K4, W(count));
+		ROUND(e, a, b, c, d, F2, K4, W(count + 1));
+		ROUND(d, e, a, b, c, F2, K4, W(count + 2));
+		ROUND(c, d, e, a, b, F2, K4, W(count + 3));
+		ROUND(b, c, d, e, a, F2, K4, W(count + 4));
 	}
 
 	// Add this chunk's hash to the result
@@ -62,12 +62,32 @@ static inline unsigned ror(unsigned x, unsigned n)
 	return ((x << (32 - n)) | (x >> n));
 }
 
+#define BSIG0(x)		(ror((x), 2) ^ ror((x), 13) ^ ror((x), 22))
+#define BSIG1(x)		(ror((x), 6) ^ ror((x), 11) ^ ror((x), 25))
+#define SSIG0(x)		(ror((x), 7) ^ ror((x), 18) ^ ((x) >> 3))
+#define SSIG1(x)		(ror((x), 17) ^ ror((x), 19) ^ ((x) >> 10))
+#define CH(x, y, z)		((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+// The message schedule is kept as a rolling window of 16 dwords
+#define W(n) \
+	(w[(n) & 15] += (SSIG1(w[((n) - 2) & 15]) + w[((n) - 7) & 15] + \
+		SSIG0(w[((n) - 15) & 15])))
+
+// One round.  Rather than shuffling all of the working variables along, the
+// callers rotate the arguments.
+#define ROUND(a, b, c, d, e, f, g, h, n, wn) do { \
+	tmp = ((h) + BSIG1(e) + CH((e), (f), (g)) + k[n] + (wn)); \
+	(d) += tmp; \
+	(h) = (tmp + BSIG0(a) + MAJ((a), (b), (c))); \
+} while (0)
+
 
 static void hashChunk(const unsigned char *buffer, unsigned *hash)
 {
 	// Hash one 512-bit chunk
 
-	unsigned w[64];
+	unsigned w[16];
 	unsigned a = hash[0];
 	unsigned b = hash[1];
 	unsigned c = hash[2];
@@ -76,42 +96,37 @@ static void hashChunk(const unsigned char *buffer, unsigned *hash)
 	unsigned f = hash[5];
 	unsigned g = hash[6];
 	unsigned h = hash[7];
-	unsigned s0, s1;
-	unsigned ch, maj;
-	unsigned tmp1, tmp2;
+	unsigned tmp;
 	int count;
 
 	// Break the chunk into 16 32-bit big-endian dwords in the work area
 	for (count = 0; count < 16; count ++)
 		w[count] = processorSwap32(((unsigned *) buffer)[count]);
 
-	// Extend the 16 values into 64
-	for (count = 16; count < 64; count ++)
+	// The first 16 rounds use the message dwords as they are
+	for (count = 0; count < 16; count += 8)
 	{
-		s0 = (ror(w[count - 15], 7) ^ ror(w[count - 15], 18) ^
-			(w[count - 15] >> 3));
-		s1 = (ror(w[count - 2], 17) ^ ror(w[count - 2], 19) ^
-			(w[count - 2] >> 10));
-        w[count] = (w[count - 16] + s0 + w[count - 7] + s1);
+		ROUND(a, b, c, d, e, f, g, h, count, w[count]);
+		ROUND(h, a, b, c, d, e, f, g, (count + 1), w[count + 1]);
+		ROUND(g, h, a, b, c, d, e, f, (count + 2), w[count + 2]);
+		ROUND(f, g, h, a, b, c, d, e, (count + 3), w[count + 3]);
+		ROUND(e, f, g, h, a, b, c, d, (count + 4), w[count + 4]);
+		ROUND(d, e, f, g, h, a, b, c, (count + 5), w[count + 5]);
+		ROUND(c, d, e, f, g, h, a, b, (count + 6), w[count + 6]);
+		ROUND(b, c, d, e, f, g, h, a, (count + 7), w[count + 7]);
 	}
 
-	for (count = 0; count < 64; count ++)
+	// The rest extend the schedule as they go
+	for ( ; count < 64; count += 8)
 	{
-		s1 = (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25));
-        ch = ((e & f) ^ (~e & g));
-        tmp1 = (h + s1 + ch + k[count] + w[count]);
-        s0 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22));
-        maj = ((a & b) ^ (a & c) ^ (b & c));
-		tmp2 = (s0 + maj);
-
-		h = g;
-        g = f;
-        f = e;
-        e = (d + tmp1);
-        d = c;
-        c = b;
-        b = a;
-        a = (tmp1 + tmp2);
+		ROUND(a, b, c, d, e, f, g, h, count, W(count));
+		ROUND(h, a, b, c, d, e, f, g, (count + 1), W(count + 1));
+		ROUND(g, h, a, b, c, d, e, f, (count + 2), W(count + 2));
+		ROUND(f, g, h, a, b, c, d, e, (count + 3), W(count + 3));
+		ROUND(e, f, g, h, a, b, c, d, (count + 4), W(count + 4));
+		ROUND(d, e, f, g, h, a, b, c, (count + 5), W(count + 5));
+		ROUND(c, d, e, f, g, h, a, b, (count + 6), W(count + 6));
+		ROUND(b, c, d, e, f, g, h, a, (count + 7), W(count + 7));
 	}
 
 	// Add this chunk's hash to the result
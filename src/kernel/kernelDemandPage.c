@@ -0,0 +1,646 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelDemandPage.c
+//
+
+// This file keeps track of memory whose contents come from a file, and which
+// is only read in one page at a time, when the page is first touched.  The
+// memory itself is allocated in the normal way, but its pages are marked not
+// present until they've been filled from the file by the page fault handler.
+// Regions are recorded by physical address, since the same memory can be
+// mapped into more than one process (such as a new program's image, which is
+// laid out by the loader before it belongs to the new process).  The file is
+// pinned for as long as any region refers to it, so that it can't change
+// underneath the programs using it.
+
+#include "kernelDemandPage.h"
+#include "kernelDebug.h"
+#include "kernelError.h"
+#include "kernelFile.h"
+#include "kernelLock.h"
+#include "kernelMalloc.h"
+#include "kernelMultitasker.h"
+#include "kernelPage.h"
+#include "kernelParameters.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _demandRegion {
+	unsigned id;
+	int processId;
+	unsigned physical;
+	unsigned size;
+	file theFile;
+	unsigned fileOffset;
+	unsigned numPages;
+	unsigned filledPages;
+	unsigned char *filled;
+	struct _demandRegion *next;
+
+} demandRegion;
+
+static demandRegion *regionList = NULL;
+static unsigned regionIds = 0;
+static spinLock regionLock;
+
+
+static inline int overlaps(demandRegion *region, unsigned physical,
+	unsigned size)
+{
+	return ((physical < (region->physical + region->size)) &&
+		((physical + size) > region->physical));
+}
+
+
+static inline int pageIndex(demandRegion *region, unsigned physicalPage)
+{
+	return ((physicalPage - kernelPageRoundDown(region->physical)) /
+		MEMORY_PAGE_SIZE);
+}
+
+
+static inline int isFilled(demandRegion *region, unsigned physicalPage)
+{
+	int index = pageIndex(region, physicalPage);
+	return ((region->filled[index / 8] >> (index % 8)) & 1);
+}
+
+
+static demandRegion *newRegion(int processId, unsigned physical,
+	unsigned size, file *theFile, unsigned fileOffset)
+{
+	demandRegion *region = NULL;
+	unsigned numPages = 0;
+
+	numPages = ((kernelPageRoundUp(physical + size) -
+		kernelPageRoundDown(physical)) / MEMORY_PAGE_SIZE);
+
+	// Get memory for the region and its bitmap of filled pages together
+	region = kernelMalloc(sizeof(demandRegion) + ((numPages + 7) / 8));
+	if (!region)
+		return (region);
+
+	region->processId = processId;
+	region->physical = physical;
+	region->size = size;
+	memcpy(&region->theFile, theFile, sizeof(file));
+	region->fileOffset = fileOffset;
+	region->numPages = numPages;
+	region->filled = ((void *) region + sizeof(demandRegion));
+
+	return (region);
+}
+
+
+static unsigned getPhysical(void *virtual)
+{
+	// Kernel memory is only in the kernel's page directory
+
+	if (virtual >= (void *) KERNEL_VIRTUAL_ADDRESS)
+		return (kernelPageGetPhysical(KERNELPROCID, virtual));
+	else
+		return (kernelPageGetPhysical(kernelCurrentProcess->processId,
+			virtual));
+}
+
+
+static int readPage(demandRegion *region, unsigned physicalPage,
+	file *theFile, unsigned *pageOffset, unsigned *bytes, void **data,
+	void **buffer)
+{
+	// Read the part of the region that falls within the page from the file.
+	// The file can only be read in whole blocks, so this returns the buffer,
+	// and where the data for the page is in it.  The region list must not be
+	// locked, and 'region' is only used for its offsets, so it should be a
+	// copy.
+
+	int status = 0;
+	unsigned start = 0, end = 0;
+	unsigned fileStart = 0;
+	unsigned blockSize = theFile->blockSize;
+	unsigned firstBlock = 0, numBlocks = 0;
+
+	start = max(physicalPage, region->physical);
+	end = min((physicalPage + MEMORY_PAGE_SIZE),
+		(region->physical + region->size));
+	fileStart = (region->fileOffset + (start - region->physical));
+
+	firstBlock = (fileStart / blockSize);
+	numBlocks = ((((fileStart + (end - start)) + (blockSize - 1)) /
+		blockSize) - firstBlock);
+
+	*buffer = kernelMalloc(numBlocks * blockSize);
+	if (!*buffer)
+		return (status = ERR_MEMORY);
+
+	status = kernelFileRead(theFile, firstBlock, numBlocks, *buffer);
+	if (status < 0)
+	{
+		kernelFree(*buffer);
+		*buffer = NULL;
+		return (status);
+	}
+
+	*pageOffset = (start - physicalPage);
+	*bytes = (end - start);
+	*data = (*buffer + (fileStart % blockSize));
+
+	return (status = 0);
+}
+
+
+static int hideUnfilled(demandRegion *region, int processId,
+	void *virtualBase, unsigned physicalBase)
+{
+	// Mark the region's unfilled pages as not present in the process, given
+	// the virtual address at which the physical base address is mapped
+
+	int status = 0;
+	unsigned physicalPage = kernelPageRoundDown(region->physical);
+	unsigned count;
+
+	for (count = 0; count < region->numPages; count ++)
+	{
+		if (!isFilled(region, physicalPage))
+		{
+			status = kernelPageSetAttrs(processId, pageattr_notpresent,
+				(virtualBase + (physicalPage - physicalBase)),
+				MEMORY_PAGE_SIZE);
+			if (status < 0)
+				return (status);
+		}
+
+		physicalPage += MEMORY_PAGE_SIZE;
+	}
+
+	return (status = 0);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+//  Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int kernelDemandPageAdd(void *virtual, unsigned size, file *theFile,
+	unsigned fileOffset)
+{
+	// Register memory of the current process, which must be physically
+	// contiguous (as from kernelMemoryGet()), to be filled from the opened
+	// file starting at the file offset, as its pages are touched.  The memory
+	// should already be zeroed.  Kernel memory is registered, but its pages
+	// aren't hidden; only the processes it gets shared with will fill it.
+
+	int status = 0;
+	int processId = kernelCurrentProcess->processId;
+	unsigned physical = 0;
+	demandRegion *region = NULL;
+
+	// Check params
+	if (!virtual || !theFile)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (!size)
+		return (status = 0);
+
+	if (virtual >= (void *) KERNEL_VIRTUAL_ADDRESS)
+		processId = KERNELPROCID;
+
+	physical = kernelPageGetPhysical(processId, virtual);
+	if (!physical)
+		return (status = ERR_NOSUCHENTRY);
+
+	region = newRegion(processId, physical, size, theFile, fileOffset);
+	if (!region)
+		return (status = ERR_MEMORY);
+
+	// Don't let the file change while we might still need to read from it
+	status = kernelFilePin(&region->theFile);
+	if (status < 0)
+	{
+		kernelFree(region);
+		return (status);
+	}
+
+	// Add it to the list before hiding its pages, so that any fault can be
+	// satisfied
+	status = kernelLockGet(&regionLock);
+	if (status < 0)
+	{
+		kernelFileUnpin(&region->theFile);
+		kernelFree(region);
+		return (status);
+	}
+
+	region->id = ++regionIds;
+	region->next = regionList;
+	regionList = region;
+
+	if (processId != KERNELPROCID)
+	{
+		status = hideUnfilled(region, processId, (void *)
+			kernelPageRoundDown(virtual), kernelPageRoundDown(physical));
+	}
+
+	kernelLockRelease(&regionLock);
+
+	if (status < 0)
+	{
+		kernelDemandPageRelease(processId, virtual, size);
+		kernelPageSetAttrs(processId, pageattr_present, virtual, size);
+	}
+
+	return (status);
+}
+
+
+int kernelDemandPageCopy(void *dest, const void *src, unsigned size)
+{
+	// Like memcpy(), for copying from memory that's filled on demand.  Where
+	// the source hasn't been read yet, then rather than reading it in to copy
+	// it, the destination memory gets filled on demand from the same part of
+	// the file instead.  The source and destination must each be physically
+	// contiguous.
+
+	int status = 0;
+	unsigned srcPhysical = 0;
+	demandRegion *region = NULL;
+	unsigned offset = 0;
+	unsigned spanEnd = 0;
+	int unfilled = 0;
+	file theFile;
+	unsigned fileOffset = 0;
+	unsigned physicalPage = 0;
+
+	// Check params
+	if (!dest || !src)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (!regionList)
+	{
+		memcpy(dest, src, size);
+		return (status = 0);
+	}
+
+	srcPhysical = getPhysical((void *) src);
+
+	// Work through the source, in spans that are either inside one region,
+	// or not in any
+	while (offset < size)
+	{
+		spanEnd = size;
+		unfilled = 0;
+
+		status = kernelLockGet(&regionLock);
+		if (status < 0)
+			return (status);
+
+		for (region = regionList; srcPhysical && region;
+			region = region->next)
+		{
+			if (overlaps(region, (srcPhysical + offset), 1))
+				break;
+
+			// Stop short of any region further on
+			if ((region->physical > (srcPhysical + offset)) &&
+				(region->physical < (srcPhysical + spanEnd)))
+			{
+				spanEnd = (region->physical - srcPhysical);
+			}
+		}
+
+		if (region)
+		{
+			spanEnd = min(size, ((region->physical + region->size) -
+				srcPhysical));
+
+			// If it's all been read in already, it's quicker to copy it
+			for (physicalPage = kernelPageRoundDown(srcPhysical + offset);
+				physicalPage < (srcPhysical + spanEnd);
+				physicalPage += MEMORY_PAGE_SIZE)
+			{
+				if (!isFilled(region, physicalPage))
+				{
+					unfilled = 1;
+					break;
+				}
+			}
+
+			memcpy(&theFile, &region->theFile, sizeof(file));
+			fileOffset = (region->fileOffset +
+				((srcPhysical + offset) - region->physical));
+		}
+
+		kernelLockRelease(&regionLock);
+
+		if (!unfilled || (kernelDemandPageAdd((dest + offset),
+			(spanEnd - offset), &theFile, fileOffset) < 0))
+		{
+			memcpy((dest + offset), (src + offset), (spanEnd - offset));
+		}
+
+		offset = spanEnd;
+	}
+
+	return (status = 0);
+}
+
+
+int kernelDemandPageShare(int processId, void *virtual, unsigned size)
+{
+	// The memory has been mapped into the process at the virtual address.
+	// Mark any pages of it that haven't been read yet as not present in its
+	// address space.
+
+	int status = 0;
+	unsigned physical = 0;
+	demandRegion *region = NULL;
+
+	// Check params
+	if (!virtual)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (!regionList)
+		return (status = 0);
+
+	physical = kernelPageGetPhysical(processId, virtual);
+	if (!physical)
+		return (status = ERR_NOSUCHENTRY);
+
+	status = kernelLockGet(&regionLock);
+	if (status < 0)
+		return (status);
+
+	for (region = regionList; region; region = region->next)
+	{
+		if ((region->physical < physical) ||
+			((region->physical + region->size) > (physical + size)))
+		{
+			continue;
+		}
+
+		status = hideUnfilled(region, processId, (void *)
+			kernelPageRoundDown(virtual), kernelPageRoundDown(physical));
+		if (status < 0)
+			break;
+	}
+
+	kernelLockRelease(&regionLock);
+	return (status);
+}
+
+
+int kernelDemandPageTransfer(int processId, void *virtual, unsigned size)
+{
+	// Give the current process' regions within the memory, which has been
+	// mapped into the other process at the virtual address, to the other
+	// process, and hide their unread pages there.
+
+	int status = 0;
+	int currentId = kernelCurrentProcess->processId;
+	unsigned physical = 0;
+	demandRegion *region = NULL;
+
+	// Check params
+	if (!virtual)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (!regionList)
+		return (status = 0);
+
+	physical = kernelPageGetPhysical(processId, virtual);
+	if (!physical)
+		return (status = ERR_NOSUCHENTRY);
+
+	status = kernelLockGet(&regionLock);
+	if (status < 0)
+		return (status);
+
+	for (region = regionList; region; region = region->next)
+	{
+		if ((region->processId == currentId) &&
+			(region->physical >= physical) &&
+			((region->physical + region->size) <= (physical + size)))
+		{
+			region->processId = processId;
+		}
+	}
+
+	kernelLockRelease(&regionLock);
+
+	return (status = kernelDemandPageShare(processId, virtual, size));
+}
+
+
+void kernelDemandPageRelease(int processId, void *virtual, unsigned size)
+{
+	// Forget about the process' regions within the memory, or all of them if
+	// the virtual address is NULL.  This doesn't touch the pages, so the
+	// memory should be released afterwards.
+
+	unsigned physical = 0;
+	demandRegion **prev = NULL;
+	demandRegion *region = NULL;
+
+	if (!regionList)
+		return;
+
+	if (virtual)
+	{
+		physical = getPhysical(virtual);
+		if (!physical)
+			return;
+	}
+
+	if (kernelLockGet(&regionLock) < 0)
+		return;
+
+	prev = &regionList;
+	while (*prev)
+	{
+		region = *prev;
+
+		if ((region->processId != processId) || (virtual &&
+			!overlaps(region, physical, size)))
+		{
+			prev = &region->next;
+			continue;
+		}
+
+		kernelDebug(debug_memory, "Demand paging process %d read %u of %u "
+			"pages", processId, region->filledPages, region->numPages);
+
+		*prev = region->next;
+		kernelFileUnpin(&region->theFile);
+		kernelFree(region);
+	}
+
+	kernelLockRelease(&regionLock);
+}
+
+
+int kernelDemandPageFault(void *address)
+{
+	// Called by the page fault handler, with interrupts enabled.  If the
+	// address is in memory that's filled on demand, read in the page and
+	// mark it present.  Returns negative if it's not ours to handle.  The
+	// file is read without holding the region list lock, or any page table
+	// or memory locks.
+
+	int status = 0;
+	int processId = kernelCurrentProcess->processId;
+	void *page = (void *) kernelPageRoundDown(address);
+	unsigned physicalPage = 0;
+	demandRegion *region = NULL;
+	demandRegion readRegion;
+	file theFile;
+	unsigned pageOffset = 0;
+	unsigned bytes = 0;
+	void *data = NULL;
+	void *buffer = NULL;
+	void *pageMemory = NULL;
+	int index = 0;
+	int found = 0;
+
+	if (!regionList || (address >= (void *) KERNEL_VIRTUAL_ADDRESS))
+		return (status = ERR_NOSUCHENTRY);
+
+	// It has to be mapped, but not present
+	if (kernelPagePresent(processId, page))
+		return (status = ERR_NOSUCHENTRY);
+
+	physicalPage = kernelPageGetPhysical(processId, page);
+
+	// The page can be covered by more than one region (for example the end
+	// of the code and the start of the data).  Fill it from each in turn.
+	while (1)
+	{
+		// Find a region covering the page which hasn't filled it yet, and
+		// take a copy of what we need to read it
+		status = kernelLockGet(&regionLock);
+		if (status < 0)
+			break;
+
+		for (region = regionList; region; region = region->next)
+		{
+			if (!overlaps(region, physicalPage, MEMORY_PAGE_SIZE))
+				continue;
+
+			found = 1;
+
+			// Another process might already have had it read in
+			if (!isFilled(region, physicalPage))
+				break;
+		}
+
+		if (region)
+		{
+			memcpy(&readRegion, region, sizeof(demandRegion));
+			memcpy(&theFile, &region->theFile, sizeof(file));
+
+			// Keep the file for ourselves, in case the region goes away
+			// while we're reading
+			status = kernelFilePin(&theFile);
+		}
+
+		kernelLockRelease(&regionLock);
+
+		if (!region || (status < 0))
+			break;
+
+		status = readPage(&readRegion, physicalPage, &theFile, &pageOffset,
+			&bytes, &data, &buffer);
+
+		kernelFileUnpin(&theFile);
+
+		if (status < 0)
+		{
+			kernelError(kernel_error, "Couldn't read page at %p from file "
+				"%s", page, theFile.name);
+			break;
+		}
+
+		if (!pageMemory)
+		{
+			status = kernelPageMapToFree(KERNELPROCID, physicalPage,
+				&pageMemory, MEMORY_PAGE_SIZE);
+			if (status < 0)
+				break;
+		}
+
+		// Copy it in, unless the region went away, or someone else filled
+		// the page while we were reading
+		status = kernelLockGet(&regionLock);
+		if (status < 0)
+			break;
+
+		for (region = regionList; region; region = region->next)
+		{
+			if (region->id == readRegion.id)
+				break;
+		}
+
+		if (region && !isFilled(region, physicalPage))
+		{
+			memcpy((pageMemory + pageOffset), data, bytes);
+
+			index = pageIndex(region, physicalPage);
+			region->filled[index / 8] |= (1 << (index % 8));
+			region->filledPages += 1;
+		}
+
+		kernelLockRelease(&regionLock);
+
+		kernelFree(buffer);
+		buffer = NULL;
+	}
+
+	if (buffer)
+		kernelFree(buffer);
+
+	if (pageMemory)
+		kernelPageUnmap(KERNELPROCID, pageMemory, MEMORY_PAGE_SIZE);
+
+	if (status >= 0)
+	{
+		if (found)
+			status = kernelPageSetAttrs(processId, pageattr_present, page,
+				MEMORY_PAGE_SIZE);
+		else
+			status = ERR_NOSUCHENTRY;
+	}
+
+	return (status);
+}
+
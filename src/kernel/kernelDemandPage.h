@@ -0,0 +1,36 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelDemandPage.h
+//
+
+#ifndef _KERNELDEMANDPAGE_H
+#define _KERNELDEMANDPAGE_H
+
+#include <sys/file.h>
+
+// Functions exported by kernelDemandPage.c
+int kernelDemandPageAdd(void *, unsigned, file *, unsigned);
+int kernelDemandPageCopy(void *, const void *, unsigned);
+int kernelDemandPageShare(int, void *, unsigned);
+int kernelDemandPageTransfer(int, void *, unsigned);
+void kernelDemandPageRelease(int, void *, unsigned);
+int kernelDemandPageFault(void *);
+
+#endif
+
@@ -213,6 +213,16 @@ int kernelDescriptorInitialize(void)
 }
 
 
+void kernelDescriptorLoad(void)
+{
+	// Application processors (see kernelSmp.c) start with a temporary GDT,
+	// and no IDT.  This loads ours.
+
+	processorSetGDT((void *) globalDescriptorTable, (GDT_SIZE * 8));
+	processorSetIDT((void *) interruptDescriptorTable, (IDT_SIZE * 8));
+}
+
+
 int kernelDescriptorRequest(volatile kernelSelector *descNumPointer)
 {
 	// This function is used to allocate a free descriptor from the
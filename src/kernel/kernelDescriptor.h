@@ -60,6 +60,7 @@ typedef struct {
 
 // Functions exported by kernelDescriptor.c
 int kernelDescriptorInitialize(void);
+void kernelDescriptorLoad(void);
 int kernelDescriptorRequest(volatile kernelSelector *);
 int kernelDescriptorRelease(kernelSelector descriptorNumber);
 int kernelDescriptorSetUnformatted(volatile kernelSelector, unsigned char,
@@ -28,9 +28,11 @@
 #include "kernelDisk.h"
 #include "kernelError.h"
 #include "kernelFilesystem.h"
+#include "kernelLoader.h"
 #include "kernelLock.h"
 #include "kernelMalloc.h"
 #include "kernelMemory.h"
+#include "kernelMisc.h"
 #include "kernelMultitasker.h"
 #include "kernelRandom.h"
 #include "kernelRtc.h"
@@ -268,6 +270,9 @@ static inline void updateModifiedTime(kernelFileEntry *entry)
 	entry->modifiedDate = kernelRtcPackedDate();
 	entry->modifiedTime = kernelRtcPackedTime();
 	entry->lastAccess = kernelCpuTimestamp();
+
+	// Any cached copy of a config file is out of date
+	kernelConfigFileChanged(entry);
 }
 
 
@@ -682,6 +687,27 @@ static int fileCreate(const char *path)
 }
 
 
+static int fileBusy(kernelFileEntry *entry)
+{
+	// Returns 1 if the file is pinned because programs are loaded from it on
+	// demand, in which case it can't be changed or deleted.  Images cached by
+	// the loader that aren't being used pin their files too, so drop those
+	// first.
+
+	if (entry->pinned)
+		kernelLoaderFlushImageCache();
+
+	if (entry->pinned)
+	{
+		kernelError(kernel_error, "File %s is in use by a running program",
+			entry->name);
+		return (1);
+	}
+
+	return (0);
+}
+
+
 static int fileOpen(kernelFileEntry *entry, int openMode)
 {
 	// This is mostly a wrapper function for the equivalent function in the
@@ -716,6 +742,9 @@ static int fileOpen(kernelFileEntry *entry, int openMode)
 		return (status = ERR_NOWRITE);
 	}
 
+	if ((openMode & OPENMODE_WRITE) && fileBusy(entry))
+		return (status = ERR_BUSY);
+
 	driver = fsDisk->filesystem.driver;
 
 	// There are extra things we need to do if this will be a write operation
@@ -802,6 +831,9 @@ static int fileDelete(kernelFileEntry *entry)
 		return (status = ERR_NOWRITE);
 	}
 
+	if (fileBusy(entry))
+		return (status = ERR_BUSY);
+
 	driver = fsDisk->filesystem.driver;
 
 	// If the filesystem driver has a 'delete' function, call it.
@@ -1454,6 +1486,9 @@ void kernelFileReleaseEntry(kernelFileEntry *entry)
 		}
 	}
 
+	// Don't let the config file cache mistake a reused entry for this one
+	kernelConfigFileChanged(entry);
+
 	// Clear it out
 	memset((void *) entry, 0, sizeof(kernelFileEntry));
 
@@ -1686,6 +1721,10 @@ int kernelFileRemoveEntry(kernelFileEntry *entry)
 	entry->previousEntry = NULL;
 	entry->nextEntry = NULL;
 
+	// It's no longer the file with this name, as far as the config file
+	// cache is concerned
+	kernelConfigFileChanged(entry);
+
 	// Update the access time on the directory
 	parentEntry->lastAccess = kernelCpuTimestamp();
 
@@ -1889,11 +1928,11 @@ int kernelFileUnbufferRecursive(kernelFileEntry *entry)
 	}
 
 	// Now this directory should be a leaf directory.  Do any of its files
-	// currently have a valid lock?
+	// currently have a valid lock, or are any of them pinned?
 	listEntry = entry->contents;
 	while (listEntry)
 	{
-		if (kernelLockVerify(&listEntry->lock))
+		if (kernelLockVerify(&listEntry->lock) || listEntry->pinned)
 			break;
 		else
 			listEntry = listEntry->nextEntry;
@@ -1957,6 +1996,8 @@ int kernelFileEntrySetSize(kernelFileEntry *entry, unsigned newSize)
 	entry->size = newSize;
 	entry->blocks = newBlocks;
 
+	kernelConfigFileChanged(entry);
+
 	if (fsDisk->filesystem.driver->driverWriteDir)
 	{
 		status = fsDisk->filesystem.driver->
@@ -2420,6 +2461,53 @@ int kernelFileClose(file *fileStruct)
 }
 
 
+int kernelFilePin(file *fileStruct)
+{
+	// Pin an opened file, so that it can't be changed or deleted while
+	// programs are being loaded from it on demand.  A file that's currently
+	// open for writing can't be pinned.
+
+	int status = 0;
+	kernelFileEntry *entry = NULL;
+
+	if (!initialized)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Check params
+	if (!fileStruct)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	entry = (kernelFileEntry *) fileStruct->handle;
+	if (!entry)
+		return (status = ERR_NULLPARAMETER);
+
+	if (kernelLockVerify(&entry->lock) > 0)
+		return (status = ERR_BUSY);
+
+	entry->pinned += 1;
+
+	return (status = 0);
+}
+
+
+void kernelFileUnpin(file *fileStruct)
+{
+	// Undo a kernelFilePin()
+
+	kernelFileEntry *entry = NULL;
+
+	if (!fileStruct)
+		return;
+
+	entry = (kernelFileEntry *) fileStruct->handle;
+	if (entry && (entry->pinned > 0))
+		entry->pinned -= 1;
+}
+
+
 int kernelFileRead(file *fileStruct, unsigned blockNum, unsigned blocks,
 	void *fileBuffer)
 {
@@ -2560,6 +2648,9 @@ int kernelFileWrite(file *fileStruct, unsigned blockNum, unsigned blocks,
 	// Now we can call our target function
 	status = driver->driverWriteFile(fileStruct->handle, blockNum, blocks,
 		fileBuffer);
+
+	kernelConfigFileChanged(fileStruct->handle);
+
 	if (status < 0)
 		return (status);
 
@@ -51,6 +51,7 @@ typedef volatile struct _kernelFileEntry {
 	volatile struct _kernelDisk *disk;	// parent filesystem
 	void *driverData;					// private fs-driver-specific data
 	int openCount;
+	int pinned;							// loaded on demand by programs
 	spinLock lock;
 
 	// Linked-list stuff.
@@ -88,6 +89,8 @@ int kernelFileNext(const char *, file *);
 int kernelFileFind(const char *, file *);
 int kernelFileOpen(const char *, int, file *);
 int kernelFileClose(file *);
+int kernelFilePin(file *);
+void kernelFileUnpin(file *);
 int kernelFileRead(file *, unsigned, unsigned, void *);
 int kernelFileWrite(file *, unsigned, unsigned, void *);
 int kernelFileDelete(const char *);
@@ -29,6 +29,8 @@
 #include "kernelFile.h"
 #include "kernelFont.h"
 #include "kernelImage.h"
+#include "kernelInterrupt.h"
+#include "kernelLock.h"
 #include "kernelLog.h"
 #include "kernelMalloc.h"
 #include "kernelMultitasker.h"
@@ -52,6 +54,29 @@ static kernelDevice *systemAdapter = NULL;
 static kernelGraphicAdapter *adapterDevice = NULL;
 static kernelGraphicOps *ops = NULL;
 
+// A cache of glyphs, pre-rendered in the native pixel format of the
+// display, for each recently-used combination of font and colors.  Text is
+// then drawn a scan line at a time, copying whole runs of glyph pixels rather
+// than expanding the mono bitmaps for each character.
+#define GLYPHCACHE_ENTRIES		16
+#define GLYPHCACHE_DIRECTCODES	256
+
+typedef struct {
+	kernelFont *font;
+	kernelGlyph *glyphs;
+	int numGlyphs;
+	color foreground;
+	color background;
+	unsigned lastUsed;
+	int directMap[GLYPHCACHE_DIRECTCODES];
+	unsigned char **pixels;
+
+} glyphCacheEntry;
+
+static glyphCacheEntry glyphCache[GLYPHCACHE_ENTRIES];
+static unsigned glyphCacheCounter = 0;
+static spinLock glyphCacheLock;
+
 #define VBE_PMINFOBLOCK_SIG "PMID"
 
 typedef struct {
@@ -134,6 +159,306 @@ out:
 }
 
 
+static int findGlyph(kernelFont *font, glyphCacheEntry *entry,
+	unsigned unicode)
+{
+	// Returns the index of the glyph for the requested character in the
+	// font, or -1 if there isn't one
+
+	int count;
+
+	if (entry && (unicode < GLYPHCACHE_DIRECTCODES))
+		return (entry->directMap[unicode]);
+
+	for (count = 0; count < font->numGlyphs; count ++)
+	{
+		if (font->glyphs[count].unicode == unicode)
+			return (count);
+	}
+
+	return (-1);
+}
+
+
+static void glyphCacheClear(glyphCacheEntry *entry)
+{
+	// Free any pre-rendered glyphs in the cache entry
+
+	int count;
+
+	if (entry->pixels)
+	{
+		for (count = 0; count < entry->numGlyphs; count ++)
+		{
+			if (entry->pixels[count])
+				kernelFree(entry->pixels[count]);
+		}
+
+		kernelFree(entry->pixels);
+	}
+
+	memset(entry, 0, sizeof(glyphCacheEntry));
+}
+
+
+static glyphCacheEntry *glyphCacheGet(kernelFont *font, color *foreground,
+	color *background)
+{
+	// Find (or create) the cache entry for this font and color combination.
+	// The glyph cache lock must be held.
+
+	glyphCacheEntry *entry = NULL;
+	int count;
+
+	for (count = 0; count < GLYPHCACHE_ENTRIES; count ++)
+	{
+		if ((glyphCache[count].font == font) &&
+			PIXELS_EQ(&glyphCache[count].foreground, foreground) &&
+			PIXELS_EQ(&glyphCache[count].background, background))
+		{
+			entry = &glyphCache[count];
+
+			// If glyphs have been added to the font since the entry was
+			// created, it's stale
+			if ((entry->glyphs != font->glyphs) ||
+				(entry->numGlyphs != font->numGlyphs))
+			{
+				glyphCacheClear(entry);
+				break;
+			}
+
+			entry->lastUsed = ++glyphCacheCounter;
+			return (entry);
+		}
+
+		// Remember the least-recently-used entry, in case we need to replace
+		// it
+		if (!entry || (glyphCache[count].lastUsed < entry->lastUsed))
+			entry = &glyphCache[count];
+	}
+
+	glyphCacheClear(entry);
+
+	entry->pixels = kernelMalloc(font->numGlyphs * sizeof(unsigned char *));
+	if (!entry->pixels)
+		return (entry = NULL);
+
+	entry->font = font;
+	entry->glyphs = font->glyphs;
+	entry->numGlyphs = font->numGlyphs;
+	PIXEL_COPY(foreground, &entry->foreground);
+	PIXEL_COPY(background, &entry->background);
+	entry->lastUsed = ++glyphCacheCounter;
+
+	// Make a direct map of the lower character codes, so that we don't have
+	// to search the font's glyph list for those
+	for (count = 0; count < GLYPHCACHE_DIRECTCODES; count ++)
+		entry->directMap[count] = findGlyph(font, NULL, count);
+
+	return (entry);
+}
+
+
+static unsigned char *glyphCachePixels(glyphCacheEntry *entry, int index)
+{
+	// Returns the pre-rendered pixels for the glyph, expanding the mono image
+	// into the native pixel format if it's the first use.  The glyph cache
+	// lock must be held.
+
+	kernelGlyph *glyph = &entry->font->glyphs[index];
+	graphicBuffer glyphBuffer;
+
+	if (entry->pixels[index])
+		return (entry->pixels[index]);
+
+	glyphBuffer.width = glyph->img.width;
+	glyphBuffer.height = glyph->img.height;
+	glyphBuffer.data = kernelMalloc(kernelGraphicCalculateAreaBytes(
+		glyphBuffer.width, glyphBuffer.height));
+	if (!glyphBuffer.data)
+		return (NULL);
+
+	if (ops->driverDrawMonoImage(&glyphBuffer, &glyph->img, draw_normal,
+		&entry->foreground, &entry->background, 0, 0) < 0)
+	{
+		kernelFree(glyphBuffer.data);
+		return (NULL);
+	}
+
+	entry->pixels[index] = glyphBuffer.data;
+	return (entry->pixels[index]);
+}
+
+
+static int drawGlyphRun(graphicBuffer *buffer, glyphCacheEntry *entry,
+	int *indexes, int numGlyphs, int xCoord, int yCoord)
+{
+	// Draw a run of pre-rendered glyphs, one scan line at a time
+
+	kernelGlyph *glyph = NULL;
+	unsigned char *destData = NULL;
+	unsigned char *destLine = NULL;
+	unsigned char *srcLine = NULL;
+	int bufferWidth = 0, bufferHeight = 0;
+	int scanLineBytes = 0;
+	int bytesPerPixel = adapterDevice->bytesPerPixel;
+	int glyphX = 0, startX = 0, endX = 0;
+	int maxHeight = 0;
+	int row, count;
+
+	if (buffer)
+	{
+		destData = buffer->data;
+		bufferWidth = buffer->width;
+		bufferHeight = buffer->height;
+		scanLineBytes = (buffer->width * bytesPerPixel);
+	}
+	else
+	{
+		destData = adapterDevice->framebuffer;
+		bufferWidth = adapterDevice->xRes;
+		bufferHeight = adapterDevice->yRes;
+	}
+
+	if (destData == adapterDevice->framebuffer)
+		scanLineBytes = adapterDevice->scanLineBytes;
+
+	for (count = 0; count < numGlyphs; count ++)
+		maxHeight = max(maxHeight, (int)
+			entry->font->glyphs[indexes[count]].img.height);
+
+	for (row = 0; row < maxHeight; row ++)
+	{
+		if ((yCoord + row) < 0)
+			continue;
+		if ((yCoord + row) >= bufferHeight)
+			break;
+
+		destLine = (destData + ((yCoord + row) * scanLineBytes));
+		glyphX = xCoord;
+
+		for (count = 0; count < numGlyphs; count ++)
+		{
+			glyph = &entry->font->glyphs[indexes[count]];
+
+			if (row < (int) glyph->img.height)
+			{
+				// Clip the glyph's line to the buffer
+				startX = max(0, -glyphX);
+				endX = min((int) glyph->img.width, (bufferWidth - glyphX));
+
+				if (endX > startX)
+				{
+					srcLine = (entry->pixels[indexes[count]] + (((row *
+						glyph->img.width) + startX) * bytesPerPixel));
+
+					memcpy((destLine + ((glyphX + startX) * bytesPerPixel)),
+						srcLine, ((endX - startX) * bytesPerPixel));
+				}
+			}
+
+			glyphX += glyph->img.width;
+			if (glyphX >= bufferWidth)
+				break;
+		}
+	}
+
+	return (numGlyphs);
+}
+
+
+static int drawTextCached(graphicBuffer *buffer, color *foreground,
+	color *background, kernelFont *font, const char *charSet,
+	const char *text, int length, int xCoord, int yCoord)
+{
+	// Decode the string into a run of glyphs from the cache, and draw them
+	// all at once.  Returns the number of glyphs drawn, or negative if the
+	// cache can't be used and the caller should draw the slow way.
+
+	int status = 0;
+	glyphCacheEntry *entry = NULL;
+	int *indexes = NULL;
+	int numGlyphs = 0;
+	unsigned unicode = 0;
+	int multiByte = 0;
+	int index = 0;
+	int count;
+
+	// We can't wait for the lock in an interrupt handler, and it won't work
+	// before multitasking is started.  The kernel's locks let a process
+	// re-enter a lock it already holds, so refuse that here, otherwise an
+	// interrupt taken while the current process is changing the cache would
+	// get in, and would release the lock out from under it when done.
+	if (kernelProcessingInterrupt() || (glyphCacheLock.processId ==
+		kernelMultitaskerGetCurrentProcessId()))
+	{
+		return (status = ERR_BUSY);
+	}
+
+	status = kernelLockGet(&glyphCacheLock);
+	if (status < 0)
+		return (status);
+
+	entry = glyphCacheGet(font, foreground, background);
+	if (!entry)
+	{
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	indexes = kernelMalloc(length * sizeof(int));
+	if (!indexes)
+	{
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	for (count = 0; count < length; count ++)
+	{
+		if ((unsigned char) text[count] < CHARSET_IDENT_CODES)
+		{
+			unicode = text[count];
+		}
+		else if (!strcmp(charSet, CHARSET_NAME_UTF8))
+		{
+			multiByte = mbtowc(&unicode, (text + count), (length - count));
+			if (multiByte < 0)
+				continue;
+			else if (multiByte > 1)
+				count += (multiByte - 1);
+		}
+		else
+		{
+			unicode = kernelCharsetToUnicode(charSet, (unsigned char)
+				text[count]);
+		}
+
+		index = findGlyph(font, entry, unicode);
+		if ((index < 0) || !font->glyphs[index].img.data)
+			continue;
+
+		if (font->glyphs[index].img.width && font->glyphs[index].img.height &&
+			!glyphCachePixels(entry, index))
+		{
+			status = ERR_MEMORY;
+			goto out;
+		}
+
+		indexes[numGlyphs++] = index;
+	}
+
+	status = drawGlyphRun(buffer, entry, indexes, numGlyphs, xCoord, yCoord);
+
+out:
+	if (indexes)
+		kernelFree(indexes);
+
+	kernelLockRelease(&glyphCacheLock);
+
+	return (status);
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -623,7 +948,8 @@ int kernelGraphicDrawText(graphicBuffer *buffer, color *foreground,
 	int length = 0;
 	unsigned unicode = 0;
 	int multiByte = 0;
-	int count1, count2;
+	int glyph = 0;
+	int count1;
 
 	// Make sure we've been initialized
 	if (!systemAdapter)
@@ -648,6 +974,18 @@ int kernelGraphicDrawText(graphicBuffer *buffer, color *foreground,
 	if (!charSet)
 		charSet = CHARSET_NAME_DEFAULT;
 
+	// Unless we're drawing translucently (leaving the background pixels
+	// alone), use the pre-rendered glyph cache
+	if (mode != draw_translucent)
+	{
+		printed = drawTextCached(buffer, foreground, background, font,
+			charSet, text, length, xCoord, yCoord);
+		if (printed >= 0)
+			return (printed);
+
+		printed = 0;
+	}
+
 	// Loop through the string
 	for (count1 = 0; count1 < length; count1 ++)
 	{
@@ -669,23 +1007,16 @@ int kernelGraphicDrawText(graphicBuffer *buffer, color *foreground,
 				text[count1]);
 		}
 
-		for (count2 = 0; count2 < font->numGlyphs; count2 ++)
+		glyph = findGlyph(font, NULL, unicode);
+		if ((glyph >= 0) && font->glyphs[glyph].img.data)
 		{
-			if (font->glyphs[count2].unicode == unicode)
-			{
-				if (font->glyphs[count2].img.data)
-				{
-					// Call the driver function to draw the character
-					status = ops->driverDrawMonoImage(buffer,
-						&font->glyphs[count2].img, mode, foreground,
-						background, xCoord, yCoord);
+			// Call the driver function to draw the character
+			status = ops->driverDrawMonoImage(buffer,
+				&font->glyphs[glyph].img, mode, foreground, background,
+				xCoord, yCoord);
 
-					xCoord += font->glyphs[count2].img.width;
-					printed += 1;
-				}
-
-				break;
-			}
+			xCoord += font->glyphs[glyph].img.width;
+			printed += 1;
 		}
 	}
 
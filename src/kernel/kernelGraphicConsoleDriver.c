@@ -42,6 +42,63 @@ static inline void updateComponent(kernelTextArea *area)
 }
 
 
+static int areaWidth(kernelTextArea *area)
+{
+	// Returns the drawable width of the text area, in pixels
+
+	kernelWindowComponent *component = area->windowComponent;
+	kernelWindowTextArea *windowTextArea = component->data;
+
+	if (windowTextArea)
+		return (windowTextArea->areaWidth);
+	else if (component->width)
+		return (component->width);
+	else
+		return (component->buffer->width);
+}
+
+
+static void markDirty(kernelTextArea *area, int row, int numRows)
+{
+	// Remember that some rows have been drawn into the graphic buffer, but
+	// not yet updated on the screen
+
+	int lastRow = 0;
+
+	if (area->dirtyRows)
+	{
+		lastRow = max((area->dirtyFirstRow + area->dirtyRows),
+			(row + numRows));
+		area->dirtyFirstRow = min(area->dirtyFirstRow, row);
+		area->dirtyRows = (lastRow - area->dirtyFirstRow);
+	}
+	else
+	{
+		area->dirtyFirstRow = row;
+		area->dirtyRows = numRows;
+	}
+}
+
+
+static void flushDirty(kernelTextArea *area)
+{
+	// Tell the window manager to update the dirty rows on the screen, unless
+	// we're in the middle of a batch of updates
+
+	graphicBuffer *buffer = ((kernelWindowComponent *)
+		area->windowComponent)->buffer;
+
+	if (area->updateBatch || !area->dirtyRows)
+		return;
+
+	kernelWindowUpdateBuffer(buffer, area->xCoord, (area->yCoord +
+		(area->dirtyFirstRow * area->font->glyphHeight)), areaWidth(area),
+		(area->dirtyRows * area->font->glyphHeight));
+
+	area->dirtyRows = 0;
+}
+
+
 static int buffer2Char(kernelTextArea *area, char *dest,
 	const unsigned char * volatile src, int index, int maxChars)
 {
@@ -169,10 +226,8 @@ static void setCursor(kernelTextArea *area, int onOff)
 	}
 
 	// Tell the window manager to update the graphic buffer
-	kernelWindowUpdateBuffer(buffer,
-		(area->xCoord + (area->cursorColumn * area->font->glyphWidth)),
-		(area->yCoord + (area->cursorRow * area->font->glyphHeight)),
-		area->font->glyphWidth, area->font->glyphHeight);
+	markDirty(area, area->cursorRow, 1);
+	flushDirty(area);
 
 	area->cursorState = onOff;
 
@@ -184,17 +239,9 @@ static int scrollLine(kernelTextArea *area)
 {
 	// Scrolls the text by 1 line in the text area provided
 
-	kernelWindowComponent *component = area->windowComponent;
-	kernelWindowTextArea *windowTextArea = component->data;
-	graphicBuffer *buffer = component->buffer;
-	int maxWidth = 0;
-
-	if (windowTextArea)
-		maxWidth = windowTextArea->areaWidth;
-	else if (component->width)
-		maxWidth = component->width;
-	else
-		maxWidth = buffer->width;
+	graphicBuffer *buffer = ((kernelWindowComponent *)
+		area->windowComponent)->buffer;
+	int maxWidth = areaWidth(area);
 
 	if (buffer->height > area->font->glyphHeight)
 	{
@@ -209,9 +256,9 @@ static int scrollLine(kernelTextArea *area)
 		(area->yCoord + ((area->rows - 1) * area->font->glyphHeight)),
 		maxWidth, area->font->glyphHeight);
 
-	// Tell the window manager to update the whole graphic buffer
-	kernelWindowUpdateBuffer(buffer, area->xCoord, area->yCoord, maxWidth,
-		(area->rows * area->font->glyphHeight));
+	// Everything has moved, so the whole area needs to be updated.  If we're
+	// printing, that will happen once at the end rather than for every line.
+	markDirty(area, 0, area->rows);
 
 	// Move the buffer up by one
 	scrollBuffer(area, 1);
@@ -275,9 +322,8 @@ static int screenDraw(kernelTextArea *area)
 	kernelFree(lineBuffer);
 
 	// Tell the window manager to update the whole area buffer
-	kernelWindowUpdateBuffer(buffer, area->xCoord, area->yCoord,
-		(area->columns * area->font->glyphWidth),
-		(area->rows * area->font->glyphHeight));
+	markDirty(area, 0, area->rows);
+	flushDirty(area);
 
 	// If we aren't scrolled back, show the cursor again
 	if (area->cursorState && !(area->scrolledBackLines))
@@ -354,6 +400,9 @@ static int print(kernelTextArea *area, const char *input, textAttrs *attrs)
 	if (!lineBuffer)
 		return (status = ERR_MEMORY);
 
+	// Collect all of the screen updates, and do them at the end
+	area->updateBatch += 1;
+
 	// See whether we're printing with special attributes
 	if (attrs)
 	{
@@ -468,10 +517,7 @@ static int print(kernelTextArea *area, const char *input, textAttrs *attrs)
 					area->font->glyphWidth)),
 				(area->yCoord + (area->cursorRow * area->font->glyphHeight)));
 
-			kernelWindowUpdateBuffer(buffer, (area->xCoord +
-					(area->cursorColumn * area->font->glyphWidth)),
-				(area->yCoord + (area->cursorRow * area->font->glyphHeight)),
-				(printed * area->font->glyphWidth), area->font->glyphHeight);
+			markDirty(area, area->cursorRow, 1);
 
 			if (newLine || ((area->cursorColumn + printed) >= area->columns))
 			{
@@ -507,6 +553,9 @@ static int print(kernelTextArea *area, const char *input, textAttrs *attrs)
 		// Turn on the cursor
 		setCursor(area, 1);
 
+	area->updateBatch -= 1;
+	flushDirty(area);
+
 	return (status = 0);
 }
 
@@ -515,8 +564,6 @@ static int delete(kernelTextArea *area)
 {
 	// Erase the character at the current position
 
-	graphicBuffer *buffer = ((kernelWindowComponent *)
-		area->windowComponent)->buffer;
 	int cursorState = area->cursorState;
 	int position = TEXTAREA_CURSORPOS(area);
 
@@ -537,10 +584,8 @@ static int delete(kernelTextArea *area)
 	*(TEXTAREA_FIRSTVISIBLE(area) + (position * area->bytesPerChar)) = L'\0';
 	*(area->visibleData + (position * area->bytesPerChar)) = L'\0';
 
-	kernelWindowUpdateBuffer(buffer, (area->xCoord + (area->cursorColumn *
-		area->font->glyphWidth)), (area->yCoord + (area->cursorRow *
-		area->font->glyphHeight)), area->font->glyphWidth,
-		area->font->glyphHeight);
+	markDirty(area, area->cursorRow, 1);
+	flushDirty(area);
 
 	if (cursorState)
 		// Turn on the cursor
@@ -563,9 +608,8 @@ static int screenClear(kernelTextArea *area)
 		(area->rows * area->font->glyphHeight));
 
 	// Tell the window manager to update the whole area buffer
-	kernelWindowUpdateBuffer(buffer, area->xCoord, area->yCoord,
-		(area->columns * area->font->glyphWidth),
-		(area->rows * area->font->glyphHeight));
+	markDirty(area, 0, area->rows);
+	flushDirty(area);
 
 	// Empty all the data
 	memset(TEXTAREA_FIRSTVISIBLE(area), 0, (area->columns * area->rows *
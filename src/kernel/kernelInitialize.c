@@ -42,6 +42,7 @@
 #include "kernelParameters.h"
 #include "kernelRamDiskDriver.h"
 #include "kernelRandom.h"
+#include "kernelSmp.h"
 #include "kernelText.h"
 #include "kernelTouch.h"
 #include "kernelUsbDriver.h"
@@ -402,6 +403,11 @@ int kernelInitialize(unsigned kernelMemory, void *kernelStack,
 		return (status);
 	}
 
+	// Start any other processors
+	status = kernelSmpInitialize();
+	if (status < 0)
+		kernelError(kernel_warn, "Multiprocessor initialization failed");
+
 	// Initialize keyboard operations
 	status = kernelKeyboardInitialize();
 	if (status < 0)
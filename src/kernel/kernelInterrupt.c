@@ -45,7 +45,7 @@ static int initialized = 0;
 	unsigned exAddress = 0;			\
 	int exInterrupts = 0;			\
 	processorExceptionEnter(exAddress, exInterrupts);	\
-	kernelException(exceptionNum, exAddress);	\
+	kernelException(exceptionNum, exAddress, NULL, 0);	\
 	processorExceptionExit(exInterrupts);	\
 }
 
@@ -64,13 +64,35 @@ static void exHandler10(void) EXHANDLERX(EXCEPTION_INVALIDTSS)
 static void exHandler11(void) EXHANDLERX(EXCEPTION_SEGNOTPRES)
 static void exHandler12(void) EXHANDLERX(EXCEPTION_STACK)
 static void exHandler13(void) EXHANDLERX(EXCEPTION_GENPROTECT)
-static void exHandler14(void) EXHANDLERX(EXCEPTION_PAGE)
 static void exHandler15(void) EXHANDLERX(EXCEPTION_RESERVED)
 static void exHandler16(void) EXHANDLERX(EXCEPTION_FLOAT)
 static void exHandler17(void) EXHANDLERX(EXCEPTION_ALIGNCHECK)
 static void exHandler18(void) EXHANDLERX(EXCEPTION_MACHCHECK)
 
 
+static void exHandler14(void)
+{
+	// This is the page fault handler.  It's separate from the others because
+	// the processor pushes an error code, and supplies the faulting address.
+
+	unsigned exAddress = 0;
+	void *faultAddress = NULL;
+	unsigned faultCode = 0;
+	int exInterrupts = 0;
+
+	processorPageFaultEnter(exAddress, faultAddress, faultCode, exInterrupts);
+
+	// Pages can only be filled on demand or copied if the code that faulted
+	// can be interrupted, since that can mean waiting for I/O
+	if (!exInterrupts)
+		faultAddress = NULL;
+
+	kernelException(EXCEPTION_PAGE, exAddress, faultAddress, faultCode);
+
+	processorPageFaultExit();
+}
+
+
 static void intHandlerUnimp(void)
 {
 	// This is the "unimplemented interrupt" handler
@@ -23,13 +23,17 @@
 // program loader.
 
 #include "kernelLoader.h"
+#include "kernelCpu.h"
 #include "kernelDebug.h"
+#include "kernelDemandPage.h"
 #include "kernelError.h"
 #include "kernelFile.h"
+#include "kernelLock.h"
 #include "kernelMalloc.h"
 #include "kernelMemory.h"
 #include "kernelMultitasker.h"
 #include "kernelPage.h"
+#include "kernelParameters.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -79,6 +83,9 @@ kernelFileClass emptyFileClass = { FILECLASS_NAME_EMPTY, NULL, { } };
 static kernelFileClass *fileClassList[NUM_FILECLASS_REGS];
 static int numFileClasses = 0;
 static kernelDynamicLibrary *libraryList = NULL;
+static uquad_t phaseUs[LOADER_NUM_PHASES];
+static kernelCachedImage *imageCache = NULL;
+static spinLock imageCacheLock;
 
 
 static void parseCommand(char *commandLine, int *argc, char *argv[])
@@ -136,12 +143,15 @@ static void parseCommand(char *commandLine, int *argc, char *argv[])
 }
 
 
-static void *load(const char *filename, file *theFile, int kernel)
+static void *load(const char *filename, file *theFile, int kernel,
+	int demand)
 {
 	// This function merely loads the named file into memory (kernel memory if
 	// 'kernel' is non-NULL, otherwise user memory) and returns a pointer to
 	// the memory.  The caller must deallocate the memory when finished with
-	// the data
+	// the data.  If 'demand' is non-NULL, the user memory is filled from the
+	// file as it's touched, rather than all at once, and the caller must
+	// call kernelDemandPageRelease() before deallocating it.
 
 	int status = 0;
 	void *fileData = NULL;
@@ -202,7 +212,12 @@ static void *load(const char *filename, file *theFile, int kernel)
 		return (fileData = NULL);
 	}
 
-	status = kernelFileRead(theFile, 0, theFile->blocks, fileData);
+	// If the file can't be pinned for loading on demand (for example because
+	// it's open for writing), read it all now
+	if (!kernel && demand)
+		status = kernelDemandPageAdd(fileData, theFile->size, theFile, 0);
+	if (kernel || !demand || (status < 0))
+		status = kernelFileRead(theFile, 0, theFile->blocks, fileData);
 	if (status < 0)
 	{
 		// Release the memory we allocated for the program
@@ -218,53 +233,253 @@ static void *load(const char *filename, file *theFile, int kernel)
 }
 
 
-static int sortSymbols(loaderSymbolTable *table)
+static void releaseFileData(void *fileData, unsigned size)
 {
-	int status = 0;
-	loaderSymbolTable *tempTable = NULL;
-	void *smallestValue = NULL;
-	int smallestPosition = 0;
-	int count1, count2;
-
-	// Allocate memory for a temporary table
-	tempTable = kernelMalloc(table->tableSize);
-	if (!tempTable)
-		return (status = ERR_MEMORY);
+	// Release user memory which might be filled on demand
+
+	kernelDemandPageRelease(kernelCurrentProcess->processId, fileData, size);
+	kernelMemoryRelease(fileData);
+}
+
+
+static unsigned hashName(const char *name)
+{
+	// The standard ELF symbol hash function
 
-	// Loop through our temporary table and fill it with the symbols sorted by
-	// value.
-	for (count1 = 0; count1 < table->numSymbols; count1 ++)
+	unsigned hash = 0;
+	unsigned high = 0;
+
+	while (*name)
 	{
-		smallestValue = NULL;
-		for (count2 = 0; count2 < table->numSymbols; count2 ++)
+		hash = ((hash << 4) + (unsigned char) *name++);
+		high = (hash & 0xF0000000);
+		if (high)
+			hash ^= (high >> 24);
+		hash &= ~high;
+	}
+
+	return (hash);
+}
+
+
+static void freeCachedImage(kernelCachedImage *cached)
+{
+	// Release the memory of a cached image that nothing is using
+
+	kernelDebug(debug_loader, "Dropping cached image of %s",
+		cached->fileName);
+
+	kernelDemandPageRelease(KERNELPROCID, cached->code, cached->imageSize);
+	kernelMemoryReleaseSystem(cached->code);
+	kernelFree(cached);
+}
+
+
+static void trimImageCache(void)
+{
+	// Free any stale images that nothing is using, and the least recently
+	// used ones beyond the limit.  The list is in order of most recent use.
+	// The cache should be locked.
+
+	kernelCachedImage **prev = &imageCache;
+	kernelCachedImage *cached = NULL;
+	int unused = 0;
+
+	while (*prev)
+	{
+		cached = *prev;
+
+		if (!cached->users && (cached->stale ||
+			(++unused > LOADER_MAX_CACHED_IMAGES)))
 		{
-			if (table->symbols[count2].value && (!smallestValue ||
-				(table->symbols[count2].value < smallestValue)))
-			{
-				smallestValue = table->symbols[count2].value;
-				smallestPosition = count2;
-			}
+			*prev = cached->next;
+			freeCachedImage(cached);
+			continue;
 		}
 
-		if (smallestValue)
+		prev = &cached->next;
+	}
+}
+
+
+static kernelCachedImage *getCachedImage(const char *fileName,
+	file *theFile)
+{
+	// Look for a cached image of the file, and if there's one that's still
+	// current, move it to the front of the list and count another user of
+	// it.  The cache should be locked.
+
+	kernelCachedImage **prev = &imageCache;
+	kernelCachedImage *cached = NULL;
+
+	for ( ; *prev; prev = &cached->next)
+	{
+		cached = *prev;
+
+		if (cached->stale || strcmp(cached->fileName, fileName))
+			continue;
+
+		if ((cached->fileSize != theFile->size) ||
+			memcmp(&cached->modified, &theFile->modified,
+				sizeof(struct tm)))
 		{
-			memcpy(&tempTable->symbols[tempTable->numSymbols++],
-				&table->symbols[smallestPosition], sizeof(loaderSymbol));
-			table->symbols[smallestPosition].value = NULL;
+			// The file has changed since it was cached
+			cached->stale = 1;
+			continue;
 		}
+
+		*prev = cached->next;
+		cached->next = imageCache;
+		imageCache = cached;
+
+		cached->users += 1;
+		return (cached);
 	}
 
-	// Copy our temporary table's sorted symbols back to the original table
-	memcpy(table->symbols, tempTable->symbols, (tempTable->numSymbols *
-		sizeof(loaderSymbol)));
+	return (cached = NULL);
+}
 
-	table->numSymbols = tempTable->numSymbols;
 
-	kernelFree(tempTable);
-	return (status = 0);
+static kernelCachedImage *cacheImage(const char *fileName, file *theFile,
+	processImage *execImage)
+{
+	// Add a newly laid-out image to the front of the cache, with one user
+
+	int status = 0;
+	kernelCachedImage *cached = NULL;
+
+	cached = kernelMalloc(sizeof(kernelCachedImage));
+	if (!cached)
+		return (cached);
+
+	strncpy(cached->fileName, fileName, MAX_PATH_NAME_LENGTH);
+	memcpy(&cached->modified, &theFile->modified, sizeof(struct tm));
+	cached->fileSize = theFile->size;
+	cached->virtualAddress = execImage->virtualAddress;
+	cached->entryPoint = execImage->entryPoint;
+	cached->code = execImage->code;
+	cached->codeSize = execImage->codeSize;
+	cached->data = execImage->data;
+	cached->dataSize = execImage->dataSize;
+	cached->imageSize = execImage->imageSize;
+	cached->users = 1;
+
+	status = kernelLockGet(&imageCacheLock);
+	if (status < 0)
+	{
+		kernelFree(cached);
+		return (cached = NULL);
+	}
+
+	cached->next = imageCache;
+	imageCache = cached;
+	trimImageCache();
+
+	kernelLockRelease(&imageCacheLock);
+
+	return (cached);
 }
 
 
+static int linkPrivateData(int processId, kernelFileClass *driver,
+	void *loadAddress, processImage *execImage, loaderSymbolTable **symTable)
+{
+	// A dynamically-linked program needs its own copy of the cached image's
+	// data, for its relocations.  Link the copy here, and then put it in
+	// place of the shared data in the new process.
+
+	int status = 0;
+	int currentId = kernelCurrentProcess->processId;
+	void *sharedCode = execImage->code;
+	void *sharedData = execImage->data;
+	unsigned dataOffset = kernelPageRoundDown(sharedData - sharedCode);
+	unsigned dataSize = (execImage->imageSize - dataOffset);
+	void *dataVirtual = (execImage->virtualAddress + dataOffset);
+	void *dataMemory = NULL;
+	unsigned dataPhysical = 0;
+
+	dataMemory = kernelMemoryGet(dataSize, "elf executable data");
+	if (!dataMemory)
+		return (status = ERR_MEMORY);
+
+	status = kernelDemandPageCopy(dataMemory, (sharedCode + dataOffset),
+		dataSize);
+	if (status < 0)
+	{
+		releaseFileData(dataMemory, dataSize);
+		return (status);
+	}
+
+	// The linker only uses the code address to work out where the data goes
+	execImage->data = (dataMemory + ((sharedData - sharedCode) - dataOffset));
+	execImage->code = (execImage->data - (sharedData - sharedCode));
+
+	status = driver->executable.link(processId, loadAddress, execImage,
+		symTable);
+
+	execImage->code = sharedCode;
+	execImage->data = sharedData;
+
+	if (status < 0)
+	{
+		releaseFileData(dataMemory, dataSize);
+		return (status);
+	}
+
+	dataPhysical = kernelPageGetPhysical(currentId, dataMemory);
+
+	status = kernelMemoryChangeOwner(currentId, processId, 0, dataMemory,
+		NULL);
+	if (status < 0)
+	{
+		releaseFileData(dataMemory, dataSize);
+		return (status);
+	}
+
+	status = kernelPageUnmap(processId, dataVirtual, dataSize);
+	if (status >= 0)
+		status = kernelPageMap(processId, dataPhysical, dataVirtual,
+			dataSize);
+	if (status >= 0)
+		status = kernelDemandPageTransfer(processId, dataVirtual, dataSize);
+	if (status < 0)
+		kernelDemandPageRelease(currentId, dataMemory, dataSize);
+
+	kernelPageUnmap(currentId, dataMemory, dataSize);
+
+	return (status);
+}
+
+
+#ifdef DEBUG
+static void debugPhaseTimes(const char *name)
+{
+	static const char *phaseNames[LOADER_NUM_PHASES] = {
+		"read", "classify", "layout", "process", "libraries", "symbols",
+		"relocate", "sort"
+	};
+
+	char buffer[160];
+	uquad_t totalUs = 0;
+	int count;
+
+	buffer[0] = '\0';
+
+	for (count = 0; count < LOADER_NUM_PHASES; count ++)
+	{
+		totalUs += phaseUs[count];
+		snprintf((buffer + strlen(buffer)), (sizeof(buffer) - strlen(buffer)),
+			" %s=%llu", phaseNames[count], phaseUs[count]);
+	}
+
+	kernelDebug(debug_loader, "Loaded %s in %lluus:%s", name, totalUs,
+		buffer);
+}
+#else
+	#define debugPhaseTimes(name) do { } while (0)
+#endif
+
+
 static void populateFileClassList(void)
 {
 	// Populate our list of file classes
@@ -299,7 +514,7 @@ void *kernelLoaderLoad(const char *filename, file *theFile)
 		return (NULL);
 	}
 
-	return (load(filename, theFile, 0 /* not kernel */));
+	return (load(filename, theFile, 0 /* not kernel */, 0 /* not demand */));
 }
 
 
@@ -464,7 +679,7 @@ loaderSymbolTable *kernelLoaderGetSymbols(const char *fileName)
 
 	// Load the file data into memory
 	loadAddress = (unsigned char *) load(fileName, &theFile,
-		1 /* kernel memory */);
+		1 /* kernel memory */, 0 /* not demand */);
 	if (!loadAddress)
 		return (symTable = NULL);
 
@@ -500,7 +715,7 @@ loaderSymbolTable *kernelLoaderGetSymbols(const char *fileName)
 	if (symTable)
 	{
 		// Sort 'em
-		if (sortSymbols(symTable) < 0)
+		if (kernelLoaderSortSymbols(symTable) < 0)
 			kernelDebugError("Couldn't sort symbols");
 	}
 
@@ -508,11 +723,138 @@ loaderSymbolTable *kernelLoaderGetSymbols(const char *fileName)
 }
 
 
+void kernelLoaderHashSymbols(loaderSymbolTable *symTable, int first)
+{
+	// Add the symbols from 'first' onwards to the table's hash chains.  If
+	// 'first' is zero, the whole hash table is rebuilt.  Symbols are put at
+	// the heads of the chains in reverse order, so that a lookup finds the
+	// first of any symbols with the same name, as a linear search would.
+	// Symbols added later come before all of the earlier ones, though.
+
+	unsigned bucket = 0;
+	int count;
+
+	// Check params
+	if (!symTable || !symTable->numBuckets)
+		return;
+
+	if (!first)
+	{
+		for (count = 0; count < symTable->numBuckets; count ++)
+			symTable->buckets[count] = -1;
+	}
+
+	for (count = (symTable->numSymbols - 1); count >= first; count --)
+	{
+		bucket = (hashName(symTable->symbols[count].name) %
+			symTable->numBuckets);
+		symTable->symbols[count].hashNext = symTable->buckets[bucket];
+		symTable->buckets[bucket] = count;
+	}
+}
+
+
+int kernelLoaderSortSymbols(loaderSymbolTable *symTable)
+{
+	// Sort the symbols by value, for address lookups, and discard any
+	// without a value.  This is a merge sort, so symbols with the same value
+	// stay in the same order.  Afterwards, the hash table is rebuilt.
+
+	int status = 0;
+	loaderSymbol *tempSymbols = NULL;
+	loaderSymbol *from = NULL;
+	loaderSymbol *to = NULL;
+	loaderSymbol *swap = NULL;
+	int numSymbols = 0;
+	int width = 0, left = 0, middle = 0, right = 0;
+	int count1, count2, count3;
+
+	// Check params
+	if (!symTable)
+		return (status = ERR_NULLPARAMETER);
+
+	// Squeeze out the symbols with no value
+	for (count1 = 0; count1 < symTable->numSymbols; count1 ++)
+	{
+		if (!symTable->symbols[count1].value)
+			continue;
+
+		if (count1 != numSymbols)
+		{
+			memcpy(&symTable->symbols[numSymbols], &symTable->symbols[count1],
+				sizeof(loaderSymbol));
+		}
+
+		numSymbols += 1;
+	}
+
+	symTable->numSymbols = numSymbols;
+
+	if (numSymbols > 1)
+	{
+		// Get memory for a temporary array of symbols
+		tempSymbols = kernelMalloc(numSymbols * sizeof(loaderSymbol));
+		if (!tempSymbols)
+		{
+			kernelLoaderHashSymbols(symTable, 0);
+			return (status = ERR_MEMORY);
+		}
+
+		from = symTable->symbols;
+		to = tempSymbols;
+
+		// Merge successively larger sorted runs, from one array to the other
+		for (width = 1; width < numSymbols; width *= 2)
+		{
+			for (left = 0; left < numSymbols; left += (width * 2))
+			{
+				middle = min((left + width), numSymbols);
+				right = min((left + (width * 2)), numSymbols);
+
+				count1 = left;
+				count2 = middle;
+
+				for (count3 = left; count3 < right; count3 ++)
+				{
+					if ((count1 < middle) && ((count2 >= right) ||
+						(from[count1].value <= from[count2].value)))
+					{
+						memcpy(&to[count3], &from[count1++],
+							sizeof(loaderSymbol));
+					}
+					else
+					{
+						memcpy(&to[count3], &from[count2++],
+							sizeof(loaderSymbol));
+					}
+				}
+			}
+
+			swap = from;
+			from = to;
+			to = swap;
+		}
+
+		// Make sure the sorted symbols end up in the table
+		if (from != symTable->symbols)
+		{
+			memcpy(symTable->symbols, from,
+				(numSymbols * sizeof(loaderSymbol)));
+		}
+
+		kernelFree(tempSymbols);
+	}
+
+	kernelLoaderHashSymbols(symTable, 0);
+
+	return (status = 0);
+}
+
+
 loaderSymbol *kernelLoaderFindSymbol(const char *name,
 	loaderSymbolTable *symTable)
 {
-	// Returns a pointer to a symbol if it exists in the table and is defined
-	// there
+	// Returns a pointer to a symbol if it exists in the table
 
 	loaderSymbol *symbol = NULL;
 	int count;
@@ -521,6 +863,22 @@ loaderSymbol *kernelLoaderFindSymbol(const char *name,
 	if (!name || !symTable)
 		return (symbol = NULL);
 
+	if (symTable->numBuckets)
+	{
+		// Follow the hash chain
+		count = symTable->buckets[hashName(name) % symTable->numBuckets];
+
+		while (count >= 0)
+		{
+			if (!strcmp(symTable->symbols[count].name, name))
+				return (symbol = &symTable->symbols[count]);
+
+			count = symTable->symbols[count].hashNext;
+		}
+
+		return (symbol = NULL);
+	}
+
 	for (count = 0; count < symTable->numSymbols; count ++)
 	{
 		if (!strcmp(symTable->symbols[count].name, name))
@@ -534,6 +892,16 @@ loaderSymbol *kernelLoaderFindSymbol(const char *name,
 }
 
 
+void kernelLoaderPhaseTime(kernelLoaderPhase phase, uquad_t startUs)
+{
+	// Add the time since 'startUs' to the total for a phase of loading a
+	// program.  The totals are reported in debug output when the program
+	// has been loaded.
+
+	phaseUs[phase] += (kernelCpuGetUs() - startUs);
+}
+
+
 int kernelLoaderCheckCommand(const char *command)
 {
 	// This takes the string of a command to run and checks whether the
@@ -577,8 +945,11 @@ int kernelLoaderLoadProgram(const char *command, int privilege)
 	loaderFileClass fileClass;
 	char procName[MAX_NAME_LENGTH + 1];
 	char tmp[MAX_PATH_NAME_LENGTH + 1];
+	char fullName[MAX_PATH_NAME_LENGTH + 1];
+	kernelCachedImage *cached = NULL;
 	int newProcId = 0;
 	loaderSymbolTable *symTable = NULL;
+	uquad_t startUs = 0;
 
 	// Check params
 	if (!command)
@@ -596,18 +967,26 @@ int kernelLoaderLoadProgram(const char *command, int privilege)
 	if (!execImage.argc)
 		return (status = ERR_NOSUCHFILE);
 
-	// Load the program code/data into memory
+	memset(phaseUs, 0, sizeof(phaseUs));
+
+	// Load the program code/data into memory.  It's only read from the file
+	// as it's touched, which for the most part will be when the new process
+	// runs.
+	startUs = kernelCpuGetUs();
 	loadAddress = (unsigned char *) load(execImage.argv[0], &theFile,
-		0 /* not kernel */);
+		0 /* not kernel */, 1 /* demand */);
 	if (!loadAddress)
 		return (status = ERR_INVALID);
+	kernelLoaderPhaseTime(loader_phase_read, startUs);
 
 	// Try to determine what kind of executable format we're dealing with.
+	startUs = kernelCpuGetUs();
 	fileClassDriver = kernelLoaderClassify(execImage.argv[0], loadAddress,
 		theFile.size, &fileClass);
+	kernelLoaderPhaseTime(loader_phase_classify, startUs);
 	if (!fileClassDriver)
 	{
-		kernelMemoryRelease(loadAddress);
+		releaseFileData(loadAddress, theFile.size);
 		return (status = ERR_INVALID);
 	}
 
@@ -616,22 +995,68 @@ int kernelLoaderLoadProgram(const char *command, int privilege)
 	{
 		kernelError(kernel_error, "File \"%s\" is not an executable program",
 			execImage.argv[0]);
-		kernelMemoryRelease(loadAddress);
+		releaseFileData(loadAddress, theFile.size);
 		return (status = ERR_PERMISSION);
 	}
 
-	// We may need to do some fixup or relocations
-	if (fileClassDriver->executable.layoutExecutable)
+	// If the program has been run before, its laid-out image might still be
+	// in the cache, otherwise lay it out.  The cache is keyed on the full
+	// path name, and checked against the file's size and modified time.
+	status = kernelFileFixupPath(execImage.argv[0], fullName);
+	if (status < 0)
 	{
+		releaseFileData(loadAddress, theFile.size);
+		return (status);
+	}
+
+	status = kernelLockGet(&imageCacheLock);
+	if (status < 0)
+	{
+		releaseFileData(loadAddress, theFile.size);
+		return (status);
+	}
+
+	cached = getCachedImage(fullName, &theFile);
+
+	kernelLockRelease(&imageCacheLock);
+
+	if (!cached)
+	{
+		if (!fileClassDriver->executable.layoutExecutable)
+		{
+			releaseFileData(loadAddress, theFile.size);
+			return (status = ERR_NOTIMPLEMENTED);
+		}
+
+		startUs = kernelCpuGetUs();
 		status = fileClassDriver->executable.layoutExecutable(loadAddress,
 			&execImage);
 		if (status < 0)
 		{
-			kernelMemoryRelease(loadAddress);
+			releaseFileData(loadAddress, theFile.size);
 			return (status);
 		}
+		kernelLoaderPhaseTime(loader_phase_layout, startUs);
+
+		cached = cacheImage(fullName, &theFile, &execImage);
+		if (!cached)
+		{
+			kernelDemandPageRelease(KERNELPROCID, execImage.code,
+				execImage.imageSize);
+			kernelMemoryReleaseSystem(execImage.code);
+			releaseFileData(loadAddress, theFile.size);
+			return (status = ERR_MEMORY);
+		}
 	}
 
+	execImage.virtualAddress = cached->virtualAddress;
+	execImage.entryPoint = cached->entryPoint;
+	execImage.code = cached->code;
+	execImage.codeSize = cached->codeSize;
+	execImage.data = cached->data;
+	execImage.dataSize = cached->dataSize;
+	execImage.imageSize = cached->imageSize;
+
 	// Just get the program name without the path in order to set the process
 	// name
 	status = kernelFileSeparateLast(execImage.argv[0], tmp, procName);
@@ -639,57 +1064,118 @@ int kernelLoaderLoadProgram(const char *command, int privilege)
 		strncpy(procName, command, MAX_NAME_LENGTH);
 
 	// Create the user program as a process in the multitasker
+	startUs = kernelCpuGetUs();
 	newProcId = kernelMultitaskerCreateProcess(procName, privilege,
 		&execImage);
+	kernelLoaderPhaseTime(loader_phase_process, startUs);
 	if (newProcId < 0)
 	{
 		// Release the memory we allocated for the program
-		kernelMemoryRelease(loadAddress);
-		kernelMemoryRelease(execImage.code);
+		releaseFileData(loadAddress, theFile.size);
+		kernelLoaderReleaseImage(cached);
 		return (newProcId);
 	}
 
+	// The process has one of the image's users, until it goes away
+	kernelMultitaskerSetCachedImage(newProcId, cached);
+
+	// Any of the image that hasn't been read in yet gets read in when the
+	// new process touches it
+	status = kernelDemandPageShare(newProcId, execImage.virtualAddress,
+		execImage.imageSize);
+	if (status < 0)
+		kernelError(kernel_warn, "Unable to share demand-loaded memory");
+
 	if (fileClass.subType & LOADERFILESUBCLASS_DYNAMIC)
 	{
 		// It's a dynamically-linked program, so we need to link in the
-		// required libraries
+		// required libraries.  The driver times the phases of linking.
 		if (fileClassDriver->executable.link)
 		{
-			status = fileClassDriver->executable.link(newProcId, loadAddress,
+			status = linkPrivateData(newProcId, fileClassDriver, loadAddress,
 				&execImage, &symTable);
 			if (status < 0)
 			{
-				kernelMemoryRelease(loadAddress);
-				kernelMemoryRelease(execImage.code);
+				releaseFileData(loadAddress, theFile.size);
 				return (status);
 			}
 		}
+
+		// Sort the combined symbols, for address lookups
+		if (symTable)
+		{
+			startUs = kernelCpuGetUs();
+			if (kernelLoaderSortSymbols(symTable) < 0)
+				kernelDebugError("Couldn't sort symbols");
+			kernelLoaderPhaseTime(loader_phase_sort, startUs);
+		}
 	}
-	else
+	else if (fileClassDriver->executable.getSymbols)
 	{
-		symTable = kernelLoaderGetSymbols(execImage.argv[0]);
+		// Get the symbols from the file data we already have, rather than
+		// loading the file again
+		startUs = kernelCpuGetUs();
+		symTable = fileClassDriver->executable.getSymbols(loadAddress,
+			0 /* not kernel */);
+		if (symTable && (kernelLoaderSortSymbols(symTable) < 0))
+			kernelDebugError("Couldn't sort symbols");
+		kernelLoaderPhaseTime(loader_phase_symbols, startUs);
 	}
 
 	if (symTable)
 		kernelMultitaskerSetSymbols(newProcId, symTable);
 
-	// Unmap the new process' image memory from this process' address space.
-	status = kernelPageUnmap(kernelCurrentProcess->processId, execImage.code,
-		execImage.imageSize);
-	if (status < 0)
-	{
-		kernelError(kernel_warn, "Unable to unmap new process memory from "
-			"current process");
-	}
-
 	// Get rid of the old file memory
-	kernelMemoryRelease(loadAddress);
+	releaseFileData(loadAddress, theFile.size);
+
+	debugPhaseTimes(procName);
 
 	// All set.  Return the process id.
 	return (newProcId);
 }
 
 
+void kernelLoaderReleaseImage(kernelCachedImage *cached)
+{
+	// Called when a process running a cached image goes away
+
+	if (!cached)
+		return;
+
+	if (kernelLockGet(&imageCacheLock) < 0)
+		return;
+
+	if (cached->users > 0)
+		cached->users -= 1;
+
+	trimImageCache();
+
+	kernelLockRelease(&imageCacheLock);
+}
+
+
+void kernelLoaderFlushImageCache(void)
+{
+	// Drop all of the cached images that nothing is using, for example
+	// because one of the files they're loaded from is going to be changed
+
+	kernelCachedImage *cached = NULL;
+
+	if (kernelLockGet(&imageCacheLock) < 0)
+		return;
+
+	for (cached = imageCache; cached; cached = cached->next)
+	{
+		if (!cached->users)
+			cached->stale = 1;
+	}
+
+	trimImageCache();
+
+	kernelLockRelease(&imageCacheLock);
+}
+
+
 int kernelLoaderLoadLibrary(const char *libraryName)
 {
 	// This takes the name of a library to load and creates a shared dynamic
@@ -717,7 +1203,7 @@ int kernelLoaderLoadLibrary(const char *libraryName)
 
 	// Load the program code/data into memory
 	loadAddress = (unsigned char *) load(libraryName, &theFile,
-		1 /* kernel */);
+		1 /* kernel */, 0 /* not demand */);
 	if (!loadAddress)
 		return (status = ERR_INVALID);
 
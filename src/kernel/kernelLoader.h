@@ -29,6 +29,7 @@
 #include <sys/file.h>
 #include <sys/image.h>
 #include <sys/process.h>
+#include <sys/types.h>
 
 #define FILECLASS_NAME_DIR		"directory"
 #define FILECLASS_NAME_EMPTY	"empty"
@@ -78,6 +79,21 @@
 #define FILECLASS_NAME_HTML		"HTML"
 #define FILECLASS_NAME_UTF8		"UTF-8"
 
+// The number of hash buckets in a symbol table with the given number of
+// symbols.  Symbol tables keep the buckets after the symbols, and before the
+// strings.
+#define LOADER_SYMBOL_BUCKETS(numSymbols)	((numSymbols) | 1)
+
+// Phases of loading a program, for timing
+typedef enum {
+	loader_phase_read, loader_phase_classify, loader_phase_layout,
+	loader_phase_process, loader_phase_libraries, loader_phase_symbols,
+	loader_phase_relocate, loader_phase_sort
+
+} kernelLoaderPhase;
+
+#define LOADER_NUM_PHASES	(loader_phase_sort + 1)
+
 // A generic structure to represent a relocation entry
 typedef struct {
 	void *offset;		// Virtual offset in image
@@ -141,6 +157,29 @@ typedef struct _kernelDynamicLibrary {
 
 } kernelDynamicLibrary;
 
+// The most program images kept in the image cache when nothing is using them
+#define LOADER_MAX_CACHED_IMAGES	16
+
+// A laid-out program image in the loader's image cache.  Its memory belongs
+// to the kernel, and is mapped into each process running the program, with
+// the code read-only and the data copied when it's first written.
+typedef struct _kernelCachedImage {
+	char fileName[MAX_PATH_NAME_LENGTH + 1];
+	struct tm modified;
+	unsigned fileSize;
+	void *virtualAddress;
+	void *entryPoint;
+	void *code;
+	unsigned codeSize;
+	void *data;
+	unsigned dataSize;
+	unsigned imageSize;
+	int users;
+	int stale;
+	struct _kernelCachedImage *next;
+
+} kernelCachedImage;
+
 // Functions exported by kernelLoader.c
 void *kernelLoaderLoad(const char *, file *);
 kernelFileClass *kernelLoaderGetFileClass(const char *);
@@ -148,9 +187,14 @@ kernelFileClass *kernelLoaderClassify(const char *, void *, unsigned,
 	loaderFileClass *);
 kernelFileClass *kernelLoaderClassifyFile(const char *, loaderFileClass *);
 loaderSymbolTable *kernelLoaderGetSymbols(const char *);
+void kernelLoaderHashSymbols(loaderSymbolTable *, int);
+int kernelLoaderSortSymbols(loaderSymbolTable *);
 loaderSymbol *kernelLoaderFindSymbol(const char *, loaderSymbolTable *);
+void kernelLoaderPhaseTime(kernelLoaderPhase, uquad_t);
 int kernelLoaderCheckCommand(const char *);
 int kernelLoaderLoadProgram(const char *, int);
+void kernelLoaderReleaseImage(kernelCachedImage *);
+void kernelLoaderFlushImageCache(void);
 int kernelLoaderLoadLibrary(const char *);
 kernelDynamicLibrary *kernelLoaderGetLibrary(const char *);
 kernelDynamicLibrary *kernelLoaderLinkLibrary(const char *);
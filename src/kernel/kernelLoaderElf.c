@@ -23,7 +23,9 @@
 // and object files.
 
 #include "kernelLoaderElf.h"
+#include "kernelCpu.h"
 #include "kernelDebug.h"
+#include "kernelDemandPage.h"
 #include "kernelError.h"
 #include "kernelLoader.h"
 #include "kernelMalloc.h"
@@ -219,7 +221,9 @@ static loaderSymbolTable *getSymbols(void *data, int kernel)
 	symbols = (data + symbolTableHeader->sh_offset);
 	numSymbols = (symbolTableHeader->sh_size / (int) sizeof(Elf32Symbol));
 	symTableSize = (sizeof(loaderSymbolTable) +
-		(numSymbols * sizeof(loaderSymbol)) + stringTableHeader->sh_size);
+		(numSymbols * sizeof(loaderSymbol)) +
+		(LOADER_SYMBOL_BUCKETS(numSymbols) * sizeof(int)) +
+		stringTableHeader->sh_size);
 
 	// Get memory for the symbol table
 	if (kernel)
@@ -232,8 +236,11 @@ static loaderSymbolTable *getSymbols(void *data, int kernel)
 	// Set up the structure
 	symTable->numSymbols = (numSymbols - 1);
 	symTable->tableSize = symTableSize;
-	symTableData = (void *)((unsigned) symTable + sizeof(loaderSymbolTable) +
-		(numSymbols * sizeof(loaderSymbol)));
+	symTable->numBuckets = LOADER_SYMBOL_BUCKETS(numSymbols);
+	symTable->buckets = (int *)((unsigned) symTable +
+		sizeof(loaderSymbolTable) + (numSymbols * sizeof(loaderSymbol)));
+	symTableData = (void *)((unsigned) symTable->buckets +
+		(symTable->numBuckets * sizeof(int)));
 
 	// Copy the string table data
 	memcpy(symTableData, (data + stringTableHeader->sh_offset),
@@ -267,6 +274,8 @@ static loaderSymbolTable *getSymbols(void *data, int kernel)
 			symTable->symbols[count - 1].type = LOADERSYMBOLTYPE_FILE;
 	}
 
+	kernelLoaderHashSymbols(symTable, 0);
+
 	return (symTable);
 }
 
@@ -403,7 +412,10 @@ static int layoutCodeAndData(void *loadAddress, processImage *execImage,
 				"(%x)", srcAddr, destAddr, programHeader[count].p_filesz,
 				programHeader[count].p_filesz);
 
-			memcpy(destAddr, srcAddr, programHeader[count].p_filesz);
+			// Images are filled on demand straight from the file, if the
+			// file data hasn't been read in yet
+			kernelDemandPageCopy(destAddr, srcAddr,
+				programHeader[count].p_filesz);
 
 			// Code segment?
 			if (programHeader[count].p_flags == (ELFPF_R | ELFPF_X))
@@ -516,24 +528,30 @@ static int resolveLibrarySymbols(loaderSymbolTable **symTable,
 	// resolveable symbols resolved.
 
 	int status = 0;
+	int maxSymbols = 0;
 	int newTableSize = 0;
 	loaderSymbolTable *newTable = NULL;
 	char *newTableData = NULL;
 	loaderSymbol *symbol = NULL;
 	loaderSymbol *newSymbol = NULL;
+	int hashNext = 0;
 	int count;
 
-	// First get memory for the new combined table
-	newTableSize = ((*symTable)->tableSize + library->symbolTable->tableSize);
+	// First get memory for the new combined table, with room for a hash
+	// table big enough for all the symbols
+	maxSymbols = ((*symTable)->numSymbols + library->symbolTable->numSymbols);
+	newTableSize = ((*symTable)->tableSize + library->symbolTable->tableSize +
+		(LOADER_SYMBOL_BUCKETS(maxSymbols) * sizeof(int)));
 	newTable = kernelMalloc(newTableSize);
 	if (!newTable)
 		return (status = ERR_MEMORY);
 
 	newTable->tableSize = newTableSize;
-	newTableData = (void *)
-		(((unsigned) newTable + sizeof(loaderSymbolTable)) +
-		(((*symTable)->numSymbols + library->symbolTable->numSymbols) *
-			sizeof(loaderSymbol)));
+	newTable->numBuckets = LOADER_SYMBOL_BUCKETS(maxSymbols);
+	newTable->buckets = (int *)((unsigned) newTable +
+		sizeof(loaderSymbolTable) + (maxSymbols * sizeof(loaderSymbol)));
+	newTableData = (void *)((unsigned) newTable->buckets +
+		(newTable->numBuckets * sizeof(int)));
 
 	// Copy over the symbols of the first table
 	for (count = 0; count < (*symTable)->numSymbols; count ++)
@@ -550,6 +568,8 @@ static int resolveLibrarySymbols(loaderSymbolTable **symTable,
 		newTable->numSymbols += 1;
 	}
 
+	kernelLoaderHashSymbols(newTable, 0);
+
 	// Loop through the symbols of the library.  If a symbol is undefined
 	// in the new table and defined in the library, define it.  If a symbol
 	// doesn't exist in the new table and defined in the library, add it.
@@ -572,8 +592,11 @@ static int resolveLibrarySymbols(loaderSymbolTable **symTable,
 		{
 			if (!newSymbol->defined)
 			{
+				// Keep its place in the hash chain
+				hashNext = newSymbol->hashNext;
 				memcpy(newSymbol, symbol, sizeof(loaderSymbol));
 				newSymbol->value += (unsigned) library->codeVirtual;
+				newSymbol->hashNext = hashNext;
 			}
 		}
 		else
@@ -586,6 +609,9 @@ static int resolveLibrarySymbols(loaderSymbolTable **symTable,
 			newSymbol->value += (unsigned) library->codeVirtual;
 			newTableData += (strlen(newSymbol->name) + 1);
 			newTable->numSymbols += 1;
+
+			// It's not already there, so it can go at the head of its chain
+			kernelLoaderHashSymbols(newTable, (newTable->numSymbols - 1));
 		}
 	}
 
@@ -610,7 +636,8 @@ static kernelRelocationTable *getRelocations(void *loadAddress,
 	int tableSize = 0;
 	Elf32Symbol *symArray = NULL;
 	Elf32Rel *relArray = NULL;
-	int count1, count2, count3;
+	loaderSymbol *symbol = NULL;
+	int count1, count2;
 
 	#define RELOC_SECTIONS 2
 
@@ -714,14 +741,11 @@ static kernelRelocationTable *getRelocations(void *loadAddress,
 					sym->st_name);
 
 				// Find the symbol in our symbol table
-				for (count3 = 0; count3 < symbols->numSymbols; count3 ++)
+				symbol = kernelLoaderFindSymbol(symName, symbols);
+				if (symbol)
 				{
-					if (!strcmp(symbols->symbols[count3].name, symName))
-					{
-						table->relocations[table->numRelocs].symbolName =
-							symbols->symbols[count3].name;
-						break;
-					}
+					table->relocations[table->numRelocs].symbolName =
+						symbol->name;
 				}
 
 				if (!table->relocations[table->numRelocs].symbolName)
@@ -760,6 +784,14 @@ static int doRelocations(void *dataAddress, void *codeVirtualAddress,
 	// Loop for each relocation
 	for (count1 = 0; count1 < relocTable->numRelocs; count1 ++)
 	{
+		// Relocations can only be done in the data, since the code is
+		// shared
+		if (relocTable->relocations[count1].offset < (void *) dataOffset)
+		{
+			kernelError(kernel_error, "Relocation in code is not supported");
+			return (status = ERR_NOTIMPLEMENTED);
+		}
+
 		// Get the address of the relocation
 		relocation = (dataAddress + (unsigned)
 			(relocTable->relocations[count1].offset - dataOffset));
@@ -943,8 +975,9 @@ static int layoutExecutable(void *loadAddress, processImage *execImage)
 	// already sure that this file is both ELF and an executable.  Thus, we
 	// will not check the magic number stuff at the head of the file.
 
-	status =
-		layoutCodeAndData(loadAddress, execImage, 0 /* not kernel memory */);
+	// The image goes in kernel memory, since it's cached by the loader and
+	// shared between the processes running it
+	status = layoutCodeAndData(loadAddress, execImage, 1 /* kernel memory */);
 	if (status < 0)
 		return (status);
 
@@ -963,6 +996,7 @@ static int pullInLibrary(int processId, kernelDynamicLibrary *library,
 	unsigned dataOffset = 0;
 	void *dataMem = NULL;
 	unsigned libraryDataPhysical = 0;
+	uquad_t startUs = kernelCpuGetUs();
 
 	kernelDebug(debug_loader, "ELF pull in library %s", library->name);
 
@@ -1057,13 +1091,17 @@ static int pullInLibrary(int processId, kernelDynamicLibrary *library,
 
 	kernelDebug(debug_loader, "ELF set code page attrs");
 
+	kernelLoaderPhaseTime(loader_phase_libraries, startUs);
+
 	// Resolve symbols
+	startUs = kernelCpuGetUs();
 	status = resolveLibrarySymbols(symbols, library);
 	if (status < 0)
 	{
 		kernelMemoryRelease(dataMem);
 		return (status);
 	}
+	kernelLoaderPhaseTime(loader_phase_symbols, startUs);
 
 	kernelDebug(debug_loader, "ELF resolved library symbols");
 
@@ -1079,6 +1117,7 @@ static int resolveLibraryDependencies(int processId,
 
 	int status = 0;
 	kernelDynamicLibrary *library = NULL;
+	uquad_t startUs = 0;
 	int count;
 
 	// For each library in our list,
@@ -1091,6 +1130,7 @@ static int resolveLibraryDependencies(int processId,
 	}
 
 	// Do relocations for each library.  All symbols should now be resolved
+	startUs = kernelCpuGetUs();
 	for (count = 0; count < libArray->numLibraries; count ++)
 	{
 		library = &libArray->libraries[count];
@@ -1100,6 +1140,7 @@ static int resolveLibraryDependencies(int processId,
 		if (status < 0)
 			return (status);
 	}
+	kernelLoaderPhaseTime(loader_phase_relocate, startUs);
 
 	return (status = 0);
 }
@@ -1115,6 +1156,7 @@ static int link(int processId, void *loadAddress, processImage *execImage,
 	int status = 0;
 	elfLibraryArray libArray;
 	kernelRelocationTable *relocations = NULL;
+	uquad_t startUs = 0;
 	int count;
 
 	// We will assume we this function is not called unless the loader is
@@ -1122,11 +1164,14 @@ static int link(int processId, void *loadAddress, processImage *execImage,
 	// will not check the magic number stuff at the head of the file.
 
 	// Get the dynamic symbols for the program
+	startUs = kernelCpuGetUs();
 	*symbols = getSymbols(loadAddress, 1 /* kernel */);
 	if (!*symbols)
 		return (status = ERR_NODATA);
+	kernelLoaderPhaseTime(loader_phase_symbols, startUs);
 
 	// Get any library dependencies
+	startUs = kernelCpuGetUs();
 	status = getLibraryDependencies(loadAddress, &libArray);
 	if (status < 0)
 	{
@@ -1134,6 +1179,7 @@ static int link(int processId, void *loadAddress, processImage *execImage,
 		*symbols = NULL;
 		return (status);
 	}
+	kernelLoaderPhaseTime(loader_phase_libraries, startUs);
 
 	// Resolve the dependencies
 	status = resolveLibraryDependencies(processId, symbols, &libArray);
@@ -1146,6 +1192,7 @@ static int link(int processId, void *loadAddress, processImage *execImage,
 	}
 
 	// Get the relocations for the program code
+	startUs = kernelCpuGetUs();
 	relocations =
 		getRelocations(loadAddress, *symbols, execImage->virtualAddress);
 	if (!relocations)
@@ -1167,6 +1214,7 @@ static int link(int processId, void *loadAddress, processImage *execImage,
 		kernelFree(libArray.libraries);
 		return (status);
 	}
+	kernelLoaderPhaseTime(loader_phase_relocate, startUs);
 
 	// Make the process own the memory for each library's data, and unmap it
 	// from the memory of this process.
@@ -1213,6 +1261,10 @@ static int hotLink(kernelDynamicLibrary *library)
 	if (status < 0)
 		return (status);
 
+	// Sort the combined symbols, for address lookups
+	if (kernelLoaderSortSymbols(symbols) < 0)
+		kernelDebugError("Couldn't sort symbols");
+
 	// Set the symbol table
 	kernelMultitaskerSetSymbols(kernelCurrentProcess->processId, symbols);
 
@@ -46,6 +46,7 @@ static unsigned char * volatile freeBlockBitmap = NULL;
 static volatile int totalBlocks = 0;
 static volatile unsigned totalFree = 0;
 static volatile unsigned totalUsed = 0;
+static unsigned short * volatile shareCounts = NULL;
 
 // This structure can be used to "reserve" memory blocks so that they will be
 // marked as "used" by the memory manager and then left alone.  It should be
@@ -310,6 +311,29 @@ static int findBlock(unsigned memory)
 }
 
 
+static int findBlockContaining(unsigned memory)
+{
+	// Search the used block list for the one containing the supplied physical
+	// address.  If found, return the index of the block (else negative error
+	// code).
+
+	int index = 0;
+
+	for (index = 0; ((index < usedBlocks) && (index < MAXMEMORYBLOCKS));
+		index ++)
+	{
+		if ((usedBlockList[index]->startLocation <= memory) &&
+			(usedBlockList[index]->endLocation >= memory))
+		{
+			return (index);
+		}
+	}
+
+	// Not found
+	return (ERR_NOSUCHENTRY);
+}
+
+
 static int releaseBlock(int index)
 {
 	// This function will remove a block from the used block list, mark the
@@ -362,6 +386,40 @@ static int releaseBlock(int index)
 }
 
 
+static int unshare(unsigned physical, unsigned size)
+{
+	// Drop one reference to each of the pages of copy-on-write shared memory.
+	// When none of the pages of the block have any references left, release
+	// it.  The memory data should be locked.
+
+	int status = 0;
+	int index = 0;
+	unsigned page = 0;
+	unsigned count;
+
+	index = findBlockContaining(physical);
+	if (index < 0)
+		return (status = index);
+
+	for (count = 0; count < size; count += MEMORY_BLOCK_SIZE)
+	{
+		page = ((physical + count) / MEMORY_BLOCK_SIZE);
+		if (shareCounts[page])
+			shareCounts[page] -= 1;
+	}
+
+	for (page = (usedBlockList[index]->startLocation / MEMORY_BLOCK_SIZE);
+		page <= (usedBlockList[index]->endLocation / MEMORY_BLOCK_SIZE);
+		page ++)
+	{
+		if (shareCounts[page])
+			return (status = 0);
+	}
+
+	return (status = releaseBlock(index));
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -906,6 +964,7 @@ int kernelMemoryRelease(void *virtual)
 	int pid = 0;
 	unsigned physical = 0;
 	int index = 0;
+	unsigned blockSize = 0;
 
 	// Make sure the memory manager has been initialized
 	if (!initialized)
@@ -956,17 +1015,23 @@ int kernelMemoryRelease(void *virtual)
 	{
 		// Now that we know the index of the memory block, we can get the
 		// size, and unmap it from the virtual address space
-		status = kernelPageUnmap(pid, virtual,
-			(usedBlockList[index]->endLocation -
-				usedBlockList[index]->startLocation + 1));
+		blockSize = (usedBlockList[index]->endLocation -
+			usedBlockList[index]->startLocation + 1);
+
+		status = kernelPageUnmap(pid, virtual, blockSize);
 		if (status < 0)
 		{
 			kernelError(kernel_error, "Unable to unmap memory from the "
 				"virtual address space");
 		}
 
-		// Call the releaseBlock function with this block's index
-		status = releaseBlock(index);
+		// If it's copy-on-write shared memory, only this reference to it
+		// goes.  Otherwise call the releaseBlock function with this block's
+		// index.
+		if (shareCounts && shareCounts[physical / MEMORY_BLOCK_SIZE])
+			status = unshare(physical, blockSize);
+		else
+			status = releaseBlock(index);
 	}
 	else
 	{
@@ -1195,6 +1260,251 @@ int kernelMemoryShare(int sharerPid, int shareePid, void *oldVirtual,
 }
 
 
+int kernelMemoryShareCopyOnWrite(int sharerPid, int shareePid,
+	void *oldVirtual, void **newVirtual)
+{
+	// Give another process a copy of a block of memory owned by one process,
+	// without copying it.  Both processes map the same pages, read-only, and
+	// whichever writes to them first gets its own copy of them then.  The
+	// memory belongs to the kernel while it's shared, and is released along
+	// with the last reference to it.  Memory that's already shared this way
+	// can be shared again.
+
+	int status = 0;
+	unsigned short *counts = NULL;
+	unsigned physical = 0;
+	int index = 0;
+	unsigned blockSize = 0;
+	unsigned page = 0;
+
+	// Make sure the memory manager has been initialized
+	if (!initialized)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Check params
+	if (!oldVirtual || !newVirtual)
+		return (status = ERR_NULLPARAMETER);
+
+	if (oldVirtual >= (void *) KERNEL_VIRTUAL_ADDRESS)
+	{
+		kernelError(kernel_error, "Can't share kernel memory copy-on-write");
+		return (status = ERR_INVALID);
+	}
+
+	// The reference counts for each page are only needed once something is
+	// shared
+	if (!shareCounts)
+	{
+		counts = kernelMalloc(totalBlocks * sizeof(unsigned short));
+		if (!counts)
+			return (status = ERR_MEMORY);
+
+		memset(counts, 0, (totalBlocks * sizeof(unsigned short)));
+	}
+
+	// Turn the virtual address into a physical one
+	physical = kernelPageGetPhysical(sharerPid, oldVirtual);
+	if (!physical)
+	{
+		kernelError(kernel_error, "The memory pointer is NULL");
+		if (counts)
+			kernelFree(counts);
+		return (status = ERR_NOSUCHENTRY);
+	}
+
+	// Obtain a lock on the memory data
+	status = kernelLockGet(&memoryLock);
+	if (status < 0)
+	{
+		if (counts)
+			kernelFree(counts);
+		return (status);
+	}
+
+	if (counts)
+	{
+		if (!shareCounts)
+			shareCounts = counts;
+		else
+			kernelFree(counts);
+	}
+
+	// Try to find the block
+	index = findBlock(physical);
+	if (index < 0)
+	{
+		kernelLockRelease(&memoryLock);
+		return (status = index);
+	}
+
+	if ((usedBlockList[index]->processId != sharerPid) &&
+		!shareCounts[physical / MEMORY_BLOCK_SIZE])
+	{
+		kernelError(kernel_error, "Attempt to share memory from incorrect "
+			"owner (%d should be %d)", sharerPid,
+			usedBlockList[index]->processId);
+		kernelLockRelease(&memoryLock);
+		return (status = ERR_PERMISSION);
+	}
+
+	blockSize = ((usedBlockList[index]->endLocation -
+		usedBlockList[index]->startLocation) + 1);
+
+	// Map the memory into the sharee's address space.  That takes the lock
+	// on its page directory, so it can't be done while we hold the memory
+	// lock: deleting a page directory takes the same locks the other way
+	// around.
+	kernelLockRelease(&memoryLock);
+
+	status = kernelPageMapToFree(shareePid, physical, newVirtual, blockSize);
+	if (status < 0)
+		return (status);
+
+	status = kernelLockGet(&memoryLock);
+	if (status < 0)
+	{
+		kernelPageUnmap(shareePid, *newVirtual, blockSize);
+		return (status);
+	}
+
+	// Make sure the block didn't change while we weren't holding the lock
+	index = findBlock(physical);
+	if ((index < 0) || (((usedBlockList[index]->endLocation -
+		usedBlockList[index]->startLocation) + 1) != blockSize) ||
+		((usedBlockList[index]->processId != sharerPid) &&
+			!shareCounts[physical / MEMORY_BLOCK_SIZE]))
+	{
+		kernelLockRelease(&memoryLock);
+		kernelError(kernel_error, "Memory changed while being shared");
+		kernelPageUnmap(shareePid, *newVirtual, blockSize);
+		return (status = ERR_BUSY);
+	}
+
+	// Count the references, including the sharer's own, if it's the first
+	// time
+	for (page = (physical / MEMORY_BLOCK_SIZE);
+		page < ((physical + blockSize) / MEMORY_BLOCK_SIZE); page ++)
+	{
+		if (!shareCounts[page])
+			shareCounts[page] = 2;
+		else
+			shareCounts[page] += 1;
+	}
+
+	usedBlockList[index]->processId = KERNELPROCID;
+
+	kernelLockRelease(&memoryLock);
+
+	// Now neither of them can write to it without getting a copy
+	status = kernelPageSetAttrs(sharerPid, pageattr_copyonwrite, oldVirtual,
+		blockSize);
+	if (status >= 0)
+		status = kernelPageSetAttrs(sharerPid, pageattr_shared, oldVirtual,
+			blockSize);
+	if (status >= 0)
+		status = kernelPageSetAttrs(shareePid, pageattr_copyonwrite,
+			*newVirtual, blockSize);
+	if (status >= 0)
+		status = kernelPageSetAttrs(shareePid, pageattr_shared, *newVirtual,
+			blockSize);
+
+	return (status);
+}
+
+
+int kernelMemoryGetShares(unsigned physical, unsigned *start, unsigned *size)
+{
+	// Returns the number of copy-on-write references to the page of memory,
+	// and if there are any, the physical extent of its memory block
+
+	int status = 0;
+	int index = 0;
+
+	if (!shareCounts || !shareCounts[physical / MEMORY_BLOCK_SIZE])
+		return (status = 0);
+
+	status = kernelLockGet(&memoryLock);
+	if (status < 0)
+		return (status);
+
+	index = findBlockContaining(physical);
+	if (index >= 0)
+	{
+		if (start)
+			*start = usedBlockList[index]->startLocation;
+		if (size)
+			*size = ((usedBlockList[index]->endLocation -
+				usedBlockList[index]->startLocation) + 1);
+
+		status = shareCounts[physical / MEMORY_BLOCK_SIZE];
+	}
+	else
+	{
+		status = index;
+	}
+
+	kernelLockRelease(&memoryLock);
+	return (status);
+}
+
+
+int kernelMemoryUnshare(unsigned physical, unsigned size)
+{
+	// Drop a reference to copy-on-write shared memory, such as when a process
+	// has copied it or exits
+
+	int status = 0;
+
+	if (!shareCounts)
+		return (status = 0);
+
+	status = kernelLockGet(&memoryLock);
+	if (status < 0)
+		return (status);
+
+	status = unshare(physical, size);
+
+	kernelLockRelease(&memoryLock);
+	return (status);
+}
+
+
+void *kernelMemoryCopyToProcess(void *buffer, int processId)
+{
+	// Gives the process a copy-on-write copy of a block of the current
+	// process' memory, which is a cheap way to hand over a large buffer.
+	// Returns the address of the copy in the other process.
+
+	int currentId = kernelMultitaskerGetCurrentProcessId();
+	int privilege = 0;
+	void *newVirtual = NULL;
+
+	// Check params
+	if (!buffer)
+		return (newVirtual = NULL);
+
+	privilege = kernelMultitaskerGetProcessPrivilege(processId);
+	if (privilege < 0)
+		return (newVirtual = NULL);
+
+	// A process can't give memory to a more privileged one
+	if (kernelMultitaskerGetProcessPrivilege(currentId) > privilege)
+	{
+		kernelError(kernel_error, "Process %d can't give memory to more "
+			"privileged process %d", currentId, processId);
+		return (newVirtual = NULL);
+	}
+
+	if (kernelMemoryShareCopyOnWrite(currentId, processId, buffer,
+		&newVirtual) < 0)
+	{
+		return (newVirtual = NULL);
+	}
+
+	return (newVirtual);
+}
+
+
 int kernelMemoryGetStats(memoryStats *stats, int kernel)
 {
 	// Return overall memory usage statistics
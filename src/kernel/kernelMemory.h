@@ -54,6 +54,9 @@ int kernelMemoryGetIo(unsigned, unsigned, int, const char *,
 int kernelMemoryReleaseIo(kernelIoMemory *);
 int kernelMemoryChangeOwner(int, int, int, void *, void **);
 int kernelMemoryShare(int, int, void *, void **);
+int kernelMemoryShareCopyOnWrite(int, int, void *, void **);
+int kernelMemoryGetShares(unsigned, unsigned *, unsigned *);
+int kernelMemoryUnshare(unsigned, unsigned);
 
 // Functions exported to userspace
 void *kernelMemoryGet(unsigned, const char *);
@@ -61,6 +64,7 @@ int kernelMemoryRelease(void *);
 int kernelMemoryReleaseAllByProcId(int);
 int kernelMemoryGetStats(memoryStats *, int);
 int kernelMemoryGetBlocks(memoryBlock *, unsigned, int);
+void *kernelMemoryCopyToProcess(void *, int);
 
 #endif
 
@@ -40,62 +40,37 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <sys/cdefs.h>
 #include <sys/guid.h>
 #include <sys/processor.h>
 #include <sys/utsname.h>
 #include <sys/vis.h>
 
-static unsigned long  crcTable[256] = {
-	0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
-	0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
-	0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
-	0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
-	0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
-	0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
-	0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
-	0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
-	0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
-	0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
-	0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
-	0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
-	0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
-	0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
-	0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
-	0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
-	0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
-	0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
-	0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
-	0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
-	0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
-	0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
-	0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
-	0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
-	0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
-	0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
-	0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
-	0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
-	0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
-	0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
-	0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
-	0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
-	0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
-	0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
-	0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
-	0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
-	0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
-	0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
-	0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
-	0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
-	0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
-	0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
-	0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
-};
-
 char *kernelVersion[] = {
 	"Visopsys",
 	_KVERSION_
 };
 
+// A cache of parsed config files, so that getting or setting a single
+// variable doesn't mean reading and parsing the whole file each time.  An
+// entry goes stale whenever its file is written, truncated, moved, deleted,
+// or dropped from the file entry buffer.
+#define CONFIG_CACHE_ENTRIES	16
+
+typedef struct {
+	char fileName[MAX_PATH_NAME_LENGTH + 1];
+	kernelFileEntry *fileEntry;
+	volatile int stale;
+	variableList list;
+	unsigned lastUse;
+
+} configCacheEntry;
+
+static configCacheEntry configCache[CONFIG_CACHE_ENTRIES];
+static spinLock configCacheLock;
+static unsigned configCacheUses = 0;
+static configCacheStats cacheStats;
+
 
 static void walkStack(kernelProcess *traceProcess, void *stackMemory,
 	unsigned stackSize, long memoryOffset, void **framePointer, char *buffer,
@@ -241,6 +216,109 @@ static int configRead(const char *fileName, variableList *list, int system)
 }
 
 
+static void configCacheDrop(configCacheEntry *entry)
+{
+	// Empty a config cache entry.  The cache lock must be held.
+
+	if (entry->fileName[0])
+	{
+		variableListDestroy(&entry->list);
+		entry->fileName[0] = '\0';
+		cacheStats.entries -= 1;
+	}
+
+	entry->fileEntry = NULL;
+	entry->lastUse = 0;
+}
+
+
+static configCacheEntry *configCacheGet(const char *fileName, int *status)
+{
+	// Find the config file in the cache, or read it in if it isn't there or
+	// has changed.  The cache lock must be held.
+
+	char fullName[MAX_PATH_NAME_LENGTH + 1];
+	configCacheEntry *entry = NULL;
+	configCacheEntry *oldest = NULL;
+	int count;
+
+	*status = kernelFileFixupPath(fileName, fullName);
+	if (*status < 0)
+		return (entry = NULL);
+
+	configCacheUses += 1;
+
+	for (count = 0; count < CONFIG_CACHE_ENTRIES; count ++)
+	{
+		if (!strcmp(configCache[count].fileName, fullName))
+		{
+			entry = &configCache[count];
+			break;
+		}
+
+		// Otherwise, remember the least-recently-used entry.  Empty ones
+		// have never been used.
+		if (!oldest || (configCache[count].lastUse < oldest->lastUse))
+			oldest = &configCache[count];
+	}
+
+	if (entry && !entry->stale)
+	{
+		entry->lastUse = configCacheUses;
+		cacheStats.hits += 1;
+		return (entry);
+	}
+
+	if (!entry)
+		entry = oldest;
+
+	cacheStats.misses += 1;
+
+	configCacheDrop(entry);
+
+	// Note which file entry it is before reading, so that a change made
+	// while we're reading it will mark it stale
+	entry->fileEntry = kernelFileLookup(fullName);
+	entry->stale = 0;
+
+	*status = configRead(fullName, &entry->list, 1 /* system memory */);
+	if (*status < 0)
+	{
+		entry->fileEntry = NULL;
+		return (entry = NULL);
+	}
+
+	strcpy(entry->fileName, fullName);
+	entry->lastUse = configCacheUses;
+	cacheStats.entries += 1;
+
+	return (entry);
+}
+
+
+static int configCacheWrite(configCacheEntry *entry)
+{
+	// Write a changed cache entry back to its file.  The file is replaced
+	// in one step by kernelConfigWrite(), after which the cached copy is
+	// current again.  The cache lock must be held.
+
+	int status = 0;
+
+	status = kernelConfigWrite(entry->fileName, &entry->list);
+	if (status < 0)
+	{
+		// We don't know what's in the file now
+		configCacheDrop(entry);
+		return (status);
+	}
+
+	entry->fileEntry = kernelFileLookup(entry->fileName);
+	entry->stale = 0;
+
+	return (status = 0);
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -289,7 +367,7 @@ const char *kernelLookupClosestSymbol(kernelProcess *lookupProcess,
 	void *address)
 {
 	loaderSymbolTable *symTable = NULL;
-	int count = 0;
+	int first = 0, last = 0, middle = 0;
 
 	if (address >= (void *) KERNEL_VIRTUAL_ADDRESS)
 	{
@@ -301,20 +379,30 @@ const char *kernelLookupClosestSymbol(kernelProcess *lookupProcess,
 		symTable = lookupProcess->symbols;
 	}
 
-	if (!symTable)
+	if (!symTable || !symTable->numSymbols)
 		return (NULL);
 
-	for (count = 0; count < symTable->numSymbols; count ++)
+	// The symbols are sorted by value, so do a binary search for the last
+	// one at or below the address
+	first = 0;
+	last = (symTable->numSymbols - 1);
+
+	if (address < symTable->symbols[first].value)
+		return (NULL);
+
+	while (first < last)
 	{
-		if ((symTable->symbols[count].type == LOADERSYMBOLTYPE_FUNC) &&
-			(address >= symTable->symbols[count].value) &&
-			((count >= (symTable->numSymbols - 1)) ||
-				(address < symTable->symbols[count + 1].value)))
-		{
-			return (symTable->symbols[count].name);
-		}
+		middle = (first + ((last - first + 1) / 2));
+
+		if (address >= symTable->symbols[middle].value)
+			first = middle;
+		else
+			last = (middle - 1);
 	}
 
+	if (symTable->symbols[first].type == LOADERSYMBOLTYPE_FUNC)
+		return (symTable->symbols[first].name);
+
 	// Not found
 	return (NULL);
 }
@@ -381,8 +469,8 @@ int kernelStackTrace(kernelProcess *traceProcess, char *buffer, int len)
 	else
 	{
 #ifdef ARCH_X86
-		instPointer = (void *) traceProcess->context.taskStateSegment.EIP;
-		framePointer = (void *) traceProcess->context.taskStateSegment.EBP;
+		instPointer = (void *) traceProcess->context.instPointer;
+		framePointer = (void *) traceProcess->context.framePointer;
 #endif
 
 		// If we're tracing some other process, we need to map its stack into
@@ -678,24 +766,31 @@ int kernelConfigGet(const char *fileName, const char *variable, char *buffer,
 	unsigned buffSize)
 {
 	// This is a convenience function giving the ability to quickly get a
-	// single variable value from a config file.  Uses the
-	// kernelConfigReadSystem() function, above.
+	// single variable value from a config file.  The parsed file is cached
+	// for next time.
 
 	int status = 0;
-	variableList list;
+	configCacheEntry *entry = NULL;
 	const char *value = NULL;
 
 	// Check params
 	if (!fileName || !variable || !buffer || !buffSize)
 		return (status = ERR_NULLPARAMETER);
 
-	// Try to read in the config file
-	status = kernelConfigReadSystem(fileName, &list);
+	status = kernelLockGet(&configCacheLock);
 	if (status < 0)
 		return (status);
 
+	// Try to get the config file
+	entry = configCacheGet(fileName, &status);
+	if (!entry)
+	{
+		kernelLockRelease(&configCacheLock);
+		return (status);
+	}
+
 	// Try to get the value
-	value = variableListGet(&list, variable);
+	value = variableListGet(&entry->list, variable);
 
 	if (value)
 	{
@@ -708,8 +803,7 @@ int kernelConfigGet(const char *fileName, const char *variable, char *buffer,
 		status = ERR_NOSUCHENTRY;
 	}
 
-	// Deallocate the list
-	variableListDestroy(&list);
+	kernelLockRelease(&configCacheLock);
 
 	return (status);
 }
@@ -719,32 +813,35 @@ int kernelConfigSet(const char *fileName, const char *variable,
 	const char *value)
 {
 	// This is a convenience function giving the ability to quickly set a
-	// single variable value in a config file.  Uses the
-	// kernelConfigReadSystem() and kernelConfigWrite() functions, above.
+	// single variable value in a config file.  Changes the cached copy, and
+	// writes it out with the kernelConfigWrite() function, above.
 
 	int status = 0;
-	variableList list;
+	configCacheEntry *entry = NULL;
 
 	// Check params
 	if (!fileName || !variable || !value)
 		return (status = ERR_NULLPARAMETER);
 
-	// Try to read in the config file
-	status = kernelConfigReadSystem(fileName, &list);
+	status = kernelLockGet(&configCacheLock);
 	if (status < 0)
 		return (status);
 
+	// Try to get the config file
+	entry = configCacheGet(fileName, &status);
+	if (!entry)
+		goto out;
+
 	// Try to set the value
-	status = variableListSet(&list, variable, value);
+	status = variableListSet(&entry->list, variable, value);
 	if (status < 0)
 		goto out;
 
 	// Try to write the config file
-	status = kernelConfigWrite(fileName, &list);
+	status = configCacheWrite(entry);
 
 out:
-	// Deallocate the list.
-	variableListDestroy(&list);
+	kernelLockRelease(&configCacheLock);
 	return (status);
 }
 
@@ -752,36 +849,76 @@ out:
 int kernelConfigUnset(const char *fileName, const char *variable)
 {
 	// This is a convenience function giving the ability to quickly unset a
-	// single variable value in a config file.  Uses the
-	// kernelConfigReadSystem() and kernelConfigWrite() functions, above.
+	// single variable value in a config file.  Changes the cached copy, and
+	// writes it out with the kernelConfigWrite() function, above.
 
 	int status = 0;
-	variableList list;
+	configCacheEntry *entry = NULL;
 
 	// Check params
 	if (!fileName || !variable)
 		return (status = ERR_NULLPARAMETER);
 
-	// Try to read in the config file
-	status = kernelConfigReadSystem(fileName, &list);
+	status = kernelLockGet(&configCacheLock);
 	if (status < 0)
 		return (status);
 
+	// Try to get the config file
+	entry = configCacheGet(fileName, &status);
+	if (!entry)
+		goto out;
+
 	// Try to unset the value
-	status = variableListUnset(&list, variable);
+	status = variableListUnset(&entry->list, variable);
 	if (status < 0)
 		goto out;
 
 	// Try to write the config file
-	status = kernelConfigWrite(fileName, &list);
+	status = configCacheWrite(entry);
 
 out:
-	// Deallocate the list
-	variableListDestroy(&list);
+	kernelLockRelease(&configCacheLock);
 	return (status);
 }
 
 
+void kernelConfigFileChanged(kernelFileEntry *fileEntry)
+{
+	// Called by the file code whenever a file is written or truncated, or
+	// its entry is removed or released.  Marks any cached copy of it as
+	// stale.  This doesn't take the cache lock, since it can be called while
+	// the cache is reading or writing the file.
+
+	int count;
+
+	for (count = 0; count < CONFIG_CACHE_ENTRIES; count ++)
+	{
+		if ((configCache[count].fileEntry == fileEntry) &&
+			!configCache[count].stale)
+		{
+			configCache[count].stale = 1;
+			cacheStats.invalidations += 1;
+		}
+	}
+}
+
+
+int kernelConfigGetCacheStats(configCacheStats *stats)
+{
+	// Returns the config file cache statistics
+
+	int status = 0;
+
+	// Check params
+	if (!stats)
+		return (status = ERR_NULLPARAMETER);
+
+	memcpy(stats, &cacheStats, sizeof(configCacheStats));
+
+	return (status = 0);
+}
+
+
 int kernelReadSymbols(void)
 {
 	// This will attempt to read the symbol table from the kernel executable,
@@ -894,22 +1031,9 @@ int kernelGuidGenerate(guid *g)
 
 unsigned kernelCrc32(void *buff, unsigned len, unsigned *lastCrc)
 {
-	// Generates a CRC32
-
-	register char *p = buff;
-	register unsigned crc = 0;
-
-	if (lastCrc)
-		crc = *lastCrc;
-
-	crc ^= ~0U;
-
-	while (len-- > 0)
-		crc = (unsigned)(crcTable[(crc ^ *p++) & 0xFFL] ^ (unsigned)(crc >> 8));
-
-	if (lastCrc)
-		*lastCrc = crc;
+	// Generates a CRC32.  The C library has the implementation, so that user
+	// space programs can use it without calling the kernel.
 
-	return (crc ^ ~0U);
+	return (_crc32(buff, len, lastCrc));
 }
 
@@ -22,6 +22,7 @@
 #ifndef _KERNELMISC_H
 #define _KERNELMISC_H
 
+#include "kernelFile.h"
 #include "kernelMultitasker.h"
 #include <time.h>
 #include <sys/guid.h>
@@ -39,6 +40,8 @@ int kernelConfigWrite(const char *, variableList *);
 int kernelConfigGet(const char *, const char *, char *, unsigned);
 int kernelConfigSet(const char *, const char *, const char *);
 int kernelConfigUnset(const char *, const char *);
+void kernelConfigFileChanged(kernelFileEntry *);
+int kernelConfigGetCacheStats(configCacheStats *);
 int kernelReadSymbols(void);
 time_t kernelUnixTime(void);
 int kernelGuidGenerate(guid *);
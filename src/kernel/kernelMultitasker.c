@@ -22,12 +22,16 @@
 // This file contains the C functions belonging to the kernel's multitasker
 
 #include "kernelMultitasker.h"
+#include "kernelApi.h"
+#include "kernelApicDriver.h"
 #include "kernelCpu.h"
 #include "kernelDebug.h"
+#include "kernelDemandPage.h"
 #include "kernelEnvironment.h"
 #include "kernelError.h"
 #include "kernelFile.h"
 #include "kernelInterrupt.h"
+#include "kernelLoader.h"
 #include "kernelLog.h"
 #include "kernelMain.h"
 #include "kernelMalloc.h"
@@ -38,7 +42,9 @@
 #include "kernelParameters.h"
 #include "kernelPic.h"
 #include "kernelShutdown.h"
-#include "kernelSysTimer.h"
+#include "kernelTimer.h"
+#include "kernelWindow.h"
+#include <limits.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -66,23 +72,47 @@ static kernelProcess *idleProc = NULL;
 static kernelProcess *exceptionProc = NULL;
 static volatile int processingException = 0;
 static volatile unsigned exceptionAddress = 0;
-static volatile int schedulerSwitchedByCall = 0;
-static kernelProcess *fpuProcess = NULL;
 
-// We allow the pointer to the current process to be exported, so that when a
-// process uses system calls, there is an easy way for the process to get
-// information about itself
-kernelProcess *kernelCurrentProcess = NULL;
+// The per-processor data, including the pointer to each one's current
+// process.  That's exported (see kernelCurrentProcess) so that when a process
+// uses system calls, there is an easy way for the process to get information
+// about itself.
+kernelCpuData kernelCpus[SMP_MAX_CPUS];
+#ifdef ARCH_X86
+kernelCpuData *kernelCpuBySelector[GDT_SIZE];
+#endif
+static int numCpus = 1;
 
 // Process list for CPU execution
 static linkedList processList;
 
-// Things specific to the scheduler.  The scheduler process is just a
-// convenient place to keep things, we don't use all of it and it doesn't go
-// in the process list.
-static kernelProcess *schedulerProc = NULL;
+// The schedulers on all processors choose from this table, which unlike the
+// list above, can be used with only the scheduler lock.  Slots are never
+// moved, so the boot processor can keep iterating while it drops the lock.
+static kernelProcess *processTable[MAX_PROCESSES];
+static volatile int processTableSize = 0;
+
+// Things specific to the scheduler, which runs on the stack of whichever
+// process was interrupted (or yielded).  The lock protects the process
+// states and the processors' data from the schedulers on other processors,
+// and is only held with interrupts disabled.
+static volatile int schedulerLock = 0;
+static volatile int schedulerLockCpu = CPU_NONE;
 static volatile int schedulerStop = 0;
 static volatile unsigned schedulerTimeslices = 0;
+static unsigned schedulerTime = 0;
+static unsigned oldSliceCount = 0;
+static volatile int profiling = 0;
+
+#ifdef ARCH_X86
+// There's a TSS for each processor, which only supplies the supervisor stack
+// and the I/O permission bitmap of its current process.  Context switches are
+// done in software, by switching stacks.
+static x86TSS taskState;
+
+// Space left below a new process's initial stack frame, for startProcess()
+#define START_STACK_MARGIN	64
+#endif
 
 // An array of exception types.  The selectors are initialized later.
 static struct {
@@ -121,50 +151,23 @@ static void debugContext(kernelProcess *proc, char *buffer, int len)
 		return;
 
 #ifdef ARCH_X86
-	snprintf(buffer, len, "Multitasker debug TSS selector:\n");
-	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  oldTss=%08x", proc->context.taskStateSegment.oldTss);
-
-	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  ESP0=%08x SS0=%08x\n", proc->context.taskStateSegment.ESP0,
-		proc->context.taskStateSegment.SS0);
-
-	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  ESP1=%08x SS1=%08x\n", proc->context.taskStateSegment.ESP1,
-		proc->context.taskStateSegment.SS1);
-
-	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  ESP2=%08x SS2=%08x\n", proc->context.taskStateSegment.ESP2,
-		proc->context.taskStateSegment.SS2);
-
-	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  CR3=%08x EIP=%08x EFLAGS=%08x\n",
-		proc->context.taskStateSegment.CR3,
-		proc->context.taskStateSegment.EIP,
-		proc->context.taskStateSegment.EFLAGS);
-
-	// Skip general-purpose registers for now -- not terribly interesting
+	snprintf(buffer, len, "Multitasker debug context:\n");
 
 	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  ESP=%08x EBP=%08x ESI=%08x EDI=%08x\n",
-		proc->context.taskStateSegment.ESP,
-		proc->context.taskStateSegment.EBP,
-		proc->context.taskStateSegment.ESI,
-		proc->context.taskStateSegment.EDI);
+		"  ESP=%08x ESP0=%08x CR3=%08x\n", proc->context.stackPointer,
+		proc->context.kernelStack,
+		(unsigned) proc->pageDirectory->physical);
 
 	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  CS=%08x SS=%08x\n", proc->context.taskStateSegment.CS,
-		proc->context.taskStateSegment.SS);
+		"  EIP=%08x EBP=%08x\n", proc->context.instPointer,
+		proc->context.framePointer);
 
 	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  ES=%08x DS=%08x FS=%08x GS=%08x\n",
-		proc->context.taskStateSegment.ES, proc->context.taskStateSegment.DS,
-		proc->context.taskStateSegment.FS, proc->context.taskStateSegment.GS);
+		"  entry=%08x stack=%08x EFLAGS=%08x\n", proc->context.entryPoint,
+		proc->context.initialStack, proc->context.flags);
 
 	snprintf((buffer + strlen(buffer)), (len - strlen(buffer)),
-		"  LDTSelector=%08x IOMapBase=%04x\n",
-		proc->context.taskStateSegment.LDTSelector,
-		proc->context.taskStateSegment.IOMapBase);
+		"  IOMap=%p\n", proc->context.ioMap);
 #endif
 }
 
@@ -244,6 +247,44 @@ static inline int freeProcess(kernelProcess *proc)
 }
 
 
+static void lockScheduler(void)
+{
+	// Get the scheduler lock.  Interrupts must be disabled.
+
+	int cpuNumber = kernelMultitaskerGetCpu()->number;
+	int locked = 0;
+
+	if (schedulerLockCpu == cpuNumber)
+		kernelPanic("Scheduler lock recursion on processor %d", cpuNumber);
+
+	while (1)
+	{
+		locked = 1;
+		processorExchange(schedulerLock, locked);
+		if (!locked)
+			break;
+
+		// Don't hold up any other processor that's waiting for us
+		while (schedulerLock)
+		{
+			kernelSmpPoll();
+			processorPause();
+		}
+	}
+
+	schedulerLockCpu = cpuNumber;
+}
+
+
+static void unlockScheduler(void)
+{
+	int locked = 0;
+
+	schedulerLockCpu = CPU_NONE;
+	processorExchange(schedulerLock, locked);
+}
+
+
 static int addProcessToList(kernelProcess *proc)
 {
 	// This function will add a process to the process list.  It returns zero
@@ -252,6 +293,8 @@ static int addProcessToList(kernelProcess *proc)
 	int status = 0;
 	kernelProcess *listProc = NULL;
 	linkedListItem *iter = NULL;
+	int interrupts = 0;
+	int count;
 
 	// Check params
 	if (!proc)
@@ -284,6 +327,30 @@ static int addProcessToList(kernelProcess *proc)
 	if (status < 0)
 		return (status);
 
+	// And to the scheduler's table
+	processorSuspendInts(interrupts);
+	lockScheduler();
+
+	for (count = 0; count < MAX_PROCESSES; count ++)
+	{
+		if (!processTable[count])
+		{
+			processTable[count] = proc;
+			if (count >= processTableSize)
+				processTableSize = (count + 1);
+			break;
+		}
+	}
+
+	unlockScheduler();
+	processorRestoreInts(interrupts);
+
+	if (count >= MAX_PROCESSES)
+	{
+		linkedListRemove(&processList, (void *) proc);
+		return (status = ERR_NOFREE);
+	}
+
 	// Done
 	return (status = 0);
 }
@@ -297,6 +364,8 @@ static int removeProcessFromList(kernelProcess *proc)
 	int status = 0;
 	kernelProcess *listProc = NULL;
 	linkedListItem *iter = NULL;
+	int interrupts = 0;
+	int count;
 
 	// Check params
 	if (!proc)
@@ -318,6 +387,26 @@ static int removeProcessFromList(kernelProcess *proc)
 	if (listProc != proc)
 		return (status = ERR_NOSUCHPROCESS);
 
+	// Take it out of the scheduler's table first, so that no other
+	// processor can be looking at it once it's gone
+	processorSuspendInts(interrupts);
+	lockScheduler();
+
+	for (count = 0; count < processTableSize; count ++)
+	{
+		if (processTable[count] == proc)
+		{
+			processTable[count] = NULL;
+			break;
+		}
+	}
+
+	while (processTableSize && !processTable[processTableSize - 1])
+		processTableSize -= 1;
+
+	unlockScheduler();
+	processorRestoreInts(interrupts);
+
 	// OK, now we can remove the process from the list
 	status = linkedListRemove(&processList, (void *) proc);
 	if (status < 0)
@@ -330,83 +419,32 @@ static int removeProcessFromList(kernelProcess *proc)
 
 static int createProcessContext(kernelProcess *proc)
 {
-	// This function will create a processor context (for x86 it's a TSS -
-	// Task State Segment) for a new process based on the attributes of the
-	// process.  This function relies on the privilege, userStackSize, and
+	// This function will create a processor context for a new process based
+	// on the attributes of the process.  Nothing is pushed on the process's
+	// stacks until it first runs (see startProcess()).  This function relies
+	// on the privilege, userStack, userStackSize, superStack, and
 	// superStackSize attributes having been previously set.  Returns 0 on
 	// success, negative on error.
 
 	int status = 0;
 
 #ifdef ARCH_X86
-	// Get a free descriptor for the process's TSS
-	status = kernelDescriptorRequest(&proc->context.tssSelector);
-	if ((status < 0) || !proc->context.tssSelector)
-		return (status);
-
-	// Fill in the process's Task State Segment descriptor
-	status = kernelDescriptorSet(
-		proc->context.tssSelector,		// TSS selector number
-		&proc->context.taskStateSegment, // Starts at...
-		sizeof(x86TSS),					// Limit of a TSS segment
-		1,								// Present in memory
-		PRIVILEGE_SUPERVISOR,			// TSSs are supervisor privilege level
-		0,								// TSSs are system segs
-		0xB,							// TSS, 32-bit, busy
-		0,								// 0 for SMALL size granularity
-		0);								// Must be 0 in TSS
-	if (status < 0)
-	{
-		kernelDescriptorRelease(proc->context.tssSelector);
-		return (status);
-	}
-
-	// Now, fill in the TSS (Task State Segment) for the new process.  Parts
-	// of this will be different depending on whether this is a user or
-	// supervisor mode process.
-
-	memset((void *) &proc->context.taskStateSegment, 0, sizeof(x86TSS));
-
-	// Set the IO bitmap's offset
-	proc->context.taskStateSegment.IOMapBase = X86_IOBITMAP_OFFSET;
-
-	if (proc->processorPrivilege == PRIVILEGE_SUPERVISOR)
-	{
-		proc->context.taskStateSegment.CS = PRIV_CODE;
-		proc->context.taskStateSegment.DS = PRIV_DATA;
-		proc->context.taskStateSegment.SS = PRIV_STACK;
-	}
-	else
-	{
-		proc->context.taskStateSegment.CS = USER_CODE;
-		proc->context.taskStateSegment.DS = USER_DATA;
-		proc->context.taskStateSegment.SS = USER_STACK;
-
-		// Turn off access to all I/O ports by default
-		memset((void *) proc->context.taskStateSegment.IOMap, 0xFF,
-			X86_PORTS_BYTES);
-	}
-
-	// All other data segments same as DS
-	proc->context.taskStateSegment.ES = proc->context.taskStateSegment.FS =
-		proc->context.taskStateSegment.GS = proc->context.taskStateSegment.DS;
+	memset((void *) &proc->context, 0, sizeof(kernelProcessContext));
 
-	proc->context.taskStateSegment.ESP = ((unsigned) proc->userStack +
+	proc->context.initialStack = ((unsigned) proc->userStack +
 		(proc->userStackSize - sizeof(void *)));
 
 	if (proc->processorPrivilege != PRIVILEGE_SUPERVISOR)
 	{
-		proc->context.taskStateSegment.SS0 = PRIV_STACK;
-		proc->context.taskStateSegment.ESP0 = ((unsigned) proc->superStack +
+		proc->context.kernelStack = ((unsigned) proc->superStack +
 			(proc->superStackSize - sizeof(int)));
 	}
 
-	proc->context.taskStateSegment.EFLAGS = 0x00000202; // Interrupts enabled
-	proc->context.taskStateSegment.CR3 = (unsigned)
-		proc->pageDirectory->physical;
+	proc->context.flags = 0x00000202; // Interrupts enabled
 
 	// All remaining values will be NULL from initialization.  Note that this
-	// includes the EIP.
+	// includes the entry point, and the I/O bitmap (which means all ports
+	// are denied for user processes).
 #endif
 
 	// Return success
@@ -460,7 +498,7 @@ static int createNewProcess(const char *name, int priority, int privilege,
 	proc->name[MAX_PROCNAME_LENGTH] = '\0';
 
 	// Copy the process image data
-	memcpy((processImage *) &proc->execImage, &execImage,
+	memcpy((processImage *) &proc->execImage, execImage,
 		sizeof(processImage));
 
 	// Set the Id number
@@ -469,6 +507,8 @@ static int createNewProcess(const char *name, int priority, int privilege,
 	// By default, the type is a normal process
 	proc->type = proc_normal;
 
+	proc->statsTime = kernelCpuGetUs();
+
 	// Now, if the process Id is KERNELPROCID, then we are creating the kernel
 	// process, and it will be its own parent.  Otherwise, get the current
 	// process and make IT be the parent of this new process.
@@ -515,6 +555,7 @@ static int createNewProcess(const char *name, int priority, int privilege,
 
 	// The thread's initial state will be "stopped"
 	proc->state = proc_stopped;
+	proc->onCpu = CPU_NONE;
 
 	// Add the process to the process list so we can continue whilst doing
 	// things like changing memory ownerships
@@ -545,16 +586,27 @@ static int createNewProcess(const char *name, int priority, int privilege,
 			goto out;
 		}
 
-		// Get the physical address of the code/data
-		physicalCodeData = kernelPageGetPhysical(proc->parentProcessId,
-			execImage->code);
-
-		// Make the process own its code/data memory.  Don't remap it yet
-		// because we want to map it at the requested virtual address.
-		status = kernelMemoryChangeOwner(proc->parentProcessId,
-			proc->processId, 0, execImage->code, NULL);
-		if (status < 0)
-			goto out;
+		if (execImage->code >= (void *) KERNEL_VIRTUAL_ADDRESS)
+		{
+			// The image is shared, from the loader's image cache, and
+			// still belongs to the kernel
+			physicalCodeData = kernelPageGetPhysical(KERNELPROCID,
+				execImage->code);
+		}
+		else
+		{
+			// Get the physical address of the code/data
+			physicalCodeData = kernelPageGetPhysical(proc->parentProcessId,
+				execImage->code);
+
+			// Make the process own its code/data memory.  Don't remap it
+			// yet because we want to map it at the requested virtual
+			// address.
+			status = kernelMemoryChangeOwner(proc->parentProcessId,
+				proc->processId, 0, execImage->code, NULL);
+			if (status < 0)
+				goto out;
+		}
 
 		// Remap the code/data to the requested virtual address
 		status = kernelPageMap(proc->processId, physicalCodeData,
@@ -567,6 +619,17 @@ static int createNewProcess(const char *name, int priority, int privilege,
 			execImage->virtualAddress, execImage->codeSize);
 		if (status < 0)
 			goto out;
+
+		// Shared data is copied when it's first written
+		if (execImage->code >= (void *) KERNEL_VIRTUAL_ADDRESS)
+		{
+			status = kernelPageSetAttrs(proc->processId,
+				pageattr_copyonwrite, (execImage->virtualAddress +
+					(execImage->data - execImage->code)),
+				execImage->dataSize);
+			if (status < 0)
+				goto out;
+		}
 	}
 	else
 	{
@@ -701,17 +764,17 @@ static int createNewProcess(const char *name, int priority, int privilege,
 	status = createProcessContext(proc);
 	if (status < 0)
 	{
-		// Not able to create the TSS
+		// Not able to create the context
 		goto out;
 	}
 
 #ifdef ARCH_X86
 	// Adjust the stack pointer to account for the arguments that we copied to
 	// the process's stack
-	proc->context.taskStateSegment.ESP -= sizeof(int);
+	proc->context.initialStack -= sizeof(int);
 
 	// Set the EIP to the entry point
-	proc->context.taskStateSegment.EIP = (unsigned) execImage->entryPoint;
+	proc->context.entryPoint = (unsigned) execImage->entryPoint;
 #endif
 
 	// Get memory for the user process environment structure
@@ -748,6 +811,7 @@ static int deleteProcess(kernelProcess *proc)
 	// descendent threads have terminated, for example.
 
 	int status = 0;
+	int count;
 
 	// Processes cannot delete themselves
 	if (proc == kernelCurrentProcess)
@@ -757,19 +821,27 @@ static int deleteProcess(kernelProcess *proc)
 		return (status = ERR_INVALID);
 	}
 
+	// Make sure it's not in the timer queue
+	kernelTimerCancel((kernelTimer *) &proc->waitTimer);
+
 #ifdef ARCH_X86
-	// We need to deallocate the TSS descriptor allocated to the process, if
-	// it has one
-	if (proc->context.tssSelector)
+	// Release the process's I/O bitmap, if it has one
+	if (proc->context.ioMap)
 	{
-		status = kernelDescriptorRelease(proc->context.tssSelector);
-		if (status < 0)
+		// Don't let a later bitmap at the same address look like it's
+		// already loaded
+		for (count = 0; count < numCpus; count ++)
 		{
-			// If this was unsuccessful, we don't want to continue and "lose"
-			// the descriptor
-			kernelError(kernel_error, "Can't release TSS");
-			return (status);
+			if (kernelCpus[count].loadedIoMap == proc->context.ioMap)
+			{
+				memset((void *) kernelCpus[count].taskState->IOMap, 0xFF,
+					X86_PORTS_BYTES);
+				kernelCpus[count].loadedIoMap = NULL;
+			}
 		}
+
+		kernelFree(proc->context.ioMap);
+		proc->context.ioMap = NULL;
 	}
 #endif
 
@@ -777,6 +849,16 @@ static int deleteProcess(kernelProcess *proc)
 	if (proc->signalStream.buffer)
 		kernelStreamDestroy(&proc->signalStream);
 
+	// Forget about any of its memory that's loaded on demand
+	kernelDemandPageRelease(proc->processId, NULL, 0);
+
+	// If it was running a cached program image, it's done with it
+	if (proc->cachedImage)
+	{
+		kernelLoaderReleaseImage(proc->cachedImage);
+		proc->cachedImage = NULL;
+	}
+
 	// Deallocate all memory owned by this process
 	status = kernelMemoryReleaseAllByProcId(proc->processId);
 	if (status < 0)
@@ -787,6 +869,9 @@ static int deleteProcess(kernelProcess *proc)
 		return (status);
 	}
 
+	// Forget any window canvas buffers mapped into its address space
+	kernelWindowCanvasProcessExit(proc->processId);
+
 	// Delete the page table we created for this process
 	status = kernelPageDeleteDirectory(proc->processId);
 	if (status < 0)
@@ -824,9 +909,12 @@ static int deleteProcess(kernelProcess *proc)
 		}
 	}
 
-	// If this process was using the FPU, it's not any more
-	if (fpuProcess == proc)
-		fpuProcess = NULL;
+	// If this process was using an FPU, it's not any more
+	for (count = 0; count < numCpus; count ++)
+	{
+		if (kernelCpus[count].fpuProcess == proc)
+			kernelCpus[count].fpuProcess = NULL;
+	}
 
 	// Remove the process from the multitasker's process list
 	status = removeProcessFromList(proc);
@@ -849,6 +937,34 @@ static int deleteProcess(kernelProcess *proc)
 }
 
 
+static void stopProcess(kernelProcess *proc)
+{
+	// Stop the process, and if it's running on another processor, wait for
+	// that one to let go of it
+
+	int interrupts = 0;
+	int cpuNumber = CPU_NONE;
+
+	processorSuspendInts(interrupts);
+	lockScheduler();
+	proc->state = proc_stopped;
+	cpuNumber = proc->onCpu;
+	unlockScheduler();
+	processorRestoreInts(interrupts);
+
+	if ((cpuNumber == CPU_NONE) ||
+		(cpuNumber == kernelMultitaskerGetCpu()->number))
+	{
+		return;
+	}
+
+	kernelSmpReschedule(cpuNumber);
+
+	while (proc->onCpu != CPU_NONE)
+		processorPause();
+}
+
+
 static void exceptionHandler(void)
 {
 	// This code is the general exception handler.  Before multitasking
@@ -1014,21 +1130,8 @@ static int spawnExceptionThread(void)
 	exceptionProc->state = proc_sleeping;
 
 #ifdef ARCH_X86
-	status = kernelDescriptorSet(
-		exceptionProc->context.tssSelector,	// TSS selector
-		&exceptionProc->context.taskStateSegment, // Starts at...
-		sizeof(x86TSS),						// Maximum size of a TSS selector
-		1,									// Present in memory
-		PRIVILEGE_SUPERVISOR,				// Highest privilege level
-		0,									// TSS's are system segs
-		0x9,								// TSS, 32-bit, non-busy
-		0,									// 0 for SMALL size granularity
-		0);									// Must be 0 in TSS
-	if (status < 0)
-		return (status);
-
 	// Interrupts should always be disabled for this task
-	exceptionProc->context.taskStateSegment.EFLAGS = 0x00000002;
+	exceptionProc->context.flags = 0x00000002;
 #endif
 
 	return (status = 0);
@@ -1052,13 +1155,14 @@ static void idleThread(void)
 		processorIdle();
 
 		// Loop through the process list looking for any that have changed
-		// state to "I/O ready"
+		// state to "I/O ready", or been woken up by a timer
 
 		proc = linkedListIterStart(&processList, &iter);
 
 		while (proc)
 		{
-			if (proc->state == proc_ioready)
+			if ((proc->state == proc_ioready) || ((proc != idleProc) &&
+				(proc->state == proc_ready)))
 			{
 				kernelMultitaskerYield();
 				break;
@@ -1088,6 +1192,8 @@ static int spawnIdleThread(void)
 	if (!idleProc)
 		return (status = ERR_NOSUCHPROCESS);
 
+	kernelCpus[0].idleProcess = idleProc;
+
 	// Set it to the lowest priority
 	status = kernelMultitaskerSetProcessPriority(idleProcId,
 		(PRIORITY_LEVELS - 1));
@@ -1103,90 +1209,100 @@ static int spawnIdleThread(void)
 }
 
 
-static int markProcessBusy(kernelProcess *proc, int busy)
+static int schedulerShutdown(void)
 {
-	// This function gets the requested TSS selector from the GDT and marks it
-	// as busy/not busy.  Returns negative on error.
+	// This function will perform all of the necessary shutdown to stop the
+	// sheduler and return control to the kernel's main task.  This will
+	// probably only be useful at system shutdown time.
 
-	int status = 0;
+	// NOTE that this function should NEVER be called directly.  If this
+	// advice is ignored, you have no assurance that things will occur the way
+	// you might expect them to.  To shut down the scheduler, set the variable
+	// schedulerStop to a nonzero value.  The scheduler will then invoke this
+	// function when it's ready, and the current process will keep the CPU.
 
-#ifdef ARCH_X86
-	kernelDescriptor descriptor;
+	// Stop the clock events, and restore the normal operation of the system
+	// timer
+	kernelTimerShutdown();
 
-	status = kernelDescriptorGet(proc->context.tssSelector, &descriptor);
-	if (status < 0)
-		return (status);
+	return (0);
+}
 
-	if (busy)
-		descriptor.attributes1 |= 0x2;
-	else
-		descriptor.attributes1 &= ~0x2;
-
-	// Re-set the descriptor in the GDT
-	status =  kernelDescriptorSetUnformatted(proc->context.tssSelector,
-		descriptor.segSizeByte1, descriptor.segSizeByte2,
-		descriptor.baseAddress1, descriptor.baseAddress2,
-		descriptor.baseAddress3, descriptor.attributes1,
-		descriptor.attributes2, descriptor.baseAddress4);
-	if (status < 0)
-		return (status);
-#else
-	if (proc && busy) { }
-#endif
 
-	// Return success
-	return (status = 0);
+static int dependsOn(kernelProcess *proc, kernelProcess *ancestor)
+{
+	// Returns 1 if 'proc' is 'ancestor', or is a thread that would be
+	// dismantled along with it
+
+	while (proc)
+	{
+		if (proc == ancestor)
+			return (1);
+
+		if (proc->type != proc_thread)
+			break;
+
+		proc = getProcessById(proc->parentProcessId);
+	}
+
+	return (0);
 }
 
 
-static int schedulerShutdown(void)
+static inline int apCanRun(kernelProcess *proc)
 {
-	// This function will perform all of the necessary shutdown to stop the
-	// sheduler and return control to the kernel's main task.  This will
-	// probably only be useful at system shutdown time.
+	// Application processors only run processes' user code.  Processes that
+	// are in the kernel need the boot processor.
 
-	// NOTE that this function should NEVER be called directly.  If this
-	// advice is ignored, you have no assurance that things will occur the way
-	// you might expect them to.  To shut down the scheduler, set the variable
-	// schedulerStop to a nonzero value.  The scheduler will then invoke this
-	// function when it's ready.
+	return ((proc->processorPrivilege != PRIVILEGE_SUPERVISOR) &&
+		!proc->inKernel);
+}
 
-	int status = 0;
 
-	// Restore the normal operation of the system timer 0, which is mode 3,
-	// initial count of 0
-	status = kernelSysTimerSetupTimer(0 /* timer */, 3 /* mode */,
-		0 /* count 0x10000 */);
-	if (status < 0)
-		kernelError(kernel_warn, "Couldn't restore system timer");
+static void accountWaitTime(kernelProcess *proc, uquad_t now)
+{
+	// When profiling, add the time since the process's stats were last
+	// updated to its ready or blocked time, depending on its state.  The
+	// scheduler lock is held.
 
-	// Restore the old default system timer interrupt handler
-	status = kernelSysTimerHook();
-	if (status < 0)
-		kernelError(kernel_warn, "Couldn't hook system timer interrupt");
+	if (now > proc->statsTime)
+	{
+		switch (proc->state)
+		{
+			case proc_ready:
+			case proc_ioready:
+				proc->stats.readyTime += (now - proc->statsTime);
+				break;
 
-#ifdef ARCH_X86
-	// Give exclusive control to the current task
-	markProcessBusy(kernelCurrentProcess, 0);
-	processorFarJump(kernelCurrentProcess->context.tssSelector);
-#endif
+			case proc_waiting:
+			case proc_sleeping:
+			case proc_stopped:
+				proc->stats.blockedTime += (now - proc->statsTime);
+				break;
 
-	// We should never get here
-	return (status = 0);
+			default:
+				break;
+		}
+	}
+
+	proc->statsTime = now;
 }
 
 
-static kernelProcess *chooseNextProcess(void)
+static kernelProcess *chooseNextProcess(kernelCpuData *cpu,
+	kernelProcess *prevProc, int byCall)
 {
-	// Loops through the process list, and determines which process to run
-	// next
+	// Loops through the process table, and determines which process to run
+	// next on this processor.  'prevProc' is the process whose stack we're
+	// running on.  The scheduler lock is held.
 
-	unsigned long long theTime = 0;
+	uquad_t theTime = 0;
 	kernelProcess *miscProc = NULL;
 	kernelProcess *nextProc = NULL;
-	linkedListItem *iter = NULL;
 	unsigned processWeight = 0;
 	unsigned topProcessWeight = 0;
+	int spareProcs = 0;
+	int count;
 
 	// Here is where we make decisions about which tasks to schedule, and
 	// when.  Below is a brief description of the scheduling algorithm.
@@ -1251,16 +1367,33 @@ static kernelProcess *chooseNextProcess(void)
 	// give higher-priority processes no advantage over lower-priority, and
 	// waiting time would determine execution order.
 	//
-	// A tie beteen the highest-weighted tasks is broken based on list order.
-	// The list is neither FIFO nor LIFO (it's unordered), but closer to LIFO.
+	// A tie beteen the highest-weighted tasks is broken based on table
+	// order, which is roughly the order the processes were created in.
+	//
+	// With more than one processor, processes that are running on another
+	// one are skipped, and the application processors only consider the
+	// processes they can run (see apCanRun()).  A process gets a little
+	// extra weight on the processor it last ran on, since its cache might
+	// still be warm there.
 
 	// Get the CPU time
-	theTime = kernelCpuGetMs();
+	theTime = kernelCpuGetUs();
 
-	miscProc = linkedListIterStart(&processList, &iter);
-
-	while (miscProc)
+	for (count = 0; count < processTableSize; count ++)
 	{
+		miscProc = processTable[count];
+		if (!miscProc)
+			continue;
+
+		if ((miscProc->onCpu != CPU_NONE) && (miscProc != prevProc))
+			continue;
+
+		if (cpu->number && !apCanRun(miscProc))
+			continue;
+
+		if (profiling)
+			accountWaitTime(miscProc, theTime);
+
 		if (miscProc->state == proc_waiting)
 		{
 			// This will change the state of a waiting process to "ready" if
@@ -1268,7 +1401,7 @@ static kernelProcess *chooseNextProcess(void)
 
 			// If the process is waiting for a specified time.  Has the
 			// requested time come?
-			if (miscProc->waitUntil && (miscProc->waitUntil < theTime))
+			if (miscProc->waitUntil && (miscProc->waitUntil <= theTime))
 			{
 				// The process is ready to run
 				miscProc->state = proc_ready;
@@ -1276,16 +1409,24 @@ static kernelProcess *chooseNextProcess(void)
 			else
 			{
 				// The process must continue waiting
-				goto checkNext;
+				continue;
 			}
 		}
 
 		if (miscProc->state == proc_finished)
 		{
 			// This will dismantle any process that has identified itself as
-			// finished, and remove it from the list
-			kernelMultitaskerKillProcess(miscProc->processId);
-			goto checkNext;
+			// finished, and remove it from the list.  Not if we're running
+			// on its stack, though; that will have to wait until next time.
+			// Only the boot processor does this, and not with the lock
+			// held.
+			if (!cpu->number && !dependsOn(prevProc, miscProc))
+			{
+				unlockScheduler();
+				kernelMultitaskerKillProcess(miscProc->processId);
+				lockScheduler();
+			}
+			continue;
 		}
 
 		if ((miscProc->state != proc_ready) &&
@@ -1293,9 +1434,12 @@ static kernelProcess *chooseNextProcess(void)
 		{
 			// This process is not ready (might be stopped, sleeping, or
 			// zombie)
-			goto checkNext;
+			continue;
 		}
 
+		if ((miscProc != prevProc) && apCanRun(miscProc))
+			spareProcs += 1;
+
 		// This process is ready to run.  Determine its weight.
 
 		if (!miscProc->priority)
@@ -1317,7 +1461,7 @@ static kernelProcess *chooseNextProcess(void)
 			processWeight = (((PRIORITY_LEVELS - 1) * PRIORITY_RATIO) +
 				miscProc->waitTime);
 		}
-		else if (schedulerSwitchedByCall && (miscProc->lastSlice ==
+		else if (byCall && (miscProc->lastSlice ==
 			schedulerTimeslices))
 		{
 			// If this process has yielded this timeslice already, we should
@@ -1331,6 +1475,9 @@ static kernelProcess *chooseNextProcess(void)
 			// algorithm described above
 			processWeight = (((PRIORITY_LEVELS - miscProc->priority) *
 				PRIORITY_RATIO) + miscProc->waitTime);
+
+			if ((numCpus > 1) && (miscProc->lastCpu == cpu->number))
+				processWeight += 1;
 		}
 
 		// Did this process win?
@@ -1352,7 +1499,7 @@ static kernelProcess *chooseNextProcess(void)
 					// previously winning process, it will NOT win if the
 					// other process has been waiting as long or longer
 					miscProc->waitTime += 1;
-					goto checkNext;
+					continue;
 				}
 				else
 				{
@@ -1365,78 +1512,226 @@ static kernelProcess *chooseNextProcess(void)
 			topProcessWeight = processWeight;
 			nextProc = miscProc;
 		}
+	}
 
-	checkNext:
-		miscProc = linkedListIterNext(&processList, &iter);
+	// If there are more processes ready than we can run, wake up any idle
+	// processors to take them
+	if (nextProc && (nextProc != prevProc) && apCanRun(nextProc))
+		spareProcs -= 1;
+
+	for (count = 1; (count < numCpus) && (spareProcs > 0); count ++)
+	{
+		if ((count != cpu->number) && kernelCpus[count].online &&
+			(kernelCpus[count].currentProcess ==
+				kernelCpus[count].idleProcess))
+		{
+			kernelSmpReschedule(count);
+			spareProcs -= 1;
+		}
 	}
 
 	return (nextProc);
 }
 
 
-static int scheduler(void)
+static void finishSwitch(void)
 {
-	// This is the kernel multitasker's scheduler thread.  This little program
-	// will run continually in a loop, handing out time slices to all
-	// processes, including the kernel itself, initially, before it goes to
-	// sleep.
+	// Called on the new process's stack after a context switch, to let go
+	// of the previous process and the scheduler lock
 
-	// By the time this scheduler is invoked, the kernel should already have
-	// created itself a process in the process list.  Thus, the scheduler can
-	// begin by simply handing all time slices to the kernel.
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
+	kernelProcess *prevProc = cpu->prevProcess;
 
-	// Additional processes will be created with calls to the kernel, which
-	// will create them and place them in the list.  Thus, when the scheduler
-	// regains control after a time slice has expired, the list of processes
-	// that it examines will have the new process added.
+	cpu->prevProcess = NULL;
 
-	int status = 0;
+	if (prevProc)
+	{
+		prevProc->onCpu = CPU_NONE;
+
+		// If it was moving into the kernel, let the boot processor know
+		// that it can run it
+		if (cpu->number && prevProc->inKernel &&
+			(prevProc->state == proc_ready))
+		{
+			kernelSmpReschedule(0);
+		}
+	}
+
+	unlockScheduler();
+}
+
+
+#ifdef ARCH_X86
+static void loadIoMap(kernelCpuData *cpu, kernelProcess *proc)
+{
+	// Load the process's I/O permission bitmap into the processor's TSS,
+	// unless it's the one that's already there
+
+	if (proc->context.ioMap == cpu->loadedIoMap)
+		return;
+
+	if (proc->context.ioMap)
+	{
+		memcpy((void *) cpu->taskState->IOMap, proc->context.ioMap,
+			X86_PORTS_BYTES);
+	}
+	else
+	{
+		// Turn off access to all I/O ports
+		memset((void *) cpu->taskState->IOMap, 0xFF, X86_PORTS_BYTES);
+	}
+
+	cpu->loadedIoMap = proc->context.ioMap;
+}
+
+
+static unsigned *initialFrame(kernelProcess *proc)
+{
+	// The interrupt return frame that starts a process sits just below its
+	// initial (supervisor) stack pointer
+
+	if (proc->processorPrivilege == PRIVILEGE_SUPERVISOR)
+		return ((unsigned *) proc->context.initialStack - 3);
+	else
+		return ((unsigned *) proc->context.kernelStack - 5);
+}
+
+
+__attribute__((noreturn))
+static void startProcess(void)
+{
+	// Processes that have never run are switched to here, on their own
+	// stacks.  Build an interrupt return frame, and 'return' to the entry
+	// point at the right privilege level.
+
+	kernelProcess *proc = kernelMultitaskerGetCpu()->startingProcess;
+	unsigned *frame = initialFrame(proc);
+
+	finishSwitch();
+
+	frame[0] = proc->context.entryPoint;
+	frame[2] = proc->context.flags;
+
+	if (proc->processorPrivilege == PRIVILEGE_SUPERVISOR)
+	{
+		frame[1] = PRIV_CODE;
+		processorStartTask(frame, PRIV_DATA);
+	}
+	else
+	{
+		frame[1] = USER_CODE;
+		frame[3] = proc->context.initialStack;
+		frame[4] = USER_STACK;
+		processorStartTask(frame, USER_DATA);
+	}
+}
+#endif
+
+
+static void switchProcess(kernelCpuData *cpu, kernelProcess *prevProc,
+	kernelProcess *nextProc)
+{
+	// Switch the CPU from one process to another.  Interrupts must be
+	// disabled, and the scheduler lock held.  This returns when something
+	// switches back to 'prevProc', after which finishSwitch() must be called.
+
+#ifdef ARCH_X86
+	unsigned loadStack = nextProc->context.stackPointer;
+	void *entry = NULL;
+
+	// Only processes running at user privilege need a supervisor stack and
+	// an I/O bitmap from the TSS
+	if (nextProc->processorPrivilege != PRIVILEGE_SUPERVISOR)
+	{
+		cpu->taskState->ESP0 = nextProc->context.kernelStack;
+		loadIoMap(cpu, nextProc);
+	}
+
+	// The FPU state is switched lazily (see fpuExceptionHandler()), but a
+	// user process might be about to run on another processor, so when
+	// there's more than one, its state is saved now
+	if ((numCpus > 1) && (prevProc == cpu->fpuProcess) &&
+		(prevProc->processorPrivilege != PRIVILEGE_SUPERVISOR))
+	{
+		processorClearTaskSwitched();
+		processorFpuStateSave(prevProc->context.fpuState[0]);
+		prevProc->context.fpuStateSaved = 1;
+		cpu->fpuProcess = NULL;
+	}
+
+	if (nextProc != cpu->fpuProcess)
+		processorSetTaskSwitched();
+
+	cpu->pageDirectory = (unsigned) nextProc->pageDirectory->physical;
+
+	if (!loadStack)
+	{
+		// It has never run.  Start it below its initial stack frame.
+		cpu->startingProcess = nextProc;
+		loadStack = ((unsigned) initialFrame(nextProc) - START_STACK_MARGIN);
+		entry = startProcess;
+	}
+
+	// Remember where we were, for stack traces
+	processorGetInstructionPointer(prevProc->context.instPointer);
+	processorGetFramePointer(prevProc->context.framePointer);
+
+	processorSwitchStack(&prevProc->context.stackPointer,
+		nextProc->pageDirectory->physical, loadStack, entry);
+#else
+	if (cpu && prevProc && nextProc) { }
+#endif
+}
+
+
+static void schedule(int byCall)
+{
+	// This is the kernel multitasker's scheduler.  It's called with
+	// interrupts disabled, either from the clock event interrupt when a time
+	// slice or a timer has expired, or when a process yields, and it runs
+	// on the stack of the process that's giving up the CPU.  It hands the
+	// next time slice to the best process, and returns when the calling
+	// process gets another one.  Each processor runs its own scheduler; the
+	// boot processor's also keeps the CPU usage statistics.
+
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
+	uquad_t now = 0;
 	unsigned timeUsed = 0;
-	unsigned systemTime = 0;
-	unsigned schedulerTime = 0;
 	unsigned sliceCount = 0;
-	unsigned oldSliceCount = 0;
 	kernelProcess *listProc = NULL;
 	linkedListItem *iter = NULL;
+	int preempted = 0;
 
 	// This is info about the processes we run
+	kernelProcess *prevProc = cpu->currentProcess;
 	kernelProcess *nextProc = NULL;
-	kernelProcess *prevProc = NULL;
 
-	// Here is the scheduler's big loop
-
-	while (!schedulerStop)
+	if (schedulerStop)
 	{
-		// Make sure.  No interrupts allowed inside this task.
-		processorDisableInts();
-
-		// The scheduler is the current process
-		kernelCurrentProcess = schedulerProc;
-
-		// Calculate how many timer ticks were used in the previous time
-		// slice.  This will be different depending on whether the previous
-		// timeslice actually expired, or whether we were called for some
-		// other reason (for example a yield()).
-
-		if (!schedulerSwitchedByCall)
-			timeUsed = TIME_SLICE_LENGTH;
-		else
-			timeUsed = (TIME_SLICE_LENGTH - kernelSysTimerReadValue(0));
+		if (cpu->number)
+		{
+			// Application processors just stop
+			cpu->online = 0;
+			while (1)
+				processorStop();
+		}
 
-		// Count the time used for legacy system timer purposes
-		systemTime += timeUsed;
+		// The scheduler is supposed to shut down
+		schedulerShutdown();
+		return;
+	}
 
-		// Have we had the equivalent of a full timer revolution?  If so, we
-		// need to call the standard timer interrupt handler.
-		if (systemTime >= SYSTIMER_FULLCOUNT)
-		{
-			// Reset to zero
-			systemTime = 0;
+	lockScheduler();
 
-			// Artifically register a system timer tick
-			kernelSysTimerTick();
-		}
+	// Calculate how many microseconds were used in the previous time slice.
+	// Slices end early when processes yield or wait, and the clock event
+	// might also be for a timer rather than the end of the slice.
+	now = kernelCpuGetUs();
+	timeUsed = (unsigned) (now - cpu->sliceStart);
+	cpu->sliceStart = now;
 
+	if (!cpu->number)
+	{
 		// Count the time used for the purpose of tracking CPU usage
 		schedulerTime += timeUsed;
 		sliceCount = (schedulerTime / TIME_SLICE_LENGTH);
@@ -1448,127 +1743,150 @@ static int scheduler(void)
 
 			oldSliceCount = sliceCount;
 		}
+	}
 
-		// Remember the previous process we ran
-		prevProc = nextProc;
+	if (prevProc->state == proc_running)
+	{
+		// Change the state of the previous process to ready, since it was
+		// interrupted while still on the CPU
+		prevProc->state = proc_ready;
 
-		if (prevProc)
-		{
-			if (prevProc->state == proc_running)
-			{
-				// Change the state of the previous process to ready, since it
-				// was interrupted while still on the CPU
-				prevProc->state = proc_ready;
-			}
+		// Unless it yielded, it didn't give up the CPU voluntarily
+		preempted = !byCall;
+	}
 
-			// Add the last timeslice to the process's CPU time
-			prevProc->cpuTime += timeUsed;
+	// Add the last timeslice to the process's CPU time
+	prevProc->cpuTime += timeUsed;
+	prevProc->stats.runTime += timeUsed;
+	prevProc->statsTime = now;
 
-			// Record the current timeslice number, so we can remember when
-			// this process was last active (see chooseNextProcess())
-			prevProc->lastSlice = schedulerTimeslices;
-		}
+	// Record the current timeslice number, so we can remember when this
+	// process was last active (see chooseNextProcess())
+	prevProc->lastSlice = schedulerTimeslices;
+	if (prevProc != cpu->idleProcess)
+		prevProc->lastCpu = cpu->number;
 
-		// Every CPU_PERCENT_TIMESLICES timeslices we will update the %CPU
-		// value for each process currently in the list
-		if (sliceCount >= CPU_PERCENT_TIMESLICES)
-		{
-			// Calculate the CPU percentage
+	// Every CPU_PERCENT_TIMESLICES timeslices we will update the %CPU value
+	// for each process currently in the list
+	if (sliceCount >= CPU_PERCENT_TIMESLICES)
+	{
+		// Calculate the CPU percentage
 
-			listProc = linkedListIterStart(&processList, &iter);
+		listProc = linkedListIterStart(&processList, &iter);
 
-			while (listProc)
+		while (listProc)
+		{
+			if (!schedulerTime)
 			{
-				if (!schedulerTime)
-				{
-					listProc->cpuPercent = 0;
-				}
-				else
-				{
-					listProc->cpuPercent = ((listProc->cpuTime * 100) /
-						schedulerTime);
-				}
-
-				// Reset the process's cpuTime counter
-				listProc->cpuTime = 0;
-
-				listProc = linkedListIterNext(&processList, &iter);
+				listProc->cpuPercent = 0;
+			}
+			else
+			{
+				listProc->cpuPercent = ((listProc->cpuTime * 100) /
+					schedulerTime);
 			}
 
-			// Reset the schedulerTime and slice counters
-			schedulerTime = sliceCount = oldSliceCount = 0;
-		}
+			// Reset the process's cpuTime counter
+			listProc->cpuTime = 0;
 
-		if (processingException)
-		{
-			// If we were processing an exception (either the exception
-			// process or another exception handler), keep it active
-			nextProc = prevProc;
-			kernelDebugError("Scheduler interrupt while processing "
-				"exception");
-		}
-		else
-		{
-			// Choose the next process to run
-			nextProc = chooseNextProcess();
+			listProc = linkedListIterNext(&processList, &iter);
 		}
 
-		// We should now have selected a process to run.  If not, we should
-		// re-start the old one.  This should only be likely to happen if
-		// something kills the idle thread.
-		if (!nextProc)
-			nextProc = prevProc;
-
-		// Update some info about the next process
-		nextProc->waitTime = 0;
-		nextProc->state = proc_running;
+		// Reset the schedulerTime and slice counters
+		schedulerTime = sliceCount = oldSliceCount = 0;
+	}
 
-		// Export (to the rest of the multitasker) the pointer to the
-		// currently selected process
-		kernelCurrentProcess = nextProc;
+	if (!cpu->number && processingException)
+	{
+		// If we were processing an exception (either the exception process
+		// or another exception handler), keep it active
+		nextProc = prevProc;
+		kernelDebugError("Scheduler interrupt while processing exception");
+	}
+	else
+	{
+		// Choose the next process to run.  Any finished processes get
+		// dismantled on the way, which needs the kernel's permissions.
+		cpu->currentProcess = kernelProc;
+		nextProc = chooseNextProcess(cpu, prevProc, byCall);
+		cpu->currentProcess = prevProc;
+	}
 
-		if (!schedulerSwitchedByCall)
+	// We should now have selected a process to run.  If not, we should
+	// re-start the old one, or an application processor can idle.  The
+	// former should only be likely to happen if something kills the idle
+	// thread.
+	if (!nextProc)
+	{
+		if (cpu->number && ((prevProc->state != proc_ready) ||
+			!apCanRun(prevProc)))
 		{
-			// Acknowledge the timer interrupt if one occurred
-			kernelPicEndOfInterrupt(INTERRUPT_NUM_SYSTIMER);
+			nextProc = cpu->idleProcess;
 		}
 		else
 		{
-			// Reset the "switched by call" flag
-			schedulerSwitchedByCall = 0;
+			nextProc = prevProc;
 		}
+	}
 
-		// Set up a new time slice - PIT single countdown
-		while (kernelSysTimerSetupTimer(0 /* timer */, 0 /* mode */,
-			TIME_SLICE_LENGTH) < 0)
-		{
-			kernelError(kernel_warn, "The scheduler was unable to control "
-				"the system timer");
-		}
+	// Update some info about the next process
+	nextProc->waitTime = 0;
+	nextProc->state = proc_running;
+	nextProc->onCpu = cpu->number;
 
-		// In the final part, we do the actual context switch
+	// Set up the next clock event, for the end of the new time slice or the
+	// next timer, whichever is sooner.  The idle thread doesn't need a time
+	// slice; if nothing is due, the CPU can stay idle until an interrupt.
+	// The application processors' idle threads keep taking time slices, so
+	// that they notice new work even if no reschedule interrupt comes.
+	if (!cpu->number && (nextProc == idleProc))
+		kernelTimerProgram(0);
+	else
+		kernelTimerProgram(now + TIME_SLICE_LENGTH);
 
-		// Mark the exception handler and scheduler tasks as not busy so they
-		// can be jumped back to
-		if (exceptionProc)
-			markProcessBusy(exceptionProc, 0);
-		markProcessBusy(schedulerProc, 0);
+	if (nextProc == prevProc)
+	{
+		unlockScheduler();
+		return;
+	}
 
-		// Mark the next task as not busy and jump to it
-		markProcessBusy(nextProc, 0);
+	// Count the context switch
+	if (preempted)
+		prevProc->stats.involuntarySwitches += 1;
+	else
+		prevProc->stats.voluntarySwitches += 1;
+
+	// Export (to the rest of the multitasker) the pointer to the currently
+	// selected process, and do the actual context switch
+	cpu->currentProcess = nextProc;
+	cpu->prevProcess = prevProc;
+	switchProcess(cpu, prevProc, nextProc);
+	finishSwitch();
+}
 
-#ifdef ARCH_X86
-		processorFarJump(nextProc->context.tssSelector);
-#endif
 
-		// Continue to loop
-	}
+static void timerEvent(void)
+{
+	// This is called from the clock event interrupt, after any expired
+	// timers have been run.  Either the time slice expired, or a timer
+	// might have made something ready to run.
+
+	schedule(0 /* not by call */);
+}
 
-	// If we get here, then the scheduler is supposed to shut down
-	schedulerShutdown();
 
-	// We should never get here
-	return (status = 0);
+static void waitTimerExpired(void *data)
+{
+	// A waiting process's timer expired.  Make it ready, if it's still
+	// waiting for that.
+
+	kernelProcess *proc = data;
+
+	if ((proc->state == proc_waiting) && proc->waitUntil &&
+		(proc->waitUntil <= kernelCpuGetUs()))
+	{
+		proc->state = proc_ready;
+	}
 }
 
 
@@ -1577,74 +1895,77 @@ static int schedulerInitialize(void)
 	// This function will do all of the necessary initialization for the
 	// scheduler.  Returns 0 on success, negative otherwise.
 
-	// The scheduler needs to make a task (but not a fully-fledged process)
-	// for itself
-
 	int status = 0;
 	int interrupts = 0;
-	processImage schedImage = {
-		scheduler, scheduler,
-		NULL, 0xFFFFFFFF,
-		NULL, 0xFFFFFFFF,
-		0xFFFFFFFF,
-		"", 0, { NULL }
-	};
-
-	status = createNewProcess("scheduler process", kernelProc->priority,
-		kernelProc->privilege, &schedImage, 0 /* no page directory */);
-	if (status < 0)
-		return (status);
+	kernelCpuData *cpu = &kernelCpus[0];
 
-	schedulerProc = getProcessById(status);
+	kernelDebug(debug_multitasker, "Multitasker initialize scheduler");
 
-	// The scheduler process doesn't sit in the normal process list
-	removeProcessFromList(schedulerProc);
+	// This is the boot processor
+	cpu->number = 0;
+	cpu->online = 1;
 
-	// Interrupts should always be disabled for this task
 #ifdef ARCH_X86
-	schedulerProc->context.taskStateSegment.EFLAGS = 0x00000002;
-#endif
+	// Get a free descriptor for the TSS.  It just supplies the supervisor
+	// stack and I/O bitmap of the current process.
+	status = kernelDescriptorRequest(&cpu->tssSelector);
+	if ((status < 0) || !cpu->tssSelector)
+		return (status);
 
-	// Not busy
-	markProcessBusy(schedulerProc, 0);
+	status = kernelDescriptorSet(
+		cpu->tssSelector,		// TSS selector number
+		&taskState,				// Starts at...
+		sizeof(x86TSS),			// Limit of a TSS segment
+		1,						// Present in memory
+		PRIVILEGE_SUPERVISOR,	// TSSs are supervisor privilege level
+		0,						// TSSs are system segs
+		0x9,					// TSS, 32-bit, non-busy
+		0,						// 0 for SMALL size granularity
+		0);						// Must be 0 in TSS
+	if (status < 0)
+	{
+		kernelDescriptorRelease(cpu->tssSelector);
+		return (status);
+	}
 
-	kernelDebug(debug_multitasker, "Multitasker initialize scheduler");
+	memset((void *) &taskState, 0, sizeof(x86TSS));
+	taskState.SS0 = PRIV_STACK;
+	taskState.IOMapBase = X86_IOBITMAP_OFFSET;
+
+	// Turn off access to all I/O ports by default
+	memset((void *) taskState.IOMap, 0xFF, X86_PORTS_BYTES);
+	cpu->taskState = &taskState;
+	cpu->loadedIoMap = NULL;
+	kernelCpuBySelector[cpu->tssSelector >> 3] = cpu;
+#endif
 
 	// Disable interrupts, so we can ensure that we don't immediately get a
 	// timer interrupt
 	processorSuspendInts(interrupts);
 
-	// Hook the system timer interrupt
-	kernelDebug(debug_multitasker, "Multitasker hook system timer interrupt");
+	// Start the clock events
+	kernelDebug(debug_multitasker, "Multitasker start clock events");
 
-	// Install a task gate for the interrupt, which will be the scheduler's
-	// timer interrupt.  After this point, our new scheduler task will run
-	// with every clock tick.
-	status = kernelInterruptHook(INTERRUPT_NUM_SYSTIMER, (void *)
-		schedulerProc->context.tssSelector);
+	// After this point, the scheduler will run whenever a time slice ends or
+	// a timer expires
+	status = kernelTimerInitialize(&timerEvent);
 	if (status < 0)
 	{
 		processorRestoreInts(interrupts);
 		return (status);
 	}
 
-	// The scheduler task should now be set up to run.  We should set up the
-	// kernel task to resume operation.
-
-	// Before we load the kernel's selector into the task reg, mark it as not
-	// busy, since one cannot load the task register with a busy TSS selector
-	markProcessBusy(kernelProc, 0);
-
 #ifdef ARCH_X86
-	// Make the kernel's Task State Segment be the current one
-	processorLoadTaskReg(kernelProc->context.tssSelector);
+	// Make our Task State Segment be the current one
+	processorLoadTaskReg(cpu->tssSelector);
 #endif
 
 	// Make note that the multitasker has been enabled
 	multitaskingEnabled = 1;
 
-	// Set up the initial timer countdown
-	kernelSysTimerSetupTimer(0 /* timer */, 0 /* mode */, TIME_SLICE_LENGTH);
+	// Set up the initial time slice
+	cpu->sliceStart = kernelCpuGetUs();
+	kernelTimerProgram(cpu->sliceStart + TIME_SLICE_LENGTH);
 
 	processorRestoreInts(interrupts);
 
@@ -1703,11 +2024,12 @@ static int createKernelProcess(void *kernelStack, unsigned kernelStackSize)
 
 #ifdef ARCH_X86
 	// Interrupts are initially disabled for the kernel
-	kernelProc->context.taskStateSegment.EFLAGS = 0x00000002;
+	kernelProc->context.flags = 0x00000002;
 #endif
 
 	// Set the current process to initially be the kernel process
 	kernelCurrentProcess = kernelProc;
+	kernelProc->onCpu = 0;
 
 	// Deallocate the stack that was allocated, since the kernel already has
 	// one set up by the OS loader
@@ -1820,13 +2142,14 @@ static int fpuExceptionHandler(void)
 
 #ifdef ARCH_X86
 
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
 	unsigned short fpuReg = 0;
 
 	//kernelDebug(debug_multitasker, "Multitasker FPU exception start");
 
 	processorClearTaskSwitched();
 
-	if (fpuProcess && (fpuProcess == kernelCurrentProcess))
+	if (cpu->fpuProcess && (cpu->fpuProcess == kernelCurrentProcess))
 	{
 		// This was the last process to use the FPU.  The state should be the
 		// same as it was, so there's nothing to do.
@@ -1843,16 +2166,16 @@ static int fpuExceptionHandler(void)
 	}
 
 	// Save the FPU state for the previous process
-	if (fpuProcess)
+	if (cpu->fpuProcess)
 	{
 		// Save FPU state
 		//kernelDebug(debug_multitasker, "Multitasker switch FPU ownership "
-		//	"from %s to %s", fpuProcess->name,
+		//	"from %s to %s", cpu->fpuProcess->name,
 		//	kernelCurrentProcess->name);
 		//kernelDebug(debug_multitasker, "Multitasker save FPU state for %s",
-		//	fpuProcess->name);
-		processorFpuStateSave(fpuProcess->context.fpuState[0]);
-		fpuProcess->context.fpuStateSaved = 1;
+		//	cpu->fpuProcess->name);
+		processorFpuStateSave(cpu->fpuProcess->context.fpuState[0]);
+		cpu->fpuProcess->context.fpuStateSaved = 1;
 	}
 
 	if (kernelCurrentProcess->context.fpuStateSaved)
@@ -1878,7 +2201,7 @@ static int fpuExceptionHandler(void)
 
 	processorFpuClearEx();
 
-	fpuProcess = kernelCurrentProcess;
+	cpu->fpuProcess = kernelCurrentProcess;
 
 #endif
 
@@ -2040,50 +2363,298 @@ int kernelMultitaskerShutdown(int nice)
 	// Make note that the multitasker has been disabled
 	multitaskingEnabled = 0;
 
-	// Deallocate the stack used by the scheduler
-	kernelMemoryRelease(schedulerProc->userStack);
-
 	// Log a message
 	kernelLog("Multitasking stopped");
 
-	return (status = 0);
+	return (status = 0);
+}
+
+
+void kernelException(int num, unsigned address, void *faultAddress,
+	unsigned faultCode)
+{
+	int status = 0;
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
+	kernelProcess *proc = cpu->currentProcess;
+
+	// The FPU exception is handled by whichever processor gets it
+	if ((num == EXCEPTION_DEVNOTAVAIL) && (fpuExceptionHandler() >= 0))
+		return;
+
+	// Anything else is handled on the boot processor.  Application
+	// processors only run user code, so move the process over there.
+	if (cpu->number && (proc->processorPrivilege == PRIVILEGE_SUPERVISOR))
+	{
+		kernelPanic("%s exception on processor %d",
+			exceptionVector[num].name, cpu->number);
+	}
+
+	kernelMultitaskerEnterKernel();
+
+	// A page fault might just be for a page that's loaded on demand, or a
+	// write to a copy-on-write page.  Those can mean waiting for I/O, so
+	// they're done with interrupts enabled, before we consider ourselves to
+	// be processing an exception.
+	if ((num == EXCEPTION_PAGE) && faultAddress)
+	{
+		proc->stats.pageFaults += 1;
+
+		processorEnableInts();
+
+		status = kernelDemandPageFault(faultAddress);
+		if (status < 0)
+			status = kernelPageCopyOnWrite(proc->processId, faultAddress);
+
+		// Another thread of the process might have dealt with the same
+		// page in the meantime, in which case the access can just be tried
+		// again
+		if ((status < 0) && (kernelPageFaultResolved(proc->processId,
+			faultAddress, faultCode) > 0))
+		{
+			status = 0;
+		}
+
+		processorDisableInts();
+
+		if (status >= 0)
+		{
+			kernelMultitaskerLeaveKernel();
+			return;
+		}
+	}
+
+	// If we are already processing one, then it's a double-fault and we are
+	// totally finished
+	if (processingException)
+	{
+		kernelPanic("Double-fault (%s) while processing %s %s exception",
+			exceptionVector[num].name, exceptionVector[processingException].a,
+			exceptionVector[processingException].name);
+	}
+
+	processingException = num;
+	exceptionAddress = address;
+
+	// If there's a handler for this exception type, call it
+	if (exceptionVector[processingException].handler &&
+		(exceptionVector[processingException].handler() >= 0))
+	{
+		// The exception was handled.  Return to the caller.
+		processingException = 0;
+		exceptionAddress = 0;
+		kernelMultitaskerLeaveKernel();
+		return;
+	}
+
+	// If multitasking is enabled, switch to the exception thread.  Otherwise
+	// just call the exception handler as a function.  The current process
+	// stays 'current' so that the exception thread can see who faulted.
+	if (multitaskingEnabled)
+	{
+		cpu = kernelMultitaskerGetCpu();
+		lockScheduler();
+		exceptionProc->onCpu = cpu->number;
+		cpu->prevProcess = proc;
+		switchProcess(cpu, proc, exceptionProc);
+		finishSwitch();
+	}
+	else
+	{
+		exceptionHandler();
+	}
+
+	// If the exception is handled, then we return
+	kernelMultitaskerLeaveKernel();
+}
+
+
+void kernelMultitaskerEnterKernel(void)
+{
+	// Called when the current process enters the kernel, by calling the
+	// kernel API or by causing an exception.  The kernel only runs on the
+	// boot processor, so on any other processor this gives up the CPU, and
+	// returns when the boot processor picks the process up.
+
+	kernelCpuData *cpu = NULL;
+	int interrupts = 0;
+
+	processorSuspendInts(interrupts);
+
+	cpu = kernelMultitaskerGetCpu();
+	cpu->currentProcess->inKernel += 1;
+
+	if (multitaskingEnabled && cpu->number)
+		schedule(1 /* by call */);
+
+	processorRestoreInts(interrupts);
+}
+
+
+void kernelMultitaskerLeaveKernel(void)
+{
+	// Called when the current process returns from the kernel.  After this,
+	// the application processors can run it again.
+
+	int interrupts = 0;
+
+	processorSuspendInts(interrupts);
+
+	if (kernelCurrentProcess->inKernel > 0)
+		kernelCurrentProcess->inKernel -= 1;
+
+	processorRestoreInts(interrupts);
+}
+
+
+void kernelMultitaskerReschedule(void)
+{
+	// Called from the reschedule inter-processor interrupt, when another
+	// processor has work for this one.  Interrupts are disabled.
+
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
+
+	if (!multitaskingEnabled || schedulerStop)
+		return;
+
+	// The boot processor's time slices are its own business, but if it's
+	// idle, it should have a look
+	if (!cpu->number && (cpu->currentProcess != idleProc))
+		return;
+
+	schedule(0 /* not by call */);
+}
+
+
+int kernelMultitaskerAddCpu(int apicId)
+{
+	// Set up the scheduler's data for another processor, before it gets
+	// started.  Returns the processor number on success, negative otherwise.
+
+	int status = 0;
+	kernelCpuData *cpu = NULL;
+	kernelProcess *idle = NULL;
+	int cpuNumber = 0;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Re-use the slot of a processor that didn't start, if there is one
+	for (cpuNumber = 1; cpuNumber < numCpus; cpuNumber ++)
+	{
+		if (!kernelCpus[cpuNumber].online)
+			break;
+	}
+
+	if (cpuNumber >= SMP_MAX_CPUS)
+		return (status = ERR_NOFREE);
+
+	cpu = &kernelCpus[cpuNumber];
+
+	if (!cpu->taskState)
+	{
+#ifdef ARCH_X86
+		// Each processor needs its own TSS, set up like the boot
+		// processor's (see schedulerInitialize())
+		cpu->taskState = kernelMalloc(sizeof(x86TSS));
+		if (!cpu->taskState)
+			return (status = ERR_MEMORY);
+
+		status = kernelDescriptorRequest(&cpu->tssSelector);
+		if ((status < 0) || !cpu->tssSelector)
+			goto err_out;
+
+		status = kernelDescriptorSet(cpu->tssSelector, cpu->taskState,
+			sizeof(x86TSS), 1, PRIVILEGE_SUPERVISOR, 0, 0x9, 0, 0);
+		if (status < 0)
+		{
+			kernelDescriptorRelease(cpu->tssSelector);
+			goto err_out;
+		}
+
+		cpu->taskState->SS0 = PRIV_STACK;
+		cpu->taskState->IOMapBase = X86_IOBITMAP_OFFSET;
+		memset((void *) cpu->taskState->IOMap, 0xFF, X86_PORTS_BYTES);
+		kernelCpuBySelector[cpu->tssSelector >> 3] = cpu;
+#endif
+	}
+
+	if (!cpu->idleProcess)
+	{
+		// The idle 'process' of an application processor just runs on its
+		// boot stack.  It isn't in the process list, because nothing else
+		// needs to know about it.
+		idle = kernelMalloc(sizeof(kernelProcess));
+		if (!idle)
+		{
+			status = ERR_MEMORY;
+			goto err_out;
+		}
+
+		strcpy((char *) idle->name, "idle thread");
+		idle->processId = KERNELPROCID;
+		idle->priority = (PRIORITY_LEVELS - 1);
+		idle->privilege = PRIVILEGE_SUPERVISOR;
+		idle->processorPrivilege = PRIVILEGE_SUPERVISOR;
+		idle->pageDirectory = kernelProc->pageDirectory;
+		idle->state = proc_running;
+		idle->onCpu = cpuNumber;
+		idle->lastCpu = cpuNumber;
+		cpu->idleProcess = idle;
+	}
+
+	cpu->number = cpuNumber;
+	cpu->apicId = apicId;
+	cpu->online = 0;
+	cpu->currentProcess = cpu->idleProcess;
+	cpu->prevProcess = NULL;
+	cpu->fpuProcess = NULL;
+#ifdef ARCH_X86
+	cpu->loadedIoMap = NULL;
+#endif
+
+	if (cpuNumber >= numCpus)
+		numCpus = (cpuNumber + 1);
+
+	return (cpuNumber);
+
+err_out:
+#ifdef ARCH_X86
+	kernelFree((void *) cpu->taskState);
+	cpu->taskState = NULL;
+#endif
+	return (status);
 }
 
 
-void kernelException(int num, unsigned address)
+void kernelMultitaskerStartCpu(int cpuNumber)
 {
-	// If we are already processing one, then it's a double-fault and we are
-	// totally finished
-	if (processingException)
-	{
-		kernelPanic("Double-fault (%s) while processing %s %s exception",
-			exceptionVector[num].name, exceptionVector[processingException].a,
-			exceptionVector[processingException].name);
-	}
+	// This is where a newly-started application processor joins in, on its
+	// boot stack, with interrupts disabled.  It becomes the processor's idle
+	// thread.
 
-	processingException = num;
-	exceptionAddress = address;
+	kernelCpuData *cpu = &kernelCpus[cpuNumber];
 
-	// If there's a handler for this exception type, call it
-	if (exceptionVector[processingException].handler &&
-		(exceptionVector[processingException].handler() >= 0))
+#ifdef ARCH_X86
+	processorLoadTaskReg(cpu->tssSelector);
+#endif
+
+	floatingPointInitialize();
+
+	if (kernelApicStartCpu() < 0)
 	{
-		// The exception was handled.  Return to the caller.
-		processingException = 0;
-		exceptionAddress = 0;
-		return;
+		while (1)
+			processorStop();
 	}
 
-#ifdef ARCH_X86
-	// If multitasking is enabled, switch to the exception thread.  Otherwise
-	// just call the exception handler as a function.
-	if (multitaskingEnabled)
-		processorFarJump(exceptionProc->context.tssSelector);
-	else
-		exceptionHandler();
-#endif
+	cpu->currentProcess = cpu->idleProcess;
+	cpu->pageDirectory = (unsigned) kernelProc->pageDirectory->physical;
+	cpu->sliceStart = kernelCpuGetUs();
+	kernelTimerProgram(cpu->sliceStart + TIME_SLICE_LENGTH);
+	cpu->online = 1;
 
-	// If the exception is handled, then we return
+	while (1)
+		processorIdle();
 }
 
 
@@ -2155,6 +2726,14 @@ void kernelMultitaskerDumpProcessList(void)
 					break;
 			}
 
+			sprintf((buffer + strlen(buffer)), "\n        switches=%u/%u "
+				"faults=%u calls=%u run=%llums ready=%llums blocked=%llums",
+				proc->stats.voluntarySwitches,
+				proc->stats.involuntarySwitches, proc->stats.pageFaults,
+				proc->stats.apiCalls, (proc->stats.runTime / 1000),
+				(proc->stats.readyTime / 1000),
+				(proc->stats.blockedTime / 1000));
+
 			kernelTextStreamPrintLine(currentOutput, buffer);
 
 			proc = linkedListIterNext(&processList, &iter);
@@ -2309,7 +2888,7 @@ int kernelMultitaskerSpawn(void *startAddress, const char *name, int argc,
 	// additional bytes from the stack pointer to account for the space where
 	// the return address would normally go
 #ifdef ARCH_X86
-	proc->context.taskStateSegment.ESP -= sizeof(void *);
+	proc->context.initialStack -= sizeof(void *);
 #endif
 
 	// Share the environment of the parent
@@ -3169,7 +3748,7 @@ int kernelMultitaskerDuplicateIo(int firstPid, int secondPid, int clear)
 int kernelMultitaskerGetProcessorTime(clock_t *clk)
 {
 	// Returns processor time used by a process since its start.  This value
-	// is the number of timer ticks from the system timer.
+	// is in microseconds.
 
 	int status = 0;
 
@@ -3192,6 +3771,8 @@ void kernelMultitaskerYield(void)
 	// This function will yield control from the current running process back
 	// to the scheduler
 
+	int interrupts = 0;
+
 	// Make sure multitasking has been enabled
 	if (!multitaskingEnabled)
 		return;
@@ -3200,13 +3781,11 @@ void kernelMultitaskerYield(void)
 	if (kernelProcessingInterrupt())
 		return;
 
-	// We accomplish a yield by doing a far call to the scheduler's task.  The
-	// scheduler sees this almost as if the current timeslice had expired.
-	schedulerSwitchedByCall = 1;
-
-#ifdef ARCH_X86
-	processorFarJump(schedulerProc->context.tssSelector);
-#endif
+	// We accomplish a yield by calling the scheduler directly.  It sees this
+	// almost as if the current timeslice had expired.
+	processorSuspendInts(interrupts);
+	schedule(1 /* by call */);
+	processorRestoreInts(interrupts);
 }
 
 
@@ -3227,6 +3806,35 @@ void kernelMultitaskerWait(unsigned milliseconds)
 		return;
 	}
 
+	while (milliseconds > (UINT_MAX / US_PER_MS))
+	{
+		kernelMultitaskerWaitUs((UINT_MAX / US_PER_MS) * US_PER_MS);
+		milliseconds -= (UINT_MAX / US_PER_MS);
+	}
+
+	kernelMultitaskerWaitUs(milliseconds * US_PER_MS);
+}
+
+
+void kernelMultitaskerWaitUs(unsigned microseconds)
+{
+	// This function will put a process into the waiting state for *at least*
+	// the specified number of microseconds, and yield control back to the
+	// scheduler.  A timer wakes the process up when the time comes.
+
+	uquad_t endTime = 0;
+	int interrupts = 0;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+	{
+		kernelDebugError("Cannot wait() before multitasking is enabled.  "
+			"Spinning.");
+		endTime = (kernelCpuGetUs() + microseconds);
+		while (kernelCpuGetUs() < endTime);
+		return;
+	}
+
 	// Don't do this inside an interrupt
 	if (kernelProcessingInterrupt())
 	{
@@ -3241,15 +3849,26 @@ void kernelMultitaskerWait(unsigned milliseconds)
 		return;
 	}
 
-	// Set the wait until time
-	kernelCurrentProcess->waitUntil = (kernelCpuGetMs() + milliseconds);
+	endTime = (kernelCpuGetUs() + microseconds);
+
+	processorSuspendInts(interrupts);
+
+	// Set the wait until time, and the timer to wake us up
+	kernelCurrentProcess->waitUntil = endTime;
 	kernelCurrentProcess->waitForProcess = 0;
+	kernelCurrentProcess->waitTimer.function = &waitTimerExpired;
+	kernelCurrentProcess->waitTimer.data = (void *) kernelCurrentProcess;
+	kernelTimerAdd((kernelTimer *) &kernelCurrentProcess->waitTimer, endTime);
 
 	// Set the current process to "waiting"
 	kernelCurrentProcess->state = proc_waiting;
 
 	// And yield
-	kernelMultitaskerYield();
+	schedule(1 /* by call */);
+
+	processorRestoreInts(interrupts);
+
+	kernelTimerCancel((kernelTimer *) &kernelCurrentProcess->waitTimer);
 }
 
 
@@ -3309,6 +3928,143 @@ int kernelMultitaskerBlock(int processId)
 }
 
 
+int kernelMultitaskerFutexWait(volatile int *address, int value,
+	unsigned timeout)
+{
+	// This is the slow path of the user space locks (see libpthread).  If
+	// the integer at 'address' still contains 'value', the current process
+	// waits until another one calls kernelMultitaskerFutexWake() for the
+	// same address, or until 'timeout' microseconds have passed, if it's
+	// non-zero.  Waiters are identified by physical address, so this also
+	// works for memory shared between processes.  Returns 0 if woken,
+	// ERR_BUSY if the value had already changed, or ERR_TIMEOUT.
+
+	int status = 0;
+	unsigned physical = 0;
+	uquad_t endTime = 0;
+	int interrupts = 0;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Don't do this inside an interrupt
+	if (kernelProcessingInterrupt())
+	{
+		kernelPanic("Cannot wait() inside an interrupt handler (%d)",
+			kernelInterruptGetCurrent());
+	}
+
+	// Check params
+	if (!address)
+		return (status = ERR_NULLPARAMETER);
+
+	if ((unsigned) address % sizeof(int))
+		return (status = ERR_ALIGN);
+
+	physical = kernelPageGetPhysical(kernelCurrentProcess->processId,
+		(void *) address);
+	if (!physical)
+		return (status = ERR_BADADDRESS);
+
+	if (timeout)
+		endTime = (kernelCpuGetUs() + timeout);
+
+	// The kernel only runs on one processor, so with interrupts disabled,
+	// nothing can wake waiters between here and when we're on the list
+	processorSuspendInts(interrupts);
+
+	if (*address != value)
+	{
+		processorRestoreInts(interrupts);
+		return (status = ERR_BUSY);
+	}
+
+	kernelCurrentProcess->waitForFutex = physical;
+	kernelCurrentProcess->waitForProcess = 0;
+	kernelCurrentProcess->waitUntil = endTime;
+
+	if (timeout)
+	{
+		kernelCurrentProcess->waitTimer.function = &waitTimerExpired;
+		kernelCurrentProcess->waitTimer.data = (void *) kernelCurrentProcess;
+		kernelTimerAdd((kernelTimer *) &kernelCurrentProcess->waitTimer,
+			endTime);
+	}
+
+	// Set the current process to "waiting"
+	kernelCurrentProcess->state = proc_waiting;
+
+	// And yield
+	schedule(1 /* by call */);
+
+	// If nothing woke us, the time ran out
+	if (kernelCurrentProcess->waitForFutex)
+	{
+		kernelCurrentProcess->waitForFutex = 0;
+		status = ERR_TIMEOUT;
+	}
+
+	processorRestoreInts(interrupts);
+
+	if (timeout)
+		kernelTimerCancel((kernelTimer *) &kernelCurrentProcess->waitTimer);
+
+	return (status);
+}
+
+
+int kernelMultitaskerFutexWake(volatile int *address, int count)
+{
+	// Wake up to 'count' processes waiting in kernelMultitaskerFutexWait()
+	// on 'address'.  Returns the number woken.
+
+	int status = 0;
+	unsigned physical = 0;
+	kernelProcess *proc = NULL;
+	linkedListItem *iter = NULL;
+	int woken = 0;
+	int interrupts = 0;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Check params
+	if (!address)
+		return (status = ERR_NULLPARAMETER);
+
+	if (count < 1)
+		return (status = ERR_RANGE);
+
+	physical = kernelPageGetPhysical(kernelCurrentProcess->processId,
+		(void *) address);
+	if (!physical)
+		return (status = ERR_BADADDRESS);
+
+	processorSuspendInts(interrupts);
+
+	proc = linkedListIterStart(&processList, &iter);
+
+	while (proc && (woken < count))
+	{
+		if ((proc->state == proc_waiting) &&
+			(proc->waitForFutex == physical))
+		{
+			proc->waitForFutex = 0;
+			proc->state = proc_ready;
+			woken += 1;
+		}
+
+		proc = linkedListIterNext(&processList, &iter);
+	}
+
+	processorRestoreInts(interrupts);
+
+	return (woken);
+}
+
+
 int kernelMultitaskerDetach(void)
 {
 	// This will allow a program or daemon to detach from its parent process
@@ -3426,7 +4182,7 @@ int kernelMultitaskerKillProcess(int processId)
 
 	// Mark the process as stopped in the process list, so that the scheduler
 	// will not inadvertently select it to run while we're destroying it
-	proc->state = proc_stopped;
+	stopProcess(proc);
 
 	// We must iterate through the list of existing processes, looking for any
 	// other processes whose states depend on this one (such as child threads
@@ -3812,8 +4568,12 @@ int kernelMultitaskerGetIoPerm(int processId, int portNum)
 	if (portNum >= X86_IO_PORTS)
 		return (status = ERR_BOUNDS);
 
+	// Supervisor processes don't use the bitmap
+	if (proc->processorPrivilege == PRIVILEGE_SUPERVISOR)
+		return (status = 1);
+
 	// If the bit is clear, permission is granted
-	if (!GET_PORT_BIT(proc->context.taskStateSegment.IOMap, portNum))
+	if (proc->context.ioMap && !GET_PORT_BIT(proc->context.ioMap, portNum))
 		return (status = 1);
 #endif
 
@@ -3827,6 +4587,10 @@ int kernelMultitaskerSetIoPerm(int processId, int portNum, int yesNo)
 
 	int status = 0;
 	kernelProcess *proc = NULL;
+	int interrupts = 0;
+#ifdef ARCH_X86
+	int count;
+#endif
 
 	// Make sure multitasking has been enabled
 	if (!multitaskingEnabled)
@@ -3845,10 +4609,43 @@ int kernelMultitaskerSetIoPerm(int processId, int portNum, int yesNo)
 	if (portNum >= X86_IO_PORTS)
 		return (status = ERR_BOUNDS);
 
+	// Processes get their own bitmap the first time it changes
+	if (!proc->context.ioMap)
+	{
+		if (!yesNo)
+			return (status = 0);
+
+		proc->context.ioMap = kernelMalloc(X86_PORTS_BYTES);
+		if (!proc->context.ioMap)
+			return (status = ERR_MEMORY);
+
+		memset(proc->context.ioMap, 0xFF, X86_PORTS_BYTES);
+	}
+
+	processorSuspendInts(interrupts);
+
 	if (yesNo)
-		UNSET_PORT_BIT(proc->context.taskStateSegment.IOMap, portNum);
+		UNSET_PORT_BIT(proc->context.ioMap, portNum);
 	else
-		SET_PORT_BIT(proc->context.taskStateSegment.IOMap, portNum);
+		SET_PORT_BIT(proc->context.ioMap, portNum);
+
+	// If it's the bitmap in any processor's TSS, or the current process's,
+	// update that
+	for (count = 0; count < numCpus; count ++)
+	{
+		if (kernelCpus[count].taskState &&
+			(proc->context.ioMap == kernelCpus[count].loadedIoMap))
+		{
+			kernelCpus[count].taskState->IOMap[portNum / 8] =
+				proc->context.ioMap[portNum / 8];
+		}
+	}
+
+	if ((proc == kernelCurrentProcess) &&
+		(proc->processorPrivilege != PRIVILEGE_SUPERVISOR))
+		loadIoMap(kernelMultitaskerGetCpu(), proc);
+
+	processorRestoreInts(interrupts);
 #endif
 
 	return (status = 0);
@@ -3923,6 +4720,33 @@ int kernelMultitaskerSetSymbols(int processId, loaderSymbolTable *symbols)
 }
 
 
+int kernelMultitaskerSetCachedImage(int processId, void *cachedImage)
+{
+	// Given a process ID and the loader's cached image that it's running,
+	// attach the image to the process, so that the loader can be told when
+	// the process is finished with it
+
+	int status = 0;
+	kernelProcess *proc = NULL;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	proc = getProcessById(processId);
+	if (!proc)
+	{
+		// There's no such process
+		kernelError(kernel_error, "No process %d to set cached image",
+			processId);
+		return (status = ERR_NOSUCHPROCESS);
+	}
+
+	proc->cachedImage = cachedImage;
+	return (status = 0);
+}
+
+
 int kernelMultitaskerStackTrace(int processId)
 {
 	// Locate the process by ID and do a stack trace of it
@@ -3985,3 +4809,90 @@ int kernelMultitaskerPropagateEnvironment(int processId, const char *variable)
 	return (status);
 }
 
+
+int kernelMultitaskerSetProfiling(int on)
+{
+	// Turn the collection of scheduling and API call timing statistics on
+	// or off.  Turning it on resets all of the statistics.
+
+	int status = 0;
+	kernelProcess *proc = NULL;
+	uquad_t now = 0;
+	int interrupts = 0;
+	int count;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	if (on && !profiling)
+	{
+		status = kernelApiClearStats();
+		if (status < 0)
+			return (status);
+
+		processorSuspendInts(interrupts);
+		lockScheduler();
+
+		now = kernelCpuGetUs();
+
+		for (count = 0; count < processTableSize; count ++)
+		{
+			proc = processTable[count];
+			if (!proc)
+				continue;
+
+			memset((void *) &proc->stats, 0, sizeof(processStats));
+			proc->statsTime = now;
+		}
+
+		profiling = 1;
+
+		unlockScheduler();
+		processorRestoreInts(interrupts);
+
+		kernelLog("Profiling turned on");
+	}
+	else if (!on && profiling)
+	{
+		profiling = 0;
+		kernelLog("Profiling turned off");
+	}
+
+	return (status = 0);
+}
+
+
+int kernelMultitaskerGetProfiling(void)
+{
+	// Returns 1 if profiling statistics are being collected
+
+	return (profiling);
+}
+
+
+int kernelMultitaskerGetProcessStats(int processId, processStats *stats)
+{
+	// Return the scheduling statistics of the requested process
+
+	int status = 0;
+	kernelProcess *proc = NULL;
+
+	// Make sure multitasking has been enabled
+	if (!multitaskingEnabled)
+		return (status = ERR_NOTINITIALIZED);
+
+	// Check params
+	if (!stats)
+		return (status = ERR_NULLPARAMETER);
+
+	proc = getProcessById(processId);
+	if (!proc)
+		return (status = ERR_NOSUCHENTRY);
+
+	memcpy(stats, (processStats *) &proc->stats, sizeof(processStats));
+	stats->processId = proc->processId;
+
+	return (status = 0);
+}
+
@@ -24,8 +24,10 @@
 
 #include "kernelDescriptor.h"
 #include "kernelPage.h"
+#include "kernelSmp.h"
 #include "kernelSysTimer.h"
 #include "kernelText.h"
+#include "kernelTimer.h"
 #include <time.h>
 #include <sys/file.h>
 #include <sys/loader.h>
@@ -35,15 +37,15 @@
 #include <sys/vis.h>
 
 // Definitions
-#define MAX_PROCESSES				((GDT_SIZE - RES_GLOBAL_DESCRIPTORS))
 #define PRIORITY_LEVELS				8
 #define DEFAULT_STACK_SIZE			(32 * 1024)
 #define DEFAULT_SUPER_STACK_SIZE	(32 * 1024)
 #define TIME_SLICES_PER_SEC			64 // ~15ms per slice
-#define TIME_SLICE_LENGTH			(SYSTIMER_FREQ_HZ / TIME_SLICES_PER_SEC)
+#define TIME_SLICE_LENGTH			(US_PER_SEC / TIME_SLICES_PER_SEC) // us
 #define CPU_PERCENT_TIMESLICES		(TIME_SLICES_PER_SEC / 2) // every 1/2 sec
 #define PRIORITY_RATIO				3
 #define PRIORITY_DEFAULT			((PRIORITY_LEVELS / 2) - 1)
+#define CPU_NONE					-1
 
 // Exception vector numbers
 #define EXCEPTION_DIVBYZERO			0
@@ -68,8 +70,14 @@
 
 typedef volatile struct {
 #ifdef ARCH_X86
-	kernelSelector tssSelector;
-	x86TSS taskStateSegment;
+	unsigned stackPointer;		// Saved kernel stack pointer, 0 if never run
+	unsigned kernelStack;		// ESP0 for user processes
+	unsigned entryPoint;
+	unsigned initialStack;
+	unsigned flags;
+	unsigned instPointer;		// Where it was switched out, for stack traces
+	unsigned framePointer;
+	unsigned char *ioMap;		// I/O permission bitmap, NULL if default
 	unsigned char fpuState[X86_FPU_STATE_LEN];
 	int fpuStateSaved;
 #endif
@@ -92,10 +100,15 @@ typedef volatile struct {
 	int cpuPercent;
 	unsigned lastSlice;
 	unsigned waitTime;
-	unsigned long long waitUntil;
+	unsigned long long waitUntil;		// Microseconds, see kernelCpuGetUs()
+	kernelTimer waitTimer;
 	int waitForProcess;
+	unsigned waitForFutex;				// Physical address being waited on
 	int blockingExitCode;
 	processState state;
+	int inKernel;						// Depth of API calls and exceptions
+	int onCpu;							// Running, or just switched out
+	int lastCpu;
 	void *userStack;
 	unsigned userStackSize;
 	void *superStack;
@@ -110,17 +123,69 @@ typedef volatile struct {
 	unsigned signalMask;
 	stream signalStream;
 	loaderSymbolTable *symbols;
+	void *cachedImage;					// Loader's cached image, if any
+	processStats stats;
+	uquad_t statsTime;					// When the stats were last updated
 
 } kernelProcess;
 
+// The scheduler's state for each processor
+typedef volatile struct {
+	int number;
+	int apicId;
+	int online;
+	kernelProcess *currentProcess;
+	kernelProcess *idleProcess;
+	kernelProcess *prevProcess;			// Until its context is saved
+	kernelProcess *startingProcess;
+	kernelProcess *fpuProcess;
+	uquad_t sliceStart;
+	unsigned pageDirectory;				// Physical address in use
+	int tlbFlushPending;
+#ifdef ARCH_X86
+	kernelSelector tssSelector;
+	x86TSS *taskState;
+	unsigned char *loadedIoMap;
+#endif
+
+} kernelCpuData;
+
+extern kernelCpuData kernelCpus[SMP_MAX_CPUS];
+#ifdef ARCH_X86
+extern kernelCpuData *kernelCpuBySelector[GDT_SIZE];
+#endif
+
+static inline kernelCpuData *kernelMultitaskerGetCpu(void)
+{
+	// Returns the data for the processor we're running on.  Each one has its
+	// own TSS, so the task register tells us which one it is.
+
+#ifdef ARCH_X86
+	unsigned short selector = 0;
+	kernelCpuData *cpu = NULL;
+
+	processorGetTaskReg(selector);
+	cpu = kernelCpuBySelector[selector >> 3];
+	if (cpu)
+		return (cpu);
+#endif
+
+	return (&kernelCpus[0]);
+}
+
 // When in system calls, processes will be allowed to access information
 // about themselves
-extern kernelProcess *kernelCurrentProcess;
+#define kernelCurrentProcess (kernelMultitaskerGetCpu()->currentProcess)
 
 // Functions exported by kernelMultitasker.c
 int kernelMultitaskerInitialize(void *, unsigned);
 int kernelMultitaskerShutdown(int);
-void kernelException(int, unsigned);
+void kernelException(int, unsigned, void *, unsigned);
+int kernelMultitaskerAddCpu(int);
+void kernelMultitaskerStartCpu(int) __attribute__((noreturn));
+void kernelMultitaskerReschedule(void);
+void kernelMultitaskerEnterKernel(void);
+void kernelMultitaskerLeaveKernel(void);
 void kernelMultitaskerDumpProcessList(void);
 int kernelMultitaskerGetCurrentProcessId(void);
 int kernelMultitaskerGetProcess(int, process *);
@@ -151,7 +216,10 @@ int kernelMultitaskerDuplicateIo(int, int, int);
 int kernelMultitaskerGetProcessorTime(clock_t *);
 void kernelMultitaskerYield(void);
 void kernelMultitaskerWait(unsigned);
+void kernelMultitaskerWaitUs(unsigned);
 int kernelMultitaskerBlock(int);
+int kernelMultitaskerFutexWait(volatile int *, int, unsigned);
+int kernelMultitaskerFutexWake(volatile int *, int);
 int kernelMultitaskerDetach(void);
 int kernelMultitaskerKillProcess(int);
 int kernelMultitaskerKillByName(const char *);
@@ -165,8 +233,12 @@ int kernelMultitaskerSetIoPerm(int, int, int);
 kernelPageDirectory *kernelMultitaskerGetPageDir(int);
 loaderSymbolTable *kernelMultitaskerGetSymbols(int);
 int kernelMultitaskerSetSymbols(int, loaderSymbolTable *);
+int kernelMultitaskerSetCachedImage(int, void *);
 int kernelMultitaskerStackTrace(int);
 int kernelMultitaskerPropagateEnvironment(int, const char *);
+int kernelMultitaskerSetProfiling(int);
+int kernelMultitaskerGetProfiling(void);
+int kernelMultitaskerGetProcessStats(int, processStats *);
 
 #endif
 
@@ -145,10 +145,13 @@ static void networkThread(void)
 	kernelNetworkPacket *packet = NULL;
 	kernelNetworkConnection *connection = NULL;
 	linkedListItem *iter = NULL;
+	int busy = 0;
 	int count;
 
 	while (!networkStop)
 	{
+		busy = 0;
+
 		// Loop for each device
 		for (count = 0; count < numDevices; count ++)
 		{
@@ -183,6 +186,8 @@ static void networkThread(void)
 
 			while (netDev->inputStream.count)
 			{
+				busy = 1;
+
 				status = kernelNetworkPacketStreamRead(&netDev->inputStream,
 					&packet);
 				if (status < 0)
@@ -260,6 +265,8 @@ static void networkThread(void)
 
 			while (netDev->outputStream.count)
 			{
+				busy = 1;
+
 				status = kernelNetworkPacketStreamRead(&netDev->outputStream,
 					&packet);
 				if (status < 0)
@@ -303,8 +310,13 @@ static void networkThread(void)
 			}
 		}
 
-		// Finished for this time slice
-		kernelMultitaskerYield();
+		// Finished for this time slice.  If there was nothing to do, sleep
+		// for a bit (until a timer wakes us), so that the CPU can be idle
+		// between packets and time-based processing.
+		if (busy)
+			kernelMultitaskerYield();
+		else
+			kernelMultitaskerWaitUs(NETWORK_THREAD_IDLE_US);
 	}
 
 	// Finished
@@ -43,6 +43,9 @@
 #define NETWORK_TCP_SYN_TIMEOUT_MS			5000
 #define NETWORK_TCP_SYN_RETRIES				5
 
+// How long the network thread sleeps when it finds nothing to do
+#define NETWORK_THREAD_IDLE_US				1000
+
 // A structure to describe and point to sections inside a buffer of packet
 // data
 typedef struct _kernelNetworkPacket {
@@ -31,6 +31,7 @@
 #include "kernelMemory.h"
 #include "kernelMultitasker.h"
 #include "kernelParameters.h"
+#include "kernelSmp.h"
 #include <string.h>
 #include <sys/processor.h>
 
@@ -49,7 +50,9 @@ static volatile int numberPageTables = 0;
 // The physical memory location where we'll store the kernel's paging data.
 static unsigned long kernelPagingData = 0;
 
+static spinLock copyOnWriteLock;
 static int haveGlobalPages = 0;
+static int haveLargePages = 0;
 static int havePageAttributeTable = 0;
 static volatile int initialized = 0;
 
@@ -59,6 +62,14 @@ static volatile int initialized = 0;
 #define getPageNumber(address) \
 	((((unsigned long)(address)) >> 12) & 0x000003FF)
 
+// Internally, map() can ask itself to line up the virtual address with the
+// physical address on large page boundaries
+#define PAGE_MAP_LARGE			0x04
+
+// Page entry flags that the processor sets as the pages are used
+#define PAGEFLAGS_USAGE \
+	(PROCESSOR_PAGEFLAG_ACCESSED | PROCESSOR_PAGEFLAG_DIRTY)
+
 
 static kernelPageTable *findPageTable(kernelPageDirectory *directory,
 	int tableNumber)
@@ -222,6 +233,29 @@ static int findFreePages(kernelPageDirectory *directory, int pages,
 }
 
 
+static unsigned tableEntry(kernelPageDirectory *directory,
+	kernelPageTable *table)
+{
+	// Returns the page directory entry that points to the page table.  Always
+	// enable read/write and page-present.
+
+	unsigned entry = ((unsigned) table->physical |
+		(PROCESSOR_PAGEFLAG_WRITABLE | PROCESSOR_PAGEFLAG_PRESENT));
+
+	// Set the 'user' bit, if this page table is not privileged
+	if (directory->privilege != PRIVILEGE_SUPERVISOR)
+		entry |= PROCESSOR_PAGEFLAG_USER;
+
+	// Set the 'global' bit for the kernel's page tables, so that if this is a
+	// Pentium Pro or better processor, the page table won't be invalidated
+	// during a context switch
+	if ((directory == kernelPageDir) && haveGlobalPages)
+		entry |= PROCESSOR_PAGEFLAG_GLOBAL;
+
+	return (entry);
+}
+
+
 static kernelPageTable *createPageTable(kernelPageDirectory *directory,
 	int number)
 {
@@ -237,6 +271,13 @@ static kernelPageTable *createPageTable(kernelPageDirectory *directory,
 	kernelPageTable *newTable = NULL;
 	int count;
 
+	// Make sure there's a free slot in the page table list
+	if (numberPageTables >= MAX_PROCESSES)
+	{
+		kernelError(kernel_error, "No free page table slots");
+		return (newTable = NULL);
+	}
+
 	// Allocate some physical memory for the page table
 	physicalAddr = (kernelPageTablePhysicalMem *)
 		kernelMemoryGetPhysical(sizeof(kernelPageTablePhysicalMem),
@@ -306,26 +347,12 @@ static kernelPageTable *createPageTable(kernelPageDirectory *directory,
 	newTable->virtual = virtualAddr;
 
 	// Now we actually go into the page directory memory and add the
-	// real page table to the requested slot number.  Always enable
-	// read/write and page-present
-	directory->virtual->table[number] = (unsigned) newTable->physical;
-	directory->virtual->table[number] |= (PROCESSOR_PAGEFLAG_WRITABLE |
-		PROCESSOR_PAGEFLAG_PRESENT);
+	// real page table to the requested slot number.
+	directory->virtual->table[number] = tableEntry(directory, newTable);
 
-	// Set the 'user' bit, if this page table is not privileged
-	if (directory->privilege != PRIVILEGE_SUPERVISOR)
-		directory->virtual->table[number] |= PROCESSOR_PAGEFLAG_USER;
-
-	// A couple of extra things we do if this new page table belongs to the
-	// kernel or one of its threads
+	// If this new page table belongs to the kernel or one of its threads
 	if (directory == kernelPageDir)
 	{
-		// Set the 'global' bit, so that if this is a Pentium Pro or better
-		// processor, the page table won't be invalidated during a context
-		// switch
-		if (haveGlobalPages)
-			directory->virtual->table[number] |= PROCESSOR_PAGEFLAG_GLOBAL;
-
 		// It needs to be 'shared' with all of the other real page
 		// directories.
 		for (count = 0; count < numberPageDirectories; count ++)
@@ -383,8 +410,10 @@ static int deletePageTable(kernelPageDirectory *directory,
 	kernelTable->virtual->page[kernelPageNumber] = NULL;
 	kernelTable->freePages++;
 
-	// Clear the TLB entry for this page
+	// Clear the TLB entry for this page, on all processors
 	processorAddressCacheInvalidatePage(table->virtual);
+	kernelSmpFlushTlb((unsigned) kernelPageDir->physical,
+		(void *) table->virtual, 1);
 
 	// Release the physical memory used by the table
 	status = kernelMemoryReleasePhysical((unsigned) table->physical);
@@ -427,6 +456,101 @@ static int deletePageTable(kernelPageDirectory *directory,
 }
 
 
+static void updateLargePage(kernelPageDirectory *directory,
+	kernelPageTable *table)
+{
+	// The page tables are always kept up to date, but if all of the pages in
+	// one of the kernel's tables map a physically contiguous, aligned large
+	// page with the same attributes, the page directory entry can map the
+	// large page directly instead, which saves TLB entries.  Otherwise, make
+	// sure it points to the page table.
+
+	unsigned first = table->virtual->page[0];
+	unsigned entry = 0;
+	int large = 0;
+	int count;
+
+	if (!haveLargePages || (directory != kernelPageDir))
+		return;
+
+	if ((first & PROCESSOR_PAGEFLAG_PRESENT) &&
+		!((first & 0xFFFFF000) % PROCESSOR_LARGE_PAGE_SIZE))
+	{
+		large = 1;
+
+		for (count = 1; count < PROCESSOR_PAGES_PER_TABLE; count ++)
+		{
+			if ((table->virtual->page[count] & ~PAGEFLAGS_USAGE) !=
+				((first & ~PAGEFLAGS_USAGE) + (count * MEMORY_PAGE_SIZE)))
+			{
+				large = 0;
+				break;
+			}
+		}
+	}
+
+	if (large)
+	{
+		// The PAT bit is in a different place in a large page entry
+		entry = (first & ~(PAGEFLAGS_USAGE | PROCESSOR_PAGEFLAG_PAT));
+		entry |= PROCESSOR_PAGEFLAG_LARGE;
+		if (first & PROCESSOR_PAGEFLAG_PAT)
+			entry |= PROCESSOR_PAGEFLAG_LARGEPAT;
+	}
+	else
+	{
+		entry = tableEntry(directory, table);
+	}
+
+	if (directory->virtual->table[table->tableNumber] == entry)
+		return;
+
+	// The kernel's page directory entries are shared with all of the other
+	// real page directories
+	directory->virtual->table[table->tableNumber] = entry;
+	for (count = 0; count < numberPageDirectories; count ++)
+		pageDirList[count]->virtual->table[table->tableNumber] = entry;
+
+	// Any TLB entry for an old large page needs to go.  Old entries for the
+	// small pages are the same as the new large page, so they can stay.
+	if (table->large)
+	{
+		processorAddressCacheInvalidatePage((void *)(table->tableNumber <<
+			22));
+		kernelSmpFlushTlb((unsigned) directory->physical,
+			(void *)(table->tableNumber << 22), 1);
+	}
+
+	table->large = large;
+}
+
+
+static void updateLargePages(kernelPageDirectory *directory,
+	void *virtualAddress, int pages)
+{
+	// Update the large page status of all of the page tables covering the
+	// range of pages
+
+	kernelPageTable *table = NULL;
+	int tableNumber = 0;
+	int lastTable = 0;
+
+	if (!haveLargePages || (directory != kernelPageDir) || (pages <= 0))
+		return;
+
+	tableNumber = getTableNumber(virtualAddress);
+	lastTable = getTableNumber(virtualAddress +
+		((pages - 1) * MEMORY_PAGE_SIZE));
+
+	for ( ; tableNumber <= lastTable; tableNumber ++)
+	{
+		table = findPageTable(directory, tableNumber);
+		if (table)
+			updateLargePage(directory, table);
+	}
+}
+
+
 static int findPageTableEntry(kernelPageDirectory *directory,
 	void *virtualAddress, unsigned *entry)
 {
@@ -464,6 +588,22 @@ static int findPageTableEntry(kernelPageDirectory *directory,
 }
 
 
+static volatile unsigned *getPageEntry(kernelPageDirectory *directory,
+	void *virtualAddress)
+{
+	// Returns a pointer to the page table entry for the virtual address, or
+	// NULL if there's no page table for it
+
+	kernelPageTable *table = NULL;
+
+	table = findPageTable(directory, getTableNumber(virtualAddress));
+	if (!table)
+		return (NULL);
+
+	return (&table->virtual->page[getPageNumber(virtualAddress)]);
+}
+
+
 static inline unsigned getNumPages(unsigned size)
 {
 	// Turn a size into a number of pages
@@ -528,6 +668,64 @@ static int arePagesAt(kernelPageDirectory *directory, int numPages,
 }
 
 
+static int findLargeFreePages(kernelPageDirectory *directory,
+	unsigned physicalAddress, int pages, void **virtualAddress)
+{
+	// Like findFreePages(), but looks for a range whose offset from a large
+	// page boundary is the same as the physical address', so that all of the
+	// large pages in the middle of it can be mapped as such.  Page tables
+	// that don't exist yet count as free.
+
+	int status = 0;
+	unsigned offset = (physicalAddress % PROCESSOR_LARGE_PAGE_SIZE);
+	int tablesNeeded = 0;
+	kernelPageTable *table = NULL;
+	int tableNumber = 0;
+	int maxTables = 0;
+	void *address = NULL;
+	int count;
+
+	if (directory == kernelPageDir)
+	{
+		tableNumber = getTableNumber(KERNEL_VIRTUAL_ADDRESS);
+		maxTables = PROCESSOR_PAGE_TABLES_PER_DIR;
+	}
+	else
+	{
+		tableNumber = 0;
+		maxTables = getTableNumber(KERNEL_VIRTUAL_ADDRESS);
+	}
+
+	tablesNeeded = (((offset / MEMORY_PAGE_SIZE) + pages +
+		(PROCESSOR_PAGES_PER_TABLE - 1)) / PROCESSOR_PAGES_PER_TABLE);
+
+	for ( ; (tableNumber + tablesNeeded) <= maxTables; tableNumber ++)
+	{
+		address = (void *)((tableNumber << 22) | offset);
+		table = NULL;
+
+		for (count = 0; count < pages; count ++)
+		{
+			if (!table || !getPageNumber(address))
+				table = findPageTable(directory, getTableNumber(address));
+
+			if (table && table->virtual->page[getPageNumber(address)])
+				break;
+
+			address += MEMORY_PAGE_SIZE;
+		}
+
+		if (count >= pages)
+		{
+			*virtualAddress = (void *)((tableNumber << 22) | offset);
+			return (status = 0);
+		}
+	}
+
+	return (status = ERR_NOFREE);
+}
+
+
 static void detectCpuPagingFeatures(void)
 {
 	// Detect paging-related features supported by the CPU, and set things
@@ -564,6 +762,16 @@ static void detectCpuPagingFeatures(void)
 		haveGlobalPages = 1;
 	}
 
+	// Does the processor support large pages (PSE)?
+	if ((regd >> 3) & 1)
+	{
+		processorGetCR4(rega);
+		rega |= 0x00000010;
+		processorSetCR4(rega);
+
+		haveLargePages = 1;
+	}
+
 	// Is there a PAT?
 	if ((regd >> 16) & 1)
 	{
@@ -620,6 +828,31 @@ static int map(kernelPageDirectory *directory, unsigned physicalAddress,
 	// Determine how many pages we need to map
 	numPages = getNumPages(size);
 
+	// If it's big enough for large pages, try to put it where it can use
+	// them
+	if ((flags == PAGE_MAP_ANY) && haveLargePages &&
+		(directory == kernelPageDir) &&
+		(numPages >= PROCESSOR_PAGES_PER_TABLE) &&
+		(findLargeFreePages(directory, physicalAddress, numPages,
+			virtualAddress) >= 0))
+	{
+		flags = PAGE_MAP_LARGE;
+
+		// Make sure there's enough for the next page table, and create the
+		// page tables
+		if (((numPages + 1) >= countFreePages(directory)) &&
+			!createPageTable(directory, findFreeTableNumber(directory)))
+		{
+			flags = PAGE_MAP_ANY;
+		}
+		else if (!arePagesAt(directory, numPages, *virtualAddress,
+			0 /* free */))
+		{
+			// New page tables might have been put in the way
+			flags = PAGE_MAP_ANY;
+		}
+	}
+
 	if (flags == PAGE_MAP_ANY)
 	{
 		// Are there enough free pages in this page directory (plus 1 for the
@@ -657,7 +890,7 @@ static int map(kernelPageDirectory *directory, unsigned physicalAddress,
 			}
 		}
 	}
-	else
+	else if (flags != PAGE_MAP_LARGE)
 	{
 		return (status = ERR_INVALID);
 	}
@@ -718,6 +951,8 @@ static int map(kernelPageDirectory *directory, unsigned physicalAddress,
 		// Loop again
 	}
 
+	updateLargePages(directory, *virtualAddress, getNumPages(size));
+
 	// Return success
 	return (status = 0);
 }
@@ -734,6 +969,7 @@ static int unmap(kernelPageDirectory *directory, void *virtualAddress,
 	unsigned tableNumber = 0;
 	unsigned pageNumber = 0;
 	unsigned numPages = 0;
+	void *flushAddress = virtualAddress;
 
 	// Make sure that our arguments are reasonable.  The wrapper functions
 	// that are used to call us from external locations do not check them.
@@ -796,6 +1032,12 @@ static int unmap(kernelPageDirectory *directory, void *virtualAddress,
 		// Loop again
 	}
 
+	updateLargePages(directory, flushAddress, getNumPages(size));
+
+	// Other processors might have cached the old entries too
+	kernelSmpFlushTlb((unsigned) directory->physical, flushAddress,
+		getNumPages(size));
+
 	// Return success
 	return (status = 0);
 }
@@ -813,6 +1055,13 @@ static kernelPageDirectory *createPageDirectory(int processId)
 	unsigned physicalAddr = 0;
 	kernelPageDirVirtualMem *virtualAddr = NULL;
 
+	// Make sure there's a free slot in the page directory list
+	if (numberPageDirectories >= MAX_PROCESSES)
+	{
+		kernelError(kernel_error, "No free page directory slots");
+		return (directory = NULL);
+	}
+
 	// Get some physical memory for the page directory
 	physicalAddr = kernelMemoryGetPhysical(sizeof(kernelPageDirPhysicalMem),
 		MEMORY_PAGE_SIZE, 0 /* not low memory */, "page directory");
@@ -1148,6 +1397,8 @@ static int setPageAttrs(kernelPageDirectory *directory,
 	int status = 0;
 	kernelPageTable *pageTable = NULL;
 	int pageNumber = 0;
+	void *flushAddress = virtualAddress;
+	int flushPages = pages;
 
 	while (pages > 0)
 	{
@@ -1209,6 +1460,31 @@ static int setPageAttrs(kernelPageDirectory *directory,
 					}
 					break;
 
+				case pageattr_notpresent:
+					// Still mapped, but accessing it will cause a page fault
+					pageTable->virtual->page[pageNumber] &=
+						~PROCESSOR_PAGEFLAG_PRESENT;
+					break;
+
+				case pageattr_present:
+					pageTable->virtual->page[pageNumber] |=
+						PROCESSOR_PAGEFLAG_PRESENT;
+					break;
+
+				case pageattr_copyonwrite:
+					// Read-only until written, then copied
+					pageTable->virtual->page[pageNumber] &=
+						~PROCESSOR_PAGEFLAG_WRITABLE;
+					pageTable->virtual->page[pageNumber] |=
+						PROCESSOR_PAGEFLAG_COPYONWRITE;
+					break;
+
+				case pageattr_shared:
+					// Holds a reference to copy-on-write shared memory
+					pageTable->virtual->page[pageNumber] |=
+						PROCESSOR_PAGEFLAG_SHARED;
+					break;
+
 				default:
 					break;
 			}
@@ -1221,6 +1497,12 @@ static int setPageAttrs(kernelPageDirectory *directory,
 		}
 	}
 
+	updateLargePages(directory, flushAddress, flushPages);
+
+	// Other processors might have cached the old entries too
+	kernelSmpFlushTlb((unsigned) directory->physical, flushAddress,
+		flushPages);
+
 	return (status = 0);
 }
 
@@ -1276,6 +1558,10 @@ int kernelPageInitialize(unsigned kernelMemory)
 	if (status < 0)
 		return (status);
 
+	// Read-only pages need to be read-only for the kernel too, so that its
+	// writes to copy-on-write pages get copied
+	processorSetWriteProtect();
+
 	// Make note that we're initialized
 	initialized = 1;
 
@@ -1395,6 +1681,7 @@ int kernelPageDeleteDirectory(int processId)
 	int status = 0;
 	kernelPageDirectory *directory = NULL;
 	kernelPageTable *table = NULL;
+	int entry = 0;
 	int count;
 
 	// Have we been initialized?
@@ -1432,6 +1719,16 @@ int kernelPageDeleteDirectory(int processId)
 
 		if (table)
 		{
+			// Drop its references to any copy-on-write shared memory
+			for (entry = 0; entry < PROCESSOR_PAGES_PER_TABLE; entry ++)
+			{
+				if (table->virtual->page[entry] & PROCESSOR_PAGEFLAG_SHARED)
+				{
+					kernelMemoryUnshare((table->virtual->page[entry] &
+						0xFFFFF000), MEMORY_PAGE_SIZE);
+				}
+			}
+
 			status = deletePageTable(directory, table);
 			if (status < 0)
 			{
@@ -1641,6 +1938,114 @@ int kernelPageMapped(int processId, void *virtualAddress, unsigned size)
 }
 
 
+int kernelPagePresent(int processId, void *virtualAddress)
+{
+	// Returns 1 if the page containing the virtual address is mapped and
+	// present, 0 if it's mapped but marked not present, or negative if it's
+	// not mapped at all.
+
+	int status = 0;
+	kernelPageDirectory *directory = NULL;
+	kernelPageTable *pageTable = NULL;
+	unsigned entry = 0;
+
+	// Have we been initialized?
+	if (!initialized)
+		return (status = ERR_NOTINITIALIZED);
+
+	if (kernelProcessingInterrupt())
+		return (status = ERR_INVALID);
+
+	// Find the appropriate page directory
+	directory = findPageDirectory(processId);
+	if (!directory)
+		return (status = ERR_NOSUCHENTRY);
+
+	status = kernelLockGet(&directory->lock);
+	if (status < 0)
+	{
+		kernelError(kernel_error, "Can't get lock on page directory");
+		return (status = ERR_NOLOCK);
+	}
+
+	pageTable = findPageTable(directory, getTableNumber(virtualAddress));
+	if (pageTable)
+		entry = pageTable->virtual->page[getPageNumber(virtualAddress)];
+
+	kernelLockRelease(&directory->lock);
+
+	if (!entry)
+		return (status = ERR_NODATA);
+
+	return (status = ((entry & PROCESSOR_PAGEFLAG_PRESENT)? 1 : 0));
+}
+
+
+int kernelPageFaultResolved(int processId, void *virtualAddress,
+	unsigned faultCode)
+{
+	// Given the address and error code of a page fault, returns 1 if the
+	// page entry now allows the access, for example because another thread
+	// read the page in or copied it in the meantime, otherwise 0.
+
+	int status = 0;
+	kernelPageDirectory *directory = NULL;
+	kernelPageTable *pageTable = NULL;
+	unsigned entry = 0;
+
+	// Have we been initialized?
+	if (!initialized)
+		return (status = ERR_NOTINITIALIZED);
+
+	if (kernelProcessingInterrupt())
+		return (status = ERR_INVALID);
+
+	// A protection fault on a page that was already present for reading
+	// can't have been fixed by anyone else
+	if ((virtualAddress >= (void *) KERNEL_VIRTUAL_ADDRESS) ||
+		((faultCode & PROCESSOR_PAGEFAULT_PRESENT) &&
+			!(faultCode & PROCESSOR_PAGEFAULT_WRITE)))
+	{
+		return (status = 0);
+	}
+
+	// Find the appropriate page directory
+	directory = findPageDirectory(processId);
+	if (!directory)
+		return (status = ERR_NOSUCHENTRY);
+
+	status = kernelLockGet(&directory->lock);
+	if (status < 0)
+	{
+		kernelError(kernel_error, "Can't get lock on page directory");
+		return (status = ERR_NOLOCK);
+	}
+
+	pageTable = findPageTable(directory, getTableNumber(virtualAddress));
+	if (pageTable)
+		entry = pageTable->virtual->page[getPageNumber(virtualAddress)];
+
+	kernelLockRelease(&directory->lock);
+
+	if (!(entry & PROCESSOR_PAGEFLAG_PRESENT))
+		return (status = 0);
+
+	if ((faultCode & PROCESSOR_PAGEFAULT_WRITE) &&
+		!(entry & PROCESSOR_PAGEFLAG_WRITABLE))
+	{
+		return (status = 0);
+	}
+
+	if ((faultCode & PROCESSOR_PAGEFAULT_USER) &&
+		!(entry & PROCESSOR_PAGEFLAG_USER))
+	{
+		return (status = 0);
+	}
+
+	return (status = 1);
+}
+
+
 unsigned kernelPageGetPhysical(int processId, void *virtualAddress)
 {
 	// Return the physical address mapped to this virtual address.  The
@@ -1780,6 +2185,217 @@ int kernelPageSetAttrs(int processId, kernelPageAttribute attr,
 }
 
 
+int kernelPageCopyOnWrite(int processId, void *virtualAddress)
+{
+	// Called by the page fault handler, for a write fault in the current
+	// process.  If the page is copy-on-write, then it and any neighbouring
+	// copy-on-write pages that are contiguous in physical memory (such as
+	// the rest of a program's data) are copied to new memory belonging to
+	// the process, which takes their place.  Memory shared using
+	// kernelMemoryShareCopyOnWrite() is only copied if another process still
+	// references it.  Returns 0 if the page is already writable, for example
+	// because another thread copied it first, or negative if it's not a
+	// copy-on-write page.
+
+	int status = 0;
+	kernelPageDirectory *directory = NULL;
+	void *page = (void *) kernelPageRoundDown(virtualAddress);
+	void *start = page;
+	void *end = (page + MEMORY_PAGE_SIZE);
+	void *lowest = NULL;
+	void *highest = (void *) KERNEL_VIRTUAL_ADDRESS;
+	volatile unsigned *entry = NULL;
+	unsigned physical = 0;
+	unsigned shared = 0;
+	int shares = 0;
+	unsigned blockStart = 0;
+	unsigned blockSize = 0;
+	unsigned size = 0;
+	void *copy = NULL;
+	unsigned copyPhysical = 0;
+	void *address = NULL;
+
+	// Have we been initialized?
+	if (!initialized)
+		return (status = ERR_NOTINITIALIZED);
+
+	if (kernelProcessingInterrupt())
+		return (status = ERR_INVALID);
+
+	if (virtualAddress >= (void *) KERNEL_VIRTUAL_ADDRESS)
+		return (status = ERR_NOSUCHENTRY);
+
+	// Find the appropriate page directory
+	directory = findPageDirectory(processId);
+	if (!directory)
+		return (status = ERR_NOSUCHENTRY);
+
+	// Only one copy at a time, so that threads sharing the page directory
+	// don't both copy the same pages
+	status = kernelLockGet(&copyOnWriteLock);
+	if (status < 0)
+		return (status);
+
+	status = kernelLockGet(&directory->lock);
+	if (status < 0)
+	{
+		kernelLockRelease(&copyOnWriteLock);
+		return (status);
+	}
+
+	entry = getPageEntry(directory, page);
+	if (entry && (*entry & PROCESSOR_PAGEFLAG_PRESENT) &&
+		(*entry & PROCESSOR_PAGEFLAG_WRITABLE))
+	{
+		// Another thread copied it while we waited for the lock.  The write
+		// can simply be tried again.
+		kernelLockRelease(&directory->lock);
+		kernelLockRelease(&copyOnWriteLock);
+		return (status = 0);
+	}
+
+	if (!entry || !(*entry & PROCESSOR_PAGEFLAG_PRESENT) ||
+		!(*entry & PROCESSOR_PAGEFLAG_COPYONWRITE))
+	{
+		kernelLockRelease(&directory->lock);
+		kernelLockRelease(&copyOnWriteLock);
+		return (status = ERR_NOSUCHENTRY);
+	}
+
+	physical = (*entry & 0xFFFFF000);
+	shared = (*entry & PROCESSOR_PAGEFLAG_SHARED);
+
+	kernelLockRelease(&directory->lock);
+
+	// Memory shared by kernelMemoryShareCopyOnWrite() is counted, and the
+	// copy mustn't go beyond its memory block
+	if (shared)
+	{
+		shares = kernelMemoryGetShares(physical, &blockStart, &blockSize);
+		if (shares < 0)
+		{
+			kernelLockRelease(&copyOnWriteLock);
+			return (status = shares);
+		}
+
+		lowest = (page - (physical - blockStart));
+		highest = (lowest + blockSize);
+	}
+
+	status = kernelLockGet(&directory->lock);
+	if (status < 0)
+	{
+		kernelLockRelease(&copyOnWriteLock);
+		return (status);
+	}
+
+	// Find the extent of the copy-on-write pages around it
+	while (start > lowest)
+	{
+		entry = getPageEntry(directory, (start - MEMORY_PAGE_SIZE));
+		if (!entry || !(*entry & PROCESSOR_PAGEFLAG_COPYONWRITE) ||
+			((*entry & PROCESSOR_PAGEFLAG_SHARED) != shared) ||
+			((*entry & 0xFFFFF000) !=
+				(physical - (page - start) - MEMORY_PAGE_SIZE)))
+		{
+			break;
+		}
+
+		start -= MEMORY_PAGE_SIZE;
+	}
+
+	while (end < highest)
+	{
+		entry = getPageEntry(directory, end);
+		if (!entry || !(*entry & PROCESSOR_PAGEFLAG_COPYONWRITE) ||
+			((*entry & PROCESSOR_PAGEFLAG_SHARED) != shared) ||
+			((*entry & 0xFFFFF000) != (physical + (end - page))))
+		{
+			break;
+		}
+
+		end += MEMORY_PAGE_SIZE;
+	}
+
+	size = (end - start);
+
+	// If nothing else references the shared memory any more, the process
+	// can simply have it
+	if (shared && (shares <= 1))
+	{
+		kernelDebug(debug_memory, "Page copy-on-write %p-%p for process %d "
+			"is the last reference", start, (end - 1), processId);
+
+		for (address = start; address < end; address += MEMORY_PAGE_SIZE)
+		{
+			entry = getPageEntry(directory, address);
+			*entry &= ~PROCESSOR_PAGEFLAG_COPYONWRITE;
+			*entry |= PROCESSOR_PAGEFLAG_WRITABLE;
+			processorAddressCacheInvalidatePage(address);
+		}
+
+		kernelSmpFlushTlb((unsigned) directory->physical, start,
+			(size / MEMORY_PAGE_SIZE));
+
+		kernelLockRelease(&directory->lock);
+		kernelLockRelease(&copyOnWriteLock);
+		return (status = 0);
+	}
+
+	kernelLockRelease(&directory->lock);
+
+	kernelDebug(debug_memory, "Page copy-on-write %p-%p for process %d",
+		start, (end - 1), processId);
+
+	// Get the new memory, and copy the old pages (which might not have been
+	// filled in yet, so this can cause page faults of its own)
+	copy = kernelMemoryGet(size, "copy-on-write memory");
+	if (!copy)
+	{
+		kernelLockRelease(&copyOnWriteLock);
+		return (status = ERR_MEMORY);
+	}
+
+	memcpy(copy, start, size);
+
+	copyPhysical = kernelPageGetPhysical(processId, copy);
+
+	status = kernelLockGet(&directory->lock);
+	if (status < 0)
+	{
+		kernelLockRelease(&copyOnWriteLock);
+		return (status);
+	}
+
+	// Swap in the new pages, writable, keeping the other attributes
+	for (address = start; address < end; address += MEMORY_PAGE_SIZE)
+	{
+		entry = getPageEntry(directory, address);
+		*entry = ((copyPhysical + (address - start)) | (*entry & 0x0FFF));
+		*entry &= ~(PROCESSOR_PAGEFLAG_COPYONWRITE |
+			PROCESSOR_PAGEFLAG_SHARED);
+		*entry |= (PROCESSOR_PAGEFLAG_WRITABLE | PROCESSOR_PAGEFLAG_PRESENT);
+		processorAddressCacheInvalidatePage(address);
+	}
+
+	kernelSmpFlushTlb((unsigned) directory->physical, start,
+		(size / MEMORY_PAGE_SIZE));
+
+	kernelLockRelease(&directory->lock);
+
+	// The process no longer references the shared pages
+	if (shared)
+		kernelMemoryUnshare((physical - (page - start)), size);
+
+	// The new memory stays with the process, but doesn't need its other
+	// mapping
+	kernelPageUnmap(processId, copy, size);
+
+	kernelLockRelease(&copyOnWriteLock);
+	return (status = 0);
+}
+
+
 #ifdef PAGE_DEBUG
 void kernelPageTableDebug(int processId)
 {
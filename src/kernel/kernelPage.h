@@ -36,7 +36,11 @@ typedef enum {
 	pageattr_readonly,
 	pageattr_privileged,
 	pageattr_writecombine,
-	pageattr_uncacheable
+	pageattr_uncacheable,
+	pageattr_notpresent,
+	pageattr_present,
+	pageattr_copyonwrite,
+	pageattr_shared
 
 } kernelPageAttribute;
 
@@ -74,6 +78,7 @@ typedef volatile struct {
 	int freePages;
 	kernelPageTablePhysicalMem *physical;
 	kernelPageTableVirtualMem *virtual;
+	int large;
 
 } kernelPageTable;
 
@@ -93,9 +98,12 @@ int kernelPageMap(int, unsigned, void *, unsigned);
 int kernelPageMapToFree(int, unsigned, void **, unsigned);
 int kernelPageUnmap(int, void *, unsigned);
 int kernelPageMapped(int, void *, unsigned);
+int kernelPagePresent(int, void *);
+int kernelPageFaultResolved(int, void *, unsigned);
 unsigned kernelPageGetPhysical(int, void *);
 void *kernelPageFindFree(int, unsigned);
 int kernelPageSetAttrs(int, kernelPageAttribute, void *, unsigned);
+int kernelPageCopyOnWrite(int, void *);
 
 #ifdef PAGE_DEBUG
 void kernelPageTableDebug(int);
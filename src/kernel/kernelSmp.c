@@ -0,0 +1,566 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelSmp.c
+//
+
+// This file contains the code for starting the other processors (application
+// processors, or APs) of a multiprocessor system, and for interrupting them.
+// The kernel itself only runs on the boot processor; the APs only run
+// processes' user code, and hand them back to the boot processor whenever
+// they need the kernel (see kernelMultitaskerEnterKernel()).
+
+#include "kernelSmp.h"
+#include "kernelApicDriver.h"
+#include "kernelCpu.h"
+#include "kernelDebug.h"
+#include "kernelDescriptor.h"
+#include "kernelDevice.h"
+#include "kernelError.h"
+#include "kernelLog.h"
+#include "kernelMalloc.h"
+#include "kernelMemory.h"
+#include "kernelMultitasker.h"
+#include "kernelPage.h"
+#include "kernelParameters.h"
+#include "kernelSystemDriver.h"
+#include <string.h>
+#include <sys/multiproc.h>
+#include <sys/processor.h>
+
+#ifdef ARCH_X86
+
+// The AP startup code.  It gets copied to a page below 1MB, where the APs
+// start in real mode at the beginning of the page.  It loads a temporary,
+// flat GDT, switches to protected mode, turns on paging with the kernel's
+// page directory, and jumps to the entry point on the supplied stack.  The
+// parameters at the end are filled in for each AP.
+__asm__ (
+	".pushsection .text \n\t"
+	".code16 \n\t"
+	"smpTrampolineStart: \n\t"
+	"cli \n\t"
+	"movw %cs, %ax \n\t"
+	"movw %ax, %ds \n\t"
+	"xorl %ebx, %ebx \n\t"
+	"movw %ax, %bx \n\t"
+	"shll $4, %ebx \n\t"
+	"lgdtl (smpTrampolineGdtPtr - smpTrampolineStart) \n\t"
+	"movl %cr0, %eax \n\t"
+	"orl $1, %eax \n\t"
+	"movl %eax, %cr0 \n\t"
+	"ljmpl *(smpTrampolineJump - smpTrampolineStart) \n\t"
+	".code32 \n\t"
+	"smpTrampoline32: \n\t"
+	"movw $0x10, %ax \n\t"
+	"movw %ax, %ds \n\t"
+	"movw %ax, %es \n\t"
+	"movw %ax, %fs \n\t"
+	"movw %ax, %gs \n\t"
+	"movw %ax, %ss \n\t"
+	"movl (smpTrampolineCr4 - smpTrampolineStart)(%ebx), %eax \n\t"
+	"movl %eax, %cr4 \n\t"
+	"movl (smpTrampolineCr3 - smpTrampolineStart)(%ebx), %eax \n\t"
+	"movl %eax, %cr3 \n\t"
+	"movl %cr0, %eax \n\t"
+	"orl $0x80010000, %eax \n\t"		// Paging, and kernel write protect
+	"movl %eax, %cr0 \n\t"
+	"movl (smpTrampolineStack - smpTrampolineStart)(%ebx), %esp \n\t"
+	"movl (smpTrampolineEntry - smpTrampolineStart)(%ebx), %eax \n\t"
+	"movl $1, (smpTrampolineStarted - smpTrampolineStart)(%ebx) \n\t"
+	"jmp *%eax \n\t"
+	".align 8 \n\t"
+	"smpTrampolineGdt: \n\t"
+	".quad 0 \n\t"
+	".quad 0x00CF9A000000FFFF \n\t"		// Flat code, selector 0x08
+	".quad 0x00CF92000000FFFF \n\t"		// Flat data, selector 0x10
+	"smpTrampolineGdtPtr: \n\t"
+	".word 23 \n\t"
+	".long 0 \n\t"						// Physical address of the GDT
+	"smpTrampolineJump: \n\t"
+	".long 0 \n\t"						// Physical address of 32-bit code
+	".word 0x08 \n\t"
+	".align 4 \n\t"
+	"smpTrampolineCr3: .long 0 \n\t"
+	"smpTrampolineCr4: .long 0 \n\t"
+	"smpTrampolineStack: .long 0 \n\t"
+	"smpTrampolineEntry: .long 0 \n\t"
+	"smpTrampolineStarted: .long 0 \n\t"
+	"smpTrampolineEnd: \n\t"
+	".popsection"
+);
+
+extern char smpTrampolineStart[], smpTrampoline32[], smpTrampolineGdt[],
+	smpTrampolineGdtPtr[], smpTrampolineJump[], smpTrampolineCr3[],
+	smpTrampolineCr4[], smpTrampolineStack[], smpTrampolineEntry[],
+	smpTrampolineStarted[], smpTrampolineEnd[];
+
+// The address of one of the startup code's fields, in the low memory copy
+#define TRAMPOLINE_FIELD(field) \
+	((volatile unsigned *)(trampoline + (field - smpTrampolineStart)))
+
+static unsigned char *trampoline = NULL;
+static volatile int startingCpu = 0;
+
+#endif
+
+static volatile int cpusOnline = 1;
+
+// For asking other processors to invalidate their TLBs
+static volatile struct {
+	int lock;
+	void *address;
+	unsigned pages;
+
+} tlbFlush;
+
+
+static void spinUs(unsigned microseconds)
+{
+	uquad_t endTime = (kernelCpuGetUs() + microseconds);
+
+	while (kernelCpuGetUs() < endTime)
+		processorPause();
+}
+
+
+static void flushLocalTlb(void)
+{
+	// Invalidate this processor's TLB entries for the requested pages
+
+#ifdef ARCH_X86
+	unsigned cr4 = 0;
+	unsigned count;
+
+	if (!tlbFlush.address || (tlbFlush.pages > SMP_TLBFLUSH_MAX_PAGES))
+	{
+		// Everything.  Reloading CR3 doesn't invalidate global pages, but
+		// toggling CR4[PGE] does.
+		processorGetCR4(cr4);
+		if (cr4 & 0x80)
+		{
+			processorSetCR4(cr4 & ~0x80U);
+			processorSetCR4(cr4);
+		}
+		else
+		{
+			processorAddressCacheInvalidate();
+		}
+	}
+	else
+	{
+		for (count = 0; count < tlbFlush.pages; count ++)
+		{
+			processorAddressCacheInvalidatePage(tlbFlush.address +
+				(count * MEMORY_PAGE_SIZE));
+		}
+	}
+#endif
+}
+
+
+static void reschedInterrupt(void)
+{
+	// The handler for the reschedule inter-processor interrupt
+
+	void *address = NULL;
+
+	processorIsrEnter(address);
+
+	kernelApicEndOfInterrupt();
+	kernelMultitaskerReschedule();
+
+	processorIsrExit(address);
+}
+
+
+static void tlbFlushInterrupt(void)
+{
+	// The handler for the TLB flush inter-processor interrupt
+
+	void *address = NULL;
+
+	processorIsrEnter(address);
+
+	kernelSmpPoll();
+	kernelApicEndOfInterrupt();
+
+	processorIsrExit(address);
+}
+
+
+#ifdef ARCH_X86
+__attribute__((noreturn))
+static void apEntry(void)
+{
+	// APs arrive here from the startup code, in protected mode with paging
+	// turned on, and running on their boot stacks
+
+	int cpuNumber = startingCpu;
+
+	// Load the real GDT and IDT, and the stack segment that goes with them
+	kernelDescriptorLoad();
+	__asm__ __volatile__ ("movw %%ax, %%ss" : : "a" (PRIV_STACK));
+
+	// Join in the multitasking
+	kernelMultitaskerStartCpu(cpuNumber);
+}
+
+
+static int trampolineSetup(void)
+{
+	// Copy the startup code to a low memory page, and map it to the same
+	// address so that it keeps running when paging gets turned on
+
+	int status = 0;
+	unsigned physical = 0;
+	unsigned cr4 = 0;
+
+	physical = kernelMemoryGetPhysical(MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE,
+		1 /* low memory */, "smp startup code");
+	if (!physical)
+		return (status = ERR_MEMORY);
+
+	// The startup IPI can only point below 640KB
+	if ((physical + MEMORY_PAGE_SIZE) > 0xA0000)
+	{
+		kernelError(kernel_error, "No low memory page for processor startup "
+			"code");
+		kernelMemoryReleasePhysical(physical);
+		return (status = ERR_MEMORY);
+	}
+
+	status = kernelPageMap(KERNELPROCID, physical, (void *) physical,
+		MEMORY_PAGE_SIZE);
+	if (status < 0)
+	{
+		kernelMemoryReleasePhysical(physical);
+		return (status);
+	}
+
+	trampoline = (unsigned char *) physical;
+
+	memcpy(trampoline, smpTrampolineStart, (smpTrampolineEnd -
+		smpTrampolineStart));
+
+	*((volatile unsigned *)(trampoline + (smpTrampolineGdtPtr -
+		smpTrampolineStart) + 2)) = (physical + (smpTrampolineGdt -
+		smpTrampolineStart));
+	*TRAMPOLINE_FIELD(smpTrampolineJump) = (physical + (smpTrampoline32 -
+		smpTrampolineStart));
+	*TRAMPOLINE_FIELD(smpTrampolineCr3) = (unsigned)
+		kernelPageGetDirectory(KERNELPROCID)->physical;
+	processorGetCR4(cr4);
+	*TRAMPOLINE_FIELD(smpTrampolineCr4) = cr4;
+	*TRAMPOLINE_FIELD(smpTrampolineEntry) = (unsigned) &apEntry;
+
+	return (status = 0);
+}
+
+
+static void trampolineRemove(void)
+{
+	unsigned physical = (unsigned) trampoline;
+
+	if (!trampoline)
+		return;
+
+	kernelPageUnmap(KERNELPROCID, trampoline, MEMORY_PAGE_SIZE);
+	kernelMemoryReleasePhysical(physical);
+	trampoline = NULL;
+}
+
+
+static int startCpu(int apicId)
+{
+	// Start one AP, using the INIT-SIPI-SIPI sequence
+
+	int status = 0;
+	int cpuNumber = 0;
+	void *stack = NULL;
+	uquad_t timeout = 0;
+	int count;
+
+	cpuNumber = kernelMultitaskerAddCpu(apicId);
+	if (cpuNumber < 0)
+		return (status = cpuNumber);
+
+	stack = kernelMalloc(SMP_BOOT_STACK_SIZE);
+	if (!stack)
+		return (status = ERR_MEMORY);
+
+	startingCpu = cpuNumber;
+	*TRAMPOLINE_FIELD(smpTrampolineStack) = ((unsigned) stack +
+		SMP_BOOT_STACK_SIZE);
+	*TRAMPOLINE_FIELD(smpTrampolineStarted) = 0;
+
+	kernelDebug(debug_multitasker, "SMP start processor %d, APIC ID %d",
+		cpuNumber, apicId);
+
+	// Reset it
+	status = kernelApicSendIpi(apicId, (APIC_IPI_INIT | APIC_IPI_ASSERT |
+		APIC_IPI_LEVEL));
+	if (status < 0)
+		goto out;
+
+	kernelCpuSpinMs(10);
+
+	// Send up to 2 startup IPIs, which give it the page number of the
+	// startup code
+	for (count = 0; count < 2; count ++)
+	{
+		status = kernelApicSendIpi(apicId, (APIC_IPI_STARTUP |
+			((unsigned) trampoline >> 12)));
+		if (status < 0)
+			goto out;
+
+		spinUs(200);
+
+		if (*TRAMPOLINE_FIELD(smpTrampolineStarted))
+			break;
+	}
+
+	// Wait for it to join in
+	timeout = (kernelCpuGetUs() + (SMP_START_TIMEOUT_MS * US_PER_MS));
+	while (!kernelCpus[cpuNumber].online)
+	{
+		if (kernelCpuGetUs() > timeout)
+		{
+			status = ERR_TIMEOUT;
+			goto out;
+		}
+
+		processorPause();
+	}
+
+	cpusOnline += 1;
+	return (status = 0);
+
+out:
+	// The boot stack can't be freed if it got as far as using it
+	if (!*TRAMPOLINE_FIELD(smpTrampolineStarted))
+		kernelFree(stack);
+
+	return (status);
+}
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+//  Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int kernelSmpInitialize(void)
+{
+	// Start any other processors listed in the multiprocessor table.  They
+	// need local APICs, and the local APIC timer for their time slices.
+	// Called after the multitasker is initialized.
+
+	int status = 0;
+#ifdef ARCH_X86
+	kernelDevice *mpDevice = NULL;
+	kernelMultiProcOps *mpOps = NULL;
+	multiProcCpuEntry *cpuEntry = NULL;
+	int bootApicId = 0;
+	int count;
+
+	bootApicId = kernelApicGetId();
+	if ((bootApicId < 0) || !kernelApicTimerRunning())
+		goto out;
+
+	if (kernelDeviceFindType(
+		kernelDeviceGetClass(DEVICESUBCLASS_SYSTEM_MULTIPROC), NULL,
+			&mpDevice, 1) < 1)
+	{
+		goto out;
+	}
+
+	mpOps = (kernelMultiProcOps *) mpDevice->driver->ops;
+
+	kernelCpus[0].apicId = bootApicId;
+
+	status = kernelDescriptorSetIDTInterruptGate(SMP_VECTOR_RESCHEDULE,
+		&reschedInterrupt);
+	if (status < 0)
+		goto out;
+
+	status = kernelDescriptorSetIDTInterruptGate(SMP_VECTOR_TLBFLUSH,
+		&tlbFlushInterrupt);
+	if (status < 0)
+		goto out;
+
+	status = trampolineSetup();
+	if (status < 0)
+		goto out;
+
+	for (count = 0; cpusOnline < SMP_MAX_CPUS; count ++)
+	{
+		cpuEntry = mpOps->driverGetEntry(mpDevice, MULTIPROC_ENTRY_CPU,
+			count);
+		if (!cpuEntry)
+			break;
+
+		if (!(cpuEntry->cpuFlags & MULTIPROC_CPUFLAG_ENABLED) ||
+			(cpuEntry->cpuFlags & MULTIPROC_CPUFLAG_BOOT) ||
+			(cpuEntry->localApicId == bootApicId))
+		{
+			continue;
+		}
+
+		status = startCpu(cpuEntry->localApicId);
+		if (status < 0)
+		{
+			kernelError(kernel_warn, "Processor with APIC ID %d didn't "
+				"start", cpuEntry->localApicId);
+		}
+	}
+
+	trampolineRemove();
+
+out:
+#endif
+	kernelLog("Using %d processor%s", cpusOnline, ((cpusOnline > 1)? "s" :
+		""));
+
+	return (status = 0);
+}
+
+
+int kernelSmpCpus(void)
+{
+	// Returns the number of processors that are running
+
+	return (cpusOnline);
+}
+
+
+void kernelSmpReschedule(int cpuNumber)
+{
+	// Ask another processor to run its scheduler
+
+	if ((cpuNumber < 0) || (cpuNumber >= SMP_MAX_CPUS) ||
+		!kernelCpus[cpuNumber].online)
+	{
+		return;
+	}
+
+	kernelApicSendIpi(kernelCpus[cpuNumber].apicId, (APIC_IPI_FIXED |
+		SMP_VECTOR_RESCHEDULE));
+}
+
+
+void kernelSmpFlushTlb(unsigned pageDir, void *address, unsigned pages)
+{
+	// Called after page table entries have been changed or removed, to make
+	// any other processors that might have cached them invalidate their TLB
+	// entries.  A NULL address means all of them.  Kernel addresses are
+	// shared by all page directories; otherwise only processors using the
+	// page directory with the physical address 'pageDir' are interrupted.
+
+	kernelCpuData *self = NULL;
+	kernelCpuData *cpu = NULL;
+	int interrupts = 0;
+	int lock = 0;
+	uquad_t timeout = 0;
+	int count;
+
+	if (cpusOnline < 2)
+		return;
+
+	processorSuspendInts(interrupts);
+
+	do {
+		lock = 1;
+		processorExchange(tlbFlush.lock, lock);
+		if (lock)
+			kernelSmpPoll();
+	} while (lock);
+
+	tlbFlush.address = address;
+	tlbFlush.pages = pages;
+
+	// The page table changes must be visible before we look at which page
+	// directories the other processors are using.  Any that load this one
+	// afterwards will get the new entries.
+	processorBarrier();
+
+	self = kernelMultitaskerGetCpu();
+
+	for (count = 0; count < SMP_MAX_CPUS; count ++)
+	{
+		cpu = &kernelCpus[count];
+
+		if ((cpu == self) || !cpu->online)
+			continue;
+
+		if (address && ((unsigned) address < KERNEL_VIRTUAL_ADDRESS) &&
+			(cpu->pageDirectory != pageDir))
+		{
+			continue;
+		}
+
+		cpu->tlbFlushPending = 1;
+		kernelApicSendIpi(cpu->apicId, (APIC_IPI_FIXED |
+			SMP_VECTOR_TLBFLUSH));
+	}
+
+	// Wait for them
+	timeout = (kernelCpuGetUs() + SMP_TLBFLUSH_TIMEOUT_US);
+	for (count = 0; count < SMP_MAX_CPUS; count ++)
+	{
+		while (kernelCpus[count].tlbFlushPending)
+		{
+			if (kernelCpuGetUs() > timeout)
+			{
+				kernelError(kernel_warn, "Processor %d didn't flush its TLB",
+					count);
+				kernelCpus[count].tlbFlushPending = 0;
+				break;
+			}
+
+			processorPause();
+		}
+	}
+
+	lock = 0;
+	processorExchange(tlbFlush.lock, lock);
+
+	processorRestoreInts(interrupts);
+}
+
+
+void kernelSmpPoll(void)
+{
+	// Do anything other processors have asked for.  Called from the
+	// inter-processor interrupt handlers, and by anything spinning with
+	// interrupts disabled.
+
+	kernelCpuData *cpu = kernelMultitaskerGetCpu();
+
+	if (cpu->tlbFlushPending)
+	{
+		flushLocalTlb();
+		processorBarrier();
+		cpu->tlbFlushPending = 0;
+	}
+}
+
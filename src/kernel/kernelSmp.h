@@ -0,0 +1,48 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelSmp.h
+//
+
+#ifndef _KERNELSMP_H
+#define _KERNELSMP_H
+
+// The most processors we'll use, including the boot processor
+#define SMP_MAX_CPUS				16
+
+// Local interrupt vectors for inter-processor interrupts.  These are just
+// below the local APIC timer's, and above any that IRQs get.
+#define SMP_VECTOR_RESCHEDULE		0xEE
+#define SMP_VECTOR_TLBFLUSH			0xED
+
+#define SMP_BOOT_STACK_SIZE			4096
+#define SMP_START_TIMEOUT_MS		100
+#define SMP_TLBFLUSH_TIMEOUT_US		100000
+
+// Above this many pages, other processors flush their whole TLBs
+#define SMP_TLBFLUSH_MAX_PAGES		32
+
+// Functions exported by kernelSmp.c
+int kernelSmpInitialize(void);
+int kernelSmpCpus(void);
+void kernelSmpReschedule(int);
+void kernelSmpFlushTlb(unsigned, void *, unsigned);
+void kernelSmpPoll(void);
+
+#endif
+
@@ -69,7 +69,10 @@ static kernelTextArea consoleArea = {
 	NULL,							// font
 	CHARSET_NAME_DEFAULT,			// charSet
 	NULL,							// window component
-	0								// no-scroll flag
+	0,								// no-scroll flag
+	0,								// dirty first row
+	0,								// dirty rows
+	0								// update batch
 };
 
 // So nobody can use us until we're ready
@@ -989,9 +992,12 @@ int kernelTextStreamPrintLine(kernelTextOutputStream *outputStream,
 		return (status = ERR_NOSUCHFUNCTION);
 
 	// We will call the text stream output driver function with the characters
-	// we were passed
+	// we were passed.  Hold off any screen updates until the newline has been
+	// printed as well.
+	outputStream->textArea->updateBatch += 1;
 	status = outputStream->outputDriver->print(outputStream->textArea, output,
 		NULL);
+	outputStream->textArea->updateBatch -= 1;
 
 	// Print the newline too
 	outputStream->outputDriver->print(outputStream->textArea, "\n", NULL);
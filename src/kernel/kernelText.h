@@ -90,6 +90,9 @@ typedef volatile struct {
 	char *charSet;
 	volatile struct _kernelWindowComponent *windowComponent;
 	int noScroll;
+	int dirtyFirstRow;
+	int dirtyRows;
+	int updateBatch;
 
 } kernelTextArea;
 
@@ -0,0 +1,390 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelTimer.c
+//
+
+// This is the kernel's one-shot timer layer.  Rather than taking an interrupt
+// at a fixed rate, the timer interrupt is programmed for the next thing that
+// actually needs to happen: the end of the current time slice, or the
+// earliest entry in the timer queue.  The best available clock event device
+// is used to generate the interrupts, with the system timer (PIT) as the
+// fallback.  With more than one processor, the timer queue belongs to the
+// boot processor; the others only use their own clock event devices for
+// their time slices.
+
+#include "kernelTimer.h"
+#include "kernelCpu.h"
+#include "kernelError.h"
+#include "kernelInterrupt.h"
+#include "kernelLog.h"
+#include "kernelMultitasker.h"
+#include "kernelPic.h"
+#include "kernelSysTimer.h"
+#include <time.h>
+#include <sys/processor.h>
+
+// The length of one legacy system timer tick (a full PIT count)
+#define LEGACY_TICK_US \
+	(((uquad_t) SYSTIMER_FULLCOUNT * US_PER_SEC) / SYSTIMER_FREQ_HZ)
+
+static kernelClockEvent *clockEvent = NULL;
+static void (*eventHandler)(void) = NULL;
+static kernelTimer *timerQueue = NULL;
+static uquad_t lastTick = 0;
+
+
+static void pitInterrupt(void)
+{
+	// This is the system timer interrupt handler, when the PIT is the clock
+	// event device
+
+	void *address = NULL;
+
+	processorIsrEnter(address);
+
+	kernelPicEndOfInterrupt(INTERRUPT_NUM_SYSTIMER);
+	kernelTimerEvent();
+
+	processorIsrExit(address);
+}
+
+
+static int pitStart(void)
+{
+	int status = 0;
+
+	status = kernelInterruptHook(INTERRUPT_NUM_SYSTIMER, &pitInterrupt);
+	if (status < 0)
+		return (status);
+
+	return (status = kernelPicMask(INTERRUPT_NUM_SYSTIMER, 1));
+}
+
+
+static int pitSetNext(uquad_t deadline __attribute__((unused)),
+	unsigned delay)
+{
+	// Single countdown
+
+	unsigned count = (((uquad_t) delay * SYSTIMER_FREQ_HZ) / US_PER_SEC);
+
+	if (!count)
+		count = 1;
+	if (count >= SYSTIMER_FULLCOUNT)
+		count = (SYSTIMER_FULLCOUNT - 1);
+
+	return (kernelSysTimerSetupTimer(0 /* timer */, 0 /* mode */, count));
+}
+
+
+static kernelClockEvent pitClockEvent = {
+	"PIT",
+	20,		// minDelay
+	(unsigned) ((((uquad_t) SYSTIMER_FULLCOUNT - 1) * US_PER_SEC) /
+		SYSTIMER_FREQ_HZ),	// maxDelay
+	pitStart,
+	pitSetNext,
+	NULL	// stop
+};
+
+
+static void legacyTicks(uquad_t now)
+{
+	// The system timer no longer interrupts at a regular rate, so keep its
+	// tick count going based on the elapsed time
+
+	while ((now - lastTick) >= LEGACY_TICK_US)
+	{
+		lastTick += LEGACY_TICK_US;
+		kernelSysTimerTick();
+	}
+}
+
+
+static void runExpired(uquad_t now)
+{
+	// Call the functions of any timers that have expired.  Interrupts are
+	// disabled.
+
+	kernelTimer *timer = NULL;
+
+	while (timerQueue && (timerQueue->expires <= now))
+	{
+		timer = timerQueue;
+		timerQueue = timer->next;
+		timer->next = NULL;
+		timer->pending = 0;
+
+		if (timer->function)
+			timer->function(timer->data);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+//  Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int kernelTimerRegisterClockEvent(kernelClockEvent *event)
+{
+	// Called by drivers for timer hardware that's better than the PIT.  The
+	// last one registered before kernelTimerInitialize() gets used.
+
+	int status = 0;
+
+	// Check params
+	if (!event || !event->start || !event->setNext)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (eventHandler)
+		return (status = ERR_BUSY);
+
+	clockEvent = event;
+
+	return (status = 0);
+}
+
+
+int kernelTimerInitialize(void (*handler)(void))
+{
+	// Start the clock event device.  The handler gets called from the timer
+	// interrupt, after any expired timers have been run, and is expected to
+	// call kernelTimerProgram() before returning.  Interrupts should be
+	// disabled.
+
+	int status = 0;
+
+	// Check params
+	if (!handler)
+		return (status = ERR_NULLPARAMETER);
+
+	// Measure the timestamp counter now, while we still can use the PIT to
+	// do it
+	kernelCpuTimestampFreq();
+
+	if (!clockEvent)
+		clockEvent = &pitClockEvent;
+
+	status = clockEvent->start();
+	if ((status < 0) && (clockEvent != &pitClockEvent))
+	{
+		kernelError(kernel_warn, "Couldn't start %s timer, using the PIT",
+			clockEvent->name);
+		clockEvent = &pitClockEvent;
+		status = clockEvent->start();
+	}
+
+	if (status < 0)
+		return (status);
+
+	// If something else is doing the job, we don't want interrupts from
+	// the PIT
+	if (clockEvent != &pitClockEvent)
+		kernelPicMask(INTERRUPT_NUM_SYSTIMER, 0);
+
+	lastTick = kernelCpuGetUs();
+	eventHandler = handler;
+
+	kernelLog("Using %s timer for clock events", clockEvent->name);
+
+	return (status = 0);
+}
+
+
+int kernelTimerShutdown(void)
+{
+	// Stop the clock event device, and restore the normal operation of the
+	// system timer
+
+	int status = 0;
+
+	if (!eventHandler)
+		return (status = ERR_NOTINITIALIZED);
+
+	if (clockEvent->stop)
+		clockEvent->stop();
+
+	eventHandler = NULL;
+
+	// Restore the normal operation of the system timer 0, which is mode 3,
+	// initial count of 0
+	status = kernelSysTimerSetupTimer(0 /* timer */, 3 /* mode */,
+		0 /* count 0x10000 */);
+	if (status < 0)
+		kernelError(kernel_warn, "Couldn't restore system timer");
+
+	// Restore the old default system timer interrupt handler
+	status = kernelSysTimerHook();
+	if (status < 0)
+		kernelError(kernel_warn, "Couldn't hook system timer interrupt");
+
+	return (status);
+}
+
+
+const char *kernelTimerClockEventName(void)
+{
+	if (!clockEvent)
+		return (NULL);
+
+	return (clockEvent->name);
+}
+
+
+void kernelTimerEvent(void)
+{
+	// Called by the clock event interrupt handler, with interrupts disabled
+
+	uquad_t now = 0;
+
+	if (kernelMultitaskerGetCpu()->number)
+	{
+		if (eventHandler)
+			eventHandler();
+		return;
+	}
+
+	now = kernelCpuGetUs();
+
+	legacyTicks(now);
+	runExpired(now);
+
+	if (eventHandler)
+		eventHandler();
+}
+
+
+void kernelTimerProgram(uquad_t deadline)
+{
+	// Program the next clock event for the requested deadline, or when the
+	// next timer expires if that's sooner.  A deadline of 0 means there's
+	// nothing else to do.  Interrupts should be disabled.
+
+	uquad_t now = 0;
+	uquad_t delay = 0;
+
+	if (!eventHandler)
+		return;
+
+	if (timerQueue && !kernelMultitaskerGetCpu()->number &&
+		(!deadline || (timerQueue->expires < deadline)))
+	{
+		deadline = timerQueue->expires;
+	}
+
+	now = kernelCpuGetUs();
+
+	if (!deadline)
+		delay = TIMER_MAX_IDLE_US;
+	else if (deadline > now)
+		delay = (deadline - now);
+
+	if (delay < clockEvent->minDelay)
+		delay = clockEvent->minDelay;
+	if (delay > clockEvent->maxDelay)
+		delay = clockEvent->maxDelay;
+	if (delay > TIMER_MAX_IDLE_US)
+		delay = TIMER_MAX_IDLE_US;
+
+	if (clockEvent->setNext((now + delay), (unsigned) delay) < 0)
+		kernelError(kernel_warn, "Unable to program the %s timer",
+			clockEvent->name);
+}
+
+
+void kernelTimerAdd(kernelTimer *timer, uquad_t expires)
+{
+	// Add the timer to the queue (or move it, if it's already there) to
+	// expire at the requested time
+
+	int interrupts = 0;
+	kernelTimer **prev = NULL;
+
+	// Check params
+	if (!timer)
+		return;
+
+	processorSuspendInts(interrupts);
+
+	if (timer->pending)
+		kernelTimerCancel(timer);
+
+	timer->expires = expires;
+
+	// Keep the queue in order of expiry
+	prev = &timerQueue;
+	while (*prev && ((*prev)->expires <= expires))
+		prev = &((*prev)->next);
+
+	timer->next = *prev;
+	*prev = timer;
+	timer->pending = 1;
+
+	processorRestoreInts(interrupts);
+}
+
+
+void kernelTimerCancel(kernelTimer *timer)
+{
+	// Remove the timer from the queue, if it's there
+
+	int interrupts = 0;
+	kernelTimer **prev = NULL;
+
+	// Check params
+	if (!timer)
+		return;
+
+	processorSuspendInts(interrupts);
+
+	if (timer->pending)
+	{
+		prev = &timerQueue;
+		while (*prev && (*prev != timer))
+			prev = &((*prev)->next);
+
+		if (*prev)
+			*prev = timer->next;
+
+		timer->next = NULL;
+		timer->pending = 0;
+	}
+
+	processorRestoreInts(interrupts);
+}
+
+
+uquad_t kernelTimerNextExpiry(void)
+{
+	// Returns the expiry time of the first timer in the queue, or 0 if it's
+	// empty
+
+	if (!timerQueue)
+		return (0);
+
+	return (timerQueue->expires);
+}
+
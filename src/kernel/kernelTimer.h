@@ -0,0 +1,67 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This program is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation; either version 2 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+//  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License along
+//  with this program; if not, write to the Free Software Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  kernelTimer.h
+//
+
+#ifndef _KERNELTIMER_H
+#define _KERNELTIMER_H
+
+#include <sys/types.h>
+
+// The longest we'll let the CPU go without a timer interrupt, when nothing
+// is due sooner
+#define TIMER_MAX_IDLE_US			1000000
+
+// A clock event device is a source of one-shot timer interrupts.  Its
+// interrupt handler must acknowledge the interrupt and then call
+// kernelTimerEvent().  All times are in microseconds, from kernelCpuGetUs().
+typedef struct {
+	const char *name;
+	unsigned minDelay;
+	unsigned maxDelay;
+	int (*start)(void);
+	int (*setNext)(uquad_t, unsigned);	// deadline, delay
+	int (*stop)(void);
+
+} kernelClockEvent;
+
+// An entry in the timer queue.  The function is called with interrupts
+// disabled, from the clock event interrupt, so it must be quick.
+typedef struct _kernelTimer {
+	uquad_t expires;
+	void (*function)(void *);
+	void *data;
+	int pending;
+	struct _kernelTimer *next;
+
+} kernelTimer;
+
+// Functions exported by kernelTimer.c
+int kernelTimerRegisterClockEvent(kernelClockEvent *);
+int kernelTimerInitialize(void (*)(void));
+int kernelTimerShutdown(void);
+const char *kernelTimerClockEventName(void);
+void kernelTimerEvent(void);
+void kernelTimerProgram(uquad_t);
+void kernelTimerAdd(kernelTimer *, uquad_t);
+void kernelTimerCancel(kernelTimer *);
+uquad_t kernelTimerNextExpiry(void);
+
+#endif
+
@@ -299,7 +299,9 @@ static void usbThread(void)
 
 	while (1)
 	{
-		kernelMultitaskerYield();
+		// Hub status changes only need to be polled occasionally; sleep in
+		// between, rather than taking every time slice
+		kernelMultitaskerWait(USB_THREAD_INTERVAL_MS);
 
 		// Call applicable thread calls for all the hubs
 		hub = linkedListIterStart(&hubList, &iter);
@@ -28,6 +28,7 @@
 #include <sys/vis.h>
 
 #define USB_STD_TIMEOUT_MS		2000
+#define USB_THREAD_INTERVAL_MS	20
 
 // The 4 USB controller types
 typedef enum {
@@ -292,9 +292,21 @@ typedef volatile struct {
 
 typedef volatile struct {
 	graphicBuffer buffer;
+	unsigned memorySize;
+	int mappedPid;
+	void *mappedData;
+	void *nextMapped;
 
 } kernelWindowCanvas;
 
+typedef struct {
+	kernelWindowComponent *component;
+	int item;
+	int state;
+	unsigned requestTime;
+
+} kernelWindowListSlot;
+
 typedef volatile struct {
 	windowListType type;
 	int columns;
@@ -306,6 +318,10 @@ typedef volatile struct {
 	int selectedItem;
 	int firstVisibleRow;
 	int itemRows;
+	int numItems;
+	int virtual;
+	int numSlots;
+	kernelWindowListSlot *slots;
 	kernelWindowComponent *container;
 	kernelWindowComponent *scrollBar;
 
@@ -400,6 +416,8 @@ typedef volatile struct {
 	int visibleItems;
 	int scrolledLines;
 	int selectedItem;
+	int *itemRows;
+	int *rowItems;
 	kernelWindowComponent *container;
 	kernelWindowComponent *scrollBar;
 
@@ -695,6 +713,8 @@ kernelWindowComponent *kernelWindowNewList(objectKey, windowListType,
 	int, int, int, listItemParameters *, int, componentParameters *);
 kernelWindowComponent *kernelWindowNewListItem(objectKey, windowListType,
 	listItemParameters *, componentParameters *);
+kernelWindowComponent *kernelWindowNewVirtualList(objectKey, windowListType,
+	int, int, int, int, componentParameters *);
 kernelWindow *kernelWindowNewMenu(kernelWindow *, kernelWindowComponent *,
 	const char *, windowMenuContents *, componentParameters *);
 kernelWindowComponent *kernelWindowNewMenuBar(kernelWindow *,
@@ -727,8 +747,15 @@ kernelWindowComponent *kernelWindowNewTree(objectKey, windowTreeItem *, int,
 	int, componentParameters *);
 
 // Additional component-specific functions
+int kernelWindowCanvasMapBuffer(kernelWindowComponent *, graphicBuffer *);
+int kernelWindowCanvasPresent(kernelWindowComponent *, int, int, int, int);
+void kernelWindowCanvasProcessExit(int);
 int kernelWindowContainerAdd(kernelWindowComponent *, objectKey);
 int kernelWindowContainerDelete(kernelWindowComponent *, objectKey);
+int kernelWindowListSetNumItems(kernelWindowComponent *, int);
+int kernelWindowListSetItems(kernelWindowComponent *, int,
+	listItemParameters *, int);
+int kernelWindowListScrollTo(kernelWindowComponent *, int);
 int kernelWindowMenuUpdate(kernelWindow *, const char *, const char *,
 	windowMenuContents *, componentParameters *);
 int kernelWindowMenuDestroy(kernelWindow *);
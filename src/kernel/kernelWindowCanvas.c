@@ -25,8 +25,106 @@
 #include "kernelWindow.h"	// Our prototypes are here
 #include "kernelDebug.h"
 #include "kernelGraphic.h"
+#include "kernelError.h"
 #include "kernelImage.h"
+#include "kernelLock.h"
 #include "kernelMalloc.h"
+#include "kernelMemory.h"
+#include "kernelMultitasker.h"
+#include "kernelPage.h"
+#include "kernelParameters.h"
+
+
+// The canvases whose buffers are mapped into processes, so that the mappings
+// can be forgotten when the processes go away
+static kernelWindowCanvas *mappedCanvases = NULL;
+static spinLock mappedLock;
+
+
+static void removeMapped(kernelWindowCanvas *canvas)
+{
+	// Take the canvas out of the list of mapped ones.  The list must be
+	// locked.
+
+	kernelWindowCanvas *listCanvas = NULL;
+
+	if (mappedCanvases == canvas)
+	{
+		mappedCanvases = canvas->nextMapped;
+	}
+	else
+	{
+		for (listCanvas = mappedCanvases; listCanvas;
+			listCanvas = listCanvas->nextMapped)
+		{
+			if (listCanvas->nextMapped == canvas)
+			{
+				listCanvas->nextMapped = canvas->nextMapped;
+				break;
+			}
+		}
+	}
+
+	canvas->nextMapped = NULL;
+	canvas->mappedPid = 0;
+	canvas->mappedData = NULL;
+}
+
+
+static void unmapBuffer(kernelWindowCanvas *canvas)
+{
+	// If the canvas buffer is mapped into a process' address space, remove
+	// that mapping.  The mapping is forgotten when the process is deleted, so
+	// if we still have one, the process is still there.
+
+	if (kernelLockGet(&mappedLock) < 0)
+		return;
+
+	if (canvas->mappedData)
+	{
+		kernelDebug(debug_gui, "WindowCanvas unmap buffer from process %d",
+			canvas->mappedPid);
+
+		kernelPageUnmap(canvas->mappedPid, canvas->mappedData,
+			canvas->memorySize);
+
+		removeMapped(canvas);
+	}
+
+	kernelLockRelease(&mappedLock);
+}
+
+
+static int allocBuffer(kernelWindowCanvas *canvas, int width, int height)
+{
+	// The canvas buffer comes from whole pages of system memory (rather than
+	// the kernel heap) so that it can be mapped into the address space of
+	// the process that's drawing on it.
+
+	canvas->buffer.width = width;
+	canvas->buffer.height = height;
+	canvas->memorySize = kernelPageRoundUp(
+		kernelGraphicCalculateAreaBytes(width, height));
+
+	canvas->buffer.data = kernelMemoryGetSystem(canvas->memorySize,
+		"canvas buffer");
+	if (!canvas->buffer.data)
+		return (ERR_MEMORY);
+
+	return (0);
+}
+
+
+static void freeBuffer(kernelWindowCanvas *canvas)
+{
+	unmapBuffer(canvas);
+
+	if (canvas->buffer.data)
+	{
+		kernelMemoryReleaseSystem(canvas->buffer.data);
+		canvas->buffer.data = NULL;
+	}
+}
 
 
 static void drawFocus(kernelWindowComponent *component, int focus)
@@ -82,16 +180,12 @@ static int resize(kernelWindowComponent *component, int width, int height)
 	if (status < 0)
 		return (status);
 
-	// Re-allocate the canvas buffer
-	canvas->buffer.width = width;
-	canvas->buffer.height = height;
-	canvas->buffer.data = kernelRealloc(canvas->buffer.data,
-		kernelGraphicCalculateAreaBytes(width, height));
-	if (!canvas->buffer.data)
-	{
-		status = ERR_MEMORY;
+	// Re-allocate the canvas buffer.  Any process mapping of the old buffer
+	// goes away, and the program will have to map the new one.
+	freeBuffer(canvas);
+	status = allocBuffer(canvas, width, height);
+	if (status < 0)
 		goto out;
-	}
 
 	// Resize the canvas image
 	status = kernelImageResize(&tmpImage, width, height);
@@ -220,8 +314,7 @@ static int destroy(kernelWindowComponent *component)
 	// Release all our memory
 	if (canvas)
 	{
-		if (canvas->buffer.data)
-			kernelFree(canvas->buffer.data);
+		freeBuffer(canvas);
 
 		kernelFree(component->data);
 		component->data = NULL;
@@ -281,19 +374,15 @@ kernelWindowComponent *kernelWindowNewCanvas(objectKey parent, int width,
 		return (component = NULL);
 	}
 
+	component->data = (void *) canvas;
+
 	// Get a graphic buffer
-	canvas->buffer.width = width;
-	canvas->buffer.height = height;
-	canvas->buffer.data = kernelMalloc(kernelGraphicCalculateAreaBytes(width,
-		height));
-	if (!canvas->buffer.data)
+	if (allocBuffer(canvas, width, height) < 0)
 	{
 		kernelWindowComponentDestroy(component);
 		return (component = NULL);
 	}
 
-	component->data = (void *) canvas;
-
 	// If a custom background was specified, fill it with that color
 	if (params->flags & COMP_PARAMS_FLAG_CUSTOMBACKGROUND)
 	{
@@ -305,3 +394,191 @@ kernelWindowComponent *kernelWindowNewCanvas(objectKey parent, int width,
 	return (component);
 }
 
+
+
+int kernelWindowCanvasMapBuffer(kernelWindowComponent *component,
+	graphicBuffer *buffer)
+{
+	// Map the canvas' graphic buffer into the address space of the calling
+	// process, so that it can draw directly into it without making a kernel
+	// API call for each drawing operation.  When it's done drawing, it calls
+	// kernelWindowCanvasPresent() with the damaged area.  The mapping is
+	// removed if the canvas is resized, in which case the program needs to
+	// call this again.
+
+	int status = 0;
+	kernelWindowCanvas *canvas = NULL;
+	int processId = 0;
+	kernelPageDirectory *directory = NULL;
+	unsigned physical = 0;
+	void *virtual = NULL;
+
+	// Check params
+	if (!component || !buffer)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (component->type != canvasComponentType)
+	{
+		kernelError(kernel_error, "Component is not a canvas");
+		return (status = ERR_INVALID);
+	}
+
+	canvas = component->data;
+	processId = kernelMultitaskerGetCurrentProcessId();
+
+	kernelDebug(debug_gui, "WindowCanvas map buffer into process %d",
+		processId);
+
+	// Only the process that owns the window, or its threads (which share its
+	// address space) can map the canvas
+	directory = kernelPageGetDirectory(processId);
+	if (!directory || (directory != kernelPageGetDirectory(component->
+		window->processId)))
+	{
+		kernelError(kernel_error, "Process %d doesn't own the canvas",
+			processId);
+		return (status = ERR_PERMISSION);
+	}
+
+	// The mapping belongs to the process that owns the address space, so
+	// that it stays valid for as long as the address space does
+	processId = directory->processId;
+
+	if (canvas->mappedData && (canvas->mappedPid != processId))
+	{
+		// Only one process can have the buffer mapped at a time
+		unmapBuffer(canvas);
+	}
+
+	status = kernelLockGet(&mappedLock);
+	if (status < 0)
+		return (status);
+
+	if (!canvas->mappedData)
+	{
+		// The buffer is one block of physical memory
+		physical = kernelPageGetPhysical(KERNELPROCID, canvas->buffer.data);
+		if (!physical)
+		{
+			status = ERR_BADADDRESS;
+			goto out;
+		}
+
+		status = kernelPageMapToFree(processId, physical, &virtual,
+			canvas->memorySize);
+		if (status < 0)
+			goto out;
+
+		canvas->mappedPid = processId;
+		canvas->mappedData = virtual;
+		canvas->nextMapped = (void *) mappedCanvases;
+		mappedCanvases = canvas;
+	}
+
+	buffer->width = canvas->buffer.width;
+	buffer->height = canvas->buffer.height;
+	buffer->data = canvas->mappedData;
+
+	status = 0;
+
+out:
+	kernelLockRelease(&mappedLock);
+	return (status);
+}
+
+
+int kernelWindowCanvasPresent(kernelWindowComponent *component, int xCoord,
+	int yCoord, int width, int height)
+{
+	// After a program has drawn directly into its mapping of the canvas
+	// buffer, this puts the damaged area on the screen
+
+	int status = 0;
+
+	// Check params
+	if (!component)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (component->type != canvasComponentType)
+	{
+		kernelError(kernel_error, "Component is not a canvas");
+		return (status = ERR_INVALID);
+	}
+
+	// Clip the area to the canvas
+	if (xCoord < 0)
+	{
+		width += xCoord;
+		xCoord = 0;
+	}
+	if (yCoord < 0)
+	{
+		height += yCoord;
+		yCoord = 0;
+	}
+	if ((xCoord + width) > component->width)
+		width = (component->width - xCoord);
+	if ((yCoord + height) > component->height)
+		height = (component->height - yCoord);
+
+	if ((width <= 0) || (height <= 0))
+		return (status = 0);
+
+	kernelDebug(debug_gui, "WindowCanvas present %d,%d %dx%d", xCoord,
+		yCoord, width, height);
+
+	// Copy the damaged area into the window buffer, and update the screen
+	status = kernelGraphicCopyBuffer((graphicBuffer *) &((kernelWindowCanvas *)
+		component->data)->buffer, xCoord, yCoord, component->buffer,
+		(component->xCoord + xCoord), (component->yCoord + yCoord), width,
+		height);
+	if (status < 0)
+		return (status);
+
+	if (component->flags & WINDOW_COMP_FLAG_VISIBLE)
+	{
+		component->window->update(component->window,
+			(component->xCoord + xCoord), (component->yCoord + yCoord),
+			width, height);
+	}
+
+	return (status = 0);
+}
+
+
+void kernelWindowCanvasProcessExit(int processId)
+{
+	// Called when a process is being deleted.  Forget any canvas mappings in
+	// its address space, so that we don't later try to unmap them from some
+	// new process that gets the same process ID.
+
+	kernelWindowCanvas *canvas = NULL;
+	kernelWindowCanvas *next = NULL;
+
+	if (!mappedCanvases)
+		return;
+
+	if (kernelLockGet(&mappedLock) < 0)
+		return;
+
+	for (canvas = mappedCanvases; canvas; canvas = next)
+	{
+		next = canvas->nextMapped;
+
+		if (canvas->mappedPid == processId)
+		{
+			kernelDebug(debug_gui, "WindowCanvas process %d exited",
+				processId);
+			removeMapped(canvas);
+		}
+	}
+
+	kernelLockRelease(&mappedLock);
+}
+
@@ -21,17 +21,208 @@
 
 // This code is for managing kernelWindowList objects.  These are containers
 // for kernelWindowListItem components.
+//
+// A list can also be 'virtual', in which case the application only tells us
+// how many items there are.  We keep a small pool of kernelWindowListItem
+// 'slots' covering the visible rows plus a margin, recycle them as the list
+// scrolls, and ask the application for the data of newly-exposed items by
+// putting a WINDOW_EVENT_LIST_FETCH event into the list's event stream.
 
 #include "kernelWindow.h"	// Our prototypes are here
+#include "kernelCpu.h"
 #include "kernelDebug.h"
 #include "kernelError.h"
+#include "kernelFont.h"
 #include "kernelMalloc.h"
 #include "kernelWindowEventStream.h"
+#include <stdlib.h>
 #include <string.h>
 
+// Number of extra rows of items kept above and below the visible ones in a
+// virtual list
+#define VIRTUAL_MARGIN_ROWS		2
+
+// States of virtual list slots
+#define SLOT_EMPTY				0
+#define SLOT_REQUESTED			1
+#define SLOT_LOADED				2
+
+// If the application hasn't supplied the data for a requested slot after
+// this many milliseconds, ask again
+#define SLOT_REQUEST_TIMEOUT	1000
+
 extern kernelWindowVariables *windowVariables;
 
 
+static inline int itemNumber(kernelWindowList *list,
+	kernelWindowComponent *listItemComponent)
+{
+	// Items are always laid out in order, so we can get an item's number
+	// from its grid coordinates
+	return ((listItemComponent->params.gridY * max(1, list->columns)) +
+		listItemComponent->params.gridX);
+}
+
+
+static kernelWindowComponent *itemComponent(kernelWindowList *list,
+	int item)
+{
+	// Returns the list item component for the item number, if there is one
+
+	kernelWindowContainer *container = list->container->data;
+	kernelWindowListSlot *slot = NULL;
+
+	if ((item < 0) || (item >= list->numItems))
+		return (NULL);
+
+	if (list->virtual)
+	{
+		if (!list->numSlots)
+			return (NULL);
+
+		slot = &list->slots[item % list->numSlots];
+
+		if ((slot->item == item) && (slot->state == SLOT_LOADED))
+			return (slot->component);
+		else
+			return (NULL);
+	}
+
+	if (item < container->numComponents)
+		return (container->components[item]);
+	else
+		return (NULL);
+}
+
+
+static void virtualFreeSlots(kernelWindowList *list)
+{
+	// Destroy the pool of recycled list item components
+
+	int count;
+
+	if (list->slots)
+	{
+		for (count = 0; count < list->numSlots; count ++)
+		{
+			if (list->slots[count].component)
+				kernelWindowComponentDestroy(list->slots[count].component);
+		}
+
+		kernelFree(list->slots);
+		list->slots = NULL;
+	}
+
+	list->numSlots = 0;
+}
+
+
+static int virtualSetSlots(kernelWindowList *list)
+{
+	// (Re-)create the pool of slots, enough for the visible rows plus a
+	// margin above and below.  The list item components themselves are
+	// created when the first data for each slot arrives.
+
+	int numSlots = 0;
+	int count;
+
+	numSlots = ((list->rows + (VIRTUAL_MARGIN_ROWS * 2)) *
+		max(1, list->columns));
+
+	if (numSlots == list->numSlots)
+		return (0);
+
+	kernelDebug(debug_gui, "WindowList virtual slots %d", numSlots);
+
+	virtualFreeSlots(list);
+
+	list->slots = kernelMalloc(numSlots * sizeof(kernelWindowListSlot));
+	if (!list->slots)
+		return (ERR_MEMORY);
+
+	for (count = 0; count < numSlots; count ++)
+		list->slots[count].item = -1;
+
+	list->numSlots = numSlots;
+
+	return (0);
+}
+
+
+static void virtualBindSlots(kernelWindowComponent *component)
+{
+	// Bind the items around the visible rows to slots.  Item N always goes in
+	// slot (N % numSlots), so items that stay in range as the list scrolls
+	// keep their slots, and only the newly-exposed ones get recycled.  Then
+	// ask the application for the data of any items we don't have.
+
+	kernelWindowList *list = component->data;
+	kernelWindowListSlot *slot = NULL;
+	unsigned currentTime = 0;
+	int firstItem = 0, lastItem = 0;
+	int fetchFirst = -1, fetchLast = -1;
+	windowEvent event;
+	int count;
+
+	if (!list->numSlots)
+		return;
+
+	currentTime = (unsigned) kernelCpuGetMs();
+
+	firstItem = (max(0, (list->firstVisibleRow - VIRTUAL_MARGIN_ROWS)) *
+		max(1, list->columns));
+	lastItem = min(list->numItems, (firstItem + list->numSlots));
+
+	for (count = firstItem; count < lastItem; count ++)
+	{
+		slot = &list->slots[count % list->numSlots];
+
+		if (slot->item != count)
+		{
+			slot->item = count;
+			slot->state = SLOT_EMPTY;
+
+			if (slot->component && (slot->component->flags &
+				WINDOW_COMP_FLAG_VISIBLE))
+			{
+				kernelWindowComponentSetVisible(slot->component, 0);
+			}
+		}
+
+		// If the request for the data got lost, or the application only
+		// gave us some of it, request it again
+		if ((slot->state == SLOT_REQUESTED) && ((currentTime -
+			slot->requestTime) >= SLOT_REQUEST_TIMEOUT))
+		{
+			slot->state = SLOT_EMPTY;
+		}
+
+		if (slot->state == SLOT_EMPTY)
+		{
+			slot->state = SLOT_REQUESTED;
+			slot->requestTime = currentTime;
+
+			if (fetchFirst < 0)
+				fetchFirst = count;
+			fetchLast = count;
+		}
+	}
+
+	if (fetchFirst >= 0)
+	{
+		kernelDebug(debug_gui, "WindowList fetch items %d-%d", fetchFirst,
+			fetchLast);
+
+		memset(&event, 0, sizeof(windowEvent));
+		event.type = WINDOW_EVENT_LIST_FETCH;
+		event.coord.x = fetchFirst;
+		event.coord.y = ((fetchLast - fetchFirst) + 1);
+
+		kernelWindowEventStreamWrite(&component->events, &event);
+	}
+}
+
+
 static void setVisibleItems(kernelWindowComponent *component)
 {
 	// Set the visible/not visible attributes of the components based on the
@@ -45,11 +236,39 @@ static void setVisibleItems(kernelWindowComponent *component)
 
 	kernelDebug(debug_gui, "WindowList set visible items");
 
+	if (list->virtual)
+	{
+		virtualBindSlots(component);
+
+		// Set the grid coordinates of the slots from their item numbers
+		for (count = 0; count < list->numSlots; count ++)
+		{
+			listItemComponent = list->slots[count].component;
+			if (!listItemComponent)
+				continue;
+
+			if ((list->slots[count].state == SLOT_LOADED) &&
+				(list->slots[count].item < list->numItems))
+			{
+				listItemComponent->params.gridX =
+					(list->slots[count].item % max(1, list->columns));
+				listItemComponent->params.gridY =
+					(list->slots[count].item / max(1, list->columns));
+			}
+			else
+			{
+				// Nothing to show here (yet)
+				listItemComponent->params.gridY = -1;
+			}
+		}
+	}
+
 	for (count = 0; count < container->numComponents; count ++)
 	{
 		listItemComponent = container->components[count];
 
-		if ((listItemComponent->params.gridY >= list->firstVisibleRow) &&
+		if ((listItemComponent->params.gridY >= 0) &&
+			(listItemComponent->params.gridY >= list->firstVisibleRow) &&
 			(listItemComponent->params.gridY <
 				(list->rows + list->firstVisibleRow)))
 		{
@@ -246,6 +465,11 @@ static void setRowsAndColumns(kernelWindowComponent *component)
 
 	kernelDebug(debug_gui, "WindowList rows %d, columns %d", list->rows,
 		list->columns);
+
+	// A virtual list needs enough slots for the new number of rows and
+	// columns
+	if (list->virtual)
+		virtualSetSlots(list);
 }
 
 
@@ -254,30 +478,23 @@ static void selectionScroll(kernelWindowComponent *component)
 	// Looks at the currently selected item and scrolls
 
 	kernelWindowList *list = component->data;
-	kernelWindowContainer *container = list->container->data;
-	kernelWindowComponent *listItemComponent = NULL;
+	int gridY = 0;
 
 	//kernelDebug(debug_gui, "WindowList check scroll");
 
 	if (list->selectedItem == -1)
 		return;
 
-	listItemComponent = container->components[list->selectedItem];
+	gridY = (list->selectedItem / max(1, list->columns));
 
 	// Do we have to scroll the list?
-	if ((listItemComponent->params.gridY < list->firstVisibleRow) ||
-		(listItemComponent->params.gridY >=
-	 		(list->firstVisibleRow + list->rows)))
+	if ((gridY < list->firstVisibleRow) ||
+		(gridY >= (list->firstVisibleRow + list->rows)))
 	{
-		if (listItemComponent->params.gridY < list->firstVisibleRow)
-		{
-			list->firstVisibleRow = listItemComponent->params.gridY;
-		}
+		if (gridY < list->firstVisibleRow)
+			list->firstVisibleRow = gridY;
 		else
-		{
-			list->firstVisibleRow = ((listItemComponent->params.gridY -
-				list->rows) + 1);
-		}
+			list->firstVisibleRow = ((gridY - list->rows) + 1);
 
 		if (list->scrollBar)
 			// Set the scroll bar display percent
@@ -298,13 +515,12 @@ static int setSelected(kernelWindowComponent *component, int item)
 
 	int status = 0;
 	kernelWindowList *list = component->data;
-	kernelWindowContainer *container = list->container->data;
 	kernelWindowComponent *listItemComponent = NULL;
 	int oldItem = 0;
 
 	kernelDebug(debug_gui, "WindowList set selected %d", item);
 
-	if ((item < -1) || (item >= container->numComponents))
+	if ((item < -1) || (item >= list->numItems))
 	{
 		kernelError(kernel_error, "Illegal component number %d", item);
 		return (status = ERR_BOUNDS);
@@ -315,8 +531,9 @@ static int setSelected(kernelWindowComponent *component, int item)
 	if ((oldItem != item) && (oldItem != -1))
 	{
 		// Deselect the old selected item
-		listItemComponent = container->components[oldItem];
-		listItemComponent->setSelected(listItemComponent, 0);
+		listItemComponent = itemComponent(list, oldItem);
+		if (listItemComponent)
+			listItemComponent->setSelected(listItemComponent, 0);
 	}
 
 	list->selectedItem = item;
@@ -327,8 +544,9 @@ static int setSelected(kernelWindowComponent *component, int item)
 	if ((oldItem != item) && (item != -1))
 	{
 		// Select the selected item
-		listItemComponent = container->components[item];
-		listItemComponent->setSelected(listItemComponent, 1);
+		listItemComponent = itemComponent(list, item);
+		if (listItemComponent)
+			listItemComponent->setSelected(listItemComponent, 1);
 	}
 
 	return (status = 0);
@@ -381,7 +599,6 @@ static int layout(kernelWindowComponent *component)
 	// Loop through the list items in the container and put them into a grid
 
 	kernelWindowList *list = component->data;
-	kernelWindowContainer *container = list->container->data;
 	int scrollBarX = 0;
 
 	kernelDebug(debug_gui, "WindowList layout");
@@ -406,12 +623,15 @@ static int layout(kernelWindowComponent *component)
 	// items (not just visible ones)
 	if (list->columns)
 	{
-		list->itemRows = (container->numComponents / list->columns);
-		if (container->numComponents % list->columns)
+		list->itemRows = (list->numItems / list->columns);
+		if (list->numItems % list->columns)
 			list->itemRows += 1;
 	}
 
-	setItemGrid(component);
+	// Virtual lists set the grid coordinates of their slots as they're bound
+	if (!list->virtual)
+		setItemGrid(component);
+
 	setVisibleItems(component);
 
 	if (list->scrollBar)
@@ -456,12 +676,13 @@ static kernelWindowComponent *activeComp(kernelWindowComponent *component)
 	// Return the selected list item component, if applicable
 
 	kernelWindowList *list = component->data;
-	kernelWindowContainer *container = list->container->data;
+	kernelWindowComponent *listItemComponent = NULL;
 
 	kernelDebug(debug_gui, "WindowList get active component");
 
-	if (list->selectedItem >= 0)
-		return (container->components[list->selectedItem]);
+	listItemComponent = itemComponent(list, list->selectedItem);
+	if (listItemComponent)
+		return (listItemComponent);
 	else
 		return (component);
 }
@@ -519,7 +740,7 @@ static kernelWindowComponent *eventComp(kernelWindowComponent *component,
 				return (component);
 			}
 
-			setSelected(component, count);
+			setSelected(component, itemNumber(list, listItemComponent));
 
 			// Make a copy of this event, make it also a 'selection' event,
 			// and put it into the windowList's event stream
@@ -591,6 +812,10 @@ static int draw(kernelWindowComponent *component)
 	//kernelDebug(debug_gui, "WindowList Draw width %d, height %d",
 	//	component->width, component->height);
 
+	// Re-request any virtual items whose data never arrived
+	if (list->virtual)
+		virtualBindSlots(component);
+
 	drawVisibleItems(component);
 
 	// Draw any scrollbars
@@ -711,6 +936,8 @@ static void populateList(kernelWindowComponent *listComponent,
 		}
 	}
 
+	list->numItems = container->numComponents;
+
 	// Set the sizes of all the items
 	setItemSizes(list);
 
@@ -743,6 +970,8 @@ static void appendList(kernelWindowComponent *listComponent,
 	if (!listItemComponent)
 		return;
 
+	list->numItems += 1;
+
 	// Set the sizes of all the items
 	setItemSizes(list);
 
@@ -761,6 +990,72 @@ static void appendList(kernelWindowComponent *listComponent,
 }
 
 
+static int virtualLoadSlot(kernelWindowComponent *component,
+	kernelWindowListSlot *slot, listItemParameters *item)
+{
+	// Put the application's data for an item into its slot, creating the
+	// slot's list item component if necessary.
+
+	int status = 0;
+	kernelWindowList *list = component->data;
+	kernelWindowComponent *listItemComponent = slot->component;
+
+	if (!listItemComponent)
+	{
+		listItemComponent = addComponent(component, item);
+		if (!listItemComponent)
+			return (status = ERR_NOCREATE);
+
+		kernelWindowComponentSetVisible(listItemComponent, 0);
+
+		slot->component = listItemComponent;
+	}
+	else
+	{
+		if (listItemComponent->flags & WINDOW_COMP_FLAG_VISIBLE)
+			kernelWindowComponentSetVisible(listItemComponent, 0);
+
+		status = listItemComponent->setData(listItemComponent, item,
+			sizeof(listItemParameters));
+		if (status < 0)
+			return (status);
+
+		if (listItemComponent->width > list->itemWidth)
+			list->itemWidth = listItemComponent->width;
+
+		if (listItemComponent->height > list->itemHeight)
+			list->itemHeight = listItemComponent->height;
+
+		// Back to the uniform size, and make sure any new icon gets
+		// positioned
+		if (listItemComponent->resize)
+		{
+			listItemComponent->resize(listItemComponent, list->itemWidth,
+				list->itemHeight);
+		}
+
+		listItemComponent->width = list->itemWidth;
+		listItemComponent->height = list->itemHeight;
+
+		if (listItemComponent->move)
+		{
+			listItemComponent->move(listItemComponent,
+				listItemComponent->xCoord, listItemComponent->yCoord);
+		}
+	}
+
+	if (listItemComponent->setSelected)
+	{
+		listItemComponent->setSelected(listItemComponent,
+			(slot->item == list->selectedItem));
+	}
+
+	slot->state = SLOT_LOADED;
+
+	return (status = 0);
+}
+
+
 static int getData(kernelWindowComponent *component, void *buffer, int size)
 {
 	// Return the object keys of the list components
@@ -784,8 +1079,14 @@ static int setData(kernelWindowComponent *component, void *buffer, int size)
 {
 	// Resets the subcomponents
 
+	kernelWindowList *list = component->data;
+
 	kernelDebug(debug_gui, "WindowList set data");
 
+	// For a virtual list, this is data for the first items
+	if (list->virtual)
+		return (kernelWindowListSetItems(component, 0, buffer, size));
+
 	// Re-populate the list
 	populateList(component, buffer, size);
 
@@ -805,8 +1106,22 @@ static int appendData(kernelWindowComponent *component, void *buffer,
 {
 	// Adds a new subcomponent
 
+	int status = 0;
+	kernelWindowList *list = component->data;
+
 	kernelDebug(debug_gui, "WindowList append data");
 
+	// For a virtual list, add an item and supply its data
+	if (list->virtual)
+	{
+		status = kernelWindowListSetNumItems(component, (list->numItems + 1));
+		if (status < 0)
+			return (status);
+
+		return (kernelWindowListSetItems(component, (list->numItems - 1),
+			buffer, 1));
+	}
+
 	// Add to the list
 	appendList(component, buffer);
 
@@ -922,7 +1237,7 @@ static int mouseEvent(kernelWindowComponent *component, windowEvent *event)
 
 		// Now, adjust the visible subcomponents based on the 'position
 		// percent' of the scroll bar
-		if (container->numComponents > list->rows)
+		if (list->numItems > list->rows)
 		{
 			firstVisibleRow = (((list->itemRows - list->rows) *
 				scrollBar->state.positionPercent) / 100);
@@ -953,7 +1268,7 @@ static int mouseEvent(kernelWindowComponent *component, windowEvent *event)
 					makeComponentScreenArea(listItemComponent)))
 			{
 				// Don't bother passing the mouse event to the list item
-				setSelected(component, count);
+				setSelected(component, itemNumber(list, listItemComponent));
 
 				// Make this also a 'selection' event
 				event->type |= WINDOW_EVENT_SELECTION;
@@ -974,24 +1289,23 @@ static int keyEvent(kernelWindowComponent *component, windowEvent *event)
 
 	int status = 0;
 	kernelWindowList *list = component->data;
-	kernelWindowContainer *container = list->container->data;
-	kernelWindowComponent *listItemComponent = NULL;
+	int columns = max(1, list->columns);
+	int oldGridX = 0, oldGridY = 0;
 	int gridX = 0, gridY = 0;
-	int count;
+	int item = 0;
 
 	kernelDebug(debug_gui, "WindowList key event");
 
 	if (event->type == WINDOW_EVENT_KEY_DOWN)
 	{
-		if (!container->numComponents)
+		if (!list->numItems)
 			return (status = 0);
 
 		if (list->selectedItem >= 0)
 		{
-			// Get the currently selected item
-			listItemComponent = container->components[list->selectedItem];
-			gridX = listItemComponent->params.gridX;
-			gridY = listItemComponent->params.gridY;
+			// Get the grid coordinates of the currently selected item
+			gridX = oldGridX = (list->selectedItem % columns);
+			gridY = oldGridY = (list->selectedItem / columns);
 
 			switch (event->key.scan)
 			{
@@ -1042,23 +1356,17 @@ static int keyEvent(kernelWindowComponent *component, windowEvent *event)
 					break;
 			}
 
-			if ((gridX != listItemComponent->params.gridX) ||
-				(gridY != listItemComponent->params.gridY))
+			if ((gridX != oldGridX) || (gridY != oldGridY))
 			{
-				// Find an item with these coordinates
-				for (count = 0; count < container->numComponents; count ++)
+				// Is there an item with these coordinates?
+				item = ((gridY * columns) + gridX);
+				if (item < list->numItems)
 				{
-					if ((container->components[count]->params.gridX ==
-							gridX) &&
-						(container->components[count]->params.gridY == gridY))
-					{
-						// Don't bother passing the key event to the list item
-						setSelected(component, count);
+					// Don't bother passing the key event to the list item
+					setSelected(component, item);
 
-						// Make this also a 'selection' event
-						event->type |= WINDOW_EVENT_SELECTION;
-						break;
-					}
+					// Make this also a 'selection' event
+					event->type |= WINDOW_EVENT_SELECTION;
 				}
 			}
 		}
@@ -1085,6 +1393,10 @@ static int destroy(kernelWindowComponent *component)
 	// Release all our memory
 	if (list)
 	{
+		// The slots' components belong to the container
+		if (list->slots)
+			kernelFree(list->slots);
+
 		if (list->container)
 			kernelWindowComponentDestroy(list->container);
 
@@ -1099,37 +1411,15 @@ static int destroy(kernelWindowComponent *component)
 }
 
 
-/////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////
-//
-// Below here, the functions are exported for external use
-//
-/////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////
-
-kernelWindowComponent *kernelWindowNewList(objectKey parent,
-	windowListType type, int rows, int columns, int selectMultiple,
-	listItemParameters *items, int numItems, componentParameters *params)
+static kernelWindowComponent *newList(objectKey parent, windowListType type,
+	int rows, int columns, int selectMultiple, componentParameters *params)
 {
-	// Formats a kernelWindowComponent as a kernelWindowList
+	// Formats a kernelWindowComponent as an empty kernelWindowList
 
 	kernelWindowComponent *component = NULL;
 	kernelWindowList *list = NULL;
-	kernelWindowContainer *container = NULL;
-	kernelWindowListItem *listItem = NULL;
 	componentParameters subParams;
 
-	// Check params
-	if (!parent || !items || !params)
-	{
-		kernelError(kernel_error, "NULL parameter");
-		return (component = NULL);
-	}
-
-	kernelDebug(debug_gui, "WindowList new list rows %d, columns %d, "
-		"selectMultiple %d, numItems %d", rows, columns, selectMultiple,
-		numItems);
-
 	// Get the basic component structure
 	component = kernelWindowComponentNew(parent, params);
 	if (!component)
@@ -1201,8 +1491,6 @@ kernelWindowComponent *kernelWindowNewList(objectKey parent,
 	// Remove it from the parent container
 	kernelWindowContainerDelete(list->container->container, list->container);
 
-	container = list->container->data;
-
 	// Standard parameters for a scroll bar
 	memcpy(&subParams, params, sizeof(componentParameters));
 	subParams.flags &= ~(COMP_PARAMS_FLAG_CUSTOMFOREGROUND |
@@ -1224,6 +1512,47 @@ kernelWindowComponent *kernelWindowNewList(objectKey parent,
 			list->scrollBar);
 	}
 
+	return (component);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+// Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+kernelWindowComponent *kernelWindowNewList(objectKey parent,
+	windowListType type, int rows, int columns, int selectMultiple,
+	listItemParameters *items, int numItems, componentParameters *params)
+{
+	// Formats a kernelWindowComponent as a kernelWindowList
+
+	kernelWindowComponent *component = NULL;
+	kernelWindowList *list = NULL;
+	kernelWindowContainer *container = NULL;
+	kernelWindowListItem *listItem = NULL;
+
+	// Check params
+	if (!parent || !items || !params)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (component = NULL);
+	}
+
+	kernelDebug(debug_gui, "WindowList new list rows %d, columns %d, "
+		"selectMultiple %d, numItems %d", rows, columns, selectMultiple,
+		numItems);
+
+	component = newList(parent, type, rows, columns, selectMultiple, params);
+	if (!component)
+		return (component);
+
+	list = component->data;
+	container = list->container->data;
+
 	// Fill up
 	populateList(component, items, numItems);
 
@@ -1259,3 +1588,325 @@ kernelWindowComponent *kernelWindowNewList(objectKey parent,
 	return (component);
 }
 
+
+kernelWindowComponent *kernelWindowNewVirtualList(objectKey parent,
+	windowListType type, int rows, int columns, int selectMultiple,
+	int numItems, componentParameters *params)
+{
+	// Formats a kernelWindowComponent as a virtual kernelWindowList, which
+	// only has list item components for the items around the visible rows.
+	// The application supplies the data for items with
+	// kernelWindowListSetItems() when it receives WINDOW_EVENT_LIST_FETCH
+	// events, whose coord.x and coord.y fields are the first item and the
+	// number of items wanted.
+
+	kernelWindowComponent *component = NULL;
+	kernelWindowList *list = NULL;
+
+	// Check params
+	if (!parent || !params)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (component = NULL);
+	}
+
+	if ((rows < 1) || (columns < 1) || (numItems < 0))
+	{
+		kernelError(kernel_error, "Invalid rows (%d), columns (%d), or number "
+			"of items (%d)", rows, columns, numItems);
+		return (component = NULL);
+	}
+
+	kernelDebug(debug_gui, "WindowList new virtual list rows %d, columns %d, "
+		"selectMultiple %d, numItems %d", rows, columns, selectMultiple,
+		numItems);
+
+	component = newList(parent, type, rows, columns, selectMultiple, params);
+	if (!component)
+		return (component);
+
+	list = component->data;
+
+	list->virtual = 1;
+	list->numItems = numItems;
+
+	// We don't know the item sizes until some data arrives, so start with
+	// something reasonable.  The items grow the list as they do for a
+	// non-virtual list.
+	list->itemWidth = 64;
+	list->itemHeight = 64;
+	if (type == windowlist_textonly)
+		list->itemHeight = (((kernelFont *) component->params.font)->
+			glyphHeight + 2);
+
+	component->minWidth = list->itemWidth;
+	component->minHeight = list->itemHeight;
+
+	// Take care of any default selection
+	if (selectMultiple || !numItems)
+		list->selectedItem = -1;
+	else
+		// Multiple selections are not allowed, so we select the first one
+		list->selectedItem = 0;
+
+	if (virtualSetSlots(list) < 0)
+	{
+		kernelWindowComponentDestroy(component);
+		return (component = NULL);
+	}
+
+	// Request the data for the first items.  We don't do layout yet, so that
+	// if the application supplies the first items straight away, the list
+	// gets sized to fit them.
+	virtualBindSlots(component);
+
+	return (component);
+}
+
+
+int kernelWindowListSetNumItems(kernelWindowComponent *component,
+	int numItems)
+{
+	// Change the number of items in a virtual list.  Any data we have for
+	// items is discarded, and the application will be asked for it again.
+
+	int status = 0;
+	kernelWindowList *list = NULL;
+	int count;
+
+	// Check params
+	if (!component)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (component->type != listComponentType)
+	{
+		kernelError(kernel_error, "Component is not a list");
+		return (status = ERR_INVALID);
+	}
+
+	list = component->data;
+
+	if (!list->virtual)
+	{
+		kernelError(kernel_error, "List is not virtual");
+		return (status = ERR_INVALID);
+	}
+
+	if (numItems < 0)
+	{
+		kernelError(kernel_error, "Illegal number of items %d", numItems);
+		return (status = ERR_RANGE);
+	}
+
+	kernelDebug(debug_gui, "WindowList set number of items %d", numItems);
+
+	// Forget what's in all the slots
+	for (count = 0; count < list->numSlots; count ++)
+	{
+		list->slots[count].item = -1;
+		list->slots[count].state = SLOT_EMPTY;
+
+		if (list->slots[count].component && (list->slots[count].component->
+			flags & WINDOW_COMP_FLAG_VISIBLE))
+		{
+			kernelWindowComponentSetVisible(list->slots[count].component, 0);
+		}
+	}
+
+	list->numItems = numItems;
+
+	// If the selected item is greater than the new number we have, make it
+	// the last one
+	if (list->selectedItem >= numItems)
+		list->selectedItem = (numItems - 1);
+	else if (!list->selectMultiple && (list->selectedItem < 0) && numItems)
+		list->selectedItem = 0;
+
+	// Don't leave the list scrolled past the end
+	list->itemRows = ((numItems + (max(1, list->columns) - 1)) /
+		max(1, list->columns));
+	list->firstVisibleRow = max(0, min(list->firstVisibleRow,
+		(list->itemRows - list->rows)));
+
+	layout(component);
+	setScrollBar(list);
+
+	if (component->draw)
+		component->draw(component);
+
+	component->window->update(component->window, component->xCoord,
+		component->yCoord, component->width, component->height);
+
+	return (status = 0);
+}
+
+
+int kernelWindowListSetItems(kernelWindowComponent *component, int firstItem,
+	listItemParameters *items, int numItems)
+{
+	// Set the data for a range of items in the list.  For a virtual list,
+	// data for items that have since scrolled out of range is ignored.
+
+	int status = 0;
+	kernelWindowList *list = NULL;
+	kernelWindowListSlot *slot = NULL;
+	kernelWindowComponent *listItemComponent = NULL;
+	int oldWidth = 0, oldHeight = 0;
+	int item = 0;
+	int count;
+
+	// Check params
+	if (!component || !items)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (component->type != listComponentType)
+	{
+		kernelError(kernel_error, "Component is not a list");
+		return (status = ERR_INVALID);
+	}
+
+	list = component->data;
+
+	kernelDebug(debug_gui, "WindowList set items %d-%d", firstItem,
+		((firstItem + numItems) - 1));
+
+	oldWidth = list->itemWidth;
+	oldHeight = list->itemHeight;
+
+	for (count = 0; count < numItems; count ++)
+	{
+		item = (firstItem + count);
+		if ((item < 0) || (item >= list->numItems))
+			continue;
+
+		if (list->virtual)
+		{
+			if (!list->numSlots)
+				break;
+
+			slot = &list->slots[item % list->numSlots];
+			if (slot->item != item)
+				// Not in range any more
+				continue;
+
+			status = virtualLoadSlot(component, slot, &items[count]);
+			if (status < 0)
+				return (status);
+		}
+		else
+		{
+			listItemComponent = itemComponent(list, item);
+			if (!listItemComponent || !listItemComponent->setData)
+				continue;
+
+			listItemComponent->setData(listItemComponent, &items[count],
+				sizeof(listItemParameters));
+
+			if (listItemComponent->width > list->itemWidth)
+				list->itemWidth = listItemComponent->width;
+
+			if (listItemComponent->height > list->itemHeight)
+				list->itemHeight = listItemComponent->height;
+
+			if (listItemComponent->move)
+			{
+				listItemComponent->move(listItemComponent,
+					listItemComponent->xCoord, listItemComponent->yCoord);
+			}
+		}
+	}
+
+	// Set the sizes of all the items
+	setItemSizes(list);
+
+	if ((list->itemWidth != oldWidth) || (list->itemHeight != oldHeight))
+	{
+		if (component->doneLayout)
+		{
+			// The items got bigger, so re-calculate the number of rows and
+			// columns
+			setRowsAndColumns(component);
+		}
+		else
+		{
+			component->minWidth = list->itemWidth;
+			component->minHeight = list->itemHeight;
+		}
+	}
+
+	// Do layout
+	layout(component);
+
+	// Update the scroll bar position percent
+	setScrollBar(list);
+
+	if (component->draw)
+		component->draw(component);
+
+	component->window->update(component->window, component->xCoord,
+		component->yCoord, component->width, component->height);
+
+	return (status = 0);
+}
+
+
+int kernelWindowListScrollTo(kernelWindowComponent *component, int item)
+{
+	// Scroll the list so that the item is visible.  This is just arithmetic
+	// on the item number, so it's fast even for huge virtual lists.
+
+	int status = 0;
+	kernelWindowList *list = NULL;
+	int gridY = 0;
+
+	// Check params
+	if (!component)
+	{
+		kernelError(kernel_error, "NULL parameter");
+		return (status = ERR_NULLPARAMETER);
+	}
+
+	if (component->type != listComponentType)
+	{
+		kernelError(kernel_error, "Component is not a list");
+		return (status = ERR_INVALID);
+	}
+
+	list = component->data;
+
+	if ((item < 0) || (item >= list->numItems))
+	{
+		kernelError(kernel_error, "Illegal item number %d", item);
+		return (status = ERR_BOUNDS);
+	}
+
+	kernelDebug(debug_gui, "WindowList scroll to %d", item);
+
+	gridY = (item / max(1, list->columns));
+
+	if ((gridY >= list->firstVisibleRow) &&
+		(gridY < (list->firstVisibleRow + list->rows)))
+	{
+		// Already visible
+		return (status = 0);
+	}
+
+	// Put the item's row at the top, if we can
+	list->firstVisibleRow = max(0, min(gridY, (list->itemRows - list->rows)));
+
+	setScrollBar(list);
+	setVisibleItems(component);
+	drawVisibleItems(component);
+
+	component->window->update(component->window, component->xCoord,
+		component->yCoord, component->width, component->height);
+
+	return (status = 0);
+}
+
@@ -19,7 +19,9 @@
 //  kernelWindowTree.c
 //
 
-// This code is for managing kernelWindowTree objects.
+// This code is for managing kernelWindowTree objects.  Only the visible rows
+// of the tree have kernelWindowListItem components; these are recycled as the
+// tree is scrolled, expanded, and collapsed.
 
 #include "kernelWindow.h"	// Our prototypes are here
 #include "kernelDebug.h"
@@ -80,42 +82,56 @@ static void copyItemsRecursive(kernelWindowTree *tree,
 }
 
 
-static int createListItemsRecursive(kernelWindowComponent *component,
-	windowTreeItem *item)
+static int itemHeight(kernelWindowComponent *component)
 {
-	int status = 0;
+	// Returns the height of the rows
+
 	kernelWindowTree *tree = component->data;
-	listItemParameters itemParams;
+	kernelWindowContainer *container = tree->container->data;
 
-	if (!item)
-		return (0);
+	if (container->numComponents)
+		return (container->components[0]->height);
+	else
+		return (((kernelFont *) component->params.font)->glyphHeight + 2);
+}
 
-	kernelDebug(debug_gui, "WindowTree create list item for \"%s\"",
-		item->text);
 
-	memset(&itemParams, 0, sizeof(listItemParameters));
-	memcpy(itemParams.text, item->text, WINDOW_MAX_LABEL_LENGTH);
+static kernelWindowComponent *rowComponent(kernelWindowComponent *component,
+	int row)
+{
+	// Get the list item component for a visible row, creating it if this is
+	// the first time we've needed this many rows
 
-	item->key = kernelWindowNewListItem(tree->container, windowlist_textonly,
-		&itemParams, (componentParameters *) &component->params);
-	if (!item->key)
-		return (status = ERR_NOCREATE);
+	kernelWindowTree *tree = component->data;
+	kernelWindowContainer *container = tree->container->data;
+	kernelWindowComponent *itemComponent = NULL;
+	listItemParameters itemParams;
+	int *rowItems = NULL;
 
-	if (item->firstChild)
-	{
-		status = createListItemsRecursive(component, item->firstChild);
-		if (status < 0)
-			return (status);
-	}
+	if (row < container->numComponents)
+		return (container->components[row]);
 
-	if (item->next)
+	kernelDebug(debug_gui, "WindowTree create list item for row %d", row);
+
+	rowItems = kernelMalloc((row + 1) * sizeof(int));
+	if (!rowItems)
+		return (itemComponent = NULL);
+
+	if (tree->rowItems)
 	{
-		status = createListItemsRecursive(component, item->next);
-		if (status < 0)
-			return (status);
+		memcpy(rowItems, tree->rowItems, (row * sizeof(int)));
+		kernelFree(tree->rowItems);
 	}
 
-	return (status = 0);
+	tree->rowItems = rowItems;
+
+	memset(&itemParams, 0, sizeof(listItemParameters));
+
+	itemComponent = kernelWindowNewListItem(tree->container,
+		windowlist_textonly, &itemParams, (componentParameters *)
+		&component->params);
+
+	return (itemComponent);
 }
 
 
@@ -124,30 +140,32 @@ static void layoutItemsRecursive(kernelWindowComponent *component,
 {
 	kernelWindowTree *tree = component->data;
 	kernelWindowComponent *itemComponent = NULL;
+	int height = itemHeight(component);
 	int xCoord = 0, yCoord = 0;
 
 	if (!item)
 		return;
 
-	itemComponent = item->key;
-
 	// Calculate the X and Y coordinates for the list item
 	xCoord = (tree->container->xCoord + (level * INDENT) + INDENT);
-	yCoord = (tree->container->yCoord + (int)(itemComponent->height *
+	yCoord = (tree->container->yCoord + (int)(height *
 		(tree->expandedItems - tree->scrolledLines)));
 
 	// Remember what row it's in
-	itemComponent->params.gridY = tree->expandedItems;
+	tree->itemRows[item - tree->items] = tree->expandedItems;
 
 	tree->expandedItems += 1;
 
 	// Determine whether the item is currently visible, or scrolled out of
 	// the container area
 	if ((yCoord >= tree->container->yCoord) &&
-		((yCoord + itemComponent->height) <=
-			(tree->container->yCoord + tree->container->height)))
+		((yCoord + height) <=
+			(tree->container->yCoord + tree->container->height)) &&
+		(itemComponent = rowComponent(component, tree->visibleItems)))
 	{
-		// This one is visible
+		// This one is visible, so it gets the next row's list item
+		tree->rowItems[tree->visibleItems] = (item - tree->items);
+		itemComponent->params.gridY = tree->itemRows[item - tree->items];
 
 		if ((xCoord != itemComponent->xCoord) ||
 			(yCoord != itemComponent->yCoord))
@@ -183,6 +201,12 @@ static void layoutItemsRecursive(kernelWindowComponent *component,
 		kernelWindowComponentSetData(itemComponent, item->displayText,
 			strlen(item->displayText), 0 /* no render */);
 
+		if (itemComponent->setSelected)
+		{
+			itemComponent->setSelected(itemComponent,
+				((item - tree->items) == tree->selectedItem));
+		}
+
 		if (!(itemComponent->flags & WINDOW_COMP_FLAG_VISIBLE))
 			kernelWindowComponentSetVisible(itemComponent, 1);
 
@@ -213,6 +237,10 @@ static void layoutItems(kernelWindowComponent *component)
 			kernelWindowComponentSetVisible(container->components[count], 0);
 	}
 
+	// Collapsed items don't have a row
+	for (count = 0; count < tree->numItems; count ++)
+		tree->itemRows[count] = -1;
+
 	tree->expandedItems = 0;
 	tree->visibleItems = 0;
 	layoutItemsRecursive(component, tree->items, 0 /* level */);
@@ -221,47 +249,83 @@ static void layoutItems(kernelWindowComponent *component)
 }
 
 
+static kernelWindowComponent *shownItem(kernelWindowTree *tree, int item)
+{
+	// Returns the list item component showing the item, if it's visible
+
+	kernelWindowContainer *container = tree->container->data;
+	int row = 0;
+
+	if ((item < 0) || (item >= tree->numItems))
+		return (NULL);
+
+	row = (tree->itemRows[item] - tree->scrolledLines);
+
+	if ((tree->itemRows[item] >= 0) && (row >= 0) &&
+		(row < tree->visibleItems) && (tree->rowItems[row] == item))
+	{
+		return (container->components[row]);
+	}
+
+	return (NULL);
+}
+
+
 static int populateTree(kernelWindowComponent *component,
 	windowTreeItem *rootItem)
 {
 	int status = 0;
 	kernelWindowTree *tree = component->data;
 	int numItems = 0;
-	int count;
 
 	numItems = countItemsRecursive(rootItem);
 
 	kernelDebug(debug_gui, "WindowTree populate tree (%d items)", numItems);
 
-	// Free old stuff
+	// Free old stuff.  The list item components for the rows are re-used.
 	if (tree->items)
 	{
-		for (count = 0; count < tree->numItems; count ++)
-		{
-			if (tree->items[count].key)
-				kernelWindowComponentDestroy(tree->items[count].key);
-		}
-
 		kernelFree(tree->items);
 		tree->items = NULL;
 	}
 
+	if (tree->itemRows)
+	{
+		kernelFree(tree->itemRows);
+		tree->itemRows = NULL;
+	}
+
 	tree->numItems = 0;
 
 	if (!rootItem)
+	{
+		layoutItems(component);
 		return (status = 0);
+	}
 
 	// Get kernel memory for the items
 	tree->items = kernelMalloc(numItems * sizeof(windowTreeItem));
-	if (!tree->items)
+	tree->itemRows = kernelMalloc(numItems * sizeof(int));
+	if (!tree->items || !tree->itemRows)
+	{
+		if (tree->items)
+		{
+			kernelFree(tree->items);
+			tree->items = NULL;
+		}
+
+		if (tree->itemRows)
+		{
+			kernelFree(tree->itemRows);
+			tree->itemRows = NULL;
+		}
+
+		layoutItems(component);
 		return (status = ERR_MEMORY);
+	}
 
 	copyItemsRecursive(tree, rootItem, NULL /* no link */);
 
-	status = createListItemsRecursive(component, tree->items);
-	if (status < 0)
-		return (status);
-
 	layoutItems(component);
 
 	return (status = 0);
@@ -411,12 +475,13 @@ static kernelWindowComponent *activeComp(kernelWindowComponent *component)
 	// Return the selected list item component, if applicable
 
 	kernelWindowTree *tree = component->data;
-	kernelWindowContainer *container = tree->container->data;
+	kernelWindowComponent *itemComponent = NULL;
 
 	kernelDebug(debug_gui, "WindowTree get active component");
 
-	if (tree->selectedItem >= 0)
-		return (container->components[tree->selectedItem]);
+	itemComponent = shownItem(tree, tree->selectedItem);
+	if (itemComponent)
+		return (itemComponent);
 	else
 		return (component);
 }
@@ -459,6 +524,7 @@ static int draw(kernelWindowComponent *component)
 
 	kernelWindowTree *tree = component->data;
 	kernelWindowContainer *container = tree->container->data;
+	windowTreeItem *item = NULL;
 	int width = 0, xCoord = 0, yCoord = 0;
 	int count;
 
@@ -474,11 +540,13 @@ static int draw(kernelWindowComponent *component)
 	{
 		if (container->components[count]->flags & WINDOW_COMP_FLAG_VISIBLE)
 		{
+			item = &tree->items[tree->rowItems[count]];
+
 			kernelDebug(debug_gui, "WindowTree item %d xCoord %d, yCoord %d",
-				count, container->components[count]->xCoord,
+				tree->rowItems[count], container->components[count]->xCoord,
 				container->components[count]->yCoord);
 
-			if (tree->items[count].firstChild)
+			if (item->firstChild)
 			{
 				// Draw an expansion box
 
@@ -496,7 +564,7 @@ static int draw(kernelWindowComponent *component)
 					(xCoord + 2), (yCoord + (width / 2)),
 					(xCoord + (width - 3)), (yCoord + (width / 2)));
 
-				if (!tree->items[count].expanded)
+				if (!item->expanded)
 				{
 					kernelGraphicDrawLine(component->buffer,
 						(color *) &component->params.foreground, draw_normal,
@@ -583,13 +651,9 @@ static int resize(kernelWindowComponent *component, int width, int height)
 		tree->container->height = height;
 
 		// Calculate a new number of rows we can display
-		if (tree->numItems)
-		{
-			tree->rows = (height /
-				((kernelWindowComponent *) tree->items[0].key)->height);
+		tree->rows = (height / itemHeight(component));
 
-			kernelDebug(debug_gui, "WindowTree rows now %d", tree->rows);
-		}
+		kernelDebug(debug_gui, "WindowTree rows now %d", tree->rows);
 
 		// Move/resize scroll bars too
 
@@ -626,21 +690,51 @@ static int setData(kernelWindowComponent *component, void *buffer,
 
 	int status = 0;
 	kernelWindowTree *tree = component->data;
+	int oldSelected = tree->selectedItem;
+	windowTreeItem oldItem;
+	kernelWindowComponent *itemComponent = NULL;
+	int count;
+
+	// Remember the selected item, so that we can select it again if it's
+	// still there in the new contents
+	memset(&oldItem, 0, sizeof(windowTreeItem));
+	if (oldSelected >= 0)
+	{
+		memcpy(&oldItem, &tree->items[tree->selectedItem],
+			sizeof(windowTreeItem));
+	}
+
+	// Nothing is selected now
+	tree->selectedItem = -1;
 
 	status = populateTree(component, buffer);
 
 	// Calculate a new number of rows we can display
-	if (!tree->rows && tree->numItems)
+	if (!tree->rows)
 	{
-		tree->rows = (tree->container->height /
-			((kernelWindowComponent *) tree->items[0].key)->height);
+		tree->rows = (tree->container->height / itemHeight(component));
 		kernelDebug(debug_gui, "WindowTree rows now %d", tree->rows);
 	}
 
 	setScrollBar(tree);
 
-	// Nothing is selected now
-	tree->selectedItem = -1;
+	if (oldSelected >= 0)
+	{
+		for (count = 0; count < tree->numItems; count ++)
+		{
+			if ((tree->items[count].key == oldItem.key) &&
+				!strcmp(tree->items[count].text, oldItem.text))
+			{
+				tree->selectedItem = count;
+
+				itemComponent = shownItem(tree, count);
+				if (itemComponent)
+					itemComponent->setSelected(itemComponent, 1);
+
+				break;
+			}
+		}
+	}
 
 	if (component->draw)
 		component->draw(component);
@@ -666,13 +760,12 @@ static int setSelected(kernelWindowComponent *component, int item)
 
 	int status = 0;
 	kernelWindowTree *tree = component->data;
-	kernelWindowContainer *container = tree->container->data;
 	kernelWindowComponent *itemComponent = NULL;
 	int oldItem = 0;
 
 	kernelDebug(debug_gui, "WindowTree set selected %d", item);
 
-	if ((item < -1) || (item >= container->numComponents))
+	if ((item < -1) || (item >= tree->numItems))
 	{
 		kernelError(kernel_error, "Illegal component number %d", item);
 		return (status = ERR_BOUNDS);
@@ -680,11 +773,15 @@ static int setSelected(kernelWindowComponent *component, int item)
 
 	oldItem = tree->selectedItem;
 
+	// Only items which are showing have list item components to
+	// (de)select.  Others get the right state when they're laid out.
+
 	if ((oldItem != item) && (oldItem != -1))
 	{
 		// Deselect the old selected item
-		itemComponent = container->components[oldItem];
-		itemComponent->setSelected(itemComponent, 0);
+		itemComponent = shownItem(tree, oldItem);
+		if (itemComponent)
+			itemComponent->setSelected(itemComponent, 0);
 	}
 
 	tree->selectedItem = item;
@@ -692,8 +789,9 @@ static int setSelected(kernelWindowComponent *component, int item)
 	if ((oldItem != item) && (item != -1))
 	{
 		// Select the selected item
-		itemComponent = container->components[item];
-		itemComponent->setSelected(itemComponent, 1);
+		itemComponent = shownItem(tree, item);
+		if (itemComponent)
+			itemComponent->setSelected(itemComponent, 1);
 	}
 
 	return (status = 0);
@@ -763,7 +861,7 @@ static int mouseEvent(kernelWindowComponent *component, windowEvent *event)
 				if (isPointInside(event->coord.x, event->coord.y, area))
 				{
 					// Don't bother passing the mouse event to the list item
-					setSelected(component, count);
+					setSelected(component, tree->rowItems[count]);
 
 					// Make this also a 'selection' event
 					event->type |= WINDOW_EVENT_SELECTION;
@@ -778,7 +876,7 @@ static int mouseEvent(kernelWindowComponent *component, windowEvent *event)
 					(event->coord.x >= (area->leftX - INDENT)) &&
 					(event->coord.x <= area->leftX))
 				{
-					expandCollapse(component, count);
+					expandCollapse(component, tree->rowItems[count]);
 					break;
 				}
 			}
@@ -796,23 +894,21 @@ static int keyEvent(kernelWindowComponent *component, windowEvent *event)
 
 	int status = 0;
 	kernelWindowTree *tree = component->data;
-	kernelWindowContainer *container = tree->container->data;
-	kernelWindowComponent *itemComponent = NULL;
-	int gridY = 0;
-	int count;
+	int oldGridY = 0, gridY = 0;
+	int row = 0;
 
 	kernelDebug(debug_gui, "WindowTree key event");
 
 	if (event->type == WINDOW_EVENT_KEY_DOWN)
 	{
-		if (!container->numComponents)
+		if (!tree->numItems)
 			return (status = 0);
 
-		if (tree->selectedItem >= 0)
+		if ((tree->selectedItem >= 0) &&
+			(tree->itemRows[tree->selectedItem] >= 0))
 		{
-			// Get the currently selected item
-			itemComponent = container->components[tree->selectedItem];
-			gridY = itemComponent->params.gridY;
+			// Get the row of the currently selected item
+			gridY = oldGridY = tree->itemRows[tree->selectedItem];
 
 			switch (event->key.scan)
 			{
@@ -843,7 +939,7 @@ static int keyEvent(kernelWindowComponent *component, windowEvent *event)
 					break;
 			}
 
-			if (gridY != itemComponent->params.gridY)
+			if (gridY != oldGridY)
 			{
 				// Scroll up?
 				if (gridY < tree->scrolledLines)
@@ -857,20 +953,15 @@ static int keyEvent(kernelWindowComponent *component, windowEvent *event)
 						(tree->scrolledLines + tree->rows)));
 				}
 
-				// Find a visible item with these coordinates
-				for (count = 0; count < container->numComponents; count ++)
+				// Find the item showing in this row
+				row = (gridY - tree->scrolledLines);
+				if ((row >= 0) && (row < tree->visibleItems))
 				{
-					if ((container->components[count]->flags &
-							WINDOW_COMP_FLAG_VISIBLE) &&
-						(container->components[count]->params.gridY == gridY))
-					{
-						// Don't bother passing the key event to the list item
-						setSelected(component, count);
-
-						// Make this also a 'selection' event
-						event->type |= WINDOW_EVENT_SELECTION;
-						break;
-					}
+					// Don't bother passing the key event to the list item
+					setSelected(component, tree->rowItems[row]);
+
+					// Make this also a 'selection' event
+					event->type |= WINDOW_EVENT_SELECTION;
 				}
 			}
 		}
@@ -896,6 +987,12 @@ static int destroy(kernelWindowComponent *component)
 		if (tree->items)
 			kernelFree(tree->items);
 
+		if (tree->itemRows)
+			kernelFree(tree->itemRows);
+
+		if (tree->rowItems)
+			kernelFree(tree->rowItems);
+
 		if (tree->container)
 			kernelWindowComponentDestroy(tree->container);
 
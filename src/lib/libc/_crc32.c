@@ -0,0 +1,116 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  _crc32.c
+//
+
+// This is the CRC32 (as used by Ethernet, GZIP, PNG, GPT, etc.) shared by the
+// kernel and the C library.  It uses the 'slice-by-8' method, which looks up
+// 8 bytes at a time in 8 tables, instead of 1 byte at a time in 1 table.
+
+#include <sys/cdefs.h>
+
+#define CRC32_POLYNOMIAL	0xEDB88320
+
+static unsigned crcTable[8][256];
+static volatile int tableMade = 0;
+
+
+static void makeTable(void)
+{
+	// Table 0 is the classic byte-at-a-time table.  Each entry of table N
+	// is the CRC of the same byte followed by N zero bytes.  If more than one
+	// thread gets here at the same time, they'll all write the same values.
+
+	unsigned crc = 0;
+	int count1, count2;
+
+	for (count1 = 0; count1 < 256; count1 ++)
+	{
+		crc = count1;
+		for (count2 = 0; count2 < 8; count2 ++)
+			crc = ((crc >> 1) ^ ((crc & 1)? CRC32_POLYNOMIAL : 0));
+
+		crcTable[0][count1] = crc;
+	}
+
+	for (count1 = 0; count1 < 256; count1 ++)
+	{
+		crc = crcTable[0][count1];
+		for (count2 = 1; count2 < 8; count2 ++)
+		{
+			crc = (crcTable[0][crc & 0xFF] ^ (crc >> 8));
+			crcTable[count2][count1] = crc;
+		}
+	}
+
+	// Make sure the tables are complete before anyone can see the flag
+	__asm__ __volatile__ ("" : : : "memory");
+	tableMade = 1;
+}
+
+
+unsigned _crc32(void *buff, unsigned len, unsigned *lastCrc)
+{
+	// Generates a CRC32 of 'len' bytes of 'buff', optionally continuing from
+	// the previous value in 'lastCrc'
+
+	const unsigned char *p = buff;
+	unsigned crc = 0;
+	unsigned lo = 0, hi = 0;
+
+	if (!tableMade)
+		makeTable();
+
+	if (lastCrc)
+		crc = *lastCrc;
+
+	crc ^= ~0U;
+
+	// Go a byte at a time until the buffer is aligned
+	while (len && ((unsigned long) p & (sizeof(unsigned) - 1)))
+	{
+		crc = (crcTable[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8));
+		len -= 1;
+	}
+
+	// 8 bytes at a time
+	while (len >= 8)
+	{
+		lo = (*((unsigned *) p) ^ crc);
+		hi = *((unsigned *)(p + 4));
+
+		crc = (crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF] ^
+			crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24] ^
+			crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF] ^
+			crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24]);
+
+		p += 8;
+		len -= 8;
+	}
+
+	// Whatever is left over
+	while (len--)
+		crc = (crcTable[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8));
+
+	if (lastCrc)
+		*lastCrc = crc;
+
+	return (crc ^ ~0U);
+}
+
@@ -22,6 +22,7 @@
 // This contains code for calling the Visopsys kernel
 
 #include <sys/api.h>
+#include <sys/cdefs.h>
 
 #ifndef _X_
 #define _X_
@@ -976,6 +977,13 @@ _X_ int memoryGetBlocks(memoryBlock *blocksArray, unsigned buffSize _U_, int ker
 	return (_syscall(_fnum_memoryGetBlocks, &blocksArray));
 }
 
+_X_ void *memoryCopyToProcess(void *buffer, int processId _U_)
+{
+	// Proto: void *kernelMemoryCopyToProcess(void *, int);
+	// Desc : Give the process 'processId' a copy of the block of memory starting at 'buffer', which must have been allocated using memoryGet().  The memory isn't really copied; both processes share it read-only until one of them writes to it, at which point the writer gets its own copy.  This is a cheap way to hand a large buffer to another process.  Returns the address of the copy in the other process' address space, or NULL on error.  Either copy can be released with memoryRelease().
+	return ((void *)(long) _syscall(_fnum_memoryCopyToProcess, &buffer));
+}
+
 
 //
 // Multitasker functions
@@ -1198,6 +1206,55 @@ _X_ int multitaskerStackTrace(int processId)
 	return (_syscall(_fnum_multitaskerStackTrace, &processId));
 }
 
+_X_ void multitaskerWaitUs(unsigned microseconds)
+{
+	// Proto: void kernelMultitaskerWaitUs(unsigned);
+	// Desc : Like multitaskerWait(), but wait at least 'microseconds' before running the calling process again.
+	_syscall(_fnum_multitaskerWaitUs, &microseconds);
+}
+
+_X_ int multitaskerFutexWait(volatile int *address, int value _U_, unsigned timeout _U_)
+{
+	// Proto: int kernelMultitaskerFutexWait(volatile int *, int, unsigned);
+	// Desc : If the integer at 'address' still contains 'value', wait until another thread or process calls multitaskerFutexWake() for the same address, or until 'timeout' microseconds have passed (if non-zero).  Returns 0 if woken, ERR_BUSY if the value had already changed, or ERR_TIMEOUT.  This is the basis of the libpthread locks.
+	return (_syscall(_fnum_multitaskerFutexWait, &address));
+}
+
+_X_ int multitaskerFutexWake(volatile int *address, int count _U_)
+{
+	// Proto: int kernelMultitaskerFutexWake(volatile int *, int);
+	// Desc : Wake up to 'count' threads or processes waiting in multitaskerFutexWait() on 'address'.  Returns the number woken.
+	return (_syscall(_fnum_multitaskerFutexWake, &address));
+}
+
+_X_ int multitaskerSetProfiling(int on)
+{
+	// Proto: int kernelMultitaskerSetProfiling(int);
+	// Desc : Turn the collection of timing statistics for processes and kernel API functions on (non-zero 'on') or off.  Turning it on resets all of the statistics.  Context switch, page fault, and API call counts are always collected.
+	return (_syscall(_fnum_multitaskerSetProfiling, &on));
+}
+
+_X_ int multitaskerGetProfiling(void)
+{
+	// Proto: int kernelMultitaskerGetProfiling(void);
+	// Desc : Returns 1 if timing statistics are being collected, 0 otherwise.
+	return (_syscall(_fnum_multitaskerGetProfiling, NULL));
+}
+
+_X_ int multitaskerGetProcessStats(int pid, processStats *stats _U_)
+{
+	// Proto: int kernelMultitaskerGetProcessStats(int, processStats *);
+	// Desc : Fill in the processStats structure 'stats' with the context switch, run, ready and blocked time, page fault, and API call statistics of the process with process ID 'pid'.
+	return (_syscall(_fnum_multitaskerGetProcessStats, &pid));
+}
+
+_X_ int multitaskerGetApiStats(apiCallStats *stats, int maxStats _U_)
+{
+	// Proto: int kernelApiGetStats(apiCallStats *, int);
+	// Desc : Fill in up to 'maxStats' apiCallStats structures in 'stats' with the call counts and times of the kernel API functions that have been called while profiling (see multitaskerSetProfiling()).  Returns the number filled in.
+	return (_syscall(_fnum_multitaskerGetApiStats, &stats));
+}
+
 
 //
 // Loader functions
@@ -2262,6 +2319,48 @@ _X_ int windowMenuDestroy(objectKey menu)
 	return (_syscall(_fnum_windowMenuDestroy, &menu));
 }
 
+_X_ objectKey windowNewVirtualList(objectKey parent, windowListType type _U_, int rows _U_, int columns _U_, int multiple _U_, int numItems _U_, componentParameters *params _U_)
+{
+	// Proto: kernelWindowComponent *kernelWindowNewVirtualList(objectKey, windowListType, int, int, int, int, componentParameters *);
+	// Desc : Get a new virtual window list component to be placed inside the parent object 'parent', using the component parameters 'params'.  This is like windowNewList(), except that instead of supplying all the items up front, the caller only specifies the number of items, 'numItems', and the list only keeps components for the items around the visible rows.  When the list needs data for items it puts a WINDOW_EVENT_LIST_FETCH event in its event queue, with the number of the first item in 'coord.x' and the number of items in 'coord.y', and the caller should respond by calling windowListSetItems().  See also windowRegisterListDataHandler() in libwindow, which can do this automatically.
+	return ((objectKey)(long) _syscall(_fnum_windowNewVirtualList, &parent));
+}
+
+_X_ int windowListSetNumItems(objectKey list, int numItems _U_)
+{
+	// Proto: int kernelWindowListSetNumItems(kernelWindowComponent *, int);
+	// Desc : Change the number of items in the virtual window list 'list' to 'numItems'.  Any item data already supplied is discarded, and the list will request it again using WINDOW_EVENT_LIST_FETCH events.
+	return (_syscall(_fnum_windowListSetNumItems, &list));
+}
+
+_X_ int windowListSetItems(objectKey list, int firstItem _U_, listItemParameters *items _U_, int numItems _U_)
+{
+	// Proto: int kernelWindowListSetItems(kernelWindowComponent *, int, listItemParameters *, int);
+	// Desc : Supply the data for 'numItems' items of the window list 'list', starting at item number 'firstItem', in the array 'items'.  For virtual lists, this is the response to WINDOW_EVENT_LIST_FETCH events, and data for items which are no longer near the visible rows is ignored.  For other lists, this updates the existing items.
+	return (_syscall(_fnum_windowListSetItems, &list));
+}
+
+_X_ int windowListScrollTo(objectKey list, int item _U_)
+{
+	// Proto: int kernelWindowListScrollTo(kernelWindowComponent *, int);
+	// Desc : Scroll the window list 'list', if necessary, so that the item number 'item' is visible.
+	return (_syscall(_fnum_windowListScrollTo, &list));
+}
+
+_X_ int windowCanvasMapBuffer(objectKey canvas, graphicBuffer *buffer _U_)
+{
+	// Proto: int kernelWindowCanvasMapBuffer(kernelWindowComponent *, graphicBuffer *);
+	// Desc : Map the graphic buffer of the window canvas 'canvas' into the address space of the calling process, so that it can be drawn upon directly without further kernel API calls, and fill in 'buffer' to describe it.  Call windowCanvasPresent() to put the changes on the screen.  Only the process that owns the window containing the canvas, or one of its threads, can map it.  If the canvas is resized, the old mapping is removed, and this function must be called again.
+	return (_syscall(_fnum_windowCanvasMapBuffer, &canvas));
+}
+
+_X_ int windowCanvasPresent(objectKey canvas, int xCoord _U_, int yCoord _U_, int width _U_, int height _U_)
+{
+	// Proto: int kernelWindowCanvasPresent(kernelWindowComponent *, int, int, int, int);
+	// Desc : After drawing directly into a mapped buffer (see windowCanvasMapBuffer()), put the area of the canvas 'canvas' at ('xCoord', 'yCoord'), with the dimensions 'width' and 'height', on the screen.
+	return (_syscall(_fnum_windowCanvasPresent, &canvas));
+}
+
 
 //
 // User functions
@@ -2716,11 +2815,11 @@ _X_ int guidGenerate(guid *g)
 	return (_syscall(_fnum_guidGenerate, &g));
 }
 
-_X_ unsigned crc32(void *buff, unsigned len _U_, unsigned *lastCrc _U_)
+_X_ unsigned crc32(void *buff, unsigned len, unsigned *lastCrc)
 {
 	// Proto: unsigned kernelCrc32(void *, unsigned, unsigned *);
-	// Desc : Generate a CRC32 from 'len' bytes of the buffer 'buff', using an optional previous CRC32 value (otherwise lastCrc should be NULL).
-	return (_syscall(_fnum_crc32, &buff));
+	// Desc : Generate a CRC32 from 'len' bytes of the buffer 'buff', using an optional previous CRC32 value (otherwise lastCrc should be NULL).  This is done by the C library in the calling process, without a call into the kernel.
+	return (_crc32(buff, len, lastCrc));
 }
 
 _X_ int keyboardGetMap(keyMap *map)
@@ -2814,3 +2913,38 @@ _X_ int touchAvailable(void)
 	return (_syscall(_fnum_touchAvailable, NULL));
 }
 
+_X_ uquad_t cpuGetUs(void)
+{
+	// Proto: uquad_t kernelCpuGetUs(void);
+	// Desc : Returns a value representing the current CPU timestamp in microseconds.
+	return (_syscall(_fnum_cpuGetUs, NULL));
+}
+
+_X_ int cpuGetCount(void)
+{
+	// Proto: int kernelSmpCpus(void);
+	// Desc : Returns the number of processors that are running.
+	return (_syscall(_fnum_cpuGetCount, NULL));
+}
+
+_X_ int configGetCacheStats(configCacheStats *stats)
+{
+	// Proto: int kernelConfigGetCacheStats(configCacheStats *);
+	// Desc : Returns statistics for the kernel's cache of parsed configuration files in 'stats': the number of hits and misses for configGet, configSet and configUnset, the number of times a cached file was invalidated because the file changed, and the number of files currently cached.
+	return (_syscall(_fnum_configGetCacheStats, &stats));
+}
+
+_X_ int cryptHashSha1File(const char *fileName, unsigned char *out _U_)
+{
+	// Proto: int kernelCryptHashSha1File(const char *, unsigned char *);
+	// Desc : Read the file 'fileName' and return its SHA1 digest in the buffer 'out', which must be at least CRYPT_HASH_SHA1_BYTES long.  The file is read and hashed inside the kernel, so it doesn't need to be read by the caller.
+	return (_syscall(_fnum_cryptHashSha1File, &fileName));
+}
+
+_X_ int cryptHashSha256File(const char *fileName, unsigned char *out _U_)
+{
+	// Proto: int kernelCryptHashSha256File(const char *, unsigned char *);
+	// Desc : Read the file 'fileName' and return its SHA256 digest in the buffer 'out', which must be at least CRYPT_HASH_SHA256_BYTES long.  The file is read and hashed inside the kernel, so it doesn't need to be read by the caller.
+	return (_syscall(_fnum_cryptHashSha256File, &fileName));
+}
+
@@ -0,0 +1,85 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  clock_gettime.c
+//
+
+// This is the standard "clock_gettime" function, as found in standard C
+// libraries
+
+#include <time.h>
+#include <errno.h>
+#include <sys/api.h>
+
+
+int clock_gettime(clockid_t clockId, struct timespec *tp)
+{
+	// The clock_gettime() function retrieves the time of the specified
+	// clock.  CLOCK_MONOTONIC counts from an unspecified starting point, and
+	// CLOCK_REALTIME from 00:00:00 UTC, January 1, 1970.  Returns 0 on
+	// success, or -1 on error (in which case errno is set).
+
+	static uquad_t realtimeOffset = 0;
+	uquad_t us = 0;
+	time_t now = 0;
+
+	if (visopsys_in_kernel)
+	{
+		errno = ERR_BUG;
+		return (-1);
+	}
+
+	if (!tp)
+	{
+		errno = ERR_NULLPARAMETER;
+		return (-1);
+	}
+
+	us = cpuGetUs();
+
+	switch (clockId)
+	{
+		case CLOCK_MONOTONIC:
+			break;
+
+		case CLOCK_REALTIME:
+			// The real-time clock only counts seconds, so remember how far
+			// it is from the timestamp counter, and use that
+			if (!realtimeOffset)
+			{
+				now = time(NULL);
+				if (now == (time_t) -1)
+					return (-1);
+
+				realtimeOffset = (((uquad_t) now * US_PER_SEC) - us);
+			}
+
+			us += realtimeOffset;
+			break;
+
+		default:
+			errno = ERR_INVALID;
+			return (-1);
+	}
+
+	tp->tv_sec = (time_t)(us / US_PER_SEC);
+	tp->tv_nsec = (long)((us % US_PER_SEC) * NS_PER_US);
+
+	return (0);
+}
+
@@ -0,0 +1,44 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  usleep.c
+//
+
+// This is the standard "usleep" function, as found in standard C libraries
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/api.h>
+
+
+int usleep(useconds_t usec)
+{
+	// Suspend execution for (at least) the specified number of microseconds.
+	// Returns 0 on success, or -1 on error.
+
+	if (visopsys_in_kernel)
+	{
+		errno = ERR_BUG;
+		return (-1);
+	}
+
+	multitaskerWaitUs(usec);
+
+	return (0);
+}
+
@@ -23,10 +23,12 @@
 
 #include "libcompress.h"
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/deflate.h>
 #include <sys/api.h>
+#include <sys/processor.h>
 
 #ifdef DEBUG
 	#define DEBUG_OUTMAX	160
@@ -82,6 +84,11 @@ static void makeHuffmanCodes(unsigned char *codeLens, huffmanTable *table)
 		table->len[bits].numCodes = lenCounts[bits];
 	}
 
+	// There might not be any codes at all (for example no distance codes,
+	// when a block is all literals)
+	if (!table->mostBits)
+		return;
+
 	DEBUGMSG("Code length counts (numCodes=%d, leastBits=%d, mostBits=%d):\n",
 		table->numCodes, table->leastBits, table->mostBits);
 	for (bits = table->leastBits; bits <= table->mostBits; bits ++)
@@ -149,53 +156,458 @@ static void makeHuffmanCodes(unsigned char *codeLens, huffmanTable *table)
 }
 
 
-/////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////
-//
-// Below here, the functions are exported for external use
-//
-/////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////
+// Large inputs are compressed in independent chunks by a pool of threads, and
+// the output is written out in order by the calling thread.  Each chunk gets
+// the last DEFLATE_MAX_DISTANCE (32K) bytes of the one before it as a preset
+// dictionary, so very little compression is lost.
+#define PARALLEL_CHUNK			(DEFLATE_MAX_INBUFFERSIZE * 4)
+#define PARALLEL_MAX_THREADS	8
+#define PARALLEL_MAX_JOBS		(PARALLEL_MAX_THREADS * 2)
+
+// States of a compression job, or of the decompression output writer
+#define JOB_FREE				0
+#define JOB_READY				1
+#define JOB_BUSY				2
+#define JOB_DONE				3
+#define JOB_QUIT				4
+
+typedef struct {
+	volatile int state;
+	unsigned char *inBuffer;	// Dictionary, followed by the input chunk
+	unsigned dictBytes;
+	unsigned inBytes;
+	int last;
+	unsigned char *outBuffer;
+	unsigned outBytes;
+	unsigned outByte;
+	int status;
+
+} compressJob;
+
+typedef struct {
+	compressJob jobs[PARALLEL_MAX_JOBS];
+	int numJobs;
+	int level;
+	volatile int sequence;		// Changes whenever a job is ready
+	volatile int quit;
+
+} compressPool;
+
+typedef struct {
+	compressPool *pool;
+	deflateState *state;
+	int pid;
+
+} compressWorker;
+
+typedef struct {
+	volatile int state;
+	FILE *outStream;
+	int (*output)(void *, unsigned char *, unsigned);
+	void *data;
+	unsigned char *buffer;
+	unsigned bytes;
+	int status;
+
+} outputWriter;
+
+
+static int spawnThread(void *function, const char *name, void *data)
+{
+	// Start a thread, passing it a pointer as its argument string
 
-int deflateCompressFileData(deflateState *deflate, FILE *inStream,
+	char ptrString[(sizeof(void *) * 2) + 3];
+
+	lltoux((unsigned long) data, ptrString);
+
+	return (multitaskerSpawn(function, name, 1, (void *[]){ ptrString },
+		1 /* run */));
+}
+
+
+static void *threadData(int argc, void *argv[])
+{
+	// Convert a thread's argument string back to a pointer
+
+	if (argc != 2)
+		return (NULL);
+
+	return ((void *)((unsigned long) xtoll((char *) argv[1])));
+}
+
+
+static void setState(volatile int *state, int value)
+{
+	// Change a job state, and wake up anyone waiting for it to change
+
+	processorExchange(*state, value);
+	multitaskerFutexWake(state, INT_MAX);
+}
+
+
+static void waitState(volatile int *state, int value)
+{
+	// Wait until a job state has the requested value
+
+	int current = 0;
+
+	while ((current = *state) != value)
+		multitaskerFutexWait(state, current, 0 /* no timeout */);
+}
+
+
+static void poolWake(compressPool *pool, int threads)
+{
+	// Change the pool's sequence number, and wake up waiting threads
+
+	int add = 1;
+
+	processorAtomicAdd(pool->sequence, add);
+	multitaskerFutexWake(&pool->sequence, threads);
+}
+
+
+static void stopThread(int pid)
+{
+	// Wait for a thread that's been told to quit
+
+	if ((pid > 0) && multitaskerProcessIsAlive(pid))
+		multitaskerBlock(pid);
+}
+
+
+static void compressThread(int argc, void *argv[])
+{
+	// One of a pool of threads which take chunks of input that are ready,
+	// and compress them
+
+	compressWorker *worker = threadData(argc, argv);
+	compressPool *pool = NULL;
+	deflateState *state = NULL;
+	compressJob *job = NULL;
+	int sequence = 0;
+	int old = 0;
+	int count;
+
+	if (!worker)
+		multitaskerTerminate(ERR_NULLPARAMETER);
+
+	pool = worker->pool;
+	state = worker->state;
+
+	while (1)
+	{
+		// Get the sequence number before looking, so that we can't miss the
+		// wakeup for a job that becomes ready in the meantime
+		sequence = pool->sequence;
+		job = NULL;
+
+		for (count = 0; count < pool->numJobs; count ++)
+		{
+			old = JOB_READY;
+			processorCompareExchange(pool->jobs[count].state, old, JOB_BUSY);
+			if (old == JOB_READY)
+			{
+				job = &pool->jobs[count];
+				break;
+			}
+		}
+
+		if (!job)
+		{
+			if (pool->quit)
+				break;
+
+			multitaskerFutexWait(&pool->sequence, sequence,
+				0 /* no timeout */);
+			continue;
+		}
+
+		memset(state, 0, sizeof(deflateState));
+		memset(job->outBuffer, 0, job->outBytes);
+		state->inBuffer = job->inBuffer;
+		state->inByte = job->dictBytes;
+		state->inBytes = job->inBytes;
+		state->outBuffer = job->outBuffer;
+		state->outBytes = job->outBytes;
+		state->level = pool->level;
+
+		// Unless this is the last chunk, the next one gets appended to the
+		// output, so it has to end on a byte boundary
+		state->flush = !job->last;
+
+		job->status = deflateCompress(state);
+
+		// If the last chunk was a multiple of the block size, there's no
+		// final block yet
+		if ((job->status >= 0) && job->last && !state->final)
+			job->status = deflateCompress(state);
+
+		job->outByte = state->outByte;
+
+		setState(&job->state, JOB_DONE);
+	}
+
+	multitaskerTerminate(0);
+}
+
+
+static int writeJob(compressJob *job, FILE *outStream, progress *prog,
+	unsigned *doneBytes, unsigned totalBytes)
+{
+	// If the job has been started, wait for it to finish, and write out the
+	// compressed data
+
+	int status = 0;
+
+	if (job->state == JOB_FREE)
+		return (status = 0);
+
+	waitState(&job->state, JOB_DONE);
+	job->state = JOB_FREE;
+
+	if (job->status < 0)
+	{
+		fprintf(stderr, "Error compressing data for %s\n",
+			outStream->f.name);
+		return (status = job->status);
+	}
+
+	DEBUGMSG("Writing %u bytes\n", job->outByte);
+	if (prog && (lockGet(&prog->lock) >= 0))
+	{
+		sprintf((char *) prog->statusMessage, "Writing %u bytes",
+			job->outByte);
+		lockRelease(&prog->lock);
+	}
+
+	if (fwrite((void *) job->outBuffer, 1, job->outByte, outStream) <
+		job->outByte)
+	{
+		fprintf(stderr, "Error writing %s\n", outStream->f.name);
+		return (status = ERR_IO);
+	}
+
+	*doneBytes += job->inBytes;
+
+	if (prog && (lockGet(&prog->lock) >= 0))
+	{
+		prog->numFinished = *doneBytes;
+		prog->percentFinished = ((*doneBytes * 100) / totalBytes);
+		lockRelease(&prog->lock);
+	}
+
+	return (status = 0);
+}
+
+
+static int compressParallel(deflateState *deflate, FILE *inStream,
 	FILE *outStream, progress *prog)
 {
+	// Read the input in chunks, have the pool of threads compress them, and
+	// write out the results in order.  Returns ERR_NOCREATE, before doing any
+	// I/O, if no threads could be started.
+
 	int status = 0;
 	unsigned totalBytes = inStream->f.size;
+	unsigned readBytes = 0;
+	unsigned doneBytes = 0;
+	compressPool *pool = NULL;
+	compressWorker workers[PARALLEL_MAX_THREADS];
+	int numWorkers = 0;
+	compressJob *job = NULL;
+	compressJob *prevJob = NULL;
+	int chunk = 0;
+	int ready = 0;
+	int count;
+
+	memset(workers, 0, sizeof(workers));
+
+	// One thread per processor, but at least one, so that the I/O overlaps
+	// with the compression even if there's only one processor
+	numWorkers = max(1, min(cpuGetCount(), PARALLEL_MAX_THREADS));
+	numWorkers = min(numWorkers, (int)((totalBytes + (PARALLEL_CHUNK - 1)) /
+		PARALLEL_CHUNK));
+
+	pool = calloc(1, sizeof(compressPool));
+	if (!pool)
+	{
+		fprintf(stderr, "Memory error\n");
+		return (status = ERR_MEMORY);
+	}
+
+	pool->numJobs = (numWorkers * 2);
+	pool->level = deflate->level;
+
+	for (count = 0; count < pool->numJobs; count ++)
+	{
+		job = &pool->jobs[count];
+		job->inBuffer = malloc(DEFLATE_MAX_DISTANCE + PARALLEL_CHUNK);
+		job->outBytes = (PARALLEL_CHUNK + (PARALLEL_CHUNK / 10));
+		job->outBuffer = malloc(job->outBytes);
+
+		if (!job->inBuffer || !job->outBuffer)
+		{
+			fprintf(stderr, "Memory error\n");
+			status = ERR_MEMORY;
+			goto out;
+		}
+	}
+
+	for (count = 0; count < numWorkers; count ++)
+	{
+		workers[count].pool = pool;
+		workers[count].state = malloc(sizeof(deflateState));
+		if (!workers[count].state)
+			break;
+
+		workers[count].pid = spawnThread(&compressThread, "compress thread",
+			&workers[count]);
+		if (workers[count].pid < 0)
+		{
+			free(workers[count].state);
+			memset(&workers[count], 0, sizeof(compressWorker));
+			break;
+		}
+	}
+
+	numWorkers = count;
+	if (!numWorkers)
+	{
+		status = ERR_NOCREATE;
+		goto out;
+	}
+
+	DEBUGMSG("Compressing with %d threads\n", numWorkers);
+
+	deflate->crc32Sum = 0;
+
+	for (chunk = 0; readBytes < totalBytes; chunk ++)
+	{
+		job = &pool->jobs[chunk % pool->numJobs];
+
+		// Finish off the last chunk that used this job
+		status = writeJob(job, outStream, prog, &doneBytes, totalBytes);
+		if (status < 0)
+			goto out;
+
+		job->dictBytes = 0;
+		if (prevJob)
+		{
+			memcpy(job->inBuffer, (prevJob->inBuffer + prevJob->dictBytes +
+				prevJob->inBytes - DEFLATE_MAX_DISTANCE),
+				DEFLATE_MAX_DISTANCE);
+			job->dictBytes = DEFLATE_MAX_DISTANCE;
+		}
+
+		job->inBytes = min((totalBytes - readBytes), PARALLEL_CHUNK);
+
+		DEBUGMSG("Reading %u bytes\n", job->inBytes);
+		if (prog && (lockGet(&prog->lock) >= 0))
+		{
+			sprintf((char *) prog->statusMessage, "Reading %u bytes",
+				job->inBytes);
+			lockRelease(&prog->lock);
+		}
+
+		if (fread((job->inBuffer + job->dictBytes), 1, job->inBytes,
+			inStream) < job->inBytes)
+		{
+			fprintf(stderr, "Error reading %s\n", inStream->f.name);
+			status = ERR_IO;
+			goto out;
+		}
+
+		// The threads only do the checksums of their own chunks
+		deflate->crc32Sum = crc32((job->inBuffer + job->dictBytes),
+			job->inBytes, &deflate->crc32Sum);
+
+		readBytes += job->inBytes;
+		job->last = (readBytes >= totalBytes);
+		prevJob = job;
+
+		// Hand it to the threads
+		ready = JOB_READY;
+		processorExchange(job->state, ready);
+		poolWake(pool, 1);
+	}
+
+	// Write out the rest, in order
+	for (count = 0; count < pool->numJobs; count ++)
+	{
+		status = writeJob(&pool->jobs[(chunk + count) % pool->numJobs],
+			outStream, prog, &doneBytes, totalBytes);
+		if (status < 0)
+			goto out;
+	}
+
+	deflate->final = 1;
+	status = 0;
+
+out:
+	// Tell the threads to quit once there's nothing left to do, and wait for
+	// them
+	pool->quit = 1;
+	poolWake(pool, INT_MAX);
+
+	for (count = 0; count < numWorkers; count ++)
+	{
+		stopThread(workers[count].pid);
+		free(workers[count].state);
+	}
+
+	for (count = 0; count < pool->numJobs; count ++)
+	{
+		if (pool->jobs[count].inBuffer)
+			free(pool->jobs[count].inBuffer);
+		if (pool->jobs[count].outBuffer)
+			free(pool->jobs[count].outBuffer);
+	}
+
+	free(pool);
+
+	return (status);
+}
+
+
+static int compressSerial(deflateState *deflate, FILE *inStream,
+	FILE *outStream, progress *prog)
+{
+	// Compress the input a buffer at a time, in the calling thread
+
+	int status = 0;
+	unsigned totalBytes = inStream->f.size;
+	unsigned bufferBytes = 0;
 	unsigned maxInBytes = 0;
 	unsigned maxOutBytes = 0;
 	unsigned doneBytes = 0;
 
-	maxInBytes = min(totalBytes, COMPRESS_MAX_BUFFERSIZE);
-	maxInBytes = max(maxInBytes, 1); // Makes dealing with empty files easier
+	bufferBytes = min(totalBytes, COMPRESS_MAX_BUFFERSIZE);
+	bufferBytes = max(bufferBytes, 1); // Makes dealing with empty files easier
 
 	// Worst case scenario, DEFLATE expands to 5 extra bytes per 32K block,
 	// but give it a bit of extra working space in any case.
-	maxOutBytes = (maxInBytes +
-		max((((maxInBytes + (DEFLATE_MAX_INBUFFERSIZE - 1)) /
+	maxOutBytes = (bufferBytes +
+		max((((bufferBytes + (DEFLATE_MAX_INBUFFERSIZE - 1)) /
 			DEFLATE_MAX_INBUFFERSIZE) * 5),
-		(maxInBytes / 10)));
+		(bufferBytes / 10)));
 	maxOutBytes = max(maxOutBytes, 5);
 
-	memset(deflate, 0, sizeof(deflateState));
-	deflate->inBuffer = calloc(maxInBytes, 1);
+	deflate->inBuffer = calloc(bufferBytes, 1);
 	deflate->outBuffer = calloc(maxOutBytes, 1);
 
 	if (!deflate->inBuffer || !deflate->outBuffer)
 	{
 		fprintf(stderr, "Memory error\n");
-		return (status = ERR_MEMORY);
-	}
-
-	if (prog)
-	{
-		memset((void *) prog, 0, sizeof(progress));
-		prog->numTotal = totalBytes;
+		status = ERR_MEMORY;
+		goto out;
 	}
 
 	do
 	{
-		maxInBytes = min((totalBytes - doneBytes), maxInBytes);
+		// Whatever fits after any data we're keeping from the previous round
+		maxInBytes = min((totalBytes - doneBytes),
+			(bufferBytes - deflate->inByte));
 
 		if (doneBytes < totalBytes)
 		{
@@ -273,7 +685,6 @@ int deflateCompressFileData(deflateState *deflate, FILE *inStream,
 				(deflate->inBuffer + (deflate->inByte - DEFLATE_MAX_DISTANCE)),
 				DEFLATE_MAX_DISTANCE);
 			deflate->inByte = DEFLATE_MAX_DISTANCE;
-			maxInBytes -= DEFLATE_MAX_DISTANCE;
 
 			// If the previous round produced an incomplete output byte,
 			// preserve it for the next round in byte 0, and clear the rest.
@@ -291,6 +702,7 @@ int deflateCompressFileData(deflateState *deflate, FILE *inStream,
 
 	} while (!deflate->final);
 
+out:
 	if (deflate->outBuffer)
 		free(deflate->outBuffer);
 
@@ -301,27 +713,142 @@ int deflateCompressFileData(deflateState *deflate, FILE *inStream,
 }
 
 
-int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
-	FILE *outStream, progress *prog)
+static int writeOutput(FILE *outStream,
+	int (*output)(void *, unsigned char *, unsigned), void *data,
+	unsigned char *buffer, unsigned bytes)
 {
+	// Send decompressed data to the output function, if there is one, or
+	// else write it to the output stream
+
+	int status = 0;
+
+	if (output)
+		return (status = output(data, buffer, bytes));
+
+	if (fwrite((void *) buffer, 1, bytes, outStream) < bytes)
+	{
+		fprintf(stderr, "Error writing %s\n", outStream->f.name);
+		return (status = ERR_IO);
+	}
+
+	return (status = 0);
+}
+
+
+static void writerThread(int argc, void *argv[])
+{
+	// Writes out one lot of decompressed data, while the calling thread is
+	// decompressing the next
+
+	outputWriter *writer = threadData(argc, argv);
+	int current = 0;
+
+	if (!writer)
+		multitaskerTerminate(ERR_NULLPARAMETER);
+
+	while (1)
+	{
+		current = writer->state;
+
+		if (current == JOB_READY)
+		{
+			if (writer->status >= 0)
+			{
+				writer->status = writeOutput(writer->outStream,
+					writer->output, writer->data, writer->buffer,
+					writer->bytes);
+			}
+
+			setState(&writer->state, JOB_DONE);
+			continue;
+		}
+
+		if (current == JOB_QUIT)
+			break;
+
+		multitaskerFutexWait(&writer->state, current, 0 /* no timeout */);
+	}
+
+	multitaskerTerminate(0);
+}
+
+
+static int startWriter(outputWriter **writer, FILE *outStream,
+	int (*output)(void *, unsigned char *, unsigned), void *data,
+	unsigned char **outBuffer, unsigned bytes)
+{
+	// Get a second output buffer, and start a thread to write the output
+	// from one while we decompress into the other.  Returns the thread's
+	// process ID.
+
+	*writer = calloc(1, sizeof(outputWriter));
+	*outBuffer = calloc(bytes, 1);
+
+	if (!*writer || !*outBuffer)
+		return (ERR_MEMORY);
+
+	(*writer)->outStream = outStream;
+	(*writer)->output = output;
+	(*writer)->data = data;
+
+	return (spawnThread(&writerThread, "decompress writer thread", *writer));
+}
+
+
+static int stopWriter(outputWriter *writer, int pid)
+{
+	// Wait for the writer thread to finish what it's doing, and stop it
+
+	int status = 0;
+
+	if (pid <= 0)
+		return (status = 0);
+
+	if (writer->state == JOB_READY)
+		waitState(&writer->state, JOB_DONE);
+
+	status = writer->status;
+
+	setState(&writer->state, JOB_QUIT);
+	stopThread(pid);
+
+	return (status);
+}
+
+
+static int decompressFileData(deflateState *deflate, FILE *inStream,
+	FILE *outStream, int (*output)(void *, unsigned char *, unsigned),
+	void *data, progress *prog)
+{
+	// Decompress from the input stream until the end of the final block,
+	// passing the output to the output function or the output stream, if
+	// any.  If there's more than one buffer's worth, a separate thread deals
+	// with each buffer while we decompress the next one.
+
 	int status = 0;
 	unsigned totalBytes = inStream->f.size;
 	unsigned maxInBytes = 0;
 	unsigned maxOutBytes = 0;
 	unsigned doneBytes = 0;
 	unsigned skipOutBytes = 0;
+	unsigned char *outBuffers[2] = { NULL, NULL };
+	int current = 0;
+	outputWriter *writer = NULL;
+	int writerPid = 0;
+	int writerStatus = 0;
 
 	maxInBytes = min(totalBytes, COMPRESS_MAX_BUFFERSIZE);
 	maxOutBytes = COMPRESS_MAX_BUFFERSIZE;
 
 	memset(deflate, 0, sizeof(deflateState));
 	deflate->inBuffer = calloc(maxInBytes, 1);
-	deflate->outBuffer = calloc(maxOutBytes, 1);
+	deflate->outBuffer = outBuffers[0] = calloc(maxOutBytes, 1);
 
 	if (!deflate->inBuffer || !deflate->outBuffer)
 	{
 		fprintf(stderr, "Memory error\n");
-		return (status = ERR_MEMORY);
+		status = ERR_MEMORY;
+		goto out;
 	}
 
 	if (prog)
@@ -373,7 +900,7 @@ int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
 			break;
 		}
 
-		if (outStream)
+		if (outStream || output)
 		{
 			DEBUGMSG("Writing %u bytes\n", (deflate->outByte - skipOutBytes));
 			if (prog && (lockGet(&prog->lock) >= 0))
@@ -383,13 +910,37 @@ int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
 				lockRelease(&prog->lock);
 			}
 
-			if (fwrite((void *)(deflate->outBuffer + skipOutBytes), 1,
-				(deflate->outByte - skipOutBytes), outStream) <
-				(deflate->outByte - skipOutBytes))
+			// If there will be more, try to get the writer thread going
+			if (!deflate->final && !writer)
 			{
-				fprintf(stderr, "Error writing %s\n", outStream->f.name);
-				status = ERR_IO;
-				break;
+				writerPid = startWriter(&writer, outStream, output, data,
+					&outBuffers[1], maxOutBytes);
+			}
+
+			if (writerPid > 0)
+			{
+				// Wait for the writer to finish with the previous buffer, and
+				// give it this one
+				if (writer->state == JOB_READY)
+					waitState(&writer->state, JOB_DONE);
+
+				if (writer->status < 0)
+				{
+					status = writer->status;
+					break;
+				}
+
+				writer->buffer = (deflate->outBuffer + skipOutBytes);
+				writer->bytes = (deflate->outByte - skipOutBytes);
+				setState(&writer->state, JOB_READY);
+			}
+			else
+			{
+				status = writeOutput(outStream, output, data,
+					(deflate->outBuffer + skipOutBytes),
+					(deflate->outByte - skipOutBytes));
+				if (status < 0)
+					break;
 			}
 		}
 
@@ -409,25 +960,26 @@ int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
 		// need to copy them to the top before we start the next loop.
 		if (deflate->inBytes)
 		{
-			memcpy((void *) deflate->inBuffer, (deflate->inBuffer +
+			memmove((void *) deflate->inBuffer, (deflate->inBuffer +
 				deflate->inByte), deflate->inBytes);
 		}
 
-		// We must keep the last DEFLATE_MAX_DISTANCE (32K) bytes at the top
-		// of the output buffer.
-		memmove(deflate->outBuffer,
+		// We must keep the last DEFLATE_MAX_DISTANCE (32K) bytes of output at
+		// the top of the output buffer.  If the writer thread has this one,
+		// switch to the other.
+		if (writerPid > 0)
+			current ^= 1;
+
+		memmove(outBuffers[current],
 			(deflate->outBuffer + (deflate->outByte - DEFLATE_MAX_DISTANCE)),
 			DEFLATE_MAX_DISTANCE);
+		deflate->outBuffer = outBuffers[current];
 
 		if (!skipOutBytes)
 		{
 			skipOutBytes = DEFLATE_MAX_DISTANCE;
 			maxOutBytes -= skipOutBytes;
 		}
-
-		// Clear the rest of the output buffer
-		memset((deflate->outBuffer + skipOutBytes), 0,
-			(deflate->outByte - skipOutBytes));
 	}
 
 	// Seek backwards to the start of any un-processed input bytes
@@ -437,8 +989,21 @@ int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
 		fseek(inStream, -((long) deflate->inBytes), SEEK_CUR);
 	}
 
-	if (deflate->outBuffer)
-		free(deflate->outBuffer);
+out:
+	if (writer)
+	{
+		writerStatus = stopWriter(writer, writerPid);
+		if ((status >= 0) && (writerStatus < 0))
+			status = writerStatus;
+
+		free(writer);
+	}
+
+	if (outBuffers[1])
+		free(outBuffers[1]);
+
+	if (outBuffers[0])
+		free(outBuffers[0]);
 
 	if (deflate->inBuffer)
 		free((void *) deflate->inBuffer);
@@ -447,6 +1012,73 @@ int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
 }
 
 
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+// Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int deflateCompressFileData(deflateState *deflate, FILE *inStream,
+	FILE *outStream, progress *prog)
+{
+	// Compress all of the input stream to the output stream.  Large inputs
+	// are compressed in chunks by a pool of threads.
+
+	int status = 0;
+	unsigned totalBytes = inStream->f.size;
+	int level = deflate->level;
+
+	// Keep the caller's choice of compression level
+	memset(deflate, 0, sizeof(deflateState));
+	deflate->level = level;
+
+	if (prog)
+	{
+		memset((void *) prog, 0, sizeof(progress));
+		prog->numTotal = totalBytes;
+	}
+
+	if (totalBytes > PARALLEL_CHUNK)
+	{
+		status = compressParallel(deflate, inStream, outStream, prog);
+		if (status != ERR_NOCREATE)
+			return (status);
+
+		// Couldn't start any threads.  Do it ourselves.
+		memset(deflate, 0, sizeof(deflateState));
+		deflate->level = level;
+	}
+
+	return (status = compressSerial(deflate, inStream, outStream, prog));
+}
+
+
+int deflateDecompressFileData(deflateState *deflate, FILE *inStream,
+	FILE *outStream, progress *prog)
+{
+	// Decompress from the input stream until the end of the final block,
+	// writing to the output stream, if any
+
+	return (decompressFileData(deflate, inStream, outStream,
+		NULL /* output */, NULL /* data */, prog));
+}
+
+
+int deflateDecompressFileOutput(deflateState *deflate, FILE *inStream,
+	int (*output)(void *, unsigned char *, unsigned), void *data,
+	progress *prog)
+{
+	// Decompress from the input stream until the end of the final block,
+	// passing each buffer of output to the supplied function, rather than
+	// writing it to a file.  Any error it returns stops the decompression.
+
+	return (decompressFileData(deflate, inStream, NULL /* outStream */,
+		output, data, prog));
+}
+
+
 void deflateMakeHuffmanTable(huffmanTable *table, int numCodes,
 	unsigned char *codeLens)
 {
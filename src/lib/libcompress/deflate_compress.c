@@ -128,129 +128,178 @@ static void skipOutputBits(deflateState *state)
 }
 
 
-static inline int addHashNode(deflateState *state, const unsigned char *data)
+// Per-level match finding parameters
+typedef struct {
+	unsigned short goodLength;	// Search less hard beyond this length
+	unsigned short lazyLength;	// Don't look for better matches beyond this
+	unsigned short niceLength;	// Stop searching at this length
+	unsigned short maxChain;	// Maximum number of chain entries to search
+	int lazy;					// Use lazy matching
+
+} compressLevel;
+
+static const compressLevel levels[DEFLATE_MAX_LEVEL + 1] = {
+	// good	lazy	nice	chain	lazy
+	{ 0,	0,		0,		0,		0 },	// (unused)
+	{ 4,	4,		8,		4,		0 },	// 1: fastest
+	{ 4,	5,		16,		8,		0 },
+	{ 4,	6,		32,		32,		0 },
+	{ 4,	4,		16,		16,		1 },
+	{ 8,	16,		32,		32,		1 },
+	{ 8,	16,		128,	128,	1 },	// 6: default
+	{ 8,	32,		128,	256,	1 },
+	{ 32,	128,	258,	1024,	1 },
+	{ 32,	258,	258,	4096,	1 }		// 9: best
+};
+
+// A minimum-length match that's further away than this costs about as much
+// as the literals
+#define TOO_FAR		4096
+
+#define hashString(ptr) \
+	((((ptr)[0] << 10) ^ ((ptr)[1] << 5) ^ (ptr)[2]) & (DEFLATE_HASH_SIZE - 1))
+
+
+static inline unsigned insertString(hashTable *hash,
+	const unsigned char *buffer, unsigned pos)
 {
-	int status = 0;
-	hashNode **start = NULL;
-	hashNode *newNode = NULL;
-	hashNode *nextNode = NULL;
-
-	DEBUGMSG("Add hash node '%02x %02x %02x' offset %d\n", data[0], data[1],
-		data[2], (data - state->byteIn.data));
-
-	if (state->hash.numFreeNodes <= 0)
-	{
-		DEBUGMSG("No free hash nodes\n");
-		return (status = ERR_NOFREE);
-	}
-
-	// Take a new hash node from the list of free nodes
-	newNode = state->hash.freeNodes;
-	state->hash.freeNodes = newNode->next;
-	state->hash.numFreeNodes -= 1;
-
-	// Set up the new node
-	newNode->generation = state->hash.generation;
-	newNode->data = data;
-	newNode->prev = NULL;
+	// Add the 3-byte string at this position to the hash chains, and return
+	// the previous head of its chain
 
-	// Add the node to the appropriate bucket
-	start = &state->hash.buckets[data[0]].sub[data[1]];
-	nextNode = *start;
-	newNode->next = nextNode;
-	if (nextNode)
-		nextNode->prev = newNode;
-	*start = newNode;
+	unsigned *head = &hash->head[hashString(buffer + pos)];
+	unsigned match = *head;
 
-	return (status = 0);
-}
+	hash->prev[pos & (DEFLATE_MAX_DISTANCE - 1)] = match;
+	*head = (pos + 1);
 
-
-static inline void removeHashNode(deflateState *state, int bucket,
-	int subBucket, hashNode *removeNode)
-{
-	hashNode **start = NULL;
-
-	//DEBUGMSG("Remove hash node\n");
-
-	// Remove the node from the appropriate bucket
-	start = &state->hash.buckets[bucket].sub[subBucket];
-	if (*start == removeNode)
-		*start = removeNode->next;
-	else
-		removeNode->prev->next = removeNode->next;
-	if (removeNode->next)
-		removeNode->next->prev = removeNode->prev;
-
-	// Add it back to the list of free nodes
-	removeNode->next = state->hash.freeNodes;
-	state->hash.freeNodes = removeNode;
-	state->hash.numFreeNodes += 1;
+	return (match);
 }
 
 
 static void initHashTable(deflateState *state)
 {
-	unsigned ptrAdjust = 0;
-	hashNode *node = NULL;
-	hashNode *next = NULL;
-	int count1, count2;
-
-	DEBUGMSG("Init hash table\n");
+	unsigned shift = 0;
+	unsigned pos = 0;
+	int count;
 
 	if (!state->inByte)
 	{
 		DEBUGMSG("Start new hash table\n");
 
-		// We're starting at the beginning of the buffer, so initialize
-		// everything in the hash table.
-
+		// We're starting at the beginning of the buffer, so there's no
+		// previous data
 		memset(&state->hash, 0, sizeof(hashTable));
-		state->hash.freeNodes = state->hash.nodeMemory;
-		state->hash.numFreeNodes = DEFLATE_HASH_NODES;
+	}
+	else if (state->inByte < state->hash.byte)
+	{
+		// The caller has moved the most recent data (hopefully the last
+		// DEFLATE_MAX_DISTANCE (32K) bytes) down to the start of the buffer.
+		// Move the positions in the hash chains to match, and forget any
+		// that were moved off the start.
+		shift = (state->hash.byte - state->inByte);
+
+		DEBUGMSG("Adjust hash positions by %u\n", shift);
 
-		for (count1 = 0; count1 < DEFLATE_HASH_NODES; count1 ++)
+		for (count = 0; count < DEFLATE_HASH_SIZE; count ++)
 		{
-			// No need to set the 'prev' link in the free node list
-			if (count1 < (DEFLATE_HASH_NODES - 1))
-				state->hash.freeNodes[count1].next =
-					&state->hash.freeNodes[count1 + 1];
+			state->hash.head[count] = ((state->hash.head[count] > shift)?
+				(state->hash.head[count] - shift) : 0);
+		}
+
+		for (count = 0; count < DEFLATE_MAX_DISTANCE; count ++)
+		{
+			state->hash.prev[count] = ((state->hash.prev[count] > shift)?
+				(state->hash.prev[count] - shift) : 0);
 		}
 	}
-	else
+	else if (!state->hash.byte)
 	{
-		DEBUGMSG("Keep existing hash table\n");
+		// This is a new state, but the caller has put some earlier data (a
+		// 'preset dictionary') before the start of the input.  Add its
+		// strings to the hash chains so that we can find matches in it.
+		DEBUGMSG("Preset dictionary of %u bytes\n",
+			min(state->inByte, DEFLATE_MAX_DISTANCE));
+
+		for (pos = (state->inByte - min(state->inByte, DEFLATE_MAX_DISTANCE));
+			(pos < state->inByte) && ((pos + DEFLATE_MIN_MATCH) <=
+				(state->inByte + state->inBytes)); pos ++)
+		{
+			insertString(&state->hash, state->inBuffer, pos);
+		}
+	}
+}
 
-		// There is previous data in the buffer, so adjust the pointers in the
-		// hash table, and prune any hash nodes that have moved outside our
-		// DEFLATE_MAX_DISTANCE (32k) distance window (more than one generation
-		// ago).
-		if (state->inByte < state->hash.byte)
-			ptrAdjust = (state->hash.byte - state->inByte);
 
-		DEBUGMSG("%sdjust pointers\n", (ptrAdjust? "A" : "Don't a"));
+static int longestMatch(deflateState *state, unsigned pos, unsigned match,
+	int maxLength, int prevLength, unsigned *distance)
+{
+	// Follow the hash chain from 'match', looking for the longest match for
+	// the string at 'pos' that's longer than prevLength.  Returns the length
+	// of the best match, or prevLength if there's nothing better.
+
+	const compressLevel *level = &levels[state->level];
+	const unsigned char *ptr = (state->inBuffer + pos);
+	const unsigned char *candidate = NULL;
+	unsigned chain = level->maxChain;
+	int niceLength = min(level->niceLength, maxLength);
+	int bestLength = max(prevLength, (DEFLATE_MIN_MATCH - 1));
+	int length = 0;
+	unsigned next = 0;
+
+	// If we already have a good match, don't try so hard
+	if (prevLength >= level->goodLength)
+		chain >>= 2;
+
+	while (match && chain--)
+	{
+		candidate = (state->inBuffer + (match - 1));
 
-		state->hash.generation += 1;
+		if ((unsigned)(ptr - candidate) > DEFLATE_MAX_DISTANCE)
+			break;
 
-		for (count1 = 0; count1 < DEFLATE_HASH_BUCKETS; count1 ++)
+		// Check the byte that would make this match better than the best
+		// one first, since that's the one most likely to be different
+		if ((candidate[bestLength] == ptr[bestLength]) &&
+			(candidate[0] == ptr[0]) && (candidate[1] == ptr[1]))
 		{
-			for (count2 = 0; count2 < DEFLATE_HASH_BUCKETS; count2 ++)
-			{
-				node = state->hash.buckets[count1].sub[count2];
+			for (length = 2; (length < maxLength) &&
+				(candidate[length] == ptr[length]); length ++);
 
-				while (node)
-				{
-					next = node->next;
-					if (node->generation < (state->hash.generation - 1))
-						removeHashNode(state, count1, count2, node);
-					else if (ptrAdjust)
-						node->data -= ptrAdjust;
+			if (length > bestLength)
+			{
+				bestLength = length;
+				*distance = (ptr - candidate);
 
-					node = next;
-				}
+				if (length >= niceLength)
+					break;
 			}
 		}
+
+		// Positions further down the chain are always earlier, unless the
+		// window has since wrapped around and re-used the entry
+		next = state->hash.prev[(match - 1) & (DEFLATE_MAX_DISTANCE - 1)];
+		if (next >= match)
+			break;
+
+		match = next;
 	}
+
+	return (bestLength);
+}
+
+
+static inline void outputMatch(deflateState *state, int length,
+	unsigned distance)
+{
+	// Output the length and distance codes
+	state->processed.codes[state->processed.numCodes++] = (0x8000 | length);
+	state->processed.codes[state->processed.numCodes++] = distance;
+}
+
+
+static inline void outputLiteral(deflateState *state, unsigned char data)
+{
+	state->processed.codes[state->processed.numCodes++] = data;
 }
 
 
@@ -258,20 +307,26 @@ static int processInput(deflateState *state)
 {
 	// Examines all of the input data, builds hash chains and searches for
 	// matches, and outputs a combination of literal values and length/distance
-	// (match) values.
+	// (match) values.  At the lower compression levels, we take the first
+	// match we find.  Otherwise, we look to see whether starting the match at
+	// the next byte instead would give a longer one ('lazy' matching).
 
 	int status = 0;
-	const unsigned char *ptr = (state->byteIn.data + state->byteIn.byte);
-	int remainingBytes = state->byteIn.bufferedBytes;
-	int bucket = 0, subBucket = 0;
-	hashNode *searchNode = NULL;
-	hashNode *nextNode = NULL;
-	int nodeMatch = 0;
-	int nodeDistance = 0;
-	int matchLength = 0;
-	int distance = 0;
-
-	DEBUGMSG("Process %d bytes of input data\n", remainingBytes);
+	const compressLevel *level = &levels[state->level];
+	const unsigned char *buffer = state->inBuffer;
+	unsigned pos = ((state->byteIn.data + state->byteIn.byte) - buffer);
+	unsigned end = (pos + state->byteIn.bufferedBytes);
+	unsigned hashHead = 0;
+	int maxLength = 0;
+	int matchLength = (DEFLATE_MIN_MATCH - 1);
+	int prevLength = 0;
+	unsigned distance = 0;
+	unsigned prevDistance = 0;
+	int matchAvailable = 0;
+	unsigned count;
+
+	DEBUGMSG("Process %d bytes of input data at level %d\n",
+		state->byteIn.bufferedBytes, state->level);
 
 	memset(&state->processed, 0, sizeof(processedInput));
 
@@ -279,93 +334,98 @@ static int processInput(deflateState *state)
 	initHashTable(state);
 
 	// Loop through the input
-	while (remainingBytes >= 3)
+	while (pos < end)
 	{
-		// Hash buckets and sub-buckets are indexed by the first two data
-		// bytes, so that we only have to search for a matching third byte.
-		// Thus, it's not a true hashing function at all.  It's done this
-		// way for speed, at the expense of expanded memory usage, to reduce
-		// search iterations and improve performance.
-		bucket = ptr[0];
-		subBucket = ptr[1];
-
-		//DEBUGMSG("Offset %d, search for match for '%02x %02x %02x' in "
-		//	"bucket %d sub %d\n", (ptr - state->byteIn.data), ptr[0], ptr[1],
-		//	ptr[2], bucket, subBucket);
-
-		searchNode = state->hash.buckets[bucket].sub[subBucket];
-		matchLength = 0;
-		distance = 0;
-
-		while (searchNode)
-		{
-			nextNode = searchNode->next;
+		maxLength = min((end - pos), DEFLATE_MAX_MATCH);
+
+		hashHead = 0;
+		if (maxLength >= DEFLATE_MIN_MATCH)
+			hashHead = insertString(&state->hash, buffer, pos);
 
-			if (ptr[2] == searchNode->data[2])
+		if (!level->lazy)
+		{
+			matchLength = 0;
+			if (hashHead)
 			{
-				// We found a hash table match.  Is it within the permissable
-				// distance?
-				nodeDistance = (ptr - searchNode->data);
-				if (nodeDistance <= DEFLATE_MAX_DISTANCE)
-				{
-					// Initially, we've matched 3 bytes.
-					nodeMatch = 3;
+				matchLength = longestMatch(state, pos, hashHead, maxLength,
+					0, &distance);
+			}
 
-					// Continue looking for more matching bytes
-					while ((nodeMatch < min(remainingBytes, 258)) &&
-						(ptr[nodeMatch] == searchNode->data[nodeMatch]))
-					{
-						nodeMatch += 1;
-					}
+			if ((matchLength < DEFLATE_MIN_MATCH) ||
+				((matchLength == DEFLATE_MIN_MATCH) && (distance > TOO_FAR)))
+			{
+				outputLiteral(state, buffer[pos++]);
+				continue;
+			}
 
-					DEBUGMSG("Found hash match of length %d at distance %d\n",
-						nodeMatch, nodeDistance);
+			outputMatch(state, matchLength, distance);
 
-					// Prefer less distant nodes (occur sooner in the bucket
-					// list) by requiring a more distant match to be longer.
-					if (nodeMatch > matchLength)
-					{
-						matchLength = nodeMatch;
-						distance = nodeDistance;
-					}
-				}
-				else
+			// Add the rest of the match's strings to the hash chains, unless
+			// it's a long one and we're in a hurry
+			if (matchLength <= level->lazyLength)
+			{
+				for (count = (pos + 1); (count < (pos + matchLength)) &&
+					((count + DEFLATE_MIN_MATCH) <= end); count ++)
 				{
-					// Out of range; remove it from the table to reduce search
-					// times.
-					removeHashNode(state, bucket, subBucket, searchNode);
+					insertString(&state->hash, buffer, count);
 				}
 			}
 
-			// Look at the next one.
-			searchNode = nextNode;
+			pos += matchLength;
+			continue;
 		}
 
-		// Add the 3 bytes to the hash table
-		status = addHashNode(state, ptr);
-		if (status < 0)
-			return (status);
+		// Lazy matching.  Find the best match at this position, and compare
+		// it with the one from the previous position.
+		prevLength = matchLength;
+		prevDistance = distance;
+		matchLength = (DEFLATE_MIN_MATCH - 1);
 
-		if (matchLength)
+		if (hashHead && (prevLength < level->lazyLength) &&
+			(prevLength < maxLength))
 		{
-			// Output the length and distance codes
-			state->processed.codes[state->processed.numCodes++] =
-				(0x8000 | matchLength);
-			state->processed.codes[state->processed.numCodes++] = distance;
-			ptr += matchLength;
-			remainingBytes -= matchLength;
+			matchLength = longestMatch(state, pos, hashHead, maxLength,
+				prevLength, &distance);
+
+			if ((matchLength == DEFLATE_MIN_MATCH) && (distance > TOO_FAR))
+				matchLength = (DEFLATE_MIN_MATCH - 1);
+		}
+
+		if ((prevLength >= DEFLATE_MIN_MATCH) && (matchLength <= prevLength))
+		{
+			// The previous match was at least as good.  Output it, and add
+			// the rest of its strings to the hash chains.
+			outputMatch(state, prevLength, prevDistance);
+
+			for (count = (pos + 1); (count < (pos - 1 + prevLength)) &&
+				((count + DEFLATE_MIN_MATCH) <= end); count ++)
+			{
+				insertString(&state->hash, buffer, count);
+			}
+
+			pos += (prevLength - 1);
+			matchAvailable = 0;
+			matchLength = (DEFLATE_MIN_MATCH - 1);
 		}
 		else
 		{
-			// Output the current byte as a literal
-			state->processed.codes[state->processed.numCodes++] = *(ptr++);
-			remainingBytes -= 1;
+			// Output the previous byte as a literal, if it's still pending,
+			// and see whether the next byte improves on the current match
+			if (matchAvailable)
+				outputLiteral(state, buffer[pos - 1]);
+
+			matchAvailable = 1;
+			pos += 1;
 		}
 	}
 
-	// Copy the last byte(s) as literals
-	while (remainingBytes--)
-		state->processed.codes[state->processed.numCodes++] = *(ptr++);
+	if (matchAvailable)
+	{
+		if (matchLength >= DEFLATE_MIN_MATCH)
+			outputMatch(state, matchLength, distance);
+		else
+			outputLiteral(state, buffer[pos - 1]);
+	}
 
 	// Add end-of-block (256)
 	state->processed.codes[state->processed.numCodes++] = DEFLATE_CODE_EOB;
@@ -412,6 +472,28 @@ static int copyUncompressedOutputBlock(deflateState *state)
 }
 
 
+static void emptyBlock(deflateState *state, int final)
+{
+	// Output an empty uncompressed block.  This is how we end the stream when
+	// there's no more input, and it also leaves the output aligned on a byte
+	// boundary.
+
+	state->byteIn.bufferedBytes = 0;
+	state->bitOut.byte = 0;
+
+	DEBUGMSG("Final flag: ");
+	writeBitField(state, 1, (state->final = final));
+	DEBUGMSG("\n");
+
+	copyUncompressedOutputBlock(state);
+
+	state->outBytes -= state->bitOut.byte;
+	state->outByte += state->bitOut.byte;
+	state->bitOut.data += state->bitOut.byte;
+	state->bitOut.byte = 0;
+}
+
+
 static void makeStaticHuffmanLitLenTable(deflateState *state)
 {
 	// Construct a table of static Huffman codes
@@ -863,6 +945,26 @@ static int makeCodeLengths(huffmanTree *tree, unsigned short *codeCounts,
 	// Produce the list of code lengths from the list of code counts.
 
 	int status = 0;
+	int usedCodes = 0;
+	int lastCode = 0;
+	int count;
+
+	// A single code doesn't make a tree.  It's encoded using 1 bit (with 1
+	// unused code).
+	for (count = 0; count < numCodeCounts; count ++)
+	{
+		if (codeCounts[count])
+		{
+			usedCodes += 1;
+			lastCode = count;
+		}
+	}
+
+	if (usedCodes == 1)
+	{
+		codeLengths[lastCode] = 1;
+		return (status = 0);
+	}
 
 	// Turn the code counts into a Huffman tree.
 	makeHuffmanTree(tree, codeCounts, numCodeCounts, 1 /* balance */);
@@ -1356,24 +1458,20 @@ int deflateCompress(deflateState *state)
 		goto out;
 	}
 
+	if (!state->level)
+		state->level = DEFLATE_DEFAULT_LEVEL;
+	else
+		state->level = max(DEFLATE_MIN_LEVEL, min(state->level,
+			DEFLATE_MAX_LEVEL));
+
 	// Set up our input and output buffers
 	state->byteIn.data = (state->inBuffer + state->inByte);
 	state->bitOut.data = (state->outBuffer + state->outByte);
 
 	if (!state->inBytes)
-	{
-		// Empty file.  Do it anyway.
-		writeBitField(state, 1, (state->final = 1));
-		copyUncompressedOutputBlock(state);
-		state->outBytes -= state->bitOut.byte;
-		state->outByte += state->bitOut.byte;
-		if (state->bitOut.bit)
-		{
-			skipOutputBits(state);
-			state->outBytes -= 1;
-			state->outByte += 1;
-		}
-	}
+		// Empty file, or the end of one that was a multiple of the block
+		// size.  Do it anyway.
+		emptyBlock(state, 1 /* final */);
 
 	while (state->inBytes)
 	{
@@ -1460,6 +1558,11 @@ int deflateCompress(deflateState *state)
 		state->bitOut.data += state->bitOut.byte;
 	}
 
+	// If the caller wants to be able to append independently-compressed data
+	// to this, finish on a byte boundary
+	if (!state->final && state->flush)
+		emptyBlock(state, 0 /* not final */);
+
 	// Return success
 	status = 0;
 
@@ -52,378 +52,456 @@
 #endif
 
 
-static void readBitField(deflateState *state, int bits, unsigned short *data)
-{
-	// Read bitfield bits, in LSB order.
-
-	int returned = 0;
-	int count;
 
-	*data = 0;
+// Input is read through a bit accumulator the size of a machine word, which
+// is refilled a word at a time wherever possible.  After a refill it holds at
+// least (BUFFER_BITS - 7) bits.
+#define BUFFER_BITS				((int)(sizeof(unsigned long) * 8))
+
+// The fields of the entries in a huffmanDecodeTable
+#define DECODE_SUBTABLE			0x80000000
+#define DECODE_LENGTH(entry)	(((entry) >> 16) & 0xFF)
+#define DECODE_VALUE(entry)		((entry) & 0xFFFF)
+
+// Base values and numbers of extra bits for the length codes (257-287) and
+// the distance codes.  A base of 0 marks a code that's not valid.
+static const unsigned short lengthBase[DEFLATE_LENGTH_CODES] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+	67, 83, 99, 115, 131, 163, 195, 227, 258, 0, 0
+};
+static const unsigned char lengthExtra[DEFLATE_LENGTH_CODES] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+	5, 5, 5, 5, 0, 0, 0
+};
+static const unsigned short distBase[DEFLATE_DIST_CODES] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+	769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0, 0
+};
+static const unsigned char distExtra[DEFLATE_DIST_CODES] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+	11, 11, 12, 12, 13, 13, 0, 0
+};
+
+static const unsigned char codeLenCodeOrder[DEFLATE_CODELEN_CODES] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+static inline void refillBits(bitBufferIn *in)
+{
+	// Top up the bit accumulator.  Past the end of the input we pretend to
+	// read zeros; callers find out that they've overrun by checking the
+	// position afterwards.
 
-	while (bits)
+	if ((in->byte + sizeof(unsigned long)) <= in->bytes)
 	{
-		if (state->bitIn.data[state->bitIn.byte] & (1 << state->bitIn.bit))
-			*data |= (1 << returned);
-
-		bits -=1; returned +=1; state->bitIn.bit += 1;
-
-		if (state->bitIn.bit >= 8)
-		{
-			state->bitIn.byte += 1;
-			state->bitIn.bit = 0;
-		}
+		// Load a whole (unaligned, little-endian) word, and count however
+		// many whole bytes of it fit
+		in->buffer |= (*((const unsigned long *)(in->data + in->byte)) <<
+			in->bufferBits);
+		in->byte += ((BUFFER_BITS - 1 - in->bufferBits) >> 3);
+		in->bufferBits |= (BUFFER_BITS - 8);
 	}
-
-	DEBUGMSG("[");
-	for (count = (returned - 1); count >= 0; count --)
+	else
 	{
-		if (*data & (1 << count))
-			DEBUGMSG("1");
-		else
-			DEBUGMSG("0");
+		while (in->bufferBits <= (BUFFER_BITS - 8))
+		{
+			if (in->byte < in->bytes)
+			{
+				in->buffer |= ((unsigned long) in->data[in->byte] <<
+					in->bufferBits);
+			}
+
+			in->byte += 1;
+			in->bufferBits += 8;
+		}
 	}
-	DEBUGMSG("] ");
 }
 
 
-static void readBits(deflateState *state, int bits, unsigned short *data)
+static inline unsigned getBits(bitBufferIn *in, int bits)
 {
-	// Get Huffman code bits, in MSB order.  This can be called repeatedly with
-	// the same value in 'data' to add more bits to what's already there.
-
-	DEBUGMSG("%dx[", bits);
-	while (bits)
-	{
-		*data <<= 1;
+	// Read a bit field of up to (BUFFER_BITS - 7) bits, in LSB order
 
-		if (state->bitIn.data[state->bitIn.byte] & (1 << state->bitIn.bit))
-		{
-			DEBUGMSG("1");
-			*data |= 1;
-		}
-		else
-		{
-			DEBUGMSG("0");
-		}
+	unsigned data = 0;
 
-		bits -=1; state->bitIn.bit += 1;
+	if (in->bufferBits < bits)
+		refillBits(in);
 
-		if (state->bitIn.bit >= 8)
-		{
-			state->bitIn.byte += 1;
-			state->bitIn.bit = 0;
-		}
-	}
+	data = (in->buffer & ((1UL << bits) - 1));
+	in->buffer >>= bits;
+	in->bufferBits -= bits;
 
-	DEBUGMSG("] ");
+	return (data);
 }
 
 
-static void skipInputBits(deflateState *state)
+static inline unsigned bitPosition(bitBufferIn *in)
 {
-	// Skip the remaining bits of the byte.
+	// Returns the number of input bits consumed so far
 
-	if (state->bitIn.bit)
-	{
-		DEBUGMSG("Skip %d bits\n", (8 - state->bitIn.bit));
-		state->bitIn.byte += 1;
-		state->bitIn.bit = 0;
-	}
+	return ((in->byte << 3) - in->bufferBits);
 }
 
 
-static int copyUncompressedInputBlock(deflateState *state)
+static inline int decodeSymbol(bitBufferIn *in,
+	const huffmanDecodeTable *table)
 {
-	// Given an uncompressed block, copy the data from the input stream to the
-	// output stream.
-
-	int status = 0;
-	unsigned short length = 0;
-	unsigned short nLength = 0;
+	// Decode one Huffman code from the input, and return its symbol.  The
+	// caller makes sure there are at least DEFLATE_MAX_CODE_BITS bits in the
+	// accumulator.
 
-	// Discard the remaining bits of this byte
-	if (state->bitIn.bit)
-		skipInputBits(state);
+	unsigned entry = table->entry[in->buffer & ((1UL << table->bits) - 1)];
 
-	// Get the length value and its complementary value
-	readBitField(state, 16, &length);
-	readBitField(state, 16, &nLength);
-
-	DEBUGMSG("\nUncompressed block of %d bytes\n", length);
+	if (entry & DECODE_SUBTABLE)
+	{
+		in->buffer >>= table->bits;
+		in->bufferBits -= table->bits;
+		entry = table->entry[DECODE_VALUE(entry) + (in->buffer &
+			((1UL << DECODE_LENGTH(entry)) - 1))];
+	}
 
-	if (length != (unsigned short) ~nLength)
+	if (!DECODE_LENGTH(entry))
 	{
-		DEBUGMSG("length (%04x) != ~nLength (%04x)\n", length,
-			(unsigned short) ~nLength);
-		return (status = ERR_BADDATA);
+		DEBUGMSG("Code not recognized\n");
+		return (ERR_BADDATA);
 	}
 
-	// Output the data
-	memcpy((state->byteOut.data + state->byteOut.byte), (state->bitIn.data +
-		state->bitIn.byte), length);
-	state->bitIn.byte += length;
-	state->byteOut.byte += length;
+	in->buffer >>= DECODE_LENGTH(entry);
+	in->bufferBits -= DECODE_LENGTH(entry);
 
-	return (status = 0);
+	return (DECODE_VALUE(entry));
 }
 
 
-static int getLength(deflateState *state, unsigned short code,
-	unsigned short *length)
+static int makeDecodeTable(huffmanDecodeTable *table, int numCodes,
+	const unsigned char *codeLens)
 {
-	// Given a code representing a literal-length alphabet code, read any
-	// applicable extra bits from the stream, and return the length value.
+	// Build the lookup table for a set of canonical Huffman codes, given
+	// their lengths.  Codes of up to table->bits bits are found directly by
+	// the next table->bits bits of input, with an entry for every possible
+	// pattern of the bits that follow.  Longer codes share the primary entry
+	// for their first table->bits bits, which points to a sub-table indexed
+	// by the rest.  Unused entries are 0, and decode as errors.
 
 	int status = 0;
-	int extraBits = 0;
-	unsigned short extraData = 0;
-
-	// Get the 'length' value and/or the number of extra bits, if
-	// applicable
-	extraBits = 0;
-	if ((code >= 257) && (code <= 264))
-		*length = (code - 254);
-	else if ((code >= 265) && (code <= 284))
-		extraBits = (1 + ((code - 265) / 4));
-	else
-		*length = 258;
-
-	if (extraBits)
+	unsigned short lenCounts[DEFLATE_MAX_CODE_BITS + 1];
+	unsigned short nextCode[DEFLATE_MAX_CODE_BITS + 1];
+	int mostBits = 0;
+	int subBits = 0;
+	int left = 1;
+	unsigned nextSub = 0;
+	unsigned code = 0;
+	unsigned reversed = 0;
+	unsigned sub = 0;
+	unsigned index = 0;
+	int len, count, bit;
+
+	memset(lenCounts, 0, sizeof(lenCounts));
+
+	for (count = 0; count < numCodes; count ++)
 	{
-		// Get the extra length bits
-		readBitField(state, extraBits, &extraData);
+		lenCounts[codeLens[count]] += 1;
+		if (codeLens[count] > mostBits)
+			mostBits = codeLens[count];
+	}
 
-		*length = (((((code - 1) & 3) + 4) << extraBits) + 3 + extraData);
+	// Make sure the set of codes isn't over-subscribed.  Incomplete sets are
+	// allowed; the unused codes just stay invalid.
+	for (len = 1; len <= DEFLATE_MAX_CODE_BITS; len ++)
+	{
+		left = ((left << 1) - lenCounts[len]);
+		if (left < 0)
+		{
+			DEBUGMSG("Over-subscribed Huffman code lengths\n");
+			return (status = ERR_BADDATA);
+		}
 	}
 
-	DEBUGMSG("Repeat of length=%d\n", *length);
+	table->bits = max(1, min(mostBits, DEFLATE_DECODE_BITS));
+	subBits = (mostBits - table->bits);
+	nextSub = (1 << table->bits);
 
-	return (status = 0);
-}
+	memset(table->entry, 0, (nextSub * sizeof(unsigned)));
 
+	// The first code of each length
+	lenCounts[0] = 0;
+	for (len = 1; len <= mostBits; len ++)
+		nextCode[len] = code = ((code + lenCounts[len - 1]) << 1);
 
-static int getDistance(deflateState *state, unsigned short code,
-	unsigned short *distance)
-{
-	// Given a code representing a distance alphabet code, read any
-	// applicable extra bits from the stream, and return the distance value.
+	for (count = 0; count < numCodes; count ++)
+	{
+		len = codeLens[count];
+		if (!len)
+			continue;
 
-	int status = 0;
-	int extraBits = 0;
-	unsigned short extraData = 0;
+		// Huffman codes are packed MSB first, but we take bits from the
+		// accumulator LSB first, so the table is indexed by reversed codes
+		code = nextCode[len]++;
+		for (reversed = 0, bit = 0; bit < len; bit ++)
+			reversed |= (((code >> bit) & 1) << (len - 1 - bit));
 
-	// Do we need to read any extra bits?
-	if (code <= 3)
-		*distance = (code + 1);
-	else
-	{
-		// Get the extra distance bits
-		extraBits = (1 + ((code - 4) / 2));
+		if (len <= table->bits)
+		{
+			for (index = reversed; index < (1U << table->bits);
+				index += (1 << len))
+			{
+				table->entry[index] = ((len << 16) | count);
+			}
+		}
+		else
+		{
+			index = (reversed & ((1 << table->bits) - 1));
 
-		readBitField(state, extraBits, &extraData);
+			if (!table->entry[index])
+			{
+				// The first long code with this prefix.  Add a sub-table.
+				table->entry[index] = (DECODE_SUBTABLE | (subBits << 16) |
+					nextSub);
+				memset(&table->entry[nextSub], 0,
+					((1 << subBits) * sizeof(unsigned)));
+				nextSub += (1 << subBits);
+			}
 
-		*distance = (((2 << extraBits) + 1) +
-			(((code - 4) % 2) * (1 << extraBits)) + extraData);
-	}
+			sub = DECODE_VALUE(table->entry[index]);
 
-	DEBUGMSG("Repeat at distance=%d\n", *distance);
+			for (index = (reversed >> table->bits); index < (1U << subBits);
+				index += (1 << (len - table->bits)))
+			{
+				table->entry[sub + index] =
+					(((len - table->bits) << 16) | count);
+			}
+		}
+	}
 
 	return (status = 0);
 }
 
 
-static int repeatBytes(deflateState *state, unsigned short length,
-	unsigned short distance)
+static int copyUncompressedInputBlock(deflateState *state)
 {
+	// Given an uncompressed block, copy the data from the input stream to the
+	// output stream.
+
 	int status = 0;
-	unsigned short doBytes = 0;
+	bitBufferIn *in = &state->bitIn;
+	unsigned position = 0;
+	unsigned length = 0;
+	unsigned nLength = 0;
 
-	if ((distance <= 0) || (distance > (state->outByte + state->byteOut.byte)))
-	{
-		DEBUGMSG("Distance value %d is out of range (%d in buffer)\n",
-			distance, (state->outByte + state->byteOut.byte));
-		return (status = ERR_RANGE);
-	}
+	// Discard the remaining bits of this byte, and go back to reading whole
+	// bytes
+	position = ((bitPosition(in) + 7) >> 3);
+	in->buffer = 0;
+	in->bufferBits = 0;
+	in->byte = position;
 
-	while (length)
-	{
-		// Copy the data from our buffer
+	if ((position + 4) > in->bytes)
+		return (status = ERR_NODATA);
 
-		doBytes = min(length, distance);
+	// Get the length value and its complementary value
+	length = (in->data[position] | (in->data[position + 1] << 8));
+	nLength = (in->data[position + 2] | (in->data[position + 3] << 8));
+	position += 4;
+
+	DEBUGMSG("\nUncompressed block of %u bytes\n", length);
 
-		memcpy((state->byteOut.data + state->byteOut.byte),
-			(state->byteOut.data + (state->byteOut.byte - distance)), doBytes);
+	if (length != (~nLength & 0xFFFF))
+	{
+		DEBUGMSG("length (%04x) != ~nLength (%04x)\n", length,
+			(~nLength & 0xFFFF));
+		return (status = ERR_BADDATA);
+	}
 
-		state->byteOut.byte += doBytes;
-		length -= doBytes;
+	if (((position + length) > in->bytes) ||
+		(length > (state->outBytes - state->byteOut.byte)))
+	{
+		return (status = ERR_NODATA);
 	}
 
+	// Output the data
+	memcpy((state->byteOut.data + state->byteOut.byte), (in->data +
+		position), length);
+	in->byte = (position + length);
+	state->byteOut.byte += length;
+
 	return (status = 0);
 }
 
 
-static int decompressStaticBlock(deflateState *state)
+static inline void repeatBytes(unsigned char *out, unsigned length,
+	unsigned distance, const unsigned char *outEnd)
 {
-	// Decompress a block of data compressed with the 'deflate' algorithm and
-	// static Huffman codes.
+	// Copy 'length' bytes from 'distance' bytes back in the output.  If the
+	// distance is less than the length, the copy overlaps itself, and the
+	// pattern repeats.
 
-	int status = 0;
-	unsigned short data = 0;
-	unsigned short code = 0;
-	unsigned short length = 0;
-	unsigned short distance = 0;
+	const unsigned char *src = (out - distance);
+	unsigned char *end = (out + length);
 
-	// Loop for one compressed data block
-	while (1)
+	if ((distance >= sizeof(unsigned long)) &&
+		((unsigned)(outEnd - end) >= sizeof(unsigned long)))
+	{
+		// Copy a word at a time.  Since the distance is at least a word,
+		// each word we read has already been written in full.  We might
+		// write a few bytes past the end, but there's room, and they'll be
+		// overwritten by whatever comes next.
+		do {
+			*((unsigned long *) out) = *((const unsigned long *) src);
+			out += sizeof(unsigned long);
+			src += sizeof(unsigned long);
+		} while (out < end);
+	}
+	else if (distance == 1)
+	{
+		memset(out, *src, length);
+	}
+	else
 	{
-		// New piece of data
-		data = 0;
+		while (out < end)
+			*out++ = *src++;
+	}
+}
 
-		readBits(state, 7, &data);
 
-		DEBUGMSG("data=%d ", data);
+static int decompressHuffmanBlock(deflateState *state)
+{
+	// Decompress a block of data compressed with the 'deflate' algorithm,
+	// using the current literal-length and distance decode tables.
 
-		// Does this fall into our 7-bit range of values?
-		if (data <= 0x17)
+	int status = 0;
+	bitBufferIn in = state->bitIn;
+	unsigned char *out = (state->byteOut.data + state->byteOut.byte);
+	unsigned char *outEnd = (state->byteOut.data + state->outBytes);
+	int symbol = 0;
+	unsigned length = 0;
+	unsigned distance = 0;
+
+	// Loop for one compressed data block.  The bit accumulator always has
+	// room for a literal-length code plus its extra bits, so we only need
+	// to check once per code.
+	while (1)
+	{
+		if (in.bufferBits < (DEFLATE_MAX_CODE_BITS + 5))
 		{
-			// This is a length-distance pair, or end-of-block.
-			code = (data + DEFLATE_CODE_EOB); // Codes 256-279
-
-			DEBUGMSG("7-bit 0x%02x code=%d\n", data, code);
+			refillBits(&in);
 
-			if (code == DEFLATE_CODE_EOB)
-				// End of block
-				break;
-
-			// Decode the length value
-			status = getLength(state, code, &length);
-			if (status < 0)
-				return (status);
-
-			// Read the 'distance' value
-			code = 0;
-			readBits(state, 5, &code);
+			// Don't keep decoding imaginary zeros forever, if the block
+			// runs past the end of the input
+			if (in.byte > (in.bytes + sizeof(unsigned long)))
+			{
+				status = ERR_NODATA;
+				goto out;
+			}
+		}
 
-			// Decode the distance value
-			status = getDistance(state, code, &distance);
-			if (status < 0)
-				return (status);
+		// Read a literal-length code
+		symbol = decodeSymbol(&in, &state->litLenDecode);
 
-			// Repeat the data
-			status = repeatBytes(state, length, distance);
-			if (status < 0)
-				return (status);
-		}
-		else
+		// Is it a literal or a length?
+		if (symbol < DEFLATE_CODE_EOB)
 		{
-			// Get one more bit
-			readBits(state, 1, &data);
-
-			DEBUGMSG("data=%d ", data);
+			if (symbol < 0)
+			{
+				status = symbol;
+				goto out;
+			}
 
-			// Does this fall into either of our 8-bit ranges of codes?
-			if ((data >= 0x30) && (data <= 0xBF))
+			if (out >= outEnd)
 			{
-				// This is a literal data code
-				code = (data - 0x30); // Codes 0-143
+				status = ERR_NODATA;
+				goto out;
+			}
 
-				if ((code >= 0x20) && (code <= 0x7E))
-					DEBUGMSG("8-bit 0x%02x code=%d (%c)\n", data, code,
-						code);
-				else
-					DEBUGMSG("8-bit 0x%02x code=%d\n", data, code);
+			// This is a literal value; write it to the output
+			*out++ = symbol;
+			continue;
+		}
 
-				// Write it to the output
-				state->byteOut.data[state->byteOut.byte++] = code;
-			}
+		if (symbol == DEFLATE_CODE_EOB)
+			// End of block
+			break;
 
-			else if ((data >= 0xC0) && (data <= 0xC7))
-			{
-				// This is a length-distance pair
-				code = (data += 0x58); // Codes 280-287
+		// Get the length value
+		symbol -= DEFLATE_LITERAL_CODES;
+		if (!lengthBase[symbol])
+		{
+			DEBUGMSG("Invalid length code %d\n", symbol);
+			status = ERR_BADDATA;
+			goto out;
+		}
 
-				DEBUGMSG("8-bit 0x%02x code=%d\n", data, code);
+		length = (lengthBase[symbol] + getBits(&in, lengthExtra[symbol]));
 
-				// Decode the length value
-				status = getLength(state, code, &length);
-				if (status < 0)
-					return (status);
+		// Read the distance code, and get the distance value
+		if (in.bufferBits < DEFLATE_MAX_CODE_BITS)
+			refillBits(&in);
 
-				// Read the 'distance' value
-				code = 0;
-				readBits(state, 5, &code);
+		symbol = decodeSymbol(&in, &state->distDecode);
+		if (symbol < 0)
+		{
+			status = symbol;
+			goto out;
+		}
 
-				// Decode the distance value
-				status = getDistance(state, code, &distance);
-				if (status < 0)
-					return (status);
+		if (!distBase[symbol])
+		{
+			DEBUGMSG("Invalid distance code %d\n", symbol);
+			status = ERR_BADDATA;
+			goto out;
+		}
 
-				// Repeat the data
-				status = repeatBytes(state, length, distance);
-				if (status < 0)
-					return (status);
-			}
+		distance = (distBase[symbol] + getBits(&in, distExtra[symbol]));
 
-			else
-			{
-				// Get one more bit
-				readBits(state, 1, &data);
-
-				DEBUGMSG("data=%d ", data);
-
-				// Does this fall into our 9-bit range of codes?
-				if ((data >= 0x190) && (data <= 0x1FF))
-				{
-					// This is a literal data code
-					code = (data - DEFLATE_CODE_EOB); // Codes 144-255
-
-					DEBUGMSG("9-bit 0x%03x code=%d\n", data, code);
-
-					// Write it to the output
-					state->byteOut.data[state->byteOut.byte++] = code;
-				}
-				else
-				{
-					DEBUGMSG("Invalid data code %03x\n", data);
-					return (status = ERR_BADDATA);
-				}
-			}
+		if (distance > (unsigned)(out - state->outBuffer))
+		{
+			DEBUGMSG("Distance value %u is out of range (%u in buffer)\n",
+				distance, (unsigned)(out - state->outBuffer));
+			status = ERR_RANGE;
+			goto out;
 		}
+
+		if (length > (unsigned)(outEnd - out))
+		{
+			status = ERR_NODATA;
+			goto out;
+		}
+
+		// Repeat the data
+		repeatBytes(out, length, distance, outEnd);
+		out += length;
 	}
 
-	return (status = 0);
+	status = 0;
+
+out:
+	state->bitIn = in;
+	state->byteOut.byte = (out - state->byteOut.data);
+	return (status);
 }
 
 
-static int readHuffmanCode(deflateState *state, huffmanTable *table,
-	unsigned short *code)
+static int makeStaticTables(deflateState *state)
 {
-	// Try to match a Huffman code from the stream, and return the value
+	// Make the decode tables for the fixed Huffman codes
 
 	int status = 0;
-	unsigned short bits = 0;
-	unsigned short data = 0;
+	unsigned char codeLens[DEFLATE_LITLEN_CODES];
 
-	readBits(state, table->leastBits, &data);
+	memset(codeLens, 8, 144);
+	memset((codeLens + 144), 9, (256 - 144));
+	memset((codeLens + 256), 7, (280 - 256));
+	memset((codeLens + 280), 8, (DEFLATE_LITLEN_CODES - 280));
 
-	for (bits = table->leastBits; bits <= table->mostBits; bits ++)
-	{
-		if ((data >= table->len[bits].startCode) &&
-			(data < (table->len[bits].startCode + table->len[bits].numCodes)))
-		{
-			*code = table->ordered[table->len[bits].first +
-				(data - table->len[bits].startCode)]->num;
-			DEBUGMSG("found code %d (%02x)\n", *code, *code);
-			return (status = 0);
-		}
+	status = makeDecodeTable(&state->litLenDecode, DEFLATE_LITLEN_CODES,
+		codeLens);
+	if (status < 0)
+		return (status);
 
-		readBits(state, 1, &data);
-	}
+	memset(codeLens, 5, DEFLATE_DIST_CODES);
 
-	// No match
-	DEBUGMSG("Code not recognized\n");
-	return (status = ERR_NOSUCHENTRY);
+	return (status = makeDecodeTable(&state->distDecode, DEFLATE_DIST_CODES,
+		codeLens));
 }
 
 
@@ -431,141 +509,105 @@ static int readCodeLengths(deflateState *state, int numCodes,
 	unsigned char *codeLens)
 {
 	int status = 0;
-	unsigned short data = 0;
-	unsigned short length = 0;
-	int count1, count2;
+	bitBufferIn *in = &state->bitIn;
+	int symbol = 0;
+	unsigned char value = 0;
+	int repeat = 0;
+	int count;
 
-	for (count1 = 0; count1 < numCodes; )
+	for (count = 0; count < numCodes; )
 	{
-		DEBUGMSG("Read code %d of %d\n", (count1 + 1), numCodes);
+		if (in->bufferBits < (DEFLATE_MAX_CODE_BITS + 7))
+			refillBits(in);
 
-		status = readHuffmanCode(state, &state->codeLenTable, &data);
-		if (status < 0)
-			goto out;
+		symbol = decodeSymbol(in, &state->codeLenDecode);
+		if (symbol < 0)
+			return (status = symbol);
 
-		if (data < 16)
+		if (symbol < 16)
 		{
-			codeLens[count1++] = data;
+			codeLens[count++] = symbol;
+			continue;
 		}
 
-		else if (data == 16)
+		if (symbol == 16)
 		{
 			// Copy the previous code length 3-6 times.  The next 2 bits
 			// indicate repeat length
+			if (!count)
+				return (status = ERR_BADDATA);
 
-			length = 0;
-			readBitField(state, 2, &length);
-
-			length += 3;
-			data = codeLens[count1 - 1];
-
-			DEBUGMSG("Repeat previous value %d times %d-%d=%d\n",
-				length, count1, (count1 + length - 1), data);
-
-			for (count2 = 0; count2 < length; count2 ++)
-				codeLens[count1++] = data;
+			value = codeLens[count - 1];
+			repeat = (getBits(in, 2) + 3);
 		}
-
-		else if (data == 17)
+		else if (symbol == 17)
 		{
 			// Repeat a code length of 0 for 3-10 times.  The next 3 bits
 			// indicate repeat length
-
-			length = 0;
-			readBitField(state, 3, &length);
-
-			length += 3;
-			DEBUGMSG("Repeat 0 %d times %d-%d=0\n", length, count1,
-				(count1 + length - 1));
-
-			for (count2 = 0; count2 < length; count2 ++)
-				codeLens[count1++] = 0;
+			value = 0;
+			repeat = (getBits(in, 3) + 3);
 		}
-
-		else if (data == 18)
+		else
 		{
 			// Repeat a code length of 0 for 11-138 times.  The next 7 bits
 			// indicate repeat length
+			value = 0;
+			repeat = (getBits(in, 7) + 11);
+		}
 
-			length = 0;
-			readBitField(state, 7, &length);
-
-			length += 11;
-			DEBUGMSG("Repeat 0 %d times %d-%d=0\n", length, count1,
-				(count1 + length - 1));
+		DEBUGMSG("Repeat %d %d times %d-%d\n", value, repeat, count,
+			(count + repeat - 1));
 
-			for (count2 = 0; count2 < length; count2 ++)
-				codeLens[count1++] = 0;
+		if ((count + repeat) > numCodes)
+		{
+			DEBUGMSG("Code lengths overflow (%d > %d)\n", (count + repeat),
+				numCodes);
+			return (status = ERR_BADDATA);
 		}
-	}
 
-	status = 0;
+		memset((codeLens + count), value, repeat);
+		count += repeat;
+	}
 
-out:
-	return (status);
+	return (status = 0);
 }
 
 
-static int decompressDynamicBlock(deflateState *state)
+static int makeDynamicTables(deflateState *state)
 {
-	// Decompress a block of data compressed with the 'deflate' algorithm and
-	// dynamic Huffman codes.
+	// Read the code length information at the start of a block compressed
+	// with dynamic Huffman codes, and make the decode tables.
 
 	int status = 0;
-	unsigned short data = 0;
-	unsigned short numLitLenCodes = 0;
-	unsigned short numDistCodes = 0;
-	unsigned short numCodeLenCodes = 0;
-	unsigned char codeLenCodeOrder[DEFLATE_CODELEN_CODES] =
-		{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	unsigned numLitLenCodes = 0;
+	unsigned numDistCodes = 0;
+	unsigned numCodeLenCodes = 0;
 	unsigned char codeLenCodeLens[DEFLATE_CODELEN_CODES];
 	unsigned char comboCodeLens[DEFLATE_LITLEN_CODES + DEFLATE_DIST_CODES];
-	unsigned char *litLenCodeLens = NULL;
-	unsigned char *distCodeLens = NULL;
-	unsigned short length = 0, distance = 0;
-	int count;
+	unsigned count;
 
 	memset(codeLenCodeLens, 0, sizeof(codeLenCodeLens));
-	memset(comboCodeLens, 0, sizeof(comboCodeLens));
 
 	// Get the number of literal-length alphabet codes, the number of distance
-	// codes, and the number of code length codes
-	readBitField(state, 5, &numLitLenCodes);
-	readBitField(state, 5, &numDistCodes);
-	readBitField(state, 4, &numCodeLenCodes);
+	// codes, and the number of code length codes, adjusted according to the
+	// spec
+	numLitLenCodes = (getBits(&state->bitIn, 5) + DEFLATE_LITERAL_CODES);
+	numDistCodes = (getBits(&state->bitIn, 5) + 1);
+	numCodeLenCodes = (getBits(&state->bitIn, 4) + 4);
 
-	// Adjust the numbers according to the spec
-	numLitLenCodes += DEFLATE_LITERAL_CODES;
-	numDistCodes += 1;
-	numCodeLenCodes += 4;
-
-	DEBUGMSG("\nnumLitLenCodes=%d, numDistCodes=%d, numCodeLenCodes=%d\n",
+	DEBUGMSG("\nnumLitLenCodes=%u, numDistCodes=%u, numCodeLenCodes=%u\n",
 		numLitLenCodes, numDistCodes, numCodeLenCodes);
 
 	// Get the code lengths for the code length codes (does that make
 	// sense? ;-)
 	for (count = 0; count < numCodeLenCodes; count ++)
-	{
-		data = 0;
-		readBitField(state, 3, &data);
-
-		codeLenCodeLens[codeLenCodeOrder[count]] = data;
-	}
-
-	DEBUGMSG("\nCode lengths:\n");
-	for (count = 0; count < DEFLATE_CODELEN_CODES; count ++)
-		DEBUGMSG("%d=%d ", codeLenCodeOrder[count],
-			codeLenCodeLens[codeLenCodeOrder[count]]);
-
-	DEBUGMSG("\nReordered:\n");
-	for (count = 0; count < DEFLATE_CODELEN_CODES; count ++)
-		DEBUGMSG("%d=%d ", count, codeLenCodeLens[count]);
-
-	DEBUGMSG("\n");
+		codeLenCodeLens[codeLenCodeOrder[count]] = getBits(&state->bitIn, 3);
 
-	// Make the Huffman table for the code lengths
-	deflateMakeHuffmanTable(&state->codeLenTable, DEFLATE_CODELEN_CODES,
+	// Make the decode table for the code lengths
+	status = makeDecodeTable(&state->codeLenDecode, DEFLATE_CODELEN_CODES,
 		codeLenCodeLens);
+	if (status < 0)
+		return (status);
 
 	// Now we construct the list of code lengths for the literal-length and
 	// distance codes, in a single go
@@ -574,66 +616,14 @@ static int decompressDynamicBlock(deflateState *state)
 	if (status < 0)
 		return (status);
 
-	litLenCodeLens = comboCodeLens;
-
-	// Make the Huffman table for the literal-length alphabet
-	deflateMakeHuffmanTable(&state->litLenTable, numLitLenCodes,
-		litLenCodeLens);
-
-	distCodeLens = ((void *) comboCodeLens + numLitLenCodes);
-
-	// Make the Huffman table for the distance alphabet
-	deflateMakeHuffmanTable(&state->distTable, numDistCodes, distCodeLens);
-
-	// Decompress the data
-	DEBUGMSG("Decompress data\n");
-
-	// Loop for one compressed data block
-	while (1)
-	{
-		// Read a literal-length code
-		status = readHuffmanCode(state, &state->litLenTable, &data);
-		if (status < 0)
-			return (status);
-
-		// Is it a literal or a length?
-		if (data < DEFLATE_CODE_EOB)
-		{
-			// This is a literal value; write it to the output
-			state->byteOut.data[state->byteOut.byte++] = data;
-		}
-
-		else if (data == DEFLATE_CODE_EOB)
-		{
-			// End of block
-			break;
-		}
-
-		else
-		{
-			// Get the length value
-			status = getLength(state, data, &length);
-			if (status < 0)
-				return (status);
-
-			// Read the distance code
-			status = readHuffmanCode(state, &state->distTable, &data);
-			if (status < 0)
-				return (status);
-
-			// Get the distance value
-			status = getDistance(state, data, &distance);
-			if (status < 0)
-				return (status);
-
-			// Repeat the data
-			status = repeatBytes(state, length, distance);
-			if (status < 0)
-				return (status);
-		}
-	}
+	// Make the decode tables for the literal-length and distance alphabets
+	status = makeDecodeTable(&state->litLenDecode, numLitLenCodes,
+		comboCodeLens);
+	if (status < 0)
+		return (status);
 
-	return (status = 0);
+	return (status = makeDecodeTable(&state->distDecode, numDistCodes,
+		(comboCodeLens + numLitLenCodes)));
 }
 
 
@@ -647,8 +637,15 @@ static int decompressDynamicBlock(deflateState *state)
 
 int deflateDecompress(deflateState *state)
 {
+	// Decompress as many whole blocks as there's input and output space for.
+	// A block that runs off the end of the input is left for the next call,
+	// when the caller has supplied more.
+
 	int status = 0;
-	unsigned short method = 0;
+	int blocks = 0;
+	unsigned short final = 0;
+	unsigned method = 0;
+	unsigned position = 0;
 
 	// Check params
 	if (!state || !state->inBuffer || !state->outBuffer)
@@ -665,41 +662,41 @@ int deflateDecompress(deflateState *state)
 	while (!state->final && state->inBytes &&
 		(state->outBytes >= DEFLATE_MAX_OUTBUFFERSIZE))
 	{
+		// Start at the bit where the previous block ended
+		state->bitIn.bytes = state->inBytes;
 		state->bitIn.byte = 0;
+		state->bitIn.buffer = 0;
+		state->bitIn.bufferBits = 0;
 		state->byteOut.byte = 0;
+		getBits(&state->bitIn, state->bitIn.bit);
 
-		// Find out whether this is the final block, by reading the first bit
-		DEBUGMSG("Final flag: ");
-		readBitField(state, 1, &state->final);
-		DEBUGMSG("\n");
+		// Find out whether this is the final block, and get the 2-bit
+		// compression method of the block
+		final = getBits(&state->bitIn, 1);
+		method = getBits(&state->bitIn, 2);
 
-		// Read the 2-bit compression method of the block
-		DEBUGMSG("Compression method: ");
-		readBitField(state, 2, &method);
-		DEBUGMSG("\n");
+		DEBUGMSG("Final flag: %d, compression method: %u\n", final, method);
 
 		if (method == DEFLATE_BTYPE_NONE)
 		{
 			DEBUGMSG("No compression\n");
 			status = copyUncompressedInputBlock(state);
-			if (status < 0)
-				goto out;
 		}
 
 		else if (method == DEFLATE_BTYPE_FIXED)
 		{
 			DEBUGMSG("Static Huffman codes\n");
-			status = decompressStaticBlock(state);
-			if (status < 0)
-				goto out;
+			status = makeStaticTables(state);
+			if (status >= 0)
+				status = decompressHuffmanBlock(state);
 		}
 
 		else if (method == DEFLATE_BTYPE_DYN)
 		{
 			DEBUGMSG("Dynamic Huffman codes\n");
-			status = decompressDynamicBlock(state);
-			if (status < 0)
-				goto out;
+			status = makeDynamicTables(state);
+			if (status >= 0)
+				status = decompressHuffmanBlock(state);
 		}
 
 		else
@@ -709,6 +706,30 @@ int deflateDecompress(deflateState *state)
 			goto out;
 		}
 
+		// If we read past the end of the input, whatever went wrong was
+		// because the block isn't all there
+		position = bitPosition(&state->bitIn);
+		if (position > (state->inBytes << 3))
+			status = ERR_NODATA;
+
+		if (status < 0)
+		{
+			if ((status == ERR_NODATA) && blocks)
+			{
+				// Leave the rest for the next call
+				DEBUGMSG("Incomplete block\n");
+				status = 0;
+				break;
+			}
+
+			goto out;
+		}
+
+		blocks += 1;
+		state->final = final;
+		state->bitIn.byte = (position >> 3);
+		state->bitIn.bit = (position & 7);
+
 		// Calculate the CRC32 of the decompressed data
 		state->crc32Sum = crc32(state->byteOut.data, state->byteOut.byte,
 			&state->crc32Sum);
@@ -723,7 +744,7 @@ int deflateDecompress(deflateState *state)
 			// Discard any remaining bits of the current input byte
 			if (state->bitIn.bit)
 			{
-				skipInputBits(state);
+				state->bitIn.bit = 0;
 				state->inBytes -= 1;
 				state->inByte += 1;
 			}
@@ -188,6 +188,46 @@ out:
 }
 
 
+static int readMemberTrailer(FILE *inStream, deflateState *deflate,
+	const char *name)
+{
+	// Read the CRC32 and decompressed size that follow a member's data, and
+	// check the CRC32 against the one we calculated
+
+	int status = 0;
+	unsigned fileCrc32Sum = 0;
+	unsigned decompressedSize = 0;
+
+	// Read CRC32
+	DEBUGMSG("Reading CRC\n");
+	if (fread(&fileCrc32Sum, sizeof(unsigned), 1, inStream) < 1)
+	{
+		fprintf(stderr, "Error reading CRC\n");
+		return (status = ERR_NODATA);
+	}
+
+	DEBUGMSG("Data CRC32: %08x\n", deflate->crc32Sum);
+	DEBUGMSG("File CRC32: %08x\n", fileCrc32Sum);
+
+	// Read decompressed size
+	DEBUGMSG("Reading decompressed size\n");
+	if (fread(&decompressedSize, sizeof(unsigned), 1, inStream) < 1)
+	{
+		fprintf(stderr, "Error reading decompressed size\n");
+		return (status = ERR_NODATA);
+	}
+
+	DEBUGMSG("Decompressed size: %u\n", decompressedSize);
+
+	// Check that the checksums match
+	if (deflate->crc32Sum != fileCrc32Sum)
+		fprintf(stderr, "%s CRC32 checksum mismatch (expected %08x, got "
+			"%08x)\n", name, fileCrc32Sum, deflate->crc32Sum);
+
+	return (status = 0);
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -197,7 +237,8 @@ out:
 /////////////////////////////////////////////////////////////////////////
 
 int gzipAddMember(FILE *inStream, FILE *outStream, const char *memberName,
-	const char *comment, unsigned modTime, int textFile, progress *prog)
+	const char *comment, unsigned modTime, int textFile, int level,
+	progress *prog)
 {
 	int status = 0;
 	gzipMember member;
@@ -209,7 +250,8 @@ int gzipAddMember(FILE *inStream, FILE *outStream, const char *memberName,
 		goto out;
 	}
 
-	// Check params.  It's OK for name, comment, and prog to be NULL.
+	// Check params.  It's OK for name, comment, and prog to be NULL.  A level
+	// of 0 means the default compression level.
 	if (!inStream || !outStream)
 	{
 		fprintf(stderr, "NULL parameter\n");
@@ -230,6 +272,10 @@ int gzipAddMember(FILE *inStream, FILE *outStream, const char *memberName,
 	if (textFile)
 		member.flags |= GZIP_FLG_FTEXT;
 	member.modTime = modTime;
+	if (level == DEFLATE_MAX_LEVEL)
+		member.extraFlags = GZIP_XFL_MAXCOMP;
+	else if (level == DEFLATE_MIN_LEVEL)
+		member.extraFlags = GZIP_XFL_FASTEST;
 	member.opSys = GZIP_OS_UNIX; // Closest thing available
 
 	// Output the member header
@@ -277,6 +323,7 @@ int gzipAddMember(FILE *inStream, FILE *outStream, const char *memberName,
 	}
 
 	// Compress the data
+	deflate->level = level;
 	status = deflateCompressFileData(deflate, inStream, outStream, prog);
 	if (status < 0)
 		goto out;
@@ -322,10 +369,10 @@ out:
 
 
 int gzipCompressFile(const char *inFileName, const char *outFileName,
-	const char *comment, int append, progress *prog)
+	const char *comment, int append, int level, progress *prog)
 {
 	// Compress a file using the GZIP file format, and the DEFLATE compression
-	// algorithm.
+	// algorithm, at the requested compression level (0 for the default).
 
 	int status = 0;
 	struct stat st;
@@ -403,7 +450,7 @@ int gzipCompressFile(const char *inFileName, const char *outFileName,
 
 	// Add the member
 	status = gzipAddMember(inStream, outStream, inFileName, comment,
-		st.st_mtime, textFile, prog);
+		st.st_mtime, textFile, level, prog);
 
 out:
 	if (outStream)
@@ -516,8 +563,6 @@ int gzipExtractNextMember(FILE *inStream, int memberNum,
 	char constOutFileName[MAX_NAME_LENGTH + 1];
 	FILE *outStream = NULL;
 	deflateState *deflate = NULL;
-	unsigned fileCrc32Sum = 0;
-	unsigned decompressedSize = 0;
 
 	// Check params.  It's OK for outFileName and prog to be NULL.
 	if (!inStream)
@@ -602,36 +647,79 @@ int gzipExtractNextMember(FILE *inStream, int memberNum,
 		goto out;
 	}
 
-	// Read CRC32
-	DEBUGMSG("Reading CRC\n");
-	if (fread(&fileCrc32Sum, sizeof(unsigned), 1, inStream) < 1)
+	status = readMemberTrailer(inStream, deflate, outFileName);
+	if (status < 0)
+		goto out;
+
+	free(deflate);
+	deflate = NULL;
+
+	// Return success
+	status = 1;
+
+out:
+	if (deflate)
+		free(deflate);
+
+	if (info.comment)
+		free(info.comment);
+
+	if (info.name)
+		free(info.name);
+
+	if (status < 0)
+		errno = status;
+
+	return (status);
+}
+
+
+int gzipExtractNextMemberOutput(FILE *inStream,
+	int (*output)(void *, unsigned char *, unsigned), void *data,
+	progress *prog)
+{
+	// Decompress the current member of a GZIP file, passing the data to the
+	// output function rather than writing it to a file.  This lets another
+	// format (such as TAR) be extracted as it's decompressed.
+
+	int status = 0;
+	archiveMemberInfo info;
+	deflateState *deflate = NULL;
+
+	memset(&info, 0, sizeof(archiveMemberInfo));
+
+	// Check params.  It's OK for prog to be NULL.
+	if (!inStream || !output)
 	{
-		fprintf(stderr, "Error reading CRC\n");
-		status = ERR_NODATA;
+		fprintf(stderr, "NULL parameter\n");
+		status = ERR_NULLPARAMETER;
 		goto out;
 	}
 
-	DEBUGMSG("Data CRC32: %08x\n", deflate->crc32Sum);
-	DEBUGMSG("File CRC32: %08x\n", fileCrc32Sum);
+	DEBUGMSG("GZIP extract next member output\n");
 
-	// Read decompressed size
-	DEBUGMSG("Reading decompressed size\n");
-	if (fread(&decompressedSize, sizeof(unsigned), 1, inStream) < 1)
+	status = gzipReadMemberHeader(inStream, &info);
+	if (status <= 0)
+		// Error, or finished
+		goto out;
+
+	deflate = calloc(1, sizeof(deflateState));
+	if (!deflate)
 	{
-		fprintf(stderr, "Error reading decompressed size\n");
-		status = ERR_NODATA;
+		fprintf(stderr, "Memory error\n");
+		status = ERR_MEMORY;
 		goto out;
 	}
 
-	DEBUGMSG("Decompressed size: %u\n", decompressedSize);
-
-	// Check that the checksums match
-	if (deflate->crc32Sum != fileCrc32Sum)
-		fprintf(stderr, "%s CRC32 checksum mismatch (expected %08x, got "
-			"%08x)\n", outFileName, fileCrc32Sum, deflate->crc32Sum);
+	// Decompress the data
+	status = deflateDecompressFileOutput(deflate, inStream, output, data,
+		prog);
+	if (status < 0)
+		goto out;
 
-	free(deflate);
-	deflate = NULL;
+	status = readMemberTrailer(inStream, deflate, inStream->f.name);
+	if (status < 0)
+		goto out;
 
 	// Return success
 	status = 1;
@@ -640,11 +728,7 @@ out:
 	if (deflate)
 		free(deflate);
 
-	if (info.comment)
-		free(info.comment);
-
-	if (info.name)
-		free(info.name);
+	archiveInfoContentsFree(&info);
 
 	if (status < 0)
 		errno = status;
@@ -59,11 +59,12 @@
 /////////////////////////////////////////////////////////////////////////
 
 int archiveAddMember(const char *inFileName, const char *outFileName,
-	int type, const char *comment, progress *prog)
+	int type, const char *comment, int level, progress *prog)
 {
 	// Determine the archive type, and if supported, add the new member to it.
 	// If the archive doesn't exist, create it (we choose the type unless
-	// specified).
+	// specified).  The compression level only applies to compressing archive
+	// types, and 0 means the default.
 
 	int status = 0;
 	file f;
@@ -117,7 +118,7 @@ int archiveAddMember(const char *inFileName, const char *outFileName,
 		if (class.subType & LOADERFILESUBCLASS_GZIP)
 		{
 			status = gzipCompressFile(inFileName, outFileName, comment,
-				1 /* append */, prog);
+				1 /* append */, level, prog);
 		}
 		else if (class.subType & LOADERFILESUBCLASS_TAR)
 		{
@@ -152,7 +153,7 @@ out:
 
 
 int archiveAddRecursive(const char *inFileName, const char *outFileName,
-	int type, const char *comment, progress *prog)
+	int type, const char *comment, int level, progress *prog)
 {
 	// Call archiveAddMember() - recursively if inFileName names a directory
 
@@ -183,7 +184,8 @@ int archiveAddRecursive(const char *inFileName, const char *outFileName,
 		sprintf((char *) prog->statusMessage, "Adding %s", inFileName);
 
 	// Add the member we were passed
-	status = archiveAddMember(inFileName, outFileName, type, comment, prog);
+	status = archiveAddMember(inFileName, outFileName, type, comment, level,
+		prog);
 	if (status < 0)
 		goto out;
 
@@ -214,7 +216,7 @@ int archiveAddRecursive(const char *inFileName, const char *outFileName,
 						"" : "/"), f.name);
 
 					status = archiveAddRecursive(newFileName, outFileName,
-						type, comment, prog);
+						type, comment, level, prog);
 
 					free(newFileName);
 
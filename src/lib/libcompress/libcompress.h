@@ -41,7 +41,13 @@ extern int debugTar;
 int archiveCopyFileData(FILE *, FILE *, unsigned, progress *);
 
 // Exported from deflate.c
+int deflateDecompressFileOutput(deflateState *, FILE *,
+	int (*)(void *, unsigned char *, unsigned), void *, progress *);
 void deflateMakeHuffmanTable(huffmanTable *, int, unsigned char *);
 
+// Exported from gzip.c
+int gzipExtractNextMemberOutput(FILE *,
+	int (*)(void *, unsigned char *, unsigned), void *, progress *);
+
 #endif
 
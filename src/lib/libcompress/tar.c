@@ -51,6 +51,18 @@
 	#define DEBUGMSG(message, arg...) do { } while (0)
 #endif
 
+// The state of a TAR archive that's being extracted as it's decompressed
+typedef struct {
+	tarHeader header;
+	unsigned headerBytes;
+	archiveMemberInfo info;
+	FILE *outStream;
+	unsigned dataBytes;
+	unsigned padBytes;
+	int finished;
+
+} tarStream;
+
 
 static int seekEnd(FILE *outStream)
 {
@@ -124,33 +136,21 @@ static int terminate(FILE *outStream)
 }
 
 
-static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
+static int parseMemberHeader(tarHeader *header, archiveMemberInfo *info)
 {
-	// Read the next member header of a TAR file, and return the relevant
-	// info from it.
+	// Check a TAR member header, and return the relevant info from it.
+	// Returns 0 if it's an empty block, which marks the end of the archive.
 
 	int status = 0;
-	tarHeader header;
 	int prefixLen = 0;
 	int nameLen = 0;
 	int count;
 
-	memset(&header, 0, sizeof(tarHeader));
-
-	DEBUGMSG("Read TAR member header\n");
-
-	// Record where the member starts
-	info->startOffset = ftell(inStream);
-
-	status = fread((void *) &header, sizeof(tarHeader), 1, inStream);
-	if (status < 1)
-		return (status = errno);
-
 	// Look out for an empty block - indicates end of archive (actually 2 of
 	// them)
 	for (count = 0; count < TAR_BLOCKSIZE; count ++)
 	{
-		if (((char *) &header)[count])
+		if (((char *) header)[count])
 			break;
 	}
 
@@ -158,20 +158,17 @@ static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
 	{
 		// Finished, we guess.  No more members.
 		DEBUGMSG("End of TAR archive\n");
-
-		// Try to put the file pointer back to the start of the NULL blocks
-		fseek(inStream, info->startOffset, SEEK_SET);
 		return (status = 0);
 	}
 
-	if (memcmp(header.magic, TAR_MAGIC, sizeof(TAR_MAGIC)) &&
-		memcmp(header.magic, TAR_OLDMAGIC, sizeof(TAR_OLDMAGIC)))
+	if (memcmp(header->magic, TAR_MAGIC, sizeof(TAR_MAGIC)) &&
+		memcmp(header->magic, TAR_OLDMAGIC, sizeof(TAR_OLDMAGIC)))
 	{
 		fprintf(stderr, "Not a valid TAR entry\n");
 		return (status = ERR_BADDATA);
 	}
 
-	if (memberHeaderChecksum(&header) != strtoul(header.checksum, NULL, 8))
+	if (memberHeaderChecksum(header) != strtoul(header->checksum, NULL, 8))
 	{
 		fprintf(stderr, "TAR entry checksum failure\n");
 		return (status = ERR_BADDATA);
@@ -182,22 +179,22 @@ static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
 	// The 'prefix' and 'name' are NULL-terminated -- unless they're full,
 	// in which case they're not.  Bah!
 
-	if (header.prefix[0])
+	if (header->prefix[0])
 	{
-		if (header.prefix[TAR_MAX_PREFIX - 1])
+		if (header->prefix[TAR_MAX_PREFIX - 1])
 			prefixLen = TAR_MAX_PREFIX;
 		else
-			prefixLen = strlen(header.prefix);
+			prefixLen = strlen(header->prefix);
 	}
 
-	if (header.name[TAR_MAX_NAMELEN - 1])
+	if (header->name[TAR_MAX_NAMELEN - 1])
 		nameLen = TAR_MAX_NAMELEN;
 	else
-		nameLen = strlen(header.name);
+		nameLen = strlen(header->name);
 
 	DEBUGMSG("Member name length: %d\n", nameLen);
 
-	info->name = malloc(nameLen + prefixLen + 1);
+	info->name = calloc((nameLen + prefixLen + 1), 1);
 	if (!info->name)
 	{
 		fprintf(stderr, "Error allocating memory\n");
@@ -205,21 +202,21 @@ static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
 		goto out;
 	}
 
-	if (header.prefix[0])
+	if (header->prefix[0])
 	{
-		strncpy(info->name, header.prefix, prefixLen);
+		strncpy(info->name, header->prefix, prefixLen);
 		info->name[prefixLen] = '\0';
-		strncat(info->name, header.name, nameLen);
+		strncat(info->name, header->name, nameLen);
 	}
 	else
 	{
-		strncpy(info->name, header.name, nameLen);
+		strncpy(info->name, header->name, nameLen);
 	}
 
 	DEBUGMSG("Member file name: %s\n", info->name);
 
 	// Directory, link?
-	switch (header.typeFlag)
+	switch (header->typeFlag)
 	{
 		case TAR_TYPEFLAG_DIR:
 			info->mode = (unsigned) dirT;
@@ -235,14 +232,10 @@ static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
 	}
 
 	// Get the modification time
-	info->modTime = strtoul(header.modTime, NULL, 8);
-
-	info->dataOffset = ftell(inStream);
-
-	DEBUGMSG("Member data offset: %u\n", info->dataOffset);
+	info->modTime = strtoul(header->modTime, NULL, 8);
 
 	info->compressedDataSize = info->decompressedDataSize =
-		strtoul(header.size, NULL, 8);
+		strtoul(header->size, NULL, 8);
 
 	DEBUGMSG("Member data size: %u\n", info->compressedDataSize);
 
@@ -270,6 +263,43 @@ out:
 }
 
 
+static int readMemberHeader(FILE *inStream, archiveMemberInfo *info)
+{
+	// Read the next member header of a TAR file, and return the relevant
+	// info from it.
+
+	int status = 0;
+	tarHeader header;
+
+	memset(&header, 0, sizeof(tarHeader));
+
+	DEBUGMSG("Read TAR member header\n");
+
+	// Record where the member starts
+	info->startOffset = ftell(inStream);
+
+	status = fread((void *) &header, sizeof(tarHeader), 1, inStream);
+	if (status < 1)
+		return (status = errno);
+
+	status = parseMemberHeader(&header, info);
+	if (!status)
+	{
+		// Try to put the file pointer back to the start of the NULL blocks
+		fseek(inStream, info->startOffset, SEEK_SET);
+	}
+
+	if (status <= 0)
+		return (status);
+
+	info->dataOffset = ftell(inStream);
+
+	DEBUGMSG("Member data offset: %u\n", info->dataOffset);
+
+	return (status);
+}
+
+
 static int makeDirRecursive(char *path)
 {
 	int status = 0;
@@ -293,6 +323,166 @@ static int makeDirRecursive(char *path)
 }
 
 
+static int createMember(archiveMemberInfo *info, FILE **outStream)
+{
+	// Create the directory, or open the output stream for the file, named
+	// in the member header.  For anything else (e.g. links), *outStream is
+	// left NULL.
+
+	int status = 0;
+	char *destDir = NULL;
+
+	// Create output parent directory, if necessary
+	destDir = dirname(info->name);
+	if (destDir && strcmp(destDir, "."))
+	{
+		DEBUGMSG("TAR make parent directory %s\n", destDir);
+		status = makeDirRecursive(destDir);
+		if (status < 0)
+			goto out;
+	}
+
+	if ((fileType) info->mode == dirT)
+	{
+		DEBUGMSG("TAR make directory %s\n", info->name);
+		status = makeDirRecursive(info->name);
+		if (status < 0)
+			goto out;
+	}
+	else if ((fileType) info->mode == linkT)
+	{
+		// Ignore this for the time being
+		DEBUGMSG("TAR ignoring link %s\n", info->name);
+	}
+	else
+	{
+		// Open output stream
+		DEBUGMSG("TAR create file %s\n", info->name);
+		*outStream = fopen(info->name, "w");
+		if (!*outStream)
+		{
+			fprintf(stderr, "Couldn't open %s\n", info->name);
+			status = ERR_NOCREATE;
+			goto out;
+		}
+	}
+
+	status = 0;
+
+out:
+	if (destDir)
+		free(destDir);
+
+	return (status);
+}
+
+
+static void streamEndMember(tarStream *tar)
+{
+	// Finished with the current member of a streamed archive
+
+	if (tar->outStream)
+	{
+		fclose(tar->outStream);
+		tar->outStream = NULL;
+	}
+
+	archiveInfoContentsFree(&tar->info);
+}
+
+
+static int streamStartMember(tarStream *tar)
+{
+	// We have a complete member header from a streamed archive.  Create the
+	// member, and get ready for its data.
+
+	int status = 0;
+
+	status = parseMemberHeader(&tar->header, &tar->info);
+	if (status <= 0)
+	{
+		if (!status)
+			tar->finished = 1;
+
+		return (status);
+	}
+
+	tar->dataBytes = tar->info.compressedDataSize;
+	tar->padBytes = (tar->info.totalSize - sizeof(tarHeader) -
+		tar->dataBytes);
+
+	status = createMember(&tar->info, &tar->outStream);
+	if (status < 0)
+	{
+		archiveInfoContentsFree(&tar->info);
+		return (status);
+	}
+
+	if (!tar->dataBytes)
+		streamEndMember(tar);
+
+	return (status = 0);
+}
+
+
+static int streamOutput(void *data, unsigned char *buffer, unsigned bytes)
+{
+	// Called with each buffer of decompressed data, while the next one is
+	// being decompressed.  Splits it into member headers, file data, and
+	// padding.
+
+	int status = 0;
+	tarStream *tar = data;
+	unsigned doBytes = 0;
+
+	while (bytes && !tar->finished)
+	{
+		if (tar->dataBytes)
+		{
+			doBytes = min(bytes, tar->dataBytes);
+
+			if (tar->outStream && (fwrite(buffer, 1, doBytes,
+				tar->outStream) < doBytes))
+			{
+				fprintf(stderr, "Error writing %s\n", tar->info.name);
+				return (status = ERR_IO);
+			}
+
+			tar->dataBytes -= doBytes;
+			if (!tar->dataBytes)
+				streamEndMember(tar);
+		}
+		else if (tar->padBytes)
+		{
+			doBytes = min(bytes, tar->padBytes);
+			tar->padBytes -= doBytes;
+		}
+		else
+		{
+			doBytes = min(bytes, (sizeof(tarHeader) - tar->headerBytes));
+
+			memcpy(((unsigned char *) &tar->header + tar->headerBytes),
+				buffer, doBytes);
+			tar->headerBytes += doBytes;
+
+			if (tar->headerBytes >= sizeof(tarHeader))
+			{
+				tar->headerBytes = 0;
+
+				status = streamStartMember(tar);
+				if (status < 0)
+					return (status);
+			}
+		}
+
+		buffer += doBytes;
+		bytes -= doBytes;
+	}
+
+	return (status = 0);
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -534,7 +724,6 @@ int tarExtractNextMember(FILE *inStream, progress *prog)
 
 	int status = 0;
 	archiveMemberInfo info;
-	char *destDir = NULL;
 	FILE *outStream = NULL;
 
 	if (visopsys_in_kernel)
@@ -560,40 +749,12 @@ int tarExtractNextMember(FILE *inStream, progress *prog)
 		// Finished, we guess
 		goto out;
 
-	// Create output parent directory, if necessary
-	destDir = dirname(info.name);
-	if (destDir && strcmp(destDir, "."))
-	{
-		DEBUGMSG("TAR make parent directory %s\n", destDir);
-		status = makeDirRecursive(destDir);
-		if (status < 0)
-			goto out;
-	}
+	status = createMember(&info, &outStream);
+	if (status < 0)
+		goto out;
 
-	if ((fileType) info.mode == dirT)
-	{
-		DEBUGMSG("TAR make directory %s\n", info.name);
-		status = makeDirRecursive(info.name);
-		if (status < 0)
-			goto out;
-	}
-	else if ((fileType) info.mode == linkT)
-	{
-		// Ignore this for the time being
-		DEBUGMSG("TAR ignoring link %s\n", info.name);
-	}
-	else
+	if (outStream)
 	{
-		// Open output stream
-		DEBUGMSG("TAR create file %s\n", info.name);
-		outStream = fopen(info.name, "w");
-		if (!outStream)
-		{
-			fprintf(stderr, "Couldn't open %s\n", info.name);
-			status = ERR_NOCREATE;
-			goto out;
-		}
-
 		if (info.compressedDataSize)
 		{
 			// Copy the data
@@ -616,9 +777,6 @@ int tarExtractNextMember(FILE *inStream, progress *prog)
 	status = 1;
 
 out:
-	if (destDir)
-		free(destDir);
-
 	// Seek to the end of the member
 	fseek(inStream, (info.startOffset + info.totalSize), SEEK_SET);
 
@@ -765,6 +923,82 @@ out:
 }
 
 
+int tarExtractGzip(const char *inFileName, progress *prog)
+{
+	// Extract a GZIP-compressed TAR file, without decompressing it to a
+	// temporary file first.  The members are extracted from each buffer of
+	// decompressed data while the next one is being decompressed.
+
+	int status = 0;
+	FILE *inStream = NULL;
+	tarStream tar;
+
+	memset(&tar, 0, sizeof(tarStream));
+
+	if (visopsys_in_kernel)
+	{
+		status = ERR_BUG;
+		goto out;
+	}
+
+	// Check params.  It's OK for prog to be NULL.
+	if (!inFileName)
+	{
+		fprintf(stderr, "NULL parameter\n");
+		status = ERR_NULLPARAMETER;
+		goto out;
+	}
+
+	DEBUGMSG("TAR extract GZIP %s\n", inFileName);
+
+	inStream = fopen(inFileName, "r");
+	if (!inStream)
+	{
+		fprintf(stderr, "Couldn't open %s\n", inFileName);
+		status = ERR_NOSUCHFILE;
+		goto out;
+	}
+
+	// The TAR data might be split across more than one GZIP member
+	do
+	{
+		status = gzipExtractNextMemberOutput(inStream, &streamOutput,
+			&tar, prog);
+	} while ((status > 0) && !tar.finished);
+
+	if (status < 0)
+		goto out;
+
+	if (tar.headerBytes || tar.dataBytes || tar.padBytes)
+	{
+		fprintf(stderr, "TAR archive %s is truncated\n", inFileName);
+		status = ERR_NODATA;
+		goto out;
+	}
+
+	// Return success
+	status = 0;
+
+out:
+	if (tar.outStream)
+	{
+		// Delete the incomplete output file
+		fclose(tar.outStream);
+		fileDelete(tar.info.name);
+	}
+
+	archiveInfoContentsFree(&tar.info);
+
+	if (inStream)
+		fclose(inStream);
+
+	if (status < 0)
+		errno = status;
+
+	return (status);
+}
+
+
 int tarDeleteMember(const char *inFileName, const char *memberName,
 	int memberIndex, progress *prog)
 {
@@ -22,7 +22,9 @@
 // This is the library for using the HTTP protocol
 
 #include "libhttp.h"
+#include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -82,6 +84,11 @@ const char *unsuppSchemes[] = {
 	NULL
 };
 
+// Connections we keep open, so that more requests to the same servers don't
+// need new ones
+static httpConnection connections[HTTP_MAX_CONNECTIONS];
+static unsigned connectionUses = 0;
+
 #ifdef DEBUG
 	#define DEBUG_OUTMAX	160
 	int debugLibHttp = 0;
@@ -181,43 +188,130 @@ static objectKey openConnection(urlInfo *url)
 }
 
 
-static inline int writeLine(objectKey connection, const char *line)
+static void closeConnection(httpConnection *conn)
 {
-	DEBUGMSG("%s", line);
+	if (conn->key)
+	{
+		DEBUGMSG("Closing connection to %s:%d\n", conn->host, conn->port);
+		networkClose(conn->key);
+	}
+
+	if (conn->host)
+		free(conn->host);
 
-	return (networkWrite(connection, (unsigned char *) line, strlen(line)));
+	memset(conn, 0, sizeof(httpConnection));
 }
 
 
-static int writeRequestGet(objectKey connection, urlInfo *url)
+static int sameServer(urlInfo *url1, urlInfo *url2)
 {
-	int status = 0;
-	char lineBuffer[256];
+	return (url1->host && url2->host && (url1->port == url2->port) &&
+		!strcasecmp(url1->host, url2->host));
+}
 
-	// Compose the request
 
-	DEBUGMSG("Sending request:\n");
+static httpConnection *getConnection(urlInfo *url)
+{
+	// Return an open connection to the URL's server, reusing one that we
+	// already have if possible
 
-	snprintf(lineBuffer, sizeof(lineBuffer), "%s /%s HTTP/1.1\r\n",
-		HTTP_REQUEST_GET, (url->path? url->path : ""));
+	httpConnection *conn = NULL;
+	int count;
 
-	status = writeLine(connection, lineBuffer);
-	if (status < 0)
-		goto out;
+	for (count = 0; count < HTTP_MAX_CONNECTIONS; count ++)
+	{
+		if (connections[count].key && (connections[count].port == url->port)
+			&& !strcasecmp(connections[count].host, url->host))
+		{
+			conn = &connections[count];
 
-	snprintf(lineBuffer, sizeof(lineBuffer), "%s: %s:%d\r\n",
-		HTTP_HEADER_HOST, url->host, url->port);
+			DEBUGMSG("Reusing connection to %s:%d\n", conn->host,
+				conn->port);
 
-	// Add an empty last line
-	strncat(lineBuffer, "\r\n", (sizeof(lineBuffer) - strlen(lineBuffer)));
+			goto out;
+		}
+	}
 
-	status = writeLine(connection, lineBuffer);
-	if (status < 0)
-		goto out;
+	// Use an unused slot, or else close the least recently used connection
+	conn = &connections[0];
+	for (count = 0; count < HTTP_MAX_CONNECTIONS; count ++)
+	{
+		if (!connections[count].key)
+		{
+			conn = &connections[count];
+			break;
+		}
 
-	status = 0;
+		if (connections[count].lastUsed < conn->lastUsed)
+			conn = &connections[count];
+	}
+
+	closeConnection(conn);
+
+	conn->host = strdup(url->host);
+	if (!conn->host)
+	{
+		fprintf(stderr, "Memory error\n");
+		return (conn = NULL);
+	}
+
+	conn->port = url->port;
+
+	conn->key = openConnection(url);
+	if (!conn->key)
+	{
+		closeConnection(conn);
+		return (conn = NULL);
+	}
 
 out:
+	conn->lastUsed = ++connectionUses;
+	return (conn);
+}
+
+
+static int writeRequests(httpConnection *conn, urlInfo *urls[], int numUrls)
+{
+	// Compose GET requests for the URLs, and send them all at once
+
+	int status = 0;
+	char *request = NULL;
+	int size = 0;
+	int len = 0;
+	int count;
+
+	for (count = 0; count < numUrls; count ++)
+	{
+		size += (strlen(urls[count]->host) + 64);
+		if (urls[count]->path)
+			size += strlen(urls[count]->path);
+		if (urls[count]->query)
+			size += strlen(urls[count]->query);
+	}
+
+	request = malloc(size);
+	if (!request)
+	{
+		fprintf(stderr, "Memory error\n");
+		return (status = ERR_MEMORY);
+	}
+
+	for (count = 0; count < numUrls; count ++)
+	{
+		len += snprintf((request + len), (size - len), "%s /%s%s%s %s\r\n"
+			"%s: %s:%d\r\n\r\n", HTTP_REQUEST_GET,
+			(urls[count]->path? urls[count]->path : ""),
+			(urls[count]->query? "?" : ""),
+			(urls[count]->query? urls[count]->query : ""), HTTP_VERSION_11,
+			HTTP_HEADER_HOST, urls[count]->host, urls[count]->port);
+	}
+
+	DEBUGMSG("Sending %d request(s):\n%s", numUrls, request);
+
+	status = networkWrite(conn->key, (unsigned char *) request, len);
+
+	free(request);
+
 	if (status < 0)
 		fprintf(stderr, "Error sending request\n");
 
@@ -225,152 +319,236 @@ out:
 }
 
 
-static int readHeader(objectKey connection, variableList *header,
-	unsigned timeout)
+static int fillBuffer(httpConnection *conn, unsigned timeoutMs)
 {
+	// Make sure there's some unread data in the connection's buffer, waiting
+	// for it to arrive if necessary.  Returns the number of bytes available.
+	// The timeout is for inactivity: it starts again each time we wait.
+
 	int status = 0;
-	char lineBuffer[256];
-	int bufferBytes = 0;
-	char *sep = NULL;
-	int lineLen = 0;
-	int statusLine = 0;
-	char *tmp = NULL;
+	uquad_t timeout = 0;
 
-	DEBUGMSG("Receiving response:\n");
+	if (conn->bufferPos < conn->bufferBytes)
+		return (status = (conn->bufferBytes - conn->bufferPos));
+
+	conn->bufferPos = conn->bufferBytes = 0;
+
+	if (timeoutMs)
+		timeout = (cpuGetMs() + timeoutMs);
 
 	while (!timeout || (cpuGetMs() < timeout))
 	{
-		// Read the header one byte at a time, so we can process complete
-		// lines, and stop when we reach the empty line marking the end of the
-		// header
+		status = networkRead(conn->key, conn->buffer, HTTP_BUFFERSIZE);
+		if (status < 0)
+			return (status);
 
-		if (bufferBytes >= (int)(sizeof(lineBuffer) - 1))
+		if (status)
 		{
-			fprintf(stderr, "Buffer full, no EOL detected\n");
-			status = ERR_BADDATA;
-			break;
+			conn->bufferBytes = status;
+			conn->received += status;
+			return (status);
 		}
 
-		status = networkRead(connection, (unsigned char *)(lineBuffer +
-			bufferBytes), 1);
+		multitaskerYield();
+	}
+
+	return (status = ERR_TIMEOUT);
+}
+
+
+static int readLine(httpConnection *conn, char *lineBuffer, unsigned timeoutMs)
+{
+	// Read a line into the buffer (which is HTTP_MAX_LINE bytes), without
+	// the CRLF at the end.  Returns the length of the line.
+
+	int status = 0;
+	int lineLen = 0;
+	char c = 0;
+
+	while (1)
+	{
+		status = fillBuffer(conn, timeoutMs);
 		if (status < 0)
-		{
-			fprintf(stderr, "Error receiving response header\n");
+			return (status);
+
+		c = conn->buffer[conn->bufferPos++];
+		if (c == '\n')
 			break;
+
+		if (lineLen >= (HTTP_MAX_LINE - 1))
+		{
+			fprintf(stderr, "Buffer full, no EOL detected\n");
+			return (status = ERR_BADDATA);
 		}
 
-		if (!status)
-			continue;
+		lineBuffer[lineLen++] = c;
+	}
 
-		bufferBytes += 1;
-		lineBuffer[bufferBytes] = '\0';
+	if (lineLen && (lineBuffer[lineLen - 1] == '\r'))
+		lineLen -= 1;
 
-		while (bufferBytes && (sep = strstr(lineBuffer, "\r\n")))
-		{
-			lineLen = (sep - lineBuffer);
+	lineBuffer[lineLen] = '\0';
 
-			*sep = '\0';
+	DEBUGMSG("%s\n", lineBuffer);
 
-			DEBUGMSG("%s\n", lineBuffer);
+	return (status = lineLen);
+}
 
-			if (!lineLen)
-			{
-				// Empty line
-				status = 0;
-				goto out;
-			}
 
-			if (!statusLine)
-			{
-				sep = strstr(lineBuffer, " ");
-				if (!sep)
-				{
-					fprintf(stderr, "Syntax error in line '%s'\n",
-						lineBuffer);
-					status = ERR_BADDATA;
-					goto out;
-				}
+static int readHeader(httpConnection *conn, variableList *header,
+	unsigned timeoutMs)
+{
+	int status = 0;
+	char lineBuffer[HTTP_MAX_LINE];
+	char *sep = NULL;
+	int statusLine = 0;
+	char *tmp = NULL;
 
-				*sep = '\0';
+	DEBUGMSG("Receiving response:\n");
 
-				status = variableListSet(header, HTTP_VERSION_VAR,
-					lineBuffer);
-				if (status < 0)
-				{
-					fprintf(stderr, "Error saving line\n");
-					goto out;
-				}
+	while (1)
+	{
+		// Process complete lines, and stop when we reach the empty line
+		// marking the end of the header
 
-				tmp = (sep + 1);
+		status = readLine(conn, lineBuffer, timeoutMs);
+		if (status < 0)
+			break;
 
-				sep = strstr(tmp, " ");
-				if (!sep)
-				{
-					fprintf(stderr, "Syntax error in status line '%s'\n",
-						tmp);
-					status = ERR_BADDATA;
-					goto out;
-				}
+		if (!status)
+		{
+			// Empty line
+			if (statusLine)
+				break;
+			else
+				continue;
+		}
 
-				*sep = '\0';
+		if (!statusLine)
+		{
+			sep = strstr(lineBuffer, " ");
+			if (!sep)
+			{
+				fprintf(stderr, "Syntax error in line '%s'\n", lineBuffer);
+				status = ERR_BADDATA;
+				break;
+			}
 
-				status = variableListSet(header, HTTP_STATUSCODE_VAR, tmp);
-				if (status < 0)
-				{
-					fprintf(stderr, "Error saving line\n");
-					goto out;
-				}
+			*sep = '\0';
 
-				tmp = (sep + 1);
+			status = variableListSet(header, HTTP_VERSION_VAR, lineBuffer);
+			if (status < 0)
+			{
+				fprintf(stderr, "Error saving line\n");
+				break;
+			}
 
-				if (strlen(tmp))
-				{
-					status = variableListSet(header, HTTP_STATUSSTRING_VAR,
-						tmp);
-					if (status < 0)
-					{
-						fprintf(stderr, "Error saving line\n");
-						goto out;
-					}
-				}
+			tmp = (sep + 1);
 
-				statusLine = 1;
+			sep = strstr(tmp, " ");
+			if (!sep)
+			{
+				fprintf(stderr, "Syntax error in status line '%s'\n", tmp);
+				status = ERR_BADDATA;
+				break;
 			}
-			else
+
+			*sep = '\0';
+
+			status = variableListSet(header, HTTP_STATUSCODE_VAR, tmp);
+			if (status < 0)
 			{
-				sep = strstr(lineBuffer, ": ");
-				if (!sep)
-				{
-					fprintf(stderr, "Syntax error in line '%s'\n",
-						lineBuffer);
-					status = ERR_BADDATA;
-					goto out;
-				}
+				fprintf(stderr, "Error saving line\n");
+				break;
+			}
 
-				*sep = '\0';
+			tmp = (sep + 1);
 
-				status = variableListSet(header, lineBuffer, (sep + 2));
+			if (strlen(tmp))
+			{
+				status = variableListSet(header, HTTP_STATUSSTRING_VAR, tmp);
 				if (status < 0)
 				{
 					fprintf(stderr, "Error saving line\n");
-					goto out;
+					break;
 				}
 			}
 
-			lineLen += 2;
+			statusLine = 1;
+		}
+		else
+		{
+			sep = strstr(lineBuffer, ": ");
+			if (!sep)
+			{
+				fprintf(stderr, "Syntax error in line '%s'\n", lineBuffer);
+				status = ERR_BADDATA;
+				break;
+			}
 
-			memmove(lineBuffer, (lineBuffer + lineLen), (bufferBytes -
-				lineLen));
+			*sep = '\0';
 
-			bufferBytes -= lineLen;
+			status = variableListSet(header, lineBuffer, (sep + 2));
+			if (status < 0)
+			{
+				fprintf(stderr, "Error saving line\n");
+				break;
+			}
 		}
 	}
 
-out:
 	return (status);
 }
 
 
+static const char *findHeader(variableList *header, const char *name)
+{
+	// Header field names aren't case-sensitive
+
+	const char *variable = NULL;
+	int count;
+
+	if (variableListGet(header, name))
+		return (variableListGet(header, name));
+
+	for (count = 0; count < header->numVariables; count ++)
+	{
+		variable = variableListGetVariable(header, count);
+		if (variable && !strcasecmp(variable, name))
+			return (variableListGet(header, variable));
+	}
+
+	// Not found
+	return (NULL);
+}
+
+
+static int keepAlive(variableList *header)
+{
+	// Returns 1 if the server will keep the connection open after this
+	// response.  That's the default for HTTP/1.1, unless it says otherwise.
+
+	const char *version = NULL;
+	const char *connection = NULL;
+	int alive = 0;
+
+	version = variableListGet(header, HTTP_VERSION_VAR);
+	if (version && !strcmp(version, HTTP_VERSION_11))
+		alive = 1;
+
+	connection = findHeader(header, HTTP_HEADER_CONNECTION);
+	if (connection)
+	{
+		if (strcasestr(connection, HTTP_CONNECTION_CLOSE))
+			alive = 0;
+		else if (strcasestr(connection, HTTP_CONNECTION_KEEPALIVE))
+			alive = 1;
+	}
+
+	return (alive);
+}
+
+
 static int checkStatus(variableList *header)
 {
 	int status = 0;
@@ -409,27 +587,385 @@ static int checkStatus(variableList *header)
 }
 
 
-static int readContent(objectKey connection, char *content, int len,
-	unsigned timeout)
+static int readContent(httpConnection *conn, int request, int len,
+	httpContentCallback callback, void *data, unsigned timeoutMs)
 {
+	// Pass 'len' bytes of content to the callback (if any) as they arrive.
+	// If 'len' is negative, read until the server closes the connection.
+
 	int status = 0;
-	int read = 0;
+	unsigned bytes = 0;
 
-	while ((read < len) && (!timeout || (cpuGetMs() < timeout)))
+	while (len)
 	{
-		status = networkRead(connection, (unsigned char *)(content + read),
-			(len - read));
+		status = fillBuffer(conn, timeoutMs);
 		if (status < 0)
 		{
+			if ((len < 0) && (status == ERR_IO))
+			{
+				// The connection was closed: that's the end
+				break;
+			}
+
 			fprintf(stderr, "Error receiving content\n");
+			return (status);
+		}
+
+		bytes = status;
+		if (len > 0)
+			bytes = min(bytes, (unsigned) len);
+
+		if (callback)
+		{
+			status = callback(request, (char *)(conn->buffer +
+				conn->bufferPos), bytes, data);
+			if (status < 0)
+				return (status);
+		}
+
+		conn->bufferPos += bytes;
+		if (len > 0)
+			len -= bytes;
+	}
+
+	return (status = 0);
+}
+
+
+static int readChunked(httpConnection *conn, int request,
+	httpContentCallback callback, void *data, unsigned timeoutMs)
+{
+	// Read content sent with "chunked" transfer encoding.  Each chunk is
+	// preceded by a line with its size in hex, and followed by an empty line.
+	// A chunk of size zero marks the end, followed by any trailer fields and
+	// an empty line.
+
+	int status = 0;
+	char lineBuffer[HTTP_MAX_LINE];
+	char *sep = NULL;
+	char *end = NULL;
+	unsigned long chunkLen = 0;
+
+	while (1)
+	{
+		status = readLine(conn, lineBuffer, timeoutMs);
+		if (status < 0)
+			return (status);
+
+		// Ignore any chunk extensions
+		sep = strchr(lineBuffer, ';');
+		if (sep)
+			*sep = '\0';
+
+		chunkLen = strtoul(lineBuffer, &end, 16);
+
+		// Allow spaces and tabs before the end
+		while ((*end == ' ') || (*end == '\t'))
+			end += 1;
+
+		if (!isxdigit(lineBuffer[0]) || *end || (chunkLen > INT_MAX))
+		{
+			fprintf(stderr, "Bad chunk size '%s'\n", lineBuffer);
+			return (status = ERR_BADDATA);
+		}
+
+		if (!chunkLen)
 			break;
+
+		status = readContent(conn, request, (int) chunkLen, callback, data,
+			timeoutMs);
+		if (status < 0)
+			return (status);
+
+		status = readLine(conn, lineBuffer, timeoutMs);
+		if (status < 0)
+			return (status);
+
+		if (status)
+		{
+			fprintf(stderr, "Syntax error after chunk\n");
+			return (status = ERR_BADDATA);
 		}
+	}
 
-		read += status;
-		status = 0;
+	// Skip any trailer fields
+	do {
+		status = readLine(conn, lineBuffer, timeoutMs);
+		if (status < 0)
+			return (status);
+
+	} while (status);
+
+	return (status = 0);
+}
+
+
+static int readResponse(httpConnection *conn, int request,
+	variableList *header, int *result, httpContentCallback callback,
+	void *data, unsigned timeoutMs, int *alive)
+{
+	// Read the response header, and then the content.  The HTTP status goes
+	// in 'result'.  The content of unsuccessful responses is read (and
+	// discarded) too, to keep the connection in step with the requests.
+
+	int status = 0;
+	int statusVal = 0;
+	const char *value = NULL;
+	int len = 0;
+
+	while (1)
+	{
+		status = readHeader(conn, header, timeoutMs);
+		if (status < 0)
+			return (status);
+
+		value = variableListGet(header, HTTP_STATUSCODE_VAR);
+		statusVal = (value? atoi(value) : 0);
+
+		// Interim responses, such as 100 Continue or 103 Early Hints, have
+		// no content, and are followed by the final response to the same
+		// request
+		if (!value || ((statusVal / 100) != 1))
+			break;
+
+		DEBUGMSG("Interim response %d\n", statusVal);
+		variableListClear(header);
 	}
 
-	return (status);
+	*result = checkStatus(header);
+	*alive = keepAlive(header);
+
+	if (*result < 0)
+		callback = NULL;
+
+	if ((statusVal == HTTP_STATUSCODE_NOCONTENT) ||
+		(statusVal == HTTP_STATUSCODE_NOTMODIFIED))
+	{
+		// No content
+		return (status = 0);
+	}
+
+	value = findHeader(header, HTTP_HEADER_TRANSFERENCODING);
+	if (value && strcasestr(value, HTTP_TRANSFERENCODING_CHUNKED))
+	{
+		DEBUGMSG("Chunked content\n");
+		return (status = readChunked(conn, request, callback, data,
+			timeoutMs));
+	}
+
+	value = findHeader(header, HTTP_HEADER_CONTENTLENGTH);
+	if (value)
+	{
+		len = atoi(value);
+
+		DEBUGMSG("Content length = %d\n", len);
+
+		if (len < 0)
+		{
+			fprintf(stderr, "Bad content length %d\n", len);
+			return (status = ERR_BADDATA);
+		}
+
+		return (status = readContent(conn, request, len, callback, data,
+			timeoutMs));
+	}
+
+	// The content ends when the server closes the connection
+	DEBUGMSG("No content length\n");
+	*alive = 0;
+	return (status = readContent(conn, request, -1, callback, data,
+		timeoutMs));
+}
+
+
+static int getUrls(urlInfo *urls[], variableList *headers, int *results,
+	int numUrls, httpContentCallback callback, void *data,
+	unsigned timeoutMs)
+{
+	// Get the URLs in order.  Once we know that a server keeps connections
+	// open, requests for consecutive URLs on it are pipelined: sent together
+	// without waiting, with the responses coming back in the same order.  If
+	// the server closes the connection partway through, the requests that
+	// didn't get responses are sent again on a new connection.
+
+	int status = 0;
+	httpConnection *conn = NULL;
+	int done = 0;
+	int numRequests = 0;
+	int reused = 0;
+	int retried = 0;
+	unsigned received = 0;
+	int alive = 0;
+	int count;
+
+	// Set up all the headers first, so the caller can always destroy them.
+	// Until a response is received, each result is an error.
+	for (count = 0; count < numUrls; count ++)
+	{
+		memset(&headers[count], 0, sizeof(variableList));
+		results[count] = ERR_IO;
+	}
+
+	for (count = 0; count < numUrls; count ++)
+	{
+		status = variableListCreate(&headers[count]);
+		if (status < 0)
+		{
+			fprintf(stderr, "Error allocating response header\n");
+			return (status);
+		}
+	}
+
+	while (done < numUrls)
+	{
+		if (!urls[done]->host)
+		{
+			fprintf(stderr, "No host in URL\n");
+			results[done++] = ERR_INVALID;
+			continue;
+		}
+
+		conn = getConnection(urls[done]);
+		if (!conn)
+		{
+			results[done++] = ERR_NOCONNECTION;
+			continue;
+		}
+
+		// Has this connection been used, and maybe been idle?
+		reused = (conn->responses > 0);
+
+		numRequests = 1;
+		if (reused)
+		{
+			while (((done + numRequests) < numUrls) &&
+				(numRequests < HTTP_MAX_PIPELINE) &&
+				sameServer(urls[done], urls[done + numRequests]))
+			{
+				numRequests += 1;
+			}
+		}
+
+		received = conn->received;
+
+		status = writeRequests(conn, &urls[done], numRequests);
+
+		for (count = 0; (status >= 0) && (count < numRequests); count ++)
+		{
+			received = conn->received;
+
+			status = readResponse(conn, done, &headers[done],
+				&results[done], callback, data, timeoutMs, &alive);
+			if (status < 0)
+				break;
+
+			conn->responses += 1;
+			done += 1;
+			retried = 0;
+
+			if (!alive)
+			{
+				// Any remaining requests will be sent again
+				closeConnection(conn);
+				break;
+			}
+		}
+
+		if (status < 0)
+		{
+			// A server can close a connection that's been idle for a
+			// while.  If nothing came back on a reused connection, try
+			// again with a new one.
+			if (reused && !retried && !count &&
+				(conn->received == received))
+			{
+				DEBUGMSG("Retrying with a new connection\n");
+				retried = 1;
+				variableListClear(&headers[done]);
+			}
+			else
+			{
+				fprintf(stderr, "Error receiving response\n");
+				results[done++] = status;
+				retried = 0;
+			}
+
+			closeConnection(conn);
+
+			if (status == ERR_TIMEOUT)
+			{
+				// Don't wait for the rest either
+				while (done < numUrls)
+					results[done++] = status;
+			}
+		}
+	}
+
+	// Return the first error, if any
+	for (count = 0; count < numUrls; count ++)
+	{
+		if (results[count] < 0)
+			return (status = results[count]);
+	}
+
+	return (status = 0);
+}
+
+
+static int appendContent(int request __attribute__((unused)),
+	const char *content, unsigned len, void *data)
+{
+	// Collect the content into a buffer, sized by the content length (if
+	// known) and grown as necessary
+
+	httpContentBuffer *buffer = data;
+	const char *contentLen = NULL;
+	unsigned newSize = 0;
+	char *newData = NULL;
+
+	if ((buffer->len + len) > buffer->size)
+	{
+		newSize = max((buffer->size * 2), HTTP_BUFFERSIZE);
+
+		if (!buffer->size)
+		{
+			contentLen = findHeader(buffer->header,
+				HTTP_HEADER_CONTENTLENGTH);
+			if (contentLen)
+				newSize = max((unsigned) atoi(contentLen), len);
+		}
+
+		while ((buffer->len + len) > newSize)
+			newSize *= 2;
+
+		newData = realloc(buffer->data, newSize);
+		if (!newData)
+		{
+			fprintf(stderr, "Memory error\n");
+			return (ERR_MEMORY);
+		}
+
+		buffer->data = newData;
+		buffer->size = newSize;
+	}
+
+	memcpy((buffer->data + buffer->len), content, len);
+	buffer->len += len;
+
+	return (0);
+}
+
+
+static int writeFile(int request __attribute__((unused)),
+	const char *content, unsigned len, void *data)
+{
+	if (fwrite(content, 1, len, (FILE *) data) != len)
+	{
+		fprintf(stderr, "Error writing content\n");
+		return (ERR_IO);
+	}
+
+	return (0);
 }
 
 
@@ -705,9 +1241,10 @@ const char *httpUrlSchemeToString(urlScheme scheme)
 int httpGet(urlInfo *url, variableList *header, char **content, int *len,
 	unsigned timeoutMs)
 {
+	// Get the URL, and return all of its content in a new buffer
+
 	int status = 0;
-	uquad_t timeout = 0;
-	objectKey connection = NULL;
+	httpContentBuffer buffer;
 
 	// Check params
 	if (!url || !header || !content || !len)
@@ -716,74 +1253,103 @@ int httpGet(urlInfo *url, variableList *header, char **content, int *len,
 		return (status = ERR_NULLPARAMETER);
 	}
 
-	if (timeoutMs)
-		timeout = (cpuGetMs() + timeoutMs);
-
-	connection = openConnection(url);
-	if (!connection)
-	{
-		status = ERR_NOCONNECTION;
-		goto out;
-	}
+	memset(&buffer, 0, sizeof(httpContentBuffer));
+	buffer.header = header;
 
-	status = writeRequestGet(connection, url);
-	if (status < 0)
-		goto out;
+	status = httpGetStream(url, header, &appendContent, &buffer, timeoutMs);
+	if ((status >= 0) && !buffer.len)
+		status = ERR_NODATA;
 
-	status = variableListCreate(header);
 	if (status < 0)
 	{
-		fprintf(stderr, "Error allocating response header\n");
-		goto out;
+		if (buffer.data)
+			free(buffer.data);
+
+		return (status);
 	}
 
-	status = readHeader(connection, header, timeout);
-	if (status < 0)
-		goto out;
+	*content = buffer.data;
+	*len = buffer.len;
 
-	status = checkStatus(header);
-	if (status < 0)
-		goto out;
+	return (status = 0);
+}
+
+
+int httpGetStream(urlInfo *url, variableList *header,
+	httpContentCallback callback, void *data, unsigned timeoutMs)
+{
+	// Get the URL, passing the content to the callback as it arrives, so
+	// that it doesn't all need to be held in memory
+
+	int result = 0;
 
-	// Get the content length
-	if (!variableListGet(header, HTTP_HEADER_CONTENTLENGTH))
+	// Check params
+	if (!url || !header || !callback)
 	{
-		fprintf(stderr, "No content length\n");
-		goto out;
+		fprintf(stderr, "NULL parameter\n");
+		return (ERR_NULLPARAMETER);
 	}
 
-	*len = atoi(variableListGet(header, HTTP_HEADER_CONTENTLENGTH));
+	return (getUrls(&url, header, &result, 1, callback, data, timeoutMs));
+}
+
 
-	DEBUGMSG("Content length = %d\n", *len);
+int httpGetFile(urlInfo *url, variableList *header, FILE *theStream,
+	unsigned timeoutMs)
+{
+	// Get the URL, writing the content to the stream as it arrives
 
-	if (!*len)
+	// Check params
+	if (!url || !header || !theStream)
 	{
-		status = ERR_NODATA;
-		goto out;
+		fprintf(stderr, "NULL parameter\n");
+		return (ERR_NULLPARAMETER);
 	}
 
-	// Allocate the buffer
-	*content = malloc(*len);
-	if (!*content)
+	return (httpGetStream(url, header, &writeFile, theStream, timeoutMs));
+}
+
+
+int httpGetPipelined(urlInfo *urls[], variableList *headers, int *results,
+	int numUrls, httpContentCallback callback, void *data,
+	unsigned timeoutMs)
+{
+	// Get a number of URLs, passing the content to the callback as it
+	// arrives.  Requests for URLs on the same server share a connection,
+	// and are sent without waiting for each response.  There's a header and
+	// a result (0 or a negative error code) for each one.  Returns the first
+	// error, if any.
+
+	int count;
+
+	// Check params
+	if (!urls || !headers || !results || !callback)
 	{
-		fprintf(stderr, "Memory error\n");
-		status = ERR_MEMORY;
-		goto out;
+		fprintf(stderr, "NULL parameter\n");
+		return (ERR_NULLPARAMETER);
 	}
 
-	status = readContent(connection, *content, *len, timeout);
-	if (status < 0)
+	for (count = 0; count < numUrls; count ++)
 	{
-		free(*content) ; *content = NULL; *len = 0;
-		goto out;
+		if (!urls[count])
+		{
+			fprintf(stderr, "NULL parameter\n");
+			return (ERR_NULLPARAMETER);
+		}
 	}
 
-	status = 0;
+	return (getUrls(urls, headers, results, numUrls, callback, data,
+		timeoutMs));
+}
 
-out:
-	if (connection)
-		networkClose(connection);
 
-	return (status);
+void httpCloseConnections(void)
+{
+	// Close any connections we've been keeping open
+
+	int count;
+
+	for (count = 0; count < HTTP_MAX_CONNECTIONS; count ++)
+		closeConnection(&connections[count]);
 }
 
@@ -25,6 +25,41 @@
 #ifndef _LIBHTTP_H
 #define _LIBHTTP_H
 
+#include <sys/apidefs.h>
+#include <sys/vis.h>
+
+// How many connections to different servers we keep open for reuse
+#define HTTP_MAX_CONNECTIONS	4
+
+// How many requests we send on a connection before waiting for responses
+#define HTTP_MAX_PIPELINE		8
+
+#define HTTP_BUFFERSIZE			4096
+#define HTTP_MAX_LINE			1024
+
+// An open connection to a server, with a buffer for data received from it
+typedef struct {
+	char *host;
+	int port;
+	objectKey key;
+	unsigned lastUsed;
+	int responses;
+	unsigned received;
+	unsigned char buffer[HTTP_BUFFERSIZE];
+	unsigned bufferPos;
+	unsigned bufferBytes;
+
+} httpConnection;
+
+// For collecting the content of a response into a single buffer
+typedef struct {
+	variableList *header;
+	char *data;
+	unsigned len;
+	unsigned size;
+
+} httpContentBuffer;
+
 extern int debugLibHttp;
 
 #endif
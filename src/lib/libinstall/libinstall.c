@@ -1802,7 +1802,7 @@ int installArchiveCreate(installInfo *info, char **archiveFileName)
 			}
 #else
 			status = archiveAddMember(archiveName, tarFileName,
-				LOADERFILESUBCLASS_TAR, NULL /* comment */,
+				LOADERFILESUBCLASS_TAR, NULL /* comment */, 0 /* level */,
 				NULL /* progress */);
 			if (status < 0)
 				goto out;
@@ -1822,7 +1822,7 @@ int installArchiveCreate(installInfo *info, char **archiveFileName)
 #else
 	status = archiveAddMember(tarFileName, gzipFileName,
 		LOADERFILESUBCLASS_GZIP, "Visopsys package files",
-		NULL /* progress */);
+		DEFLATE_MAX_LEVEL, NULL /* progress */);
 	if (status < 0)
 		goto out;
 #endif
@@ -1857,13 +1857,13 @@ out:
 
 int installArchiveExtract(const char *archiveFileName, char **filesDirName)
 {
-	// Extract an archive of the package files
+	// Extract an archive of the package files.  The archive is decompressed
+	// and extracted in one pass, without an intermediate TAR file.
 
 	int status = 0;
 	char cwd[512];
-	char *tarFileName = NULL;
 	char *tmpDirName = NULL;
-	char *absTarFileName = NULL;
+	char *absArchiveFileName = NULL;
 
 	memset(cwd, 0, sizeof(cwd));
 
@@ -1885,16 +1885,6 @@ int installArchiveExtract(const char *archiveFileName, char **filesDirName)
 		goto out;
 	}
 
-	// Get a temporary file for unzip-ing
-	status = makeTmpFile(&tarFileName);
-	if (status < 0)
-		goto out;
-
-	status = archiveExtractMember(archiveFileName, NULL /* memberName */,
-		0 /* memberIndex */, tarFileName, NULL /* progress */);
-	if (status < 0)
-		goto out;
-
 	// Get the name for a temporary directory
 	tmpDirName = strdup(INSTALL_TMP_NAMEFORMAT);
 	if (!tmpDirName)
@@ -1914,28 +1904,32 @@ int installArchiveExtract(const char *archiveFileName, char **filesDirName)
 
 	DEBUGMSG("Created temporary directory %s\n", tmpDirName);
 
-	// Change to the temporary directory
-	status = chdir(tmpDirName);
-	if (status < 0)
+	// We need to refer to the archive file from the temporary directory
+
+	absArchiveFileName = calloc((strlen(cwd) + strlen(archiveFileName) + 2),
+		1);
+	if (!absArchiveFileName)
 	{
-		fprintf(stderr, "Couldn't change to temporary directory\n");
-		status = errno;
+		fprintf(stderr, "Memory error\n");
+		status = ERR_MEMORY;
 		goto out;
 	}
 
-	// We need to refer to the tar file in the parent directory
+	if (archiveFileName[0] == '/')
+		strcpy(absArchiveFileName, archiveFileName);
+	else
+		sprintf(absArchiveFileName, "%s/%s", cwd, archiveFileName);
 
-	absTarFileName = calloc((strlen(cwd) + strlen(tarFileName) + 2), 1);
-	if (!absTarFileName)
+	// Change to the temporary directory
+	status = chdir(tmpDirName);
+	if (status < 0)
 	{
-		fprintf(stderr, "Memory error\n");
-		status = ERR_MEMORY;
+		fprintf(stderr, "Couldn't change to temporary directory\n");
+		status = errno;
 		goto out;
 	}
 
-	sprintf(absTarFileName, "%s/%s", cwd, tarFileName);
-
-	status = archiveExtract(absTarFileName, NULL /* progress */);
+	status = tarExtractGzip(absArchiveFileName, NULL /* progress */);
 	if (status < 0)
 		goto out;
 
@@ -1943,18 +1937,12 @@ int installArchiveExtract(const char *archiveFileName, char **filesDirName)
 	status = 0;
 
 out:
-	if (absTarFileName)
-		free(absTarFileName);
+	if (absArchiveFileName)
+		free(absArchiveFileName);
 
 	if (cwd[0])
 		chdir(cwd);
 
-	if (tarFileName)
-	{
-		unlink(tarFileName);
-		free(tarFileName);
-	}
-
 	if (tmpDirName)
 	{
 		if (status < 0)
@@ -0,0 +1,201 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  libpthread.c
+//
+
+// This contains data and functions shared by the parts of the POSIX thread
+// library.  The locks are built on multitaskerFutexWait() and
+// multitaskerFutexWake(): the uncontended cases are handled entirely in user
+// space with atomic instructions, and threads only call the kernel when
+// they have to wait, or wake a waiter.
+
+#include "libpthread.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+pthreadKey pthreadKeys[PTHREAD_KEYS_MAX];
+pthreadSpecific *pthreadSpecificList = NULL;
+pthread_mutex_t pthreadKeysLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+void pthreadMutexWait(pthread_mutex_t *mutex)
+{
+	// The contended path of locking a mutex.  Mark it as having waiters, and
+	// sleep until we're the ones who changed it from unlocked.
+
+	int old = 2;
+
+	processorExchange(mutex->lock, old);
+
+	while (old)
+	{
+		multitaskerFutexWait(&mutex->lock, 2, 0 /* no timeout */);
+
+		old = 2;
+		processorExchange(mutex->lock, old);
+	}
+}
+
+
+int pthreadCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+	const struct timespec *abstime)
+{
+	// Release the mutex, wait for the condition to be signalled (or until
+	// the absolute time 'abstime', if it's not NULL), and then get the
+	// mutex back
+
+	int status = 0;
+	int sequence = cond->sequence;
+	pthread_t owner = mutex->owner;
+	int count = mutex->count;
+	struct timespec now;
+	quad_t timeout = 0;
+	int limited = 0;
+	int add = 1;
+
+	processorAtomicAdd(cond->waiters, add);
+
+	// Let go of the mutex completely, even if it's recursive
+	mutex->count = 1;
+	pthread_mutex_unlock(mutex);
+
+	if (abstime)
+	{
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		timeout = ((((quad_t) abstime->tv_sec - now.tv_sec) * US_PER_SEC) +
+			((abstime->tv_nsec - now.tv_nsec) / NS_PER_US));
+
+		if (timeout <= 0)
+		{
+			status = ETIMEDOUT;
+		}
+		else if (timeout > UINT_MAX)
+		{
+			// We'll have to wake up early.  Spurious wakeups are allowed.
+			timeout = UINT_MAX;
+			limited = 1;
+		}
+	}
+
+	if (!status)
+	{
+		status = multitaskerFutexWait(&cond->sequence, sequence,
+			(unsigned) timeout);
+
+		if ((status == ERR_TIMEOUT) && !limited)
+			status = ETIMEDOUT;
+		else
+			status = 0;
+	}
+
+	add = -1;
+	processorAtomicAdd(cond->waiters, add);
+
+	// Get the mutex back.  Other threads woken up at the same time might be
+	// waiting for it, so it has to be marked that way.
+	pthreadMutexWait(mutex);
+
+	mutex->owner = owner;
+	mutex->count = count;
+
+	return (status);
+}
+
+
+pthreadSpecific *pthreadGetSpecific(pthread_t thread, int create)
+{
+	// Find the thread-specific data of the thread, and optionally create it
+	// if it doesn't exist yet
+
+	pthreadSpecific *specific = NULL;
+
+	pthread_mutex_lock(&pthreadKeysLock);
+
+	for (specific = pthreadSpecificList; specific;
+		specific = specific->next)
+	{
+		if (specific->thread == thread)
+			break;
+	}
+
+	if (!specific && create)
+	{
+		specific = calloc(1, sizeof(pthreadSpecific));
+		if (specific)
+		{
+			specific->thread = thread;
+			specific->next = pthreadSpecificList;
+			pthreadSpecificList = specific;
+		}
+	}
+
+	pthread_mutex_unlock(&pthreadKeysLock);
+
+	return (specific);
+}
+
+
+void pthreadDestroySpecific(void)
+{
+	// Called when a thread exits, to call the destructors of its
+	// thread-specific data values, and free them
+
+	pthread_t self = pthread_self();
+	pthreadSpecific **prev = NULL;
+	pthreadSpecific *specific = NULL;
+	void (*destructor)(void *) = NULL;
+	const void *value = NULL;
+	int count;
+
+	pthread_mutex_lock(&pthreadKeysLock);
+
+	for (prev = &pthreadSpecificList; *prev; prev = &((*prev)->next))
+	{
+		if ((*prev)->thread == self)
+		{
+			specific = *prev;
+			*prev = specific->next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&pthreadKeysLock);
+
+	if (!specific)
+		return;
+
+	for (count = 0; count < PTHREAD_KEYS_MAX; count ++)
+	{
+		destructor = pthreadKeys[count].destructor;
+		value = specific->values[count];
+
+		if (pthreadKeys[count].used && destructor && value)
+		{
+			specific->values[count] = NULL;
+			destructor((void *) value);
+		}
+	}
+
+	free(specific);
+}
+
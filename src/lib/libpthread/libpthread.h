@@ -0,0 +1,57 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  libpthread.h
+//
+
+// This file contains private definitions and structures used by the POSIX
+// thread library.
+
+#ifndef _LIBPTHREAD_H
+#define _LIBPTHREAD_H
+
+#include <pthread.h>
+
+// A thread-specific data key
+typedef struct {
+	int used;
+	void (*destructor)(void *);
+
+} pthreadKey;
+
+// A thread's values for the keys, created the first time it sets one
+typedef struct _pthreadSpecific {
+	pthread_t thread;
+	const void *values[PTHREAD_KEYS_MAX];
+	struct _pthreadSpecific *next;
+
+} pthreadSpecific;
+
+extern pthreadKey pthreadKeys[PTHREAD_KEYS_MAX];
+extern pthreadSpecific *pthreadSpecificList;
+extern pthread_mutex_t pthreadKeysLock;
+
+// Exported from libpthread.c
+void pthreadMutexWait(pthread_mutex_t *);
+int pthreadCondWait(pthread_cond_t *, pthread_mutex_t *,
+	const struct timespec *);
+pthreadSpecific *pthreadGetSpecific(pthread_t, int);
+void pthreadDestroySpecific(void);
+
+#endif
+
@@ -0,0 +1,54 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_cond_init.c
+//
+
+// This is the "pthread_cond_init" function as found in POSIX thread libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_cond_init() function shall initialize the condition
+	// variable referenced by cond with attributes referenced by attr.  If
+	// attr is NULL, the default condition variable attributes shall be used.
+	// Upon successful initialization, the state of the condition variable
+	// shall become initialized.
+	//
+	// If successful, the pthread_cond_init() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+
+	// Check params.  'attr' is allowed to be NULL
+	if (!cond)
+		return (errno = ERR_NULLPARAMETER);
+
+	memset((void *) cond, 0, sizeof(pthread_cond_t));
+
+	// There are no condition variable attributes that we support yet
+	if (attr)
+		return (0);
+
+	return (0);
+}
+
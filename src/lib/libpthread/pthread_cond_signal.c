@@ -0,0 +1,56 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_cond_signal.c
+//
+
+// This is the "pthread_cond_signal" function as found in POSIX thread libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_cond_signal() function shall unblock at least one of the
+	// threads that are blocked on the specified condition variable cond (if
+	// any threads are blocked on cond).
+	//
+	// If successful, the pthread_cond_signal() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+
+	int add = 1;
+
+	// Check params
+	if (!cond)
+		return (errno = ERR_NULLPARAMETER);
+
+	// No need to call the kernel if nobody is waiting
+	if (!cond->waiters)
+		return (0);
+
+	processorAtomicAdd(cond->sequence, add);
+	multitaskerFutexWake(&cond->sequence, 1);
+
+	return (0);
+}
+
@@ -0,0 +1,60 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_cond_timedwait.c
+//
+
+// This is the "pthread_cond_timedwait" function as found in POSIX thread
+// libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+	const struct timespec *abstime)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_cond_timedwait() function shall be equivalent to
+	// pthread_cond_wait(), except that an error is returned if the absolute
+	// time specified by abstime passes (that is, system time equals or
+	// exceeds abstime) before the condition cond is signaled or broadcasted,
+	// or if the absolute time specified by abstime has already been passed
+	// at the time of the call.  When such timeouts occur,
+	// pthread_cond_timedwait() shall nonetheless release and re-acquire the
+	// mutex referenced by mutex.
+	//
+	// The pthread_cond_timedwait() function shall fail if:
+	//
+	// ETIMEDOUT  The time specified by abstime to pthread_cond_timedwait()
+	//	has passed
+	//
+	// EINVAL  The abstime argument specified a nanosecond value less than
+	//	zero or greater than or equal to 1000 million
+
+	// Check params
+	if (!cond || !mutex || !abstime)
+		return (errno = ERR_NULLPARAMETER);
+
+	if ((abstime->tv_nsec < 0) || (abstime->tv_nsec >= NS_PER_SEC))
+		return (errno = EINVAL);
+
+	return (pthreadCondWait(cond, mutex, abstime));
+}
+
@@ -0,0 +1,56 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_cond_wait.c
+//
+
+// This is the "pthread_cond_wait" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_cond_wait() function shall block on a condition variable.
+	// It shall be called with mutex locked by the calling thread or
+	// undefined behavior results.  This function atomically releases mutex
+	// and causes the calling thread to block on the condition variable cond.
+	// Upon successful return, the mutex shall have been locked and shall be
+	// owned by the calling thread.
+	//
+	// When using condition variables there is always a Boolean predicate
+	// involving shared variables associated with each condition wait that
+	// is true if the thread should proceed.  Spurious wakeups from the
+	// pthread_cond_wait() function may occur.
+	//
+	// Except in the case of ETIMEDOUT, all these error checks shall act as
+	// if they were performed immediately at the beginning of processing for
+	// the function.  Upon successful completion, a value of zero shall be
+	// returned; otherwise, an error number shall be returned to indicate the
+	// error.
+
+	// Check params
+	if (!cond || !mutex)
+		return (errno = ERR_NULLPARAMETER);
+
+	return (pthreadCondWait(cond, mutex, NULL /* no timeout */));
+}
+
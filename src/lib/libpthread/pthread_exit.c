@@ -21,7 +21,7 @@
 
 // This is the "pthread_exit" function as found in POSIX thread libraries
 
-#include <pthread.h>
+#include "libpthread.h"
 #include <sys/api.h>
 
 
@@ -39,6 +39,9 @@ void pthread_exit(void *exitCode)
 	// that was used to create it.  The function's return value shall serve as
 	// the thread's exit status.
 
+	// Call the destructors of any thread-specific data
+	pthreadDestroySpecific();
+
 	while (1)
 	{
 		multitaskerTerminate((int) exitCode);
@@ -0,0 +1,51 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_getspecific.c
+//
+
+// This is the "pthread_getspecific" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+void *pthread_getspecific(pthread_key_t key)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_getspecific() function shall return the value currently
+	// bound to the specified key on behalf of the calling thread.
+	//
+	// The pthread_getspecific() function shall return the thread-specific
+	// data value associated with the given key.  If no thread-specific data
+	// value is associated with key, then the value NULL shall be returned.
+	// No errors are returned from pthread_getspecific().
+
+	pthreadSpecific *specific = NULL;
+
+	if ((key < 0) || (key >= PTHREAD_KEYS_MAX) || !pthreadKeys[key].used)
+		return (NULL);
+
+	specific = pthreadGetSpecific(pthread_self(), 0 /* don't create */);
+	if (!specific)
+		return (NULL);
+
+	return ((void *) specific->values[key]);
+}
+
@@ -0,0 +1,92 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_key_create.c
+//
+
+// This is the "pthread_key_create" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+int pthread_key_create(pthread_key_t *key, void (*destructor)(void *))
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_key_create() function shall create a thread-specific data
+	// key visible to all threads in the process.  Although the same key
+	// value may be used by different threads, the values bound to the key
+	// by pthread_setspecific() are maintained on a per-thread basis.  Upon
+	// key creation, the value NULL shall be associated with the new key in
+	// all active threads.
+	//
+	// An optional destructor function may be associated with each key
+	// value.  At thread exit, if a key value has a non-NULL destructor
+	// pointer, and the thread has a non-NULL value associated with that key,
+	// the value of the key is set to NULL, and then the function pointed to
+	// is called with the previously associated value as its sole argument.
+	//
+	// If successful, the pthread_key_create() function shall store the newly
+	// created key value at *key and shall return zero.  Otherwise, an error
+	// number shall be returned to indicate the error.
+	//
+	// The pthread_key_create() function shall fail if:
+	//
+	// EAGAIN  The system lacked the necessary resources to create another
+	//	thread-specific data key, or the system-imposed limit on the total
+	//	number of keys per process {PTHREAD_KEYS_MAX} has been exceeded
+
+	pthreadSpecific *specific = NULL;
+	int count;
+
+	// Check params.  'destructor' is allowed to be NULL
+	if (!key)
+		return (errno = ERR_NULLPARAMETER);
+
+	pthread_mutex_lock(&pthreadKeysLock);
+
+	for (count = 0; count < PTHREAD_KEYS_MAX; count ++)
+	{
+		if (!pthreadKeys[count].used)
+			break;
+	}
+
+	if (count >= PTHREAD_KEYS_MAX)
+	{
+		pthread_mutex_unlock(&pthreadKeysLock);
+		return (errno = EAGAIN);
+	}
+
+	pthreadKeys[count].used = 1;
+	pthreadKeys[count].destructor = destructor;
+
+	// Any old values from a deleted key with the same number go away
+	for (specific = pthreadSpecificList; specific;
+		specific = specific->next)
+	{
+		specific->values[count] = NULL;
+	}
+
+	pthread_mutex_unlock(&pthreadKeysLock);
+
+	*key = count;
+
+	return (0);
+}
+
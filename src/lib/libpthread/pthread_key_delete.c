@@ -0,0 +1,62 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_key_delete.c
+//
+
+// This is the "pthread_key_delete" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+int pthread_key_delete(pthread_key_t key)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_key_delete() function shall delete a thread-specific data
+	// key previously returned by pthread_key_create().  The thread-specific
+	// data values associated with key need not be NULL at the time
+	// pthread_key_delete() is called.  It is the responsibility of the
+	// application to free any application storage or perform any cleanup
+	// actions for data structures related to the deleted key or associated
+	// thread-specific data in any threads; this cleanup can be done either
+	// before or after pthread_key_delete() is called.
+	//
+	// If successful, the pthread_key_delete() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+
+	if ((key < 0) || (key >= PTHREAD_KEYS_MAX))
+		return (errno = EINVAL);
+
+	pthread_mutex_lock(&pthreadKeysLock);
+
+	if (!pthreadKeys[key].used)
+	{
+		pthread_mutex_unlock(&pthreadKeysLock);
+		return (errno = EINVAL);
+	}
+
+	pthreadKeys[key].used = 0;
+	pthreadKeys[key].destructor = NULL;
+
+	pthread_mutex_unlock(&pthreadKeysLock);
+
+	return (0);
+}
+
@@ -0,0 +1,88 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_mutex_lock.c
+//
+
+// This is the "pthread_mutex_lock" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+#include <sys/processor.h>
+
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The mutex object referenced by mutex shall be locked by calling
+	// pthread_mutex_lock().  If the mutex is already locked, the calling
+	// thread shall block until the mutex becomes available.
+	//
+	// If the mutex type is PTHREAD_MUTEX_ERRORCHECK, then error checking
+	// shall be provided.  If a thread attempts to relock a mutex that it has
+	// already locked, an error shall be returned.
+	//
+	// If the mutex type is PTHREAD_MUTEX_RECURSIVE, then the mutex shall
+	// maintain the concept of a lock count.  When a thread successfully
+	// acquires a mutex for the first time, the lock count shall be set to
+	// one.  Every time a thread relocks this mutex, the lock count shall be
+	// incremented by one.
+	//
+	// If successful, the pthread_mutex_lock() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+	//
+	// The pthread_mutex_lock() function shall fail if:
+	//
+	// EDEADLK  The mutex type is PTHREAD_MUTEX_ERRORCHECK and the current
+	//	thread already owns the mutex
+
+	pthread_t self = 0;
+	int old = 0;
+
+	// Check params
+	if (!mutex)
+		return (errno = ERR_NULLPARAMETER);
+
+	// Only the non-normal types need to know who we are
+	if (mutex->type != PTHREAD_MUTEX_NORMAL)
+	{
+		self = pthread_self();
+
+		if (mutex->owner == self)
+		{
+			if (mutex->type == PTHREAD_MUTEX_ERRORCHECK)
+				return (errno = EDEADLK);
+
+			mutex->count += 1;
+			return (0);
+		}
+	}
+
+	// If it's unlocked, this single instruction locks it
+	processorCompareExchange(mutex->lock, old, 1);
+
+	if (old)
+		pthreadMutexWait(mutex);
+
+	mutex->owner = self;
+	mutex->count = 1;
+
+	return (0);
+}
+
@@ -0,0 +1,79 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_mutex_trylock.c
+//
+
+// This is the "pthread_mutex_trylock" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/processor.h>
+
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_mutex_trylock() function shall be equivalent to
+	// pthread_mutex_lock(), except that if the mutex object referenced by
+	// mutex is currently locked (by any thread, including the current
+	// thread), the call shall return immediately.  If the mutex type is
+	// PTHREAD_MUTEX_RECURSIVE and the mutex is currently owned by the
+	// calling thread, the mutex lock count shall be incremented by one and
+	// the pthread_mutex_trylock() function shall immediately return success.
+	//
+	// The pthread_mutex_trylock() function shall return zero if a lock on
+	// the mutex object referenced by mutex is acquired.  Otherwise, an error
+	// number is returned to indicate the error.
+	//
+	// The pthread_mutex_trylock() function shall fail if:
+	//
+	// EBUSY  The mutex could not be acquired because it was already locked
+
+	pthread_t self = 0;
+	int old = 0;
+
+	// Check params
+	if (!mutex)
+		return (errno = ERR_NULLPARAMETER);
+
+	if (mutex->type != PTHREAD_MUTEX_NORMAL)
+	{
+		self = pthread_self();
+
+		if ((mutex->type == PTHREAD_MUTEX_RECURSIVE) &&
+			(mutex->owner == self))
+		{
+			mutex->count += 1;
+			return (0);
+		}
+	}
+
+	processorCompareExchange(mutex->lock, old, 1);
+
+	if (old)
+		return (errno = EBUSY);
+
+	mutex->owner = self;
+	mutex->count = 1;
+
+	return (0);
+}
+
@@ -0,0 +1,84 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_mutex_unlock.c
+//
+
+// This is the "pthread_mutex_unlock" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_mutex_unlock() function shall release the mutex object
+	// referenced by mutex.  If there are threads blocked on the mutex object
+	// referenced by mutex when pthread_mutex_unlock() is called, resulting in
+	// the mutex becoming available, the scheduling policy shall determine
+	// which thread shall acquire the mutex.
+	//
+	// (In the case of PTHREAD_MUTEX_RECURSIVE mutexes, the mutex shall
+	// become available when the count reaches zero and the calling thread no
+	// longer has any locks on this mutex.)
+	//
+	// If successful, the pthread_mutex_unlock() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+	//
+	// The pthread_mutex_unlock() function shall fail if:
+	//
+	// EPERM  The mutex type is PTHREAD_MUTEX_ERRORCHECK or
+	//	PTHREAD_MUTEX_RECURSIVE, and the current thread does not own the mutex
+
+	int old = -1;
+
+	// Check params
+	if (!mutex)
+		return (errno = ERR_NULLPARAMETER);
+
+	if (mutex->type != PTHREAD_MUTEX_NORMAL)
+	{
+		if (!mutex->lock || (mutex->owner != pthread_self()))
+			return (errno = EPERM);
+
+		mutex->count -= 1;
+		if (mutex->count)
+			return (0);
+	}
+
+	mutex->owner = 0;
+	mutex->count = 0;
+
+	// If nobody was waiting, this single instruction unlocks it
+	processorAtomicAdd(mutex->lock, old);
+
+	if (old != 1)
+	{
+		// Somebody might be waiting
+		mutex->lock = 0;
+		multitaskerFutexWake(&mutex->lock, 1);
+	}
+
+	return (0);
+}
+
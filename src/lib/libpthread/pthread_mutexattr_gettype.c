@@ -0,0 +1,49 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_mutexattr_gettype.c
+//
+
+// This is the "pthread_mutexattr_gettype" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+
+
+int pthread_mutexattr_gettype(const pthread_mutexattr_t *attr, int *type)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_mutexattr_gettype() function shall get the mutex type
+	// attribute.
+	//
+	// Upon successful completion, the pthread_mutexattr_gettype() function
+	// shall return zero and store the value of the type attribute of attr
+	// into the object referenced by the type parameter.  Otherwise, an error
+	// shall be returned to indicate the error.
+
+	// Check params
+	if (!attr || !type)
+		return (errno = ERR_NULLPARAMETER);
+
+	*type = attr->type;
+
+	return (0);
+}
+
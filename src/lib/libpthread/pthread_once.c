@@ -0,0 +1,78 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_once.c
+//
+
+// This is the "pthread_once" function as found in POSIX thread libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+// The states of a pthread_once_t
+#define ONCE_NOTRUN		0
+#define ONCE_RUNNING	1
+#define ONCE_DONE		2
+
+
+int pthread_once(pthread_once_t *onceControl, void (*initRoutine)(void))
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The first call to pthread_once() by any thread in a process, with a
+	// given onceControl, shall call the initRoutine with no arguments.
+	// Subsequent calls of pthread_once() with the same onceControl shall not
+	// call the initRoutine.  On return from pthread_once(), initRoutine
+	// shall have completed.  The onceControl parameter shall determine
+	// whether the associated initialization routine has been called.
+	//
+	// Upon successful completion, pthread_once() shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+
+	int old = ONCE_NOTRUN;
+
+	// Check params
+	if (!onceControl || !initRoutine)
+		return (errno = ERR_NULLPARAMETER);
+
+	if (*onceControl == ONCE_DONE)
+		return (0);
+
+	processorCompareExchange(*onceControl, old, ONCE_RUNNING);
+
+	if (old == ONCE_NOTRUN)
+	{
+		// We get to do it
+		initRoutine();
+
+		old = ONCE_DONE;
+		processorExchange(*onceControl, old);
+		multitaskerFutexWake(onceControl, INT_MAX);
+		return (0);
+	}
+
+	// Somebody else is doing it
+	while (*onceControl != ONCE_DONE)
+		multitaskerFutexWait(onceControl, ONCE_RUNNING, 0 /* no timeout */);
+
+	return (0);
+}
+
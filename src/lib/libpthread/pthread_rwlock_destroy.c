@@ -0,0 +1,55 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_rwlock_destroy.c
+//
+
+// This is the "pthread_rwlock_destroy" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+
+
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_rwlock_destroy() function shall destroy the read-write
+	// lock object referenced by rwlock and release any resources used by
+	// the lock.
+	//
+	// If successful, the pthread_rwlock_destroy() function shall return
+	// zero; otherwise, an error number shall be returned to indicate the
+	// error.
+	//
+	// The pthread_rwlock_destroy() function may fail if:
+	//
+	// EBUSY  The implementation has detected an attempt to destroy the
+	//	object referenced by rwlock while it is locked
+
+	// Check params
+	if (!rwlock)
+		return (errno = ERR_NULLPARAMETER);
+
+	if (rwlock->state)
+		return (errno = EBUSY);
+
+	return (0);
+}
+
@@ -0,0 +1,55 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_rwlock_init.c
+//
+
+// This is the "pthread_rwlock_init" function as found in POSIX thread libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock,
+	const pthread_rwlockattr_t *attr)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_rwlock_init() function shall allocate any resources
+	// required to use the read-write lock referenced by rwlock and
+	// initializes the lock to an unlocked state with attributes referenced
+	// by attr.  If attr is NULL, the default read-write lock attributes shall
+	// be used.
+	//
+	// If successful, the pthread_rwlock_init() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+
+	// Check params.  'attr' is allowed to be NULL
+	if (!rwlock)
+		return (errno = ERR_NULLPARAMETER);
+
+	memset((void *) rwlock, 0, sizeof(pthread_rwlock_t));
+
+	// There are no read-write lock attributes that we support yet
+	if (attr)
+		return (0);
+
+	return (0);
+}
+
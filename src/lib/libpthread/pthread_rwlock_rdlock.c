@@ -0,0 +1,82 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_rwlock_rdlock.c
+//
+
+// This is the "pthread_rwlock_rdlock" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_rwlock_rdlock() function shall apply a read lock to the
+	// read-write lock referenced by rwlock.  The calling thread acquires the
+	// read lock if a writer does not hold the lock and there are no writers
+	// blocked on the lock.
+	//
+	// If successful, the pthread_rwlock_rdlock() function shall return
+	// zero; otherwise, an error number shall be returned to indicate the
+	// error.
+
+	int state = 0;
+	int old = 0;
+
+	// Check params
+	if (!rwlock)
+		return (errno = ERR_NULLPARAMETER);
+
+	while (1)
+	{
+		state = old = rwlock->state;
+
+		// We can join the other readers, unless there's a writer, or
+		// somebody is waiting (which is probably a writer).  If there are
+		// waiters but no holders, go ahead; otherwise nobody would wake us.
+		if (!(state & PTHREAD_RWLOCK_WRITER) &&
+			(!(state & PTHREAD_RWLOCK_WAITERS) ||
+				!(state & PTHREAD_RWLOCK_READERS)))
+		{
+			processorCompareExchange(rwlock->state, old, (state + 1));
+			if (old == state)
+				return (0);
+
+			continue;
+		}
+
+		// Say that we're waiting, and wait for it to change
+		if (!(state & PTHREAD_RWLOCK_WAITERS))
+		{
+			processorCompareExchange(rwlock->state, old,
+				(state | PTHREAD_RWLOCK_WAITERS));
+			if (old != state)
+				continue;
+		}
+
+		multitaskerFutexWait(&rwlock->state,
+			(state | PTHREAD_RWLOCK_WAITERS), 0 /* no timeout */);
+	}
+}
+
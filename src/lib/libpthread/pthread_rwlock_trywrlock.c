@@ -0,0 +1,69 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_rwlock_trywrlock.c
+//
+
+// This is the "pthread_rwlock_trywrlock" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/processor.h>
+
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_rwlock_trywrlock() function shall apply a write lock like
+	// the pthread_rwlock_wrlock() function, with the exception that the
+	// function shall fail if any thread currently holds rwlock (for reading
+	// or writing).
+	//
+	// The pthread_rwlock_trywrlock() function shall return zero if the lock
+	// for writing on the read-write lock object referenced by rwlock is
+	// acquired.  Otherwise, an error number shall be returned to indicate
+	// the error.
+	//
+	// The pthread_rwlock_trywrlock() function shall fail if:
+	//
+	// EBUSY  The read-write lock could not be acquired for writing because
+	//	it was already locked for reading or writing
+
+	int state = 0;
+	int old = 0;
+
+	// Check params
+	if (!rwlock)
+		return (errno = ERR_NULLPARAMETER);
+
+	while (1)
+	{
+		state = old = rwlock->state;
+
+		if (state & (PTHREAD_RWLOCK_WRITER | PTHREAD_RWLOCK_READERS))
+			return (errno = EBUSY);
+
+		processorCompareExchange(rwlock->state, old,
+			(state | PTHREAD_RWLOCK_WRITER));
+		if (old == state)
+			return (0);
+	}
+}
+
@@ -0,0 +1,92 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_rwlock_unlock.c
+//
+
+// This is the "pthread_rwlock_unlock" function as found in POSIX thread
+// libraries
+
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/api.h>
+#include <sys/processor.h>
+
+
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_rwlock_unlock() function shall release a lock held on the
+	// read-write lock object referenced by rwlock.  If this function is
+	// called to release a read lock from the read-write lock object and
+	// there are other read locks currently held on this read-write lock
+	// object, the read-write lock object remains in the read locked state.
+	// If this function releases the last read lock for this read-write lock
+	// object, the object shall be put in the unlocked state with no owners.
+	//
+	// If successful, the pthread_rwlock_unlock() function shall return
+	// zero; otherwise, an error number shall be returned to indicate the
+	// error.
+
+	int state = 0;
+	int old = 0;
+
+	// Check params
+	if (!rwlock)
+		return (errno = ERR_NULLPARAMETER);
+
+	while (1)
+	{
+		state = old = rwlock->state;
+
+		if (!(state & (PTHREAD_RWLOCK_WRITER | PTHREAD_RWLOCK_READERS)))
+			return (errno = EPERM);
+
+		if (state & PTHREAD_RWLOCK_WRITER)
+		{
+			// The writer lets everything go
+			processorCompareExchange(rwlock->state, old, 0);
+		}
+		else if ((state & PTHREAD_RWLOCK_READERS) == 1)
+		{
+			// The last reader does too
+			processorCompareExchange(rwlock->state, old, 0);
+		}
+		else
+		{
+			// Other readers still have it
+			processorCompareExchange(rwlock->state, old, (state - 1));
+			if (old == state)
+				return (0);
+
+			continue;
+		}
+
+		if (old == state)
+			break;
+	}
+
+	// Anybody waiting can try again
+	if (state & PTHREAD_RWLOCK_WAITERS)
+		multitaskerFutexWake(&rwlock->state, INT_MAX);
+
+	return (0);
+}
+
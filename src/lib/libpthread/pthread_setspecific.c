@@ -0,0 +1,68 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  pthread_setspecific.c
+//
+
+// This is the "pthread_setspecific" function as found in POSIX thread libraries
+
+#include "libpthread.h"
+#include <errno.h>
+
+
+int pthread_setspecific(pthread_key_t key, const void *value)
+{
+	// Excerpted from the POSIX programming manual:
+	//
+	// The pthread_setspecific() function shall associate a thread-specific
+	// value with a key obtained via a previous call to
+	// pthread_key_create().  Different threads may bind different values to
+	// the same key.
+	//
+	// If successful, the pthread_setspecific() function shall return zero;
+	// otherwise, an error number shall be returned to indicate the error.
+	//
+	// The pthread_setspecific() function shall fail if:
+	//
+	// ENOMEM  Insufficient memory exists to associate the non-NULL value
+	//	with the key
+	//
+	// The pthread_setspecific() function may fail if:
+	//
+	// EINVAL  The key value is invalid
+
+	pthreadSpecific *specific = NULL;
+
+	if ((key < 0) || (key >= PTHREAD_KEYS_MAX) || !pthreadKeys[key].used)
+		return (errno = EINVAL);
+
+	// Don't bother creating anything to store NULL
+	specific = pthreadGetSpecific(pthread_self(), (value != NULL));
+	if (!specific)
+	{
+		if (value)
+			return (errno = ENOMEM);
+
+		return (0);
+	}
+
+	specific->values[key] = value;
+
+	return (0);
+}
+
@@ -30,6 +30,113 @@
 #include "libvis.h"
 
 
+// The list memory holds arrays of 'maxVariables' name offsets, value offsets
+// and name hashes, then an open-addressed hash index of (2 * maxVariables)
+// entries, then the raw string data.  Index entries hold a slot number plus
+// one, so that zero marks an empty entry.  Only offsets are stored, so the
+// memory can be moved or shared as a single block.
+//
+// Unsetting a variable only removes it from the index and marks its slot as
+// deleted.  The deleted slots and their data are squeezed out later, all at
+// once, when more space is needed or when the variables are accessed by
+// number.
+#define HASH_SIZE(list)			((list)->maxVariables * 2)
+#define USED_SLOTS(list)		((list)->numVariables + (list)->freeVariables)
+#define MEMORY_SIZE(vars, data)	(((vars) * VARIABLE_SLOT_SIZE) + (data))
+#define DELETED_SLOT			0xFFFFFFFF
+
+typedef struct {
+	unsigned *variables;
+	unsigned *values;
+	unsigned *hashes;
+	unsigned *index;
+	char *data;
+
+} listRegions;
+
+
+static void getRegions(void *memory, int maxVariables, listRegions *regions)
+{
+	regions->variables = memory;
+	regions->values = (regions->variables + maxVariables);
+	regions->hashes = (regions->values + maxVariables);
+	regions->index = (regions->hashes + maxVariables);
+	regions->data = (char *)(regions->index + (maxVariables * 2));
+}
+
+
+static unsigned hashName(const char *name)
+{
+	// 32-bit FNV-1a hash of a variable name
+
+	unsigned hash = 2166136261U;
+
+	while (*name)
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
+
+	return (hash);
+}
+
+
+static inline unsigned slotBytes(listRegions *regions, int slot)
+{
+	// The number of bytes of data used by the variable name and value in
+	// the slot, including the NULL characters
+
+	return ((regions->values[slot] - regions->variables[slot]) +
+		strlen(regions->data + regions->values[slot]) + 1);
+}
+
+
+static void indexInsert(variableList *list, listRegions *regions, int slot)
+{
+	// Add the slot to the hash index.  The index is never more than half
+	// full, so an empty entry will always be found.
+
+	unsigned mask = (HASH_SIZE(list) - 1);
+	unsigned pos = (regions->hashes[slot] & mask);
+
+	while (regions->index[pos])
+		pos = ((pos + 1) & mask);
+
+	regions->index[pos] = (slot + 1);
+}
+
+
+static void indexRemove(variableList *list, listRegions *regions,
+	unsigned pos)
+{
+	// Remove the index entry at 'pos', and move back any later entries in
+	// the same run which would otherwise become unreachable.  This saves us
+	// from needing 'deleted' markers.
+
+	unsigned mask = (HASH_SIZE(list) - 1);
+	unsigned next = pos;
+	unsigned home = 0;
+
+	while (1)
+	{
+		next = ((next + 1) & mask);
+		if (!regions->index[next])
+			break;
+
+		// The entry at 'next' can fill the gap unless its home position
+		// is cyclically after the gap
+		home = (regions->hashes[regions->index[next] - 1] & mask);
+		if (((next - home) & mask) >= ((next - pos) & mask))
+		{
+			regions->index[pos] = regions->index[next];
+			pos = next;
+		}
+	}
+
+	regions->index[pos] = 0;
+}
+
+
 static int createList(variableList *list, int sys)
 {
 	int status = 0;
@@ -49,8 +156,8 @@ static int createList(variableList *list, int sys)
 	list->memorySize = VARIABLE_INITIAL_MEMORY;
 	list->system = sys;
 
-	// The memory will be the size of pointers for both the variable names and
-	// the values, plus additional memory for raw data
+	// The memory will be the size of the offsets, hashes, and hash index,
+	// plus additional memory for raw data
 	if (list->system)
 		list->memory = memory_get_system(list->memorySize, "variable list");
 	else
@@ -66,17 +173,97 @@ static int createList(variableList *list, int sys)
 }
 
 
-static int expandList(variableList *list)
+static void indexBuild(variableList *list, listRegions *regions)
+{
+	// (Re)build the hash index from the stored hashes
+
+	int count;
+
+	memset(regions->index, 0, (HASH_SIZE(list) * sizeof(unsigned)));
+
+	for (count = 0; count < list->numVariables; count ++)
+		indexInsert(list, regions, count);
+}
+
+
+static void compactList(variableList *list, listRegions *regions)
+{
+	// Squeeze out the deleted slots, and the data space left behind by them.
+	// New variables always go at the end of both the slots and the data, so
+	// the data is in slot order, and everything can be compacted in place.
+
+	unsigned used = 0;
+	unsigned bytes = 0;
+	int slots = 0;
+	int count;
+
+	debug("VariableList compact list");
+
+	for (count = 0; count < USED_SLOTS(list); count ++)
+	{
+		if (regions->variables[count] == DELETED_SLOT)
+			continue;
+
+		bytes = slotBytes(regions, count);
+
+		if (regions->variables[count] != used)
+		{
+			memmove((regions->data + used),
+				(regions->data + regions->variables[count]), bytes);
+		}
+
+		regions->values[slots] = (used + (regions->values[count] -
+			regions->variables[count]));
+		regions->variables[slots] = used;
+		regions->hashes[slots] = regions->hashes[count];
+
+		used += bytes;
+		slots += 1;
+	}
+
+	list->usedData = used;
+	list->freeData = 0;
+
+	// If any slots moved, the index needs to be renumbered
+	if (list->freeVariables)
+	{
+		list->freeVariables = 0;
+		indexBuild(list, regions);
+	}
+}
+
+
+static int expandList(variableList *list, unsigned needData)
 {
-	// Takes the variable list and expands it.
+	// Makes room in the variable list for one more variable, with 'needData'
+	// bytes of name and value.  If compacting will leave enough space, we
+	// do that in place.  Otherwise the list is grown, once, to a big enough
+	// size.
 
 	int status = 0;
-	unsigned *oldVariables, *oldValues, *oldData;
+	listRegions oldRegions, newRegions;
+	unsigned liveData = (list->usedData - list->freeData);
+	int maxVariables = list->maxVariables;
+	unsigned maxData = list->maxData;
 	void *memory = NULL;
-	unsigned *newVariables, *newValues, *newData;
+	unsigned used = 0;
+	int slots = 0;
+	int count;
 
 	debug("VariableList expand list");
 
+	getRegions(list->memory, list->maxVariables, &oldRegions);
+
+	// Compact if at least a quarter of the slots and the data space will
+	// still be free afterwards, so that we don't end up compacting over and
+	// over
+	if ((list->numVariables < (maxVariables - (maxVariables / 4))) &&
+		((liveData + needData) <= (maxData - (maxData / 4))))
+	{
+		compactList(list, &oldRegions);
+		return (status = 0);
+	}
+
 	if (visopsys_in_kernel && !list->system)
 	{
 		// Don't allow a different process to take ownership of the memory
@@ -87,38 +274,49 @@ static int expandList(variableList *list)
 		}
 	}
 
-	// Remember where the old data is
-	oldVariables = list->memory;
-	oldValues = (list->memory + (list->maxVariables * sizeof(unsigned)));
-	oldData = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
-
-	// Double the list size
-	list->maxVariables *= 2;
-	list->maxData *= 2;
-	list->memorySize = ((list->maxVariables * sizeof(unsigned) * 2) +
-		list->maxData);
+	// Double whichever sizes would have been too full to compact, as many
+	// times as necessary, so that a quarter of each is free afterwards
+	while (list->numVariables >= (maxVariables - (maxVariables / 4)))
+		maxVariables *= 2;
+	while ((liveData + needData) > (maxData - (maxData / 4)))
+		maxData *= 2;
 
 	// Get new memory
 	if (list->system)
-		memory = memory_get_system(list->memorySize, "variable list");
+	{
+		memory = memory_get_system(MEMORY_SIZE(maxVariables, maxData),
+			"variable list");
+	}
 	else
-		memory = memory_get(list->memorySize, "variable list");
+	{
+		memory = memory_get(MEMORY_SIZE(maxVariables, maxData),
+			"variable list");
+	}
 
 	if (!memory)
 		return (status = ERR_MEMORY);
 
-	memset(memory, 0, list->memorySize);
+	getRegions(memory, maxVariables, &newRegions);
 
-	// Figure out where the new data will go
-	newVariables = (unsigned *) memory;
-	newValues = (memory + (list->maxVariables * sizeof(unsigned)));
-	newData = (memory + (list->maxVariables * 2 * sizeof(unsigned)));
+	// Copy the live slots and their data, compacting as we go.  The hashes
+	// are kept, so no names need to be hashed again.
+	for (count = 0; count < USED_SLOTS(list); count ++)
+	{
+		if (oldRegions.variables[count] == DELETED_SLOT)
+			continue;
 
-	// Copy the data
-	memcpy(newVariables, oldVariables, (list->numVariables *
-		sizeof(unsigned)));
-	memcpy(newValues, oldValues, (list->numVariables * sizeof(unsigned)));
-	memcpy(newData, oldData, list->usedData);
+		newRegions.variables[slots] = used;
+		newRegions.values[slots] = (used + (oldRegions.values[count] -
+			oldRegions.variables[count]));
+		newRegions.hashes[slots] = oldRegions.hashes[count];
+
+		memcpy((newRegions.data + used),
+			(oldRegions.data + oldRegions.variables[count]),
+			slotBytes(&oldRegions, count));
+
+		used += slotBytes(&newRegions, slots);
+		slots += 1;
+	}
 
 	if (list->system)
 		memory_release_system(list->memory);
@@ -126,33 +324,53 @@ static int expandList(variableList *list)
 		memory_release(list->memory);
 
 	list->memory = memory;
+	list->memorySize = MEMORY_SIZE(maxVariables, maxData);
+	list->freeVariables = 0;
+	list->maxVariables = maxVariables;
+	list->usedData = used;
+	list->freeData = 0;
+	list->maxData = maxData;
+
+	indexBuild(list, &newRegions);
 
 	return (status = 0);
 }
 
 
-static int findVariable(variableList *list, const char *variable)
+static int findVariable(variableList *list, listRegions *regions,
+	const char *variable, unsigned hash, unsigned *pos)
 {
-	// This will attempt to locate a variable in the supplied list.
-	// On success, it returns the slot number of the variable.  Otherwise
-	// it returns negative.
+	// This will attempt to locate a variable in the supplied list, using
+	// the hash index.  On success, it returns the slot number of the
+	// variable, and its position in the index if 'pos' is non-NULL.
+	// Otherwise it returns negative.
 
 	int slot = ERR_NOSUCHENTRY;
-	unsigned *variables = list->memory;
-	char *data = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
-	int count;
+	unsigned mask = (HASH_SIZE(list) - 1);
+	unsigned count = (hash & mask);
 
 	debug("VariableList find variable %s", variable);
 
-	// Search through the list of variables in the supplied list for the one
-	// requested by the caller
-	for (count = 0; count < list->numVariables; count ++)
+	if (!list->numVariables)
 	{
-		if (!strcmp((data + variables[count]), variable))
+		debug("VariableList not found");
+		return (slot);
+	}
+
+	// Probe from the hash's home position until we hit an empty entry
+	while (regions->index[count])
+	{
+		if ((regions->hashes[regions->index[count] - 1] == hash) &&
+			!strcmp((regions->data +
+				regions->variables[regions->index[count] - 1]), variable))
 		{
-			slot = count;
+			slot = (regions->index[count] - 1);
+			if (pos)
+				*pos = count;
 			break;
 		}
+
+		count = ((count + 1) & mask);
 	}
 
 	if (slot >= 0)
@@ -164,58 +382,63 @@ static int findVariable(variableList *list, const char *variable)
 }
 
 
+static void removeSlot(variableList *list, listRegions *regions, int slot,
+	unsigned pos)
+{
+	// Remove the variable in 'slot', which is at position 'pos' in the hash
+	// index
+
+	unsigned bytes = slotBytes(regions, slot);
+
+	indexRemove(list, regions, pos);
+
+	if (slot == (USED_SLOTS(list) - 1))
+	{
+		// This is the last slot, and its data is at the end, so we can
+		// reclaim it now
+		list->usedData -= bytes;
+	}
+	else
+	{
+		// Leave the slot and its data to be reclaimed later
+		regions->variables[slot] = DELETED_SLOT;
+		list->freeVariables += 1;
+		list->freeData += bytes;
+	}
+
+	// We now have one fewer variables
+	list->numVariables -= 1;
+
+	if (!list->numVariables)
+	{
+		// Nothing left to reclaim
+		list->freeVariables = 0;
+		list->usedData = 0;
+		list->freeData = 0;
+	}
+}
+
+
 static int unsetVariable(variableList *list, const char *variable)
 {
-	// Unset a variable's value from the supplied list.  This involves
-	// shifting the entire contents of the list data starting from where the
-	// variable is found.
+	// Unset a variable's value from the supplied list
 
 	int status = 0;
+	listRegions regions;
+	unsigned pos = 0;
 	int slot = 0;
-	unsigned *variables = list->memory;
-	unsigned *values = (list->memory + (list->maxVariables * sizeof(unsigned)));
-	char *data = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
-	int subtract = 0;
-	int count;
 
 	debug("VariableList unset %s", variable);
 
+	getRegions(list->memory, list->maxVariables, &regions);
+
 	// Search the list of variables for the requested one.
-	slot = findVariable(list, variable);
+	slot = findVariable(list, &regions, variable, hashName(variable), &pos);
 	if (slot < 0)
 		// Not found
 		return (status = ERR_NOSUCHENTRY);
 
-	// Found it.  The amount of data to subtract from the data is equal to the
-	// sum of the lengths of the variable name and its value (plus one for
-	// each NULL character)
-	subtract = ((strlen(data + variables[slot]) + 1) +
-		(strlen(data + values[slot]) + 1));
-
-	// Any more data after this?
-	if (list->numVariables > 1)
-	{
-		// Starting from where the variable name starts, shift the whole
-		// contents of the data forward by 'subtract' bytes
-		memcpy((void *)(data + variables[slot]),
-			(void *)((data + variables[slot]) + subtract),
-			((list->usedData - variables[slot]) - subtract));
-
-		// Now remove the 'variable' and 'value' offsets, and shift all
-		// subsequent offsets in the lists forward by one, adjusting each
-		// by the number of bytes we subtracted from the data
-		for (count = slot; count < (list->numVariables - 1); count ++)
-		{
-			variables[count] = (variables[count + 1] - subtract);
-			values[count] = (values[count + 1] - subtract);
-		}
-	}
-
-	// We now have one fewer variables
-	list->numVariables -= 1;
-
-	// Adjust the number of bytes used
-	list->usedData -= subtract;
+	removeSlot(list, &regions, slot, pos);
 
 	debug("VariableList finished unsetting");
 
@@ -230,54 +453,54 @@ static int setVariable(variableList *list, const char *variable,
 	// Does the work of setting a variable
 
 	int status = 0;
-	unsigned *variables, *values;
-	char *data;
+	listRegions regions;
+	unsigned hash = hashName(variable);
+	unsigned needData = (strlen(variable) + strlen(value) + 2);
+	unsigned pos = 0;
+	int slot = 0;
 
 	debug("VariableList set %s", variable);
 
-	// Check to see whether the variable currently has a value
-	if (findVariable(list, variable) >= 0)
-	{
-		// The variable already has a value.  We need to unset it first.
-		status = unsetVariable(list, variable);
-		if (status < 0)
-			// We couldn't unset it.
-			return (status);
-	}
+	getRegions(list->memory, list->maxVariables, &regions);
+
+	// Check to see whether the variable currently has a value.  If so, we
+	// need to unset it first.
+	slot = findVariable(list, &regions, variable, hash, &pos);
+	if (slot >= 0)
+		removeSlot(list, &regions, slot, pos);
 
 	// Make sure we're not exceeding the maximum number of variables, and
 	// make sure we'll have enough room to store the variable name and value
-	while ((list->numVariables >= list->maxVariables) ||
-		((list->usedData + (strlen(variable) + strlen(value) + 2)) >
-			list->maxData))
+	if ((USED_SLOTS(list) >= list->maxVariables) ||
+		((list->usedData + needData) > list->maxData))
 	{
-		status = expandList(list);
+		status = expandList(list, needData);
 		if (status < 0)
 			return (status);
-	}
 
-	// Okay, we're setting the variable
-
-	variables = list->memory;
-	values = (list->memory + (list->maxVariables * sizeof(unsigned)));
-	data = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
+		getRegions(list->memory, list->maxVariables, &regions);
+	}
 
-	// The new variable goes at the end of the used data
-	variables[list->numVariables] = list->usedData;
+	// Okay, we're setting the variable.  The new variable goes at the end of
+	// the used data.
+	slot = USED_SLOTS(list);
+	regions.variables[slot] = list->usedData;
+	regions.hashes[slot] = hash;
 
 	// Copy the variable name
-	strcpy((data + variables[list->numVariables]), variable);
+	strcpy((regions.data + regions.variables[slot]), variable);
 	list->usedData += (strlen(variable) + 1);
 
 	// The variable's value will come after the variable name
-	values[list->numVariables] = list->usedData;
+	regions.values[slot] = list->usedData;
 
 	// Copy the variable value
-	strcpy((data + values[list->numVariables]), value);
+	strcpy((regions.data + regions.values[slot]), value);
 	list->usedData += (strlen(value) + 1);
 
 	// We now have one more variable
 	list->numVariables++;
+	indexInsert(list, &regions, slot);
 
 	debug("VariableList finished setting");
 
@@ -345,7 +568,7 @@ _X_ const char *variableListGetVariable(variableList *list, int num)
 {
 	// Desc : Return a pointer to the name of the 'num'th variable from the variable list 'list'.
 
-	unsigned *variables = NULL;
+	listRegions regions;
 	char *data = NULL;
 
 	debug("VariableList get variable %d", num);
@@ -367,14 +590,19 @@ _X_ const char *variableListGetVariable(variableList *list, int num)
 	if (lock_get(&list->lock) < 0)
 		return (data = NULL);
 
-	variables = list->memory;
-	data = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
+	getRegions(list->memory, list->maxVariables, &regions);
+
+	// Variables are numbered by slot, so squeeze out any deleted ones first
+	if (list->freeVariables)
+		compactList(list, &regions);
+
+	data = (regions.data + regions.variables[num]);
 
 	lock_release(&list->lock);
 
-	debug("VariableList return variable %s", (data + variables[num]));
+	debug("VariableList return variable %s", data);
 
-	return (data + variables[num]);
+	return (data);
 }
 
 
@@ -383,7 +611,7 @@ _X_ const char *variableListGet(variableList *list, const char *var)
 	// Desc : Return a pointer to the value of the variable 'var' from the variable list 'list'.
 
 	int num = 0;
-	unsigned *values = NULL;
+	listRegions regions;
 	char *data = NULL;
 
 	// Check params
@@ -399,7 +627,9 @@ _X_ const char *variableListGet(variableList *list, const char *var)
 	if (lock_get(&list->lock) < 0)
 		return (data = NULL);
 
-	num = findVariable(list, var);
+	getRegions(list->memory, list->maxVariables, &regions);
+
+	num = findVariable(list, &regions, var, hashName(var), NULL);
 	if (num < 0)
 	{
 		// No such variable
@@ -407,14 +637,13 @@ _X_ const char *variableListGet(variableList *list, const char *var)
 		return (data = NULL);
 	}
 
-	values = (list->memory + (list->maxVariables * sizeof(unsigned)));
-	data = (list->memory + (list->maxVariables * 2 * sizeof(unsigned)));
+	data = (regions.data + regions.values[num]);
 
 	lock_release(&list->lock);
 
-	debug("VariableList return value %s", (data + values[num]));
+	debug("VariableList return value %s", data);
 
-	return (data + values[num]);
+	return (data);
 }
 
 
@@ -479,6 +708,7 @@ _X_ int variableListClear(variableList *list)
 	// Desc : Remove all the variables from the variable list 'list'.
 
 	int status = 0;
+	listRegions regions;
 
 	// Check params
 	if (!list)
@@ -495,7 +725,13 @@ _X_ int variableListClear(variableList *list)
 		return (status = ERR_NOLOCK);
 
 	list->numVariables = 0;
+	list->freeVariables = 0;
 	list->usedData = 0;
+	list->freeData = 0;
+
+	// Empty the hash index
+	getRegions(list->memory, list->maxVariables, &regions);
+	memset(regions.index, 0, (HASH_SIZE(list) * sizeof(unsigned)));
 
 	lock_release(&list->lock);
 
@@ -0,0 +1,440 @@
+//
+//  Visopsys
+//  Copyright (C) 1998-2021 J. Andrew McLaughlin
+//
+//  This library is free software; you can redistribute it and/or modify it
+//  under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation; either version 2.1 of the License, or (at
+//  your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this library; if not, write to the Free Software Foundation,
+//  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+//  windowCanvasBuffer.c
+//
+
+// This contains functions for user programs to draw directly into the
+// graphic buffer of a window canvas, without a kernel API call for each
+// drawing operation.  The damaged area is accumulated, and put on the screen
+// with a single call to windowCanvasBufferPresent().
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/api.h>
+#include <sys/image.h>
+#include <sys/window.h>
+
+extern int libwindow_initialized;
+extern void libwindowInitialize(void);
+
+
+static void damage(windowCanvasBuffer *buffer, int xCoord, int yCoord,
+	int width, int height)
+{
+	// Add the area to the damaged area
+
+	if (!buffer->damaged)
+	{
+		buffer->damageX1 = xCoord;
+		buffer->damageY1 = yCoord;
+		buffer->damageX2 = (xCoord + (width - 1));
+		buffer->damageY2 = (yCoord + (height - 1));
+		buffer->damaged = 1;
+	}
+	else
+	{
+		buffer->damageX1 = min(buffer->damageX1, xCoord);
+		buffer->damageY1 = min(buffer->damageY1, yCoord);
+		buffer->damageX2 = max(buffer->damageX2, (xCoord + (width - 1)));
+		buffer->damageY2 = max(buffer->damageY2, (yCoord + (height - 1)));
+	}
+}
+
+
+static int kernelDraw(windowCanvasBuffer *buffer, windowDrawParameters *params)
+{
+	// The canvas buffer couldn't be mapped, so fall back to asking the kernel
+	// to draw.  We still put it on the screen ourselves, when the caller
+	// presents it.
+
+	params->buffer = 1;
+	return (windowComponentSetData(buffer->canvas, params, 1,
+		0 /* no redraw */));
+}
+
+
+static inline void putPixel(windowCanvasBuffer *buffer, unsigned char *ptr,
+	color *draw, unsigned short pix, drawMode mode)
+{
+	if (buffer->bytesPerPixel >= 3)
+	{
+		if (mode == draw_or)
+		{
+			ptr[0] |= draw->blue;
+			ptr[1] |= draw->green;
+			ptr[2] |= draw->red;
+		}
+		else if (mode == draw_xor)
+		{
+			ptr[0] ^= draw->blue;
+			ptr[1] ^= draw->green;
+			ptr[2] ^= draw->red;
+		}
+		else
+		{
+			ptr[0] = draw->blue;
+			ptr[1] = draw->green;
+			ptr[2] = draw->red;
+		}
+	}
+	else
+	{
+		if (mode == draw_or)
+			*((unsigned short *) ptr) |= pix;
+		else if (mode == draw_xor)
+			*((unsigned short *) ptr) ^= pix;
+		else
+			*((unsigned short *) ptr) = pix;
+	}
+}
+
+
+static unsigned short shortPixel(windowCanvasBuffer *buffer, color *draw)
+{
+	// Calculate the 15- or 16-bit value of the color, the same way the
+	// graphics driver does
+
+	if (buffer->bitsPerPixel == 16)
+	{
+		return ((unsigned short)(((draw->red >> 3) << 11) |
+			((draw->green >> 2) << 5) | (draw->blue >> 3)));
+	}
+	else if (buffer->bitsPerPixel == 15)
+	{
+		return ((unsigned short)(((draw->red >> 3) << 10) |
+			((draw->green >> 3) << 5) | (draw->blue >> 3)));
+	}
+
+	return (0);
+}
+
+
+static void drawSpan(windowCanvasBuffer *buffer, color *draw, drawMode mode,
+	int xCoord, int yCoord, int width)
+{
+	// Draw a horizontal run of pixels, clipped to the buffer
+
+	unsigned short pix = shortPixel(buffer, draw);
+	unsigned char *ptr = NULL;
+	int count;
+
+	if ((yCoord < 0) || (yCoord >= buffer->buffer.height))
+		return;
+
+	if (xCoord < 0)
+	{
+		width += xCoord;
+		xCoord = 0;
+	}
+	if ((xCoord + width) > buffer->buffer.width)
+		width = (buffer->buffer.width - xCoord);
+
+	if (width <= 0)
+		return;
+
+	ptr = (buffer->buffer.data + (((yCoord * buffer->buffer.width) +
+		xCoord) * buffer->bytesPerPixel));
+
+	for (count = 0; count < width; count ++)
+	{
+		putPixel(buffer, ptr, draw, pix, mode);
+		ptr += buffer->bytesPerPixel;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+// Below here, the functions are exported for external use
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+_X_ int windowCanvasBufferMap(objectKey canvas, windowCanvasBuffer *buffer)
+{
+	// Desc: Map the graphic buffer of the window canvas 'canvas' into the address space of this process, and initialize 'buffer' for drawing directly into it with the windowCanvasBufferDraw*() functions.  Nothing appears on the screen until windowCanvasBufferPresent() is called.  If the canvas is resized, this function must be called again.  If the buffer can't be mapped, the drawing functions still work, but each one will make a kernel API call.
+
+	int status = 0;
+	videoMode mode;
+
+	if (!libwindow_initialized)
+		libwindowInitialize();
+
+	// Check params
+	if (!canvas || !buffer)
+		return (status = ERR_NULLPARAMETER);
+
+	memset(buffer, 0, sizeof(windowCanvasBuffer));
+	buffer->canvas = canvas;
+
+	status = graphicGetMode(&mode);
+	if (status < 0)
+		return (status);
+
+	buffer->bitsPerPixel = mode.bitsPerPixel;
+	buffer->bytesPerPixel = graphicCalculateAreaBytes(1, 1);
+
+	status = windowCanvasMapBuffer(canvas, &buffer->buffer);
+	if (status < 0)
+	{
+		buffer->buffer.width = windowComponentGetWidth(canvas);
+		buffer->buffer.height = windowComponentGetHeight(canvas);
+		buffer->buffer.data = NULL;
+		return (status);
+	}
+
+	return (status = 0);
+}
+
+
+_X_ int windowCanvasBufferDrawPixel(windowCanvasBuffer *buffer, color *draw, drawMode mode, int xCoord, int yCoord)
+{
+	// Desc: Draw a single pixel into the canvas buffer 'buffer', using the color 'draw' and the drawing mode 'mode' (draw_normal, draw_or, or draw_xor).
+
+	return (windowCanvasBufferDrawRect(buffer, draw, mode, xCoord, yCoord,
+		1, 1, 1 /* thickness */, 1 /* fill */));
+}
+
+
+_X_ int windowCanvasBufferDrawLine(windowCanvasBuffer *buffer, color *draw, drawMode mode, int xCoord1, int yCoord1, int xCoord2, int yCoord2)
+{
+	// Desc: Draw a line into the canvas buffer 'buffer' from ('xCoord1', 'yCoord1') to ('xCoord2', 'yCoord2'), using the color 'draw' and the drawing mode 'mode' (draw_normal, draw_or, or draw_xor).
+
+	int status = 0;
+	windowDrawParameters params;
+	unsigned short pix = 0;
+	int x = xCoord1, y = yCoord1;
+	int deltaX, deltaY, stepX, stepY, error, error2;
+
+	// Check params
+	if (!buffer || !draw)
+		return (status = ERR_NULLPARAMETER);
+
+	if (!buffer->buffer.data)
+	{
+		memset(&params, 0, sizeof(windowDrawParameters));
+		params.operation = draw_line;
+		params.mode = mode;
+		memcpy(&params.foreground, draw, sizeof(color));
+		params.xCoord1 = xCoord1;
+		params.yCoord1 = yCoord1;
+		params.xCoord2 = xCoord2;
+		params.yCoord2 = yCoord2;
+		status = kernelDraw(buffer, &params);
+	}
+	else if (yCoord1 == yCoord2)
+	{
+		// Horizontal lines are just spans
+		drawSpan(buffer, draw, mode, min(xCoord1, xCoord2), yCoord1,
+			(abs(xCoord2 - xCoord1) + 1));
+	}
+	else
+	{
+		pix = shortPixel(buffer, draw);
+
+		deltaX = abs(xCoord2 - xCoord1);
+		deltaY = -abs(yCoord2 - yCoord1);
+		stepX = ((xCoord1 < xCoord2)? 1 : -1);
+		stepY = ((yCoord1 < yCoord2)? 1 : -1);
+		error = (deltaX + deltaY);
+
+		while (1)
+		{
+			if ((x >= 0) && (x < buffer->buffer.width) && (y >= 0) &&
+				(y < buffer->buffer.height))
+			{
+				putPixel(buffer, (buffer->buffer.data + (((y *
+					buffer->buffer.width) + x) * buffer->bytesPerPixel)),
+					draw, pix, mode);
+			}
+
+			if ((x == xCoord2) && (y == yCoord2))
+				break;
+
+			error2 = (error * 2);
+			if (error2 >= deltaY)
+			{
+				error += deltaY;
+				x += stepX;
+			}
+			if (error2 <= deltaX)
+			{
+				error += deltaX;
+				y += stepY;
+			}
+		}
+	}
+
+	damage(buffer, min(xCoord1, xCoord2), min(yCoord1, yCoord2),
+		(abs(xCoord2 - xCoord1) + 1), (abs(yCoord2 - yCoord1) + 1));
+
+	return (status);
+}
+
+
+_X_ int windowCanvasBufferDrawRect(windowCanvasBuffer *buffer, color *draw, drawMode mode, int xCoord, int yCoord, int width, int height, int thickness, int fill)
+{
+	// Desc: Draw a rectangle into the canvas buffer 'buffer' at ('xCoord', 'yCoord') with the dimensions 'width' and 'height', using the color 'draw' and the drawing mode 'mode' (draw_normal, draw_or, or draw_xor).  If 'fill' is non-zero, the rectangle is filled, otherwise its border is drawn 'thickness' pixels thick.
+
+	int status = 0;
+	windowDrawParameters params;
+	int count;
+
+	// Check params
+	if (!buffer || !draw)
+		return (status = ERR_NULLPARAMETER);
+
+	if ((width <= 0) || (height <= 0))
+		return (status = 0);
+
+	if (!buffer->buffer.data)
+	{
+		memset(&params, 0, sizeof(windowDrawParameters));
+		params.operation = draw_rect;
+		params.mode = mode;
+		memcpy(&params.foreground, draw, sizeof(color));
+		params.xCoord1 = xCoord;
+		params.yCoord1 = yCoord;
+		params.width = width;
+		params.height = height;
+		params.thickness = thickness;
+		params.fill = fill;
+		status = kernelDraw(buffer, &params);
+	}
+	else if (fill || ((thickness * 2) >= min(width, height)))
+	{
+		for (count = 0; count < height; count ++)
+			drawSpan(buffer, draw, mode, xCoord, (yCoord + count), width);
+	}
+	else
+	{
+		for (count = 0; count < thickness; count ++)
+		{
+			// Top and bottom
+			drawSpan(buffer, draw, mode, xCoord, (yCoord + count), width);
+			drawSpan(buffer, draw, mode, xCoord,
+				(yCoord + (height - 1) - count), width);
+		}
+
+		for (count = thickness; count < (height - thickness); count ++)
+		{
+			// Left and right sides
+			drawSpan(buffer, draw, mode, xCoord, (yCoord + count),
+				thickness);
+			drawSpan(buffer, draw, mode, (xCoord + (width - thickness)),
+				(yCoord + count), thickness);
+		}
+	}
+
+	damage(buffer, xCoord, yCoord, width, height);
+
+	return (status);
+}
+
+
+_X_ int windowCanvasBufferDrawImage(windowCanvasBuffer *buffer, image *img, drawMode mode, int xCoord, int yCoord)
+{
+	// Desc: Draw the image 'img' into the canvas buffer 'buffer' at ('xCoord', 'yCoord'), using the drawing mode 'mode' (draw_normal or draw_translucent).  In draw_translucent mode, pixels matching the image's transparency color are not drawn.
+
+	int status = 0;
+	windowDrawParameters params;
+	pixel *pixels = NULL;
+	pixel *p = NULL;
+	unsigned char *ptr = NULL;
+	unsigned short pix = 0;
+	int startX = 0, endX = 0;
+	int rowCount, columnCount;
+
+	// Check params
+	if (!buffer || !img)
+		return (status = ERR_NULLPARAMETER);
+
+	if (!buffer->buffer.data)
+	{
+		memset(&params, 0, sizeof(windowDrawParameters));
+		params.operation = draw_image;
+		params.mode = mode;
+		params.xCoord1 = xCoord;
+		params.yCoord1 = yCoord;
+		params.data = img;
+		status = kernelDraw(buffer, &params);
+		damage(buffer, xCoord, yCoord, img->width, img->height);
+		return (status);
+	}
+
+	if ((mode != draw_normal) && (mode != draw_translucent))
+		return (status = ERR_NOTIMPLEMENTED);
+
+	pixels = img->data;
+
+	startX = max(0, -xCoord);
+	endX = min((int) img->width, (buffer->buffer.width - xCoord));
+
+	for (rowCount = max(0, -yCoord); (rowCount < (int) img->height) &&
+		((yCoord + rowCount) < buffer->buffer.height); rowCount ++)
+	{
+		ptr = (buffer->buffer.data + ((((yCoord + rowCount) *
+			buffer->buffer.width) + (xCoord + startX)) *
+			buffer->bytesPerPixel));
+
+		for (columnCount = startX; columnCount < endX; columnCount ++)
+		{
+			p = &pixels[(rowCount * img->width) + columnCount];
+
+			if ((mode == draw_normal) || memcmp(p, &img->transColor,
+				sizeof(color)))
+			{
+				if (buffer->bytesPerPixel < 3)
+					pix = shortPixel(buffer, p);
+				putPixel(buffer, ptr, p, pix, draw_normal);
+			}
+
+			ptr += buffer->bytesPerPixel;
+		}
+	}
+
+	damage(buffer, xCoord, yCoord, img->width, img->height);
+
+	return (status = 0);
+}
+
+
+_X_ int windowCanvasBufferPresent(windowCanvasBuffer *buffer)
+{
+	// Desc: Put everything drawn into the canvas buffer 'buffer' since the last call on the screen, with a single kernel API call.
+
+	int status = 0;
+
+	// Check params
+	if (!buffer)
+		return (status = ERR_NULLPARAMETER);
+
+	if (!buffer->damaged)
+		return (status = 0);
+
+	status = windowCanvasPresent(buffer->canvas, buffer->damageX1,
+		buffer->damageY1, ((buffer->damageX2 - buffer->damageX1) + 1),
+		((buffer->damageY2 - buffer->damageY1) + 1));
+
+	buffer->damaged = 0;
+
+	return (status);
+}
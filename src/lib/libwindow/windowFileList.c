@@ -76,6 +76,15 @@
 
 #define STANDARD_ICON_SIZE			64
 
+// Number of threads making thumbnail icons for image files
+#define THUMB_WORKERS				2
+
+// Thumbnail states of file entries
+#define THUMB_NONE					0
+#define THUMB_WANTED				1
+#define THUMB_BUSY					2
+#define THUMB_DONE					3
+
 #define FOLDER_ICON ((typeIcon) { \
 	LOADERFILECLASS_NONE, LOADERFILESUBCLASS_NONE, DEFAULT_FOLDERICON_VAR, \
 		DEFAULT_FOLDERICON_FILE, folderImageIndex } )
@@ -127,11 +136,15 @@ typedef struct {
 	listItemParameters iconParams;
 	loaderFileClass class;
 	typeIcon *icon;
+	int thumbState;
+	image thumbImage;
 
 } fileEntry;
 
 extern int libwindow_initialized;
 extern void libwindowInitialize(void);
+extern int libwindowThumbLoad(const char *, unsigned, unsigned, int,
+	image *);
 
 static typeIcon iconList[] = {
 	// These get traversed in order; the first matching file class flags get
@@ -176,8 +189,10 @@ static typeIcon iconList[] = {
 typedef struct {
 	variableList config;
 	image images[maxImageIndex];
-	image *customImages;
-	int numCustomImages;
+	int workerPids[THUMB_WORKERS];
+	int priorityFirst;
+	int priorityNum;
+	int nextThumb;
 	typeIcon folderIcon;
 	typeIcon textIcon;
 	typeIcon binIcon;
@@ -372,6 +387,10 @@ static int classifyEntry(fileListData *data, fileEntry *entry)
 			// Get the icon for the file
 			getFileIcon(data, entry);
 
+			// Image files get thumbnail icons, made in the background
+			if (entry->class.type & LOADERFILECLASS_IMAGE)
+				entry->thumbState = THUMB_WANTED;
+
 			break;
 		}
 
@@ -416,6 +435,23 @@ static int classifyEntry(fileListData *data, fileEntry *entry)
 }
 
 
+static void freeThumbs(windowFileList *fileList)
+{
+	// Free the thumbnail images of the current file entries
+
+	fileEntry *entry = NULL;
+	int count;
+
+	for (count = 0; count < fileList->numFileEntries; count ++)
+	{
+		entry = &((fileEntry *) fileList->fileEntries)[count];
+
+		if (entry->thumbImage.data)
+			imageFree(&entry->thumbImage);
+	}
+}
+
+
 static int changeDirectory(windowFileList *fileList, const char *rawPath)
 {
 	// Given a directory path, allocate memory, and read all of the required
@@ -485,178 +521,156 @@ static int changeDirectory(windowFileList *fileList, const char *rawPath)
 
 	// Commit
 	strncpy(fileList->cwd, path, MAX_PATH_LENGTH);
+	freeThumbs(fileList);
 	if (fileList->fileEntries)
 		free(fileList->fileEntries);
 	fileList->fileEntries = tmpFileEntries;
 	fileList->numFileEntries = tmpNumFileEntries;
+	((fileListData *) fileList->data)->nextThumb = 0;
+	((fileListData *) fileList->data)->priorityNum = 0;
 
 	return (status = 0);
 }
 
 
-static listItemParameters *allocateIconParameters(windowFileList *fileList)
+static int supplyItems(windowFileList *fileList, int firstItem,
+	int numItems)
 {
-	listItemParameters *newIconParams = NULL;
+	// Our window list is virtual, and wants the list item parameters for
+	// some of our file entries
+
+	int status = 0;
+	listItemParameters *iconParams = NULL;
 	int count;
 
-	if (fileList->numFileEntries)
+	status = lockGet(&fileList->lock);
+	if (status < 0)
+		return (status);
+
+	// The directory might have changed since the request was made
+	if (firstItem < 0)
+		firstItem = 0;
+	if ((firstItem + numItems) > fileList->numFileEntries)
+		numItems = (fileList->numFileEntries - firstItem);
+
+	if (numItems > 0)
 	{
-		newIconParams = calloc(fileList->numFileEntries,
-			sizeof(listItemParameters));
-		if (!newIconParams)
+		// Make thumbnails for these ones first
+		((fileListData *) fileList->data)->priorityFirst = firstItem;
+		((fileListData *) fileList->data)->priorityNum = numItems;
+
+		iconParams = calloc(numItems, sizeof(listItemParameters));
+		if (!iconParams)
 		{
+			lockRelease(&fileList->lock);
 			error("%s", _("Memory allocation error creating icon "
 				"parameters"));
-			return (newIconParams);
+			return (status = ERR_MEMORY);
 		}
 
-		// Fill in an array of list item parameters structures for our file
-		// entries.  It will get passed to the window list creation/set data
-		// function in a moment
-		for (count = 0; count < fileList->numFileEntries; count ++)
+		for (count = 0; count < numItems; count ++)
 		{
-			memcpy(&newIconParams[count], (listItemParameters *)
-				&(((fileEntry *) fileList->fileEntries)[count].iconParams),
-				sizeof(listItemParameters));
+			memcpy(&iconParams[count], (listItemParameters *)
+				&(((fileEntry *) fileList->fileEntries)[firstItem + count]
+					.iconParams), sizeof(listItemParameters));
 		}
-	}
 
-	return (newIconParams);
-}
-
-
-static void freeCustomImages(fileListData *data)
-{
-	int count;
+		status = windowListSetItems(fileList->key, firstItem, iconParams,
+			numItems);
 
-	if (data)
-	{
-		if (data->customImages)
-		{
-			for (count = 0; count < data->numCustomImages; count ++)
-				imageFree(&data->customImages[count]);
+		free(iconParams);
+	}
 
-			free(data->customImages);
-			data->customImages = NULL;
-		}
+	lockRelease(&fileList->lock);
 
-		data->numCustomImages = 0;
-	}
+	return (status);
 }
 
 
-static int getCustomIcon(fileListData *data, fileEntry *entry)
+static int makeThumb(const char *fileName, image *thumb)
 {
-	// Try to load a custom icon for certain types of files
+	// Make a thumbnail icon for an image file
 
 	int status = 0;
-	int newCustom = 0;
-	image *newCustomImages = NULL;
-	image *newImage = NULL;
 	image tmpImage;
-	image tmpImage2;
 
-	memset(&tmpImage, 0, sizeof(image));
-	memset(&tmpImage2, 0, sizeof(image));
+	status = libwindowThumbLoad(fileName, STANDARD_ICON_SIZE,
+		STANDARD_ICON_SIZE, 0 /* no stretch */, thumb);
+	if (status < 0)
+		return (status);
 
-	if (entry->class.type & LOADERFILECLASS_IMAGE)
+	// If it's smaller than our standard icon size, paste it into a larger
+	// image, so it's centered.
+	if ((thumb->width < STANDARD_ICON_SIZE) ||
+		(thumb->height < STANDARD_ICON_SIZE))
 	{
-		// Try to load the image
-		status = imageLoad(entry->fullName, 0, 0, &tmpImage);
-		if (status < 0)
-			return (status);
+		memset(&tmpImage, 0, sizeof(image));
 
-		// If it's bigger than our standard icon size, try to resize it so it
-		// fits in both dimensions, preserving the aspect ratio.
-		if ((tmpImage.width > STANDARD_ICON_SIZE) ||
-			(tmpImage.height > STANDARD_ICON_SIZE))
+		status = imageNew(&tmpImage, STANDARD_ICON_SIZE, STANDARD_ICON_SIZE);
+		if (status >= 0)
 		{
-			if (tmpImage.width >= tmpImage.height)
-			{
-				status = imageResize(&tmpImage, STANDARD_ICON_SIZE,
-					((tmpImage.height * 100) / ((tmpImage.width * 100) /
-						STANDARD_ICON_SIZE)));
-			}
-			else
-			{
-				status = imageResize(&tmpImage, ((tmpImage.width * 100) /
-					((tmpImage.height * 100) / STANDARD_ICON_SIZE)),
-					STANDARD_ICON_SIZE);
-			}
+			tmpImage.transColor = (color){ 0, 0xFF, 0 };
 
-			if (status < 0)
-				return (status);
-		}
-
-		// If it's smaller than our standard icon size, paste it into a larger
-		// image, so it's centered.
-		if ((tmpImage.width < STANDARD_ICON_SIZE) ||
-			(tmpImage.height < STANDARD_ICON_SIZE))
-		{
-			status = imageNew(&tmpImage2, STANDARD_ICON_SIZE,
-				STANDARD_ICON_SIZE);
+			status = imageFill(&tmpImage, &tmpImage.transColor);
 			if (status >= 0)
 			{
-				tmpImage2.transColor = (color){ 0, 0xFF, 0 };
-
-				status = imageFill(&tmpImage2, &tmpImage2.transColor);
+				status = imagePaste(thumb, &tmpImage,
+					((tmpImage.width - thumb->width) / 2),
+					((tmpImage.height - thumb->height) / 2));
 				if (status >= 0)
 				{
-					status = imagePaste(&tmpImage, &tmpImage2,
-						((tmpImage2.width - tmpImage.width) / 2),
-						((tmpImage2.height - tmpImage.height) / 2));
-					if (status >= 0)
-					{
-						imageFree(&tmpImage);
-						imageCopy(&tmpImage2, &tmpImage);
-					}
+					imageFree(thumb);
+					imageCopy(&tmpImage, thumb);
 				}
-
-				imageFree(&tmpImage2);
 			}
-		}
 
-		newCustom = 1;
+			imageFree(&tmpImage);
+		}
 	}
 
-	if (!newCustom)
-		return (status = ERR_NOTINITIALIZED);
-
-	// Get memory for a new custom image list
-	newCustomImages = calloc((data->numCustomImages + 1), sizeof(image));
-	if (!newCustomImages)
-	{
-		imageFree(&tmpImage);
-		return (status = ERR_MEMORY);
-	}
+	return (status = 0);
+}
 
-	// Copy the old list
-	memcpy(newCustomImages, data->customImages, (data->numCustomImages *
-		sizeof(image)));
 
-	newImage = &newCustomImages[data->numCustomImages];
-	memcpy(newImage, &tmpImage, sizeof(image));
+static int nextThumb(windowFileList *fileList)
+{
+	// Choose the next file entry that needs a thumbnail.  The ones the list
+	// most recently asked for (i.e. the visible ones) come first, then the
+	// rest in order.  Call with the lock held.
 
-	if (data->customImages)
-		free(data->customImages);
+	fileListData *data = fileList->data;
+	fileEntry *entries = fileList->fileEntries;
+	int count;
 
-	data->customImages = newCustomImages;
-	data->numCustomImages += 1;
+	for (count = data->priorityFirst; (count < (data->priorityFirst +
+		data->priorityNum)) && (count < fileList->numFileEntries); count ++)
+	{
+		if (entries[count].thumbState == THUMB_WANTED)
+			return (count);
+	}
 
-	memcpy(&entry->iconParams.iconImage, newImage, sizeof(image));
+	for ( ; data->nextThumb < fileList->numFileEntries; data->nextThumb ++)
+	{
+		if (entries[data->nextThumb].thumbState == THUMB_WANTED)
+			return (data->nextThumb);
+	}
 
-	return (status = 0);
+	return (-1);
 }
 
 
-static void iconThread(int argc, void *argv[])
+static void thumbThread(int argc, void *argv[])
 {
+	// One of a pool of threads which make thumbnail icons for image files,
+	// and update the list as each one is done
+
 	int status = 0;
 	windowFileList *fileList = NULL;
-	int updateAfter = 0;
 	fileEntry *entry = NULL;
-	listItemParameters *iconParams = NULL;
-	int count;
+	char *fileName = NULL;
+	image thumb;
+	listItemParameters iconParams;
+	int item = 0;
 
 	// Convert the argument string to a pointer
 	if (argc == 2)
@@ -671,93 +685,156 @@ static void iconThread(int argc, void *argv[])
 		goto terminate;
 	}
 
-	freeCustomImages(fileList->data);
-
-	updateAfter = max(5, (fileList->numFileEntries / 10));
+	fileName = malloc(MAX_PATH_NAME_LENGTH + 1);
+	if (!fileName)
+	{
+		status = ERR_MEMORY;
+		goto terminate;
+	}
 
-	for (count = 0; count < fileList->numFileEntries; count ++)
+	while (1)
 	{
-		entry = &((fileEntry *) fileList->fileEntries)[count];
+		status = lockGet(&fileList->lock);
+		if (status < 0)
+			break;
 
-		if (entry->file.type == fileT)
+		item = nextThumb(fileList);
+		if (item < 0)
+		{
+			// Nothing left to do
+			lockRelease(&fileList->lock);
+			break;
+		}
+
+		entry = &((fileEntry *) fileList->fileEntries)[item];
+		entry->thumbState = THUMB_BUSY;
+		strncpy(fileName, entry->fullName, MAX_PATH_NAME_LENGTH);
+
+		lockRelease(&fileList->lock);
+
+		// The slow part, without the lock
+		status = makeThumb(fileName, &thumb);
+
+		if (lockGet(&fileList->lock) < 0)
 		{
-			status = getCustomIcon(fileList->data, entry);
 			if (status >= 0)
-			{
-				if ((count && !(count % updateAfter)) || (count >=
-					(fileList->numFileEntries - 1)))
-				{
-					iconParams = allocateIconParameters(fileList);
-					if (iconParams)
-					{
-						windowComponentSetData(fileList->key, iconParams,
-							fileList->numFileEntries, 1 /* redraw */);
-						free(iconParams);
-					}
-				}
-			}
+				imageFree(&thumb);
+			break;
+		}
+
+		entry->thumbState = THUMB_DONE;
+
+		if (status >= 0)
+		{
+			memcpy(&entry->thumbImage, &thumb, sizeof(image));
+			memcpy(&entry->iconParams.iconImage, &entry->thumbImage,
+				sizeof(image));
+			memcpy(&iconParams, &entry->iconParams,
+				sizeof(listItemParameters));
+		}
+
+		lockRelease(&fileList->lock);
+
+		if (status >= 0)
+		{
+			// Update the item.  If it's not near the visible part of the list,
+			// this is ignored, and the list will ask for the new icon if it's
+			// scrolled into view.
+			windowListSetItems(fileList->key, item, &iconParams, 1);
 		}
 	}
 
 	status = 0;
 
 terminate:
+	if (fileName)
+		free(fileName);
+
 	multitaskerTerminate(status);
 }
 
 
-static void killIconThread(windowFileList *fileList)
+static void killThumbThreads(windowFileList *fileList)
 {
-	// If an icon thread was running, try to kill it
-	if (fileList->iconThreadPid > 0)
+	// If any thumbnail threads are running, try to kill them
+
+	fileListData *data = fileList->data;
+	int count;
+
+	for (count = 0; count < THUMB_WORKERS; count ++)
 	{
-		if (multitaskerProcessIsAlive(fileList->iconThreadPid))
+		if (data->workerPids[count] > 0)
 		{
-			multitaskerKillProcess(fileList->iconThreadPid);
+			if (multitaskerProcessIsAlive(data->workerPids[count]))
+			{
+				multitaskerKillProcess(data->workerPids[count]);
 
-			while (multitaskerProcessIsAlive(fileList->iconThreadPid))
-				multitaskerYield();
-		}
+				while (multitaskerProcessIsAlive(data->workerPids[count]))
+					multitaskerYield();
+			}
 
-		fileList->iconThreadPid = 0;
+			data->workerPids[count] = 0;
+		}
 	}
 }
 
 
-static void launchIconThread(windowFileList *fileList)
+static void launchThumbThreads(windowFileList *fileList)
 {
+	fileListData *data = fileList->data;
 	char ptrString[(sizeof(void *) * 2) + 3];
+	int count;
 
-	// If an existing icon thread was running, try to kill it
-	killIconThread(fileList);
+	// If existing thumbnail threads are running, try to kill them
+	killThumbThreads(fileList);
 
-	// Launch a new icon thread to do any custom icons, if applicable
+	// Launch new threads to make any thumbnail icons
 
 	lltoux((unsigned long) fileList, ptrString);
 
-	fileList->iconThreadPid = multitaskerSpawn(&iconThread, "icon thread", 1,
-		(void *[]){ ptrString }, 1 /* run */);
+	for (count = 0; count < THUMB_WORKERS; count ++)
+	{
+		data->workerPids[count] = multitaskerSpawn(&thumbThread,
+			"thumbnail thread", 1, (void *[]){ ptrString }, 1 /* run */);
+	}
 
-	// Give the thread a chance to get going before we return
+	// Give the threads a chance to get going before we return
 	multitaskerYield();
 }
 
 
-static int changeDirWithLock(windowFileList *fileList, const char *newDir)
+static int changeDirWithLock(windowFileList *fileList, const char *newDir,
+	int keepSelected)
 {
 	// Rescan the directory information and rebuild the file list, with
-	// locking so that our GUI thread and main thread don't trash one another
+	// locking so that our GUI thread and main thread don't trash one another.
+	// If 'keepSelected' is set, and the selected file is still there
+	// afterwards, it stays selected.
 
 	int status = 0;
-	listItemParameters *iconParams = NULL;
+	char selectName[MAX_PATH_NAME_LENGTH + 1];
+	fileEntry *fileEntries = NULL;
+	int selected = -1;
+	int count;
 
-	// Lock before killing any icon thread
+	// Lock before killing any thumbnail threads
 	status = lockGet(&fileList->lock);
 	if (status < 0)
 		return (status);
 
-	// If an existing icon thread was running, try to kill it
-	killIconThread(fileList);
+	// If existing thumbnail threads were running, try to kill them
+	killThumbThreads(fileList);
+
+	selectName[0] = '\0';
+	if (keepSelected)
+	{
+		windowComponentGetSelected(fileList->key, &selected);
+		if ((selected >= 0) && (selected < fileList->numFileEntries))
+		{
+			fileEntries = (fileEntry *) fileList->fileEntries;
+			strcpy(selectName, fileEntries[selected].fullName);
+		}
+	}
 
 	windowSwitchPointer(fileList->key, MOUSE_POINTER_BUSY);
 
@@ -769,29 +846,32 @@ static int changeDirWithLock(windowFileList *fileList, const char *newDir)
 		return (status);
 	}
 
-	iconParams = allocateIconParameters(fileList);
-	if (!iconParams)
+	selected = 0;
+	if (selectName[0])
 	{
-		windowSwitchPointer(fileList->key, MOUSE_POINTER_DEFAULT);
-		lockRelease(&fileList->lock);
-		return (status = ERR_MEMORY);
+		fileEntries = (fileEntry *) fileList->fileEntries;
+
+		for (count = 0; count < fileList->numFileEntries; count ++)
+		{
+			if (!strcmp(fileEntries[count].fullName, selectName))
+			{
+				selected = count;
+				break;
+			}
+		}
 	}
 
-	// Clear the list
-	windowComponentSetData(fileList->key, NULL, 0, 0 /* no redraw */);
-	windowComponentSetData(fileList->key, iconParams,
-		fileList->numFileEntries, 1 /* redraw */);
-	windowComponentSetSelected(fileList->key, 0);
+	// Reset the list.  It will ask us for the items it needs.
+	windowListSetNumItems(fileList->key, fileList->numFileEntries);
+	windowComponentSetSelected(fileList->key, selected);
 
 	windowSwitchPointer(fileList->key, MOUSE_POINTER_DEFAULT);
 
-	free(iconParams);
-
-	// Unlock before starting a new icon thread
+	// Unlock before starting new thumbnail threads
 	lockRelease(&fileList->lock);
 
-	// Start an icon thread
-	launchIconThread(fileList);
+	// Start the thumbnail threads
+	launchThumbThreads(fileList);
 
 	return (status = 0);
 }
@@ -800,7 +880,8 @@ static int changeDirWithLock(windowFileList *fileList, const char *newDir)
 static int update(windowFileList *fileList)
 {
 	// Update the supplied file list from the current directory.
-	return (changeDirWithLock(fileList, fileList->cwd));
+	return (changeDirWithLock(fileList, fileList->cwd,
+		1 /* keep selected */));
 }
 
 
@@ -811,6 +892,10 @@ static int eventHandler(windowFileList *fileList, windowEvent *event)
 	fileEntry *fileEntries = (fileEntry *) fileList->fileEntries;
 	fileEntry saveEntry;
 
+	// Is our window list asking for item data?
+	if (event->type & WINDOW_EVENT_LIST_FETCH)
+		return (status = supplyItems(fileList, event->coord.x, event->coord.y));
+
 	// Get the selected item
 	windowComponentGetSelected(fileList->key, &selected);
 	if (selected < 0)
@@ -836,7 +921,8 @@ static int eventHandler(windowFileList *fileList, windowEvent *event)
 		{
 			// Change to the directory, get the list of icon parameters, and
 			// update our window list.
-			status = changeDirWithLock(fileList, saveEntry.fullName);
+			status = changeDirWithLock(fileList, saveEntry.fullName,
+				0 /* select first */);
 			if (status < 0)
 			{
 				error(_("Can't change to directory %s"), saveEntry.file.name);
@@ -893,15 +979,12 @@ static int destroy(windowFileList *fileList)
 	fileListData *data = (fileListData *) fileList->data;
 	int count;
 
-	// If an icon thread was running, try to kill it
-	killIconThread(fileList);
-
-	if (fileList->fileEntries)
-		free(fileList->fileEntries);
-
 	if (data)
 	{
-		freeCustomImages(data);
+		// If thumbnail threads were running, try to kill them
+		killThumbThreads(fileList);
+
+		freeThumbs(fileList);
 
 		for (count = 0; count < maxImageIndex; count ++)
 		{
@@ -912,6 +995,9 @@ static int destroy(windowFileList *fileList)
 		variableListDestroy(&data->config);
 	}
 
+	if (fileList->fileEntries)
+		free(fileList->fileEntries);
+
 	free(fileList);
 
 	return (0);
@@ -933,7 +1019,7 @@ _X_ windowFileList *windowNewFileList(objectKey parent, windowListType type, int
 	int status = 0;
 	windowFileList *fileList = NULL;
 	fileListData *data = NULL;
-	listItemParameters *iconParams = NULL;
+	windowEvent event;
 
 	if (!libwindow_initialized)
 		libwindowInitialize();
@@ -973,16 +1059,24 @@ _X_ windowFileList *windowNewFileList(objectKey parent, windowListType type, int
 		return (fileList = NULL);
 	}
 
-	// Get our array of icon parameters
-	iconParams = allocateIconParameters(fileList);
-
-	// Create a window list to hold the icons
-	fileList->key = windowNewList(parent, type, rows, columns,
-		0 /* no select multiple */, iconParams, fileList->numFileEntries,
-		params);
+	// Create a virtual window list to hold the icons.  This only creates
+	// icons for the visible part of the list, so big directories are OK.
+	fileList->key = windowNewVirtualList(parent, type, rows, columns,
+		0 /* no select multiple */, fileList->numFileEntries, params);
+	if (!fileList->key)
+	{
+		destroy(fileList);
+		errno = ERR_NOCREATE;
+		return (fileList = NULL);
+	}
 
-	if (iconParams)
-		free(iconParams);
+	// Answer the list's first request for items now, so that it gets sized
+	// to fit the icons
+	while (windowComponentEventGet(fileList->key, &event) > 0)
+	{
+		if (event.type & WINDOW_EVENT_LIST_FETCH)
+			supplyItems(fileList, event.coord.x, event.coord.y);
+	}
 
 	fileList->browseFlags = flags;
 
@@ -992,8 +1086,8 @@ _X_ windowFileList *windowNewFileList(objectKey parent, windowListType type, int
 	fileList->eventHandler = &eventHandler;
 	fileList->destroy = &destroy;
 
-	// Start an icon thread
-	launchIconThread(fileList);
+	// Start the thumbnail threads
+	launchThumbThreads(fileList);
 
 	return (fileList);
 }
@@ -33,6 +33,7 @@
 typedef struct {
 	objectKey key;
 	void (*function)(objectKey, windowEvent *);
+	int (*dataFunction)(objectKey, int, listItemParameters *, int);
 
 } callBack;
 
@@ -44,6 +45,52 @@ static volatile int run = 0;
 static volatile int guiThreadPid = 0;
 
 
+static void listFetch(callBack *cb, windowEvent *event)
+{
+	// A virtual list wants data for some items.  Get it from the data
+	// callback, and give it to the list.
+
+	listItemParameters *items = NULL;
+	int numItems = 0;
+
+	if (event->coord.y <= 0)
+		return;
+
+	items = calloc(event->coord.y, sizeof(listItemParameters));
+	if (!items)
+		return;
+
+	numItems = cb->dataFunction(cb->key, event->coord.x, items,
+		event->coord.y);
+
+	if (numItems > 0)
+		windowListSetItems(cb->key, event->coord.x, items, numItems);
+
+	free(items);
+}
+
+
+static callBack *findEmptyCallBack(objectKey key)
+{
+	// Find a callback entry for this key with no event handler function
+
+	callBack *cb = NULL;
+	linkedListItem *iter = NULL;
+
+	cb = linkedListIterStart(&callBackList, &iter);
+
+	while (cb)
+	{
+		if ((cb->key == key) && !cb->function)
+			return (cb);
+
+		cb = linkedListIterNext(&callBackList, &iter);
+	}
+
+	return (cb = NULL);
+}
+
+
 static void guiRun(void)
 {
 	// This is the thread that runs for each user GUI program polling
@@ -66,7 +113,14 @@ static void guiRun(void)
 		{
 			if (cb->key && (windowComponentEventGet(cb->key, &event) > 0))
 			{
-				if (cb->function)
+				if ((event.type & WINDOW_EVENT_LIST_FETCH) &&
+					cb->dataFunction)
+				{
+					listFetch(cb, &event);
+					event.type &= ~WINDOW_EVENT_LIST_FETCH;
+				}
+
+				if (event.type && cb->function)
 					cb->function(cb->key, &event);
 			}
 
@@ -136,6 +190,15 @@ _X_ int windowRegisterEventHandler(objectKey key, void (*function)(objectKey, wi
 	if (!key || !function)
 		return (status = ERR_NULLPARAMETER);
 
+	// Is there already an entry for this key, created by
+	// windowRegisterListDataHandler()?
+	cb = findEmptyCallBack(key);
+	if (cb)
+	{
+		cb->function = function;
+		return (status = 0);
+	}
+
 	cb = calloc(1, sizeof(callBack));
 	if (!cb)
 		return (status = ERR_MEMORY);
@@ -154,6 +217,50 @@ _X_ int windowRegisterEventHandler(objectKey key, void (*function)(objectKey, wi
 }
 
 
+_X_ int windowRegisterListDataHandler(objectKey list, int (*function)(objectKey, int, listItemParameters *, int))
+{
+	// Desc: Register a callback function to supply the item data for the virtual window list 'list' (see windowNewVirtualList()).  When the list needs data, the function is called with the list, the number of the first item wanted, an array of listItemParameters to fill in, and the number of items wanted.  It should return the number of items it filled in, or a negative error code.  As with windowRegisterEventHandler(), it is necessary to use one of the 'run' functions, such as windowGuiRun() or windowGuiThread(), in order to receive the callbacks.  Any event handler registered for the list won't see WINDOW_EVENT_LIST_FETCH events.
+
+	int status = 0;
+	callBack *cb = NULL;
+	linkedListItem *iter = NULL;
+
+	// Check params
+	if (!list || !function)
+		return (status = ERR_NULLPARAMETER);
+
+	// If there's already an entry for this list, use it
+	cb = linkedListIterStart(&callBackList, &iter);
+
+	while (cb)
+	{
+		if (cb->key == list)
+		{
+			cb->dataFunction = function;
+			return (status = 0);
+		}
+
+		cb = linkedListIterNext(&callBackList, &iter);
+	}
+
+	cb = calloc(1, sizeof(callBack));
+	if (!cb)
+		return (status = ERR_MEMORY);
+
+	cb->key = list;
+	cb->dataFunction = function;
+
+	status = linkedListAddBack(&callBackList, cb);
+	if (status < 0)
+	{
+		free(cb);
+		return (status);
+	}
+
+	return (status = 0);
+}
+
+
 _X_ int windowClearEventHandler(objectKey key)
 {
 	// Desc: Remove a callback event handler registered with the windowRegisterEventHandler() function.
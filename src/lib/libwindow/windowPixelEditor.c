@@ -59,39 +59,24 @@ static void drawGrid(windowPixelEditor *editor)
 {
 	// Draw the grid
 
-	windowDrawParameters params;
-	int rowCount, columnCount;
-
-	// Clear our drawing parameters
-	memset(&params, 0, sizeof(windowDrawParameters));
-
-	params.operation = draw_line;
-	params.mode = draw_xor;
-	params.thickness = 1;
-	params.buffer = 1;
-	memcpy(&params.foreground, &editor->background, sizeof(color));
+	int lastX = ((editor->horizPixels * editor->pixelSize) - 1);
+	int lastY = ((editor->vertPixels * editor->pixelSize) - 1);
+	int count;
 
 	// Horizontal lines
-	params.xCoord2 = ((editor->horizPixels * editor->pixelSize) - 1);
-	for (rowCount = 0; rowCount <= editor->vertPixels; rowCount ++)
+	for (count = 0; count <= editor->vertPixels; count ++)
 	{
-		windowComponentSetData(editor->canvas, &params, 1, 0 /* no redraw */);
-		params.yCoord1 += editor->pixelSize;
-		params.yCoord2 = params.yCoord1;
+		windowCanvasBufferDrawLine(&editor->canvasBuffer, &editor->background,
+			draw_xor, 0, (count * editor->pixelSize), lastX,
+			(count * editor->pixelSize));
 	}
 
 	// Vertical lines
-	params.xCoord1 = params.yCoord1 = params.xCoord2 = 0;
-	params.yCoord2 = ((editor->vertPixels * editor->pixelSize) - 1);
-	for (columnCount = 0; columnCount <= editor->horizPixels; columnCount ++)
+	for (count = 0; count <= editor->horizPixels; count ++)
 	{
-		windowComponentSetData(editor->canvas, &params, 1,
-			(columnCount == editor->horizPixels));
-		params.xCoord1 += editor->pixelSize;
-		params.xCoord2 = params.xCoord1;
-
-		if (columnCount == editor->horizPixels)
-			params.buffer = 0;
+		windowCanvasBufferDrawLine(&editor->canvasBuffer, &editor->background,
+			draw_xor, (count * editor->pixelSize), 0,
+			(count * editor->pixelSize), lastY);
 	}
 }
 
@@ -100,7 +85,7 @@ static void draw(windowPixelEditor *editor)
 {
 	pixel *pixels = editor->img->data;
 	int current = 0;
-	windowDrawParameters params;
+	int xCoord = 0, yCoord = 0, width = 0;
 	int rowCount, columnCount;
 
 	// Calculate the starting horizonal and vertical pixel, based on the scroll
@@ -124,27 +109,19 @@ static void draw(windowPixelEditor *editor)
 		editor->pixelSize += 1;
 	}
 
-	// Clear our drawing parameters
-	memset(&params, 0, sizeof(windowDrawParameters));
+	// Everything is drawn directly into the mapped canvas buffer, and then
+	// put on the screen at once
 
 	// Clear the background
-	params.operation = draw_rect;
-	params.mode = draw_normal;
-	params.width = editor->width;
-	params.height = editor->height;
-	params.fill = 1;
-	params.buffer = 1;
-	memcpy(&params.foreground, &editor->background, sizeof(color));
-	windowComponentSetData(editor->canvas, &params, 1, 0 /* no redraw */);
+	windowCanvasBufferDrawRect(&editor->canvasBuffer, &editor->background,
+		draw_normal, 0, 0, editor->width, editor->height, 1 /* thickness */,
+		1 /* fill */);
 
 	// Draw the image pixels
-
-	params.height = editor->pixelSize;
-
 	for (rowCount = 0; rowCount < editor->vertPixels; rowCount ++)
 	{
-		params.xCoord1 = 0;
-		params.width = editor->pixelSize;
+		xCoord = 0;
+		width = editor->pixelSize;
 
 		for (columnCount = 0; columnCount < editor->horizPixels;
 			columnCount ++)
@@ -155,23 +132,25 @@ static void draw(windowPixelEditor *editor)
 			if ((columnCount < (editor->horizPixels - 1)) &&
 				!memcmp(&pixels[current], &pixels[current + 1], sizeof(pixel)))
 			{
-				params.width += editor->pixelSize;
+				width += editor->pixelSize;
 			}
 			else
 			{
-				memcpy(&params.foreground, &pixels[current], sizeof(pixel));
-				windowComponentSetData(editor->canvas, &params, 1,
-					0 /* no redraw */);
-				params.xCoord1 += params.width;
-				params.width = editor->pixelSize;
+				windowCanvasBufferDrawRect(&editor->canvasBuffer,
+					&pixels[current], draw_normal, xCoord, yCoord, width,
+					editor->pixelSize, 1 /* thickness */, 1 /* fill */);
+				xCoord += width;
+				width = editor->pixelSize;
 			}
 		}
 
-		params.yCoord1 += editor->pixelSize;
+		yCoord += editor->pixelSize;
 	}
 
 	// Draw the grid
 	drawGrid(editor);
+
+	windowCanvasBufferPresent(&editor->canvasBuffer);
 }
 
 
@@ -185,6 +164,9 @@ static int resize(windowPixelEditor *editor)
 	editor->width = windowComponentGetWidth(editor->canvas);
 	editor->height = windowComponentGetHeight(editor->canvas);
 
+	// The canvas has a new buffer, so map it again
+	windowCanvasBufferMap(editor->canvas, &editor->canvasBuffer);
+
 	editor->maxPixelSize = ((min(editor->width, editor->height) / 2) - 1);
 	calcNumPixels(editor);
 	calcDisplayPercentage(editor);
@@ -583,6 +565,10 @@ _X_ windowPixelEditor *windowNewPixelEditor(objectKey parent, int width, int hei
 	editor->height = height;
 	editor->img = img;
 
+	// Map the canvas buffer, so we can draw directly into it.  If this fails,
+	// drawing falls back to kernel API calls.
+	windowCanvasBufferMap(editor->canvas, &editor->canvasBuffer);
+
 	// Allocate a graphic buffer to draw in
 	editor->buffer.width = img->width;
 	editor->buffer.height = img->height;
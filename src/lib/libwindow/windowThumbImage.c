@@ -22,21 +22,210 @@
 // This contains functions for user programs to operate GUI components.
 
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/api.h>
+#include <sys/image.h>
+#include <sys/paths.h>
 #include <sys/window.h>
 
+#define THUMBNAIL_CACHE_DIR		PATH_SYSTEM_CACHE "/thumbnails"
+#define THUMBNAIL_CACHE_MAX		512
+
 extern int libwindow_initialized;
 extern void libwindowInitialize(void);
 
+int libwindowThumbLoad(const char *, unsigned, unsigned, int, image *);
+
+
+static void cacheName(const char *fileName, file *theFile, unsigned maxWidth,
+	unsigned maxHeight, int stretch, char *name)
+{
+	// Thumbnails in the cache are named for the source file's path, size,
+	// and modification time, and the thumbnail dimensions, so that a
+	// changed file never gets a stale thumbnail.  This is the name without
+	// the extension: there's a .bmp file with the thumbnail, and a .pth file
+	// with the full path of the source file, since different paths can have
+	// the same CRC.
+
+	struct tm modified;
+
+	memcpy(&modified, &theFile->modified, sizeof(struct tm));
+
+	snprintf(name, (MAX_PATH_NAME_LENGTH - 4), "%s/%08x-%08x-%08x-%ux%u%s",
+		THUMBNAIL_CACHE_DIR, crc32((void *) fileName, strlen(fileName), NULL),
+		theFile->size, (unsigned) mktime(&modified), maxWidth, maxHeight,
+		(stretch? "s" : ""));
+}
+
+
+static int cachePathMatches(const char *pathName, const char *fileName)
+{
+	// Returns 1 if the cache entry's .pth file contains the path 'fileName'
+
+	int match = 0;
+	fileStream theStream;
+	unsigned len = strlen(fileName);
+	char *buffer = NULL;
+
+	memset(&theStream, 0, sizeof(fileStream));
+
+	if (fileStreamOpen(pathName, OPENMODE_READ, &theStream) < 0)
+		return (match = 0);
+
+	if (theStream.size == len)
+	{
+		buffer = malloc(len + 1);
+		if (buffer)
+		{
+			if ((fileStreamRead(&theStream, len, buffer) >= 0) &&
+				!memcmp(buffer, fileName, len))
+			{
+				match = 1;
+			}
+
+			free(buffer);
+		}
+	}
+
+	fileStreamClose(&theStream);
+
+	return (match);
+}
+
+
+static void cacheTrim(void)
+{
+	// Keep the cache from growing without limit.  Every time a thumbnail is
+	// used, its file gets a new timestamp, so while the cache is full, we
+	// delete the least recently used one.
+
+	file theFile;
+	int numEntries = 0;
+	time_t oldestTime = 0, entryTime = 0;
+	char *oldest = NULL;
+	char *name = NULL;
+	int status = 0;
+
+	// Each entry is 2 files.  If there's room, don't bother looking at them.
+	if (fileCount(THUMBNAIL_CACHE_DIR) < (THUMBNAIL_CACHE_MAX * 2))
+		return;
+
+	oldest = malloc(MAX_NAME_LENGTH + 1);
+	name = malloc(MAX_PATH_NAME_LENGTH + 1);
+	if (!oldest || !name)
+		goto out;
+
+	while (1)
+	{
+		numEntries = 0;
+		oldest[0] = '\0';
+
+		status = fileFirst(THUMBNAIL_CACHE_DIR, &theFile);
+		while (status >= 0)
+		{
+			if ((theFile.type == fileT) && (strlen(theFile.name) > 4) &&
+				!strcmp((theFile.name + strlen(theFile.name) - 4), ".bmp"))
+			{
+				numEntries += 1;
+
+				entryTime = mktime(&theFile.modified);
+				if (!oldest[0] || (entryTime < oldestTime))
+				{
+					strcpy(oldest, theFile.name);
+					oldestTime = entryTime;
+				}
+			}
+
+			status = fileNext(THUMBNAIL_CACHE_DIR, &theFile);
+		}
+
+		if ((numEntries < THUMBNAIL_CACHE_MAX) || !oldest[0])
+			break;
+
+		// Delete the thumbnail and its .pth file
+		snprintf(name, MAX_PATH_NAME_LENGTH, "%s/%s", THUMBNAIL_CACHE_DIR,
+			oldest);
+		if (fileDelete(name) < 0)
+			break;
+
+		strcpy((name + strlen(name) - 4), ".pth");
+		fileDelete(name);
+	}
+
+out:
+	if (oldest)
+		free(oldest);
+	if (name)
+		free(name);
+}
+
+
+static void cacheSave(const char *name, const char *fileName, image *thumb)
+{
+	// Try to save a thumbnail in the cache.  It doesn't matter if this fails
+	// (for example if the filesystem is read-only).
+
+	char *entryName = NULL;
+	fileStream theStream;
+	int status = 0;
+
+	if (fileFind(THUMBNAIL_CACHE_DIR, NULL) < 0)
+	{
+		if (fileFind(PATH_SYSTEM_CACHE, NULL) < 0)
+		{
+			if (fileMakeDir(PATH_SYSTEM_CACHE) < 0)
+				return;
+		}
+
+		if (fileMakeDir(THUMBNAIL_CACHE_DIR) < 0)
+			return;
+	}
+
+	entryName = malloc(MAX_PATH_NAME_LENGTH + 1);
+	if (!entryName)
+		return;
+
+	// Make room
+	cacheTrim();
+
+	sprintf(entryName, "%s.bmp", name);
+	if (imageSave(entryName, IMAGEFORMAT_BMP, thumb) < 0)
+		goto out;
+
+	// Record the full path of the source file
+	sprintf(entryName, "%s.pth", name);
+
+	memset(&theStream, 0, sizeof(fileStream));
+
+	status = fileStreamOpen(entryName, (OPENMODE_WRITE | OPENMODE_CREATE |
+		OPENMODE_TRUNCATE), &theStream);
+	if (status >= 0)
+	{
+		status = fileStreamWrite(&theStream, strlen(fileName), fileName);
+		fileStreamClose(&theStream);
+	}
+
+	if (status < 0)
+	{
+		// The thumbnail is no use without it
+		fileDelete(entryName);
+		sprintf(entryName, "%s.bmp", name);
+		fileDelete(entryName);
+	}
+
+out:
+	free(entryName);
+}
+
 
 static int getImage(const char *fileName, image *imageData, unsigned maxWidth,
 	unsigned maxHeight, int stretch, color *background)
 {
 	int status = 0;
 	image loadImage;
-	float scale = 0;
-	unsigned thumbWidth = 0;
-	unsigned thumbHeight = 0;
 
 	memset(&loadImage, 0, sizeof(image));
 
@@ -53,60 +242,143 @@ static int getImage(const char *fileName, image *imageData, unsigned maxWidth,
 
 	if (fileName)
 	{
-		status = imageLoad(fileName, 0, 0, &loadImage);
+		status = libwindowThumbLoad(fileName, maxWidth, maxHeight, stretch,
+			&loadImage);
 		if (status < 0)
 			goto out;
 
-		// Scale the image
-		thumbWidth = loadImage.width;
-		thumbHeight = loadImage.height;
+		status = imagePaste(&loadImage, imageData,
+			((maxWidth - loadImage.width) / 2),
+			((maxHeight - loadImage.height) / 2));
+		if (status < 0)
+			goto out;
+	}
 
-		// Presumably we need to shrink it?
-		if (stretch)
-		{
-			thumbWidth = maxWidth;
-			thumbHeight = maxHeight;
-		}
-		else
+	status = 0;
+
+out:
+	if (loadImage.data)
+		imageFree(&loadImage);
+
+	if ((status < 0) && imageData->data)
+		imageFree(imageData);
+
+	return (status);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+//
+// Below here, the functions are shared within libwindow
+//
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+int libwindowThumbLoad(const char *fileName, unsigned maxWidth,
+	unsigned maxHeight, int stretch, image *thumb)
+{
+	// Load an image file as a thumbnail no bigger than 'maxWidth' x
+	// 'maxHeight', keeping the aspect ratio unless 'stretch' is set.  Scaled
+	// thumbnails are kept in a cache on disk, so this is quick the next time.
+
+	int status = 0;
+	file theFile;
+	char *name = NULL;
+	char *entryName = NULL;
+	float scale = 0;
+	unsigned thumbWidth = 0;
+	unsigned thumbHeight = 0;
+	int cache = 0;
+
+	memset(thumb, 0, sizeof(image));
+
+	status = fileFind(fileName, &theFile);
+	if (status < 0)
+		return (status);
+
+	name = malloc(MAX_PATH_NAME_LENGTH + 1);
+	entryName = malloc(MAX_PATH_NAME_LENGTH + 1);
+	if (!name || !entryName)
+	{
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	// Don't make thumbnails of the thumbnails
+	cache = strncmp(fileName, THUMBNAIL_CACHE_DIR,
+		strlen(THUMBNAIL_CACHE_DIR));
+
+	if (cache)
+	{
+		cacheName(fileName, &theFile, maxWidth, maxHeight, stretch, name);
+
+		// Is it cached?  Make sure the entry is really for this path.
+		sprintf(entryName, "%s.pth", name);
+		if (cachePathMatches(entryName, fileName))
 		{
-			if (thumbWidth > maxWidth)
+			sprintf(entryName, "%s.bmp", name);
+			if (imageLoad(entryName, 0, 0, thumb) >= 0)
 			{
-				scale = ((float) maxWidth / (float) thumbWidth);
-				thumbWidth = (unsigned)((float) thumbWidth * scale);
-				thumbHeight = (unsigned)((float) thumbHeight * scale);
+				// Mark it as recently used
+				fileTimestamp(entryName);
+				status = 0;
+				goto out;
 			}
+		}
+	}
 
-			if (thumbHeight > maxHeight)
-			{
-				scale = ((float) maxHeight / (float) thumbHeight);
-				thumbWidth = (unsigned)((float) thumbWidth * scale);
-				thumbHeight = (unsigned)((float) thumbHeight * scale);
-			}
+	status = imageLoad(fileName, 0, 0, thumb);
+	if (status < 0)
+		goto out;
+
+	// Scale the image
+	thumbWidth = thumb->width;
+	thumbHeight = thumb->height;
+
+	// Presumably we need to shrink it?
+	if (stretch)
+	{
+		thumbWidth = maxWidth;
+		thumbHeight = maxHeight;
+	}
+	else
+	{
+		if (thumbWidth > maxWidth)
+		{
+			scale = ((float) maxWidth / (float) thumbWidth);
+			thumbWidth = (unsigned)((float) thumbWidth * scale);
+			thumbHeight = (unsigned)((float) thumbHeight * scale);
 		}
 
-		if ((thumbWidth != loadImage.width) ||
-			(thumbHeight != loadImage.height))
+		if (thumbHeight > maxHeight)
 		{
-			status = imageResize(&loadImage, thumbWidth, thumbHeight);
-			if (status < 0)
-				goto out;
+			scale = ((float) maxHeight / (float) thumbHeight);
+			thumbWidth = (unsigned)((float) thumbWidth * scale);
+			thumbHeight = (unsigned)((float) thumbHeight * scale);
 		}
+	}
 
-		status = imagePaste(&loadImage, imageData,
-			((maxWidth - loadImage.width) / 2),
-			((maxHeight - loadImage.height) / 2));
+	if ((thumbWidth != thumb->width) || (thumbHeight != thumb->height))
+	{
+		status = imageResize(thumb, thumbWidth, thumbHeight);
 		if (status < 0)
+		{
+			imageFree(thumb);
 			goto out;
+		}
 	}
 
+	if (cache)
+		cacheSave(name, fileName, thumb);
+
 	status = 0;
 
 out:
-	if (loadImage.data)
-		imageFree(&loadImage);
-
-	if ((status < 0) && imageData->data)
-		imageFree(imageData);
+	if (name)
+		free(name);
+	if (entryName)
+		free(entryName);
 
 	return (status);
 }
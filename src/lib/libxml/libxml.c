@@ -30,6 +30,52 @@
 #include <sys/html.h>
 #include <sys/xml.h>
 
+#define ARENA_BLOCKSIZE		32768
+#define TEXT_INITIALSIZE	65536
+#define STREAM_READSIZE		16384
+
+// Memory for a document's tags, elements, attributes, and tag names comes
+// from a list of big blocks, which are all freed at once
+typedef struct _arenaBlock {
+	struct _arenaBlock *next;
+	unsigned size;
+	unsigned used;
+
+} arenaBlock;
+
+// An element whose 'open' tag hasn't been matched with a 'close' tag (yet)
+typedef struct _pendingElement {
+	xmlElement *element;
+	struct _pendingElement *next;
+
+} pendingElement;
+
+// Each tag name is stored once, with a list of the elements of that name
+// that are waiting for 'close' tags, innermost first
+typedef struct {
+	const char *name;
+	pendingElement *pending;
+
+} tagNameEntry;
+
+// The state of a parse in progress.  Since the text can arrive in pieces,
+// positions in it are kept as offsets.  Until the end, the elements are
+// just chained together in the order they appear.
+typedef struct {
+	const char *buffer;
+	unsigned len;
+	unsigned textSize;
+	unsigned scan;
+	int tagStart;
+	int inComment;
+	xmlElement *lastElement;
+	tagNameEntry *names;
+	unsigned numNames;
+	unsigned maxNames;
+	pendingElement *freePending;
+
+} xmlParser;
+
 
 #ifdef DEBUG
 
@@ -68,40 +114,6 @@
 		}
 	}
 
-	static void dumpTags(xmlDocument *doc)
-	{
-		const char *tmp = NULL;
-		int count;
-
-		for (count = 0; count < doc->numTags; count ++)
-		{
-			switch(doc->tag[count].type)
-			{
-				case tag_single:
-					tmp = "single";
-					break;
-
-				case tag_open:
-					tmp = "open";
-					break;
-
-				case tag_close:
-					tmp = "close";
-					break;
-
-				case tag_unknown:
-				default:
-					tmp = "unknown";
-					break;
-			}
-
-			DEBUGMSG("tag %d ", count);
-			dumpRaw(doc->tag[count].name, doc->tag[count].nameLen);
-			DEBUGMSG(":%s \t", tmp);
-			dumpLine(doc->tag[count].start, min(doc->tag[count].len, 60));
-		}
-	}
-
 	static void dumpElementsRecursive(xmlElement *element, int level)
 	{
 		int count;
@@ -128,7 +140,6 @@
 	#define DEBUGMSG(message, arg...) do { } while (0)
 	#define dumpRaw(buffer, len) do { } while (0)
 	#define dumpLine(buffer, len) do { } while (0)
-	#define dumpTags(doc) do { } while (0)
 	#define dumpElementsRecursive(element, level) do { } while (0)
 	#define dumpElements(doc) do { } while (0)
 #endif
@@ -233,161 +244,146 @@ static void tagName(xmlTag *tag)
 }
 
 
-static int enumerateTags(xmlDocument *doc, const char *buffer, unsigned len)
+static void *arenaAlloc(xmlDocument *doc, unsigned size)
 {
-	xmlTag *openTag = NULL;
-	int inComment = 0;
+	// Allocate zeroed memory that will be freed along with the document
+
+	arenaBlock *block = doc->arena;
+	void *ptr = NULL;
+
+	// Keep everything pointer-aligned
+	size = ((size + (sizeof(void *) - 1)) & ~(sizeof(void *) - 1));
 
-	while (len)
+	if (!block || ((block->used + size) > block->size))
 	{
-		if (inComment)
+		block = calloc(1, (sizeof(arenaBlock) + max(ARENA_BLOCKSIZE,
+			size)));
+		if (!block)
 		{
-			if (!strncasecmp(buffer, XML_TAG_COMMENT_CLOSE, min(len, 3)))
-			{
-				buffer += min(len, 2);
-				len -= min(len, 2);
-				inComment = 0;
-			}
-			else
-			{
-				buffer += 1;
-				len -= 1;
-				continue;
-			}
+			DEBUGMSG("Memory error\n");
+			return (ptr = NULL);
 		}
 
-		if (*buffer == '<')
-		{
-			if (openTag)
-			{
-				DEBUGMSG("Unterminated tag open\n");
-				dumpLine(buffer, min(len, 16));
-				return (-1);
-			}
+		block->next = doc->arena;
+		block->size = max(ARENA_BLOCKSIZE, size);
+		doc->arena = block;
+	}
 
-			doc->tag = realloc(doc->tag, ((doc->numTags + 1) *
-				sizeof(xmlTag)));
-			if (!doc->tag)
-			{
-				DEBUGMSG("Memory error\n");
-				return (-1);
-			}
+	ptr = ((void *)(block + 1) + block->used);
+	block->used += size;
 
-			openTag = &doc->tag[doc->numTags];
-			doc->numTags += 1;
+	return (ptr);
+}
 
-			memset(openTag, 0, sizeof(xmlTag));
-			openTag->start = buffer;
 
-			// Watch out for the special case of comments, which can enclose
-			// other tags.  We want to skip their contents entirely.
-			if (!strncasecmp(buffer, XML_TAG_COMMENT_OPEN, min(len, 4)))
-			{
-				buffer += min(len, 3);
-				len -= min(len, 3);
-				inComment = 1;
-			}
-		}
-		else if (*buffer == '>')
-		{
-			if (!openTag)
-			{
-				DEBUGMSG("Orphan tag close\n");
-				dumpLine(buffer, min(len, 16));
-				return (-1);
-			}
+static unsigned hashName(const char *name, int len)
+{
+	// 32-bit FNV-1a hash of a name
 
-			openTag->len = ((buffer - openTag->start) + 1);
-			openTag->type = tagType(openTag);
+	unsigned hash = 2166136261U;
 
-			if (openTag->type == tag_unknown)
-			{
-				DEBUGMSG("Unknown tag type: ");
-				dumpLine(openTag->start, min(openTag->len, 16));
-				return (-1);
-			}
+	while (len-- > 0)
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
 
-			tagName(openTag);
-			if (!openTag->name)
-			{
-				DEBUGMSG("Unknown tag name: ");
-				dumpLine(openTag->start, min(openTag->len, 16));
-				return (-1);
-			}
+	return (hash);
+}
+
+
+static tagNameEntry *findName(xmlParser *parser, const char *name, int len)
+{
+	// Find the entry in the table of tag names where the name is, or where
+	// it would go
+
+	unsigned mask = (parser->maxNames - 1);
+	unsigned count = (hashName(name, len) & mask);
 
-			openTag = NULL;
+	while (parser->names[count].name)
+	{
+		if (!strncmp(parser->names[count].name, name, len) &&
+			!parser->names[count].name[len])
+		{
+			break;
 		}
 
-		buffer += 1;
-		len -= 1;
+		count = ((count + 1) & mask);
 	}
 
-	return (0);
+	return (&parser->names[count]);
 }
 
 
-static int pairTags(xmlDocument *doc)
+static tagNameEntry *addName(xmlDocument *doc, xmlParser *parser,
+	const char *name, int len)
 {
-	xmlTag *tag1 = NULL, *tag2 = NULL;
-	int opens = 0;
-	int count1, count2;
+	// Return the entry for the name, adding it if necessary.  The stored,
+	// NULL-terminated copies of names stay put when the document text moves.
+
+	tagNameEntry *entry = NULL;
+	tagNameEntry *oldNames = NULL;
+	unsigned oldMax = 0;
+	char *copy = NULL;
+	unsigned count;
 
-	// Loop through all the tags, looking for 'open' tags that require a
-	// corresponding 'close'
-	for (count1 = 0; count1 < doc->numTags; count1 ++)
+	// Keep the table less than half full
+	if (((parser->numNames + 1) * 2) > parser->maxNames)
 	{
-		tag1 = &doc->tag[count1];
+		oldNames = parser->names;
+		oldMax = parser->maxNames;
 
-		if (tag1->type == tag_open)
+		parser->maxNames = max((oldMax * 2), 64);
+		parser->names = calloc(parser->maxNames, sizeof(tagNameEntry));
+		if (!parser->names)
 		{
-			opens = 1;
-
-			// Look for 'close' tags with the same name, skipping nested
-			// pairs of the same name.
-			for (count2 = (count1 + 1); count2 < doc->numTags; count2 ++)
-			{
-				tag2 = &doc->tag[count2];
-
-				if ((tag1->nameLen == tag2->nameLen) && !strncmp(tag1->name,
-					tag2->name, tag1->nameLen))
-				{
-					if (tag2->type == tag_open)
-					{
-						// Nested 'open'
-						opens += 1;
-					}
-					else if (tag2->type == tag_close)
-					{
-						opens -= 1;
-
-						if (!opens)
-						{
-							// This is the corresponding 'close'
-							tag1->closeTag = tag2;
-							break;
-						}
-					}
-				}
-			}
+			DEBUGMSG("Memory error\n");
+			parser->names = oldNames;
+			parser->maxNames = oldMax;
+			return (entry = NULL);
+		}
 
-			if (!tag1->closeTag)
+		for (count = 0; count < oldMax; count ++)
+		{
+			if (oldNames[count].name)
 			{
-				// Some tags in e.g. HTML can look like opens, but are
-				// technically allowed to be single (<a>, <br>, ...)
-				tag1->type = tag_single;
+				entry = findName(parser, oldNames[count].name,
+					strlen(oldNames[count].name));
+				memcpy(entry, &oldNames[count], sizeof(tagNameEntry));
 			}
 		}
+
+		if (oldNames)
+			free(oldNames);
 	}
 
-	return (0);
+	entry = findName(parser, name, len);
+	if (entry->name)
+		return (entry);
+
+	copy = arenaAlloc(doc, (len + 1));
+	if (!copy)
+		return (entry = NULL);
+
+	strncpy(copy, name, len);
+	entry->name = copy;
+	parser->numNames += 1;
+
+	return (entry);
 }
 
 
-static void elementAttrs(xmlElement *element)
+static int elementAttrs(xmlElement *element, xmlAttribute *attributes)
 {
+	// Parse the attributes in the element's open tag into the array, if
+	// one is supplied, and return the number of them.  Called without an
+	// array first, to count them.
+
 	const char *tmp = (element->openTag->name + element->openTag->nameLen);
 	int len = (element->openTag->len - ((tmp - element->openTag->start) + 1));
+	xmlAttribute dummy;
 	xmlAttribute *attribute = NULL;
+	int numAttributes = 0;
 
 	while (len > 0)
 	{
@@ -404,16 +400,12 @@ static void elementAttrs(xmlElement *element)
 		if (*tmp == '/')
 			break;
 
-		element->attribute = realloc(element->attribute,
-			((element->numAttributes + 1) * sizeof(xmlAttribute)));
-		if (!element->attribute)
-		{
-			DEBUGMSG("Memory error\n");
-			return;
-		}
+		if (attributes)
+			attribute = &attributes[numAttributes];
+		else
+			attribute = &dummy;
 
-		attribute = &element->attribute[element->numAttributes];
-		element->numAttributes += 1;
+		numAttributes += 1;
 
 		memset(attribute, 0, sizeof(xmlAttribute));
 		attribute->name = tmp;
@@ -458,7 +450,7 @@ static void elementAttrs(xmlElement *element)
 		if (*tmp != '"')
 		{
 			DEBUGMSG("Attribute value missing open \"\n");
-			return;
+			break;
 		}
 
 		tmp += 1;
@@ -480,124 +472,397 @@ static void elementAttrs(xmlElement *element)
 		if (*tmp != '"')
 		{
 			DEBUGMSG("Attribute value missing close \"\n");
-			return;
+			break;
 		}
 
 		tmp += 1;
 		len -= 1;
 	}
+
+	return (numAttributes);
+}
+
+
+static int addElement(xmlDocument *doc, xmlParser *parser, xmlTag *tag)
+{
+	// Make an element for a 'single' or 'open' tag
+
+	tagNameEntry *entry = NULL;
+	xmlElement *element = NULL;
+	pendingElement *pending = NULL;
+
+	element = arenaAlloc(doc, sizeof(xmlElement));
+	if (!element)
+		return (-1);
+
+	element->openTag = arenaAlloc(doc, sizeof(xmlTag));
+	if (!element->openTag)
+		return (-1);
+
+	memcpy(element->openTag, tag, sizeof(xmlTag));
+
+	// Until (unless) we see the close tag, the element is just its open tag
+	element->start = tag->start;
+	element->len = tag->len;
+
+	entry = addName(doc, parser, tag->name, tag->nameLen);
+	if (!entry)
+		return (-1);
+
+	element->name = entry->name;
+	element->nameLen = tag->nameLen;
+
+	element->numAttributes = elementAttrs(element, NULL);
+	if (element->numAttributes)
+	{
+		element->attribute = arenaAlloc(doc, (element->numAttributes *
+			sizeof(xmlAttribute)));
+		if (!element->attribute)
+			return (-1);
+
+		elementAttrs(element, element->attribute);
+	}
+
+	if (parser->lastElement)
+		parser->lastElement->next = element;
+	else
+		doc->rootElement.child = element;
+
+	parser->lastElement = element;
+	doc->numElements += 1;
+
+	if (tag->type == tag_open)
+	{
+		// Wait for a 'close' tag with the same name
+		if (parser->freePending)
+		{
+			pending = parser->freePending;
+			parser->freePending = pending->next;
+		}
+		else
+		{
+			pending = arenaAlloc(doc, sizeof(pendingElement));
+			if (!pending)
+				return (-1);
+		}
+
+		pending->element = element;
+		pending->next = entry->pending;
+		entry->pending = pending;
+	}
+
+	return (0);
 }
 
 
-static void makeElementTreeRecursive(xmlDocument *doc, xmlElement *parent,
-	xmlElement *previous, int *nextIndex)
+static int closeElement(xmlDocument *doc, xmlParser *parser, xmlTag *tag)
+{
+	// A 'close' tag goes with the innermost unclosed 'open' tag of the same
+	// name.  If there isn't one, it's ignored.
+
+	tagNameEntry *entry = NULL;
+	pendingElement *pending = NULL;
+	xmlElement *element = NULL;
+
+	if (!parser->maxNames)
+		return (0);
+
+	entry = findName(parser, tag->name, tag->nameLen);
+	if (!entry->pending)
+		return (0);
+
+	pending = entry->pending;
+	entry->pending = pending->next;
+	element = pending->element;
+
+	pending->next = parser->freePending;
+	parser->freePending = pending;
+
+	element->openTag->closeTag = arenaAlloc(doc, sizeof(xmlTag));
+	if (!element->openTag->closeTag)
+		return (-1);
+
+	memcpy(element->openTag->closeTag, tag, sizeof(xmlTag));
+
+	element->len = ((tag->start - element->start) + tag->len);
+	element->body = (element->start + element->openTag->len);
+	element->bodyLen = (tag->start - element->body);
+
+	return (0);
+}
+
+
+static void makeElementTreeRecursive(xmlElement *parent, xmlElement *previous,
+	xmlElement **nextElement)
 {
 	xmlElement *current = NULL;
 
-	while (*nextIndex < doc->numElements)
+	while (*nextElement)
 	{
-		current = &doc->element[*nextIndex];
+		current = *nextElement;
 
 		// If the current element is not inside the parent, exit
 		if (current->start >= (parent->start + parent->len))
 			return;
 
+		*nextElement = current->next;
+		current->next = NULL;
+
 		// Is the current element inside the previous one?
 		if (current->start < (previous->start + previous->len))
 		{
 			// The current element is inside the previous - recurse
 			previous->child = current;
-			*nextIndex += 1;
-			makeElementTreeRecursive(doc, previous, current, nextIndex);
+			makeElementTreeRecursive(previous, current, nextElement);
 		}
 		else
 		{
 			// The current element is not inside the previous - chain
 			previous->next = current;
 			previous = current;
-			*nextIndex += 1;
 		}
 	}
 }
 
 
-static void makeElementTree(xmlDocument *doc, xmlElement *root)
+static void makeElementTree(xmlElement *root)
 {
-	int nextIndex = 1;
+	// Turn the chain of elements, in the order they appear, into a tree
+
+	xmlElement *element = NULL;
+	xmlElement *nextElement = NULL;
+
+	for (element = root->child; element; element = element->next)
+	{
+		if ((element->openTag->type == tag_open) &&
+			!element->openTag->closeTag)
+		{
+			// Some tags in e.g. HTML can look like opens, but are
+			// technically allowed to be single (<a>, <br>, ...)
+			element->openTag->type = tag_single;
+		}
+	}
+
+	if (!root->child)
+		return;
 
-	root->child = &doc->element[0];
+	nextElement = root->child->next;
+	root->child->next = NULL;
 
-	makeElementTreeRecursive(doc, root, root->child, &nextIndex);
+	makeElementTreeRecursive(root, root->child, &nextElement);
 }
 
 
-static int composeElements(xmlDocument *doc)
+static int endTag(xmlDocument *doc, xmlParser *parser)
 {
-	xmlTag *tag = NULL;
-	int numElements = 0;
-	xmlElement *element = NULL;
-	int count;
+	// We've seen the whole of a tag.  Classify it (open, close, single), and
+	// add it to the element tree.
 
-	// The number of elements will be the number of 'single' and 'open' tags
-	for (count = 0; count < doc->numTags; count ++)
-	{
-		tag = &doc->tag[count];
+	xmlTag tag;
 
-		if ((tag->type == tag_single) || (tag->type == tag_open))
-			numElements += 1;
+	memset(&tag, 0, sizeof(xmlTag));
+	tag.start = (parser->buffer + parser->tagStart);
+	tag.len = ((parser->scan - parser->tagStart) + 1);
+	tag.type = tagType(&tag);
+
+	if (tag.type == tag_unknown)
+	{
+		DEBUGMSG("Unknown tag type: ");
+		dumpLine(tag.start, min(tag.len, 16));
+		return (-1);
 	}
 
-	// Allocate memory for all of the elements
-	doc->element = calloc(numElements, sizeof(xmlElement));
-	if (!doc->element)
+	tagName(&tag);
+	if (!tag.name)
 	{
-		DEBUGMSG("Memory error\n");
+		DEBUGMSG("Unknown tag name: ");
+		dumpLine(tag.start, min(tag.len, 16));
 		return (-1);
 	}
 
-	// Make elements corresponding to all 'single' and 'open' tags
-	for (count = 0; count < doc->numTags; count ++)
+	if (tag.type == tag_close)
+		return (closeElement(doc, parser, &tag));
+	else
+		return (addElement(doc, parser, &tag));
+}
+
+
+static int parseTags(xmlDocument *doc, xmlParser *parser, int final)
+{
+	// Find the tags in the text we have so far, in a single pass.  Unless
+	// this is the end of the document, stop where we'd need to look ahead
+	// past the end of the text.
+
+	const char *buffer = NULL;
+	unsigned len = 0;
+
+	while (parser->scan < parser->len)
 	{
-		tag = &doc->tag[count];
+		buffer = (parser->buffer + parser->scan);
+		len = (parser->len - parser->scan);
 
-		if ((tag->type == tag_single) || (tag->type == tag_open))
+		if (parser->inComment)
 		{
-			element = &doc->element[doc->numElements];
-
-			element->openTag = tag;
+			if (!final && (len < 3))
+				break;
 
-			element->start = tag->start;
-			if (tag->type == tag_single)
+			if (!strncasecmp(buffer, XML_TAG_COMMENT_CLOSE, min(len, 3)))
 			{
-				element->len = tag->len;
+				parser->scan += min(len, 2);
+				buffer += min(len, 2);
+				len -= min(len, 2);
+				parser->inComment = 0;
+
+				if (!len)
+					break;
 			}
 			else
 			{
-				element->len = ((tag->closeTag->start - tag->start) +
-					tag->closeTag->len);
+				parser->scan += 1;
+				continue;
 			}
+		}
 
-			element->name = tag->name;
-			element->nameLen = tag->nameLen;
+		if (*buffer == '<')
+		{
+			if (!final && (len < 4))
+				break;
 
-			if (tag->type == tag_open)
+			if (parser->tagStart >= 0)
 			{
-				element->body = (tag->start + tag->len);
-				element->bodyLen = (tag->closeTag->start - element->body);
+				DEBUGMSG("Unterminated tag open\n");
+				dumpLine(buffer, min(len, 16));
+				return (-1);
 			}
 
-			elementAttrs(element);
+			parser->tagStart = parser->scan;
+			doc->numTags += 1;
+
+			// Watch out for the special case of comments, which can enclose
+			// other tags.  We want to skip their contents entirely.
+			if (!strncasecmp(buffer, XML_TAG_COMMENT_OPEN, min(len, 4)))
+			{
+				parser->scan += min(len, 3);
+				parser->inComment = 1;
+			}
+		}
+		else if (*buffer == '>')
+		{
+			if (parser->tagStart < 0)
+			{
+				DEBUGMSG("Orphan tag close\n");
+				dumpLine(buffer, min(len, 16));
+				return (-1);
+			}
+
+			if (endTag(doc, parser) < 0)
+				return (-1);
+
+			parser->tagStart = -1;
+		}
+
+		parser->scan += 1;
+	}
+
+	return (0);
+}
+
+
+static void freeParser(xmlDocument *doc)
+{
+	// Free the state of a parse, which isn't needed once it's finished
+
+	xmlParser *parser = doc->parser;
+
+	if (parser)
+	{
+		if (parser->names)
+			free(parser->names);
+
+		free(parser);
+		doc->parser = NULL;
+	}
+}
+
+
+static void moveElements(xmlElement *element, long diff)
+{
+	// The document text has moved by 'diff' bytes.  Adjust the pointers into
+	// it, in the chain of elements so far.  Element names are stored
+	// separately, so they don't move.
+
+	xmlTag *closeTag = NULL;
+	int count;
+
+	for ( ; element; element = element->next)
+	{
+		element->start += diff;
+		if (element->body)
+			element->body += diff;
+
+		element->openTag->start += diff;
+		element->openTag->name += diff;
 
-			doc->numElements += 1;
+		closeTag = element->openTag->closeTag;
+		if (closeTag)
+		{
+			closeTag->start += diff;
+			closeTag->name += diff;
+		}
+
+		for (count = 0; count < element->numAttributes; count ++)
+		{
+			element->attribute[count].name += diff;
+			if (element->attribute[count].value)
+				element->attribute[count].value += diff;
 		}
 	}
+}
 
-	makeElementTree(doc, &doc->rootElement);
+
+static int resizeText(xmlDocument *doc, xmlParser *parser, unsigned size)
+{
+	// Resize the document's copy of the text
+
+	char *oldText = doc->text;
+	char *newText = NULL;
+
+	newText = realloc(doc->text, size);
+	if (!newText)
+	{
+		DEBUGMSG("Memory error\n");
+		return (-1);
+	}
+
+	doc->text = newText;
+	parser->textSize = size;
+	parser->buffer = newText;
+
+	// If the text moved, so did everything that points into it
+	if (oldText && (newText != oldText))
+		moveElements(doc->rootElement.child, (newText - oldText));
 
 	return (0);
 }
 
 
+static int growText(xmlDocument *doc, xmlParser *parser, unsigned len)
+{
+	// Make sure the document's copy of the text has room for 'len' more
+	// bytes
+
+	unsigned newSize = max(parser->textSize, TEXT_INITIALSIZE);
+
+	while ((doc->textLen + len) > newSize)
+		newSize *= 2;
+
+	if (newSize == parser->textSize)
+		return (0);
+
+	return (resizeText(doc, parser, newSize));
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 //
@@ -606,72 +871,206 @@ static int composeElements(xmlDocument *doc)
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 
-int xmlParse(xmlDocument *doc, const char *buffer, unsigned len)
+int xmlParseStart(xmlDocument *doc)
 {
+	// Start parsing a document that will be supplied in pieces, with
+	// xmlParseChunk() or xmlParseStream().  The document keeps its own copy
+	// of the text.
+
+	xmlParser *parser = NULL;
+
 	// Check params
-	if (!doc || !buffer || !len)
+	if (!doc)
 		return (-1);
 
-	DEBUGMSG("Parse XML (%u bytes)\n", len);
+	memset(doc, 0, sizeof(xmlDocument));
+
+	parser = calloc(1, sizeof(xmlParser));
+	if (!parser)
+		return (-1);
+
+	doc->parser = parser;
+	parser->tagStart = -1;
 
-	// Set up the document's root element
-	doc->rootElement.start = buffer;
-	doc->rootElement.len = len;
 	doc->rootElement.name = "root";
 	doc->rootElement.nameLen = strlen(doc->rootElement.name);
 
-	// First pass: find all the tags and classify them (open, close, single)
-	if (enumerateTags(doc, buffer, len) < 0)
+	return (0);
+}
+
+
+int xmlParseChunk(xmlDocument *doc, const char *buffer, unsigned len)
+{
+	// Add the next piece of the document text, and parse as much as we can
+
+	xmlParser *parser = NULL;
+
+	// Check params
+	if (!doc || !doc->parser || (!buffer && len))
+		return (-1);
+
+	parser = doc->parser;
+
+	if (growText(doc, parser, len) < 0)
 	{
-		DEBUGMSG("Error enumerating tags\n");
 		xmlFree(doc);
 		return (-1);
 	}
 
-	if (0) dumpTags(doc);
+	memcpy((doc->text + doc->textLen), buffer, len);
+	doc->textLen += len;
+	parser->len = doc->textLen;
 
-	// Second pass: pair open tags with close tags
-	if (pairTags(doc) < 0)
+	if (parseTags(doc, parser, 0 /* not final */) < 0)
 	{
-		DEBUGMSG("Error pairing tags\n");
+		DEBUGMSG("Error parsing tags\n");
 		xmlFree(doc);
 		return (-1);
 	}
 
-	// Third pass: build an array (and tree) of elements
-	if (composeElements(doc) < 0)
+	return (0);
+}
+
+
+int xmlParseStream(xmlDocument *doc, FILE *stream)
+{
+	// Parse a whole document from a stream (a file, or e.g. a socket opened
+	// with fdopen()), reading it straight into the document's copy of the
+	// text as we go
+
+	xmlParser *parser = NULL;
+	size_t bytes = 0;
+
+	// Check params
+	if (!doc || !stream)
+		return (-1);
+
+	if (xmlParseStart(doc) < 0)
+		return (-1);
+
+	parser = doc->parser;
+
+	while (1)
 	{
-		DEBUGMSG("Error composing elements\n");
+		if (growText(doc, parser, STREAM_READSIZE) < 0)
+		{
+			xmlFree(doc);
+			return (-1);
+		}
+
+		bytes = fread((doc->text + doc->textLen), 1, (parser->textSize -
+			doc->textLen), stream);
+		if (!bytes)
+			break;
+
+		doc->textLen += bytes;
+		parser->len = doc->textLen;
+
+		if (parseTags(doc, parser, 0 /* not final */) < 0)
+		{
+			DEBUGMSG("Error parsing tags\n");
+			xmlFree(doc);
+			return (-1);
+		}
+	}
+
+	if (!feof(stream))
+	{
+		DEBUGMSG("Error reading stream\n");
 		xmlFree(doc);
 		return (-1);
 	}
 
+	return (xmlParseFinish(doc));
+}
+
+
+int xmlParseFinish(xmlDocument *doc)
+{
+	// The whole document has been supplied.  Finish parsing it, and build
+	// the tree of elements.
+
+	xmlParser *parser = NULL;
+
+	// Check params
+	if (!doc || !doc->parser)
+		return (-1);
+
+	parser = doc->parser;
+
+	if (!parser->len)
+	{
+		DEBUGMSG("Empty document\n");
+		xmlFree(doc);
+		return (-1);
+	}
+
+	if (parseTags(doc, parser, 1 /* final */) < 0)
+	{
+		DEBUGMSG("Error parsing tags\n");
+		xmlFree(doc);
+		return (-1);
+	}
+
+	// Give back any unused space after the text
+	if (doc->text && (parser->textSize > doc->textLen))
+		resizeText(doc, parser, doc->textLen);
+
+	doc->rootElement.start = parser->buffer;
+	doc->rootElement.len = parser->len;
+
+	makeElementTree(&doc->rootElement);
+
+	freeParser(doc);
+
 	dumpElements(doc);
 
 	return (0);
 }
 
 
+int xmlParse(xmlDocument *doc, const char *buffer, unsigned len)
+{
+	// Parse a whole document that's already in memory.  The elements point
+	// into the caller's buffer, which has to stay around until xmlFree().
+
+	xmlParser *parser = NULL;
+
+	// Check params
+	if (!doc || !buffer || !len)
+		return (-1);
+
+	DEBUGMSG("Parse XML (%u bytes)\n", len);
+
+	if (xmlParseStart(doc) < 0)
+		return (-1);
+
+	parser = doc->parser;
+	parser->buffer = buffer;
+	parser->len = len;
+
+	return (xmlParseFinish(doc));
+}
+
+
 void xmlFree(xmlDocument *doc)
 {
-	int count;
+	arenaBlock *block = NULL;
 
 	if (doc)
 	{
-		if (doc->tag)
-			free(doc->tag);
+		freeParser(doc);
 
-		if (doc->element)
+		while (doc->arena)
 		{
-			for (count = 0; count < doc->numElements; count ++)
-			{
-				if (doc->element[count].attribute)
-					free(doc->element[count].attribute);
-			}
-
-			free(doc->element);
+			block = doc->arena;
+			doc->arena = block->next;
+			free(block);
 		}
 
+		if (doc->text)
+			free(doc->text);
+
 		memset(doc, 0, sizeof(xmlDocument));
 	}
 }
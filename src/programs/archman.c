@@ -651,7 +651,8 @@ static int querySaveModified(void)
 						_("Compressing"), &prog);
 
 					status = gzipCompressFile(baseName, archives[0].fileName,
-						NULL /* comment */, 0 /* append */, &prog);
+						NULL /* comment */, 0 /* append */, 0 /* level */,
+						&prog);
 
 					windowSwitchPointer(window, MOUSE_POINTER_DEFAULT);
 
@@ -988,7 +989,8 @@ static int reAddToParentRecursive(archive *arch)
 	if (fileFind(arch->memberName, NULL /* file */) >= 0)
 	{
 		status = archiveAddMember(arch->memberName, parent->fileName,
-			0 /* type */, NULL /* comment */, NULL /* progress */);
+			0 /* type */, NULL /* comment */, 0 /* level */,
+			NULL /* progress */);
 		if (status < 0)
 			return (status);
 	}
@@ -1034,7 +1036,7 @@ static int add(void)
 	progressDialog = windowNewProgressDialog(window, _("Adding"), &prog);
 
 	status = archiveAddRecursive(addItem, current->fileName,
-		LOADERFILESUBCLASS_TAR, NULL /* comment */, &prog);
+		LOADERFILESUBCLASS_TAR, NULL /* comment */, 0 /* level */, &prog);
 
 	if (status < 0)
 	{
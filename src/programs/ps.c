@@ -29,11 +29,21 @@
 Print all of the running processes
 
 Usage:
-  ps
+  ps [-s] [-a] [-p on|off]
 
 This command will print all of the running processes, their process IDs,
 privilege level, priority level, CPU utilization and other statistics.
 
+Options:
+-s      : Also show scheduling statistics for each process
+-a      : Show kernel API function statistics
+-p on   : Turn profiling on (resets the statistics)
+-p off  : Turn profiling off
+
+Context switch, page fault, and API call counts are always collected.  Times
+spent ready to run, blocked, and in kernel API functions are only collected
+while profiling is turned on, which requires administrator privileges.
+
 </help>
 */
 
@@ -43,19 +53,80 @@ privilege level, priority level, CPU utilization and other statistics.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/api.h>
 #include <sys/env.h>
 
 #define _(string) gettext(string)
 
 #define SHOW_MAX_PROCESSES	100
+#define SHOW_MAX_APISTATS	512
+
+
+static void printStats(int processId)
+{
+	processStats stats;
+
+	if (multitaskerGetProcessStats(processId, &stats) < 0)
+		return;
+
+	printf(_("        switches=%u/%u faults=%u calls=%u run=%llums\n"),
+		stats.voluntarySwitches, stats.involuntarySwitches,
+		stats.pageFaults, stats.apiCalls, (stats.runTime / 1000));
+
+	if (multitaskerGetProfiling())
+	{
+		printf(_("        ready=%llums blocked=%llums in API=%llums\n"),
+			(stats.readyTime / 1000), (stats.blockedTime / 1000),
+			(stats.apiTime / 1000));
+	}
+}
 
 
-int main(void)
+static int printApiStats(void)
+{
+	apiCallStats *stats = NULL;
+	int numStats = 0;
+	int count;
+
+	stats = malloc(SHOW_MAX_APISTATS * sizeof(apiCallStats));
+	if (!stats)
+	{
+		perror("malloc");
+		return (ERR_MEMORY);
+	}
+
+	numStats = multitaskerGetApiStats(stats, SHOW_MAX_APISTATS);
+	if (numStats < 0)
+	{
+		errno = numStats;
+		perror("multitaskerGetApiStats");
+		free(stats);
+		return (numStats);
+	}
+
+	printf("%s", _("API function statistics:\n"));
+	for (count = 0; count < numStats; count ++)
+	{
+		printf(_("  %05x  calls=%u time=%lluus avg=%lluus\n"),
+			stats[count].functionNumber, stats[count].calls,
+			stats[count].time, (stats[count].time / stats[count].calls));
+	}
+
+	free(stats);
+	return (0);
+}
+
+
+int main(int argc, char *argv[])
 {
 	// This command will query the kernel for a list of all active processes,
 	// and print information about them on the screen.
 
+	int status = 0;
+	char opt;
+	int showStats = 0;
+	int showApiStats = 0;
 	unsigned bufferSize = 0;
 	process *processes = NULL;
 	int numProcesses = 0;
@@ -66,6 +137,51 @@ int main(void)
 	setlocale(LC_ALL, getenv(ENV_LANG));
 	textdomain("ps");
 
+	// Check options
+	while (strchr("sap:?", (opt = getopt(argc, argv, "sap:"))))
+	{
+		switch (opt)
+		{
+			case 's':
+				// Show process statistics
+				showStats = 1;
+				break;
+
+			case 'a':
+				// Show API function statistics
+				showApiStats = 1;
+				break;
+
+			case 'p':
+				// Turn profiling on or off
+				if (!optarg || (strcmp(optarg, "on") &&
+					strcmp(optarg, "off")))
+				{
+					fprintf(stderr, "%s", _("Missing or invalid -p "
+						"argument\n"));
+					return (status = ERR_INVALID);
+				}
+
+				status = multitaskerSetProfiling(!strcmp(optarg, "on"));
+				if (status < 0)
+				{
+					errno = status;
+					perror("multitaskerSetProfiling");
+					return (status);
+				}
+
+				printf(_("Profiling is %s\n"), optarg);
+				break;
+
+			default:
+				fprintf(stderr, _("Unknown option '%c'\n"), optopt);
+				return (status = ERR_INVALID);
+		}
+	}
+
+	if (showApiStats)
+		return (status = printApiStats());
+
 	bufferSize = (SHOW_MAX_PROCESSES * sizeof(process));
 
 	processes = malloc(bufferSize);
@@ -126,6 +242,9 @@ int main(void)
 		}
 
 		printf("%s\n", lineBuffer);
+
+		if (showStats)
+			printStats(tmpProcess->processId);
 	}
 
 	free(processes);
@@ -47,7 +47,6 @@ supplied.
 #include <sys/crypt.h>
 
 #define _(string)	gettext(string)
-#define BUFFERSIZE	1048576 // Multiple of 64
 
 
 static void usage(char *name)
@@ -59,13 +58,6 @@ static void usage(char *name)
 int main(int argc, char *argv[])
 {
 	int status = 0;
-	fileStream sumFileStream;
-	unsigned sumBytes = 0;
-	unsigned buffLen = 0;
-	unsigned char *buffer = NULL;
-	int first = 1;
-	unsigned doBytes = 0;
-	unsigned doneBytes = 0;
 	unsigned char output[CRYPT_HASH_SHA1_BYTES];
 	int count1, count2;
 
@@ -77,7 +69,8 @@ int main(int argc, char *argv[])
 
 	for (count1 = 1; count1 < argc; count1 ++)
 	{
-		status = fileStreamOpen(argv[count1], OPENMODE_READ, &sumFileStream);
+		// The kernel reads and hashes the file
+		status = cryptHashSha1File(argv[count1], output);
 		if (status < 0)
 		{
 			fprintf(stderr, "%s: ", argv[0]);
@@ -86,84 +79,6 @@ int main(int argc, char *argv[])
 			return (status);
 		}
 
-		// How many bytes to read?
-		sumBytes = sumFileStream.size;
-
-		// Get a buffer for reading, at least one byte (for empty files)
-		buffLen = max(min(BUFFERSIZE, sumBytes), 1);
-		buffer = calloc(buffLen, 1);
-		if (!buffer)
-		{
-			status = errno;
-			perror("calloc");
-			return (status);
-		}
-
-		first = 1;
-
-		do
-		{
-			doBytes = min(buffLen, sumBytes);
-
-			// Read data
-			doneBytes = 0;
-			if (doBytes)
-			{
-				status = fileStreamRead(&sumFileStream, doBytes, (char *)
-					buffer);
-				if (status < 0)
-				{
-					errno = status;
-					perror("fileStreamRead");
-					fileStreamClose(&sumFileStream);
-					free(buffer);
-					return (status);
-				}
-
-				doneBytes = status;
-			}
-
-			sumBytes -= doneBytes;
-
-			// Hash
-			if (first)
-			{
-				status = cryptHashSha1(buffer, doneBytes, output,
-					(sumBytes == 0) /* finalize? */, sumFileStream.size);
-				if (status < 0)
-				{
-					errno = status;
-					perror("cryptHashSha1");
-				}
-
-				first = 0;
-			}
-			else
-			{
-				status = cryptHashSha1Cont(buffer, doneBytes, output,
-					(sumBytes == 0) /* finalize? */, sumFileStream.size);
-				if (status < 0)
-				{
-					errno = status;
-					perror("cryptHashSha1Cont");
-				}
-			}
-
-			// Scrub
-			memset(buffer, 0, doneBytes);
-
-			if (status < 0)
-			{
-				fileStreamClose(&sumFileStream);
-				free(buffer);
-				return (status);
-			}
-
-		} while (sumBytes);
-
-		fileStreamClose(&sumFileStream);
-		free(buffer);
-
 		for (count2 = 0; count2 < CRYPT_HASH_SHA1_BYTES; count2 ++)
 			printf("%02x", output[count2]);
 
@@ -110,6 +110,7 @@ static objectKey scoreLabel = NULL;
 static objectKey treatImage = NULL;
 static objectKey treatLabel = NULL;
 static objectKey canvas = NULL;
+static windowCanvasBuffer canvasBuffer;
 static objectKey changeDirLabel = NULL;
 
 
@@ -145,35 +146,21 @@ static void getRandomEmpty(coord *c)
 
 static void clearImage(coord *c)
 {
-	windowDrawParameters drawParams;
-
-	memset(&drawParams, 0, sizeof(windowDrawParameters));
-	drawParams.operation = draw_rect;
-	drawParams.mode = draw_normal;
-	drawParams.xCoord1 = (c->x * imageWidth);
-	drawParams.yCoord1 = (c->y * imageHeight);
-	drawParams.width = imageWidth;
-	drawParams.height = imageHeight;
-	drawParams.thickness = 1;
-	drawParams.fill = 1;
-	drawParams.foreground.red = 255;
-	drawParams.foreground.green = 255;
-	drawParams.foreground.blue = 255;
-	windowComponentSetData(canvas, &drawParams, 1, 1 /* redraw */);
+	// Drawing goes directly into the mapped canvas buffer, and appears on
+	// the screen when we present it, once per move
+
+	color white = { 255, 255, 255 };
+
+	windowCanvasBufferDrawRect(&canvasBuffer, &white, draw_normal,
+		(c->x * imageWidth), (c->y * imageHeight), imageWidth, imageHeight,
+		1 /* thickness */, 1 /* fill */);
 }
 
 
 static void putImage(coord *c, imageEnum ie)
 {
-	windowDrawParameters drawParams;
-
-	memset(&drawParams, 0, sizeof(windowDrawParameters));
-	drawParams.operation = draw_image;
-	drawParams.mode = draw_translucent;
-	drawParams.xCoord1 = (c->x * imageWidth);
-	drawParams.yCoord1 = (c->y * imageHeight);
-	drawParams.data = &images[ie];
-	windowComponentSetData(canvas, &drawParams, 1, 1 /* redraw */);
+	windowCanvasBufferDrawImage(&canvasBuffer, &images[ie], draw_translucent,
+		(c->x * imageWidth), (c->y * imageHeight));
 }
 
 
@@ -771,7 +758,6 @@ static int constructWindow(void)
 {
 	int status = 0;
 	componentParameters params;
-	windowDrawParameters drawParams;
 	int count;
 
 	// Try to load all the images
@@ -845,18 +831,14 @@ static int constructWindow(void)
 	windowSetResizable(window, 0);
 	windowSetVisible(window, 1);
 
+	// Map the canvas buffer so that we can draw directly into it
+	windowCanvasBufferMap(canvas, &canvasBuffer);
+
 	// Clear the background of the canvas
-	memset(&drawParams, 0, sizeof(windowDrawParameters));
-	drawParams.operation = draw_rect;
-	drawParams.mode = draw_normal;
-	drawParams.width = (screenWidth * imageWidth);
-	drawParams.height = (screenHeight * imageHeight);
-	drawParams.thickness = 1;
-	drawParams.fill = 1;
-	drawParams.foreground.red = 255;
-	drawParams.foreground.green = 255;
-	drawParams.foreground.blue = 255;
-	windowComponentSetData(canvas, &drawParams, 1, 1 /* redraw */);
+	windowCanvasBufferDrawRect(&canvasBuffer, &params.background, draw_normal,
+		0, 0, (screenWidth * imageWidth), (screenHeight * imageHeight),
+		1 /* thickness */, 1 /* fill */);
+	windowCanvasBufferPresent(&canvasBuffer);
 
 	return (status = 0);
 }
@@ -875,6 +857,9 @@ static int play(void)
 	// Make the first food
 	makeFood();
 
+	if (graphics)
+		windowCanvasBufferPresent(&canvasBuffer);
+
 	run = 1;
 
 	while (run)
@@ -909,6 +894,7 @@ static int play(void)
 		sprintf(tmpChar, "%04d", score);
 		if (graphics)
 		{
+			windowCanvasBufferPresent(&canvasBuffer);
 			windowComponentSetData(scoreLabel, tmpChar, strlen(tmpChar),
 				1 /* redraw */);
 		}
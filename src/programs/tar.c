@@ -250,8 +250,8 @@ int main(int argc, char *argv[])
 			if (add)
 			{
 				status = archiveAddRecursive(argv[count], archive,
-					LOADERFILESUBCLASS_TAR, NULL /* comment */, (showProgress?
-						&prog : NULL));
+					LOADERFILESUBCLASS_TAR, NULL /* comment */, 0 /* level */,
+					(showProgress? &prog : NULL));
 			}
 			else if (delete)
 			{
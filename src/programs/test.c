@@ -24,14 +24,20 @@
 #include <ctype.h>
 #include <dlfcn.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/api.h>
+#include <sys/compress.h>
+#include <sys/crypt.h>
 #include <sys/font.h>
+#include <sys/http.h>
 #include <sys/paths.h>
 #include <sys/processor.h>
+#include <sys/socket.h>
+#include <sys/xml.h>
 
 // Tests should save/restore the text screen if they (deliberately) spew
 // output or errors.
@@ -482,1363 +488,3524 @@ out:
 }
 
 
-static int text_output(void)
-{
-	// Does a bunch of text-output testing.
+static volatile struct {
+	int turn;
+	int rounds;
+	int stop;
 
-	int status = 0;
-	int columns = 0;
-	int rows = 0;
-	int screenFulls = 0;
-	int bufferSize = 0;
-	char *buffer = NULL;
-	int length = 0;
-	int count;
+} pingPongData;
 
-	// Save the current text screen
-	status = textScreenSave(&screen);
-	if (status < 0)
-		goto out;
 
-	columns = textGetNumColumns();
-	if (columns < 0)
-	{
-		status = columns;
-		goto out;
-	}
+static int pingPongThread(void)
+{
+	// Hand the ball back each time the main thread serves it
 
-	rows = textGetNumRows();
-	if (rows < 0)
+	while (!pingPongData.stop)
 	{
-		status = rows;
-		goto out;
+		if (pingPongData.turn)
+		{
+			pingPongData.turn = 0;
+			pingPongData.rounds += 1;
+		}
+
+		multitaskerYield();
 	}
 
-	// How many screenfulls of data?
-	screenFulls = 5;
+	exit(0);
+}
 
-	// Allocate a buffer
-	bufferSize = (columns * rows * screenFulls);
-	buffer = malloc(bufferSize);
-	if (!buffer)
-	{
-		FAILMSG("Error getting memory");
-		status = ERR_MEMORY;
-		goto out;
-	}
 
-	// Fill it with random printable data
-	for (count = 0; count < bufferSize; count ++)
-	{
-		buffer[count] = (char) randomFormatted(32, 126);
+static int context_switch(void)
+{
+	// Benchmark context switches by ping-ponging between two threads, each
+	// of which yields until the other has taken its turn
 
-		// We don't want '%' format characters 'cause that could cause
-		// unpredictable results
-		if (buffer[count] == '%')
-		{
-			count -= 1;
-			continue;
-		}
-	}
+	#define PINGPONG_ROUNDS		10000
+	#define PINGPONG_TIMEOUT	10000 // ms
 
-	// Randomly sprinkle newlines and tabs
-	for (count = 0; count < (screenFulls * 10); count ++)
-	{
-		buffer[randomFormatted(0, (bufferSize - 1))] = '\n';
-		buffer[randomFormatted(0, (bufferSize - 1))] = '\t';
-	}
+	int status = 0;
+	int procId = 0;
+	unsigned switches = 0;
+	uquad_t startMs = 0, elapsedMs = 0;
+	int count;
 
-	// Print the buffer
-	for (count = 0; count < bufferSize; count ++)
+	memset((void *) &pingPongData, 0, sizeof(pingPongData));
+
+	procId = multitaskerSpawn(&pingPongThread, "ping pong thread",
+		0 /* no args */, NULL /* no args */, 1 /* run */);
+	if (procId < 0)
 	{
-		if (buffer[count] == (char) 9)
-		{
-			// Tab character
-			status = textTab();
-			if (status < 0)
-				goto out;
-		}
-		else if (buffer[count] == (char) 10)
-		{
-			// Newline character
-			textNewline();
-		}
-		else
-		{
-			status = textPutc(buffer[count]);
-			if (status < 0)
-				goto out;
-		}
+		FAILMSG("Couldn't spawn ping pong thread");
+		return (status = procId);
 	}
 
-	// Stick in a bunch of NULLs
-	for (count = 0; count < (screenFulls * 30); count ++)
-		buffer[randomFormatted(0, (bufferSize - 1))] = '\0';
-
-	buffer[bufferSize - 1] = '\0';
+	startMs = cpuGetMs();
 
-	// Print the buffer again as lines
-	for (count = 0; count < bufferSize; )
+	for (count = 0; count < PINGPONG_ROUNDS; count ++)
 	{
-		length = strlen(buffer + count);
-		if (length < 0)
+		pingPongData.turn = 1;
+
+		while (pingPongData.turn)
 		{
-			// Maybe we made a string that's too long
-			buffer[count + MAXSTRINGLENGTH] = '\0';
+			multitaskerYield();
 
-			length = strlen(buffer + count);
-			if (length < 0)
+			if ((cpuGetMs() - startMs) > PINGPONG_TIMEOUT)
 			{
-				status = length;
+				FAILMSG("Ping pong thread stopped responding");
+				status = ERR_TIMEOUT;
 				goto out;
 			}
 		}
+	}
 
-		status = textPrintLine(buffer + count);
-		if (status < 0)
-			goto out;
+	elapsedMs = max((cpuGetMs() - startMs), 1);
 
-		if (length)
-			count += length;
-		else
-			count += 1;
-	}
+	// Each round is a switch there and a switch back
+	switches = (pingPongData.rounds * 2);
+
+	printf("%u switches/s %u us/switch ",
+		(unsigned)((switches * 1000ULL) / elapsedMs),
+		(unsigned)((elapsedMs * 1000) / switches));
 
-	sleep(3);
 	status = 0;
 
 out:
-	if (buffer)
-		free(buffer);
+	pingPongData.stop = 1;
 
-	// Restore the text screen
-	textScreenRestore(&screen);
+	while (multitaskerProcessIsAlive(procId))
+		multitaskerYield();
 
 	return (status);
 }
 
 
-static int text_colors(void)
+static int sleep_accuracy(void)
 {
-	// Tests the setting/printing of text colors.
+	// Check that short sleeps last at least as long as requested, and report
+	// how long after their deadlines they wake up, on average and at worst
+
+	#define SLEEP_REPEATS		20
 
 	int status = 0;
-	int columns = 0;
-	color foreground;
-	char *buffer = NULL;
-	color tmpColor;
-	textAttrs attrs;
-	int count1, count2;
+	unsigned delays[] = { 100, 250, 500, 1000, 2000, 5000 };
+	uquad_t startUs = 0, elapsedUs = 0;
+	unsigned lateUs = 0, totalLateUs = 0, maxLateUs = 0;
+	unsigned count1, count2;
 
-	color allColors[16] = {
-		COLOR_BLACK, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, COLOR_RED,
-		COLOR_MAGENTA, COLOR_BROWN, COLOR_LIGHTGRAY, COLOR_DARKGRAY,
-		COLOR_LIGHTBLUE, COLOR_LIGHTGREEN, COLOR_LIGHTCYAN, COLOR_LIGHTRED,
-		COLOR_LIGHTMAGENTA, COLOR_YELLOW, COLOR_WHITE
-	};
+	for (count1 = 0; count1 < (sizeof(delays) / sizeof(unsigned)); count1 ++)
+	{
+		totalLateUs = maxLateUs = 0;
 
-	// Save the current text screen
-	status = textScreenSave(&screen);
-	if (status < 0)
-		goto out;
+		for (count2 = 0; count2 < SLEEP_REPEATS; count2 ++)
+		{
+			startUs = cpuGetUs();
+			usleep(delays[count1]);
+			elapsedUs = (cpuGetUs() - startUs);
 
-	columns = textGetNumColumns();
-	if (columns < 0)
-	{
-		status = columns;
-		goto out;
-	}
+			if (elapsedUs < delays[count1])
+			{
+				FAILMSG("usleep(%u) returned after %u us", delays[count1],
+					(unsigned) elapsedUs);
+				return (status = ERR_BUG);
+			}
 
-	// Save the current foreground color
-	status = textGetForeground(&foreground);
-	if (status < 0)
-		goto out;
+			lateUs = (unsigned)(elapsedUs - delays[count1]);
+			totalLateUs += lateUs;
+			maxLateUs = max(maxLateUs, lateUs);
+		}
 
-	buffer = malloc(columns);
-	if (!buffer)
-	{
-		FAILMSG("Error getting memory");
-		status = ERR_MEMORY;
-		goto out;
+		printf("%uus:+%u/%u ", delays[count1], (totalLateUs / SLEEP_REPEATS),
+			maxLateUs);
 	}
 
-	for (count1 = 0; count1 < (columns - 1); count1 ++)
-		buffer[count1] = '#';
+	return (status = 0);
+}
 
-	buffer[columns - 1] = '\0';
 
-	textNewline();
+#define SCALING_MAX_THREADS		16
 
-	for (count1 = 0; count1 < 16; count1 ++)
+static volatile int scalingProcIds[SCALING_MAX_THREADS];
+static volatile unsigned scalingResults[SCALING_MAX_THREADS];
+
+
+static int scalingThread(void)
+{
+	// A fixed amount of CPU-bound work, which doesn't call the kernel.  The
+	// result goes in our slot, so the main thread can check that every
+	// thread did all of its work.
+
+	#define SCALING_LOOPS		20000000
+
+	unsigned value = 2463534242U;
+	int processId = multitaskerGetCurrentProcessId();
+	int count;
+
+	for (count = 0; count < SCALING_LOOPS; count ++)
 	{
-		status = textSetForeground(&allColors[count1]);
-		if (status < 0)
-		{
-			FAILMSG("Failed to set the foreground color");
-			goto out;
-		}
+		value ^= (value << 13);
+		value ^= (value >> 17);
+		value ^= (value << 5);
+	}
 
-		status = textGetForeground(&tmpColor);
-		if (status < 0)
+	for (count = 0; count < SCALING_MAX_THREADS; count ++)
+	{
+		if (scalingProcIds[count] == processId)
 		{
-			FAILMSG("Failed to get the foreground color");
-			goto out;
+			scalingResults[count] = value;
+			break;
 		}
+	}
 
-		if (memcmp(&allColors[count1], &tmpColor, sizeof(color)))
-		{
-			FAILMSG("Foreground color not set correctly");
-			status = ERR_INVALID;
-			goto out;
-		}
+	exit(0);
+}
 
-		textPrintLine(buffer);
+
+static int scalingRun(int threads, uquad_t *elapsedMs)
+{
+	// Run the work in the requested number of threads at once, and time how
+	// long it takes all of them to finish
+
+	int status = 0;
+	uquad_t startMs = 0;
+	int count;
+
+	threads = min(threads, SCALING_MAX_THREADS);
+
+	for (count = 0; count < SCALING_MAX_THREADS; count ++)
+	{
+		scalingProcIds[count] = 0;
+		scalingResults[count] = 0;
 	}
 
-	for (count1 = 0; count1 < 16; count1 ++)
+	for (count = 0; count < threads; count ++)
 	{
-		for (count2 = 0; count2 < 16; count2 ++)
+		scalingProcIds[count] = multitaskerSpawn(&scalingThread,
+			"scaling thread", 0 /* no args */, NULL /* no args */,
+			0 /* don't run */);
+		if (scalingProcIds[count] < 0)
 		{
-			memset(&attrs, 0, sizeof(textAttrs));
-			attrs.flags = (TEXT_ATTRS_FOREGROUND | TEXT_ATTRS_BACKGROUND);
-			memcpy(&attrs.foreground, &allColors[count1], sizeof(color));
-			memcpy(&attrs.background, &allColors[count2], sizeof(color));
-			textPrintAttrs(&attrs, buffer);
-			textPrintLine("");
+			FAILMSG("Couldn't spawn scaling thread");
+			status = scalingProcIds[count];
+			while (--count >= 0)
+				multitaskerKillProcess(scalingProcIds[count]);
+			return (status);
 		}
 	}
 
-	textNewline();
-
-	sleep(3);
-	status = 0;
+	startMs = cpuGetMs();
 
-out:
-	if (buffer)
-		free(buffer);
+	for (count = 0; count < threads; count ++)
+		multitaskerSetProcessState(scalingProcIds[count], proc_ready);
 
-	// Restore old foreground color
-	textSetForeground(&foreground);
+	for (count = 0; count < threads; count ++)
+	{
+		if (multitaskerProcessIsAlive(scalingProcIds[count]))
+			multitaskerBlock(scalingProcIds[count]);
+	}
 
-	// Restore the text screen
-	textScreenRestore(&screen);
+	*elapsedMs = max((cpuGetMs() - startMs), 1);
 
-	return (status);
+	return (status = 0);
 }
 
 
-static int xtra_chars(void)
+static int smp_scaling(void)
 {
-	// Just print out the 'extended ASCII' (actually ISO-8859-15) characters
-	// so we can see whether or not they're appearing properly in our fonts
+	// Time a CPU-bound job in one thread, and then the same job in a thread
+	// for each processor, which should take about the same time if they're
+	// really running at once.  With only one processor, 2 threads should take
+	// about twice as long.  Every thread must come up with the same answer as
+	// the first one.
 
 	int status = 0;
-	int graphics = graphicsAreEnabled();
-	objectKey window = NULL;
-	componentParameters params;
-	char lineBuffer[80];
+	int cpus = 0;
+	int threads = 0;
+	uquad_t oneMs = 0, allMs = 0;
+	unsigned expect = 0;
+	unsigned speedup = 0;
 	int count;
 
-	// Save the current text screen
-	status = textScreenSave(&screen);
+	cpus = cpuGetCount();
+	if (cpus < 1)
+	{
+		FAILMSG("Couldn't get the number of processors");
+		return (status = ERR_BUG);
+	}
+
+	threads = min(max(cpus, 2), SCALING_MAX_THREADS);
+
+	status = scalingRun(1, &oneMs);
 	if (status < 0)
-		goto out;
+		return (status);
 
-	if (graphics)
+	expect = scalingResults[0];
+	if (!expect)
 	{
-		// Create a new window
-		window = windowNew(multitaskerGetCurrentProcessId(), "Xtra chars "
-			"test window");
-		if (!window)
+		FAILMSG("Scaling thread didn't finish its work");
+		return (status = ERR_BUG);
+	}
+
+	status = scalingRun(threads, &allMs);
+	if (status < 0)
+		return (status);
+
+	for (count = 0; count < threads; count ++)
+	{
+		if (scalingResults[count] != expect)
 		{
-			FAILMSG("Error getting window");
-			status = ERR_NOTINITIALIZED;
-			goto out;
+			FAILMSG("Scaling thread %d result %08x, expected %08x", count,
+				scalingResults[count], expect);
+			return (status = ERR_BUG);
 		}
+	}
 
-		memset(&params, 0, sizeof(componentParameters));
-		params.gridWidth = 1;
-		params.gridHeight = 1;
-		params.padLeft = 5;
-		params.padRight = 5;
-		params.padTop = 5;
-		params.padBottom = 5;
-		params.orientationX = orient_center;
-		params.orientationY = orient_middle;
-		params.font = fontGet(FONT_FAMILY_XTERM, FONT_STYLEFLAG_NORMAL, 10,
-			NULL);
-		if (!params.font)
-		{
-			FAILMSG("Error %d getting font", status);
-			goto out;
-		}
-	}
+	// The speedup is the amount of work per unit of time, relative to one
+	// thread, times 100
+	speedup = (unsigned)((threads * oneMs * 100) / allMs);
 
-	printf("\n");
+	printf("%d cpu%s 1:%ums %d:%ums x%u.%02u ", cpus, ((cpus > 1)? "s" : ""),
+		(unsigned) oneMs, threads, (unsigned) allMs, (speedup / 100),
+		(speedup % 100));
 
-	lineBuffer[0] = '\0';
-	for (count = 160; count <= 255; count ++)
-	{
-		sprintf((lineBuffer + strlen(lineBuffer)), "%d='%c' ", count, count);
-		if (!((count + 1) % 8))
-		{
-			printf("%s\n", lineBuffer);
+	return (status = 0);
+}
 
-			if (window)
-			{
-				windowNewTextLabel(window, lineBuffer, &params);
-				params.gridY += 1;
-			}
 
-			lineBuffer[0] = '\0';
-		}
-	}
+static pthread_mutex_t pthreadsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pthreadsCond = PTHREAD_COND_INITIALIZER;
+static volatile int pthreadsCounter = 0;
+static volatile int pthreadsTurn = 0;
 
-	printf("\n");
 
-	if (window)
+static void *pthreadsCountThread(void *arg __attribute__((unused)))
+{
+	// Increment the shared counter under the mutex, yielding while holding
+	// it now and then to make sure the others contend for it
+
+	#define PTHREADS_LOOPS		20000
+
+	int value = 0;
+	int count;
+
+	for (count = 0; count < PTHREADS_LOOPS; count ++)
 	{
-		status = windowSetVisible(window, 1);
-		if (status < 0)
-		{
-			FAILMSG("Error %d setting window visible", status);
-			goto out;
-		}
+		pthread_mutex_lock(&pthreadsMutex);
+
+		value = pthreadsCounter;
+		if (!(count % 1000))
+			multitaskerYield();
+		pthreadsCounter = (value + 1);
+
+		pthread_mutex_unlock(&pthreadsMutex);
 	}
 
-	sleep(3);
-	status = 0;
+	return (NULL);
+}
 
-out:
-	// Restore the text screen
-	textScreenRestore(&screen);
 
-	if (window)
-		windowDestroy(window);
+static void *pthreadsPingThread(void *arg __attribute__((unused)))
+{
+	// Take turns with the main thread, using the condition variable
 
-	return (status);
+	#define PTHREADS_TURNS		100
+
+	int count;
+
+	pthread_mutex_lock(&pthreadsMutex);
+
+	for (count = 0; count < PTHREADS_TURNS; count ++)
+	{
+		while (!(pthreadsTurn & 1))
+			pthread_cond_wait(&pthreadsCond, &pthreadsMutex);
+
+		pthreadsTurn += 1;
+		pthread_cond_signal(&pthreadsCond);
+	}
+
+	pthread_mutex_unlock(&pthreadsMutex);
+
+	return (NULL);
 }
 
 
-static int port_io(void)
+static int pthreads(void)
 {
-	// Test IO ports & related stuff!  Davide Airaghi
+	// Test the POSIX thread mutexes and condition variables
 
-	int pid = 0;
-	int setClear = 0;
-	unsigned portN = 0;
-	int res = 0;
-	unsigned char ch __attribute__((unused));
+	#define PTHREADS_THREADS	4
+	#define PTHREADS_TIMEOUT_MS	50
+
+	int status = 0;
+	pthread_t threads[PTHREADS_THREADS];
+	struct timespec abstime;
+	uquad_t startMs = 0, elapsedMs = 0;
 	int count;
 
-	pid = multitaskerGetCurrentProcessId();
-	if (pid < 0)
+	// Several threads incrementing a counter
+
+	pthreadsCounter = 0;
+
+	for (count = 0; count < PTHREADS_THREADS; count ++)
 	{
-		FAILMSG("Error %d getting PID", res);
-		goto fail;
+		status = pthread_create(&threads[count], NULL, &pthreadsCountThread,
+			NULL);
+		if (status)
+		{
+			FAILMSG("Couldn't create thread");
+			while (--count >= 0)
+				pthread_cancel(threads[count]);
+			return (status);
+		}
 	}
 
-	for (count = 0; count < 65535; count ++)
+	for (count = 0; count < PTHREADS_THREADS; count ++)
+		pthread_join(threads[count], NULL);
+
+	if (pthreadsCounter != (PTHREADS_THREADS * PTHREADS_LOOPS))
 	{
-		portN = randomFormatted(0, 65535);
-		setClear = ((rand() % 2) == 0);
+		FAILMSG("Counter is %d, not %d", pthreadsCounter,
+			(PTHREADS_THREADS * PTHREADS_LOOPS));
+		return (status = ERR_BUG);
+	}
 
-		res = multitaskerSetIoPerm(pid, portN, setClear);
-		if (res < 0)
-		{
-			FAILMSG("Error %d setting perms on port %d", res, portN);
-			goto fail;
-		}
+	// Hand the turn back and forth with another thread
 
-		if (setClear)
-		{
-			// Read from the port
-			processorInPort8(portN, ch);
-		}
+	pthreadsTurn = 0;
 
-		// Clear permissions again
-		res = multitaskerSetIoPerm(pid, portN, 0);
-		if (res < 0)
-		{
-			FAILMSG("Error %d clearing perms on port %d", res, portN);
-			goto fail;
-		}
+	status = pthread_create(&threads[0], NULL, &pthreadsPingThread, NULL);
+	if (status)
+	{
+		FAILMSG("Couldn't create thread");
+		return (status);
 	}
 
-	return (0);
+	pthread_mutex_lock(&pthreadsMutex);
 
-fail:
-	return (-1);
-}
+	for (count = 0; count < PTHREADS_TURNS; count ++)
+	{
+		while (pthreadsTurn & 1)
+			pthread_cond_wait(&pthreadsCond, &pthreadsMutex);
 
+		pthreadsTurn += 1;
+		pthread_cond_signal(&pthreadsCond);
+	}
 
-static int disk_reads(disk *theDisk)
-{
-	int status = 0;
-	unsigned startSector = 0;
-	unsigned numSectors = 0;
-	unsigned char *buffer = NULL;
-	int count;
+	while (pthreadsTurn < (PTHREADS_TURNS * 2))
+		pthread_cond_wait(&pthreadsCond, &pthreadsMutex);
 
-	printf("\nTest reads from disk %s, numSectors %llu ", theDisk->name,
-		theDisk->numSectors);
+	pthread_mutex_unlock(&pthreadsMutex);
 
-	for (count = 0; count < 1024; count ++)
+	pthread_join(threads[0], NULL);
+
+	// A wait that nobody signals should time out
+
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_nsec += (PTHREADS_TIMEOUT_MS * NS_PER_MS);
+	if (abstime.tv_nsec >= NS_PER_SEC)
 	{
-		numSectors = randomFormatted(1, min(theDisk->numSectors, 512));
-		startSector = randomFormatted(0, (theDisk->numSectors - numSectors -
-			1));
+		abstime.tv_sec += 1;
+		abstime.tv_nsec -= NS_PER_SEC;
+	}
 
-		buffer = malloc(numSectors * theDisk->sectorSize);
-		if (!buffer)
-		{
-			FAILMSG("Error getting %u bytes disk %s buffer memory",
-				(numSectors * theDisk->sectorSize), theDisk->name);
-			return (status = ERR_MEMORY);
-		}
+	startMs = cpuGetMs();
 
-		status = diskReadSectors(theDisk->name, startSector, numSectors,
-			buffer);
+	pthread_mutex_lock(&pthreadsMutex);
+	status = pthread_cond_timedwait(&pthreadsCond, &pthreadsMutex, &abstime);
+	pthread_mutex_unlock(&pthreadsMutex);
 
-		free(buffer);
+	elapsedMs = (cpuGetMs() - startMs);
 
-		if (status < 0)
-		{
-			FAILMSG("Error %d reading %u sectors at %u on %s", status,
-				numSectors, startSector, theDisk->name);
-			return (status);
-		}
+	if (status != ETIMEDOUT)
+	{
+		FAILMSG("Timed wait returned %d, not ETIMEDOUT", status);
+		return (status = ERR_BUG);
 	}
 
+	if (elapsedMs < (PTHREADS_TIMEOUT_MS / 2))
+	{
+		FAILMSG("Timed wait returned after %ums", (unsigned) elapsedMs);
+		return (status = ERR_BUG);
+	}
+
+	printf("%d threads, %d turns, timeout %ums ", PTHREADS_THREADS,
+		PTHREADS_TURNS, (unsigned) elapsedMs);
+
 	return (status = 0);
 }
 
 
-static int disk_io(void)
+static int copy_on_write(void)
 {
-	// Test disk IO reads
+	// Test copy-on-write copies of memory blocks
+
+	#define COW_BYTES	(256 * 1024)
 
 	int status = 0;
-	char diskName[DISK_MAX_NAMELENGTH + 1];
-	disk theDisk;
-	int count = 0;
+	unsigned char *buffer = NULL;
+	unsigned char *copy = NULL;
+	int count;
 
-	// Save the current text screen
-	status = textScreenSave(&screen);
-	if (status < 0)
-		goto fail;
+	buffer = memoryGet(COW_BYTES, "copy-on-write test");
+	if (!buffer)
+	{
+		FAILMSG("Couldn't get memory");
+		return (status = ERR_MEMORY);
+	}
 
-	// Get the logical boot disk name
-	status = diskGetBoot(diskName);
-	if (status < 0)
+	for (count = 0; count < COW_BYTES; count ++)
+		buffer[count] = (unsigned char) count;
+
+	// Give ourselves the copy
+	copy = memoryCopyToProcess(buffer, multitaskerGetCurrentProcessId());
+	if (!copy || (copy == buffer))
 	{
-		FAILMSG("Error %d getting disk name", status);
-		goto fail;
+		FAILMSG("Couldn't copy memory");
+		status = ERR_MEMORY;
+		goto out;
 	}
 
-	for (count = 0; count < (DISK_MAX_PARTITIONS + 1); count ++)
+	if (memcmp(copy, buffer, COW_BYTES))
 	{
-		// Take off any partition letter, so that we have the name of the
-		// whole physical disk.
-		if (isalpha(diskName[strlen(diskName) - 1]))
-			diskName[strlen(diskName) - 1] = '\0';
+		FAILMSG("Copy doesn't match");
+		status = ERR_BUG;
+		goto out;
+	}
 
-		if (count)
-		{
-			// Add a partition letter
-			sprintf((diskName + strlen(diskName)), "%c", ('a' + count - 1));
-		}
+	// Writing to the copy mustn't change the original
+	memset(copy, 0xAA, COW_BYTES);
 
-		// Get the disk info
-		status = diskGet(diskName, &theDisk);
-		if (status < 0)
+	for (count = 0; count < COW_BYTES; count ++)
+	{
+		if (buffer[count] != (unsigned char) count)
 		{
-			// No such disk.  Fine.
-			break;
+			FAILMSG("Original changed at offset %d", count);
+			status = ERR_BUG;
+			goto out;
 		}
+	}
 
-		// Do random reads
-		status = disk_reads(&theDisk);
-		if (status < 0)
-			goto fail;
+	// The original is the last reference now, and still writable
+	memset(buffer, 0x55, COW_BYTES);
+
+	if ((buffer[0] != 0x55) || (copy[0] != 0xAA))
+	{
+		FAILMSG("Writes went to the wrong memory");
+		status = ERR_BUG;
+		goto out;
 	}
 
+	printf("%dKB ", (COW_BYTES / 1024));
+
 	status = 0;
 
-fail:
-	// Restore the text screen
-	textScreenRestore(&screen);
+out:
+	if (copy)
+		memoryRelease(copy);
+	memoryRelease(buffer);
 
 	return (status);
 }
 
 
-static int file_recurse(const char *dirPath, unsigned startTime)
+static int process_stats(void)
 {
+	// Test the per-process scheduling statistics
+
 	int status = 0;
-	file theFile;
-	int numFiles = 0;
-	int fileNum = 0;
-	char relPath[MAX_PATH_NAME_LENGTH + 1];
-	unsigned op = 0;
-	char newPath[MAX_PATH_NAME_LENGTH + 1];
+	int processId = multitaskerGetCurrentProcessId();
+	processStats before, after;
 	int count;
 
-	// Initialize the file structure
-	memset(&theFile, 0, sizeof(file));
+	status = multitaskerGetProcessStats(processId, &before);
+	if (status < 0)
+	{
+		FAILMSG("Error %d getting stats", status);
+		return (status);
+	}
 
-	// Loop through the contents of the directory
-	while (rtcUptimeSeconds() < (startTime + 30))
+	for (count = 0; count < 10; count ++)
+		multitaskerWaitUs(1000);
+
+	status = multitaskerGetProcessStats(processId, &after);
+	if (status < 0)
 	{
-		numFiles = fileCount(dirPath);
-		if (numFiles <= 0)
-		{
-			FAILMSG("Error %d getting directory %s file count", numFiles,
-				dirPath);
-			return (numFiles);
-		}
+		FAILMSG("Error %d getting stats", status);
+		return (status);
+	}
 
-		if (numFiles <= 2)
-			return (status = 0);
+	if (after.processId != processId)
+	{
+		FAILMSG("Wrong process ID %d", after.processId);
+		return (status = ERR_BUG);
+	}
 
-		fileNum = randomFormatted(2, (numFiles - 1));
-		for (count = 0; count <= fileNum; count ++)
-		{
-			if (!count)
-			{
-				// Get the first item in the directory
-				status = fileFirst(dirPath, &theFile);
-				if (status < 0)
-				{
-					FAILMSG("Error %d finding first file in %s", status,
-						dirPath);
-					return (status);
-				}
-			}
-			else
+	// Each wait is an API call, and gives up the processor
+	if ((after.apiCalls - before.apiCalls) < 11)
+	{
+		FAILMSG("Counted %u API calls", (after.apiCalls - before.apiCalls));
+		return (status = ERR_BUG);
+	}
+
+	if ((after.voluntarySwitches - before.voluntarySwitches) < 10)
+	{
+		FAILMSG("Counted %u voluntary switches",
+			(after.voluntarySwitches - before.voluntarySwitches));
+		return (status = ERR_BUG);
+	}
+
+	return (status = 0);
+}
+
+
+static int text_output(void)
+{
+	// Does a bunch of text-output testing.
+
+	int status = 0;
+	int columns = 0;
+	int rows = 0;
+	int screenFulls = 0;
+	int bufferSize = 0;
+	char *buffer = NULL;
+	int length = 0;
+	int count;
+
+	// Save the current text screen
+	status = textScreenSave(&screen);
+	if (status < 0)
+		goto out;
+
+	columns = textGetNumColumns();
+	if (columns < 0)
+	{
+		status = columns;
+		goto out;
+	}
+
+	rows = textGetNumRows();
+	if (rows < 0)
+	{
+		status = rows;
+		goto out;
+	}
+
+	// How many screenfulls of data?
+	screenFulls = 5;
+
+	// Allocate a buffer
+	bufferSize = (columns * rows * screenFulls);
+	buffer = malloc(bufferSize);
+	if (!buffer)
+	{
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	// Fill it with random printable data
+	for (count = 0; count < bufferSize; count ++)
+	{
+		buffer[count] = (char) randomFormatted(32, 126);
+
+		// We don't want '%' format characters 'cause that could cause
+		// unpredictable results
+		if (buffer[count] == '%')
+		{
+			count -= 1;
+			continue;
+		}
+	}
+
+	// Randomly sprinkle newlines and tabs
+	for (count = 0; count < (screenFulls * 10); count ++)
+	{
+		buffer[randomFormatted(0, (bufferSize - 1))] = '\n';
+		buffer[randomFormatted(0, (bufferSize - 1))] = '\t';
+	}
+
+	// Print the buffer
+	for (count = 0; count < bufferSize; count ++)
+	{
+		if (buffer[count] == (char) 9)
+		{
+			// Tab character
+			status = textTab();
+			if (status < 0)
+				goto out;
+		}
+		else if (buffer[count] == (char) 10)
+		{
+			// Newline character
+			textNewline();
+		}
+		else
+		{
+			status = textPutc(buffer[count]);
+			if (status < 0)
+				goto out;
+		}
+	}
+
+	// Stick in a bunch of NULLs
+	for (count = 0; count < (screenFulls * 30); count ++)
+		buffer[randomFormatted(0, (bufferSize - 1))] = '\0';
+
+	buffer[bufferSize - 1] = '\0';
+
+	// Print the buffer again as lines
+	for (count = 0; count < bufferSize; )
+	{
+		length = strlen(buffer + count);
+		if (length < 0)
+		{
+			// Maybe we made a string that's too long
+			buffer[count + MAXSTRINGLENGTH] = '\0';
+
+			length = strlen(buffer + count);
+			if (length < 0)
 			{
-				status = fileNext(dirPath, &theFile);
-				if (status < 0)
-				{
-					FAILMSG("Error %d finding next file after %s in %s",
-						status, theFile.name, dirPath);
-					return (status);
-				}
+				status = length;
+				goto out;
 			}
 		}
 
-		// Construct the relative pathname for this item
-		sprintf(relPath, "%s/%s", dirPath, theFile.name);
+		status = textPrintLine(buffer + count);
+		if (status < 0)
+			goto out;
 
-		// And a new one in case we want to move/rename it
-		strncpy(newPath, relPath, MAX_PATH_NAME_LENGTH);
-		while (fileFind(newPath, NULL) >= 0)
+		if (length)
+			count += length;
+		else
+			count += 1;
+	}
+
+	sleep(3);
+	status = 0;
+
+out:
+	if (buffer)
+		free(buffer);
+
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int text_colors(void)
+{
+	// Tests the setting/printing of text colors.
+
+	int status = 0;
+	int columns = 0;
+	color foreground;
+	char *buffer = NULL;
+	color tmpColor;
+	textAttrs attrs;
+	int count1, count2;
+
+	color allColors[16] = {
+		COLOR_BLACK, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, COLOR_RED,
+		COLOR_MAGENTA, COLOR_BROWN, COLOR_LIGHTGRAY, COLOR_DARKGRAY,
+		COLOR_LIGHTBLUE, COLOR_LIGHTGREEN, COLOR_LIGHTCYAN, COLOR_LIGHTRED,
+		COLOR_LIGHTMAGENTA, COLOR_YELLOW, COLOR_WHITE
+	};
+
+	// Save the current text screen
+	status = textScreenSave(&screen);
+	if (status < 0)
+		goto out;
+
+	columns = textGetNumColumns();
+	if (columns < 0)
+	{
+		status = columns;
+		goto out;
+	}
+
+	// Save the current foreground color
+	status = textGetForeground(&foreground);
+	if (status < 0)
+		goto out;
+
+	buffer = malloc(columns);
+	if (!buffer)
+	{
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	for (count1 = 0; count1 < (columns - 1); count1 ++)
+		buffer[count1] = '#';
+
+	buffer[columns - 1] = '\0';
+
+	textNewline();
+
+	for (count1 = 0; count1 < 16; count1 ++)
+	{
+		status = textSetForeground(&allColors[count1]);
+		if (status < 0)
 		{
-			snprintf(newPath, MAX_PATH_NAME_LENGTH, "%s/%c-%s", dirPath,
-				randomFormatted(65, 90), theFile.name);
+			FAILMSG("Failed to set the foreground color");
+			goto out;
 		}
 
-		if (theFile.type == dirT)
+		status = textGetForeground(&tmpColor);
+		if (status < 0)
 		{
-			// Randomly decide what type of operation to do to this diretory
-			op = randomFormatted(0, 3);
+			FAILMSG("Failed to get the foreground color");
+			goto out;
+		}
 
-			switch (op)
-			{
-				case 0:
-				{
-					if (numFiles < 4)
-					{
-						// Recursively copy it
-						printf("Recursively copy %s to %s\n", relPath,
-							newPath);
-						status = fileCopyRecursive(relPath, newPath);
-						if (status < 0)
-						{
-							FAILMSG("Error %d copying directory %s", status,
-								relPath);
-							return (status);
-						}
-					}
+		if (memcmp(&allColors[count1], &tmpColor, sizeof(color)))
+		{
+			FAILMSG("Foreground color not set correctly");
+			status = ERR_INVALID;
+			goto out;
+		}
 
-					break;
-				}
+		textPrintLine(buffer);
+	}
 
-				case 1:
-				{
-					if (numFiles > 4)
-					{
-						// Recursively delete it
-						printf("Recursively delete %s\n", relPath);
-						status = fileDeleteRecursive(relPath);
-						if (status < 0)
-						{
+	for (count1 = 0; count1 < 16; count1 ++)
+	{
+		for (count2 = 0; count2 < 16; count2 ++)
+		{
+			memset(&attrs, 0, sizeof(textAttrs));
+			attrs.flags = (TEXT_ATTRS_FOREGROUND | TEXT_ATTRS_BACKGROUND);
+			memcpy(&attrs.foreground, &allColors[count1], sizeof(color));
+			memcpy(&attrs.background, &allColors[count2], sizeof(color));
+			textPrintAttrs(&attrs, buffer);
+			textPrintLine("");
+		}
+	}
+
+	textNewline();
+
+	sleep(3);
+	status = 0;
+
+out:
+	if (buffer)
+		free(buffer);
+
+	// Restore old foreground color
+	textSetForeground(&foreground);
+
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int xtra_chars(void)
+{
+	// Just print out the 'extended ASCII' (actually ISO-8859-15) characters
+	// so we can see whether or not they're appearing properly in our fonts
+
+	int status = 0;
+	int graphics = graphicsAreEnabled();
+	objectKey window = NULL;
+	componentParameters params;
+	char lineBuffer[80];
+	int count;
+
+	// Save the current text screen
+	status = textScreenSave(&screen);
+	if (status < 0)
+		goto out;
+
+	if (graphics)
+	{
+		// Create a new window
+		window = windowNew(multitaskerGetCurrentProcessId(), "Xtra chars "
+			"test window");
+		if (!window)
+		{
+			FAILMSG("Error getting window");
+			status = ERR_NOTINITIALIZED;
+			goto out;
+		}
+
+		memset(&params, 0, sizeof(componentParameters));
+		params.gridWidth = 1;
+		params.gridHeight = 1;
+		params.padLeft = 5;
+		params.padRight = 5;
+		params.padTop = 5;
+		params.padBottom = 5;
+		params.orientationX = orient_center;
+		params.orientationY = orient_middle;
+		params.font = fontGet(FONT_FAMILY_XTERM, FONT_STYLEFLAG_NORMAL, 10,
+			NULL);
+		if (!params.font)
+		{
+			FAILMSG("Error %d getting font", status);
+			goto out;
+		}
+	}
+
+	printf("\n");
+
+	lineBuffer[0] = '\0';
+	for (count = 160; count <= 255; count ++)
+	{
+		sprintf((lineBuffer + strlen(lineBuffer)), "%d='%c' ", count, count);
+		if (!((count + 1) % 8))
+		{
+			printf("%s\n", lineBuffer);
+
+			if (window)
+			{
+				windowNewTextLabel(window, lineBuffer, &params);
+				params.gridY += 1;
+			}
+
+			lineBuffer[0] = '\0';
+		}
+	}
+
+	printf("\n");
+
+	if (window)
+	{
+		status = windowSetVisible(window, 1);
+		if (status < 0)
+		{
+			FAILMSG("Error %d setting window visible", status);
+			goto out;
+		}
+	}
+
+	sleep(3);
+	status = 0;
+
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	if (window)
+		windowDestroy(window);
+
+	return (status);
+}
+
+
+static int port_io(void)
+{
+	// Test IO ports & related stuff!  Davide Airaghi
+
+	int pid = 0;
+	int setClear = 0;
+	unsigned portN = 0;
+	int res = 0;
+	unsigned char ch __attribute__((unused));
+	int count;
+
+	pid = multitaskerGetCurrentProcessId();
+	if (pid < 0)
+	{
+		FAILMSG("Error %d getting PID", res);
+		goto fail;
+	}
+
+	for (count = 0; count < 65535; count ++)
+	{
+		portN = randomFormatted(0, 65535);
+		setClear = ((rand() % 2) == 0);
+
+		res = multitaskerSetIoPerm(pid, portN, setClear);
+		if (res < 0)
+		{
+			FAILMSG("Error %d setting perms on port %d", res, portN);
+			goto fail;
+		}
+
+		if (setClear)
+		{
+			// Read from the port
+			processorInPort8(portN, ch);
+		}
+
+		// Clear permissions again
+		res = multitaskerSetIoPerm(pid, portN, 0);
+		if (res < 0)
+		{
+			FAILMSG("Error %d clearing perms on port %d", res, portN);
+			goto fail;
+		}
+	}
+
+	return (0);
+
+fail:
+	return (-1);
+}
+
+
+static int disk_reads(disk *theDisk)
+{
+	int status = 0;
+	unsigned startSector = 0;
+	unsigned numSectors = 0;
+	unsigned char *buffer = NULL;
+	int count;
+
+	printf("\nTest reads from disk %s, numSectors %llu ", theDisk->name,
+		theDisk->numSectors);
+
+	for (count = 0; count < 1024; count ++)
+	{
+		numSectors = randomFormatted(1, min(theDisk->numSectors, 512));
+		startSector = randomFormatted(0, (theDisk->numSectors - numSectors -
+			1));
+
+		buffer = malloc(numSectors * theDisk->sectorSize);
+		if (!buffer)
+		{
+			FAILMSG("Error getting %u bytes disk %s buffer memory",
+				(numSectors * theDisk->sectorSize), theDisk->name);
+			return (status = ERR_MEMORY);
+		}
+
+		status = diskReadSectors(theDisk->name, startSector, numSectors,
+			buffer);
+
+		free(buffer);
+
+		if (status < 0)
+		{
+			FAILMSG("Error %d reading %u sectors at %u on %s", status,
+				numSectors, startSector, theDisk->name);
+			return (status);
+		}
+	}
+
+	return (status = 0);
+}
+
+
+static int disk_io(void)
+{
+	// Test disk IO reads
+
+	int status = 0;
+	char diskName[DISK_MAX_NAMELENGTH + 1];
+	disk theDisk;
+	int count = 0;
+
+	// Save the current text screen
+	status = textScreenSave(&screen);
+	if (status < 0)
+		goto fail;
+
+	// Get the logical boot disk name
+	status = diskGetBoot(diskName);
+	if (status < 0)
+	{
+		FAILMSG("Error %d getting disk name", status);
+		goto fail;
+	}
+
+	for (count = 0; count < (DISK_MAX_PARTITIONS + 1); count ++)
+	{
+		// Take off any partition letter, so that we have the name of the
+		// whole physical disk.
+		if (isalpha(diskName[strlen(diskName) - 1]))
+			diskName[strlen(diskName) - 1] = '\0';
+
+		if (count)
+		{
+			// Add a partition letter
+			sprintf((diskName + strlen(diskName)), "%c", ('a' + count - 1));
+		}
+
+		// Get the disk info
+		status = diskGet(diskName, &theDisk);
+		if (status < 0)
+		{
+			// No such disk.  Fine.
+			break;
+		}
+
+		// Do random reads
+		status = disk_reads(&theDisk);
+		if (status < 0)
+			goto fail;
+	}
+
+	status = 0;
+
+fail:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int file_recurse(const char *dirPath, unsigned startTime)
+{
+	int status = 0;
+	file theFile;
+	int numFiles = 0;
+	int fileNum = 0;
+	char relPath[MAX_PATH_NAME_LENGTH + 1];
+	unsigned op = 0;
+	char newPath[MAX_PATH_NAME_LENGTH + 1];
+	int count;
+
+	// Initialize the file structure
+	memset(&theFile, 0, sizeof(file));
+
+	// Loop through the contents of the directory
+	while (rtcUptimeSeconds() < (startTime + 30))
+	{
+		numFiles = fileCount(dirPath);
+		if (numFiles <= 0)
+		{
+			FAILMSG("Error %d getting directory %s file count", numFiles,
+				dirPath);
+			return (numFiles);
+		}
+
+		if (numFiles <= 2)
+			return (status = 0);
+
+		fileNum = randomFormatted(2, (numFiles - 1));
+		for (count = 0; count <= fileNum; count ++)
+		{
+			if (!count)
+			{
+				// Get the first item in the directory
+				status = fileFirst(dirPath, &theFile);
+				if (status < 0)
+				{
+					FAILMSG("Error %d finding first file in %s", status,
+						dirPath);
+					return (status);
+				}
+			}
+			else
+			{
+				status = fileNext(dirPath, &theFile);
+				if (status < 0)
+				{
+					FAILMSG("Error %d finding next file after %s in %s",
+						status, theFile.name, dirPath);
+					return (status);
+				}
+			}
+		}
+
+		// Construct the relative pathname for this item
+		sprintf(relPath, "%s/%s", dirPath, theFile.name);
+
+		// And a new one in case we want to move/rename it
+		strncpy(newPath, relPath, MAX_PATH_NAME_LENGTH);
+		while (fileFind(newPath, NULL) >= 0)
+		{
+			snprintf(newPath, MAX_PATH_NAME_LENGTH, "%s/%c-%s", dirPath,
+				randomFormatted(65, 90), theFile.name);
+		}
+
+		if (theFile.type == dirT)
+		{
+			// Randomly decide what type of operation to do to this diretory
+			op = randomFormatted(0, 3);
+
+			switch (op)
+			{
+				case 0:
+				{
+					if (numFiles < 4)
+					{
+						// Recursively copy it
+						printf("Recursively copy %s to %s\n", relPath,
+							newPath);
+						status = fileCopyRecursive(relPath, newPath);
+						if (status < 0)
+						{
+							FAILMSG("Error %d copying directory %s", status,
+								relPath);
+							return (status);
+						}
+					}
+
+					break;
+				}
+
+				case 1:
+				{
+					if (numFiles > 4)
+					{
+						// Recursively delete it
+						printf("Recursively delete %s\n", relPath);
+						status = fileDeleteRecursive(relPath);
+						if (status < 0)
+						{
 							FAILMSG("Error %d deleting directory %s", status,
 								relPath);
 							return (status);
 						}
 					}
 
-					break;
-				}
+					break;
+				}
+
+				case 2:
+				{
+					// Make a new directory
+					printf("Create %s\n", newPath);
+					status = fileMakeDir(newPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d creating directory %s", status,
+							newPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 3:
+				{
+					// Recursively process it the normal way
+					status = file_recurse(relPath, startTime);
+					if (status < 0)
+						return (status);
+
+					// Remove the directory.
+					printf("Remove %s\n", relPath);
+					status = fileDeleteRecursive(relPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d removing directory %s", status,
+							relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				default:
+				{
+					FAILMSG("Unknown op %d for file %s", op, relPath);
+					return (status = ERR_BUG);
+				}
+			}
+		}
+		else
+		{
+			// Randomly decide what type of operation to do to this file
+			op = randomFormatted(0, 6);
+
+			switch (op)
+			{
+				case 0:
+				{
+					// Just find the file
+					status = fileFind(relPath, NULL);
+					if (status < 0)
+					{
+						FAILMSG("Error %d finding file %s", status, relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 1:
+				{
+					// Read and write the file using block IO
+					printf("Read/write %s (block)\n", relPath);
+					status = fileOpen(relPath, OPENMODE_READWRITE, &theFile);
+					if (status < 0)
+					{
+						FAILMSG("Error %d opening file %s", status, relPath);
+						return (status);
+					}
+
+					unsigned char *buffer = malloc(theFile.blocks *
+						theFile.blockSize);
+					if (!buffer)
+					{
+						FAILMSG("Couldn't get %u bytes memory for file %s",
+							(theFile.blocks * theFile.blockSize), relPath);
+						return (status = ERR_MEMORY);
+					}
+
+					status = fileRead(&theFile, 0, theFile.blocks, buffer);
+					if (status < 0)
+					{
+						FAILMSG("Error %d reading file %s", status, relPath);
+						free(buffer);
+						return (status);
+					}
+
+					status = fileWrite(&theFile, 0, theFile.blocks, buffer);
+					if (status < 0)
+					{
+						FAILMSG("Error %d writing file %s", status, relPath);
+						free(buffer);
+						return (status);
+					}
+
+					status = fileWrite(&theFile, theFile.blocks, 1, buffer);
+
+					free(buffer);
+
+					if (status < 0)
+					{
+						FAILMSG("Error %d rewriting file %s", status,
+							relPath);
+						return (status);
+					}
+
+					status = fileClose(&theFile);
+					if (status < 0)
+					{
+						FAILMSG("Error %d closing file %s", status, relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 2:
+				{
+					// Delete the file
+					printf("Delete %s\n", relPath);
+					status = fileDelete(relPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d deleting file %s", status, relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 3:
+				{
+					// Delete the file securely
+					printf("Securely delete %s\n", relPath);
+					status = fileDeleteSecure(relPath, 9);
+					if (status < 0)
+					{
+						FAILMSG("Error %d securely deleting file %s", status,
+							relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 4:
+				{
+					// Copy the file
+					printf("Copy %s to %s\n", relPath, newPath);
+					status = fileCopy(relPath, newPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d copying file %s to %s", status,
+							relPath, newPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 5:
+				{
+					// Move the file
+					printf("Move %s to %s\n", relPath, newPath);
+					status = fileMove(relPath, newPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d moving file %s to %s", status,
+							relPath, newPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				case 6:
+				{
+					printf("Timestamp file %s\n", relPath);
+					status = fileTimestamp(relPath);
+					if (status < 0)
+					{
+						FAILMSG("Error %d timestamping file %s", status,
+							relPath);
+						return (status);
+					}
+
+					break;
+				}
+
+				default:
+				{
+					FAILMSG("Unknown op %d for file %s", op, relPath);
+					return (status = ERR_BUG);
+				}
+			}
+		}
+	}
+
+	// Timed out.
+	return (status = 0);
+}
+
+
+static int file_ops(void)
+{
+	// Test filesystem operations
+
+	int status = 0;
+	unsigned startTime = 0;
+	int count;
+
+	char *useFiles[] = { PATH_PROGRAMS, PATH_SYSTEM, "/visopsys", NULL };
+	#define DIRNAME "./test_tmp"
+
+	// Save the current text screen
+	status = textScreenSave(&screen);
+	if (status < 0)
+		goto fail;
+
+	// If the test directory exists, delete it
+	if (fileFind(DIRNAME, NULL) >= 0)
+	{
+		printf("Recursively delete %s\n", DIRNAME);
+		status = fileDeleteRecursive(DIRNAME);
+		if (status < 0)
+		{
+			FAILMSG("Error %d recursively deleting %s", status, DIRNAME);
+			goto fail;
+		}
+	}
+
+	status = fileMakeDir(DIRNAME);
+	if (status < 0)
+	{
+		FAILMSG("Error %d creating test directory", status);
+		goto fail;
+	}
+
+	startTime = rtcUptimeSeconds();
+	while (rtcUptimeSeconds() < (startTime + 10))
+	{
+		for (count = 0; useFiles[count]; count ++)
+		{
+			char tmpName[MAX_PATH_NAME_LENGTH + 1];
+			sprintf(tmpName, "%s%s", DIRNAME, useFiles[count]);
+
+			printf("Recursively copy %s to %s\n", useFiles[count], tmpName);
+			status = fileCopyRecursive(useFiles[count], tmpName);
+			if (status < 0)
+			{
+				FAILMSG("Error %d recursively copying files from %s", status,
+					useFiles[count]);
+				goto fail;
+			}
+		}
+
+		// Now, recurse the directory, doing random file operations on the
+		// contents.
+		status = file_recurse(DIRNAME, startTime);
+		if (status < 0)
+			break;
+	}
+
+fail:
+	if (fileFind(DIRNAME, NULL) >= 0)
+	{
+		printf("Recursively delete %s\n", DIRNAME);
+		fileDeleteRecursive(DIRNAME);
+	}
+
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int config_cache(void)
+{
+	// Test the kernel's cache of parsed config files
+
+	int status = 0;
+	FILE *configFile = NULL;
+	char value[16];
+	configCacheStats before, after;
+	int count;
+
+	#define CONFIGNAME "./test_tmp.conf"
+
+	configFile = fopen(CONFIGNAME, "w");
+	if (!configFile)
+	{
+		FAILMSG("Error creating %s", CONFIGNAME);
+		return (status = ERR_NOCREATE);
+	}
+
+	fprintf(configFile, "# Test config file\nfoo=1\nbar=2\n");
+	fclose(configFile);
+
+	status = configGetCacheStats(&before);
+	if (status < 0)
+	{
+		FAILMSG("Error %d getting stats", status);
+		goto out;
+	}
+
+	for (count = 0; count < 10; count ++)
+	{
+		status = configGet(CONFIGNAME, "bar", value, sizeof(value));
+		if ((status < 0) || strcmp(value, "2"))
+		{
+			FAILMSG("Error %d getting value (%s)", status, value);
+			goto out;
+		}
+	}
+
+	// Set a value, and make sure it's in the cache and in the file
+	status = configSet(CONFIGNAME, "foo", "3");
+	if (status < 0)
+	{
+		FAILMSG("Error %d setting value", status);
+		goto out;
+	}
+
+	status = configGet(CONFIGNAME, "foo", value, sizeof(value));
+	if ((status < 0) || strcmp(value, "3"))
+	{
+		FAILMSG("Error %d getting set value (%s)", status, value);
+		goto out;
+	}
+
+	status = configGetCacheStats(&after);
+	if (status < 0)
+	{
+		FAILMSG("Error %d getting stats", status);
+		goto out;
+	}
+
+	// After the first get, the rest (and the set) should all be hits.  Other
+	// processes might be using the cache too, so there could be more.
+	if (((after.misses - before.misses) < 1) ||
+		((after.hits - before.hits) < 11))
+	{
+		FAILMSG("Counted %u hits, %u misses", (after.hits - before.hits),
+			(after.misses - before.misses));
+		status = ERR_BUG;
+		goto out;
+	}
+
+	// Change the file behind the cache's back.  The new value is the same
+	// size, so only the write itself tells the cache about it.
+	configFile = fopen(CONFIGNAME, "w");
+	if (!configFile)
+	{
+		FAILMSG("Error re-writing %s", CONFIGNAME);
+		status = ERR_NOCREATE;
+		goto out;
+	}
+
+	fprintf(configFile, "# Test config file\nfoo=4\nbar=2\n");
+	fclose(configFile);
+
+	status = configGet(CONFIGNAME, "foo", value, sizeof(value));
+	if ((status < 0) || strcmp(value, "4"))
+	{
+		FAILMSG("Stale value after writing file (%s)", value);
+		status = ERR_BUG;
+		goto out;
+	}
+
+	status = 0;
+
+out:
+	fileDelete(CONFIGNAME);
+	return (status);
+}
+
+
+static int variable_lists(void)
+{
+	// Benchmark getting, setting, and unsetting variables in variable lists
+	// of different sizes, and make sure they keep the right values and order
+
+	#define VARLIST_OPS		100000
+
+	int status = 0;
+	int sizes[] = { 10, 100, 10000 };
+	variableList list;
+	char variable[16];
+	char value[16];
+	const char *got = NULL;
+	uquad_t startMs = 0;
+	uquad_t setMs = 0, getMs = 0, unsetMs = 0;
+	int numSizes = (sizeof(sizes) / sizeof(int));
+	int rounds = 0;
+	int count1, count2, count3;
+
+	for (count1 = 0; count1 < numSizes; count1 ++)
+	{
+		status = variableListCreate(&list);
+		if (status < 0)
+		{
+			FAILMSG("Error %d creating list", status);
+			return (status);
+		}
+
+		rounds = (VARLIST_OPS / sizes[count1]);
+		setMs = getMs = unsetMs = 0;
+
+		for (count2 = 0; count2 < rounds; count2 ++)
+		{
+			startMs = cpuGetMs();
+			for (count3 = 0; count3 < sizes[count1]; count3 ++)
+			{
+				sprintf(variable, "var%d", count3);
+				sprintf(value, "%d", (count2 + count3));
+				status = variableListSet(&list, variable, value);
+				if (status < 0)
+				{
+					FAILMSG("Error %d setting %s", status, variable);
+					goto out;
+				}
+			}
+			setMs += (cpuGetMs() - startMs);
+
+			startMs = cpuGetMs();
+			for (count3 = 0; count3 < sizes[count1]; count3 ++)
+			{
+				sprintf(variable, "var%d", count3);
+				got = variableListGet(&list, variable);
+				if (!got || (atoi(got) != (count2 + count3)))
+				{
+					FAILMSG("Wrong value for %s", variable);
+					status = ERR_BADDATA;
+					goto out;
+				}
+			}
+			getMs += (cpuGetMs() - startMs);
+
+			if (list.numVariables != sizes[count1])
+			{
+				FAILMSG("List has %d variables, not %d", list.numVariables,
+					sizes[count1]);
+				status = ERR_BADDATA;
+				goto out;
+			}
+
+			// Unset the odd-numbered variables, then make sure the even ones
+			// are still there, in the same order, with the same values
+			startMs = cpuGetMs();
+			for (count3 = 1; count3 < sizes[count1]; count3 += 2)
+			{
+				sprintf(variable, "var%d", count3);
+				status = variableListUnset(&list, variable);
+				if (status < 0)
+				{
+					FAILMSG("Error %d unsetting %s", status, variable);
+					goto out;
+				}
+			}
+			unsetMs += (cpuGetMs() - startMs);
+
+			if (list.numVariables != ((sizes[count1] + 1) / 2))
+			{
+				FAILMSG("List has %d variables after unset, not %d",
+					list.numVariables, ((sizes[count1] + 1) / 2));
+				status = ERR_BADDATA;
+				goto out;
+			}
+
+			for (count3 = 0; count3 < list.numVariables; count3 ++)
+			{
+				sprintf(variable, "var%d", (count3 * 2));
+				got = variableListGetVariable(&list, count3);
+				if (!got || strcmp(got, variable))
+				{
+					FAILMSG("Variable %d is %s, not %s", count3,
+						(got? got : "NULL"), variable);
+					status = ERR_BADDATA;
+					goto out;
+				}
+
+				got = variableListGet(&list, variable);
+				if (!got || (atoi(got) != (count2 + (count3 * 2))))
+				{
+					FAILMSG("Wrong value for %s after unset", variable);
+					status = ERR_BADDATA;
+					goto out;
+				}
+			}
+
+			startMs = cpuGetMs();
+			for (count3 = 0; count3 < sizes[count1]; count3 += 2)
+			{
+				sprintf(variable, "var%d", count3);
+				status = variableListUnset(&list, variable);
+				if (status < 0)
+				{
+					FAILMSG("Error %d unsetting %s", status, variable);
+					goto out;
+				}
+			}
+			unsetMs += (cpuGetMs() - startMs);
+
+			if (list.numVariables || variableListGet(&list, "var0"))
+			{
+				FAILMSG("List isn't empty");
+				status = ERR_BADDATA;
+				goto out;
+			}
+		}
+
+		printf("\n  %d vars: set %u, get %u, unset %u ms per %d", sizes[count1],
+			(unsigned) setMs, (unsigned) getMs, (unsigned) unsetMs,
+			(rounds * sizes[count1]));
+
+		variableListDestroy(&list);
+	}
+
+	printf("\n");
+	return (status = 0);
+
+out:
+	variableListDestroy(&list);
+	return (status);
+}
+
+
+#define HTTP_RESPONSES		5
+#define HTTP_CONTENTMAX		64
+
+static struct {
+	char content[HTTP_RESPONSES][HTTP_CONTENTMAX];
+	unsigned len[HTTP_RESPONSES];
+
+} httpData;
+
+// The server's side of the connection, fed to the HTTP library in pieces
+static struct {
+	const char *data;
+	unsigned len;
+	unsigned piece;
+
+} httpServer;
+
+
+static int httpLookup(const char *name __attribute__((unused)),
+	networkAddress *address, int *addressType)
+{
+	memset(address, 0, sizeof(networkAddress));
+	*addressType = AF_INET;
+	return (0);
+}
+
+
+static objectKey httpOpen(int mode __attribute__((unused)),
+	networkAddress *address __attribute__((unused)),
+	networkFilter *filter __attribute__((unused)))
+{
+	return ((objectKey) &httpServer);
+}
+
+
+static int httpClose(objectKey connection __attribute__((unused)))
+{
+	return (0);
+}
+
+
+static int httpRead(objectKey connection __attribute__((unused)),
+	unsigned char *buffer, unsigned bufferSize)
+{
+	// Once everything is read, the server has closed the connection
+	unsigned len = min(min(httpServer.len, httpServer.piece), bufferSize);
+
+	if (!len)
+		return (ERR_IO);
+
+	memcpy(buffer, httpServer.data, len);
+	httpServer.data += len;
+	httpServer.len -= len;
+
+	return (len);
+}
+
+
+static int httpWrite(objectKey connection __attribute__((unused)),
+	unsigned char *buffer __attribute__((unused)), unsigned bufferSize)
+{
+	return (bufferSize);
+}
+
+
+// Build the HTTP library into this program, talking to the server above
+// instead of the network
+#define networkLookupNameAddress httpLookup
+#define networkOpen httpOpen
+#define networkClose httpClose
+#define networkRead httpRead
+#define networkWrite httpWrite
+#include "../lib/libhttp/libhttp.c"
+#undef networkLookupNameAddress
+#undef networkOpen
+#undef networkClose
+#undef networkRead
+#undef networkWrite
+
+
+static int httpContent(int request, const char *content, unsigned len,
+	void *data __attribute__((unused)))
+{
+	if ((request < 0) || (request >= HTTP_RESPONSES) ||
+		((httpData.len[request] + len) > HTTP_CONTENTMAX))
+	{
+		return (ERR_RANGE);
+	}
+
+	memcpy((httpData.content[request] + httpData.len[request]), content,
+		len);
+	httpData.len[request] += len;
+
+	return (0);
+}
+
+
+static int http_responses(void)
+{
+	// Feed a series of pipelined HTTP responses to the HTTP library, split
+	// into pieces of different sizes, and make sure it gets the right
+	// content from each, including chunked content and content following an
+	// interim response.  Then make sure a bad chunk size is caught.
+
+	const char *responses =
+		"HTTP/1.1 100 Continue\r\n\r\n"
+		"HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"
+		"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+		"4;ext=1\r\nwiki\r\n5 \t\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n"
+		"0\r\nTrailer: x\r\n\r\n"
+		"HTTP/1.1 404 Not Found\r\nContent-Length: 3\r\n\r\nabc"
+		"HTTP/1.1 204 No Content\r\n\r\n"
+		"HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nthe end";
+	const char *badChunk =
+		"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+		"5x\r\nhello\r\n0\r\n\r\n";
+
+	const char *contents[HTTP_RESPONSES] = {
+		"hello", "wikipedia in\r\n\r\nchunks.", "", "", "the end"
+	};
+	int expectResults[HTTP_RESPONSES] = { 0, 0, ERR_IO, 0, 0 };
+	unsigned pieces[] = { 1, 3, 7, 4096 };
+
+	int status = 0;
+	urlInfo *urls[HTTP_RESPONSES];
+	char urlString[32];
+	variableList headers[HTTP_RESPONSES];
+	int results[HTTP_RESPONSES];
+	const char *statusCode = NULL;
+	int numPieces = (sizeof(pieces) / sizeof(unsigned));
+	int count1, count2;
+
+	memset(urls, 0, sizeof(urls));
+	memset(headers, 0, sizeof(headers));
+
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		return (status);
+	}
+
+	for (count2 = 0; count2 < HTTP_RESPONSES; count2 ++)
+	{
+		sprintf(urlString, "http://localhost/%d", count2);
+
+		status = httpParseUrl(urlString, &urls[count2]);
+		if (status < 0)
+		{
+			FAILMSG("Error %d parsing %s", status, urlString);
+			goto out;
+		}
+	}
+
+	for (count1 = 0; count1 < numPieces; count1 ++)
+	{
+		memset(&httpData, 0, sizeof(httpData));
+
+		httpServer.data = responses;
+		httpServer.len = strlen(responses);
+		httpServer.piece = pieces[count1];
+
+		status = httpGetPipelined(urls, headers, results, HTTP_RESPONSES,
+			&httpContent, NULL, 0 /* no timeout */);
+		if (status != ERR_IO)
+		{
+			FAILMSG("Reading in %u-byte pieces returned %d", pieces[count1],
+				status);
+			status = ERR_BADDATA;
+			goto out;
+		}
+
+		for (count2 = 0; count2 < HTTP_RESPONSES; count2 ++)
+		{
+			if (results[count2] != expectResults[count2])
+			{
+				FAILMSG("Response %d result %d, not %d", count2,
+					results[count2], expectResults[count2]);
+				status = ERR_BADDATA;
+				goto out;
+			}
+
+			if ((httpData.len[count2] != strlen(contents[count2])) ||
+				memcmp(httpData.content[count2], contents[count2],
+					httpData.len[count2]))
+			{
+				FAILMSG("Response %d content is wrong in %u-byte pieces",
+					count2, pieces[count1]);
+				status = ERR_BADDATA;
+				goto out;
+			}
+		}
+
+		// The interim response's header shouldn't be left behind
+		statusCode = variableListGet(&headers[0], HTTP_STATUSCODE_VAR);
+		if (!statusCode || (atoi(statusCode) != HTTP_STATUSCODE_OK))
+		{
+			FAILMSG("First response status is %s, not %d",
+				(statusCode? statusCode : "NULL"), HTTP_STATUSCODE_OK);
+			status = ERR_BADDATA;
+			goto out;
+		}
+
+		for (count2 = 0; count2 < HTTP_RESPONSES; count2 ++)
+			variableListDestroy(&headers[count2]);
+	}
+
+	httpServer.data = badChunk;
+	httpServer.len = strlen(badChunk);
+
+	status = httpGetPipelined(urls, headers, results, 1, &httpContent, NULL,
+		0 /* no timeout */);
+	if (status != ERR_BADDATA)
+	{
+		FAILMSG("Bad chunk size returned %d, not %d", status, ERR_BADDATA);
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	status = 0;
+
+out:
+	httpCloseConnections();
+
+	for (count2 = 0; count2 < HTTP_RESPONSES; count2 ++)
+	{
+		if (urls[count2])
+			httpFreeUrlInfo(urls[count2]);
+
+		if (headers[count2].memory)
+			variableListDestroy(&headers[count2]);
+	}
+
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int xmlOffset(const char *pointer, const char *base)
+{
+	// Where a pointer is in a document's text, so that the same places in
+	// different copies of the text can be compared
+
+	if (!pointer)
+		return (-1);
+
+	return (pointer - base);
+}
+
+
+static int xmlSameElements(xmlElement *element1, const char *base1,
+	xmlElement *element2, const char *base2)
+{
+	// Returns 1 if the 2 elements, their siblings, and all of their
+	// descendents are the same
+
+	int count;
+
+	for ( ; element1 && element2; element1 = element1->next,
+		element2 = element2->next)
+	{
+		if ((element1->nameLen != element2->nameLen) ||
+			strncmp(element1->name, element2->name, element1->nameLen) ||
+			(xmlOffset(element1->start, base1) !=
+				xmlOffset(element2->start, base2)) ||
+			(element1->len != element2->len) ||
+			(xmlOffset(element1->body, base1) !=
+				xmlOffset(element2->body, base2)) ||
+			(element1->bodyLen != element2->bodyLen) ||
+			(element1->numAttributes != element2->numAttributes))
+		{
+			return (0);
+		}
+
+		for (count = 0; count < element1->numAttributes; count ++)
+		{
+			if ((element1->attribute[count].nameLen !=
+					element2->attribute[count].nameLen) ||
+				strncmp(element1->attribute[count].name,
+					element2->attribute[count].name,
+					element1->attribute[count].nameLen) ||
+				(element1->attribute[count].valueLen !=
+					element2->attribute[count].valueLen) ||
+				strncmp(element1->attribute[count].value,
+					element2->attribute[count].value,
+					element1->attribute[count].valueLen))
+			{
+				return (0);
+			}
+		}
+
+		if (!xmlSameElements(element1->child, base1, element2->child,
+			base2))
+		{
+			return (0);
+		}
+	}
+
+	return (!element1 && !element2);
+}
+
+
+static int xml_parsing(void)
+{
+	// Parse the same document all at once, 1 byte at a time, and from a
+	// stream, and make sure that the element trees are all the same
+
+	#define XML_FILENAME		"./test_tmp.xml"
+
+	const char *text =
+		"<?xml version=\"1.0\"?>\n"
+		"<html>\n"
+		"<!-- a comment with <tags> in it -->\n"
+		"<head><title>Test document</title></head>\n"
+		"<body bgcolor=\"#FFFFFF\" text='black'>\n"
+		"<h1 align=center>Heading</h1>\n"
+		"<p>An unclosed paragraph with a <a href=\"a.html?x=1&y=2\">link"
+		"</a>\n"
+		"<p>Another, with an image <img src=\"b.png\" alt=\"a picture\"/>\n"
+		"<ul><li>one</li><li>two<ul><li>two a</li></ul></li></ul>\n"
+		"<br/><hr>\n"
+		"</body>\n"
+		"</html>\n";
+
+	int status = 0;
+	unsigned len = strlen(text);
+	xmlDocument whole, chunks, streamed;
+	FILE *theStream = NULL;
+	unsigned count;
+
+	memset(&whole, 0, sizeof(xmlDocument));
+	memset(&chunks, 0, sizeof(xmlDocument));
+	memset(&streamed, 0, sizeof(xmlDocument));
+
+	if (xmlParse(&whole, text, len) < 0)
+	{
+		FAILMSG("Error parsing the whole document");
+		status = ERR_INVALID;
+		goto out;
+	}
+
+	if (xmlParseStart(&chunks) < 0)
+	{
+		FAILMSG("Error starting to parse in chunks");
+		status = ERR_INVALID;
+		goto out;
+	}
+
+	for (count = 0; count < len; count ++)
+	{
+		if (xmlParseChunk(&chunks, (text + count), 1) < 0)
+		{
+			FAILMSG("Error parsing byte %u", count);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	if (xmlParseFinish(&chunks) < 0)
+	{
+		FAILMSG("Error finishing parsing in chunks");
+		status = ERR_INVALID;
+		goto out;
+	}
+
+	theStream = fopen(XML_FILENAME, "w");
+	if (!theStream || (fwrite(text, 1, len, theStream) < len))
+	{
+		FAILMSG("Error writing %s", XML_FILENAME);
+		status = ERR_IO;
+		goto out;
+	}
+
+	fclose(theStream);
+
+	theStream = fopen(XML_FILENAME, "r");
+	if (!theStream || (xmlParseStream(&streamed, theStream) < 0))
+	{
+		FAILMSG("Error parsing %s", XML_FILENAME);
+		status = ERR_INVALID;
+		goto out;
+	}
+
+	if (!whole.numElements)
+	{
+		FAILMSG("No elements in the whole document");
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	if ((chunks.numTags != whole.numTags) ||
+		(chunks.numElements != whole.numElements) ||
+		!xmlSameElements(&whole.rootElement, text, &chunks.rootElement,
+			chunks.text))
+	{
+		FAILMSG("Parsing 1 byte at a time gives a different tree");
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	if ((streamed.numTags != whole.numTags) ||
+		(streamed.numElements != whole.numElements) ||
+		!xmlSameElements(&whole.rootElement, text, &streamed.rootElement,
+			streamed.text))
+	{
+		FAILMSG("Parsing from a stream gives a different tree");
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	status = 0;
+
+out:
+	if (theStream)
+		fclose(theStream);
+
+	fileDelete(XML_FILENAME);
+
+	xmlFree(&streamed);
+	xmlFree(&chunks);
+	xmlFree(&whole);
+
+	return (status);
+}
+
+
+static int divide64(void)
+{
+	// Test 64-bit division
+
+	struct {
+		long long dividend;
+		long long divisor;
+		long long result;
+		long long remainder;
+	} array[] = {
+		{ 0x99LL, 0x11LL, 0x9LL, 0x0LL },
+		{ 0x99999999LL, 0x11111111LL, 0x9LL, 0x0LL },
+		{ 0x999999999LL, 0x11111111LL, 0x90LL, 0x9LL },
+		{ 0x999999999LL, 0x111111111LL, 0x9LL, 0x0LL },
+		{ 0x4321432143214321LL, 0x1234123412341234LL, 0x3LL,
+				0xC850C850C850C85LL },
+		{ 0xF00F00F00F00LL, 0xABCABCABCLL, 0x165BLL, 0x72C72D62CLL },
+		{ 0xF00F00F00F00LL, 0xF00F00F00LL, 0x1000LL, 0xF00LL },
+		{ 0, 0, 0, 0 }
+	};
+
+	int status = 0;
+	long long res = 0;
+	long long rem = 0;
+	int count;
+
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
+
+	for (count = 0; array[count].dividend; count ++)
+	{
+		res = (array[count].dividend / array[count].divisor);
+		rem = (array[count].dividend % array[count].divisor);
+
+		if ((res != array[count].result) || (rem != array[count].remainder))
+		{
+			FAILMSG("%llx / %llx != %llx r %llx (%llx r %llx)",
+				array[count].dividend, array[count].divisor,
+				array[count].result, array[count].remainder, res, rem);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	status = 0;
+
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int sines(void)
+{
+	// Test the sin() and sinf() functions against some hard-coded values and
+	// some random values.
+
+	int status = 0;
+	float rad = 0;
+	float fres = 0;
+	double dres = 0;
+	int count;
+
+	struct {
+		float rad;
+		float res;
+
+	} farray[] = {
+		{ -8.0, -0.989358246 },
+		{ -7.0, -0.656986594 },
+		{ -6.0, 0.279815882 },
+		{ -5.0, 0.958932817 },
+		{ -4.5, 0.977531254 },
+		{ -4.0, 0.756802499 },
+		{ -3.5, 0.350783199 },
+		{ -3.0, -0.141119972 },
+		{ -2.5, -0.598472118 },
+		{ -2.0, -0.909297466 },
+		{ -1.5, -0.997495055 },
+		{ -1.0, -0.841470957 },
+		{ -0.5, -0.479425519 },
+		{ 0.5, 0.479425519 },
+		{ 1.0, 0.84147095 },
+		{ 1.5, 0.997495055 },
+		{ 2.0, 0.909297466 },
+		{ 2.5, 0.598472118 },
+		{ 3.0, 0.141119972 },
+		{ 3.5, -0.350783199 },
+		{ 4.0, -0.756802499 },
+		{ 4.5, -0.977531254 },
+		{ 5.0, -0.958932817 },
+		{ 6.0, -0.279815882 },
+		{ 7.0, 0.656986594 },
+		{ 8.0, 0.989358246 },
+		{ 0.0, 0.0 }
+	};
+
+	struct {
+		double rad;
+		double res;
+
+	} darray[] = {
+		{ -8.0, -0.9893582466233817867 },
+		{ -7.0, -0.6569865987187892825 },
+		{ -6.0, 0.2794154980429556230 },
+		{ -5.0, 0.9589242746625863393 },
+		{ -4.5, 0.9775301176650759142 },
+		{ -4.0, 0.7568024953079276465 },
+		{ -3.5, 0.3507832276896200023 },
+		{ -3.0, -0.1411200080598672135 },
+		{ -2.5, -0.5984721441039563265 },
+		{ -2.0, -0.9092974268256817094 },
+		{ -1.5, -0.9974949866040545557 },
+		{ -1.0, -0.8414709848078965049 },
+		{ -0.5, -0.4794255386042030054 },
+		{ 0.5, 0.4794255386042030054 },
+		{ 1.0, 0.8414709848078965049 },
+		{ 1.5, 0.9974949866040545557 },
+		{ 2.0, 0.9092974268256817094 },
+		{ 2.5, 0.5984721441039563265 },
+		{ 3.0, 0.1411200080598672135 },
+		{ 3.5, -0.3507832276896200023 },
+		{ 4.0, -0.7568024953079276465 },
+		{ 4.5, -0.9775301176650759142 },
+		{ 5.0, -0.9589242746625863393 },
+		{ 6.0, -0.2794154980429556230 },
+		{ 7.0, 0.6569865987187892825 },
+		{ 8.0, 0.9893582466233817867 },
+		{ 0.0, 0.0 }
+	};
+
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
+
+	// Test some fixed values from the array above using floats
+	for (count = 0; farray[count].res; count ++)
+	{
+		fres = sinf(farray[count].rad);
+		if (fres != farray[count].res)
+		{
+			FAILMSG("Sine of float %f is incorrect (%f != %f)",
+				farray[count].rad, fres, farray[count].res);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	// Do a similar list using doubles
+	for (count = 0; darray[count].res; count ++)
+	{
+		dres = sin(darray[count].rad);
+		if (dres != darray[count].res)
+		{
+			FAILMSG("Sine of double %f is incorrect (%f != %f)",
+				darray[count].rad, dres, darray[count].res);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	// Test some additional random values to make sure they're in the correct
+	// range.
+	for (count = 0; count < 2000; count ++)
+	{
+		rad = (float) randomFormatted(5, 100);
+		if (count % 2)
+			rad *= -1.0;
+
+		fres = sinf(rad);
+		if ((fres < -1) || (fres == 0) || (fres > 1))
+		{
+			FAILMSG("Sine of %f is incorrect (%f)", rad, fres);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	status = 0;
+
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int cosines(void)
+{
+	// Test the cos() and cosf() functions against some hard-coded values and
+	// some random values.
+
+	int status = 0;
+	float rad = 0;
+	float fres = 0;
+	double dres = 0;
+	int count;
+
+	struct {
+		float rad;
+		float res;
+
+	} farray[] = {
+		{ -8.0, -0.145499974 },
+		{ -7.0, 0.753902254 },
+		{ -6.0, 0.958777964 },
+		{ -5.0, 0.283625454 },
+		{ -4.5, -0.210800409 },
+		{ -4.0, -0.653643906 },
+		{ -3.5, -0.936456680 },
+		{ -3.0, -0.989992439 },
+		{ -2.5, -0.801143587 },
+		{ -2.0, -0.416146845 },
+		{ -1.5, 0.070737205 },
+		{ -1.0, 0.540302277 },
+		{ -0.5, 0.877582609 },
+		{ 0.0, 1.000000000 },
+		{ 0.5, 0.877582609 },
+		{ 1.0, 0.540302277 },
+		{ 1.5, 0.070737205 },
+		{ 2.0, -0.416146845 },
+		{ 2.5, -0.801143587 },
+		{ 3.0, -0.989992439 },
+		{ 3.5, -0.936456680 },
+		{ 4.0, -0.653643906 },
+		{ 4.5, -0.210800409 },
+		{ 5.0, 0.283625454 },
+		{ 6.0, 0.958777964 },
+		{ 7.0, 0.753902254 },
+		{ 8.0, -0.145499974 },
+		{ 0.0, 0.0 }
+	};
+
+	struct {
+		double rad;
+		double res;
+
+	} darray[] = {
+		{ -8.0, -0.1455000338086137870 },
+		{ -7.0, 0.7539022543433044892 },
+		{ -6.0, 0.9601702874545081640 },
+		{ -5.0, 0.2836621854666496179 },
+		{ -4.5, -0.2107957994306340058 },
+		{ -4.0, -0.6536436208636079431 },
+		{ -3.5, -0.9364566872907962297 },
+		{ -3.0, -0.9899924966004455255 },
+		{ -2.5, -0.8011436155469335842 },
+		{ -2.0, -0.4161468365471424069 },
+		{ -1.5, 0.0707372016677029064 },
+		{ -1.0, 0.5403023058681396534 },
+		{ -0.5, 0.8775825618903727587 },
+		{ 0.0, 1.0000000000000000000 },
+		{ 0.5, 0.8775825618903727587 },
+		{ 1.0, 0.5403023058681396534 },
+		{ 1.5, 0.0707372016677029064 },
+		{ 2.0, -0.4161468365471424069 },
+		{ 2.5, -0.8011436155469335842 },
+		{ 3.0, -0.9899924966004455255 },
+		{ 3.5, -0.9364566872907962297 },
+		{ 4.0, -0.6536436208636079431 },
+		{ 4.5, -0.2107957994306340058 },
+		{ 5.0, 0.2836621854666496179 },
+		{ 6.0, 0.9601702874545081640 },
+		{ 7.0, 0.7539022543433044892 },
+		{ 8.0, -0.1455000338086137870 },
+		{ 0.0, 0.0 }
+	};
+
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
+
+	// Test some fixed values from the array above using floats
+	for (count = 0; farray[count].res; count ++)
+	{
+		fres = cosf(farray[count].rad);
+		if (fres != farray[count].res)
+		{
+			FAILMSG("Cosine of float %f is incorrect (%f != %f)",
+				farray[count].rad, fres, farray[count].res);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	// Do a similar list using doubles
+	for (count = 0; darray[count].res; count ++)
+	{
+		dres = cos(darray[count].rad);
+		if (dres != darray[count].res)
+		{
+			FAILMSG("Cosine of double %f is incorrect (%f != %f)",
+				darray[count].rad, dres, darray[count].res);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	// Test some additional random values to make sure they're in the correct
+	// range.
+	for (count = 0; count < 2000; count ++)
+	{
+		rad = (float) randomFormatted(5, 100);
+		if (count % 2)
+			rad *= -1.0;
+
+		fres = cosf(rad);
+		if ((fres < -1) || (fres == 0) || (fres > 1))
+		{
+			FAILMSG("Cosine of %f is incorrect (%f)", rad, fres);
+			status = ERR_INVALID;
+			goto out;
+		}
+	}
+
+	status = 0;
+
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
+
+
+static int floats(void)
+{
+	// Do calculations with floats (tests the kernel's FPU exception handling
+	// and state saving).  Adapted from an early version of our JPEG
+	// processing code.
+
+	int coefficients[64];
+	int u = 0;
+	int v = 0;
+	int x = 0;
+	int y = 0;
+	float tempValue = 0;
+	float temp[64];
+	int count;
 
-				case 2:
-				{
-					// Make a new directory
-					printf("Create %s\n", newPath);
-					status = fileMakeDir(newPath);
-					if (status < 0)
-					{
-						FAILMSG("Error %d creating directory %s", status,
-							newPath);
-						return (status);
-					}
+	memset(coefficients, 0, (64 * sizeof(int)));
+	memset(temp, 0, (64 * sizeof(float)));
 
-					break;
-				}
+	for (count = 0; count < 64; count ++)
+		coefficients[count] = rand();
 
-				case 3:
+	for (count = 0; count < 1000; count ++)
+	{
+		for (x = 0; x < 8; x++)
+		{
+			for (y = 0; y < 8; y++)
+			{
+				for (u = 0; u < 8; u++)
 				{
-					// Recursively process it the normal way
-					status = file_recurse(relPath, startTime);
-					if (status < 0)
-						return (status);
-
-					// Remove the directory.
-					printf("Remove %s\n", relPath);
-					status = fileDeleteRecursive(relPath);
-					if (status < 0)
+					for (v = 0; v < 8; v++)
 					{
-						FAILMSG("Error %d removing directory %s", status,
-							relPath);
-						return (status);
-					}
+						tempValue = coefficients[(u * 8) + v] *
+						cosf((2 * x + 1) * u * (float) M_PI / 16.0) *
+						cosf((2 * y + 1) * v * (float) M_PI / 16.0);
 
-					break;
-				}
+						if (!u)
+							tempValue *= (float) M_SQRT1_2;
+						if (!v)
+							tempValue *= (float) M_SQRT1_2;
 
-				default:
-				{
-					FAILMSG("Unknown op %d for file %s", op, relPath);
-					return (status = ERR_BUG);
+						temp[(x * 8) + y] += tempValue;
+					}
 				}
 			}
 		}
-		else
-		{
-			// Randomly decide what type of operation to do to this file
-			op = randomFormatted(0, 6);
 
-			switch (op)
+		for (y = 0; y < 8; y++)
+		{
+			for (x = 0; x < 8; x++)
 			{
-				case 0:
-				{
-					// Just find the file
-					status = fileFind(relPath, NULL);
-					if (status < 0)
-					{
-						FAILMSG("Error %d finding file %s", status, relPath);
-						return (status);
-					}
+				coefficients[(y * 8) + x] = (int)(temp[(y * 8) + x] / 4.0 +
+					0.5);
+				coefficients[(y * 8) + x] += 128;
+			}
+		}
+	}
 
-					break;
-				}
+	// If we get this far without crashing, we're golden
+	return (0);
+}
 
-				case 1:
-				{
-					// Read and write the file using block IO
-					printf("Read/write %s (block)\n", relPath);
-					status = fileOpen(relPath, OPENMODE_READWRITE, &theFile);
-					if (status < 0)
-					{
-						FAILMSG("Error %d opening file %s", status, relPath);
-						return (status);
-					}
 
-					unsigned char *buffer = malloc(theFile.blocks *
-						theFile.blockSize);
-					if (!buffer)
-					{
-						FAILMSG("Couldn't get %u bytes memory for file %s",
-							(theFile.blocks * theFile.blockSize), relPath);
-						return (status = ERR_MEMORY);
-					}
+static int libdl(void)
+{
+	int status = 0;
+	char *libName = NULL;
+	void *libHandle = NULL;
+	char *symbolName = NULL;
+	int (*fn)(const char *format, ...) = NULL;
 
-					status = fileRead(&theFile, 0, theFile.blocks, buffer);
-					if (status < 0)
-					{
-						FAILMSG("Error %d reading file %s", status, relPath);
-						free(buffer);
-						return (status);
-					}
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
 
-					status = fileWrite(&theFile, 0, theFile.blocks, buffer);
-					if (status < 0)
-					{
-						FAILMSG("Error %d writing file %s", status, relPath);
-						free(buffer);
-						return (status);
-					}
+	libName = "libc.so";
+	libHandle = dlopen(libName, RTLD_NOW);
+	if (!libHandle)
+	{
+		FAILMSG("Error getting library %s", libName);
+		status = ERR_NODATA;
+		goto out;
+	}
 
-					status = fileWrite(&theFile, theFile.blocks, 1, buffer);
+	symbolName = "printf";
+	fn = dlsym(libHandle, symbolName);
+	if (!fn)
+	{
+		FAILMSG("Error getting library symbol %s", symbolName);
+		status = ERR_NODATA;
+		goto out;
+	}
 
-					free(buffer);
+	fn("If you can read this, it works\n", libName, symbolName, fn);
 
-					if (status < 0)
-					{
-						FAILMSG("Error %d rewriting file %s", status,
-							relPath);
-						return (status);
-					}
+	sleep(3);
+	status = 0;
 
-					status = fileClose(&theFile);
-					if (status < 0)
-					{
-						FAILMSG("Error %d closing file %s", status, relPath);
-						return (status);
-					}
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
 
-					break;
-				}
+	return (status);
+}
 
-				case 2:
-				{
-					// Delete the file
-					printf("Delete %s\n", relPath);
-					status = fileDelete(relPath);
-					if (status < 0)
-					{
-						FAILMSG("Error %d deleting file %s", status, relPath);
-						return (status);
-					}
 
-					break;
-				}
+static int randoms(void)
+{
+	int status = 0;
+	unsigned numRandoms = 1000000;
+	int val = 0;
+	int evens = 0;
+	int odds = 0;
+	unsigned difference = 0;
+	unsigned count;
 
-				case 3:
-				{
-					// Delete the file securely
-					printf("Securely delete %s\n", relPath);
-					status = fileDeleteSecure(relPath, 9);
-					if (status < 0)
-					{
-						FAILMSG("Error %d securely deleting file %s", status,
-							relPath);
-						return (status);
-					}
+	status = textScreenSave(&screen);
+	if (status < 0)
+	{
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
 
-					break;
-				}
+	for (count = 0; count < numRandoms; count ++)
+	{
+		val = rand();
 
-				case 4:
-				{
-					// Copy the file
-					printf("Copy %s to %s\n", relPath, newPath);
-					status = fileCopy(relPath, newPath);
-					if (status < 0)
-					{
-						FAILMSG("Error %d copying file %s to %s", status,
-							relPath, newPath);
-						return (status);
-					}
+		if (val & 1)
+			odds += 1;
+		else
+			evens += 1;
+	}
 
-					break;
-				}
+	difference = abs(evens - odds);
+	if (difference > (numRandoms / 10))
+	{
+		FAILMSG("Imbalance in evens (%d) and odds (%d) > 10%%", evens, odds);
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	status = 0;
+
+out:
+	// Restore the text screen
+	textScreenRestore(&screen);
+
+	return (status);
+}
 
-				case 5:
-				{
-					// Move the file
-					printf("Move %s to %s\n", relPath, newPath);
-					status = fileMove(relPath, newPath);
-					if (status < 0)
-					{
-						FAILMSG("Error %d moving file %s to %s", status,
-							relPath, newPath);
-						return (status);
-					}
 
-					break;
-				}
+static void makeText(unsigned char *data, unsigned bytes)
+{
+	// Fill the buffer with some made-up text that compresses about as well as
+	// the real thing
+
+	const char *words[] = { "the", "of", "and", "a", "to", "in", "is",
+		"kernel", "Visopsys", "window", "file", "system", "memory", "page",
+		"process", "compression", "buffer", "returns", "function", "data" };
+	const char *word = NULL;
+	unsigned column = 0;
+	unsigned count;
 
-				case 6:
-				{
-					printf("Timestamp file %s\n", relPath);
-					status = fileTimestamp(relPath);
-					if (status < 0)
-					{
-						FAILMSG("Error %d timestamping file %s", status,
-							relPath);
-						return (status);
-					}
+	for (count = 0; count < bytes; )
+	{
+		word = words[rand() % (sizeof(words) / sizeof(char *))];
 
-					break;
-				}
+		for ( ; *word && (count < bytes); column ++)
+			data[count++] = *word++;
 
-				default:
-				{
-					FAILMSG("Unknown op %d for file %s", op, relPath);
-					return (status = ERR_BUG);
-				}
+		if (count < bytes)
+		{
+			if (column >= 72)
+			{
+				data[count++] = '\n';
+				column = 0;
+			}
+			else
+			{
+				data[count++] = ' ';
+				column += 1;
 			}
 		}
 	}
-
-	// Timed out.
-	return (status = 0);
 }
 
 
-static int file_ops(void)
+static unsigned crc32Bitwise(const unsigned char *buff, unsigned len)
 {
-	// Test filesystem operations
+	// The slow, obviously-correct CRC32, to check the real one against
 
-	int status = 0;
-	unsigned startTime = 0;
+	unsigned crc = ~0U;
 	int count;
 
-	char *useFiles[] = { PATH_PROGRAMS, PATH_SYSTEM, "/visopsys", NULL };
-	#define DIRNAME "./test_tmp"
+	while (len--)
+	{
+		crc ^= *buff++;
+		for (count = 0; count < 8; count ++)
+			crc = ((crc >> 1) ^ ((crc & 1)? 0xEDB88320 : 0));
+	}
 
-	// Save the current text screen
-	status = textScreenSave(&screen);
-	if (status < 0)
-		goto fail;
+	return (crc ^ ~0U);
+}
 
-	// If the test directory exists, delete it
-	if (fileFind(DIRNAME, NULL) >= 0)
+
+static int crc32s(void)
+{
+	// Check the CRC32 function against known values, and against the bitwise
+	// version for all alignments and short lengths, then benchmark it
+
+	#define CRC32_BYTES			1048576
+	#define CRC32_PASSES		20
+
+	int status = 0;
+	struct {
+		const char *string;
+		unsigned crc;
+	} vectors[] = {
+		{ "", 0x00000000 },
+		{ "a", 0xE8B7BE43 },
+		{ "abc", 0x352441C2 },
+		{ "123456789", 0xCBF43926 },
+		{ "The quick brown fox jumps over the lazy dog", 0x414FA339 },
+		{ NULL, 0 }
+	};
+	unsigned char *data = NULL;
+	unsigned crc = 0, sum = 0;
+	uquad_t startMs = 0, elapsedMs = 0;
+	unsigned offset, len;
+	int count;
+
+	for (count = 0; vectors[count].string; count ++)
 	{
-		printf("Recursively delete %s\n", DIRNAME);
-		status = fileDeleteRecursive(DIRNAME);
-		if (status < 0)
+		crc = crc32((void *) vectors[count].string,
+			strlen(vectors[count].string), NULL);
+
+		if (crc != vectors[count].crc)
 		{
-			FAILMSG("Error %d recursively deleting %s", status, DIRNAME);
-			goto fail;
+			FAILMSG("CRC32 of \"%s\" is %08x, not %08x",
+				vectors[count].string, crc, vectors[count].crc);
+			return (status = ERR_BADDATA);
 		}
 	}
 
-	status = fileMakeDir(DIRNAME);
-	if (status < 0)
+	data = malloc(CRC32_BYTES);
+	if (!data)
 	{
-		FAILMSG("Error %d creating test directory", status);
-		goto fail;
+		FAILMSG("Error getting memory");
+		return (status = ERR_MEMORY);
 	}
 
-	startTime = rtcUptimeSeconds();
-	while (rtcUptimeSeconds() < (startTime + 10))
+	for (count = 0; count < CRC32_BYTES; count ++)
+		data[count] = rand();
+
+	for (offset = 0; offset < 8; offset ++)
 	{
-		for (count = 0; useFiles[count]; count ++)
+		for (len = 0; len < 100; len ++)
 		{
-			char tmpName[MAX_PATH_NAME_LENGTH + 1];
-			sprintf(tmpName, "%s%s", DIRNAME, useFiles[count]);
-
-			printf("Recursively copy %s to %s\n", useFiles[count], tmpName);
-			status = fileCopyRecursive(useFiles[count], tmpName);
-			if (status < 0)
+			crc = crc32((data + offset), len, NULL);
+			if (crc != crc32Bitwise((data + offset), len))
 			{
-				FAILMSG("Error %d recursively copying files from %s", status,
-					useFiles[count]);
-				goto fail;
+				FAILMSG("CRC32 mismatch, offset %u length %u", offset, len);
+				status = ERR_BADDATA;
+				goto out;
 			}
 		}
+	}
 
-		// Now, recurse the directory, doing random file operations on the
-		// contents.
-		status = file_recurse(DIRNAME, startTime);
-		if (status < 0)
-			break;
+	// Continuing from a previous value, the way GZIP does it, should give
+	// the same answer as doing the whole thing at once
+	sum = 0;
+	for (offset = 0; offset < CRC32_BYTES; offset += len)
+	{
+		len = min(12345, (CRC32_BYTES - offset));
+		sum = crc32((data + offset), len, &sum);
 	}
 
-fail:
-	if (fileFind(DIRNAME, NULL) >= 0)
+	crc = crc32Bitwise(data, CRC32_BYTES);
+	if (sum != crc)
 	{
-		printf("Recursively delete %s\n", DIRNAME);
-		fileDeleteRecursive(DIRNAME);
+		FAILMSG("Continued CRC32 %08x doesn't match %08x", sum, crc);
+		status = ERR_BADDATA;
+		goto out;
 	}
 
-	// Restore the text screen
-	textScreenRestore(&screen);
+	startMs = cpuGetMs();
+
+	for (count = 0; count < CRC32_PASSES; count ++)
+	{
+		crc32(data, CRC32_BYTES, NULL);
+	}
+
+	elapsedMs = max((cpuGetMs() - startMs), 1);
+
+	printf("%u KB/s ",
+		(unsigned)(((uquad_t) CRC32_BYTES * CRC32_PASSES * 1000) /
+			(elapsedMs * 1024)));
+
+	status = 0;
 
+out:
+	free(data);
 	return (status);
 }
 
 
-static int divide64(void)
+static void digestString(const unsigned char *digest, int bytes, char *string)
 {
-	// Test 64-bit division
+	int count;
+
+	for (count = 0; count < bytes; count ++)
+		sprintf((string + (count * 2)), "%02x", digest[count]);
+}
+
+
+static int sha_hashes(void)
+{
+	// Check the SHA1 and SHA256 functions against known values, check that
+	// hashing in pieces and hashing a file give the same answers as hashing
+	// all at once, then benchmark them
+
+	#define SHA_BYTES			1048576
+	#define SHA_PASSES			8
+	#define SHA_FILENAME		"./test_tmp.sha"
 
+	int status = 0;
+	const char *strings[] = { "", "abc",
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq" };
 	struct {
-		long long dividend;
-		long long divisor;
-		long long result;
-		long long remainder;
-	} array[] = {
-		{ 0x99LL, 0x11LL, 0x9LL, 0x0LL },
-		{ 0x99999999LL, 0x11111111LL, 0x9LL, 0x0LL },
-		{ 0x999999999LL, 0x11111111LL, 0x90LL, 0x9LL },
-		{ 0x999999999LL, 0x111111111LL, 0x9LL, 0x0LL },
-		{ 0x4321432143214321LL, 0x1234123412341234LL, 0x3LL,
-				0xC850C850C850C85LL },
-		{ 0xF00F00F00F00LL, 0xABCABCABCLL, 0x165BLL, 0x72C72D62CLL },
-		{ 0xF00F00F00F00LL, 0xF00F00F00LL, 0x1000LL, 0xF00LL },
-		{ 0, 0, 0, 0 }
+		const char *name;
+		int bytes;
+		int (*hash)(const unsigned char *, unsigned, unsigned char *, int,
+			unsigned);
+		int (*hashCont)(const unsigned char *, unsigned, unsigned char *,
+			int, unsigned);
+		int (*hashFile)(const char *, unsigned char *);
+		const char *digests[3];
+	} algs[] = {
+		{ "sha1", CRYPT_HASH_SHA1_BYTES, cryptHashSha1, cryptHashSha1Cont,
+			cryptHashSha1File, {
+				"da39a3ee5e6b4b0d3255bfef95601890afd80709",
+				"a9993e364706816aba3e25717850c26c9cd0d89d",
+				"84983e441c3bd26ebaae4aa1f95129e5e54670f1" } },
+		{ "sha256", CRYPT_HASH_SHA256_BYTES, cryptHashSha256,
+			cryptHashSha256Cont, cryptHashSha256File, {
+				"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b"
+					"7852b855",
+				"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61"
+					"f20015ad",
+				"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd4"
+					"19db06c1" } }
 	};
+	unsigned char *data = NULL;
+	FILE *dataFile = NULL;
+	unsigned char digest[CRYPT_HASH_SHA256_BYTES];
+	unsigned char fileDigest[CRYPT_HASH_SHA256_BYTES];
+	char string[(CRYPT_HASH_SHA256_BYTES * 2) + 1];
+	uquad_t startMs = 0, elapsedMs = 0, fileMs = 0;
+	int count1, count2;
 
-	int status = 0;
-	long long res = 0;
-	long long rem = 0;
-	int count;
+	data = malloc(SHA_BYTES);
+	if (!data)
+	{
+		FAILMSG("Error getting memory");
+		return (status = ERR_MEMORY);
+	}
 
-	status = textScreenSave(&screen);
-	if (status < 0)
+	for (count1 = 0; count1 < SHA_BYTES; count1 ++)
+		data[count1] = rand();
+
+	dataFile = fopen(SHA_FILENAME, "w");
+	if (!dataFile)
 	{
-		FAILMSG("Error %d saving screen", status);
+		FAILMSG("Error creating %s", SHA_FILENAME);
+		status = ERR_NOCREATE;
 		goto out;
 	}
 
-	for (count = 0; array[count].dividend; count ++)
+	if (fwrite(data, 1, SHA_BYTES, dataFile) != SHA_BYTES)
 	{
-		res = (array[count].dividend / array[count].divisor);
-		rem = (array[count].dividend % array[count].divisor);
-
-		if ((res != array[count].result) || (rem != array[count].remainder))
-		{
-			FAILMSG("%llx / %llx != %llx r %llx (%llx r %llx)",
-				array[count].dividend, array[count].divisor,
-				array[count].result, array[count].remainder, res, rem);
-			status = ERR_INVALID;
-			goto out;
-		}
+		FAILMSG("Error writing %s", SHA_FILENAME);
+		fclose(dataFile);
+		status = ERR_IO;
+		goto out;
 	}
 
-	status = 0;
-
-out:
-	// Restore the text screen
-	textScreenRestore(&screen);
-
-	return (status);
-}
-
-
-static int sines(void)
-{
-	// Test the sin() and sinf() functions against some hard-coded values and
-	// some random values.
+	fclose(dataFile);
 
-	int status = 0;
-	float rad = 0;
-	float fres = 0;
-	double dres = 0;
-	int count;
+	for (count1 = 0; count1 < (int)(sizeof(algs) / sizeof(algs[0]));
+		count1 ++)
+	{
+		for (count2 = 0; count2 < 3; count2 ++)
+		{
+			algs[count1].hash((unsigned char *) strings[count2],
+				strlen(strings[count2]), digest, 1,
+				strlen(strings[count2]));
 
-	struct {
-		float rad;
-		float res;
+			digestString(digest, algs[count1].bytes, string);
+			if (strcmp(string, algs[count1].digests[count2]))
+			{
+				FAILMSG("%s of \"%s\" is %s", algs[count1].name,
+					strings[count2], string);
+				status = ERR_BADDATA;
+				goto out;
+			}
+		}
 
-	} farray[] = {
-		{ -8.0, -0.989358246 },
-		{ -7.0, -0.656986594 },
-		{ -6.0, 0.279815882 },
-		{ -5.0, 0.958932817 },
-		{ -4.5, 0.977531254 },
-		{ -4.0, 0.756802499 },
-		{ -3.5, 0.350783199 },
-		{ -3.0, -0.141119972 },
-		{ -2.5, -0.598472118 },
-		{ -2.0, -0.909297466 },
-		{ -1.5, -0.997495055 },
-		{ -1.0, -0.841470957 },
-		{ -0.5, -0.479425519 },
-		{ 0.5, 0.479425519 },
-		{ 1.0, 0.84147095 },
-		{ 1.5, 0.997495055 },
-		{ 2.0, 0.909297466 },
-		{ 2.5, 0.598472118 },
-		{ 3.0, 0.141119972 },
-		{ 3.5, -0.350783199 },
-		{ 4.0, -0.756802499 },
-		{ 4.5, -0.977531254 },
-		{ 5.0, -0.958932817 },
-		{ 6.0, -0.279815882 },
-		{ 7.0, 0.656986594 },
-		{ 8.0, 0.989358246 },
-		{ 0.0, 0.0 }
-	};
+		// Hashing in pieces should give the same answer as hashing the
+		// whole file
+		algs[count1].hash(data, 65536, digest, 0, SHA_BYTES);
+		algs[count1].hashCont((data + 65536), (SHA_BYTES - 65536), digest,
+			1, SHA_BYTES);
 
-	struct {
-		double rad;
-		double res;
+		status = algs[count1].hashFile(SHA_FILENAME, fileDigest);
+		if (status < 0)
+		{
+			FAILMSG("Error %d hashing %s", status, SHA_FILENAME);
+			goto out;
+		}
 
-	} darray[] = {
-		{ -8.0, -0.9893582466233817867 },
-		{ -7.0, -0.6569865987187892825 },
-		{ -6.0, 0.2794154980429556230 },
-		{ -5.0, 0.9589242746625863393 },
-		{ -4.5, 0.9775301176650759142 },
-		{ -4.0, 0.7568024953079276465 },
-		{ -3.5, 0.3507832276896200023 },
-		{ -3.0, -0.1411200080598672135 },
-		{ -2.5, -0.5984721441039563265 },
-		{ -2.0, -0.9092974268256817094 },
-		{ -1.5, -0.9974949866040545557 },
-		{ -1.0, -0.8414709848078965049 },
-		{ -0.5, -0.4794255386042030054 },
-		{ 0.5, 0.4794255386042030054 },
-		{ 1.0, 0.8414709848078965049 },
-		{ 1.5, 0.9974949866040545557 },
-		{ 2.0, 0.9092974268256817094 },
-		{ 2.5, 0.5984721441039563265 },
-		{ 3.0, 0.1411200080598672135 },
-		{ 3.5, -0.3507832276896200023 },
-		{ 4.0, -0.7568024953079276465 },
-		{ 4.5, -0.9775301176650759142 },
-		{ 5.0, -0.9589242746625863393 },
-		{ 6.0, -0.2794154980429556230 },
-		{ 7.0, 0.6569865987187892825 },
-		{ 8.0, 0.9893582466233817867 },
-		{ 0.0, 0.0 }
-	};
+		if (memcmp(digest, fileDigest, algs[count1].bytes))
+		{
+			FAILMSG("%s of %s doesn't match", algs[count1].name,
+				SHA_FILENAME);
+			status = ERR_BADDATA;
+			goto out;
+		}
 
-	status = textScreenSave(&screen);
+		startMs = cpuGetMs();
+		for (count2 = 0; count2 < SHA_PASSES; count2 ++)
+			algs[count1].hash(data, SHA_BYTES, digest, 1, SHA_BYTES);
+		elapsedMs = max((cpuGetMs() - startMs), 1);
+
+		startMs = cpuGetMs();
+		for (count2 = 0; count2 < SHA_PASSES; count2 ++)
+			algs[count1].hashFile(SHA_FILENAME, fileDigest);
+		fileMs = max((cpuGetMs() - startMs), 1);
+
+		printf("\n  %s: %u MB/s, file %u MB/s", algs[count1].name,
+			(unsigned)(((uquad_t) SHA_BYTES * SHA_PASSES * 1000) /
+				(elapsedMs * 1048576)),
+			(unsigned)(((uquad_t) SHA_BYTES * SHA_PASSES * 1000) /
+				(fileMs * 1048576)));
+	}
+
+	printf("\n");
+	status = 0;
+
+out:
+	fileDelete(SHA_FILENAME);
+	free(data);
+	return (status);
+}
+
+
+static int inflate(void)
+{
+	// Benchmark DEFLATE decompression, using some made-up text
+
+	#define INFLATE_BYTES		1000000
+	#define INFLATE_PASSES		10
+
+	int status = 0;
+	unsigned char *data = NULL;
+	unsigned char *compressed = NULL;
+	unsigned char *output = NULL;
+	deflateState *deflate = NULL;
+	unsigned compressedBytes = 0;
+	unsigned crc = 0;
+	uquad_t startMs = 0, elapsedMs = 0;
+	int count;
+
+	data = malloc(INFLATE_BYTES);
+	compressed = malloc(INFLATE_BYTES);
+	output = malloc(INFLATE_BYTES + DEFLATE_MAX_OUTBUFFERSIZE);
+	deflate = malloc(sizeof(deflateState));
+	if (!data || !compressed || !output || !deflate)
+	{
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	makeText(data, INFLATE_BYTES);
+
+	memset(deflate, 0, sizeof(deflateState));
+	deflate->inBuffer = data;
+	deflate->inBytes = INFLATE_BYTES;
+	deflate->outBuffer = compressed;
+	deflate->outBytes = INFLATE_BYTES;
+
+	status = deflateCompress(deflate);
 	if (status < 0)
 	{
-		FAILMSG("Error %d saving screen", status);
+		FAILMSG("Error %d compressing", status);
 		goto out;
 	}
 
-	// Test some fixed values from the array above using floats
-	for (count = 0; farray[count].res; count ++)
+	compressedBytes = deflate->outByte;
+	crc = deflate->crc32Sum;
+
+	startMs = cpuGetMs();
+
+	for (count = 0; count < INFLATE_PASSES; count ++)
 	{
-		fres = sinf(farray[count].rad);
-		if (fres != farray[count].res)
+		memset(deflate, 0, sizeof(deflateState));
+		deflate->inBuffer = compressed;
+		deflate->inBytes = compressedBytes;
+		deflate->outBuffer = output;
+		deflate->outBytes = (INFLATE_BYTES + DEFLATE_MAX_OUTBUFFERSIZE);
+
+		while (!deflate->final)
 		{
-			FAILMSG("Sine of float %f is incorrect (%f != %f)",
-				farray[count].rad, fres, farray[count].res);
-			status = ERR_INVALID;
-			goto out;
+			status = deflateDecompress(deflate);
+			if (status < 0)
+			{
+				FAILMSG("Error %d decompressing", status);
+				goto out;
+			}
+
+			if (!deflate->final && (deflate->outBytes <
+				DEFLATE_MAX_OUTBUFFERSIZE))
+			{
+				FAILMSG("Decompressed data is too big");
+				status = ERR_BOUNDS;
+				goto out;
+			}
 		}
 	}
 
-	// Do a similar list using doubles
-	for (count = 0; darray[count].res; count ++)
+	elapsedMs = max((cpuGetMs() - startMs), 1);
+
+	if ((deflate->outByte != INFLATE_BYTES) || (deflate->crc32Sum != crc) ||
+		memcmp(output, data, INFLATE_BYTES))
 	{
-		dres = sin(darray[count].rad);
-		if (dres != darray[count].res)
+		FAILMSG("Decompressed data doesn't match");
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	printf("%u->%u bytes %u KB/s ", compressedBytes, INFLATE_BYTES,
+		(unsigned)(((uquad_t) INFLATE_BYTES * INFLATE_PASSES * 1000) /
+			(elapsedMs * 1024)));
+
+	status = 0;
+
+out:
+	if (deflate)
+		free(deflate);
+	if (output)
+		free(output);
+	if (compressed)
+		free(compressed);
+	if (data)
+		free(data);
+
+	return (status);
+}
+
+
+static int deflate_levels(void)
+{
+	// Benchmark DEFLATE compression at each of the compression levels, and
+	// make sure the output decompresses back to the original
+
+	#define DEFLATE_BYTES		1000000
+
+	int status = 0;
+	unsigned char *data = NULL;
+	unsigned char *compressed = NULL;
+	unsigned char *output = NULL;
+	deflateState *deflate = NULL;
+	unsigned compressedBytes = 0;
+	unsigned crc = 0;
+	uquad_t startMs = 0, elapsedMs = 0;
+	int level;
+
+	data = malloc(DEFLATE_BYTES);
+	compressed = malloc(DEFLATE_BYTES);
+	output = malloc(DEFLATE_BYTES + DEFLATE_MAX_OUTBUFFERSIZE);
+	deflate = malloc(sizeof(deflateState));
+	if (!data || !compressed || !output || !deflate)
+	{
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	makeText(data, DEFLATE_BYTES);
+
+	for (level = DEFLATE_MIN_LEVEL; level <= DEFLATE_MAX_LEVEL; level ++)
+	{
+		memset(deflate, 0, sizeof(deflateState));
+		deflate->inBuffer = data;
+		deflate->inBytes = DEFLATE_BYTES;
+		deflate->outBuffer = compressed;
+		deflate->outBytes = DEFLATE_BYTES;
+		deflate->level = level;
+
+		startMs = cpuGetMs();
+
+		status = deflateCompress(deflate);
+		if (status < 0)
 		{
-			FAILMSG("Sine of double %f is incorrect (%f != %f)",
-				darray[count].rad, dres, darray[count].res);
-			status = ERR_INVALID;
+			FAILMSG("Error %d compressing at level %d", status, level);
 			goto out;
 		}
-	}
 
-	// Test some additional random values to make sure they're in the correct
-	// range.
-	for (count = 0; count < 2000; count ++)
-	{
-		rad = (float) randomFormatted(5, 100);
-		if (count % 2)
-			rad *= -1.0;
+		elapsedMs = max((cpuGetMs() - startMs), 1);
 
-		fres = sinf(rad);
-		if ((fres < -1) || (fres == 0) || (fres > 1))
+		compressedBytes = deflate->outByte;
+		crc = deflate->crc32Sum;
+
+		printf("\n  level %d: %u%% %u KB/s", level,
+			((compressedBytes * 100) / DEFLATE_BYTES),
+			(unsigned)(((uquad_t) DEFLATE_BYTES * 1000) /
+				(elapsedMs * 1024)));
+
+		memset(deflate, 0, sizeof(deflateState));
+		deflate->inBuffer = compressed;
+		deflate->inBytes = compressedBytes;
+		deflate->outBuffer = output;
+		deflate->outBytes = (DEFLATE_BYTES + DEFLATE_MAX_OUTBUFFERSIZE);
+
+		while (!deflate->final)
 		{
-			FAILMSG("Sine of %f is incorrect (%f)", rad, fres);
-			status = ERR_INVALID;
+			status = deflateDecompress(deflate);
+			if (status < 0)
+			{
+				FAILMSG("Error %d decompressing level %d", status, level);
+				goto out;
+			}
+
+			if (!deflate->final && (deflate->outBytes <
+				DEFLATE_MAX_OUTBUFFERSIZE))
+			{
+				FAILMSG("Decompressed data is too big");
+				status = ERR_BOUNDS;
+				goto out;
+			}
+		}
+
+		if ((deflate->outByte != DEFLATE_BYTES) ||
+			(deflate->crc32Sum != crc) ||
+			memcmp(output, data, DEFLATE_BYTES))
+		{
+			FAILMSG("Level %d data doesn't match", level);
+			status = ERR_BADDATA;
 			goto out;
 		}
 	}
 
+	printf("\n");
 	status = 0;
 
 out:
-	// Restore the text screen
-	textScreenRestore(&screen);
+	if (deflate)
+		free(deflate);
+	if (output)
+		free(output);
+	if (compressed)
+		free(compressed);
+	if (data)
+		free(data);
 
 	return (status);
 }
 
 
-static int cosines(void)
+static int deflateThreadsAlive(void)
 {
-	// Test the cos() and cosf() functions against some hard-coded values and
-	// some random values.
+	// Are any of the compression library's threads still around?
 
-	int status = 0;
-	float rad = 0;
-	float fres = 0;
-	double dres = 0;
-	int count;
+	process proc;
 
-	struct {
-		float rad;
-		float res;
+	memset(&proc, 0, sizeof(process));
 
-	} farray[] = {
-		{ -8.0, -0.145499974 },
-		{ -7.0, 0.753902254 },
-		{ -6.0, 0.958777964 },
-		{ -5.0, 0.283625454 },
-		{ -4.5, -0.210800409 },
-		{ -4.0, -0.653643906 },
-		{ -3.5, -0.936456680 },
-		{ -3.0, -0.989992439 },
-		{ -2.5, -0.801143587 },
-		{ -2.0, -0.416146845 },
-		{ -1.5, 0.070737205 },
-		{ -1.0, 0.540302277 },
-		{ -0.5, 0.877582609 },
-		{ 0.0, 1.000000000 },
-		{ 0.5, 0.877582609 },
-		{ 1.0, 0.540302277 },
-		{ 1.5, 0.070737205 },
-		{ 2.0, -0.416146845 },
-		{ 2.5, -0.801143587 },
-		{ 3.0, -0.989992439 },
-		{ 3.5, -0.936456680 },
-		{ 4.0, -0.653643906 },
-		{ 4.5, -0.210800409 },
-		{ 5.0, 0.283625454 },
-		{ 6.0, 0.958777964 },
-		{ 7.0, 0.753902254 },
-		{ 8.0, -0.145499974 },
-		{ 0.0, 0.0 }
-	};
+	return (!multitaskerGetProcessByName("compress thread", &proc) ||
+		!multitaskerGetProcessByName("decompress writer thread", &proc));
+}
 
-	struct {
-		double rad;
-		double res;
 
-	} darray[] = {
-		{ -8.0, -0.1455000338086137870 },
-		{ -7.0, 0.7539022543433044892 },
-		{ -6.0, 0.9601702874545081640 },
-		{ -5.0, 0.2836621854666496179 },
-		{ -4.5, -0.2107957994306340058 },
-		{ -4.0, -0.6536436208636079431 },
-		{ -3.5, -0.9364566872907962297 },
-		{ -3.0, -0.9899924966004455255 },
-		{ -2.5, -0.8011436155469335842 },
-		{ -2.0, -0.4161468365471424069 },
-		{ -1.5, 0.0707372016677029064 },
-		{ -1.0, 0.5403023058681396534 },
-		{ -0.5, 0.8775825618903727587 },
-		{ 0.0, 1.0000000000000000000 },
-		{ 0.5, 0.8775825618903727587 },
-		{ 1.0, 0.5403023058681396534 },
-		{ 1.5, 0.0707372016677029064 },
-		{ 2.0, -0.4161468365471424069 },
-		{ 2.5, -0.8011436155469335842 },
-		{ 3.0, -0.9899924966004455255 },
-		{ 3.5, -0.9364566872907962297 },
-		{ 4.0, -0.6536436208636079431 },
-		{ 4.5, -0.2107957994306340058 },
-		{ 5.0, 0.2836621854666496179 },
-		{ 6.0, 0.9601702874545081640 },
-		{ 7.0, 0.7539022543433044892 },
-		{ 8.0, -0.1455000338086137870 },
-		{ 0.0, 0.0 }
-	};
+static int deflate_files(void)
+{
+	// Compress a file big enough to be split into chunks for the pool of
+	// compression threads, and to need the decompression writer thread, and
+	// make sure it decompresses back to the original.  Then do it again with
+	// output streams that can't be written, and make sure that the threads
+	// all stop and the memory is freed.
+
+	#define DEFLATEFILE_BYTES		(6 * 1048576)
+	#define DEFLATEFILE_NAME		"./test_tmp.dat"
+	#define DEFLATEFILE_ZNAME		"./test_tmp.dat.z"
+	#define DEFLATEFILE_GZNAME		"./test_tmp.dat.gz"
+	#define DEFLATEFILE_OUTNAME		"./test_tmp.out"
 
-	status = textScreenSave(&screen);
-	if (status < 0)
+	int status = 0;
+	unsigned char *data = NULL;
+	unsigned char *output = NULL;
+	deflateState *deflate = NULL;
+	FILE *inStream = NULL;
+	FILE *outStream = NULL;
+	unsigned crc = 0;
+	unsigned trailer[2];
+	memoryStats before, after;
+	int screenSaved = 0;
+
+	data = malloc(DEFLATEFILE_BYTES);
+	output = malloc(DEFLATEFILE_BYTES + 1);
+	deflate = malloc(sizeof(deflateState));
+	if (!data || !output || !deflate)
 	{
-		FAILMSG("Error %d saving screen", status);
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
 		goto out;
 	}
 
-	// Test some fixed values from the array above using floats
-	for (count = 0; farray[count].res; count ++)
+	makeText(data, DEFLATEFILE_BYTES);
+	crc = crc32(data, DEFLATEFILE_BYTES, NULL);
+
+	outStream = fopen(DEFLATEFILE_NAME, "w");
+	if (!outStream || (fwrite(data, 1, DEFLATEFILE_BYTES, outStream) <
+		DEFLATEFILE_BYTES))
 	{
-		fres = cosf(farray[count].rad);
-		if (fres != farray[count].res)
-		{
-			FAILMSG("Cosine of float %f is incorrect (%f != %f)",
-				farray[count].rad, fres, farray[count].res);
-			status = ERR_INVALID;
-			goto out;
-		}
+		FAILMSG("Error writing %s", DEFLATEFILE_NAME);
+		status = ERR_IO;
+		goto out;
 	}
 
-	// Do a similar list using doubles
-	for (count = 0; darray[count].res; count ++)
+	fclose(outStream);
+
+	// Compress it
+	inStream = fopen(DEFLATEFILE_NAME, "r");
+	outStream = fopen(DEFLATEFILE_ZNAME, "w");
+	if (!inStream || !outStream)
 	{
-		dres = cos(darray[count].rad);
-		if (dres != darray[count].res)
-		{
-			FAILMSG("Cosine of double %f is incorrect (%f != %f)",
-				darray[count].rad, dres, darray[count].res);
-			status = ERR_INVALID;
-			goto out;
-		}
+		FAILMSG("Error opening files to compress");
+		status = ERR_IO;
+		goto out;
 	}
 
-	// Test some additional random values to make sure they're in the correct
-	// range.
-	for (count = 0; count < 2000; count ++)
+	memset(deflate, 0, sizeof(deflateState));
+	deflate->level = DEFLATE_MIN_LEVEL;
+
+	status = deflateCompressFileData(deflate, inStream, outStream, NULL);
+	if (status < 0)
 	{
-		rad = (float) randomFormatted(5, 100);
-		if (count % 2)
-			rad *= -1.0;
+		FAILMSG("Error %d compressing %s", status, DEFLATEFILE_NAME);
+		goto out;
+	}
 
-		fres = cosf(rad);
-		if ((fres < -1) || (fres == 0) || (fres > 1))
-		{
-			FAILMSG("Cosine of %f is incorrect (%f)", rad, fres);
-			status = ERR_INVALID;
-			goto out;
-		}
+	if (deflate->crc32Sum != crc)
+	{
+		FAILMSG("Compressed CRC %08x, not %08x", deflate->crc32Sum, crc);
+		status = ERR_BADDATA;
+		goto out;
 	}
 
-	status = 0;
+	fclose(outStream);
+	fclose(inStream);
 
-out:
-	// Restore the text screen
-	textScreenRestore(&screen);
+	// Decompress it
+	inStream = fopen(DEFLATEFILE_ZNAME, "r");
+	outStream = fopen(DEFLATEFILE_OUTNAME, "w");
+	if (!inStream || !outStream)
+	{
+		FAILMSG("Error opening files to decompress");
+		status = ERR_IO;
+		goto out;
+	}
+
+	status = deflateDecompressFileData(deflate, inStream, outStream, NULL);
+	if (status < 0)
+	{
+		FAILMSG("Error %d decompressing %s", status, DEFLATEFILE_ZNAME);
+		goto out;
+	}
+
+	if (deflate->crc32Sum != crc)
+	{
+		FAILMSG("Decompressed CRC %08x, not %08x", deflate->crc32Sum, crc);
+		status = ERR_BADDATA;
+		goto out;
+	}
 
-	return (status);
-}
+	fclose(outStream);
+	fclose(inStream);
+	outStream = NULL;
 
+	inStream = fopen(DEFLATEFILE_OUTNAME, "r");
+	if (!inStream || (fread(output, 1, (DEFLATEFILE_BYTES + 1), inStream) !=
+		DEFLATEFILE_BYTES) || memcmp(output, data, DEFLATEFILE_BYTES))
+	{
+		FAILMSG("Decompressed data doesn't match");
+		status = ERR_BADDATA;
+		goto out;
+	}
 
-static int floats(void)
-{
-	// Do calculations with floats (tests the kernel's FPU exception handling
-	// and state saving).  Adapted from an early version of our JPEG
-	// processing code.
+	fclose(inStream);
+	inStream = NULL;
 
-	int coefficients[64];
-	int u = 0;
-	int v = 0;
-	int x = 0;
-	int y = 0;
-	float tempValue = 0;
-	float temp[64];
-	int count;
+	// Compress it with GZIP, and check the CRC and size at the end
+	status = gzipCompressFile(DEFLATEFILE_NAME, DEFLATEFILE_GZNAME, NULL,
+		0 /* no append */, DEFLATE_MIN_LEVEL, NULL);
+	if (status < 0)
+	{
+		FAILMSG("Error %d compressing %s", status, DEFLATEFILE_GZNAME);
+		goto out;
+	}
 
-	memset(coefficients, 0, (64 * sizeof(int)));
-	memset(temp, 0, (64 * sizeof(float)));
+	inStream = fopen(DEFLATEFILE_GZNAME, "r");
+	if (!inStream || (inStream->f.size < sizeof(trailer)) ||
+		(fseek(inStream, -((long) sizeof(trailer)), SEEK_END) < 0) ||
+		(fread(trailer, sizeof(trailer), 1, inStream) != 1))
+	{
+		FAILMSG("Error reading %s", DEFLATEFILE_GZNAME);
+		status = ERR_IO;
+		goto out;
+	}
 
-	for (count = 0; count < 64; count ++)
-		coefficients[count] = rand();
+	if ((trailer[0] != crc) || (trailer[1] != DEFLATEFILE_BYTES))
+	{
+		FAILMSG("GZIP CRC %08x size %u, not %08x size %u", trailer[0],
+			trailer[1], crc, DEFLATEFILE_BYTES);
+		status = ERR_BADDATA;
+		goto out;
+	}
 
-	for (count = 0; count < 1000; count ++)
+	fclose(inStream);
+	inStream = NULL;
+
+	// Now make the output fail, with the threads busy.  The library will
+	// complain about it.
+	status = textScreenSave(&screen);
+	if (status < 0)
 	{
-		for (x = 0; x < 8; x++)
-		{
-			for (y = 0; y < 8; y++)
-			{
-				for (u = 0; u < 8; u++)
-				{
-					for (v = 0; v < 8; v++)
-					{
-						tempValue = coefficients[(u * 8) + v] *
-						cosf((2 * x + 1) * u * (float) M_PI / 16.0) *
-						cosf((2 * y + 1) * v * (float) M_PI / 16.0);
+		FAILMSG("Error %d saving screen", status);
+		goto out;
+	}
 
-						if (!u)
-							tempValue *= (float) M_SQRT1_2;
-						if (!v)
-							tempValue *= (float) M_SQRT1_2;
+	screenSaved = 1;
 
-						temp[(x * 8) + y] += tempValue;
-					}
-				}
-			}
-		}
+	_mallocGetStats(&before);
 
-		for (y = 0; y < 8; y++)
-		{
-			for (x = 0; x < 8; x++)
-			{
-				coefficients[(y * 8) + x] = (int)(temp[(y * 8) + x] / 4.0 +
-					0.5);
-				coefficients[(y * 8) + x] += 128;
-			}
-		}
+	inStream = fopen(DEFLATEFILE_NAME, "r");
+	outStream = fopen(DEFLATEFILE_ZNAME, "r");
+	if (!inStream || !outStream)
+	{
+		FAILMSG("Error opening files to compress");
+		status = ERR_IO;
+		goto out;
 	}
 
-	// If we get this far without crashing, we're golden
-	return (0);
-}
+	memset(deflate, 0, sizeof(deflateState));
+	deflate->level = DEFLATE_MIN_LEVEL;
 
+	if (deflateCompressFileData(deflate, inStream, outStream, NULL) >= 0)
+	{
+		FAILMSG("Compressing to a read-only stream didn't fail");
+		status = ERR_BADDATA;
+		goto out;
+	}
 
-static int libdl(void)
-{
-	int status = 0;
-	char *libName = NULL;
-	void *libHandle = NULL;
-	char *symbolName = NULL;
-	int (*fn)(const char *format, ...) = NULL;
+	fclose(outStream);
+	fclose(inStream);
 
-	status = textScreenSave(&screen);
-	if (status < 0)
+	inStream = fopen(DEFLATEFILE_ZNAME, "r");
+	outStream = fopen(DEFLATEFILE_OUTNAME, "r");
+	if (!inStream || !outStream)
 	{
-		FAILMSG("Error %d saving screen", status);
+		FAILMSG("Error opening files to decompress");
+		status = ERR_IO;
 		goto out;
 	}
 
-	libName = "libc.so";
-	libHandle = dlopen(libName, RTLD_NOW);
-	if (!libHandle)
+	if (deflateDecompressFileData(deflate, inStream, outStream, NULL) >= 0)
 	{
-		FAILMSG("Error getting library %s", libName);
-		status = ERR_NODATA;
+		FAILMSG("Decompressing to a read-only stream didn't fail");
+		status = ERR_BADDATA;
 		goto out;
 	}
 
-	symbolName = "printf";
-	fn = dlsym(libHandle, symbolName);
-	if (!fn)
+	fclose(outStream);
+	fclose(inStream);
+	outStream = inStream = NULL;
+
+	_mallocGetStats(&after);
+
+	if (deflateThreadsAlive())
 	{
-		FAILMSG("Error getting library symbol %s", symbolName);
-		status = ERR_NODATA;
+		FAILMSG("Threads still running after write errors");
+		status = ERR_BADDATA;
 		goto out;
 	}
 
-	fn("If you can read this, it works\n", libName, symbolName, fn);
+	if (after.usedMemory != before.usedMemory)
+	{
+		FAILMSG("%d bytes leaked after write errors",
+			(int)(after.usedMemory - before.usedMemory));
+		status = ERR_BADDATA;
+		goto out;
+	}
 
-	sleep(3);
 	status = 0;
 
 out:
-	// Restore the text screen
-	textScreenRestore(&screen);
+	if (screenSaved)
+		textScreenRestore(&screen);
+
+	if (outStream)
+		fclose(outStream);
+	if (inStream)
+		fclose(inStream);
+
+	fileDelete(DEFLATEFILE_OUTNAME);
+	fileDelete(DEFLATEFILE_GZNAME);
+	fileDelete(DEFLATEFILE_ZNAME);
+	fileDelete(DEFLATEFILE_NAME);
+
+	if (deflate)
+		free(deflate);
+	if (output)
+		free(output);
+	if (data)
+		free(data);
 
 	return (status);
 }
 
 
-static int randoms(void)
+static int tar_extract(void)
 {
+	// Make a GZIP-compressed TAR file with a member that's bigger than
+	// several of the decompressor's output buffers, followed by a small
+	// one, and make sure that extracting it without a temporary file gets
+	// both of them back with the right sizes and contents
+
+	#define TAR_BIGNAME			"test_tmp.big"
+	#define TAR_BIGBYTES		((12 * 1048576) + 123)
+	#define TAR_SMALLNAME		"test_tmp.small"
+	#define TAR_SMALLDATA		"small file\n"
+	#define TAR_NAME			"test_tmp.tar"
+	#define TAR_GZNAME			"test_tmp.tar.gz"
+
 	int status = 0;
-	unsigned numRandoms = 1000000;
-	int val = 0;
-	int evens = 0;
-	int odds = 0;
-	unsigned difference = 0;
+	unsigned char *data = NULL;
+	unsigned char *output = NULL;
+	FILE *theStream = NULL;
 	unsigned count;
 
-	status = textScreenSave(&screen);
+	data = malloc(TAR_BIGBYTES);
+	output = malloc(TAR_BIGBYTES + 1);
+	if (!data || !output)
+	{
+		FAILMSG("Error getting memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	// A pattern that doesn't line up with any buffer size
+	for (count = 0; count < TAR_BIGBYTES; count ++)
+		data[count] = (count % 251);
+
+	theStream = fopen(TAR_BIGNAME, "w");
+	if (!theStream || (fwrite(data, 1, TAR_BIGBYTES, theStream) <
+		TAR_BIGBYTES))
+	{
+		FAILMSG("Error writing %s", TAR_BIGNAME);
+		status = ERR_IO;
+		goto out;
+	}
+
+	fclose(theStream);
+
+	theStream = fopen(TAR_SMALLNAME, "w");
+	if (!theStream || (fwrite(TAR_SMALLDATA, 1, strlen(TAR_SMALLDATA),
+		theStream) < strlen(TAR_SMALLDATA)))
+	{
+		FAILMSG("Error writing %s", TAR_SMALLNAME);
+		status = ERR_IO;
+		goto out;
+	}
+
+	fclose(theStream);
+	theStream = NULL;
+
+	status = tarAddMember(TAR_BIGNAME, TAR_NAME, NULL);
+	if (status >= 0)
+		status = tarAddMember(TAR_SMALLNAME, TAR_NAME, NULL);
 	if (status < 0)
 	{
-		FAILMSG("Error %d saving screen", status);
+		FAILMSG("Error %d making %s", status, TAR_NAME);
 		goto out;
 	}
 
-	for (count = 0; count < numRandoms; count ++)
+	status = gzipCompressFile(TAR_NAME, TAR_GZNAME, NULL, 0 /* no append */,
+		DEFLATE_MIN_LEVEL, NULL);
+	if (status < 0)
 	{
-		val = rand();
+		FAILMSG("Error %d compressing %s", status, TAR_NAME);
+		goto out;
+	}
 
-		if (val & 1)
-			odds += 1;
-		else
-			evens += 1;
+	fileDelete(TAR_BIGNAME);
+	fileDelete(TAR_SMALLNAME);
+
+	status = tarExtractGzip(TAR_GZNAME, NULL);
+	if (status < 0)
+	{
+		FAILMSG("Error %d extracting %s", status, TAR_GZNAME);
+		goto out;
 	}
 
-	difference = abs(evens - odds);
-	if (difference > (numRandoms / 10))
+	theStream = fopen(TAR_BIGNAME, "r");
+	if (!theStream)
 	{
-		FAILMSG("Imbalance in evens (%d) and odds (%d) > 10%%", evens, odds);
+		FAILMSG("%s wasn't extracted", TAR_BIGNAME);
+		status = ERR_NOSUCHFILE;
+		goto out;
+	}
+
+	if ((theStream->f.size != TAR_BIGBYTES) ||
+		(fread(output, 1, (TAR_BIGBYTES + 1), theStream) != TAR_BIGBYTES) ||
+		memcmp(output, data, TAR_BIGBYTES))
+	{
+		FAILMSG("%s has size %u, or the wrong contents", TAR_BIGNAME,
+			theStream->f.size);
+		status = ERR_BADDATA;
+		goto out;
+	}
+
+	fclose(theStream);
+
+	theStream = fopen(TAR_SMALLNAME, "r");
+	if (!theStream)
+	{
+		FAILMSG("%s wasn't extracted", TAR_SMALLNAME);
+		status = ERR_NOSUCHFILE;
+		goto out;
+	}
+
+	memset(output, 0, (strlen(TAR_SMALLDATA) + 1));
+
+	if ((theStream->f.size != strlen(TAR_SMALLDATA)) ||
+		(fread(output, 1, (strlen(TAR_SMALLDATA) + 1), theStream) !=
+			strlen(TAR_SMALLDATA)) ||
+		strcmp((char *) output, TAR_SMALLDATA))
+	{
+		FAILMSG("%s has size %u, or the wrong contents", TAR_SMALLNAME,
+			theStream->f.size);
 		status = ERR_BADDATA;
 		goto out;
 	}
@@ -1846,8 +4013,18 @@ static int randoms(void)
 	status = 0;
 
 out:
-	// Restore the text screen
-	textScreenRestore(&screen);
+	if (theStream)
+		fclose(theStream);
+
+	fileDelete(TAR_GZNAME);
+	fileDelete(TAR_NAME);
+	fileDelete(TAR_SMALLNAME);
+	fileDelete(TAR_BIGNAME);
+
+	if (output)
+		free(output);
+	if (data)
+		free(data);
 
 	return (status);
 }
@@ -2246,6 +4423,184 @@ out:
 }
 
 
+static int text_render(void)
+{
+	// Benchmark drawing lines of text into an off-screen graphic buffer.
+	// Opaque text is drawn from the kernel's pre-rendered glyph cache;
+	// translucent text is drawn glyph-by-glyph from the mono bitmaps, which
+	// gives us something to compare against.
+
+	#define TEXTRENDER_COLUMNS	80
+	#define TEXTRENDER_ROWS		25
+	#define TEXTRENDER_PASSES	20
+
+	int status = 0;
+	objectKey font = NULL;
+	graphicBuffer buffer;
+	char line[TEXTRENDER_COLUMNS + 1];
+	color foreground = { 255, 255, 255 };
+	color background = { 0, 0, 0 };
+	drawMode modes[] = { draw_normal, draw_translucent };
+	const char *modeNames[] = { "cached", "uncached" };
+	unsigned glyphs = 0;
+	uquad_t startMs = 0, elapsedMs = 0;
+	int count1, count2, count3;
+
+	memset((void *) &buffer, 0, sizeof(graphicBuffer));
+
+	font = fontGet(FONT_FAMILY_XTERM, FONT_STYLEFLAG_NORMAL, 10, NULL);
+	if (!font)
+	{
+		FAILMSG("Error getting font");
+		status = ERR_NOSUCHENTRY;
+		goto out;
+	}
+
+	buffer.width = (TEXTRENDER_COLUMNS * fontGetWidth(font));
+	buffer.height = (TEXTRENDER_ROWS * fontGetHeight(font));
+	buffer.data = malloc(graphicCalculateAreaBytes(buffer.width,
+		buffer.height));
+	if (!buffer.data)
+	{
+		FAILMSG("Error getting buffer memory");
+		status = ERR_MEMORY;
+		goto out;
+	}
+
+	for (count1 = 0; count1 < TEXTRENDER_COLUMNS; count1 ++)
+		line[count1] = ('!' + (count1 % ('~' - '!')));
+	line[TEXTRENDER_COLUMNS] = '\0';
+
+	for (count1 = 0; count1 < 2; count1 ++)
+	{
+		glyphs = 0;
+		startMs = cpuGetMs();
+
+		for (count2 = 0; count2 < TEXTRENDER_PASSES; count2 ++)
+		{
+			for (count3 = 0; count3 < TEXTRENDER_ROWS; count3 ++)
+			{
+				status = graphicDrawText(&buffer, &foreground, &background,
+					font, NULL, line, modes[count1], 0,
+					(count3 * fontGetHeight(font)));
+				if (status < 0)
+				{
+					FAILMSG("Error %d drawing text", status);
+					goto out;
+				}
+
+				glyphs += status;
+			}
+		}
+
+		elapsedMs = max((cpuGetMs() - startMs), 1);
+
+		printf("%s %u glyphs/s ", modeNames[count1],
+			(unsigned)((glyphs * 1000ULL) / elapsedMs));
+	}
+
+	status = 0;
+
+out:
+	if (buffer.data)
+		free(buffer.data);
+
+	return (status);
+}
+
+
+static int framebuffer_fill(void)
+{
+	// Benchmark filling the whole screen.  The kernel maps big, aligned
+	// regions of the framebuffer using large pages, where it can, so this
+	// shows the effect of that (or its absence).  Afterwards, read back some
+	// lines of the screen and make sure they're the last fill color.
+
+	#define FBFILL_PASSES		50
+
+	int status = 0;
+	int width = graphicGetScreenWidth();
+	int height = graphicGetScreenHeight();
+	color colors[] = { { 248, 0, 0 }, { 0, 248, 0 }, { 0, 0, 248 } };
+	color *expect = &colors[(FBFILL_PASSES - 1) % 3];
+	int lines[3];
+	image lineImage;
+	pixel *pixels = NULL;
+	uquad_t startMs = 0, elapsedMs = 0;
+	int count1, count2;
+
+	if ((width <= 0) || (height <= 0))
+	{
+		FAILMSG("Error getting screen size");
+		return (status = ERR_NODATA);
+	}
+
+	startMs = cpuGetMs();
+
+	for (count1 = 0; count1 < FBFILL_PASSES; count1 ++)
+	{
+		status = graphicDrawRect(NULL, &colors[count1 % 3], draw_normal, 0,
+			0, width, height, 1, 1);
+		if (status < 0)
+		{
+			FAILMSG("Error %d filling the screen", status);
+			break;
+		}
+	}
+
+	elapsedMs = max((cpuGetMs() - startMs), 1);
+
+	// Check the top, middle, and bottom lines.  The screen might have fewer
+	// bits per color than we do, so allow for some rounding.
+	lines[0] = 0;
+	lines[1] = (height / 2);
+	lines[2] = (height - 1);
+
+	for (count1 = 0; (status >= 0) && (count1 < 3); count1 ++)
+	{
+		memset(&lineImage, 0, sizeof(image));
+
+		status = graphicGetImage(NULL, &lineImage, 0, lines[count1], width,
+			1);
+		if (status < 0)
+		{
+			FAILMSG("Error %d reading the screen", status);
+			break;
+		}
+
+		pixels = lineImage.data;
+
+		for (count2 = 0; count2 < width; count2 ++)
+		{
+			if ((abs(pixels[count2].red - expect->red) > 8) ||
+				(abs(pixels[count2].green - expect->green) > 8) ||
+				(abs(pixels[count2].blue - expect->blue) > 8))
+			{
+				FAILMSG("Pixel %d,%d is %02x%02x%02x, expected %02x%02x%02x",
+					count2, lines[count1], pixels[count2].red,
+					pixels[count2].green, pixels[count2].blue, expect->red,
+					expect->green, expect->blue);
+				status = ERR_BUG;
+				break;
+			}
+		}
+
+		imageFree(&lineImage);
+	}
+
+	// Get the window system to redraw everything
+	windowRefresh();
+
+	if (status < 0)
+		return (status);
+
+	printf("%dx%d %u fills/s ", width, height,
+		(unsigned)((FBFILL_PASSES * 1000ULL) / elapsedMs));
+
+	return (status = 0);
+}
+
+
 // This table describes all of the functions to run
 struct {
 	int (*function)(void);
@@ -2258,20 +4613,38 @@ struct {
 	{ pipes,			"pipes",			0,  0 },
 	{ format_strings,	"format strings",	0,  0 },
 	{ exceptions,		"exceptions",		0,  0 },
+	{ context_switch,	"context switch",	0,  0 },
+	{ sleep_accuracy,	"sleep accuracy",	0,  0 },
+	{ smp_scaling,		"smp scaling",		0,  0 },
+	{ pthreads,			"pthreads",			0,  0 },
+	{ copy_on_write,	"copy on write",	0,  0 },
+	{ process_stats,	"process stats",	0,  0 },
 	{ text_output,		"text output",		0,  0 },
 	{ text_colors,		"text colors",		0,  0 },
 	{ xtra_chars,		"xtra chars",		0,  0 },
 	{ port_io,			"port io",			0,  0 },
 	{ disk_io,			"disk io",			0,  0 },
 	{ file_ops,			"file ops",			0,  0 },
+	{ config_cache,		"config cache",		0,  0 },
+	{ variable_lists,	"variable lists",	0,  0 },
+	{ http_responses,	"http responses",	0,  0 },
+	{ xml_parsing,		"xml parsing",		0,  0 },
 	{ divide64,			"divide64",			0,  0 },
 	{ sines,			"sines",			0,  0 },
 	{ cosines,			"cosines",			0,  0 },
 	{ floats,			"floats",			0,  0 },
 	{ libdl,			"libdl",			0,  0 },
 	{ randoms,			"randoms",			0,  0 },
+	{ crc32s,			"crc32",			0,  0 },
+	{ sha_hashes,		"sha hashes",		0,  0 },
+	{ inflate,			"inflate",			0,  0 },
+	{ deflate_levels,	"deflate levels",	0,  0 },
+	{ deflate_files,	"deflate files",	0,  0 },
+	{ tar_extract,		"tar extract",		0,  0 },
 	{ gui,				"gui",				0,  1 },
 	{ icons,			"icons",			0,  1 },
+	{ text_render,		"text render",		0,  1 },
+	{ framebuffer_fill,	"framebuffer fill",	0,  1 },
 	{ NULL, NULL, 0, 0 }
 };
 
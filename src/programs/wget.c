@@ -29,10 +29,11 @@
 Download files from the web.
 
 Usage:
-  wget <URL>
+  wget <URL> [URL...]
 
 This command will send HTTP commands to download documents and elements
-referenced by them - for example images.
+referenced by them - for example images.  When several URLs are given, the
+requests for the same server are sent over a single connection.
 
 </help>
 */
@@ -61,113 +62,231 @@ extern int debugLibHttp;
 
 static void usage(char *name)
 {
-	fprintf(stderr, _("usage:\n%s <URL>\n"), name);
+	fprintf(stderr, _("usage:\n%s <URL> [URL...]\n"), name);
 	return;
 }
 
 
-static int getUrl(const char *urlString, int maxRecursions)
+typedef struct {
+	const char *urlString;
+	urlInfo *url;
+	char fullPath[MAX_PATH_NAME_LENGTH + 1];
+	fileStream outStream;
+	int opened;
+
+} download;
+
+
+static int writeContent(int request, const char *content, unsigned len,
+	void *data)
 {
+	// Called by the HTTP library as each piece of content arrives.  The file
+	// is created when the first piece comes in.
+
 	int status = 0;
-	urlInfo *url = NULL;
-	char fullPath[MAX_PATH_NAME_LENGTH + 1];
+	download *downloads = data;
+	download *dl = NULL;
+	int count;
+
+	// The request number counts only the URLs that were sent
+	for (count = 0; ; count ++)
+	{
+		if (!downloads[count].url)
+			continue;
+
+		if (!request--)
+		{
+			dl = &downloads[count];
+			break;
+		}
+	}
+
+	if (!dl->opened)
+	{
+		status = fileStreamOpen(dl->fullPath, (OPENMODE_WRITE |
+			OPENMODE_CREATE | OPENMODE_TRUNCATE), &dl->outStream);
+		if (status < 0)
+			return (status);
+
+		dl->opened = 1;
+	}
+
+	return (status = fileStreamWrite(&dl->outStream, len, content));
+}
+
+
+static int getUrls(int numUrls, const char *urlStrings[], int maxRecursions)
+{
+	// Retrieve all of the URLs together, so that the HTTP library can send
+	// the ones for the same server over a single connection, and then follow
+	// any redirects.
+
+	int status = 0;
+	download *downloads = NULL;
+	download *dl = NULL;
+	urlInfo **urls = NULL;
+	variableList *headers = NULL;
+	int *results = NULL;
+	int numRequests = 0;
+	variableList *header = NULL;
 	char *dirName = NULL;
-	variableList header;
 	const char *statusCode = NULL;
 	const char *redirect = NULL;
-	char *content = NULL;
-	int contentLen = 0;
-	fileStream outStream;
+	int count;
 
-	printf("Parsing '%s'\n", urlString);
+	if (maxRecursions <= 0)
+	{
+		fprintf(stderr, "%s\n", _("Too many redirections"));
+		return (status = ERR_RANGE);
+	}
 
-	status = httpParseUrl(urlString, &url);
-	if (status < 0)
+	downloads = calloc(numUrls, sizeof(download));
+	urls = calloc(numUrls, sizeof(urlInfo *));
+	headers = calloc(numUrls, sizeof(variableList));
+	results = calloc(numUrls, sizeof(int));
+	if (!downloads || !urls || !headers || !results)
 	{
-		fprintf(stderr, "%s\n", _("Error parsing URL"));
+		status = ERR_MEMORY;
 		goto out;
 	}
 
-	// Compose the full path to the file we'll be saving
-	strncpy(fullPath, urlString, MAX_PATH_NAME_LENGTH);
-	if (url->host && url->path)
+	for (count = 0; count < numUrls; count ++)
 	{
-		snprintf(fullPath, MAX_PATH_NAME_LENGTH, "%s/%s", url->host,
-			url->path);
+		downloads[count].urlString = urlStrings[count];
+
+		printf("Parsing '%s'\n", urlStrings[count]);
+
+		status = httpParseUrl(urlStrings[count], &downloads[count].url);
+		if (status < 0)
+		{
+			fprintf(stderr, "%s %s\n", _("Error parsing URL"),
+				urlStrings[count]);
+			downloads[count].url = NULL;
+			continue;
+		}
+
+		// Compose the full path to the file we'll be saving
+		strncpy(downloads[count].fullPath, urlStrings[count],
+			MAX_PATH_NAME_LENGTH);
+		if (downloads[count].url->host && downloads[count].url->path)
+		{
+			snprintf(downloads[count].fullPath, MAX_PATH_NAME_LENGTH,
+				"%s/%s", downloads[count].url->host,
+				downloads[count].url->path);
+		}
+
+		// Get the directory part and try to make sure it exists
+		dirName = dirname(downloads[count].fullPath);
+		if (dirName)
+		{
+			vshMakeDirRecursive(dirName);
+			free(dirName);
+		}
+
+		urls[numRequests++] = downloads[count].url;
 	}
 
-	// Get the directory part and try to make sure it exists
-	dirName = dirname(fullPath);
-	if (dirName)
+	status = 0;
+
+	if (numRequests)
 	{
-		vshMakeDirRecursive(dirName);
-		free(dirName);
+		status = httpGetPipelined(urls, headers, results, numRequests,
+			&writeContent, downloads, 10000 /* 10 second timeout */);
 	}
 
-	status = httpGet(url, &header, &content, &contentLen,
-		10000 /* 10 second timeout */);
-	if (status < 0)
+	for (count = 0, numRequests = 0; count < numUrls; count ++)
 	{
-		statusCode = variableListGet(&header, HTTP_STATUSCODE_VAR);
-		if (statusCode)
+		dl = &downloads[count];
+		if (!dl->url)
+			continue;
+
+		header = &headers[numRequests];
+
+		if (dl->opened)
+			fileStreamClose(&dl->outStream);
+
+		if ((results[numRequests] >= 0) && !dl->opened)
 		{
-			switch (atoi(statusCode))
+			// Nothing went wrong, there just wasn't any content.  Leave an
+			// empty file.
+			if (fileStreamOpen(dl->fullPath, (OPENMODE_WRITE |
+				OPENMODE_CREATE | OPENMODE_TRUNCATE), &dl->outStream) >= 0)
 			{
-				case HTTP_STATUSCODE_MOVEDPERMANENTLY:
-				case HTTP_STATUSCODE_SEEOTHER:
-				case HTTP_STATUSCODE_TEMPORARYREDIRECT:
-				case HTTP_STATUSCODE_PERMANENTREDIRECT:
+				fileStreamClose(&dl->outStream);
+			}
+		}
+
+		if (results[numRequests] < 0)
+		{
+			redirect = NULL;
+
+			statusCode = variableListGet(header, HTTP_STATUSCODE_VAR);
+			if (statusCode)
+			{
+				switch (atoi(statusCode))
 				{
-					// See whether we can retrieve it at another URL
-					redirect = variableListGet(&header, HTTP_HEADER_LOCATION);
-					if (redirect)
-					{
-						if (!strcmp(urlString, redirect))
-						{
-							fprintf(stderr, "%s %s\n", _("Error redirection "
-								"to same URL"), urlString);
-							status = ERR_ALREADY;
-							goto out;
-						}
-
-						status = getUrl(redirect, (maxRecursions - 1));
-						goto out;
-					}
+					case HTTP_STATUSCODE_MOVEDPERMANENTLY:
+					case HTTP_STATUSCODE_SEEOTHER:
+					case HTTP_STATUSCODE_TEMPORARYREDIRECT:
+					case HTTP_STATUSCODE_PERMANENTREDIRECT:
+						// See whether we can retrieve it at another URL
+						redirect = variableListGet(header,
+							HTTP_HEADER_LOCATION);
+						break;
 				}
 			}
+
+			if (redirect && !strcmp(dl->urlString, redirect))
+			{
+				fprintf(stderr, "%s %s\n", _("Error redirection to same "
+					"URL"), dl->urlString);
+				status = ERR_ALREADY;
+			}
+			else if (redirect)
+			{
+				results[numRequests] = getUrls(1, &redirect,
+					(maxRecursions - 1));
+				if (results[numRequests] < 0)
+					status = results[numRequests];
+			}
+			else
+			{
+				fprintf(stderr, "%s %s\n", _("Error retrieving"),
+					dl->urlString);
+				status = results[numRequests];
+			}
 		}
 
-		fprintf(stderr, "%s %s\n", _("Error retrieving"), urlString);
-		goto out;
+		numRequests += 1;
 	}
 
-	status = fileStreamOpen(fullPath, (OPENMODE_WRITE | OPENMODE_CREATE |
-		OPENMODE_TRUNCATE), &outStream);
-	if (status < 0)
+out:
+	if (headers)
 	{
-		fprintf(stderr, "%s %s\n", _("Error writing"), urlString);
-		goto out;
-	}
-
-	status = fileStreamWrite(&outStream, contentLen, content);
+		for (count = 0; count < numRequests; count ++)
+		{
+			if (headers[count].memory)
+				variableListDestroy(&headers[count]);
+		}
 
-	fileStreamClose(&outStream);
+		free(headers);
+	}
 
-	if (status < 0)
+	if (downloads)
 	{
-		fprintf(stderr, "%s %s\n", _("Error writing"), urlString);
-		goto out;
-	}
+		for (count = 0; count < numUrls; count ++)
+		{
+			if (downloads[count].url)
+				httpFreeUrlInfo(downloads[count].url);
+		}
 
-	status = 0;
+		free(downloads);
+	}
 
-out:
-	if (content)
-		free(content);
-	if (header.memory)
-		variableListDestroy(&header);
-	if (url)
-		httpFreeUrlInfo(url);
+	if (urls)
+		free(urls);
+	if (results)
+		free(results);
 
 	return (status);
 }
@@ -176,7 +295,6 @@ out:
 int main(int argc, char *argv[])
 {
 	int status = 0;
-	int count;
 
 	setlocale(LC_ALL, getenv(ENV_LANG));
 	textdomain("wget");
@@ -194,12 +312,11 @@ int main(int argc, char *argv[])
 		return (status = ERR_ARGUMENTCOUNT);
 	}
 
-	for (count = 1; count < argc; count ++)
-	{
-		status = getUrl(argv[count], DEFAULT_RECURSIONS);
-		if (status < 0)
-			continue;
-	}
+	status = getUrls((argc - 1), (const char **) &argv[1],
+		DEFAULT_RECURSIONS);
+
+	// Don't leave any kept-alive connections hanging around
+	httpCloseConnections();
 
 	return (status);
 }
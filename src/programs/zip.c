@@ -29,10 +29,10 @@
 Compress and archive files, and manage archives.
 
 Usage:
-  zip [-p] <file1> [file2] [...]
+  zip [-p] [-1-9] <file1> [file2] [...]
     Each file name listed will be packed in its own archive file.
 
-  zip [-p] -a <archive> <file1> [file2] [...]
+  zip [-p] [-1-9] -a <archive> <file1> [file2] [...]
     Each file name listed will be added to the archive file.
 
   zip [-p] -d <archive> <member1> [member2] [...]
@@ -42,6 +42,7 @@ Usage:
     Print info about the members of the archive file.
 
 Options:
+-1-9: Compression level, from fastest (1) to best (9).  The default is 6.
 -a  : Add files to an archive
 -d  : Delete members from an archive
 -i  : Print info about the archive members
@@ -68,8 +69,8 @@ Options:
 
 static void usage(char *name)
 {
-	printf(_("usage:\n%s [-p] <file1> [file2] [...]\n"
-		"%s [-p] -a <archive> <file1> [file2] [...]\n"
+	printf(_("usage:\n%s [-p] [-1-9] <file1> [file2] [...]\n"
+		"%s [-p] [-1-9] -a <archive> <file1> [file2] [...]\n"
 		"%s [-p] -d <archive> <member1> [member2] [...]\n"
 		"%s [-p] -i <archive>\n"), name, name, name, name);
 	return;
@@ -124,6 +125,7 @@ int main(int argc, char *argv[])
 	int info = 0;
 	char *archive = NULL;
 	int showProgress = 0;
+	int level = 0;
 	progress prog;
 	int count;
 
@@ -131,10 +133,24 @@ int main(int argc, char *argv[])
 	textdomain("zip");
 
 	// Check options
-	while (strchr("adip:?", (opt = getopt(argc, argv, "a:d:i:p"))))
+	while (strchr("123456789adip:?",
+		(opt = getopt(argc, argv, "123456789a:d:i:p"))))
 	{
 		switch (opt)
 		{
+			case '1':
+			case '2':
+			case '3':
+			case '4':
+			case '5':
+			case '6':
+			case '7':
+			case '8':
+			case '9':
+				// Set the compression level
+				level = (opt - '0');
+				break;
+
 			case 'a':
 				// Add files to the named archive
 				if (!optarg)
@@ -218,7 +234,7 @@ int main(int argc, char *argv[])
 			{
 				status = archiveAddMember(argv[count], archive,
 					0 /* library determines format */, NULL /* comment */,
-					(showProgress? &prog : NULL));
+					level, (showProgress? &prog : NULL));
 			}
 			else if (delete)
 			{
@@ -229,7 +245,7 @@ int main(int argc, char *argv[])
 			{
 				status = archiveAddMember(argv[count], NULL /* own archive */,
 					0 /* library determines format */, NULL /* comment */,
-					(showProgress? &prog : NULL));
+					level, (showProgress? &prog : NULL));
 			}
 
 			if (showProgress)